@@ -1,8 +1,7 @@
 #!/bin/bash
 
-#FIXME: we have to find a solution for these two lines on linux
-#64tass --nostart cart.a --output=launch.cbm80
-#64tass --nostart cart_ultimax.a --output=launch_ultimax.cbm80
+64tass --nostart cart.a --output=launch.cbm80 || exit 1
+64tass --nostart cart_ultimax.a --output=launch_ultimax.cbm80 || exit 1
 
 cc65 -v -t c64 -T -O --static-locals rpimenu.c
 ca65 -v -t c64 rpimenu_sub.s
@@ -0,0 +1,37 @@
+//
+// minimal replacement of Circle's logger.h for building crt.cpp on the host
+//
+#ifndef _circle_logger_h
+#define _circle_logger_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+enum TLogSeverity
+{
+	LogPanic,
+	LogError,
+	LogWarning,
+	LogNotice,
+	LogDebug
+};
+
+class CLogger
+{
+public:
+	void Write( const char *pSource, TLogSeverity Severity, const char *pMessage, ... )
+	{
+		va_list var;
+		va_start( var, pMessage );
+		fprintf( stderr, "%s: ", pSource );
+		vfprintf( stderr, pMessage, var );
+		fprintf( stderr, "\n" );
+		va_end( var );
+
+		if ( Severity == LogPanic )
+			exit( 1 );
+	}
+};
+
+#endif
@@ -0,0 +1,320 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ crtload.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - host tool: reading .CRT files chip by chip (fast start of kernel_ef.cpp)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crt.h"
+
+// as in kernel_ef.cpp
+static u8 flashFull[ 1024 * 1024 + 8 * 1024 ];
+static u8 flashStream[ 1024 * 1024 + 8 * 1024 ];
+
+static CLogger logger;
+
+//
+// FatFs on top of stdio, counting what is read from the "SD card": the bytes requested, and the 512-byte sectors
+// the card has to deliver for them
+//
+static u64 nBytesRead, nSectors, nReads, nSeeks, nOpens;
+
+FRESULT f_mount( FATFS *fs, const char *path, unsigned char opt )
+{
+	return FR_OK;
+}
+
+FRESULT f_stat( const char *path, FILINFO *fno )
+{
+	FILE *f = fopen( path, "rb" );
+	if ( !f )
+		return FR_NO_FILE;
+	fseek( f, 0, SEEK_END );
+	fno->fsize = (FSIZE_t)ftell( f );
+	fclose( f );
+	return FR_OK;
+}
+
+FRESULT f_open( FIL *fp, const char *path, unsigned char mode )
+{
+	fp->f = fopen( path, ( mode & FA_WRITE ) ? "wb" : "rb" );
+	fp->pos = 0;
+	fp->bufSector = -1;
+	nOpens ++;
+	return fp->f ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_close( FIL *fp )
+{
+	fclose( fp->f );
+	return FR_OK;
+}
+
+FRESULT f_read( FIL *fp, void *buff, UINT btr, UINT *br )
+{
+	*br = (UINT)fread( buff, 1, btr, fp->f );
+	nBytesRead += *br;
+	nReads ++;
+
+	if ( *br )
+	{
+		long first = fp->pos / 512, last = ( fp->pos + *br - 1 ) / 512;
+		for ( long s = first; s <= last; s++ )
+			if ( s != fp->bufSector )
+				nSectors ++;
+
+		// whole sectors go directly to the destination, a partial one at the end is kept in the buffer
+		if ( ( fp->pos + *br ) % 512 )
+			fp->bufSector = last;
+		fp->pos += *br;
+	}
+	return FR_OK;
+}
+
+FRESULT f_write( FIL *fp, const void *buff, UINT btw, UINT *bw )
+{
+	*bw = (UINT)fwrite( buff, 1, btw, fp->f );
+	return FR_OK;
+}
+
+FRESULT f_lseek( FIL *fp, FSIZE_t ofs )
+{
+	nSeeks ++;
+	fp->pos = ofs;
+	return fseek( fp->f, ofs, SEEK_SET ) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+static void resetCounters()
+{
+	nBytesRead = nSectors = nReads = nSeeks = nOpens = 0;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//
+// synthetic cartridges with random contents: 1 MB EasyFlash, 1 MB Magic Desk, 512 KB Ocean, and an EasyFlash
+// with the chips reordered (ROML of all banks first, then ROMH, which is missing in every 4th bank)
+//
+static void putBE( FILE *f, u32 v, u32 bytes )
+{
+	for ( s32 i = bytes - 1; i >= 0; i-- )
+		fputc( ( v >> ( i * 8 ) ) & 255, f );
+}
+
+static void putChip( FILE *f, u32 bank, u32 adr, u32 *seed )
+{
+	fwrite( CHIP_HEADER_SIG, 1, 4, f );
+	putBE( f, 0x2010, 4 );
+	putBE( f, 2, 2 );
+	putBE( f, bank, 2 );
+	putBE( f, adr, 2 );
+	putBE( f, 0x2000, 2 );
+	for ( u32 i = 0; i < 8192; i++ )
+	{
+		*seed = *seed * 1664525 + 1013904223;
+		fputc( *seed >> 24, f );
+	}
+}
+
+static int generateCRT( const char *type, const char *filename )
+{
+	u32 hwType, nBanks, romh = 0, reordered = 0;
+
+	if ( !strcmp( type, "ef" ) ) { hwType = 32; nBanks = 64; romh = 1; } else
+	if ( !strcmp( type, "efr" ) ) { hwType = 32; nBanks = 64; romh = 1; reordered = 1; } else
+	if ( !strcmp( type, "md" ) ) { hwType = 19; nBanks = 128; } else
+	if ( !strcmp( type, "ocean" ) ) { hwType = 5; nBanks = 64; } else
+		return 0;
+
+	FILE *f = fopen( filename, "wb" );
+	if ( !f )
+		return 0;
+
+	char name[ 32 ];
+	memset( name, 0, 32 );
+	snprintf( name, 32, "CRTLOAD TEST %s", type );
+
+	fwrite( CRT_HEADER_SIG, 1, 16, f );
+	putBE( f, 0x40, 4 );
+	putBE( f, 0x0100, 2 );
+	putBE( f, hwType, 2 );
+	fputc( romh ? 1 : 0, f );
+	fputc( 0, f );
+	for ( u32 i = 0; i < 6; i++ )
+		fputc( 0, f );
+	fwrite( name, 1, 32, f );
+
+	u32 seed = 1234;
+	if ( reordered )
+	{
+		for ( u32 b = 0; b < nBanks; b++ )
+			putChip( f, b, 0x8000, &seed );
+		for ( u32 b = 0; b < nBanks; b++ )
+			if ( ( b & 3 ) != 3 )
+				putChip( f, b, 0xa000, &seed );
+	} else
+	for ( u32 b = 0; b < nBanks; b++ )
+	{
+		putChip( f, b, 0x8000, &seed );
+		if ( romh )
+			putChip( f, b, 0xa000, &seed );
+	}
+
+	fclose( f );
+	return 1;
+}
+
+// a bank the C64 may use (resident) must have its final contents
+static u32 bankComplete( u8 bankswitchType, u32 bank )
+{
+	u32 size = ( bankswitchType == BS_EASYFLASH ) ? 16384 : 8192;
+	return !memcmp( &flashFull[ bank * size ], &flashStream[ bank * size ], size );
+}
+
+int main( int argc, char **argv )
+{
+	double rate = 10.0;
+	const char *filename = NULL;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-m" ) && i + 1 < argc )
+			rate = atof( argv[ ++i ] ); else
+		if ( !strcmp( argv[ i ], "-g" ) && i + 2 < argc )
+		{
+			if ( !generateCRT( argv[ i + 1 ], argv[ i + 2 ] ) )
+			{
+				fprintf( stderr, "cannot generate '%s' cartridge %s\n", argv[ i + 1 ], argv[ i + 2 ] );
+				return 1;
+			}
+			filename = argv[ i + 2 ];
+			i += 2;
+		} else
+			filename = argv[ i ];
+	}
+
+	if ( !filename || rate <= 0.0 )
+	{
+		fprintf( stderr, "usage: crtload [-m MB/s] file.crt\n" );
+		fprintf( stderr, "       crtload [-m MB/s] -g ef|efr|md|ocean file.crt    (writes and loads a synthetic cartridge)\n" );
+		return 1;
+	}
+
+	//
+	// as before: the whole file is read and parsed before the C64 starts
+	//
+	CRT_HEADER header;
+	u8 bankswitchType;
+	u32 ROM_LH, nBanks;
+
+	resetCounters();
+	double t0 = now();
+	readCRTFile( &logger, &header, "SD:", filename, flashFull, &bankswitchType, &ROM_LH, &nBanks );
+	double tFull = now() - t0;
+	u64 bytesFull = nBytesRead, sectorsFull = nSectors, readsFull = nReads;
+
+	//
+	// as kernel_ef.cpp with EF_FAST_START: chip by chip, the C64 starts once bank 0 is complete
+	//
+	CRT_HEADER headerS;
+	u8 bankswitchTypeS;
+	u32 ROM_LHS, nBanksS;
+	CRT_STREAM stream;
+	u8 bankResident[ 128 ];
+	s32 bank;
+	u32 nEarly = 0;
+
+	resetCounters();
+	t0 = now();
+	crtStreamOpen( &logger, &stream, &headerS, "SD:", filename, &bankswitchTypeS, &ROM_LHS, &nBanksS );
+
+	u32 fastStart = ( bankswitchTypeS == BS_EASYFLASH || bankswitchTypeS == BS_MAGICDESK || bankswitchTypeS == BS_OCEAN ) ? 1 : 0;
+	memset( bankResident, fastStart ? 0 : 1, 128 );
+
+	// as streamNextChip() in kernel_ef.cpp
+	#define STREAM_NEXT_CHIP													\
+		bank = crtStreamNextChip( &logger, &stream, flashStream, &ROM_LHS, &nBanksS );	\
+		if ( bank >= 0 && !bankResident[ bank & 127 ] && crtStreamBankComplete( &stream, bank ) )	\
+		{																		\
+			bankResident[ bank & 127 ] = 1;										\
+			if ( !bankComplete( bankswitchTypeS, bank & 127 ) )				\
+				nEarly ++;														\
+		}
+
+	u32 nBanksAtStart = 0;
+	do {
+		STREAM_NEXT_CHIP
+	} while ( bank >= 0 && ( !fastStart || !bankResident[ 0 ] ) );
+
+	crtStreamClose( &logger, &stream );
+	nBanksAtStart = nBanksS;
+
+	double tStart = now() - t0;
+	u64 bytesStart = nBytesRead, sectorsStart = nSectors, readsStart = nReads;
+
+	// the main loop reads the rest
+	while ( bank >= 0 )
+	{
+		if ( !stream.open )
+			crtStreamResume( &logger, &stream, "SD:", filename );
+		STREAM_NEXT_CHIP
+	}
+	crtStreamClose( &logger, &stream );
+
+	double tStream = now() - t0;
+	u64 bytesStream = nBytesRead, sectorsStream = nSectors, readsStream = nReads;
+
+	//
+	// results
+	//
+	u32 ok = bankswitchType == bankswitchTypeS && ROM_LH == ROM_LHS && nBanks == nBanksS &&
+			 !memcmp( flashFull, flashStream, sizeof( flashFull ) ) && !nEarly;
+
+	printf( "%s: type %d, %d banks, %s\n", filename, header.type, nBanks, fastStart ? "fast start" : "no fast start for this type (loaded completely)" );
+	if ( fastStart && nBanksAtStart != nBanks )
+		printf( "number of banks assumed at start: %d\n", nBanksAtStart );
+	printf( "\n" );
+	printf( "                            bytes read   sectors   f_read calls   host CPU   SD estimate at %.1f MB/s\n", rate );
+	printf( "whole file, C64 starts      %10llu   %7llu   %12llu   %6.2f ms   %6.1f ms\n", (unsigned long long)bytesFull, (unsigned long long)sectorsFull, (unsigned long long)readsFull, tFull * 1e3, sectorsFull * 512 / ( rate * 1048576.0 ) * 1e3 );
+	printf( "chip by chip, C64 starts    %10llu   %7llu   %12llu   %6.2f ms   %6.1f ms\n", (unsigned long long)bytesStart, (unsigned long long)sectorsStart, (unsigned long long)readsStart, tStart * 1e3, sectorsStart * 512 / ( rate * 1048576.0 ) * 1e3 );
+	printf( "chip by chip, all banks     %10llu   %7llu   %12llu   %6.2f ms   %6.1f ms\n", (unsigned long long)bytesStream, (unsigned long long)sectorsStream, (unsigned long long)readsStream, tStream * 1e3, sectorsStream * 512 / ( rate * 1048576.0 ) * 1e3 );
+	printf( "(SD estimate = sectors * 512 bytes / assumed rate, not measured: command latency and FatFs overhead are not included)\n" );
+	printf( "\n" );
+	if ( nEarly )
+		printf( "%u banks became resident before all of their chips were read\n", nEarly );
+	printf( "flash contents %s\n", ok ? "identical" : "DIFFER" );
+
+	return ok ? 0 : 2;
+}
@@ -0,0 +1,51 @@
+//
+// minimal replacement of FatFs for building crt.cpp on the host: the functions are implemented with stdio in crtload.cpp,
+// which also counts the calls and bytes read
+//
+#ifndef _fatfs_ff_h
+#define _fatfs_ff_h
+
+#include <stdio.h>
+
+typedef unsigned int	UINT;
+typedef unsigned int	FSIZE_t;
+
+typedef enum
+{
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_NO_FILE
+} FRESULT;
+
+typedef struct
+{
+	FILE *f;
+	// file position, and the sector held in the buffer of the file (FatFs reads partial sectors through it)
+	FSIZE_t pos;
+	long bufSector;
+} FIL;
+
+typedef struct
+{
+	FSIZE_t fsize;
+} FILINFO;
+
+typedef struct
+{
+	int mounted;
+} FATFS;
+
+#define FA_READ				0x01
+#define FA_WRITE			0x02
+#define FA_OPEN_EXISTING	0x00
+#define FA_CREATE_ALWAYS	0x08
+
+FRESULT f_mount( FATFS *fs, const char *path, unsigned char opt );
+FRESULT f_stat( const char *path, FILINFO *fno );
+FRESULT f_open( FIL *fp, const char *path, unsigned char mode );
+FRESULT f_close( FIL *fp );
+FRESULT f_read( FIL *fp, void *buff, UINT btr, UINT *br );
+FRESULT f_write( FIL *fp, const void *buff, UINT btw, UINT *bw );
+FRESULT f_lseek( FIL *fp, FSIZE_t ofs );
+
+#endif
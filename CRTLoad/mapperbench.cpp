@@ -0,0 +1,936 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ mapperbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - host tool: generated cartridge mapper handlers vs. the hand-written ones
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#define BUSCHAIN_HOST
+#define EF_FAST_START
+#include "crt.h"
+#include "cartmapper.h"
+#include "Vice/m93c86.h"
+
+#ifndef min
+#define min( a, b ) ( ((a)<(b))?(a):(b) )
+#endif
+#ifndef max
+#define max( a, b ) ( ((a)>(b))?(a):(b) )
+#endif
+
+//
+// replay bus: the signals come from a trace instead of the GPIOs, GPIO and latch outputs are recorded
+//
+typedef struct
+{
+	u32 g2, g3, data;
+} BUS_TRACE;
+
+class CBusReplay : public CBusCycle
+{
+public:
+	const BUS_TRACE *cur;
+	s32 out;
+	u32 gpio, latch;
+
+	inline void start()							{ g2 = cur->g2; }
+	inline void readRest()						{ g3 = cur->g3; }
+	inline void put( u32 D )					{ out = D & 255; }
+	inline u32  get()							{ return cur->data; }
+	inline void finish()						{}
+	inline void finishLatch()					{}
+	inline void setClr( u32 set, u32 clr )		{ gpio = ( gpio | set ) & ~clr; }
+	inline void set( u32 set )					{ gpio |= set; }
+	inline void clr( u32 clr )					{ gpio &= ~clr; }
+	inline void setLED( u32 f )					{ latch |= f; }
+	inline void clrLED( u32 f )					{ latch &= ~f; }
+	inline void waitTriggerDMA()				{}
+	inline void waitReleaseDMA()				{}
+	inline void preloadL1( const void *p )		{ __builtin_prefetch( p ); }
+	inline void preloadL2( const void *p )		{ __builtin_prefetch( p ); }
+	inline void preloadL2Strm( const void *p )	{ __builtin_prefetch( p ); }
+	inline void preloadBank( const void *p )	{ for ( u32 i = 0; i < 8192; i += 64 ) __builtin_prefetch( (const u8 *)p + i ); }
+};
+
+static CBusReplay bus;
+
+//
+// the members of EFSTATE (kernel_ef.cpp) used by the mappers
+//
+typedef struct
+{
+	u32 nBanks;
+	u8	bankswitchType;
+	u8	*flashBank;
+	u8	*flash_cacheoptimized;
+	u8  reg0, reg2;
+	u32 resetCounter, resetCounter2;
+	u64 c64CycleCount;
+	u32 releaseDMA;
+	u8  bankResident[ 128 ];
+	u32 bankMissing;
+	u32 mainloopCount;
+	s32 eeprom_cs, eeprom_data, eeprom_clock;
+	u32 triggerDMA, dmaCountWrites;
+	u32 hasKernal;
+} MAPPER_STATE;
+
+static MAPPER_STATE ef, efGen;		// hand-written and generated handlers
+
+static u8 flash[ 1024 * 1024 + 8 * 1024 ];
+
+//
+// M93C86 stand-in: a deterministic function of the signals, two instances (hand-written/generated handler)
+//
+typedef struct
+{
+	u32 select, clock, data, shift;
+} EEPROM_MODEL;
+
+static EEPROM_MODEL eepromModel[ 2 ], *eeprom;
+
+int m93c86_addr = 0;
+uint8_t m93c86_data[ M93C86_SIZE ];
+
+uint8_t m93c86_read_data()				{ return ( eeprom->shift >> 7 ) & 1; }
+void m93c86_write_data( uint8_t v )		{ eeprom->data = v; }
+void m93c86_write_select( uint8_t v )	{ eeprom->select = v; if ( !v ) eeprom->shift = 0; }
+void m93c86_write_clock( uint8_t v )
+{
+	if ( v && !eeprom->clock )
+		eeprom->shift = ( eeprom->shift << 1 ) | eeprom->data | ( ( eeprom->shift >> 5 ) & 1 );
+	eeprom->clock = v;
+}
+
+// the GMOD2 EEPROM for the generated handler, as CGMOD2EEPROM in kernel_ef.cpp
+class CGMOD2EEPROMReplay : public CCartNoHooks
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b )
+	{
+		__builtin_prefetch( &m93c86_data[ m93c86_addr * 2 ] );
+		efGen.mainloopCount = 0;
+	}
+
+	template <class BUS> static inline u32 regRead( BUS &b )
+	{
+		return efGen.eeprom_cs ? m93c86_read_data() << 7 : 0;
+	}
+
+	template <class BUS> static inline void regWrite( BUS &b, u32 D )
+	{
+		efGen.eeprom_cs = ( D >> 6 ) & 1;
+		efGen.eeprom_data = ( D >> 4 ) & 1;
+		efGen.eeprom_clock = ( D >> 5 ) & 1;
+		m93c86_write_select( (uint8_t)efGen.eeprom_cs );
+		if ( efGen.eeprom_cs )
+		{
+			m93c86_write_data( (uint8_t)( efGen.eeprom_data ) );
+			m93c86_write_clock( (uint8_t)( efGen.eeprom_clock ) );
+		}
+	}
+};
+
+//
+// the hand-written handlers as they were in kernel_ef.cpp, the GPIO/latch macros of helpers.h work on the replay bus
+//
+#define START_AND_READ_ADDR0to7_RW_RESET_CS		u32 g2, g3; bus.start(); g2 = bus.g2;
+#define WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA	bus.readRest(); g3 = bus.g3;
+#define UPDATE_COUNTERS_MIN( c64CycleCount, resetCounter ) \
+	c64CycleCount ++; if ( !( g2 & bRESET ) ) { resetCounter ++; } else { resetCounter = 0; }
+#define WRITE_D0to7_TO_BUS( D )					bus.put( D );
+#define READ_D0to7_FROM_BUS( D )				D = bus.get();
+#define SET_GPIO( s )							bus.set( s );
+#define CLR_GPIO( c )							bus.clr( c );
+#define SETCLR_GPIO( s, c )						bus.setClr( s, c );
+#define FINISH_BUS_HANDLING						bus.finish();
+#define OUTPUT_LATCH_AND_FINISH_BUS_HANDLING	bus.finishLatch();
+#define setLatchFIQ( f )						bus.setLED( f )
+#define clrLatchFIQ( f )						bus.clrLED( f )
+#define WAIT_UP_TO_CYCLE( c )
+#define CACHE_PRELOADL2STRM( p )				__builtin_prefetch( p );
+#define CACHE_PRELOADL2STRMW( p )				__builtin_prefetch( p, 1 );
+#define CACHE_PRELOAD_DATA_CACHE( p, size, F )	bus.preloadBank( p );
+
+#define IO1_ACCESS			(!(g3 & bIO1))
+#define IO2_ACCESS			(!(g3 & bIO2))
+#define ROML_ACCESS			(!(g3 & bROML))
+#define ROMH_ACCESS			(!(g3 & bROMH))
+#define ROML_OR_ROMH_ACCESS (ROML_ACCESS||ROMH_ACCESS)
+#define GET_IO12_ADDRESS	 ((g2>>A0)&255)
+#define GET_ADDRESS0to7		 ((g2>>A0)&255)
+#define GET_ADDRESS8to12	 ((g3>>A8)&31)
+#define GET_ADDRESS			 (GET_ADDRESS0to7|(GET_ADDRESS8to12<<8))
+#define GET_ADDRESS_CACHEOPT ((GET_ADDRESS0to7<<5)|GET_ADDRESS8to12)
+#define KERNAL_ACCESS		(!(g3&bCS))
+#define CPU_RESET			(!(g2&bRESET))
+#define CPU_READS_FROM_BUS	(g2&bRW)
+#define CPU_WRITES_TO_BUS	(!(g2&bRW))
+
+#define TRIGGER_CAN_ASSERT_DMA ( ef.dmaCountWrites == 3 ? true : false )
+#define TRIGGER_DMA_COUNT_WRITES { 	if ( CPU_WRITES_TO_BUS ) ef.dmaCountWrites ++; else ef.dmaCountWrites = 0; }
+#define TRIGGER_DMA( cycles ) { ef.triggerDMA = cycles; }
+#define	HANDLE_DMA_TRIGGER_RELEASE \
+	if ( ef.triggerDMA ) {							\
+		ef.releaseDMA = ef.triggerDMA;				\
+		ef.triggerDMA = 0;							\
+		WAIT_UP_TO_CYCLE( WAIT_TRIGGER_DMA );		\
+		CLR_GPIO( bDMA );							\
+		setLatchFIQ( LATCH_LED0 );					\
+	} else											\
+	if ( ef.releaseDMA > 0 && --ef.releaseDMA == 0 )\
+	{												\
+		WAIT_UP_TO_CYCLE( WAIT_RELEASE_DMA );		\
+		SET_GPIO( bDMA );							\
+		clrLatchFIQ( LATCH_LED0 );					\
+	}	
+
+
+#ifdef EF_FAST_START
+// the C64 switched to a bank which is not loaded yet => stall it (DMA) until the main loop has read the bank
+#define STALL_IF_BANK_MISSING							\
+	if ( !ef.bankResident[ ef.reg0 ] ) {				\
+		if ( ef.releaseDMA == 0 ) {						\
+			WAIT_UP_TO_CYCLE( WAIT_TRIGGER_DMA );		\
+			CLR_GPIO( bDMA );							\
+		}												\
+		ef.releaseDMA = 0;								\
+		ef.bankMissing = 1;								\
+	}
+#define BANK_ARRIVED ( ef.bankMissing && ef.bankResident[ ef.reg0 ] )
+#else
+#define STALL_IF_BANK_MISSING
+#define BANK_ARRIVED 0
+#endif
+
+#define HANDLE_KERNAL_IF_REQUIRED \
+	if ( ef.hasKernal && ROMH_ACCESS && KERNAL_ACCESS ) {	\
+		WRITE_D0to7_TO_BUS( kernalROM[ GET_ADDRESS ] );		\
+		FINISH_BUS_HANDLING									\
+		return;												\
+	}
+
+
+//#ifdef COMPILE_MENU
+#if 1
+static void KernelEFFIQHandler_Prophet( void *pParam )
+{
+	register u32 D, addr;
+
+	START_AND_READ_ADDR0to7_RW_RESET_CS
+
+	addr = GET_ADDRESS0to7 << 5;
+	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
+
+	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
+
+	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
+
+	addr = GET_ADDRESS_CACHEOPT;
+
+	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
+	{
+		D = ef.flashBank[ addr ];
+		WRITE_D0to7_TO_BUS( D )
+	} else
+	if ( CPU_WRITES_TO_BUS && IO2_ACCESS && GET_IO12_ADDRESS == 0 )
+	{
+		READ_D0to7_FROM_BUS( D )
+		setLatchFIQ( LATCH_LED0 );
+
+		if ( ( D >> 5 ) & 1 )
+		{ // cartridge off 
+			SET_GPIO( bGAME | bEXROM );
+		} else
+		{ // cartridge on
+			SETCLR_GPIO( bGAME, bEXROM );
+		}
+
+		ef.reg0 = D & 0x1f;
+		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+	} 
+		
+	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	
+	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
+	{
+		ef.resetCounter = 0x8000000;
+		ef.releaseDMA = 0;
+		ef.reg0 = 0;
+		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		SETCLR_GPIO( bGAME | bDMA | bNMI, bEXROM );
+		FINISH_BUS_HANDLING
+		return;
+	}
+
+	//CLEAR_LEDS_EVERY_8K_CYCLES
+	static u32 cycleCount = 0;
+	if ( !((++cycleCount)&8191) )
+		clrLatchFIQ( LATCH_LED0 );
+
+	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
+}
+#endif
+
+
+static volatile u32 forceRead; 
+
+static void KernelEFFIQHandler_GMOD2( void *pParam )
+{
+	register u32 D, addr;
+
+	START_AND_READ_ADDR0to7_RW_RESET_CS
+
+	addr = GET_ADDRESS0to7 << 5;
+	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
+
+	extern int m93c86_addr;
+	extern uint8_t m93c86_data[M93C86_SIZE];
+	CACHE_PRELOADL2STRMW( &m93c86_data[ m93c86_addr * 2 ] );
+
+	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
+
+	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
+
+	ef.mainloopCount = 0;
+
+	TRIGGER_DMA_COUNT_WRITES
+
+	addr = GET_ADDRESS_CACHEOPT;
+	
+
+	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
+	{
+		D = ef.flashBank[ addr ];
+		WRITE_D0to7_TO_BUS( D )
+	} else
+	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
+	{
+		if (ef.eeprom_cs) {
+			D = m93c86_read_data() << 7;
+			WRITE_D0to7_TO_BUS( D )
+		} else
+			WRITE_D0to7_TO_BUS( 0 )
+	} else
+	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	{
+		READ_D0to7_FROM_BUS( D )
+
+		if ( ( D & 0xc0 ) == 0xc0 ) {
+			SETCLR_GPIO( bEXROM, bGAME ); 
+		} else if ( ( D & 0x40 ) == 0x00 ) {
+			SETCLR_GPIO( bGAME, bEXROM ); 
+		} else if ( ( D & 0x40 ) == 0x40 ) {
+			SET_GPIO( bGAME | bEXROM ); 
+		}
+		ef.eeprom_cs = ( D >> 6 ) & 1;
+		ef.eeprom_data = ( D >> 4 ) & 1;
+		ef.eeprom_clock = ( D >> 5 ) & 1;
+		m93c86_write_select( (uint8_t)ef.eeprom_cs );
+		if ( ef.eeprom_cs ) {
+			m93c86_write_data( (uint8_t)( ef.eeprom_data ) );
+			m93c86_write_clock( (uint8_t)( ef.eeprom_clock ) );
+		}
+
+		if ( ef.reg0 != (D & 0x3f) )
+		{
+			ef.reg0 = D & 0x3f;
+			ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
+			CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		}
+	} 
+
+
+	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	
+	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
+	{
+		ef.resetCounter = 0x8000000;
+		ef.releaseDMA = 0;
+		ef.reg0 = 0;
+		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		SETCLR_GPIO( bGAME | bDMA | bNMI, bEXROM );
+		FINISH_BUS_HANDLING
+		return;
+	}
+
+	HANDLE_DMA_TRIGGER_RELEASE
+
+	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
+}
+
+static void KernelEFFIQHandler_Ocean( void *pParam )
+{
+	register u32 D, addr;
+
+	START_AND_READ_ADDR0to7_RW_RESET_CS
+
+	addr = GET_ADDRESS0to7 << 5;
+	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
+
+	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
+
+	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
+
+	addr = GET_ADDRESS_CACHEOPT;
+
+	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
+	{
+		D = ef.flashBank[ addr ];
+		WRITE_D0to7_TO_BUS( D )
+	} 
+	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	{
+		READ_D0to7_FROM_BUS( D )
+		setLatchFIQ( LATCH_LED0 );
+		ef.reg0 = D & 0x3f;
+		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		STALL_IF_BANK_MISSING
+	} 
+
+	if ( BANK_ARRIVED )
+	{
+		ef.bankMissing = 0;
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		WAIT_UP_TO_CYCLE( WAIT_RELEASE_DMA ); 
+		SET_GPIO( bDMA ); 
+	}
+
+	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	
+	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
+	{
+		ef.resetCounter = 0x8000000;
+		ef.releaseDMA = 0;
+		ef.bankMissing = 0;
+		ef.reg0 = 0;
+		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		if ( ef.nBanks > 32 )
+			{SETCLR_GPIO( bDMA | bNMI | bGAME, bEXROM );} else
+			{SETCLR_GPIO( bDMA | bNMI, bEXROM | bGAME );} 
+		FINISH_BUS_HANDLING
+		return;
+	}
+
+	//CLEAR_LEDS_EVERY_8K_CYCLES
+	static u32 cycleCount = 0;
+	if ( !((++cycleCount)&8191) )
+		clrLatchFIQ( LATCH_LED0 );
+
+	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
+}
+
+static void KernelEFFIQHandler_RGCD( void *pParam )
+{
+	register u32 D, addr;
+
+	START_AND_READ_ADDR0to7_RW_RESET_CS
+
+	addr = GET_ADDRESS0to7 << 5;
+	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
+
+	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
+
+	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
+
+	addr = GET_ADDRESS_CACHEOPT;
+
+	if ( CPU_READS_FROM_BUS && ROML_ACCESS && !ef.reg2 )
+	{
+		D = ef.flashBank[ addr ];
+		WRITE_D0to7_TO_BUS( D )
+	} 
+
+	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	{
+		READ_D0to7_FROM_BUS( D )
+		setLatchFIQ( LATCH_LED0 );
+		if ( D & 8 )
+		{
+			ef.reg2 = 1;
+			SET_GPIO( bDMA | bNMI | bGAME | bEXROM );
+		}
+		D &= 7;
+		if ( ef.bankswitchType == BS_HUCKY )
+			ef.reg0 = (D ^ 7) & (ef.nBanks - 1); else
+			ef.reg0 = D & (ef.nBanks - 1); 
+		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+	} 
+
+	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	
+	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
+	{
+		ef.resetCounter = 0x8000000;
+		ef.releaseDMA = 0;
+		ef.reg0 = ef.reg2 = 0;
+		if ( ef.bankswitchType == BS_HUCKY )
+			ef.reg0 = 7 & (ef.nBanks - 1);
+		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		SETCLR_GPIO( bDMA | bNMI | bGAME, bEXROM );
+		FINISH_BUS_HANDLING
+		return;
+	}
+
+	//CLEAR_LEDS_EVERY_8K_CYCLES
+	static u32 cycleCount = 0;
+	if ( !((++cycleCount)&8191) )
+		clrLatchFIQ( LATCH_LED0 );
+
+	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
+}
+
+
+static void KernelEFFIQHandler_C64GS( void *pParam )
+{
+	register u32 D, addr;
+
+	START_AND_READ_ADDR0to7_RW_RESET_CS
+
+	addr = GET_ADDRESS0to7 << 5;
+	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
+
+	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
+
+	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
+
+
+	addr = GET_ADDRESS_CACHEOPT;
+
+	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
+	{
+		D = ef.flashBank[ addr ];
+		WRITE_D0to7_TO_BUS( D )
+	} else
+
+	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
+	{
+		setLatchFIQ( LATCH_LED0 | LATCH_LED1 );
+		ef.reg0 = 0;
+		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+	} else
+
+	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	{
+		READ_D0to7_FROM_BUS( D )
+		setLatchFIQ( LATCH_LED0 | LATCH_LED1 );
+		ef.reg0 = GET_IO12_ADDRESS & 0x3f;
+		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
+		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+	} 
+
+	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	
+	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
+	{
+		ef.resetCounter = 0x8000000;
+		ef.releaseDMA = 0;
+		ef.reg0 = 0;
+		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
+		clrLatchFIQ( LATCH_LED1 );
+		SETCLR_GPIO( bGAME | bDMA | bNMI, bEXROM );
+		FINISH_BUS_HANDLING
+		return;
+	}
+
+	if ( ef.releaseDMA > 0 && --ef.releaseDMA == 0 )
+	{
+		WAIT_UP_TO_CYCLE( WAIT_RELEASE_DMA ); 
+		SET_GPIO( bDMA ); 
+		clrLatchFIQ( LATCH_LED1 );
+	}
+
+	//CLEAR_LEDS_EVERY_8K_CYCLES
+	static u32 cycleCount = 0;
+	if ( !((++cycleCount)&8191) )
+		clrLatchFIQ( LATCH_LED0 );
+
+	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
+}
+
+
+
+static void KernelEFFIQHandler_Comal80( void *pParam )
+{
+	register u32 D, addr;
+	register u8 *flashBankR = ef.flashBank;
+
+	START_AND_READ_ADDR0to7_RW_RESET_CS
+
+	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
+
+	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
+
+	addr = GET_ADDRESS_CACHEOPT;
+
+	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
+	{
+		D = *(u32*)&flashBankR[ addr * 2 ];
+		if ( ROMH_ACCESS )
+			D >>= 8; 
+
+		WRITE_D0to7_TO_BUS( D )
+	} else
+
+	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
+	{
+		WRITE_D0to7_TO_BUS( ef.reg2 )
+	} else
+
+	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	{
+		READ_D0to7_FROM_BUS( D )
+
+		ef.reg2 = D & 0xc7;
+		ef.reg0 = D & 3;
+		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 * 2 ];
+
+		if ( D & 0x40 )
+			{SET_GPIO( bEXROM | bGAME );} else
+			{CLR_GPIO( bEXROM | bGAME );}
+	}
+
+
+	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	
+	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
+	{
+		ef.resetCounter = 0x8000000;
+		SET_GPIO( bDMA | bNMI ); 
+		FINISH_BUS_HANDLING
+		return;
+	}
+
+	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
+}
+
+
+
+//
+// the mappers: hand-written and generated handler, and the setup of KernelEFRun/initEF
+//
+template <const CART_MAPPER &M, class HOOKS = CCartNoHooks>
+static void generated( void *pParam )
+{
+	// a local bus object as CBusFIQ in cartMapperFIQ (the signals stay in registers)
+	CBusReplay b;
+	b.cur = bus.cur;
+	b.out = bus.out;
+	b.gpio = bus.gpio;
+	b.latch = bus.latch;
+
+	cartMapperCycle< M, MAPPER_STATE, &efGen, HOOKS >( b );
+
+	bus.out = b.out;
+	bus.gpio = b.gpio;
+	bus.latch = b.latch;
+}
+
+typedef struct
+{
+	const char *name;
+	u8  bankswitchType;
+	u32 nBanks;
+	void (*handWritten)( void * );
+	void (*generated)( void * );
+	u32 gpioSet, gpioClr;
+} MAPPER;
+
+static const MAPPER mappers[] = {
+	{ "Ocean 128k",		BS_OCEAN,		16, KernelEFFIQHandler_Ocean,		generated< mapperOcean >,		bDMA | bNMI,		 bEXROM | bGAME },
+	{ "Ocean 512k",		BS_OCEAN,		64, KernelEFFIQHandler_Ocean,		generated< mapperOcean >,		bDMA | bNMI | bGAME, bEXROM },
+	{ "Prophet 64",		BS_PROPHET,		32, KernelEFFIQHandler_Prophet,		generated< mapperProphet >,		bDMA | bNMI | bGAME, bEXROM },
+	{ "RGCD",			BS_RGCD,		 8, KernelEFFIQHandler_RGCD,		generated< mapperRGCD >,		bDMA | bNMI | bGAME, bEXROM },
+	{ "Hucky",			BS_HUCKY,		 8, KernelEFFIQHandler_RGCD,		generated< mapperHucky >,		bDMA | bNMI | bGAME, bEXROM },
+	{ "GMOD2",			BS_GMOD2,		64, KernelEFFIQHandler_GMOD2,		generated< mapperGMOD2, CGMOD2EEPROMReplay >, bDMA | bNMI | bGAME, bEXROM },
+	{ "C64GS",			BS_C64GS,		64, KernelEFFIQHandler_C64GS,		generated< mapperC64GS >,		bDMA | bNMI | bGAME, bEXROM },
+	{ "Comal 80",		BS_COMAL80,		 4, KernelEFFIQHandler_Comal80,		generated< mapperComal80 >,		bDMA | bNMI,		 bEXROM | bGAME },
+};
+
+#define N_MAPPERS ( sizeof( mappers ) / sizeof( MAPPER ) )
+
+static void initState( MAPPER_STATE *s, const MAPPER *m )
+{
+	memset( s, 0, sizeof( MAPPER_STATE ) );
+	s->nBanks = m->nBanks;
+	s->bankswitchType = m->bankswitchType;
+	s->flash_cacheoptimized = flash;
+	s->flashBank = flash;
+	if ( m->bankswitchType == BS_RGCD || m->bankswitchType == BS_HUCKY )
+		s->reg0 = 7;
+
+	// fast start: only bank 0 is loaded when the C64 starts
+	memset( s->bankResident, m->bankswitchType == BS_OCEAN ? 0 : 1, 128 );
+	s->bankResident[ 0 ] = 1;
+}
+
+//
+// traces
+//
+#define AREA_NONE	0
+#define AREA_ROML	1
+#define AREA_ROMH	2
+#define AREA_IO1	3
+#define AREA_IO2	4
+
+static BUS_TRACE busCycle( u32 area, u32 addr, u32 write, u32 data, u32 reset )
+{
+	BUS_TRACE t;
+
+	t.g2 = ( ( addr & 255 ) << A0 ) | bCS | ( write ? 0 : bRW ) | ( reset ? 0 : bRESET );
+	t.g3 = ( ( ( addr >> 8 ) & 31 ) << A8 ) | bIO1 | bIO2 | bROML | bROMH | bCS | bBA;
+	t.data = data & 255;
+
+	switch ( area )
+	{
+	case AREA_ROML: t.g3 &= ~bROML; break;
+	case AREA_ROMH: t.g3 &= ~bROMH; break;
+	case AREA_IO1:  t.g3 &= ~bIO1; break;
+	case AREA_IO2:  t.g3 &= ~bIO2; break;
+	}
+	return t;
+}
+
+// random accesses to all areas (the register addresses are likely) with resets of 1-8 cycles in between
+static void mixedTrace( BUS_TRACE *t, u32 n )
+{
+	u32 reset = 0;
+
+	for ( u32 i = 0; i < n; i++ )
+	{
+		u32 r = rand() % 100, area, write = 0;
+
+		if ( r < 35 ) area = AREA_ROML; else
+		if ( r < 50 ) area = AREA_ROMH; else
+		if ( r < 60 ) area = AREA_IO1; else
+		if ( r < 70 ) { area = AREA_IO1; write = 1; } else
+		if ( r < 75 ) area = AREA_IO2; else
+		if ( r < 80 ) { area = AREA_IO2; write = 1; } else
+		{ area = AREA_NONE; write = r < 90; }
+
+		u32 addr = rand() & 0x1fff;
+		if ( area == AREA_IO1 || area == AREA_IO2 )
+		{
+			r = rand() % 4;
+			addr = r < 2 ? 0 : ( r < 3 ? rand() & 15 : rand() & 255 );
+		}
+
+		if ( reset == 0 && rand() % 20000 == 0 )
+			reset = 1 + rand() % 8;
+
+		t[ i ] = busCycle( area, addr, write, rand(), reset );
+		if ( reset ) reset --;
+	}
+}
+
+// a running program: reads from ROML/ROMH, now and then a bank switch
+static void romTrace( BUS_TRACE *t, u32 n )
+{
+	for ( u32 i = 0; i < n; i++ )
+	{
+		if ( rand() % 500 == 0 )
+			t[ i ] = busCycle( AREA_IO1, 0, 1, rand() & 3, 0 ); else
+			t[ i ] = busCycle( ( rand() & 3 ) ? AREA_ROML : AREA_ROMH, rand() & 0x1fff, 0, 0, 0 );
+	}
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// the handlers turn off LED0 every 8192 cycles (with a static counter): run idle cycles until this happens
+static void syncLEDCounter( const MAPPER *m, void (*handler)( void * ) )
+{
+	BUS_TRACE idle = busCycle( AREA_NONE, 0, 0, 0, 0 );
+
+	initState( &ef, m );
+	initState( &efGen, m );
+	eeprom = &eepromModel[ 0 ];
+
+	for ( u32 i = 0; i < 8192; i++ )
+	{
+		bus.cur = &idle;
+		bus.latch = LATCH_LED0;
+		handler( NULL );
+		if ( !( bus.latch & LATCH_LED0 ) )
+			break;
+	}
+}
+
+//
+// replays a trace through both handlers side by side, returns the number of cycles which differ
+//
+static u32 compare( const MAPPER *m, const BUS_TRACE *t, u32 n )
+{
+	u32 gpio[ 2 ], latch[ 2 ] = { 0, 0 }, nDiff = 0;
+
+	syncLEDCounter( m, m->handWritten );
+	syncLEDCounter( m, m->generated );
+
+	initState( &ef, m );
+	initState( &efGen, m );
+	memset( eepromModel, 0, sizeof( eepromModel ) );
+	gpio[ 0 ] = gpio[ 1 ] = m->gpioSet;
+
+	for ( u32 i = 0; i < n; i++ )
+	{
+		// the main loop loads the remaining banks
+		if ( i % 3000 == 0 )
+			ef.bankResident[ ( i / 3000 ) & 127 ] = efGen.bankResident[ ( i / 3000 ) & 127 ] = 1;
+
+		s32 out[ 2 ];
+		for ( u32 h = 0; h < 2; h++ )
+		{
+			bus.cur = &t[ i ];
+			bus.out = -1;
+			bus.gpio = gpio[ h ];
+			bus.latch = latch[ h ];
+			eeprom = &eepromModel[ h ];
+			if ( h == 0 )
+				m->handWritten( NULL ); else
+				m->generated( NULL );
+			out[ h ] = bus.out;
+			gpio[ h ] = bus.gpio;
+			latch[ h ] = bus.latch;
+		}
+
+		if ( out[ 0 ] != out[ 1 ] || gpio[ 0 ] != gpio[ 1 ] || latch[ 0 ] != latch[ 1 ] ||
+			 ef.reg0 != efGen.reg0 || ef.reg2 != efGen.reg2 || ef.flashBank != efGen.flashBank ||
+			 ef.releaseDMA != efGen.releaseDMA || ef.bankMissing != efGen.bankMissing ||
+			 ef.resetCounter != efGen.resetCounter ||
+			 memcmp( &eepromModel[ 0 ], &eepromModel[ 1 ], sizeof( EEPROM_MODEL ) ) )
+		{
+			if ( nDiff ++ < 5 )
+				printf( "  %s, cycle %u (g2 %08x g3 %08x): out %d/%d, gpio %08x/%08x, latch %08x/%08x, bank %d/%d, reg2 %d/%d\n",
+					m->name, i, t[ i ].g2, t[ i ].g3, out[ 0 ], out[ 1 ], gpio[ 0 ], gpio[ 1 ], latch[ 0 ], latch[ 1 ],
+					ef.reg0, efGen.reg0, ef.reg2, efGen.reg2 );
+
+			// continue from the state of the hand-written handler
+			memcpy( &efGen, &ef, sizeof( MAPPER_STATE ) );
+			gpio[ 1 ] = gpio[ 0 ];
+			latch[ 1 ] = latch[ 0 ];
+			eepromModel[ 1 ] = eepromModel[ 0 ];
+		}
+	}
+
+	return nDiff;
+}
+
+// host time per cycle in ns
+static double timing( const MAPPER *m, void (*handler)( void * ), const BUS_TRACE *t, u32 n, u32 repeat )
+{
+	double best = 1e30;
+
+	for ( u32 r = 0; r < repeat; r++ )
+	{
+		initState( &ef, m );
+		initState( &efGen, m );
+		memset( ef.bankResident, 1, 128 );
+		memset( efGen.bankResident, 1, 128 );
+		eeprom = &eepromModel[ 0 ];
+
+		double t0 = now();
+		for ( u32 i = 0; i < n; i++ )
+		{
+			bus.cur = &t[ i ];
+			handler( NULL );
+		}
+		best = min( best, ( now() - t0 ) / n * 1e9 );
+	}
+	return best;
+}
+
+int main( int argc, char **argv )
+{
+	u32 n = 2000000, repeat = 5;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			n = atoi( argv[ ++i ] ); else
+		if ( !strcmp( argv[ i ], "-r" ) && i + 1 < argc )
+		{
+			repeat = atoi( argv[ ++i ] );
+			repeat = max( 1, repeat );
+		} else
+		{
+			fprintf( stderr, "usage: mapperbench [-n cycles] [-r repeat]\n" );
+			return 1;
+		}
+	}
+	n = max( 1000, n );
+
+	srand( 1 );
+	for ( u32 i = 0; i < sizeof( flash ); i++ )
+		flash[ i ] = rand();
+
+	BUS_TRACE *mixed = new BUS_TRACE[ n ];
+	BUS_TRACE *rom = new BUS_TRACE[ n ];
+	mixedTrace( mixed, n );
+	romTrace( rom, n );
+
+	printf( "%u cycles per trace, host time in ns per cycle (best of %u)\n\n", n, repeat );
+	printf( "                                  mixed accesses           ROM reads\n" );
+	printf( "mapper            differences   hand-written generated   hand-written generated\n" );
+
+	u32 nDiff = 0;
+	for ( u32 i = 0; i < N_MAPPERS; i++ )
+	{
+		const MAPPER *m = &mappers[ i ];
+		u32 d = compare( m, mixed, n );
+		nDiff += d;
+
+		double hm = timing( m, m->handWritten, mixed, n, repeat );
+		double gm = timing( m, m->generated, mixed, n, repeat );
+		double hr = timing( m, m->handWritten, rom, n, repeat );
+		double gr = timing( m, m->generated, rom, n, repeat );
+
+		printf( "%-16s  %11u   %12.2f %9.2f   %12.2f %9.2f\n", m->name, d, hm, gm, hr, gr );
+	}
+
+	printf( "\n%s\n", nDiff ? "the generated handlers DIFFER" : "the generated handlers behave as the hand-written ones" );
+
+	delete[] mixed;
+	delete[] rom;
+
+	return nDiff ? 2 : 0;
+}
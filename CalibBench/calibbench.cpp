@@ -0,0 +1,339 @@
+//
+// calibbench: drives the pass window search and the calibration state machine of ../calibration.cpp
+// with a synthetic bus model (see readme.txt)
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "calibration.h"
+
+//
+// what lowlevel_arm64.cpp and config.cpp provide on the RPi
+//
+u32 WAIT_FOR_SIGNALS = 40;
+u32 WAIT_CYCLE_MULTIPLEXER = 200;
+u32 WAIT_CYCLE_READ = 475;
+u32 WAIT_CYCLE_WRITEDATA = 470;
+u32 WAIT_CYCLE_READ_BADLINE = 400;
+u32 WAIT_CYCLE_READ_VIC2 = 445;
+u32 WAIT_CYCLE_WRITEDATA_VIC2 = 505;
+u32 WAIT_CYCLE_MULTIPLEXER_VIC2 = 265;
+u32 WAIT_TRIGGER_DMA = 600;
+u32 WAIT_RELEASE_DMA = 600;
+
+u32 modeC128 = 0;
+u32 modeVIC = 0;
+
+int  nTimingProfiles = 0;
+char timingProfileName[ MAX_TIMING_PROFILES ][ 32 ];
+int  timingProfileValues[ MAX_TIMING_PROFILES ][ TIMING_NAMES ];
+int  timingProfileWindow[ MAX_TIMING_PROFILES ][ TIMING_NAMES ][ 2 ];
+int  timingValues[ TIMING_NAMES ] = { 40, 475, 470, 400, 445, 505, 200, 265, 600, 600 };
+
+int getTimingProfile( const char *name, int create )
+{
+	for ( int i = 0; i < nTimingProfiles; i++ )
+		if ( strcmp( timingProfileName[ i ], name ) == 0 )
+			return i;
+
+	if ( !create || nTimingProfiles >= MAX_TIMING_PROFILES )
+		return -1;
+
+	int p = nTimingProfiles ++;
+	memset( timingProfileName[ p ], 0, 32 );
+	strncpy( timingProfileName[ p ], name, 31 );
+	memcpy( timingProfileValues[ p ], timingValues, sizeof( int ) * TIMING_NAMES );
+	for ( int i = 0; i < TIMING_NAMES; i++ )
+		timingProfileWindow[ p ][ i ][ 0 ] = timingProfileWindow[ p ][ i ][ 1 ] = -1;
+	return p;
+}
+
+void applyTimingValues( int *v )
+{
+	WAIT_FOR_SIGNALS = v[ 0 ];
+	WAIT_CYCLE_READ = v[ 1 ];
+	WAIT_CYCLE_WRITEDATA = v[ 2 ];
+	WAIT_CYCLE_READ_BADLINE = v[ 3 ];
+	WAIT_CYCLE_READ_VIC2 = v[ 4 ];
+	WAIT_CYCLE_WRITEDATA_VIC2 = v[ 5 ];
+	WAIT_CYCLE_MULTIPLEXER = v[ 6 ];
+	WAIT_CYCLE_MULTIPLEXER_VIC2 = v[ 7 ];
+	WAIT_TRIGGER_DMA = v[ 8 ];
+	WAIT_RELEASE_DMA = v[ 9 ];
+}
+
+static u32 rngState = 12345;
+
+static u32 rng()
+{
+	rngState = rngState * 1664525 + 1013904223;
+	return rngState >> 8;
+}
+
+//
+// the expected result of a sweep: the values start +/- k * step which lie inside the window and the limits
+//
+static void expectedWindow( s32 start, s32 step, s32 limitLo, s32 limitHi, s32 lo, s32 hi, s32 *eLo, s32 *eHi )
+{
+	*eLo = *eHi = -1;
+	if ( start < lo || start > hi || start < limitLo || start > limitHi )
+		return;
+
+	*eLo = *eHi = start;
+	while ( *eHi + step <= hi && *eHi + step <= limitHi )
+		*eHi += step;
+	while ( *eLo - step >= lo && *eLo - step >= limitLo )
+		*eLo -= step;
+}
+
+//
+// part 1: the sweep on its own, a value passes if it is inside [lo, hi]
+//
+typedef struct
+{
+	const char *name;
+	s32 start, step, limitLo, limitHi;
+	s32 lo, hi;
+} SWEEP_CASE;
+
+static const SWEEP_CASE sweepCases[] = {
+	{ "centered",              475, 5, 150, 800,  400,  560 },
+	{ "start at lower edge",   475, 5, 150, 800,  475,  600 },
+	{ "start at upper edge",   475, 5, 150, 800,  380,  475 },
+	{ "clipped by upper limit",600, 5, 150, 800,  420,  900 },
+	{ "clipped by lower limit",200, 5, 150, 800,  100,  300 },
+	{ "clipped by both limits",400, 5, 150, 800,    0, 1000 },
+	{ "single value",          475, 5, 150, 800,  473,  477 },
+	{ "start at limitHi",      800, 5, 150, 800,  700,  900 },
+	{ "start at limitLo",      150, 5, 150, 800,  100,  200 },
+	{ "no pass (start above)", 475, 5, 150, 800,  300,  470 },
+	{ "no pass (start below)", 475, 5, 150, 800,  480,  600 },
+	{ "no pass (empty)",       475, 5, 150, 800,  600,  500 },
+};
+
+static u32 runSweepCases()
+{
+	u32 failed = 0;
+
+	printf( "sweep:\n" );
+	for ( u32 c = 0; c < sizeof( sweepCases ) / sizeof( sweepCases[ 0 ] ); c++ )
+	{
+		const SWEEP_CASE *sc = &sweepCases[ c ];
+
+		TIMING_SWEEP s;
+		sweepBegin( &s, sc->start, sc->step, sc->limitLo, sc->limitHi );
+
+		u32 probes = 0, outside = 0;
+		do {
+			probes ++;
+			if ( s.cur < sc->limitLo || s.cur > sc->limitHi )
+				outside ++;
+		} while ( sweepNext( &s, s.cur >= sc->lo && s.cur <= sc->hi ) && probes < 1000 );
+
+		s32 eLo, eHi;
+		expectedWindow( sc->start, sc->step, sc->limitLo, sc->limitHi, sc->lo, sc->hi, &eLo, &eHi );
+		s32 eCenter = eLo < 0 ? sc->start : ( eLo + eHi ) / 2;
+		s32 center = sweepCenter( &s );
+
+		// every value of the window is tested once, plus one failing value on each side (unless stopped by a limit)
+		u32 ok = s.passLo == eLo && s.passHi == eHi && center == eCenter && outside == 0 && probes < 1000;
+
+		printf( "  %-24s window %4d-%4d  found %4d-%4d  center %4d  probes %3d  %s\n",
+			sc->name, sc->lo, sc->hi, s.passLo, s.passHi, center, probes, ok ? "ok" : "FAILED" );
+		if ( !ok )
+			failed ++;
+	}
+	return failed;
+}
+
+//
+// part 2: the calibration state machine as run by the menu kernel
+//
+// The C64 runs the calibration loop after fetching the screen (startDelay), one transfer (pattern read from IO2 and
+// echo write) takes 'usPerTransfer' microseconds. A transfer is corrupted if one of the three calibrated values lies
+// outside its window; the edges of each window jitter by up to 'jitter' ticks from transfer to transfer, values close
+// to an edge therefore fail only some of the time.
+//
+typedef struct
+{
+	const char *name;
+	u32 c128, newVIC, ntsc;
+	s32 window[ 3 ][ 2 ];				// WAIT_CYCLE_READ, WAIT_CYCLE_WRITEDATA, WAIT_CYCLE_MULTIPLEXER
+	u32 stopAfter;						// the C64 stops answering after this many transfers (0 = never)
+	u32 expect;
+	const char *profile;
+} MACHINE;
+
+static const MACHINE machines[] = {
+	{ "C64 PAL new VIC",           0, 1, 0, { { 390, 560 }, { 410, 640 }, { 120, 300 } }, 0, CALIB_OK, "C64_PAL_NEWVIC" },
+	{ "C64 PAL old VIC",           0, 0, 0, { { 360, 540 }, { 430, 660 }, { 130, 290 } }, 0, CALIB_OK, "C64_PAL_OLDVIC" },
+	{ "C64 NTSC new VIC",          0, 1, 1, { { 380, 520 }, { 400, 600 }, { 110, 280 } }, 0, CALIB_OK, "C64_NTSC_NEWVIC" },
+	{ "C64 NTSC old VIC",          0, 0, 1, { { 350, 505 }, { 420, 590 }, { 125, 270 } }, 0, CALIB_OK, "C64_NTSC_OLDVIC" },
+	{ "C128 PAL",                  1, 1, 0, { { 420, 600 }, { 440, 700 }, { 150, 320 } }, 0, CALIB_OK, "C128_PAL" },
+	{ "C128 NTSC",                 1, 1, 1, { { 410, 580 }, { 430, 680 }, { 140, 310 } }, 0, CALIB_OK, "C128_NTSC" },
+	{ "one-sided (read < limit)",  0, 1, 0, { { 100, 560 }, { 410, 640 }, { 120, 300 } }, 0, CALIB_OK, "C64_PAL_NEWVIC" },
+	{ "one-sided (write > limit)", 1, 1, 0, { { 420, 600 }, { 440, 950 }, { 150, 320 } }, 0, CALIB_OK, "C128_PAL" },
+	{ "one-sided (mux > limit)",   0, 1, 0, { { 390, 560 }, { 410, 640 }, {  20, 600 } }, 0, CALIB_OK, "C64_PAL_NEWVIC" },
+	{ "no pass (read)",            0, 1, 0, { { 500, 600 }, { 410, 640 }, { 120, 300 } }, 0, CALIB_FAILED, 0 },
+	{ "no pass (mux)",             0, 1, 0, { { 390, 560 }, { 410, 640 }, { 250, 300 } }, 0, CALIB_FAILED, 0 },
+	{ "C64 stops answering",       0, 1, 0, { { 390, 560 }, { 410, 640 }, { 120, 300 } }, 20000, CALIB_LOST_C64, 0 },
+};
+
+static u32 jitter = 2;
+static u32 usPerTransfer = 18;
+static u32 startDelay = 300000;
+
+#define PAL_CLOCK		985248
+#define NTSC_CLOCK		1022727
+
+static u32 *const calibValue[ 3 ] = { &WAIT_CYCLE_READ, &WAIT_CYCLE_WRITEDATA, &WAIT_CYCLE_MULTIPLEXER };
+static const int calibIndex[ 3 ] = { 1, 2, 6 };
+
+static u32 transferFails( const MACHINE *m )
+{
+	for ( u32 i = 0; i < 3; i++ )
+	{
+		s32 v = *calibValue[ i ];
+		s32 e = jitter ? rng() % ( jitter + 1 ) : 0;
+		if ( v < m->window[ i ][ 0 ] + e || v > m->window[ i ][ 1 ] - e )
+			return 1;
+	}
+	return 0;
+}
+
+static u32 runMachine( const MACHINE *m )
+{
+	u32 original[ 3 ];
+	for ( u32 i = 0; i < 3; i++ )
+		original[ i ] = *calibValue[ i ];
+
+	// machine detection: C64/C128 and VIC revision are reported by the C64, PAL/NTSC is measured
+	modeC128 = m->c128;
+	modeVIC = m->newVIC;
+	u32 clock = m->ntsc ? NTSC_CLOCK : PAL_CLOCK;
+	u32 t = 1000;
+	while ( !timingMeasurePhi2( (u32)( (u64)t * clock / 1000000 ), t ) )
+		t += 1000;
+
+	if ( machineNTSC != m->ntsc )
+	{
+		printf( "  %-27s PAL/NTSC detection FAILED\n", m->name );
+		return 1;
+	}
+	applyMachineTimingProfile();
+
+	requestTimingCalibration();
+	beginTimingCalibration( t );
+
+	u32 result = CALIB_RUNNING, transfers = 0, transferTime = t + startDelay, tStart = t;
+	while ( result == CALIB_RUNNING && t - tStart < 1000000000 )
+	{
+		t += 10;
+
+		// the FIQ handler: serve the pattern byte, compare the echo
+		while ( t >= transferTime + usPerTransfer && !( m->stopAfter && transfers >= m->stopAfter ) )
+		{
+			transferTime += usPerTransfer;
+			transfers ++;
+			calibLastServed = calibPattern[ calibPatternIdx ++ & 255 ];
+			u8 D = calibLastServed ^ ( transferFails( m ) ? 1 << ( rng() & 7 ) : 0 );
+			calibSamples ++;
+			if ( D != calibLastServed )
+				calibErrors ++;
+		}
+
+		// the main loop of the menu
+		result = stepTimingCalibration( t );
+	}
+
+	u32 failed = 0;
+	if ( result != m->expect || calibActive || !calibDone )
+		failed = 1;
+
+	int p = -1;
+	if ( result == CALIB_OK )
+	{
+		p = getTimingProfile( getMachineTimingProfileName() );
+		if ( p < 0 || strcmp( timingProfileName[ p ], m->profile ) != 0 || activeTimingProfile != p || applyMachineTimingProfile() )
+			failed = 1;
+	} else
+	{
+		// the timings in use are left unchanged
+		for ( u32 i = 0; i < 3; i++ )
+			if ( *calibValue[ i ] != original[ i ] )
+				failed = 1;
+	}
+
+	printf( "  %-27s %-8s %5.1f s", m->name,
+		result == CALIB_OK ? "ok" : result == CALIB_FAILED ? "failed" : result == CALIB_LOST_C64 ? "lost" : "running",
+		(double)( t - tStart ) / 1000000.0 );
+
+	for ( u32 i = 0; i < 3 && p >= 0; i++ )
+	{
+		s32 found[ 2 ] = { timingProfileWindow[ p ][ calibIndex[ i ] ][ 0 ], timingProfileWindow[ p ][ calibIndex[ i ] ][ 1 ] };
+		s32 value = timingProfileValues[ p ][ calibIndex[ i ] ];
+
+		// the limits used by startParam, for the multiplexer the upper limit depends on the values calibrated before
+		s32 limitLo = 150, limitHi = 800;
+		if ( i == 2 )
+		{
+			limitLo = WAIT_FOR_SIGNALS + 5;
+			limitHi = ( timingProfileValues[ p ][ 1 ] < timingProfileValues[ p ][ 2 ] ? timingProfileValues[ p ][ 1 ] : timingProfileValues[ p ][ 2 ] ) - 50;
+		}
+
+		// without jitter the exact grid window is found, jitter can cost up to 'jitter' ticks (rounded to a step) per edge
+		s32 eLo, eHi;
+		expectedWindow( original[ i ], 5, limitLo, limitHi, m->window[ i ][ 0 ], m->window[ i ][ 1 ], &eLo, &eHi );
+		s32 slack = ( jitter + 4 ) / 5 * 5;
+		if ( found[ 0 ] < eLo || found[ 0 ] > eLo + slack || found[ 1 ] > eHi || found[ 1 ] < eHi - slack ||
+			 value != ( found[ 0 ] + found[ 1 ] ) / 2 || (s32)*calibValue[ i ] != value )
+			failed = 1;
+
+		printf( "  %d-%d (%d-%d) -> %d", found[ 0 ], found[ 1 ], eLo, eHi, value );
+	}
+	printf( "  %s\n", failed ? "FAILED" : "ok" );
+
+	return failed;
+}
+
+int main( int argc, char **argv )
+{
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-j" ) && i + 1 < argc )
+			jitter = atoi( argv[ ++ i ] ); else
+		if ( !strcmp( argv[ i ], "-t" ) && i + 1 < argc )
+			usPerTransfer = atoi( argv[ ++ i ] ) > 1 ? atoi( argv[ i ] ) : 1; else
+		if ( !strcmp( argv[ i ], "-d" ) && i + 1 < argc )
+			startDelay = atoi( argv[ ++ i ] ); else
+		if ( !strcmp( argv[ i ], "-r" ) && i + 1 < argc )
+			rngState = atoi( argv[ ++ i ] ); else
+		{
+			fprintf( stderr, "usage: calibbench [-j jitter] [-t us per transfer] [-d start delay in us] [-r seed]\n" );
+			return 1;
+		}
+	}
+
+	u32 failed = runSweepCases();
+
+	// every machine is calibrated in a process of its own: the PAL/NTSC measurement is done once after power-up
+	printf( "calibration (jitter %d, %d us per transfer):\n", jitter, usPerTransfer );
+	for ( u32 m = 0; m < sizeof( machines ) / sizeof( machines[ 0 ] ); m++ )
+	{
+		fflush( stdout );
+		pid_t pid = fork();
+		if ( pid == 0 )
+			exit( runMachine( &machines[ m ] ) );
+
+		int status = 0;
+		waitpid( pid, &status, 0 );
+		if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+			failed ++;
+	}
+
+	printf( "%d failed\n", failed );
+	return failed ? 2 : 0;
+}
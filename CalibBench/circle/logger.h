@@ -0,0 +1,9 @@
+//
+// calibration.cpp includes Circle's logger.h but does not log anything
+//
+#ifndef _circle_logger_h
+#define _circle_logger_h
+
+class CLogger;
+
+#endif
@@ -0,0 +1,40 @@
+//
+// host replacement for the parts of lowlevel_arm64.h, helpers.h and config.h used by calibration.cpp
+// (the Makefile defines the include guards of these headers and includes this file instead)
+//
+#ifndef _hostcalib_h
+#define _hostcalib_h
+
+#include <circle/types.h>
+
+#define AA __attribute__ ((aligned (64)))
+
+#define min(a,b) (((a)<(b))?(a):(b))
+#define max(a,b) (((a)>(b))?(a):(b))
+
+extern u32 WAIT_FOR_SIGNALS;
+extern u32 WAIT_CYCLE_MULTIPLEXER;
+extern u32 WAIT_CYCLE_READ;
+extern u32 WAIT_CYCLE_WRITEDATA;
+extern u32 WAIT_CYCLE_READ_BADLINE;
+extern u32 WAIT_CYCLE_READ_VIC2;
+extern u32 WAIT_CYCLE_WRITEDATA_VIC2;
+extern u32 WAIT_CYCLE_MULTIPLEXER_VIC2;
+extern u32 WAIT_TRIGGER_DMA;
+extern u32 WAIT_RELEASE_DMA;
+
+extern u32 modeC128;
+extern u32 modeVIC;
+
+#define TIMING_NAMES		10
+#define MAX_TIMING_PROFILES	8
+extern int  nTimingProfiles;
+extern char timingProfileName[ MAX_TIMING_PROFILES ][ 32 ];
+extern int  timingProfileValues[ MAX_TIMING_PROFILES ][ TIMING_NAMES ];
+extern int  timingProfileWindow[ MAX_TIMING_PROFILES ][ TIMING_NAMES ][ 2 ];
+extern int  timingValues[ TIMING_NAMES ];
+
+extern int getTimingProfile( const char *name, int create = 0 );
+extern void applyTimingValues( int *v );
+
+#endif
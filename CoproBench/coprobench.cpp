@@ -0,0 +1,609 @@
+//
+// coprobench: drives the register interface of ../copro.h with the bus accesses a C64 program would make, checks the
+// results of all commands against reference implementations and measures the throughput.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "copro.h"
+
+//
+// replay bus (as SIDReplay/chainbench.cpp), every access is executed immediately
+//
+typedef struct
+{
+	u32 g2, g3, data;
+} BUS_TRACE;
+
+class CBusReplay : public CBusCycle
+{
+public:
+	const BUS_TRACE *cur;
+	u32 out;
+
+	inline void start()							{ g2 = cur->g2; }
+	inline void readRest()						{ g3 = cur->g3; }
+	inline void put( u32 D )					{ out = D; }
+	inline u32  get()							{ return cur->data; }
+	inline void finish()						{}
+	inline void setClr( u32 set, u32 clr )		{}
+	inline void preloadL1( const void *p )		{ __builtin_prefetch( p ); }
+	inline void preloadL2( const void *p )		{ __builtin_prefetch( p ); }
+	inline void probe()							{}
+};
+
+static BUSCHAIN_COUNTERS counters;
+static COPRO_STATE copro;
+typedef CDevCopro< &copro > DevCopro;
+
+static u64 accesses = 0;
+
+static u32 busAccess( u32 addr, u32 write, u32 data = 0 )
+{
+	BUS_TRACE t;
+
+	t.g2 = ( ( addr & 255 ) << A0 ) | bCS | ( write ? 0 : bRW ) | bRESET;
+	t.g3 = ( ( ( addr >> 8 ) & 31 ) << A8 ) | bIO1 | bIO2 | bROML | bROMH | bCS | bBA;
+	t.data = data & 255;
+
+	if ( addr >= 0xde00 && addr < 0xdf00 ) t.g3 &= ~bIO1;
+	if ( addr >= 0xdf00 && addr < 0xe000 ) t.g3 &= ~bIO2;
+
+	CBusReplay b;
+	b.cur = &t;
+	b.out = 0;
+	busChainCycle< CBusReplay, &counters, DevCopro >( b );
+	accesses ++;
+
+	return b.out;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//
+// what a program on the C64 does
+//
+#define REG_A		0xdf00
+#define REG_B		0xdf04
+#define REG_C		0xdf08
+#define REG_D		0xdf0c
+#define REG_CMD		0xdf10
+#define REG_QUEUED	0xdf11
+#define REG_PTR		0xdf12
+#define REG_DATA	0xdf14
+
+static void setReg( u32 reg, u32 v, u32 bytes = 4 )
+{
+	for ( u32 i = 0; i < bytes; i++ )
+		busAccess( reg + i, 1, v >> ( i * 8 ) );
+}
+
+static u32 getReg( u32 reg, u32 bytes = 4 )
+{
+	u32 v = 0;
+	for ( u32 i = 0; i < bytes; i++ )
+		v |= busAccess( reg + i, 0 ) << ( i * 8 );
+	return v;
+}
+
+static void setParam( u32 i, u32 v )
+{
+	setReg( REG_A + i * 2, v, 2 );
+}
+
+// the main loop runs while the C64 polls the status
+static u32 waitReady()
+{
+	u32 s;
+	while ( ( s = busAccess( REG_CMD, 0 ) ) & COPRO_STATUS_BUSY )
+		coproWork( &copro );
+	return s;
+}
+
+static u32 command( u32 cmd )
+{
+	busAccess( REG_CMD, 1, cmd );
+	return waitReady() & COPRO_STATUS_ERROR;
+}
+
+static void writeRAM( u32 addr, const void *p, u32 n )
+{
+	setReg( REG_PTR, addr, 2 );
+	for ( u32 i = 0; i < n; i++ )
+		busAccess( REG_DATA, 1, ( (const u8 *)p )[ i ] );
+}
+
+static void readRAM( u32 addr, void *p, u32 n )
+{
+	setReg( REG_PTR, addr, 2 );
+	for ( u32 i = 0; i < n; i++ )
+		( (u8 *)p )[ i ] = busAccess( REG_DATA, 0 );
+}
+
+//
+// checks
+//
+static u32 failures = 0;
+
+static void fail( const char *what, u32 a, u32 b, u32 got, u32 expected )
+{
+	if ( failures ++ < 20 )
+		printf( "  %s: A=%08x B=%08x result %08x expected %08x\n", what, a, b, got, expected );
+}
+
+static u32 rnd32()
+{
+	u32 r = ( (u32)rand() << 16 ) ^ (u32)rand();
+	// more small and special values than uniform random numbers have
+	switch ( rand() % 8 )
+	{
+	case 0: return r & 0xff;
+	case 1: return r & 0xffff;
+	case 2: return (u32)-(s32)( r & 0xffff );
+	case 3: return ( rand() % 2 ) ? 0x80000000 : 0xffffffff;
+	default: return r;
+	}
+}
+
+static void checkInteger( u32 n )
+{
+	for ( u32 i = 0; i < n; i++ )
+	{
+		u32 a = rnd32(), b = rnd32();
+		if ( i % 64 == 0 ) b = 0;
+
+		setReg( REG_A, a );
+		setReg( REG_B, b );
+
+		s16 a16 = a, b16 = b;
+		s32 as = a, bs = b;
+
+		#define CHECK( cmd, err, c, d )																	\
+		{																								\
+			u32 e = command( cmd ), rc = getReg( REG_C ), rd = getReg( REG_D );							\
+			if ( e != ( ( err ) ? COPRO_STATUS_ERROR : 0 ) ) fail( #cmd " error bit", a, b, e, err );	\
+			else if ( !( err ) && rc != (u32)( c ) ) fail( #cmd, a, b, rc, c );							\
+			else if ( !( err ) && rd != (u32)( d ) ) fail( #cmd " (D)", a, b, rd, d );					\
+		}
+
+		// the reference results, D is unchanged by commands which do not write it
+		u32 d0 = getReg( REG_D );
+		CHECK( COPRO_MULS16, 0, (s32)a16 * b16, d0 );
+		CHECK( COPRO_MULU16, 0, (u32)(u16)a * (u16)b, d0 );
+		CHECK( COPRO_MULS32, 0, (u32)( (s64)as * bs ), (u32)( (u64)( (s64)as * bs ) >> 32 ) );
+		CHECK( COPRO_MULU32, 0, (u32)( (u64)a * b ), (u32)( ( (u64)a * b ) >> 32 ) );
+		d0 = getReg( REG_D );
+		if ( b16 == 0 ) CHECK( COPRO_DIVS16, 1, 0, 0 ) else CHECK( COPRO_DIVS16, 0, (s32)a16 / b16, (s32)a16 % b16 );
+		d0 = getReg( REG_D );
+		if ( (u16)b == 0 ) CHECK( COPRO_DIVU16, 1, 0, 0 ) else CHECK( COPRO_DIVU16, 0, (u16)a / (u16)b, (u16)a % (u16)b );
+		if ( b == 0 ) CHECK( COPRO_DIVS32, 1, 0, 0 ) else
+		if ( as == INT32_MIN && bs == -1 ) CHECK( COPRO_DIVS32, 0, 0x80000000, 0 ) else
+			CHECK( COPRO_DIVS32, 0, as / bs, as % bs );
+		if ( b == 0 ) CHECK( COPRO_DIVU32, 1, 0, 0 ) else CHECK( COPRO_DIVU32, 0, a / b, a % b );
+		d0 = getReg( REG_D );
+		CHECK( COPRO_FIXMUL, 0, (u32)( ( (s64)as * bs ) >> 16 ), d0 );
+		if ( b == 0 ) CHECK( COPRO_FIXDIV, 1, 0, 0 ) else CHECK( COPRO_FIXDIV, 0, (u32)( ( (s64)as * 65536 ) / bs ), d0 );
+		CHECK( COPRO_ISQRT, 0, (u32)sqrtl( (long double)a ), d0 );
+		CHECK( COPRO_FIXSQRT, 0, (u32)sqrtl( (long double)a * 65536 ), d0 );
+		#undef CHECK
+
+		// SINCOS: table with linear interpolation, at most 2/65536 away
+		u32 e = command( COPRO_SINCOS );
+		s32 s = getReg( REG_C ), c = getReg( REG_D );
+		double ang = ( a & 0xffff ) * ( 2 * M_PI / 65536 );
+		if ( e || fabs( s - sin( ang ) * 65536 ) > 2 || fabs( c - cos( ang ) * 65536 ) > 2 )
+			fail( "COPRO_SINCOS", a, b, s, (u32)(s32)lrint( sin( ang ) * 65536 ) );
+	}
+}
+
+static u32 f2u( float f ) { u32 u; memcpy( &u, &f, 4 ); return u; }
+static float u2f( u32 u ) { float f; memcpy( &f, &u, 4 ); return f; }
+
+static float rndFloat()
+{
+	switch ( rand() % 4 )
+	{
+	case 0: return ( rand() - RAND_MAX / 2 ) / 1000.0f;
+	case 1: return ( rand() - RAND_MAX / 2 ) / (float)RAND_MAX * 10;
+	case 2: return ( rand() % 2001 - 1000 ) / 100.0f;
+	default: return ldexpf( rand() / (float)RAND_MAX - 0.5f, rand() % 40 - 20 );
+	}
+}
+
+// the results are rounded to single precision, the transcendental functions may be off by one step of the result
+static u32 closeFloat( float got, double expected, double absTol = 0 )
+{
+	if ( isnan( expected ) ) return isnan( got );
+	if ( isinf( expected ) ) return got == expected;
+	double tol = fabs( expected ) * 2.5e-7 + absTol;
+	return fabs( got - expected ) <= tol;
+}
+
+static void checkFloat( u32 n )
+{
+	for ( u32 i = 0; i < n; i++ )
+	{
+		float a = rndFloat(), b = rndFloat();
+		u32 ua = f2u( a ), ub = f2u( b );
+
+		setReg( REG_A, ua );
+		setReg( REG_B, ub );
+
+		#define CHECK( cmd, expr, tol )											\
+		{																		\
+			command( cmd );														\
+			float r = u2f( getReg( REG_C ) );									\
+			if ( !closeFloat( r, expr, tol ) ) fail( #cmd, ua, ub, f2u( r ), f2u( (float)( expr ) ) );	\
+		}
+
+		// the basic operations are exact
+		#define CHECK_EXACT( cmd, expr )										\
+		{																		\
+			command( cmd );														\
+			u32 r = getReg( REG_C );											\
+			if ( r != (u32)( expr ) ) fail( #cmd, ua, ub, r, expr );			\
+		}
+
+		CHECK_EXACT( COPRO_FADD, f2u( a + b ) );
+		CHECK_EXACT( COPRO_FSUB, f2u( a - b ) );
+		CHECK_EXACT( COPRO_FMUL, f2u( a * b ) );
+		if ( b != 0 ) CHECK_EXACT( COPRO_FDIV, f2u( a / b ) );
+		if ( a >= 0 ) CHECK_EXACT( COPRO_FSQRT, f2u( sqrtf( a ) ) );
+		CHECK_EXACT( COPRO_FTOI, (u32)(s32)a );
+		CHECK( COPRO_FSIN, sin( (double)a ), 1e-7 );
+		CHECK( COPRO_FCOS, cos( (double)a ), 1e-7 );
+		CHECK( COPRO_FATAN2, atan2( (double)a, (double)b ), 0 );
+
+		// integer and fixed point inputs
+		s32 ia = (s32)rnd32(), ib = (s32)rnd32();
+		ua = ia; ub = ib;
+		setReg( REG_A, ua );
+		setReg( REG_B, ub );
+		CHECK_EXACT( COPRO_ITOF, f2u( (float)ia ) );
+		CHECK_EXACT( COPRO_FIXTOF, f2u( (float)( ia / 65536.0 ) ) );
+
+		command( COPRO_ATAN2 );
+		u32 r = getReg( REG_C );
+		if ( ia != 0 || ib != 0 )
+		{
+			double t = atan2( (double)ia, (double)ib ) * 65536 / ( 2 * M_PI );
+			s32 d = ( (s32)r - (s32)lrint( t < 0 ? t + 65536 : t ) ) & 0xffff;
+			if ( d > 1 && d < 65535 ) fail( "COPRO_ATAN2", ua, ub, r, (u32)lrint( t < 0 ? t + 65536 : t ) & 0xffff );
+		}
+		#undef CHECK
+		#undef CHECK_EXACT
+	}
+}
+
+//
+// geometry
+//
+#define BITMAP		0x2000
+#define MATRIX		0x0000
+#define VERTICES	0x0100
+#define PROJECTED	0x0400
+#define INDICES		0x0800
+
+static u8 bitmap[ 8000 ];
+
+static u32 getPixel( s32 x, s32 y )
+{
+	return ( bitmap[ ( y >> 3 ) * 320 + ( x & ~7 ) + ( y & 7 ) ] >> ( 7 - ( x & 7 ) ) ) & 1;
+}
+
+static u32 bitsSet()
+{
+	u32 n = 0;
+	for ( u32 i = 0; i < 8000; i++ )
+		n += __builtin_popcount( bitmap[ i ] );
+	return n;
+}
+
+// the bytes around the bitmap are never touched
+static u32 checkGuard()
+{
+	for ( u32 i = BITMAP - 256; i < BITMAP; i++ )
+		if ( copro.ram[ i ] != 0xa5 ) return 0;
+	for ( u32 i = BITMAP + 8000; i < BITMAP + 8256; i++ )
+		if ( copro.ram[ i ] != 0xa5 ) return 0;
+	return 1;
+}
+
+static void clearBitmap()
+{
+	memset( &copro.ram[ BITMAP - 256 ], 0xa5, 8512 );
+	setParam( 0, BITMAP );
+	setParam( 1, 0 );
+	command( COPRO_CLEAR );
+}
+
+static void checkLines( u32 n )
+{
+	for ( u32 i = 0; i < n; i++ )
+	{
+		s32 x0 = rand() % 320, y0 = rand() % 200, x1 = rand() % 320, y1 = rand() % 200;
+		if ( i % 4 == 0 ) { x1 = x0 + rand() % 9 - 4; y1 = y0 + rand() % 9 - 4; }
+		if ( x1 < 0 || x1 > 319 || y1 < 0 || y1 > 199 ) { x1 = x0; y1 = y0; }
+
+		clearBitmap();
+		setParam( 1, x0 ); setParam( 2, y0 ); setParam( 3, x1 ); setParam( 4, y1 ); setParam( 5, 0 );
+		command( COPRO_LINE );
+		readRAM( BITMAP, bitmap, 8000 );
+
+		s32 dx = abs( x1 - x0 ), dy = abs( y1 - y0 );
+		u32 ok = checkGuard() && bitsSet() == (u32)( dx > dy ? dx : dy ) + 1 && getPixel( x0, y0 ) && getPixel( x1, y1 );
+
+		// every pixel is at most half a pixel (along the minor axis) away from the line
+		for ( s32 y = 0; ok && y < 200; y++ )
+			for ( s32 x = 0; ok && x < 320; x++ )
+				if ( getPixel( x, y ) )
+				{
+					double d;
+					if ( dx >= dy )
+						d = dx ? fabs( y0 + (double)( y1 - y0 ) * ( x - x0 ) / ( x1 - x0 ) - y ) : fabs( (double)y - y0 ); else
+						d = fabs( x0 + (double)( x1 - x0 ) * ( y - y0 ) / ( y1 - y0 ) - x );
+					if ( d > 0.5 + 1e-9 ) ok = 0;
+				}
+
+		// invert the line again: the bitmap is empty
+		setParam( 5, 2 );
+		command( COPRO_LINE );
+		readRAM( BITMAP, bitmap, 8000 );
+		if ( ok && bitsSet() != 0 ) ok = 0;
+
+		if ( !ok ) fail( "COPRO_LINE", ( x0 << 16 ) | y0, ( x1 << 16 ) | y1, 0, 0 );
+	}
+
+	// lines partially or completely outside of the bitmap
+	for ( u32 i = 0; i < n; i++ )
+	{
+		s32 x0 = rand() % 1600 - 640, y0 = rand() % 1000 - 400, x1 = rand() % 1600 - 640, y1 = rand() % 1000 - 400;
+		clearBitmap();
+		setParam( 1, x0 ); setParam( 2, y0 ); setParam( 3, x1 ); setParam( 4, y1 ); setParam( 5, 0 );
+		command( COPRO_LINE );
+		if ( !checkGuard() ) fail( "COPRO_LINE (clipped)", ( x0 << 16 ) | ( y0 & 0xffff ), ( x1 << 16 ) | ( y1 & 0xffff ), 0, 0 );
+	}
+}
+
+static s64 edge( s32 ax, s32 ay, s32 bx, s32 by, s32 px, s32 py )
+{
+	return (s64)( bx - ax ) * ( py - ay ) - (s64)( by - ay ) * ( px - ax );
+}
+
+static void checkTriangles( u32 n )
+{
+	for ( u32 i = 0; i < n; )
+	{
+		s32 range = ( i % 3 == 0 ) ? 40 : 600;
+		s32 x[ 3 ], y[ 3 ];
+		for ( u32 k = 0; k < 3; k++ )
+		{
+			x[ k ] = rand() % range - range / 2 + ( range == 40 ? rand() % 320 : 160 );
+			y[ k ] = rand() % range - range / 2 + ( range == 40 ? rand() % 200 : 100 );
+		}
+		s64 area = edge( x[ 0 ], y[ 0 ], x[ 1 ], y[ 1 ], x[ 2 ], y[ 2 ] );
+		if ( area == 0 ) continue;
+		i ++;
+
+		clearBitmap();
+		for ( u32 k = 0; k < 3; k++ ) { setParam( 1 + k * 2, x[ k ] ); setParam( 2 + k * 2, y[ k ] ); }
+		setParam( 7, 0 );
+		command( COPRO_TRIANGLE );
+		readRAM( BITMAP, bitmap, 8000 );
+
+		// the pixels on the edges or inside (both orientations)
+		u32 ok = checkGuard();
+		for ( s32 py = 0; ok && py < 200; py++ )
+			for ( s32 px = 0; ok && px < 320; px++ )
+			{
+				s64 e0 = edge( x[ 0 ], y[ 0 ], x[ 1 ], y[ 1 ], px, py );
+				s64 e1 = edge( x[ 1 ], y[ 1 ], x[ 2 ], y[ 2 ], px, py );
+				s64 e2 = edge( x[ 2 ], y[ 2 ], x[ 0 ], y[ 0 ], px, py );
+				u32 inside = area > 0 ? ( e0 >= 0 && e1 >= 0 && e2 >= 0 ) : ( e0 <= 0 && e1 <= 0 && e2 <= 0 );
+				if ( inside != getPixel( px, py ) ) ok = 0;
+			}
+
+		if ( !ok ) fail( "COPRO_TRIANGLE", ( x[ 0 ] << 16 ) | ( y[ 0 ] & 0xffff ), ( x[ 1 ] << 16 ) | ( y[ 1 ] & 0xffff ), 0, 0 );
+	}
+}
+
+static void writeMatrix( const double m[ 12 ] )
+{
+	u8 b[ 48 ];
+	for ( u32 i = 0; i < 12; i++ )
+	{
+		s32 v = (s32)lrint( m[ i ] * 65536 );
+		memcpy( &b[ i * 4 ], &v, 4 );
+	}
+	writeRAM( MATRIX, b, 48 );
+}
+
+static void rotation( double m[ 12 ], double a, double b, double tz )
+{
+	double ca = cos( a ), sa = sin( a ), cb = cos( b ), sb = sin( b );
+	double r[ 12 ] = { ca, 0, sa, 0,  sa * sb, cb, -ca * sb, 0,  -sa * cb, sb, ca * cb, tz };
+	memcpy( m, r, sizeof( r ) );
+}
+
+static void checkTransform( u32 n )
+{
+	for ( u32 i = 0; i < n; i++ )
+	{
+		double m[ 12 ];
+		rotation( m, rand() * 0.001, rand() * 0.001, ( i & 1 ) ? 100 + rand() % 400 : 0 );
+		if ( i % 4 == 1 ) m[ 11 ] = -50;	// some vertices are behind the camera
+		writeMatrix( m );
+
+		s16 v[ 64 * 3 ], p[ 64 * 3 ];
+		for ( u32 k = 0; k < 64 * 3; k++ )
+			v[ k ] = rand() % 401 - 200;
+		writeRAM( VERTICES, v, sizeof( v ) );
+
+		s32 focal = ( i & 1 ) ? 256 : 0;
+		setParam( 0, MATRIX ); setParam( 1, VERTICES ); setParam( 2, PROJECTED ); setParam( 3, 64 );
+		setParam( 4, focal ); setParam( 5, 160 ); setParam( 6, 100 );
+		command( COPRO_XFORM );
+		readRAM( PROJECTED, p, sizeof( p ) );
+
+		// the matrix as the coprocessor sees it
+		double mq[ 12 ];
+		for ( u32 k = 0; k < 12; k++ )
+			mq[ k ] = lrint( m[ k ] * 65536 ) / 65536.0;
+
+		for ( u32 k = 0; k < 64; k++ )
+		{
+			double x = v[ k * 3 ], y = v[ k * 3 + 1 ], z = v[ k * 3 + 2 ];
+			double X = mq[ 0 ] * x + mq[ 1 ] * y + mq[ 2 ] * z + mq[ 3 ];
+			double Y = mq[ 4 ] * x + mq[ 5 ] * y + mq[ 6 ] * z + mq[ 7 ];
+			double Z = mq[ 8 ] * x + mq[ 9 ] * y + mq[ 10 ] * z + mq[ 11 ];
+			double ex = X, ey = Y;
+			u32 ok;
+
+			if ( focal && Z < 1 )
+				ok = p[ k * 3 ] == COPRO_INVALID && p[ k * 3 + 1 ] == COPRO_INVALID; else
+			{
+				if ( focal ) { ex = 160 + X * focal / Z; ey = 100 - Y * focal / Z; }
+				ex = ex < -32767 ? -32767 : ( ex > 32767 ? 32767 : ex );
+				ey = ey < -32767 ? -32767 : ( ey > 32767 ? 32767 : ey );
+				ok = fabs( p[ k * 3 ] - ex ) <= 1 && fabs( p[ k * 3 + 1 ] - ey ) <= 1 && fabs( p[ k * 3 + 2 ] - Z ) <= 1;
+			}
+
+			if ( !ok ) fail( "COPRO_XFORM", k, i, ( p[ k * 3 ] << 16 ) | ( p[ k * 3 + 1 ] & 0xffff ), ( (s32)ex << 16 ) | ( (s32)ey & 0xffff ) );
+		}
+	}
+}
+
+//
+// throughput
+//
+static void benchInteger( const char *name, u32 cmd, u32 n )
+{
+	u64 acc = accesses;
+	double t0 = now();
+	for ( u32 i = 0; i < n; i++ )
+	{
+		// as a C64 program: operands, command, result
+		setReg( REG_A, i * 2654435761u, 2 );
+		setReg( REG_B, i | 1, 2 );
+		command( cmd );
+		getReg( REG_C, 4 );
+	}
+	double t = now() - t0;
+	acc = accesses - acc;
+	printf( "%-12s %10.1f %12.1f %12.0f\n", name, (double)acc / n, t * 1e9 / n, n / t );
+}
+
+// a rotating cube: transform and project 8 vertices, clear the bitmap, draw 12 edges or 12 triangles
+static void benchCube( const char *name, u32 cmd, u32 frames )
+{
+	static const s16 cube[ 8 * 3 ] = { -50,-50,-50, 50,-50,-50, 50,50,-50, -50,50,-50, -50,-50,50, 50,-50,50, 50,50,50, -50,50,50 };
+	static const u8 edges[ 24 ] = { 0,1, 1,2, 2,3, 3,0, 4,5, 5,6, 6,7, 7,4, 0,4, 1,5, 2,6, 3,7 };
+	static const u8 faces[ 36 ] = { 0,1,2, 0,2,3, 4,6,5, 4,7,6, 0,4,5, 0,5,1, 1,5,6, 1,6,2, 2,6,7, 2,7,3, 3,7,4, 3,4,0 };
+
+	writeRAM( VERTICES, cube, sizeof( cube ) );
+	if ( cmd == COPRO_LINES )
+		writeRAM( INDICES, edges, sizeof( edges ) ); else
+		writeRAM( INDICES, faces, sizeof( faces ) );
+
+	u64 acc = accesses;
+	double t0 = now();
+	for ( u32 f = 0; f < frames; f++ )
+	{
+		double m[ 12 ];
+		rotation( m, f * 0.03, f * 0.017, 250 );
+		writeMatrix( m );
+
+		setParam( 0, MATRIX ); setParam( 1, VERTICES ); setParam( 2, PROJECTED ); setParam( 3, 8 );
+		setParam( 4, 200 ); setParam( 5, 160 ); setParam( 6, 100 );
+		busAccess( REG_CMD, 1, COPRO_XFORM );
+
+		setParam( 0, BITMAP ); setParam( 1, 0 );
+		busAccess( REG_CMD, 1, COPRO_CLEAR );
+
+		setParam( 0, BITMAP ); setParam( 1, PROJECTED ); setParam( 2, INDICES ); setParam( 3, 12 ); setParam( 5, 2 );
+		command( cmd );
+	}
+	double t = now() - t0;
+	acc = accesses - acc;
+	printf( "%-12s %10.1f %12.1f %12.0f\n", name, (double)acc / frames, t * 1e9 / frames, frames / t );
+}
+
+// the main loop alone
+static void benchRaster( u32 n )
+{
+	COPRO_JOB j;
+	double t0 = now();
+	for ( u32 i = 0; i < n; i++ )
+		coproLine( copro.ram, BITMAP, rand() % 320, rand() % 200, rand() % 320, rand() % 200, 2 );
+	double t1 = now();
+	for ( u32 i = 0; i < n; i++ )
+		coproTriangle( copro.ram, BITMAP, rand() % 320, rand() % 200, rand() % 320, rand() % 200, rand() % 320, rand() % 200, 2 );
+	double t2 = now();
+
+	j.cmd = COPRO_XFORM;
+	j.reg[ 0 ] = MATRIX | ( VERTICES << 16 );
+	j.reg[ 1 ] = PROJECTED | ( 1000 << 16 );
+	j.reg[ 2 ] = 256 | ( 160 << 16 );
+	j.reg[ 3 ] = 100;
+	for ( u32 i = 0; i < n / 100; i++ )
+		coproRunJob( &copro, &j );
+	double t3 = now();
+
+	printf( "\nmain loop: %.0f lines/s, %.0f triangles/s (random, full bitmap), %.0f vertices/s (transformed and projected)\n",
+		n / ( t1 - t0 ), n / ( t2 - t1 ), ( n / 100 ) * 1000 / ( t3 - t2 ) );
+}
+
+int main( int argc, char **argv )
+{
+	u32 n = 2000;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			n = atoi( argv[ ++i ] ); else
+		{
+			fprintf( stderr, "usage: coprobench [-n iterations]\n" );
+			return 1;
+		}
+	}
+
+	srand( 1 );
+	coproInit( &copro );
+
+	printf( "conformance\n" );
+	checkInteger( n );
+	printf( "  integer and SINCOS:   %u failures\n", failures );
+	u32 f = failures;
+	checkFloat( n );
+	printf( "  floating point:       %u failures\n", failures - f ); f = failures;
+	checkTransform( n / 20 + 1 );
+	printf( "  transform:            %u failures\n", failures - f ); f = failures;
+	checkLines( n / 10 + 1 );
+	printf( "  lines:                %u failures\n", failures - f ); f = failures;
+	checkTriangles( n / 20 + 1 );
+	printf( "  triangles:            %u failures\n", failures - f );
+
+	printf( "\nthroughput (bus accesses of the C64 per operation, host ns per operation including the FIQ device and the\n"
+			"main loop, operations per second)\n\n" );
+	printf( "operation      accesses      ns/op         op/s\n" );
+	benchInteger( "MULS16", COPRO_MULS16, n * 50 );
+	benchInteger( "DIVU32", COPRO_DIVU32, n * 50 );
+	benchInteger( "SINCOS", COPRO_SINCOS, n * 50 );
+	benchInteger( "FMUL", COPRO_FMUL, n * 50 );
+	benchInteger( "FSIN", COPRO_FSIN, n * 50 );
+	benchCube( "cube lines", COPRO_LINES, n * 5 );
+	benchCube( "cube faces", COPRO_TRIANGLES, n * 5 );
+	benchRaster( n * 50 );
+
+	printf( "\nconformance: %s (%u failures)\n", failures ? "FAILED" : "ok", failures );
+
+	return failures ? 2 : 0;
+}
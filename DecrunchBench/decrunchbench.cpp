@@ -0,0 +1,597 @@
+//
+// decrunchbench: checks the decrunch service of ../decrunch.h through its bus device while the main loop runs in a
+// second thread, and compares the load times of a set of demo parts with and without the service.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+#include <vector>
+
+#include "decrunch.h"
+
+//
+// replay bus (as SIDReplay/chainbench.cpp), every access is executed immediately
+//
+typedef struct
+{
+	u32 g2, g3, data;
+} BUS_TRACE;
+
+class CBusReplay : public CBusCycle
+{
+public:
+	const BUS_TRACE *cur;
+	u32 out;
+
+	inline void start()							{ g2 = cur->g2; }
+	inline void readRest()						{ g3 = cur->g3; }
+	inline void put( u32 D )					{ out = D; }
+	inline u32  get()							{ return cur->data; }
+	inline void finish()						{}
+	inline void setClr( u32 set, u32 clr )		{}
+	inline void preloadL1( const void *p )		{ __builtin_prefetch( p ); }
+	inline void preloadL2( const void *p )		{ __builtin_prefetch( p ); }
+	inline void probe()							{}
+};
+
+static BUSCHAIN_COUNTERS counters;
+static DECRUNCH_STATE dec;
+typedef CDevDecrunch< &dec > DevDecrunch;
+
+static u64 accesses = 0;
+
+static u32 busAccess( u32 addr, u32 write, u32 data = 0 )
+{
+	BUS_TRACE t;
+
+	t.g2 = ( ( addr & 255 ) << A0 ) | bCS | ( write ? 0 : bRW ) | bRESET;
+	t.g3 = ( ( ( addr >> 8 ) & 31 ) << A8 ) | bIO1 | bIO2 | bROML | bROMH | bCS | bBA;
+	t.data = data & 255;
+
+	if ( addr >= 0xde00 && addr < 0xdf00 ) t.g3 &= ~bIO1;
+	if ( addr >= 0xdf00 && addr < 0xe000 ) t.g3 &= ~bIO2;
+	if ( addr >= 0x8000 && addr < 0xa000 ) t.g3 &= ~bROML;
+
+	CBusReplay b;
+	b.cur = &t;
+	b.out = 0;
+	busChainCycle< CBusReplay, &counters, DevDecrunch >( b );
+	accesses ++;
+
+	return b.out;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//
+// LZ4 frames as written by the lz4 command line tool (greedy matches, independent 64k blocks, content size)
+//
+static u32 get32( const u8 *p )
+{
+	return p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 ) | ( (u32)p[ 3 ] << 24 );
+}
+
+static void put32( std::vector<u8> &v, u32 x )
+{
+	for ( u32 i = 0; i < 4; i++ )
+		v.push_back( x >> ( i * 8 ) );
+}
+
+// xxHash32 with seed 0 for less than 16 bytes (the header checksum of the frame descriptor)
+static u32 xxh32Short( const u8 *p, u32 n )
+{
+	const u32 P1 = 2654435761u, P2 = 2246822519u, P3 = 3266489917u, P4 = 668265263u, P5 = 374761393u;
+	#define ROTL( x, r ) ( ( (x) << (r) ) | ( (x) >> ( 32 - (r) ) ) )
+
+	u32 h = P5 + n, i = 0;
+	for ( ; i + 4 <= n; i += 4 )
+	{
+		h += get32( &p[ i ] ) * P3;
+		h = ROTL( h, 17 ) * P4;
+	}
+	for ( ; i < n; i++ )
+	{
+		h += p[ i ] * P5;
+		h = ROTL( h, 11 ) * P1;
+	}
+	h ^= h >> 15; h *= P2;
+	h ^= h >> 13; h *= P3;
+	h ^= h >> 16;
+
+	#undef ROTL
+	return h;
+}
+
+static void lz4Length( std::vector<u8> &v, u32 l )
+{
+	for ( ; l >= 255; l -= 255 )
+		v.push_back( 255 );
+	v.push_back( l );
+}
+
+static void lz4Sequence( std::vector<u8> &v, const u8 *lit, u32 nLit, u32 ofs, u32 len )
+{
+	u32 ml = len ? len - 4 : 0;
+	v.push_back( ( ( nLit < 15 ? nLit : 15 ) << 4 ) | ( ml < 15 ? ml : 15 ) );
+	if ( nLit >= 15 ) lz4Length( v, nLit - 15 );
+	v.insert( v.end(), lit, lit + nLit );
+	if ( len == 0 )
+		return;
+	v.push_back( ofs & 255 );
+	v.push_back( ofs >> 8 );
+	if ( ml >= 15 ) lz4Length( v, ml - 15 );
+}
+
+// the last 5 bytes are literals and the last match starts at least 12 bytes before the end (as the LZ4 format requires)
+static std::vector<u8> lz4Block( const u8 *src, u32 n )
+{
+	std::vector<u8> v;
+	static s32 table[ 4096 ];
+	memset( table, 0xff, sizeof( table ) );
+
+	u32 anchor = 0, i = 0;
+	u32 mfLimit = n > 12 ? n - 12 : 0, matchLimit = n > 5 ? n - 5 : 0;
+
+	while ( i < mfLimit )
+	{
+		u32 seq = get32( &src[ i ] ), h = ( seq * 2654435761u ) >> 20;
+		s32 ref = table[ h ];
+		table[ h ] = i;
+
+		if ( ref >= 0 && i - ref <= 65535 && get32( &src[ ref ] ) == seq )
+		{
+			u32 len = 4;
+			while ( i + len < matchLimit && src[ ref + len ] == src[ i + len ] )
+				len ++;
+			lz4Sequence( v, &src[ anchor ], i - anchor, i - ref, len );
+			i += len;
+			anchor = i;
+		} else
+			i ++;
+	}
+	lz4Sequence( v, &src[ anchor ], n - anchor, 0, 0 );
+
+	return v;
+}
+
+static std::vector<u8> lz4Frame( const u8 *src, u32 n )
+{
+	std::vector<u8> v;
+
+	put32( v, 0x184d2204 );
+	v.push_back( 0x68 );		// version 1, independent blocks, content size
+	v.push_back( 0x40 );		// blocks of 64k
+	put32( v, n );
+	put32( v, 0 );
+	v.push_back( ( xxh32Short( &v[ 4 ], 10 ) >> 8 ) & 255 );
+
+	for ( u32 p = 0; p < n; p += 65536 )
+	{
+		u32 l = n - p < 65536 ? n - p : 65536;
+		std::vector<u8> b = lz4Block( &src[ p ], l );
+		if ( b.size() < l )
+		{
+			put32( v, b.size() );
+			v.insert( v.end(), b.begin(), b.end() );
+		} else
+		{
+			put32( v, l | 0x80000000 );
+			v.insert( v.end(), &src[ p ], &src[ p ] + l );
+		}
+	}
+	put32( v, 0 );
+
+	return v;
+}
+
+//
+// demo parts: code, character sets, screens, bitmaps, music data and tables in the proportions of typical demo parts
+//
+static u32 rnd( u32 n ) { return rand() % n; }
+
+static void genCode( std::vector<u8> &v, u32 n )
+{
+	// instruction sequences which repeat with different operands
+	static u8 snippet[ 96 ][ 12 ];
+	static u32 snippetLen[ 96 ], init = 0;
+	static const u8 ops[] = { 0xa9, 0xa5, 0xad, 0xbd, 0xb9, 0xb1, 0x85, 0x8d, 0x9d, 0x99, 0x91, 0xe8, 0xc8, 0xca, 0x88, 0xd0,
+							  0xf0, 0x10, 0x30, 0x90, 0xb0, 0x4c, 0x20, 0x60, 0x69, 0xe9, 0x29, 0x09, 0x49, 0x0a, 0x4a, 0x18, 0x38, 0xaa, 0xa8, 0x8a };
+	if ( !init )
+	{
+		for ( u32 s = 0; s < 96; s++ )
+		{
+			snippetLen[ s ] = 3 + rnd( 10 );
+			for ( u32 i = 0; i < snippetLen[ s ]; i++ )
+				snippet[ s ][ i ] = ( i % 3 == 0 ) ? ops[ rnd( sizeof( ops ) ) ] : rnd( 4 ) ? 0x10 + rnd( 0x30 ) : rnd( 256 );
+		}
+		init = 1;
+	}
+
+	while ( n )
+	{
+		u32 s = rnd( 96 ), l = snippetLen[ s ] < n ? snippetLen[ s ] : n;
+		for ( u32 i = 0; i < l; i++ )
+			v.push_back( ( i == 1 && rnd( 3 ) == 0 ) ? rnd( 256 ) : snippet[ s ][ i ] );
+		n -= l;
+	}
+}
+
+static void genCharset( std::vector<u8> &v )
+{
+	u32 base = v.size();
+	for ( u32 c = 0; c < 256; c++ )
+		for ( u32 y = 0; y < 8; y++ )
+		{
+			if ( c < 32 || rnd( 8 ) == 0 )
+				v.push_back( 0 ); else
+			if ( c >= 64 && rnd( 2 ) )
+				v.push_back( v[ base + ( c - 64 ) * 8 + y ] ^ ( rnd( 4 ) ? 0 : 1 << rnd( 8 ) ) ); else
+				v.push_back( rnd( 256 ) & ( rnd( 2 ) ? 0x7e : 0xff ) );
+		}
+}
+
+static void genScreen( std::vector<u8> &v, u32 n )
+{
+	while ( n )
+	{
+		u32 l = 1 + rnd( rnd( 2 ) ? 8 : 40 ), c = rnd( 3 ) ? 32 : 1 + rnd( 63 );
+		if ( l > n ) l = n;
+		for ( u32 i = 0; i < l; i++ )
+			v.push_back( c == 32 ? 32 : 1 + rnd( 26 ) );
+		n -= l;
+	}
+}
+
+// koala: bitmap with patterns that change slowly over the picture, screen and color RAM, background
+static void genBitmap( std::vector<u8> &v )
+{
+	static const u8 dither[ 4 ][ 4 ] = { { 0x00, 0x00, 0x00, 0x00 }, { 0x44, 0x11, 0x44, 0x11 }, { 0xaa, 0x55, 0xaa, 0x55 }, { 0xff, 0xff, 0xff, 0xff } };
+	u32 cx = rnd( 40 ), cy = rnd( 25 );
+	for ( u32 cell = 0; cell < 1000; cell++ )
+	{
+		u32 x = cell % 40, y = cell / 40, d = ( ( x - cx ) * ( x - cx ) + ( y - cy ) * ( y - cy ) ) / 40;
+		for ( u32 l = 0; l < 8; l++ )
+			v.push_back( rnd( 10 ) == 0 ? rnd( 256 ) : dither[ ( d + ( l > 3 ) ) & 3 ][ l & 3 ] );
+	}
+	for ( u32 i = 0; i < 1000; i++ )
+		v.push_back( rnd( 4 ) ? 0x6e : rnd( 256 ) );
+	for ( u32 i = 0; i < 1000; i++ )
+		v.push_back( rnd( 6 ) ? 0x01 : rnd( 16 ) );
+	v.push_back( 0 );
+}
+
+// patterns of notes and effects, with many repeated rows
+static void genMusic( std::vector<u8> &v, u32 n )
+{
+	genCode( v, n / 3 );
+	std::vector<u8> pattern;
+	while ( pattern.size() < 64 )
+	{
+		pattern.push_back( rnd( 3 ) ? 0x80 : 0x20 + rnd( 60 ) );
+		pattern.push_back( rnd( 5 ) ? 0 : rnd( 16 ) );
+	}
+	for ( u32 i = n / 3; i < n; i++ )
+	{
+		if ( i % 64 == 0 && rnd( 2 ) )
+			pattern[ rnd( 64 ) ] = 0x20 + rnd( 60 );
+		v.push_back( pattern[ i % 64 ] );
+	}
+}
+
+static void genTables( std::vector<u8> &v, u32 n )
+{
+	// sine and ramp tables, sprites and unused (zero) areas
+	for ( u32 i = 0; i < n; i++ )
+	{
+		u32 k = ( i / 256 ) % 4;
+		if ( k == 0 ) v.push_back( (u8)( 128 + 127 * __builtin_sin( i * 6.2831853 / 256 ) ) ); else
+		if ( k == 1 ) v.push_back( i & 255 ); else
+		if ( k == 2 ) v.push_back( ( i & 63 ) < 63 ? ( rnd( 3 ) ? 0 : rnd( 256 ) ) : 0 ); else
+			v.push_back( 0 );
+	}
+}
+
+typedef struct
+{
+	const char *name;
+	std::vector<u8> data;
+} DEMO;
+
+static std::vector<DEMO> demos;
+
+static void addDemo( const char *name, std::vector<u8> &v )
+{
+	DEMO d;
+	d.name = name;
+	d.data = v;
+	demos.push_back( d );
+	v.clear();
+}
+
+static void syntheticDemos()
+{
+	std::vector<u8> v;
+
+	// .PRGs, the first two bytes are the load address
+	v.push_back( 0x01 ); v.push_back( 0x08 );
+	genCode( v, 6000 ); genCharset( v ); genScreen( v, 1000 ); genMusic( v, 4000 );
+	addDemo( "intro", v );
+
+	v.push_back( 0x00 ); v.push_back( 0x60 );
+	genBitmap( v );
+	addDemo( "koala", v );
+
+	v.push_back( 0x00 ); v.push_back( 0x10 );
+	genMusic( v, 8000 );
+	addDemo( "music", v );
+
+	v.push_back( 0x00 ); v.push_back( 0x08 );
+	genCode( v, 14000 ); genTables( v, 8192 ); genCharset( v ); genCharset( v ); genBitmap( v ); genScreen( v, 2000 );
+	addDemo( "part", v );
+
+	v.push_back( 0x00 ); v.push_back( 0x20 );
+	for ( u32 i = 0; i < 16384; i++ )
+		v.push_back( rnd( 256 ) );
+	addDemo( "noise", v );
+}
+
+//
+// the C64 side
+//
+#define REG_STATUS		0xdf10
+#define REG_DATA		0xdf11
+#define REG_READY		0xdf12
+#define REG_SIZE		0xdf13
+#define REG_WINDOW_LO	0xdf16
+#define REG_WINDOW_HI	0xdf17
+#define REG_WINDOW_OFF	0xdf18
+#define REG_FILES		0xdf19
+
+static u32 failures = 0, waits = 0;
+
+#define CHECK( cond, ... ) { if ( !( cond ) ) { if ( failures ++ < 20 ) { printf( "  " __VA_ARGS__ ); printf( "\n" ); } } }
+
+// the loader: reads as many bytes as are ready, polls the status while there are none
+static u32 loadByPort( u32 index, std::vector<u8> &out, u32 maxBytes = 0xffffffff )
+{
+	out.clear();
+	busAccess( REG_STATUS, 1, index );
+
+	while ( out.size() < maxBytes )
+	{
+		u32 n = busAccess( REG_READY, 0 );
+		if ( n == 0 )
+		{
+			u32 s = busAccess( REG_STATUS, 0 );
+			if ( !( s & DECRUNCH_STATUS_BUSY ) && busAccess( REG_READY, 0 ) == 0 )
+				return s;
+			waits ++;
+			std::this_thread::yield();		// the main loop may share the core (as on the Pi)
+			continue;
+		}
+		for ( u32 i = 0; i < n && out.size() < maxBytes; i++ )
+			out.push_back( busAccess( REG_DATA, 0 ) );
+	}
+	return busAccess( REG_STATUS, 0 );
+}
+
+static u32 waitDone()
+{
+	u32 s;
+	while ( ( s = busAccess( REG_STATUS, 0 ) ) & DECRUNCH_STATUS_BUSY )
+		std::this_thread::yield();
+	return s;
+}
+
+static void checkService( std::vector< std::vector<u8> > &packed )
+{
+	std::vector<u8> out;
+
+	// the demos and one broken file
+	CHECK( busAccess( REG_FILES, 0 ) == demos.size() + 1, "%u files instead of %u", busAccess( REG_FILES, 0 ), (u32)demos.size() + 1 );
+
+	for ( u32 i = 0; i < demos.size(); i++ )
+	{
+		u32 s = loadByPort( i, out );
+		u32 size = busAccess( REG_SIZE, 0 ) | ( busAccess( REG_SIZE + 1, 0 ) << 8 ) | ( busAccess( REG_SIZE + 2, 0 ) << 16 );
+		CHECK( !( s & DECRUNCH_STATUS_ERROR ) && out == demos[ i ].data, "%s: output through the data port differs", demos[ i ].name );
+		CHECK( size == demos[ i ].data.size(), "%s: size %u instead of %u", demos[ i ].name, size, (u32)demos[ i ].data.size() );
+
+		// the same through the ROML window, 8k at a time
+		u32 n = demos[ i ].data.size();
+		for ( u32 page = 0; page < ( n + 255 ) / 256; page += 32 )
+		{
+			busAccess( REG_WINDOW_HI, 1, page >> 8 );
+			busAccess( REG_WINDOW_LO, 1, page & 255 );
+			u32 ok = ( busAccess( REG_STATUS, 0 ) & DECRUNCH_STATUS_WINDOW ) != 0;
+			for ( u32 a = 0; a < 8192 && page * 256 + a < n; a++ )
+				if ( busAccess( 0x8000 + a, 0 ) != demos[ i ].data[ page * 256 + a ] ) ok = 0;
+			CHECK( ok, "%s: ROML window at page %u differs", demos[ i ].name, page );
+		}
+		busAccess( REG_WINDOW_OFF, 1, 0 );
+		CHECK( !( busAccess( REG_STATUS, 0 ) & DECRUNCH_STATUS_WINDOW ), "ROML window still on" );
+	}
+
+	// a new request while the previous one is being read restarts the output
+	for ( u32 i = 0; i < demos.size(); i++ )
+	{
+		u32 j = ( i + 1 ) % demos.size();
+		loadByPort( i, out, 100 );
+		loadByPort( j, out );
+		CHECK( out == demos[ j ].data, "%s after a partial %s: output differs", demos[ j ].name, demos[ i ].name );
+	}
+
+	// requests for files which do not exist or are broken
+	busAccess( REG_STATUS, 1, demos.size() );
+	CHECK( waitDone() & DECRUNCH_STATUS_ERROR, "no error for a file which does not exist" );
+	busAccess( REG_STATUS, 1, demos.size() + 1 );
+	u32 s = waitDone();
+	CHECK( s & DECRUNCH_STATUS_ERROR, "no error for a broken file" );
+	busAccess( REG_STATUS, 1, 0 );
+	CHECK( !( waitDone() & DECRUNCH_STATUS_ERROR ), "error bit not cleared by the next request" );
+}
+
+//
+// load times
+//
+#define C64_HZ			985248.0	// PAL
+
+// 6510 loops: 'lda port : sta (ptr),y : iny : bne : dex : bne' per byte, 'ldx $df12 : beq' per burst (at most 255 bytes),
+// 'lda $8000,x : sta dest,x' (unrolled) per byte from the ROML window
+#define CYCLES_PORT		20
+#define CYCLES_BURST	6
+#define CYCLES_WINDOW	9
+
+static double ms( double cycles ) { return cycles * 1000 / C64_HZ; }
+
+int main( int argc, char **argv )
+{
+	u32 decrunchCycles = 25;
+	std::vector<const char *> files;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-c" ) && i + 1 < argc )
+			decrunchCycles = atoi( argv[ ++i ] ); else
+		if ( !strcmp( argv[ i ], "-d" ) && i + 2 < argc )
+		{
+			// decrunch a file (e.g. written by the lz4 tool) to check the format
+			FILE *f = fopen( argv[ i + 1 ], "rb" );
+			if ( !f ) { fprintf( stderr, "cannot open %s\n", argv[ i + 1 ] ); return 1; }
+			std::vector<u8> src( 16 << 20 ), out( 16 << 20 );
+			size_t n = fread( src.data(), 1, src.size(), f );
+			fclose( f );
+			int r = decrunchBuffer( src.data(), n, out.data(), out.size() );
+			if ( r < 0 ) { fprintf( stderr, "%s: broken file\n", argv[ i + 1 ] ); return 2; }
+			f = fopen( argv[ i + 2 ], "wb" );
+			if ( !f ) { fprintf( stderr, "cannot write %s\n", argv[ i + 2 ] ); return 1; }
+			fwrite( out.data(), 1, r, f );
+			fclose( f );
+			return 0;
+		} else
+		if ( !strcmp( argv[ i ], "-p" ) && i + 2 < argc )
+		{
+			// pack a file as LZ4 frame (for SD:C64/DECRUNCH, the lz4 tool writes the same format)
+			FILE *f = fopen( argv[ i + 1 ], "rb" );
+			if ( !f ) { fprintf( stderr, "cannot open %s\n", argv[ i + 1 ] ); return 1; }
+			std::vector<u8> src( 16 << 20 );
+			src.resize( fread( src.data(), 1, src.size(), f ) );
+			fclose( f );
+			std::vector<u8> frame = lz4Frame( src.data(), src.size() );
+			f = fopen( argv[ i + 2 ], "wb" );
+			if ( !f ) { fprintf( stderr, "cannot write %s\n", argv[ i + 2 ] ); return 1; }
+			fwrite( frame.data(), 1, frame.size(), f );
+			fclose( f );
+			return 0;
+		} else
+		if ( argv[ i ][ 0 ] != '-' )
+			files.push_back( argv[ i ] ); else
+		{
+			fprintf( stderr, "usage: decrunchbench [-c 6510 cycles per byte for decrunching] [file.prg ...]\n"
+							 "       decrunchbench -p file packed.lz4\n"
+							 "       decrunchbench -d packed.lz4 output\n" );
+			return 1;
+		}
+	}
+
+	srand( 1 );
+	if ( files.empty() )
+		syntheticDemos();
+	for ( u32 i = 0; i < files.size(); i++ )
+	{
+		FILE *f = fopen( files[ i ], "rb" );
+		if ( !f ) { fprintf( stderr, "cannot open %s\n", files[ i ] ); return 1; }
+		DEMO d;
+		d.name = files[ i ];
+		u8 buf[ 4096 ];
+		size_t n;
+		while ( ( n = fread( buf, 1, sizeof( buf ), f ) ) > 0 )
+			d.data.insert( d.data.end(), buf, buf + n );
+		fclose( f );
+		demos.push_back( d );
+	}
+
+	// pack the files and register them with the service, then one broken file
+	static u8 staging[ 1 << 20 ];
+	decrunchInit( &dec, staging, sizeof( staging ) );
+
+	std::vector< std::vector<u8> > packed;
+	for ( u32 i = 0; i < demos.size(); i++ )
+	{
+		if ( demos[ i ].data.size() > sizeof( staging ) ) { fprintf( stderr, "%s is too large\n", demos[ i ].name ); return 1; }
+		packed.push_back( lz4Frame( demos[ i ].data.data(), demos[ i ].data.size() ) );
+	}
+	std::vector<u8> broken = packed[ 0 ];
+	broken[ broken.size() / 2 ] ^= 0xff;
+	broken.resize( broken.size() - 8 );
+	packed.push_back( broken );
+	for ( u32 i = 0; i < packed.size(); i++ )
+		decrunchAddFile( &dec, packed[ i ].data(), packed[ i ].size() );
+
+	// the main loop of kernel_decrunch.cpp
+	volatile u32 stop = 0;
+	std::thread mainLoop( [ & ] { while ( !stop ) decrunchWork( &dec ); } );
+
+	printf( "conformance (main loop in a second thread, the C64 reads while the output is produced)\n" );
+	u64 acc0 = accesses;
+	checkService( packed );
+	printf( "  %u failures, %llu bus accesses, %u polls while waiting for the main loop\n",
+		failures, (unsigned long long)( accesses - acc0 ), waits );
+
+	stop = 1;
+	mainLoop.join();
+
+	// the FIQ side alone: reading the output of the largest file through the data port
+	u32 largest = 0;
+	for ( u32 i = 1; i < demos.size(); i++ )
+		if ( demos[ i ].data.size() > demos[ largest ].data.size() ) largest = i;
+	busAccess( REG_STATUS, 1, largest );
+	decrunchWork( &dec );
+	acc0 = accesses;
+	double t0 = now();
+	for ( u32 i = 0; i < demos[ largest ].data.size(); i++ )
+		busAccess( REG_DATA, 0 );
+	printf( "  %.1f ns per access of the data port\n\n", ( now() - t0 ) * 1e9 / ( accesses - acc0 ) );
+
+	printf( "load times in ms on a PAL C64 (without: packed bytes from the launcher port and decrunching with %u cycles\n"
+			"per byte on the 6510; with: decrunched bytes from $df11 or the ROML window), host time for decrunching\n\n", decrunchCycles );
+	printf( "demo         raw  packed   ratio    without  with port  with ROML  speedup  decrunch us\n" );
+
+	static u8 out[ 1 << 20 ];
+	double sumWithout = 0, sumWith = 0;
+	for ( u32 i = 0; i < demos.size(); i++ )
+	{
+		u32 raw = demos[ i ].data.size(), pk = packed[ i ].size();
+
+		double t = now();
+		u32 reps = 0;
+		int r;
+		do {
+			r = decrunchBuffer( packed[ i ].data(), pk, out, sizeof( out ) );
+			reps ++;
+		} while ( now() - t < 0.05 );
+		double us = ( now() - t ) * 1e6 / reps;
+
+		CHECK( r == (s32)raw && memcmp( out, demos[ i ].data.data(), raw ) == 0, "%s: decrunchBuffer differs", demos[ i ].name );
+
+		double without = (double)pk * CYCLES_PORT + (double)raw * decrunchCycles;
+		double withPort = (double)raw * CYCLES_PORT + ( raw + 254 ) / 255 * CYCLES_BURST;
+		double withROML = (double)raw * CYCLES_WINDOW;
+		sumWithout += without; sumWith += withPort;
+
+		printf( "%-10s %6u %7u %6.1f%% %10.1f %10.1f %10.1f %7.2fx %12.1f\n", demos[ i ].name, raw, pk, 100.0 * pk / raw,
+			ms( without ), ms( withPort ), ms( withROML ), without / withPort, us );
+	}
+	printf( "%-10s %6s %7s %7s %10.1f %10.1f %10s %7.2fx\n", "total", "", "", "", ms( sumWithout ), ms( sumWith ), "", sumWithout / sumWith );
+
+	printf( "\nconformance: %s (%u failures)\n", failures ? "FAILED" : "ok", failures );
+
+	return failures ? 2 : 0;
+}
@@ -0,0 +1,11 @@
+//
+// minimal replacement of Circle's emmc.h for building dirindex.cpp on the host (helpers.h only needs CLogger)
+//
+#ifndef _SDCard_emmc_h
+#define _SDCard_emmc_h
+
+#include <circle/types.h>
+
+class CLogger;
+
+#endif
@@ -0,0 +1,315 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ dirbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - host tool: checks and measures the type-to-find index of the browser
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+//
+// dirbench: fills dir[] with synthetic entries (inserted directory by directory as insertDirectoryContents does),
+// compares the results of dirIndexSearch/dirIndexFind with a brute force search, and measures the time per keystroke
+// for the index and for the linear search which was used before
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "dirscan.h"
+#include "dirindex.h"
+
+DIRENTRY dir[ MAX_DIR_ENTRIES ];
+s32 nDirEntries;
+
+static u32 rnd = 12345;
+static u32 random32()
+{
+	rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+	return rnd;
+}
+
+// names are built from a vocabulary of pseudo words (letters with roughly English frequencies), with
+// "(year)(publisher)" tags and extensions, as in typical collections. With -s only 32 syllables are used
+// which gives very few distinct n-grams (worst case for the index)
+static const char *syllables[] = {
+	"ka", "to", "ra", "mi", "zo", "ne", "lu", "bar", "tan", "gor", "fli", "ster", "pac", "man", "ball", "zap",
+	"dra", "gon", "ish", "tri", "on", "ix", "star", "war", "ri", "der", "ul", "ti", "ma", "quest", "bo", "ulder" };
+
+static const char *suffixes[] = { ".prg", ".d64", ".crt", ".sid", ".PRG", ".D64", ".CRT", ".SID" };
+
+static const u32 nWords = 4000;
+static char words[ nWords ][ 12 ];
+static u32 fewSyllables = 0;
+
+static void makeWords()
+{
+	const char *consonants = "tnshrdlcmwfgypbvkjxqz";	// roughly by frequency
+	const char *vowels = "eaoiu";
+	for ( u32 w = 0; w < nWords; w++ )
+	{
+		u32 l = 2 + random32() % 4, p = 0;
+		for ( u32 i = 0; i < l; i++ )
+		{
+			u32 r = random32();
+			words[ w ][ p ++ ] = consonants[ ( r % 21 ) * ( ( r >> 8 ) % 21 ) / 21 ];
+			words[ w ][ p ++ ] = vowels[ ( r >> 16 ) % 5 ];
+			if ( p > 9 ) break;
+		}
+		words[ w ][ p ] = 0;
+	}
+}
+
+static void randomName( char *s )
+{
+	s[ 0 ] = 0;
+	u32 nw = 1 + random32() % 3;
+	for ( u32 w = 0; w < nw; w++ )
+	{
+		if ( w ) strcat( s, random32() & 1 ? " " : "_" );
+		if ( fewSyllables )
+		{
+			u32 syl = 1 + random32() % 3;
+			for ( u32 i = 0; i < syl; i++ )
+				strcat( s, syllables[ random32() % 32 ] );
+		} else
+		{
+			// skewed towards frequent words
+			u32 r = random32() % nWords;
+			strcat( s, words[ r * ( random32() % nWords ) / nWords ] );
+		}
+	}
+	if ( s[ 0 ] >= 'a' && s[ 0 ] <= 'z' && ( random32() & 1 ) ) s[ 0 ] += 'A' - 'a';
+	if ( random32() % 2 == 0 )
+	{
+		char t[ 48 ];
+		sprintf( t, " (%d)(%s)", 1982 + random32() % 12, words[ random32() % 64 ] );
+		strcat( s, t );
+	}
+	strcat( s, suffixes[ random32() % 8 ] );
+}
+
+// insert 'count' entries behind 'node' and move everything else, as readDirectory does
+static void insertEntries( s32 node, s32 count, u32 level )
+{
+	s32 first = dir[ node ].next;
+	memmove( &dir[ first + count ], &dir[ first ], ( nDirEntries - first ) * sizeof( DIRENTRY ) );
+	for ( s32 i = 0; i < nDirEntries + count; i++ )
+	{
+		if ( i >= first && i < first + count ) continue;
+		if ( dir[ i ].parent != 0xffffffff && dir[ i ].parent >= (u32)first ) dir[ i ].parent += count;
+		if ( dir[ i ].next > (u32)first || ( i != node && dir[ i ].next == (u32)first ) ) dir[ i ].next += count;
+	}
+	for ( s32 i = first; i < first + count; i++ )
+	{
+		randomName( (char*)dir[ i ].name );
+		dir[ i ].f = DIR_PRG_FILE;
+		dir[ i ].parent = node;
+		dir[ i ].level = level;
+		dir[ i ].next = 0;
+	}
+	nDirEntries += count;
+	dir[ node ].next += count;
+	dirIndexAdd( first, count );
+}
+
+//
+// reference implementations
+//
+static int convChar( char c, u32 convert )	// from c64screen.cpp
+{
+	u32 c2 = c;
+	if ( convert == 3 && c >= 'A' && c <= 'Z' )
+		c = c + 'a' - 'A';
+	if ( ( c >= 'a' ) && ( c <= 'z' ) )
+		c2 = c + 1 - 'a';
+	if ( c == '_' )
+		c2 = 100;
+	return c2;
+}
+
+// the linear search of c64screen.cpp before the index
+static s32 linearSearch( s32 searchPos, const char *searchName, int direction )
+{
+	int found = -1, c, l, ls;
+	char name[ 512 ], search[ 32 ];
+
+	ls = strlen( searchName ) < 32 ? strlen( searchName ) : 32;
+	for ( int i = 0; i < ls; i++ )
+		search[ i ] = convChar( searchName[ i ], 3 );
+
+	while ( found == -1 && searchPos < nDirEntries && searchPos >= 0 )
+	{
+		memset( name, 0, 512 );
+		l = (int)strlen( (const char*)dir[ searchPos ].name );
+		if ( ls < l ) l = ls;
+		for ( c = 0; c < l; c++ )
+			if ( search[ c ] != convChar( dir[ searchPos ].name[ c ], 3 ) )
+				break;
+		if ( c == l )
+			found = searchPos; else
+			searchPos += direction;
+	}
+	return found;
+}
+
+static s32 bruteForce( s32 pos, const char *q, int direction )
+{
+	s32 best[ 2 ] = { -1, -1 };	// prefix, substring
+	u32 ql = strlen( q );
+	for ( s32 p = 0; p < nDirEntries; p++ )
+	{
+		const char *n = (const char*)dir[ p ].name;
+		const char *h = strcasestr( n, q );
+		if ( !h || ql == 0 ) continue;
+		u32 prefix = !strncasecmp( n, q, ql );
+		for ( u32 k = 0; k < 2; k++ )
+		{
+			if ( k == 0 && !prefix ) continue;
+			if ( direction > 0 && p >= pos && ( best[ k ] < 0 || p < best[ k ] ) ) best[ k ] = p;
+			if ( direction < 0 && p <= pos && p > best[ k ] ) best[ k ] = p;
+		}
+	}
+	// any prefix match (in any direction) restricts the search to prefix matches
+	for ( s32 p = 0; p < nDirEntries; p++ )
+		if ( ql && !strncasecmp( (const char*)dir[ p ].name, q, ql ) )
+			return best[ 0 ];
+	return best[ 1 ];
+}
+
+static double now()
+{
+	return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+int main( int argc, char **argv )
+{
+	u32 nEntries = 50000;
+	for ( int i = 1; i < argc; i++ )
+		if ( !strcmp( argv[ i ], "-s" ) ) fewSyllables = 1; else
+			nEntries = atoi( argv[ i ] );
+	makeWords();
+	if ( nEntries + 64 > MAX_DIR_ENTRIES ) nEntries = MAX_DIR_ENTRIES - 64;
+
+	// top level directories, then their contents in random order (entries behind the inserted ones are moved)
+	nDirEntries = 0;
+	const u32 nFolders = 32;
+	for ( u32 i = 0; i < nFolders; i++ )
+	{
+		sprintf( (char*)dir[ i ].name, "FOLDER%02d", i );
+		dir[ i ].f = DIR_DIRECTORY;
+		dir[ i ].parent = 0xffffffff;
+		dir[ i ].level = 0;
+		dir[ i ].next = i + 1;
+		nDirEntries ++;
+	}
+	dirIndexClear();
+	dirIndexAdd( 0, nDirEntries );
+
+	double t0 = now();
+	u32 perFolder = ( nEntries - nFolders ) / nFolders, order[ nFolders ];
+	for ( u32 i = 0; i < nFolders; i++ ) order[ i ] = i;
+	for ( u32 i = nFolders - 1; i > 0; i-- ) { u32 j = random32() % ( i + 1 ), t = order[ i ]; order[ i ] = order[ j ]; order[ j ] = t; }
+	for ( u32 i = 0; i < nFolders; i++ )
+	{
+		// find the folder (it has been moved by previous insertions)
+		s32 node = 0;
+		char n[ 16 ];
+		sprintf( n, "FOLDER%02d", order[ i ] );
+		while ( strcmp( (char*)dir[ node ].name, n ) ) node ++;
+		insertEntries( node, perFolder, 1 );
+	}
+	double tBuild = now() - t0;
+
+	printf( "%d entries, index built while inserting in %.1f ms (including moving the entries)\n", nDirEntries, tBuild / 1000.0 );
+
+	// correctness: random queries taken from names, also substrings, and random positions
+	u32 errors = 0;
+	for ( u32 i = 0; i < 2000; i++ )
+	{
+		const char *n = (const char*)dir[ random32() % nDirEntries ].name;
+		u32 l = strlen( n ), s = ( i & 1 ) ? random32() % l : 0, ql = 1 + random32() % 6;
+		if ( s + ql > l ) ql = l - s;
+		char q[ 32 ];
+		memcpy( q, n + s, ql ); q[ ql ] = 0;
+		for ( u32 c = 0; c < ql; c++ )
+			if ( random32() & 1 ) q[ c ] ^= ( q[ c ] >= 'a' && q[ c ] <= 'z' ) || ( q[ c ] >= 'A' && q[ c ] <= 'Z' ) ? 32 : 0;
+
+		s32 pos = random32() % nDirEntries;
+		int direction = ( random32() & 1 ) ? 1 : -1;
+
+		// type the query character by character as in the browser
+		char typed[ 32 ] = { 0 };
+		for ( u32 c = 0; c < ql; c++ )
+		{
+			typed[ c ] = q[ c ];
+			dirIndexSearch( typed );
+		}
+		s32 a = dirIndexFind( pos, direction ), b = bruteForce( pos, q, direction );
+		if ( a != b )
+		{
+			if ( errors ++ < 10 )
+				printf( "mismatch for \"%s\" at %d: index %d, brute force %d\n", q, pos, a, b );
+		}
+	}
+	printf( "2000 queries checked against brute force search: %d mismatches\n", errors );
+
+	// latency per keystroke: typing names (from the beginning or from the middle, up to 12 characters) and strings
+	// which are not found, the cursor is at the top of the list
+	double maxIndex = 0, maxLinear = 0, sumIndex = 0, sumLinear = 0;
+	u32 keys = 0;
+	for ( u32 i = 0; i < 200; i++ )
+	{
+		char q[ 16 ];
+		const char *n = (const char*)dir[ random32() % nDirEntries ].name;
+		u32 l = strlen( n ), s = ( i % 4 == 3 ) ? random32() % l : 0;
+		strncpy( q, n + s, 12 ); q[ 12 ] = 0;
+		if ( i % 10 == 9 ) strcpy( q, "qzxj" );
+
+		char typed[ 32 ] = { 0 };
+		for ( u32 c = 0; q[ c ]; c++ )
+		{
+			typed[ c ] = q[ c ];
+
+			double t = now();
+			dirIndexSearch( typed );
+			volatile s32 a = dirIndexFind( 0, 1 );
+			double dIndex = now() - t;
+
+			t = now();
+			volatile s32 b = linearSearch( 0, typed, 1 );
+			double dLinear = now() - t;
+			(void)a; (void)b;
+
+			if ( getenv( "VERBOSE" ) ) printf( "%-14s index %7.1f us linear %7.1f us\n", typed, dIndex, dLinear );
+			sumIndex += dIndex; sumLinear += dLinear; keys ++;
+			if ( dIndex > maxIndex ) maxIndex = dIndex;
+			if ( dLinear > maxLinear ) maxLinear = dLinear;
+		}
+	}
+	printf( "per keystroke (%d keystrokes): index avg %.1f us max %.1f us, linear search avg %.1f us max %.1f us\n",
+		keys, sumIndex / keys, maxIndex, sumLinear / keys, maxLinear );
+
+	return errors ? 2 : 0;
+}
@@ -0,0 +1,7 @@
+//
+// minimal replacement of FatFs for building dirindex.cpp on the host, nothing is needed from it
+//
+#ifndef _fatfs_ff_h
+#define _fatfs_ff_h
+
+#endif
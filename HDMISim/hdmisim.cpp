@@ -0,0 +1,467 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ hdmisim.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - simulation of the HDMI sound output with clock drift (runs on the host)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <deque>
+
+#include "audioresampler.h"
+
+//
+// Simulation of the HDMI audio output of kernel_sid.cpp with synthetic clock drift (see readme.txt)
+//
+// The C64 (and with it the emulation, which renders at SAMPLERATE relative to the measured clock) runs at
+// SAMPLERATE * ( 1 + drift ) frames per second of the HDMI clock. The main loop runs every few hundred microseconds,
+// sometimes it is stalled for longer, and renders all frames which are due. The sound device is modelled after
+// CVCHIQSoundBaseDevice (Circle/modified) in the manual callback mode of the kernel: the GPU plays chunks of
+// CHUNK_SIZE / 2 frames, when one is complete (handled in the main loop) and no more than one chunk is left, the next
+// one is taken from the queue of QUEUE_SIZE_MSECS (filled up with silence if the queue holds less, an underrun), and
+// the need-data callback sets fillSoundBuffer if the queue is less than half full. The main loop then writes what it
+// has rendered into the queue. Playback starts with two chunks of silence, as the queue is still empty then.
+//
+// "new" is the resampler of ../audioresampler.h with its PI controller, "old" the former adjustment of
+// SAMPLERATE_ADJUSTED (+-1 Hz after averaging 50 measurements, rendering at the adjusted rate). The old target and
+// error are only approximate, as the occupancy it controlled mixed samples and frames.
+//
+
+#define SAMPLERATE			44100
+#define CHUNK_FRAMES		1000			// CHUNK_SIZE in sound.cpp is in samples (s16)
+#define QUEUE_FRAMES		( 50 * SAMPLERATE / 1000 )
+#define PCM_FRAMES			( 48000 / 4 / 2 )
+
+typedef struct
+{
+	const char *name;
+	double ppm;							// constant drift
+	double wanderPpm, wanderPeriod;		// sinusoidal drift (e.g. temperature)
+	double stepPpm, stepTime;			// drift changing at once
+	double stallEvery, stallMs;			// main loop stalls: on average every 'stallEvery' seconds for up to 'stallMs'
+} SCENARIO;
+
+static const SCENARIO scenarios[] =
+{
+	{ "const",    80.0,  0.0,  0.0,   0.0,  0.0, 0.5,  5.0 },
+	{ "negative", -250.0, 0.0,  0.0,   0.0,  0.0, 0.5,  5.0 },
+	{ "wander",   40.0,  60.0, 40.0,  0.0,  0.0, 0.5,  5.0 },
+	{ "step",     20.0,  0.0,  0.0,   300.0, 60.0, 0.5, 5.0 },
+	{ "stalls",   80.0,  0.0,  0.0,   0.0,  0.0, 0.1, 15.0 },
+};
+#define NUM_SCENARIOS	( sizeof( scenarios ) / sizeof( SCENARIO ) )
+
+static u32 rnd = 0x13572468;
+static double rnd01()
+{
+	rnd = rnd * 1664525 + 1013904223;
+	return ( rnd >> 8 ) * ( 1.0 / 16777216.0 );
+}
+
+static double drift( const SCENARIO *s, double t )
+{
+	double d = s->ppm;
+	if ( s->wanderPeriod > 0.0 )
+		d += s->wanderPpm * sin( 2.0 * M_PI * t / s->wanderPeriod );
+	if ( s->stepTime > 0.0 && t >= s->stepTime )
+		d += s->stepPpm;
+	return d * 1e-6;
+}
+
+typedef struct
+{
+	double t, occupancy, target, error, correctionPpm, driftPpm, latencyMs;
+} TRACE;
+
+typedef struct
+{
+	double latencySum, latencyTime;			// end-to-end latency (rendered to played) averaged over time
+	double errSum, errSqr, errMax;			// occupancy error after the settling time
+	double ppmSqr;							// correction - drift after the settling time
+	u32 nErr;
+	u32 underrunFrames;						// silence in the chunks (after the start)
+	u32 overflows;							// PCMBuffer full
+	std::deque<TRACE> trace;
+} RESULT;
+
+static void simulate( const SCENARIO *s, int useResampler, u32 targetFrames, double seconds, double settle, RESULT *r )
+{
+	memset( (void*)r, 0, sizeof( RESULT ) - sizeof( r->trace ) );
+	r->trace.clear();
+
+	AUDIO_RESAMPLER rs;
+	AUDIO_RATE_CONTROL rc;
+	audioResamplerInit( &rs );
+	audioRateControlInit( &rc, targetFrames, SAMPLERATE );
+
+	// old controller
+	u32 rateAdjusted = SAMPLERATE;
+	s32 avgSamplesAvail = 0, avgCounter = 0, targetSamplesAvail = 0, targetCount = 0;
+
+	u32 pending = 0, queue = 0;				// frames rendered (PCMBuffer), frames in the queue of the device
+	std::deque<u32> inflight;				// chunks sent to the GPU
+	double played = 0.0;					// frames of the first chunk played
+	u32 completions = 0, fill = 0, started = 0;
+
+	double t = 0.0, inputPhase = 0.0;
+	u64 inputFrames = 0, inputAtUpdate = 0;
+	double nextStall = s->stallEvery * rnd01() * 2.0;
+	s16 out[ 2 * AUDIO_RESAMPLER_MAX_OUT ];
+
+	while ( t < seconds )
+	{
+		// time until the next run of the main loop
+		double dt = ( 200.0 + 1800.0 * rnd01() ) * 1e-6;
+		if ( s->stallEvery > 0.0 && t >= nextStall )
+		{
+			dt += s->stallMs * 1e-3 * rnd01();
+			nextStall = t + s->stallEvery * rnd01() * 2.0;
+		}
+
+		// the GPU plays at the HDMI clock, completed chunks are handled by the main loop
+		double toPlay = dt * SAMPLERATE;
+		while ( toPlay > 0.0 && started && !inflight.empty() )
+		{
+			double n = inflight.front() - played;
+			if ( n > toPlay ) n = toPlay;
+			played += n;
+			toPlay -= n;
+			if ( played >= inflight.front() - 1e-9 )
+			{
+				inflight.pop_front();
+				played = 0.0;
+				completions ++;
+			}
+		}
+
+		double inflightFrames = -played;
+		for ( size_t i = 0; i < inflight.size(); i++ )
+			inflightFrames += inflight[ i ];
+
+		// end-to-end latency: rendered frames wait in PCMBuffer, the queue and the GPU
+		if ( started )
+		{
+			r->latencySum += ( pending + queue + inflightFrames ) * 1000.0 / SAMPLERATE * dt;
+			r->latencyTime += dt;
+		}
+
+		t += dt;
+
+		// VCHIQ callbacks (manual mode): the next chunk if no more than one is left
+		for ( ; completions; completions -- )
+		{
+			if ( inflightFrames <= CHUNK_FRAMES )
+			{
+				u32 n = queue < CHUNK_FRAMES ? queue : CHUNK_FRAMES;
+				r->underrunFrames += CHUNK_FRAMES - n;
+				inflight.push_back( CHUNK_FRAMES );
+				inflightFrames += CHUNK_FRAMES;
+				queue -= n;
+			}
+			if ( queue < QUEUE_FRAMES / 2 )
+				fill = 1;
+		}
+
+		// start playback once enough has been rendered
+		if ( !started )
+		{
+			u32 startFrames = useResampler ? targetFrames : 9 * QUEUE_FRAMES / 2;
+			if ( ( useResampler ? pending : inputFrames ) >= startFrames )
+			{
+				started = fill = 1;
+				inflight.push_back( CHUNK_FRAMES );
+				inflight.push_back( CHUNK_FRAMES );
+			}
+		}
+
+		if ( fill && started )
+		{
+			fill = 0;
+			u32 occupancy = pending + queue;
+
+			if ( useResampler )
+			{
+				audioResamplerSetRatio( &rs, audioRateControlUpdate( &rc, occupancy, (u32)( inputFrames - inputAtUpdate ) ) );
+				inputAtUpdate = inputFrames;
+			} else
+			{
+				// as in kernel_sid.cpp before: "computed - free" averaged over 50 calls, where samplesInBuffer() counted
+				// samples (s16), not frames
+				s32 avail = 2 * (s32)pending - (s32)( QUEUE_FRAMES - queue );
+				avgSamplesAvail += avail;
+				if ( ++ avgCounter > 50 )
+				{
+					avail = avgSamplesAvail / avgCounter;
+					if ( targetSamplesAvail == 0 && ++ targetCount > 10 )
+						targetSamplesAvail = avail > (s32)QUEUE_FRAMES ? avail : (s32)QUEUE_FRAMES;
+					if ( targetSamplesAvail != 0 )
+					{
+						if ( avail < targetSamplesAvail )
+						{
+							if ( avail < 5 * targetSamplesAvail / 100 && rateAdjusted < SAMPLERATE )
+								rateAdjusted = SAMPLERATE; else
+								rateAdjusted ++;
+						} else
+						if ( avail > targetSamplesAvail )
+						{
+							if ( avail > 105 * targetSamplesAvail / 100 && rateAdjusted > SAMPLERATE )
+								rateAdjusted = SAMPLERATE; else
+								rateAdjusted --;
+						}
+					}
+					avgSamplesAvail = avgCounter = 0;
+				}
+			}
+
+			double target = useResampler ? targetFrames : ( targetSamplesAvail ? ( targetSamplesAvail + QUEUE_FRAMES ) / 2 : 0 );
+			double d = drift( s, t );
+			TRACE tr = { t, (double)occupancy, target, useResampler ? rc.error : occupancy - target,
+				useResampler ? rc.correction * 1e6 : ( (double)SAMPLERATE / rateAdjusted - 1.0 ) * 1e6, d * 1e6,
+				( occupancy + inflightFrames ) * 1000.0 / SAMPLERATE };
+			r->trace.push_back( tr );
+
+			if ( t >= settle && target > 0 )
+			{
+				double e = occupancy - target;
+				r->errSum += e;
+				r->errSqr += e * e;
+				if ( fabs( e ) > r->errMax ) r->errMax = fabs( e );
+				r->ppmSqr += ( tr.correctionPpm - tr.driftPpm ) * ( tr.correctionPpm - tr.driftPpm );
+				r->nErr ++;
+			}
+
+			u32 n = QUEUE_FRAMES - queue;
+			if ( n > pending ) n = pending;
+			queue += n; pending -= n;
+		}
+
+		// render everything that is due (the old controller renders at the adjusted rate)
+		double rate = SAMPLERATE * ( 1.0 + drift( s, t ) );
+		if ( !useResampler )
+			rate *= (double)rateAdjusted / SAMPLERATE;
+		inputPhase += rate * dt;
+		for ( ; inputPhase >= 1.0; inputPhase -= 1.0 )
+		{
+			inputFrames ++;
+			pending += useResampler ? audioResamplerPut( &rs, 0, 0, out ) : 1;
+		}
+
+		if ( pending > PCM_FRAMES )
+		{
+			r->overflows ++;
+			pending = PCM_FRAMES;
+		}
+	}
+}
+
+//
+// interpolation error of the resampler for sine waves at a fixed ratio
+//
+static double resamplerSNR( double freq, double ratio )
+{
+	AUDIO_RESAMPLER rs;
+	audioResamplerInit( &rs );
+	audioResamplerSetRatio( &rs, ratio );
+
+	double w = 2.0 * M_PI * freq / SAMPLERATE, sig = 0.0, err = 0.0;
+	u64 pos = 0;
+	s16 out[ 2 * AUDIO_RESAMPLER_MAX_OUT ];
+
+	for ( u32 m = 0; m < SAMPLERATE * 2; m++ )
+	{
+		s32 v = (s32)floor( 16000.0 * sin( w * m ) + 0.5 );
+		u32 n = audioResamplerPut( &rs, v, v, out );
+		for ( u32 i = 0; i < n; i++ )
+		{
+			// output i lies at 'pos' after input frame m - 2
+			double x = (double)m - 2.0 + (double)pos / 4294967296.0;
+			pos += rs.step;
+			if ( m < 16 ) continue;
+			double ref = 16000.0 * sin( w * x );
+			sig += ref * ref;
+			err += ( out[ 2 * i ] - ref ) * ( out[ 2 * i ] - ref );
+		}
+		pos -= 1ULL << 32;
+	}
+	return 10.0 * log10( sig / err );
+}
+
+// ASCII plot of one column of the trace
+static void plot( const std::deque<TRACE> &trace, double TRACE::*y, double TRACE::*y2, const char *title, double seconds )
+{
+	const int W = 72, H = 11;
+	char grid[ H ][ W + 1 ];
+	double ymin = 1e30, ymax = -1e30;
+
+	for ( size_t i = 0; i < trace.size(); i++ )
+	{
+		ymin = fmin( ymin, trace[ i ].*y ); ymax = fmax( ymax, trace[ i ].*y );
+		if ( y2 ) { ymin = fmin( ymin, trace[ i ].*y2 ); ymax = fmax( ymax, trace[ i ].*y2 ); }
+	}
+	if ( ymax - ymin < 1e-9 ) { ymax += 1.0; ymin -= 1.0; }
+
+	memset( grid, ' ', sizeof( grid ) );
+	for ( int j = 0; j < H; j++ )
+		grid[ j ][ W ] = 0;
+
+	for ( size_t i = 0; i < trace.size(); i++ )
+	{
+		int x = (int)( trace[ i ].t / seconds * ( W - 1 ) );
+		if ( x >= W ) x = W - 1;
+		if ( y2 )
+		{
+			int j = (int)( ( ymax - trace[ i ].*y2 ) / ( ymax - ymin ) * ( H - 1 ) + 0.5 );
+			grid[ j ][ x ] = '-';
+		}
+		int j = (int)( ( ymax - trace[ i ].*y ) / ( ymax - ymin ) * ( H - 1 ) + 0.5 );
+		grid[ j ][ x ] = '*';
+	}
+
+	printf( "  %s\n", title );
+	for ( int j = 0; j < H; j++ )
+		printf( "  %8.0f |%s\n", ymax - ( ymax - ymin ) * j / ( H - 1 ), grid[ j ] );
+	printf( "           +%.*s\n            0 s%*s%.0f s\n", W, "------------------------------------------------------------------------------------------------", W - 8, "", seconds );
+}
+
+static void writeCSV( const char *prefix, const char *name, const char *mode, const RESULT *r )
+{
+	char fn[ 1024 ];
+	snprintf( fn, sizeof( fn ), "%s_%s_%s.csv", prefix, name, mode );
+	FILE *f = fopen( fn, "wt" );
+	if ( f == NULL )
+	{
+		fprintf( stderr, "cannot write %s\n", fn );
+		return;
+	}
+	fprintf( f, "time,occupancy,target,error,correction_ppm,drift_ppm,latency_ms\n" );
+	for ( size_t i = 0; i < r->trace.size(); i++ )
+	{
+		const TRACE &t = r->trace[ i ];
+		fprintf( f, "%.4f,%.0f,%.0f,%.1f,%.1f,%.1f,%.2f\n", t.t, t.occupancy, t.target, t.error, t.correctionPpm, t.driftPpm, t.latencyMs );
+	}
+	fclose( f );
+}
+
+static void report( const char *mode, const RESULT *r )
+{
+	double n = r->nErr ? r->nErr : 1;
+	printf( "  %-4s latency %6.1f ms, occupancy error mean %7.1f rms %7.1f max %6.0f frames, correction-drift rms %6.1f ppm, "
+		"underruns %u frames, overflows %u\n", mode, r->latencyTime > 0.0 ? r->latencySum / r->latencyTime : 0.0,
+		r->errSum / n, sqrt( r->errSqr / n ), r->errMax, sqrt( r->ppmSqr / n ), r->underrunFrames, r->overflows );
+}
+
+static void usage()
+{
+	printf( "usage: hdmisim [options]\n" );
+	printf( "  -l ms          target latency of the resampler (occupancy of PCMBuffer and queue, default 40)\n" );
+	printf( "  -s seconds     simulated time per scenario (default 180)\n" );
+	printf( "  -c name        only this scenario (const, negative, wander, step, stalls)\n" );
+	printf( "  -p             plot occupancy error and correction/drift of the resampler\n" );
+	printf( "  -o prefix      write the traces to prefix_<scenario>_<new|old>.csv\n" );
+}
+
+int main( int argc, char **argv )
+{
+	double latencyMs = 40.0, seconds = 180.0;
+	const char *only = NULL, *csv = NULL;
+	int doPlot = 0;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[ i ], "-p" ) == 0 ) { doPlot = 1; continue; }
+		if ( argv[ i ][ 0 ] == '-' && i + 1 < argc )
+		{
+			switch ( argv[ i ][ 1 ] )
+			{
+			case 'l': latencyMs = atof( argv[ ++i ] ); continue;
+			case 's': seconds = atof( argv[ ++i ] ); continue;
+			case 'c': only = argv[ ++i ]; continue;
+			case 'o': csv = argv[ ++i ]; continue;
+			}
+		}
+		usage();
+		return 1;
+	}
+
+	if ( latencyMs <= 0.0 || seconds <= 0.0 )
+	{
+		usage();
+		return 1;
+	}
+
+	u32 targetFrames = (u32)( latencyMs * SAMPLERATE / 1000.0 );
+	double settle = seconds / 6.0;
+
+	printf( "resampler: SNR of sine waves at a ratio of 1.002: 1 kHz %.1f dB, 5 kHz %.1f dB, 10 kHz %.1f dB\n",
+		resamplerSNR( 1000.0, 1.002 ), resamplerSNR( 5000.0, 1.002 ), resamplerSNR( 10000.0, 1.002 ) );
+	printf( "target latency %.1f ms (%u frames), errors after %.0f s, latency includes the chunks in the GPU\n", latencyMs, targetFrames, settle );
+
+	u32 failed = 0, found = 0;
+	RESULT rNew, rOld;
+
+	for ( u32 i = 0; i < NUM_SCENARIOS; i++ )
+	{
+		const SCENARIO *s = &scenarios[ i ];
+		if ( only && strcmp( only, s->name ) )
+			continue;
+		found ++;
+
+		printf( "%s: drift %.0f ppm", s->name, s->ppm );
+		if ( s->wanderPeriod > 0.0 ) printf( " +- %.0f ppm (period %.0f s)", s->wanderPpm, s->wanderPeriod );
+		if ( s->stepTime > 0.0 ) printf( ", %+.0f ppm after %.0f s", s->stepPpm, s->stepTime );
+		printf( ", main loop stalls up to %.0f ms\n", s->stallMs );
+
+		rnd = 0x13572468 + i;
+		simulate( s, 1, targetFrames, seconds, settle, &rNew );
+		rnd = 0x13572468 + i;
+		simulate( s, 0, targetFrames, seconds, settle, &rOld );
+		report( "new", &rNew );
+		report( "old", &rOld );
+
+		if ( doPlot )
+		{
+			plot( rNew.trace, &TRACE::error, NULL, "new: smoothed occupancy error (frames)", seconds );
+			plot( rNew.trace, &TRACE::correctionPpm, &TRACE::driftPpm, "new: correction (*) and drift (-) in ppm", seconds );
+		}
+		if ( csv )
+		{
+			writeCSV( csv, s->name, "new", &rNew );
+			writeCSV( csv, s->name, "old", &rOld );
+		}
+
+		failed += rNew.underrunFrames || rNew.overflows;
+	}
+
+	if ( !found )
+	{
+		usage();
+		return 1;
+	}
+
+	return failed ? 2 : 0;
+}
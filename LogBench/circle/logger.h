@@ -0,0 +1,125 @@
+//
+// replacement of Circle's logger.h for logbench: models the work of CLogger::Write on the host
+//
+// Circle formats the time stamp and the message into CString objects (heap allocations), appends them to the
+// text buffer of the logger, keeps the last messages as events (allocated per message) and writes the text
+// to the log device. The device is a sink here, its cost on the RPi (screen, serial) is estimated by logbench.
+//
+#ifndef _circle_logger_h
+#define _circle_logger_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+enum TLogSeverity
+{
+	LogPanic,
+	LogError,
+	LogWarning,
+	LogNotice,
+	LogDebug
+};
+
+#define LOGGER_BUFSIZE		0x4000
+#define LOG_MAX_EVENTS		50
+#define LOG_MAX_SOURCE		50
+#define LOG_MAX_MESSAGE		200
+
+class CLogger
+{
+public:
+	CLogger() : m_nInPtr( 0 ), m_nEvents( 0 ), m_nEventFirst( 0 ), m_nBytes( 0 ), m_nMessages( 0 ), m_pEcho( NULL ) {}
+
+	void Write( const char *pSource, TLogSeverity Severity, const char *pMessage, ... )
+	{
+		va_list var;
+		va_start( var, pMessage );
+		WriteV( pSource, Severity, pMessage, var );
+		va_end( var );
+	}
+
+	void WriteV( const char *pSource, TLogSeverity Severity, const char *pMessage, va_list Args )
+	{
+		// time stamp (CTimer::GetTimeString)
+		char *pTime = (char *)malloc( 32 );
+		unsigned t = (unsigned)clock();
+		snprintf( pTime, 32, "%02u:%02u:%02u.%02u ", t / 360000000 % 24, t / 6000000 % 60, t / 100000 % 60, t / 1000 % 100 );
+
+		char *pText = (char *)malloc( LOG_MAX_MESSAGE );
+		vsnprintf( pText, LOG_MAX_MESSAGE, pMessage, Args );
+
+		size_t nLength = strlen( pTime ) + strlen( pSource ) + 2 + strlen( pText ) + 1;
+		char *pBuffer = (char *)malloc( nLength + 1 );
+		strcpy( pBuffer, pTime );
+		strcat( pBuffer, pSource );
+		strcat( pBuffer, ": " );
+		strcat( pBuffer, pText );
+		strcat( pBuffer, "\n" );
+
+		// log device
+		Output( pBuffer, nLength );
+
+		// text buffer
+		for ( size_t i = 0; i < nLength; i++ )
+		{
+			m_Buffer[ m_nInPtr ] = pBuffer[ i ];
+			m_nInPtr = ( m_nInPtr + 1 ) % LOGGER_BUFSIZE;
+		}
+
+		// event list
+		TLogEvent *pEvent = new TLogEvent;
+		pEvent->Severity = Severity;
+		strncpy( pEvent->Source, pSource, LOG_MAX_SOURCE );
+		pEvent->Source[ LOG_MAX_SOURCE - 1 ] = 0;
+		strncpy( pEvent->Message, pText, LOG_MAX_MESSAGE );
+		pEvent->Message[ LOG_MAX_MESSAGE - 1 ] = 0;
+		if ( m_nEvents == LOG_MAX_EVENTS )
+		{
+			delete m_pEvent[ m_nEventFirst ];
+			m_pEvent[ m_nEventFirst ] = pEvent;
+			m_nEventFirst = ( m_nEventFirst + 1 ) % LOG_MAX_EVENTS;
+		} else
+			m_pEvent[ m_nEvents++ ] = pEvent;
+
+		free( pBuffer );
+		free( pText );
+		free( pTime );
+
+		if ( Severity == LogPanic )
+			exit( 1 );
+	}
+
+	// the text written to the log device is echoed to 'f' (NULL: discarded)
+	void SetEcho( FILE *f ) { m_pEcho = f; }
+
+	unsigned long long GetBytes() { return m_nBytes; }
+	unsigned long long GetMessages() { return m_nMessages; }
+
+private:
+	struct TLogEvent
+	{
+		TLogSeverity Severity;
+		char Source[ LOG_MAX_SOURCE ];
+		char Message[ LOG_MAX_MESSAGE ];
+	};
+
+	void Output( const char *p, size_t n )
+	{
+		m_nBytes += n;
+		m_nMessages ++;
+		if ( m_pEcho )
+			fwrite( p, 1, n, m_pEcho );
+	}
+
+	char m_Buffer[ LOGGER_BUFSIZE ];
+	unsigned m_nInPtr;
+	TLogEvent *m_pEvent[ LOG_MAX_EVENTS ];
+	unsigned m_nEvents, m_nEventFirst;
+	unsigned long long m_nBytes, m_nMessages;
+	FILE *m_pEcho;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ logbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - compares deferred logging (logring.h) with CLogger::Write
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+//
+// logbench: checks the deferred formatting of ../logring.cpp against printf and compares the cost of a LOGRING call
+// with CLogger::Write (modelled by circle/logger.h in this directory)
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "logring.h"
+
+static u32 nErrors = 0;
+
+static void compare( int line, const char *fmt, const char *got, const char *expected )
+{
+	if ( strcmp( got, expected ) == 0 )
+		return;
+	printf( "line %d: \"%s\" -> \"%s\", expected \"%s\"\n", line, fmt, got, expected );
+	nErrors ++;
+}
+
+// formats through the ring and with snprintf
+#define CHECK( ... ) check( __LINE__, __VA_ARGS__ )
+
+#pragma GCC diagnostic ignored "-Wformat-security"
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+
+template <typename... A>
+static void check( int line, const char *fmt, A... args )
+{
+	logRingWrite( LOGRING_WEB, LogNotice, "check", fmt, args... );
+
+	char got[ 512 ], expected[ 512 ];
+	logRingFormat( &logRing[ ( logRingWritePos - 1 ) & ( LOGRING_ENTRIES - 1 ) ], got, sizeof( got ) );
+	snprintf( expected, sizeof( expected ), fmt, args... );
+	logRingReadPos = logRingWritePos;
+
+	compare( line, fmt, got, expected );
+}
+
+static void checkFormatting()
+{
+	char name[ 64 ] = "SD:C64/games/giana.prg";
+	const char *null = NULL;
+
+	CHECK( "no arguments" );
+	CHECK( "%d %i %d", -5, 123456, 0 );
+	CHECK( "%u %u", 4000000000u, (unsigned char)200 );
+	CHECK( "%x %X %08x %#x %o", 0xdeadbeef, 255, 4096, 17, 8 );
+	CHECK( "%ld %lu %lld %llu %zu", -1L, 1UL << 40, -(1LL << 50), ~0ULL, sizeof( LOGRING_ENTRY ) );
+	CHECK( "%5d|%-5d|%+d|%05d", 42, 42, 42, -42 );
+	CHECK( "%c%c%c", 'a', 66, '!' );
+	CHECK( "%s, %-8s|%8s|%.3s", "abc", "left", "right", "truncated" );
+	CHECK( "%f %.2f %8.3f %e %g", 3.14159, 2.0 / 3, -1.5f, 12345.678, 0.0001 );
+	CHECK( "100%% %s", name );
+	CHECK( "%s %d %s %u %s %x", "a", -1, "b", 2u, "c", 0xabc );
+
+	// the string in the buffer is a copy: changing it afterwards does not change the message
+	logRingWrite( LOGRING_MENU, LogNotice, "check", "filename: %s", name );
+	strcpy( name, "changed" );
+	char got[ 512 ];
+	logRingFormat( &logRing[ ( logRingWritePos - 1 ) & ( LOGRING_ENTRIES - 1 ) ], got, sizeof( got ) );
+	logRingReadPos = logRingWritePos;
+	compare( __LINE__, "filename: %s", got, "filename: SD:C64/games/giana.prg" );
+
+	// strings which do not fit are cut, the following ones are empty
+	char longString[ 100 ];
+	memset( longString, 'x', 99 );
+	longString[ 99 ] = 0;
+	logRingWrite( LOGRING_MENU, LogNotice, "check", "%s|%s|%d", longString, "more", 7 );
+	logRingFormat( &logRing[ ( logRingWritePos - 1 ) & ( LOGRING_ENTRIES - 1 ) ], got, sizeof( got ) );
+	logRingReadPos = logRingWritePos;
+	char expected[ 512 ];
+	snprintf( expected, sizeof( expected ), "%.*s||7", LOGRING_STRINGS - 1, longString );
+	compare( __LINE__, "%s|%s|%d", got, expected );
+
+	logRingWrite( LOGRING_MENU, LogNotice, "check", "[%s]", null );
+	logRingFormat( &logRing[ ( logRingWritePos - 1 ) & ( LOGRING_ENTRIES - 1 ) ], got, sizeof( got ) );
+	logRingReadPos = logRingWritePos;
+	compare( __LINE__, "[%s]", got, "[]" );
+
+	// messages above the level of their subsystem are not stored, a full ring drops messages
+	u32 w = logRingWritePos;
+	LOGRING( LOGRING_MODEM, LogDebug, "check", "debug %d", 1 );
+	if ( logRingWritePos != w )
+	{
+		printf( "message above the level was stored\n" );
+		nErrors ++;
+	}
+
+	for ( u32 i = 0; i < LOGRING_ENTRIES + 10; i++ )
+		LOGRING( LOGRING_MODEM, LogNotice, "check", "message %u", i );
+	if ( logRingPending() != LOGRING_ENTRIES || logRingDropped != 10 )
+	{
+		printf( "full ring: %u pending, %u dropped\n", logRingPending(), logRingDropped );
+		nErrors ++;
+	}
+
+	CLogger logger;
+	u32 n = logRingFlush( &logger );
+	if ( n != LOGRING_ENTRIES || logger.GetMessages() != LOGRING_ENTRIES + 1 || logRingPending() != 0 )
+	{
+		printf( "flush: %u messages, %llu written\n", n, logger.GetMessages() );
+		nErrors ++;
+	}
+}
+
+//
+// timing
+//
+typedef std::chrono::steady_clock Clock;
+
+static double nsSince( Clock::time_point t )
+{
+	return std::chrono::duration<double, std::nano>( Clock::now() - t ).count();
+}
+
+#define BATCH	( LOGRING_ENTRIES / 2 )
+
+// the messages of the modem emulation, the form parsing of the web server and the launch path of the menu
+#define MESSAGE_MODEM( W )	W( LOGRING_MODEM, LogNotice, "CSidekickNet", "Terminal: wrote %u chars to frontend", 1460u + ( i & 7 ) )
+#define MESSAGE_WEB( W )	W( LOGRING_WEB, LogNotice, "webserver", "Parsing form data: Assigning timingValue key=%i value=%i", (int)( i & 7 ), 420 + (int)( i & 15 ) )
+#define MESSAGE_LAUNCH( W )	W( LOGRING_MENU, LogNotice, "RaspiMenu", "filename from d64: %s", launchName )
+
+#define WRITE_CLOGGER( sub, sev, src, ... )	logger.Write( src, sev, __VA_ARGS__ )
+
+static const char *launchName = "SD:C64/GAMES/the great giana sisters [cracked].prg";
+
+#define BENCH( name, MESSAGE )																		\
+	{																								\
+		CLogger logger;																				\
+		double tLogger = 0, tRing = 0, tOff = 0, tFlush = 0;										\
+		u32 bytes;																					\
+		for ( u32 rep = 0; rep < repeat; rep++ )													\
+		{																							\
+			Clock::time_point t = Clock::now();														\
+			for ( u32 i = 0; i < BATCH; i++ )														\
+			{																						\
+				MESSAGE( WRITE_CLOGGER );															\
+				asm volatile( "" ::: "memory" );													\
+			}																						\
+			tLogger += nsSince( t );																\
+																									\
+			t = Clock::now();																		\
+			for ( u32 i = 0; i < BATCH; i++ )														\
+			{																						\
+				MESSAGE( LOGRING );																	\
+				asm volatile( "" ::: "memory" );													\
+			}																						\
+			tRing += nsSince( t );																	\
+																									\
+			t = Clock::now();																		\
+			logRingFlush( &logger );																\
+			tFlush += nsSince( t );																	\
+																									\
+			u8 level = logRingLevel[ LOGRING_MODEM ];												\
+			for ( u32 s = 0; s < LOGRING_SUBSYSTEMS; s++ ) logRingLevel[ s ] = LogWarning;			\
+			t = Clock::now();																		\
+			for ( u32 i = 0; i < BATCH; i++ )														\
+			{																						\
+				MESSAGE( LOGRING );																	\
+				asm volatile( "" ::: "memory" );													\
+			}																						\
+			tOff += nsSince( t );																	\
+			for ( u32 s = 0; s < LOGRING_SUBSYSTEMS; s++ ) logRingLevel[ s ] = level;				\
+		}																							\
+		double n = (double)repeat * BATCH;															\
+		bytes = (u32)( logger.GetBytes() / logger.GetMessages() );									\
+		printf( "%-8s %10.1f %10.1f %10.1f %10.1f %10u %10.0f\n", name, tLogger / n, tRing / n, tOff / n,	\
+				tFlush / n, bytes, bytes * 1e6 / 11520.0 );												\
+	}
+
+int main( int argc, char **argv )
+{
+	u32 repeat = 2000;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[ i ], "-r" ) == 0 && i + 1 < argc )
+		{
+			repeat = atoi( argv[ ++i ] );
+			continue;
+		}
+		fprintf( stderr, "usage: logbench [-r repetitions of %d messages]\n", BATCH );
+		return 1;
+	}
+
+	checkFormatting();
+	printf( "formatting: %s (%u differences)\n\n", nErrors ? "FAILED" : "ok", nErrors );
+
+	printf( "time per message in ns: CLogger::Write, LOGRING (stored), LOGRING (level off), logRingFlush (deferred),\n"
+			"length of the message and the time to send it at 115200 baud if the log goes to the serial port (in us)\n\n" );
+	printf( "message   CLogger    LOGRING        off      flush      bytes  serial us\n" );
+
+	BENCH( "modem", MESSAGE_MODEM )
+	BENCH( "web", MESSAGE_WEB )
+	BENCH( "launch", MESSAGE_LAUNCH )
+
+	return nErrors ? 2 : 0;
+}
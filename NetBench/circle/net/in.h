@@ -0,0 +1,9 @@
+//
+// Circle's in.h defines the protocol numbers, on the host they come from the system
+//
+#ifndef _circle_net_in_h
+#define _circle_net_in_h
+
+#include <netinet/in.h>
+
+#endif
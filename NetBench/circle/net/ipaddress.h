@@ -0,0 +1,31 @@
+//
+// minimal replacement of Circle's CIPAddress (IPv4 address in network byte order)
+//
+#ifndef _circle_net_ipaddress_h
+#define _circle_net_ipaddress_h
+
+#include <circle/types.h>
+#include <string.h>
+
+class CIPAddress
+{
+public:
+	CIPAddress( void ) : m_nAddress( 0 ) {}
+	CIPAddress( u32 nAddress ) : m_nAddress( nAddress ) {}
+
+	boolean operator == ( const CIPAddress &rAddress2 ) const { return m_nAddress == rAddress2.m_nAddress; }
+	boolean operator != ( const CIPAddress &rAddress2 ) const { return m_nAddress != rAddress2.m_nAddress; }
+
+	operator u32( void ) const { return m_nAddress; }
+
+	void Set( u32 nAddress ) { m_nAddress = nAddress; }
+	void Set( const u8 *pAddress ) { memcpy( &m_nAddress, pAddress, 4 ); }
+	void Set( const CIPAddress &rAddress ) { m_nAddress = rAddress.m_nAddress; }
+
+	void CopyTo( u8 *pBuffer ) const { memcpy( pBuffer, &m_nAddress, 4 ); }
+
+private:
+	u32 m_nAddress;
+};
+
+#endif
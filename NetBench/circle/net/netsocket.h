@@ -0,0 +1,20 @@
+//
+// minimal replacement of Circle's CNetSocket
+//
+#ifndef _circle_net_netsocket_h
+#define _circle_net_netsocket_h
+
+#include <circle/types.h>
+#include <circle/net/ipaddress.h>
+
+class CNetSocket
+{
+public:
+	virtual ~CNetSocket( void ) {}
+
+	virtual int Connect( CIPAddress &rForeignIP, u16 nForeignPort ) = 0;
+	virtual int Send( const void *pBuffer, unsigned nLength, int nFlags ) = 0;
+	virtual int Receive( void *pBuffer, unsigned nLength, int nFlags ) = 0;
+};
+
+#endif
@@ -0,0 +1,11 @@
+//
+// the network subsystem is only passed through to the sockets, which use the host's network stack
+//
+#ifndef _circle_net_netsubsystem_h
+#define _circle_net_netsubsystem_h
+
+class CNetSubSystem
+{
+};
+
+#endif
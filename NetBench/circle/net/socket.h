@@ -0,0 +1,55 @@
+//
+// minimal replacement of Circle's CSocket (TCP only) on top of the host's sockets,
+// Receive blocks unless MSG_DONTWAIT is given and returns a negative value once the connection is closed
+//
+#ifndef _circle_net_socket_h
+#define _circle_net_socket_h
+
+#include <circle/net/netsocket.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/in.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <errno.h>
+
+class CSocket : public CNetSocket
+{
+public:
+	CSocket( CNetSubSystem *pNetSubSystem, int nProtocol ) : m_hSocket( socket( AF_INET, SOCK_STREAM, 0 ) ) {}
+	// only here: a connection the harness has accepted
+	CSocket( int hSocket ) : m_hSocket( hSocket ) {}
+	~CSocket( void ) { if ( m_hSocket >= 0 ) close( m_hSocket ); }
+
+	int Connect( CIPAddress &rForeignIP, u16 nForeignPort )
+	{
+		struct sockaddr_in a;
+		memset( &a, 0, sizeof( a ) );
+		a.sin_family = AF_INET;
+		a.sin_port = htons( nForeignPort );
+		a.sin_addr.s_addr = (u32)rForeignIP;
+		if ( connect( m_hSocket, (struct sockaddr *)&a, sizeof( a ) ) < 0 )
+			return -1;
+		int one = 1;
+		setsockopt( m_hSocket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+		return 0;
+	}
+
+	int Send( const void *pBuffer, unsigned nLength, int nFlags )
+	{
+		return send( m_hSocket, pBuffer, nLength, MSG_NOSIGNAL ) == (ssize_t)nLength ? (int)nLength : -1;
+	}
+
+	int Receive( void *pBuffer, unsigned nLength, int nFlags )
+	{
+		ssize_t n = recv( m_hSocket, pBuffer, nLength, nFlags & MSG_DONTWAIT );
+		if ( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+			return 0;
+		return n > 0 ? (int)n : -1;
+	}
+
+private:
+	int m_hSocket;
+};
+
+#endif
@@ -0,0 +1,19 @@
+//
+// minimal replacement of Circle's scheduler.h: sleeping blocks the calling thread
+//
+#ifndef _circle_sched_scheduler_h
+#define _circle_sched_scheduler_h
+
+#include <unistd.h>
+
+class CScheduler
+{
+public:
+	static CScheduler *Get( void ) { static CScheduler s; return &s; }
+
+	void MsSleep( unsigned nMilliSeconds ) { usleep( nMilliSeconds * 1000 ); }
+	void usSleep( unsigned nMicroSeconds ) { usleep( nMicroSeconds ); }
+	void Yield( void ) { usleep( 0 ); }
+};
+
+#endif
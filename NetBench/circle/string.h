@@ -0,0 +1,76 @@
+//
+// minimal replacement of Circle's CString for building the network code on the host
+//
+#ifndef _circle_string_h
+#define _circle_string_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+class CString
+{
+public:
+	CString( void ) : m_pBuffer( 0 ), m_nSize( 0 ) { Set( "" ); }
+	CString( const char *pString ) : m_pBuffer( 0 ), m_nSize( 0 ) { Set( pString ); }
+	CString( const CString &rString ) : m_pBuffer( 0 ), m_nSize( 0 ) { Set( rString.m_pBuffer ); }
+	~CString( void ) { free( m_pBuffer ); }
+
+	operator const char *( void ) const { return m_pBuffer; }
+
+	const char *operator = ( const char *pString ) { Set( pString ); return m_pBuffer; }
+	const CString &operator = ( const CString &rString ) { Set( rString.m_pBuffer ); return *this; }
+
+	size_t GetLength( void ) const { return strlen( m_pBuffer ); }
+
+	void Append( const char *pString )
+	{
+		size_t l = GetLength(), n = strlen( pString );
+		Reserve( l + n + 1 );
+		memcpy( m_pBuffer + l, pString, n + 1 );
+	}
+
+	void Format( const char *pFormat, ... )
+	{
+		va_list var;
+		va_start( var, pFormat );
+		FormatV( pFormat, var );
+		va_end( var );
+	}
+
+	void FormatV( const char *pFormat, va_list Args )
+	{
+		va_list copy;
+		va_copy( copy, Args );
+		int n = vsnprintf( 0, 0, pFormat, copy );
+		va_end( copy );
+		Reserve( n + 1 );
+		vsnprintf( m_pBuffer, n + 1, pFormat, Args );
+	}
+
+private:
+	void Set( const char *pString )
+	{
+		size_t n = strlen( pString );
+		char *p = (char *)malloc( n + 1 );
+		memcpy( p, pString, n + 1 );
+		free( m_pBuffer );
+		m_pBuffer = p;
+		m_nSize = n + 1;
+	}
+
+	void Reserve( size_t nSize )
+	{
+		if ( nSize > m_nSize )
+		{
+			m_pBuffer = (char *)realloc( m_pBuffer, nSize );
+			m_nSize = nSize;
+		}
+	}
+
+	char  *m_pBuffer;
+	size_t m_nSize;
+};
+
+#endif
@@ -0,0 +1,9 @@
+//
+// minimal replacement of Circle's synchronize.h
+//
+#ifndef _circle_synchronize_h
+#define _circle_synchronize_h
+
+#define DataMemBarrier()	__sync_synchronize()
+
+#endif
@@ -0,0 +1,29 @@
+//
+// minimal replacement of Circle's timer.h: CTimer::GetClockTicks in microseconds, 'hostClockOffset' lets
+// the harness skip time (e.g. to let keep-alive connections expire)
+//
+#ifndef _circle_timer_h
+#define _circle_timer_h
+
+#include <time.h>
+#include <unistd.h>
+
+#define CLOCKHZ		1000000
+
+extern unsigned hostClockOffset;
+
+class CTimer
+{
+public:
+	static unsigned GetClockTicks( void )
+	{
+		struct timespec ts;
+		clock_gettime( CLOCK_MONOTONIC, &ts );
+		return (unsigned)( ts.tv_sec * 1000000ull + ts.tv_nsec / 1000 ) + hostClockOffset;
+	}
+
+	static void SimpleusDelay( unsigned nMicroSeconds ) { usleep( nMicroSeconds ); }
+	static void SimpleMsDelay( unsigned nMilliSeconds ) { usleep( nMilliSeconds * 1000 ); }
+};
+
+#endif
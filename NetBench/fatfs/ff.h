@@ -0,0 +1,67 @@
+//
+// minimal replacement of FatFs for building the network code on the host: the functions are implemented with
+// POSIX calls in hostff.cpp, "SD:" at the start of a path is mapped to the directory 'hostSDRoot'
+//
+#ifndef _fatfs_ff_h
+#define _fatfs_ff_h
+
+typedef unsigned int	UINT;
+typedef unsigned char	BYTE;
+typedef unsigned int	FSIZE_t;
+
+typedef enum
+{
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_NO_FILE,
+	FR_NO_PATH,
+	FR_DENIED,
+	FR_EXIST
+} FRESULT;
+
+typedef struct
+{
+	int     fd;
+	FSIZE_t fptr;
+} FIL;
+
+typedef struct
+{
+	FSIZE_t fsize;
+	BYTE    fattrib;
+	char    fname[ 256 ];
+} FILINFO;
+
+typedef struct FF_DIR		// named, the POSIX DIR is another one
+{
+	void   *dir;
+} DIR;
+
+#define AM_HID				0x02
+#define AM_SYS				0x04
+#define AM_DIR				0x10
+
+#define FA_READ				0x01
+#define FA_WRITE			0x02
+#define FA_OPEN_EXISTING	0x00
+#define FA_CREATE_NEW		0x04
+#define FA_CREATE_ALWAYS	0x08
+#define FA_OPEN_ALWAYS		0x10
+
+extern const char *hostSDRoot;
+
+FRESULT f_open( FIL *fp, const char *path, BYTE mode );
+FRESULT f_close( FIL *fp );
+FRESULT f_read( FIL *fp, void *buff, UINT btr, UINT *br );
+FRESULT f_write( FIL *fp, const void *buff, UINT btw, UINT *bw );
+FRESULT f_lseek( FIL *fp, FSIZE_t ofs );
+FRESULT f_truncate( FIL *fp );
+FRESULT f_stat( const char *path, FILINFO *fno );
+FRESULT f_unlink( const char *path );
+FRESULT f_rename( const char *path_old, const char *path_new );
+FRESULT f_opendir( DIR *dp, const char *path );
+FRESULT f_readdir( DIR *dp, FILINFO *fno );
+FRESULT f_closedir( DIR *dp );
+FSIZE_t f_size( FIL *fp );
+
+#endif
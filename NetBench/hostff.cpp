@@ -0,0 +1,142 @@
+//
+// FatFs calls used by the network code, mapped to POSIX (see fatfs/ff.h)
+//
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#define DIR FF_DIR
+#include "fatfs/ff.h"
+#undef DIR
+
+const char *hostSDRoot = ".";
+
+static const char *hostPath( const char *path, char *buf, unsigned size )
+{
+	if ( strncmp( path, "SD:", 3 ) == 0 )
+		path += 3;
+	snprintf( buf, size, "%s/%s", hostSDRoot, path );
+	return buf;
+}
+
+FRESULT f_open( FIL *fp, const char *path, BYTE mode )
+{
+	char buf[ 1024 ];
+	int flags = ( mode & FA_WRITE ) ? ( ( mode & FA_READ ) ? O_RDWR : O_WRONLY ) : O_RDONLY;
+	if ( mode & FA_CREATE_NEW ) flags |= O_CREAT | O_EXCL;
+	if ( mode & FA_CREATE_ALWAYS ) flags |= O_CREAT | O_TRUNC;
+	if ( mode & FA_OPEN_ALWAYS ) flags |= O_CREAT;
+
+	fp->fd = open( hostPath( path, buf, sizeof( buf ) ), flags, 0644 );
+	fp->fptr = 0;
+	return fp->fd < 0 ? FR_NO_FILE : FR_OK;
+}
+
+FRESULT f_close( FIL *fp )
+{
+	return close( fp->fd ) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_read( FIL *fp, void *buff, UINT btr, UINT *br )
+{
+	ssize_t n = read( fp->fd, buff, btr );
+	*br = n > 0 ? n : 0;
+	fp->fptr += *br;
+	return n < 0 ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write( FIL *fp, const void *buff, UINT btw, UINT *bw )
+{
+	ssize_t n = write( fp->fd, buff, btw );
+	*bw = n > 0 ? n : 0;
+	fp->fptr += *bw;
+	return n < 0 ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_lseek( FIL *fp, FSIZE_t ofs )
+{
+	if ( lseek( fp->fd, ofs, SEEK_SET ) < 0 )
+		return FR_DISK_ERR;
+	fp->fptr = ofs;
+	return FR_OK;
+}
+
+FRESULT f_truncate( FIL *fp )
+{
+	return ftruncate( fp->fd, fp->fptr ) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_stat( const char *path, FILINFO *fno )
+{
+	char buf[ 1024 ];
+	struct stat st;
+	if ( stat( hostPath( path, buf, sizeof( buf ) ), &st ) != 0 )
+		return FR_NO_FILE;
+	if ( fno )
+	{
+		fno->fsize = st.st_size;
+		fno->fattrib = S_ISDIR( st.st_mode ) ? AM_DIR : 0;
+		const char *name = strrchr( path, '/' );
+		strncpy( fno->fname, name ? name + 1 : path, sizeof( fno->fname ) - 1 );
+		fno->fname[ sizeof( fno->fname ) - 1 ] = 0;
+	}
+	return FR_OK;
+}
+
+FRESULT f_unlink( const char *path )
+{
+	char buf[ 1024 ];
+	return unlink( hostPath( path, buf, sizeof( buf ) ) ) == 0 ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_rename( const char *path_old, const char *path_new )
+{
+	char buf[ 1024 ], buf2[ 1024 ];
+	return rename( hostPath( path_old, buf, sizeof( buf ) ), hostPath( path_new, buf2, sizeof( buf2 ) ) ) == 0 ? FR_OK : FR_NO_FILE;
+}
+
+// the entries "." and ".." are skipped as FatFs does, the end of the directory is an empty name
+FRESULT f_opendir( FF_DIR *dp, const char *path )
+{
+	char buf[ 1024 ];
+	dp->dir = opendir( hostPath( path, buf, sizeof( buf ) ) );
+	return dp->dir ? FR_OK : FR_NO_PATH;
+}
+
+FRESULT f_readdir( FF_DIR *dp, FILINFO *fno )
+{
+	struct dirent *e;
+	do
+	{
+		e = readdir( (DIR *)dp->dir );
+	} while ( e && ( !strcmp( e->d_name, "." ) || !strcmp( e->d_name, ".." ) ) );
+
+	fno->fname[ 0 ] = 0;
+	if ( !e )
+		return FR_OK;
+
+	strncpy( fno->fname, e->d_name, sizeof( fno->fname ) - 1 );
+	fno->fname[ sizeof( fno->fname ) - 1 ] = 0;
+
+	struct stat st;
+	int fd = dirfd( (DIR *)dp->dir );
+	if ( fstatat( fd, e->d_name, &st, 0 ) != 0 )
+		return FR_DISK_ERR;
+	fno->fsize = st.st_size;
+	fno->fattrib = S_ISDIR( st.st_mode ) ? AM_DIR : 0;
+	return FR_OK;
+}
+
+FRESULT f_closedir( FF_DIR *dp )
+{
+	closedir( (DIR *)dp->dir );
+	return FR_OK;
+}
+
+FSIZE_t f_size( FIL *fp )
+{
+	struct stat st;
+	return fstat( fp->fd, &st ) == 0 ? st.st_size : 0;
+}
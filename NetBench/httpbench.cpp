@@ -0,0 +1,543 @@
+//
+// httpbench: runs CHTTPStreamClient (../httpstream.cpp) against a loopback HTTP server (see readme.txt)
+//
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "httpstream.h"
+#include <circle/logger.h>
+
+CLogger *logger = new CLogger;
+int hostLogVerbose = 0;
+unsigned hostClockOffset = 0;
+
+//
+// the loopback server: serves one connection at a time, the response of each request is produced by the
+// current scenario and sent in pieces (a short pause between them makes the client receive them separately)
+//
+#define DOC_SIZE		5000
+static u8 document[ DOC_SIZE ];
+
+typedef struct
+{
+	const char *status;				// e.g. "200 OK", 0: answer with the document (200 or 206 for a range request)
+	const char *headers;			// additional header lines
+	u32 chunked;					// send the body chunked, with these chunk sizes (0 terminated)
+	u32 chunkSizes[ 16 ];
+	const char *trailer;			// lines after the last chunk
+	const u8 *body;					// body (0: the document)
+	u32 bodyLength;
+	u32 noLength;					// neither Content-Length nor chunked, the server closes after the body
+	u32 ignoreRange;
+	u32 closeAfter;					// close the connection after this many bytes of the response (0 = never)
+	u32 closeWhenDone;				// close the connection after the response without announcing it
+	u32 continue100;				// "100 Continue" before the response
+	u32 split[ 4 ];					// the response is sent in pieces split at these offsets (0 terminated)
+} SCENARIO;
+
+static SCENARIO scenario;
+static volatile u32 nConnections = 0, nRequests = 0;
+static char lastRange[ 64 ];
+static int listenSocket;
+static u16 serverPort;
+
+static void appendf( char **p, const char *fmt, ... )
+{
+	va_list var;
+	va_start( var, fmt );
+	*p += vsprintf( *p, fmt, var );
+	va_end( var );
+}
+
+static u32 buildResponse( char *out, const char *range )
+{
+	char *p = out;
+	const SCENARIO *s = &scenario;
+
+	u32 start = 0;
+	if ( range && !s->ignoreRange && !s->body )
+		start = atoi( range );
+
+	const u8 *body = s->body ? s->body : document + start;
+	u32 length = s->body ? s->bodyLength : DOC_SIZE - start;
+
+	if ( s->continue100 )
+		appendf( &p, "HTTP/1.1 100 Continue\r\n\r\n" );
+
+	if ( s->status )
+		appendf( &p, "HTTP/1.1 %s\r\n", s->status ); else
+	if ( start )
+		appendf( &p, "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %u-%u/%u\r\n", start, DOC_SIZE - 1, DOC_SIZE ); else
+		appendf( &p, s->noLength ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.1 200 OK\r\n" );
+
+	if ( s->headers )
+		appendf( &p, "%s", s->headers );
+
+	if ( s->chunked )
+	{
+		appendf( &p, "Transfer-Encoding: chunked\r\n\r\n" );
+		u32 pos = 0;
+		for ( u32 i = 0; pos < length; i++ )
+		{
+			u32 n = s->chunkSizes[ i ] ? s->chunkSizes[ i ] : length - pos;
+			if ( n > length - pos )
+				n = length - pos;
+			// upper and lower case hex digits and a chunk extension
+			appendf( &p, ( i & 1 ) ? "%X;name=value\r\n" : "%x\r\n", n );
+			memcpy( p, body + pos, n );
+			p += n;
+			appendf( &p, "\r\n" );
+			pos += n;
+		}
+		appendf( &p, "0\r\n%s\r\n", s->trailer ? s->trailer : "" );
+	} else
+	{
+		if ( !s->noLength )
+			appendf( &p, "Content-Length: %u\r\n", length );
+		appendf( &p, "\r\n" );
+		memcpy( p, body, length );
+		p += length;
+	}
+	return p - out;
+}
+
+static void sendAll( int fd, const char *p, u32 n )
+{
+	while ( n > 0 )
+	{
+		ssize_t r = send( fd, p, n, MSG_NOSIGNAL );
+		if ( r <= 0 )
+			return;
+		p += r;
+		n -= r;
+	}
+}
+
+static void *serverThread( void * )
+{
+	static char request[ 8192 ], response[ 65536 ];
+
+	for ( ;; )
+	{
+		int fd = accept( listenSocket, 0, 0 );
+		if ( fd < 0 )
+			continue;
+		int one = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+		nConnections ++;
+
+		for ( ;; )
+		{
+			// request header
+			u32 l = 0;
+			while ( l < 4 || memcmp( &request[ l - 4 ], "\r\n\r\n", 4 ) )
+			{
+				ssize_t r = recv( fd, &request[ l ], 1, 0 );
+				if ( r <= 0 || l >= sizeof( request ) - 2 )
+					break;
+				l += r;
+			}
+			if ( l < 4 || memcmp( &request[ l - 4 ], "\r\n\r\n", 4 ) )
+				break;
+			request[ l ] = 0;
+			nRequests ++;
+
+			const char *range = strstr( request, "Range: bytes=" );
+			lastRange[ 0 ] = 0;
+			if ( range )
+				sscanf( range + 13, "%63[^\r]", lastRange );
+
+			u32 n = buildResponse( response, range ? range + 13 : 0 );
+			u32 end = ( scenario.closeAfter && scenario.closeAfter < n ) ? scenario.closeAfter : n;
+
+			u32 pos = 0;
+			for ( u32 i = 0; i < 4 && scenario.split[ i ] && scenario.split[ i ] < end; i++ )
+			{
+				if ( scenario.split[ i ] <= pos )
+					continue;
+				sendAll( fd, &response[ pos ], scenario.split[ i ] - pos );
+				pos = scenario.split[ i ];
+				usleep( 300 );
+			}
+			sendAll( fd, &response[ pos ], end - pos );
+
+			if ( end < n || scenario.noLength || scenario.closeWhenDone || strstr( scenario.headers ? scenario.headers : "", "close" ) )
+				break;
+		}
+		close( fd );
+	}
+	return 0;
+}
+
+static void startServer()
+{
+	listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in a;
+	memset( &a, 0, sizeof( a ) );
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	a.sin_port = 0;
+	socklen_t al = sizeof( a );
+	if ( bind( listenSocket, (struct sockaddr *)&a, sizeof( a ) ) < 0 || listen( listenSocket, 4 ) < 0 ||
+		 getsockname( listenSocket, (struct sockaddr *)&a, &al ) < 0 )
+	{
+		perror( "server" );
+		exit( 1 );
+	}
+	serverPort = ntohs( a.sin_port );
+
+	pthread_t t;
+	pthread_create( &t, 0, serverThread, 0 );
+}
+
+//
+// a sink which records everything it gets
+//
+class CCheckSink : public CHTTPStreamSink
+{
+public:
+	CCheckSink( void ) { Reset(); }
+
+	void Reset( void ) { nBegin = nEnd = nLength = 0; nOffset = nTotal = ~0u; bComplete = false; }
+
+	boolean Begin( unsigned nOffset_, unsigned nTotalLength ) { nBegin ++; nOffset = nOffset_; nTotal = nTotalLength; return true; }
+	boolean Write( const u8 *pData, unsigned n )
+	{
+		if ( nLength + n > sizeof( data ) )
+			return false;
+		memcpy( &data[ nLength ], pData, n );
+		nLength += n;
+		return true;
+	}
+	void End( boolean bComplete_ ) { nEnd ++; bComplete = bComplete_; }
+
+	u8 data[ 65536 ];
+	unsigned nBegin, nEnd, nLength, nOffset, nTotal;
+	boolean bComplete;
+};
+
+static CNetSubSystem net;
+static CHTTPStreamClient client( &net );
+static CIPAddress serverIP( htonl( INADDR_LOOPBACK ) );
+static u32 failed = 0, checks = 0;
+
+static void check( u32 ok, const char *what, u32 detail = 0 )
+{
+	checks ++;
+	if ( !ok )
+	{
+		failed ++;
+		printf( "  FAILED: %s (%u)\n", what, detail );
+	}
+}
+
+static unsigned get( CHTTPStreamSink *pSink, unsigned nOffset = 0 )
+{
+	return client.Get( serverIP, serverPort, "localhost", "/doc", pSink, nOffset );
+}
+
+static void setScenario( const SCENARIO &s )
+{
+	scenario = s;
+}
+
+static u32 responseLength()
+{
+	static char buf[ 65536 ];
+	return buildResponse( buf, 0 );
+}
+
+static void writeFile( const char *name, const u8 *p, u32 n )
+{
+	FILE *f = fopen( name, "wb" );
+	fwrite( p, 1, n, f );
+	fclose( f );
+}
+
+static u32 fileMatches( const char *name, const u8 *p, u32 n )
+{
+	static u8 buf[ 65536 ];
+	FILE *f = fopen( name, "rb" );
+	if ( !f )
+		return 0;
+	u32 l = fread( buf, 1, sizeof( buf ), f );
+	fclose( f );
+	return l == n && memcmp( buf, p, n ) == 0;
+}
+
+int main( int argc, char **argv )
+{
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-v" ) )
+			hostLogVerbose = 1; else
+		{
+			fprintf( stderr, "usage: httpbench [-v]\n" );
+			return 1;
+		}
+	}
+
+	for ( u32 i = 0; i < DOC_SIZE; i++ )
+		document[ i ] = ( i * 7 + ( i >> 8 ) ) & 255;
+
+	char tmpDir[] = "/tmp/httpbenchXXXXXX";
+	if ( !mkdtemp( tmpDir ) )
+		return 1;
+	hostSDRoot = tmpDir;
+	char fileName[ 256 ];
+	snprintf( fileName, sizeof( fileName ), "%s/doc.bin", tmpDir );
+
+	startServer();
+
+	CCheckSink sink;
+	SCENARIO s;
+
+	// Content-Length, the response split at every offset, all on one keep-alive connection
+	{
+		static u8 small[ 200 ];
+		for ( u32 i = 0; i < sizeof( small ); i++ )
+			small[ i ] = i * 13;
+		memset( &s, 0, sizeof( s ) );
+		s.body = small;
+		s.bodyLength = sizeof( small );
+		setScenario( s );
+		u32 n = responseLength(), c0 = nConnections, bad = 0;
+		for ( u32 k = 1; k < n; k++ )
+		{
+			scenario.split[ 0 ] = k;
+			sink.Reset();
+			if ( get( &sink ) != 200 || !sink.bComplete || sink.nLength != sizeof( small ) || memcmp( sink.data, small, sizeof( small ) ) || sink.nTotal != sizeof( small ) )
+				bad ++;
+		}
+		printf( "content-length, split at %u offsets: %u wrong, %u connection(s)\n", n - 1, bad, nConnections - c0 );
+		check( bad == 0, "content-length split", bad );
+		check( nConnections - c0 <= 1, "content-length keep-alive", nConnections - c0 );
+	}
+
+	// chunked, chunk sizes from 1 to above the receive buffer, the response split twice at every offset
+	{
+		static u8 body[ 300 ];
+		for ( u32 i = 0; i < sizeof( body ); i++ )
+			body[ i ] = i * 29 + 3;
+		memset( &s, 0, sizeof( s ) );
+		s.body = body;
+		s.bodyLength = sizeof( body );
+		s.chunked = 1;
+		u32 sizes[] = { 1, 15, 16, 17, 2, 200, 0 };
+		memcpy( s.chunkSizes, sizes, sizeof( sizes ) );
+		setScenario( s );
+		u32 n = responseLength(), c0 = nConnections, bad = 0;
+		for ( u32 k = 1; k < n; k++ )
+		{
+			scenario.split[ 0 ] = k;
+			scenario.split[ 1 ] = k + 3;
+			sink.Reset();
+			if ( get( &sink ) != 200 || !sink.bComplete || sink.nLength != sizeof( body ) || memcmp( sink.data, body, sizeof( body ) ) || sink.nTotal != 0 )
+				bad ++;
+		}
+		printf( "chunked, split at %u offsets: %u wrong, %u connection(s)\n", n - 1, bad, nConnections - c0 );
+		check( bad == 0, "chunked split", bad );
+		check( nConnections - c0 <= 1, "chunked keep-alive", nConnections - c0 );
+
+		memset( &s, 0, sizeof( s ) );
+		s.chunked = 1;
+		s.chunkSizes[ 0 ] = HTTP_RX_BUFFER_SIZE + 7;
+		setScenario( s );
+		sink.Reset();
+		u32 status = get( &sink );
+		check( status == 200 && sink.bComplete && sink.nLength == DOC_SIZE && !memcmp( sink.data, document, DOC_SIZE ), "chunk larger than the receive buffer" );
+	}
+
+	// trailer fields after the last chunk, the connection must still be usable
+	{
+		memset( &s, 0, sizeof( s ) );
+		s.chunked = 1;
+		s.chunkSizes[ 0 ] = 1000;
+		s.trailer = "X-Checksum: 1234\r\nExpires: Wed, 21 Oct 2015 07:28:00 GMT\r\n";
+		s.split[ 0 ] = responseLength() - 20;
+		setScenario( s );
+		sink.Reset();
+		u32 ok = get( &sink ) == 200 && sink.bComplete && sink.nLength == DOC_SIZE && !memcmp( sink.data, document, DOC_SIZE );
+		u32 c0 = nConnections;
+		sink.Reset();
+		ok &= get( &sink ) == 200 && sink.nLength == DOC_SIZE;
+		printf( "trailer: %s, next request on %u new connection(s)\n", ok ? "ok" : "wrong", nConnections - c0 );
+		check( ok, "trailer" );
+		check( nConnections == c0, "trailer keep-alive", nConnections - c0 );
+	}
+
+	// 100 Continue before the response, HTTP/1.0 without length (read until closed)
+	{
+		memset( &s, 0, sizeof( s ) );
+		s.continue100 = 1;
+		setScenario( s );
+		sink.Reset();
+		check( get( &sink ) == 200 && sink.nLength == DOC_SIZE && !memcmp( sink.data, document, DOC_SIZE ), "100 continue" );
+
+		memset( &s, 0, sizeof( s ) );
+		s.noLength = 1;
+		s.split[ 0 ] = 100;
+		s.split[ 1 ] = 3000;
+		setScenario( s );
+		sink.Reset();
+		check( get( &sink ) == 200 && sink.bComplete && sink.nLength == DOC_SIZE && !memcmp( sink.data, document, DOC_SIZE ), "body until close" );
+		printf( "100 continue, HTTP/1.0 without length: done\n" );
+	}
+
+	// range resume into a file: 206, a server ignoring the range (200), 416 for a complete file
+	{
+		memset( &s, 0, sizeof( s ) );
+		setScenario( s );
+
+		writeFile( fileName, document, 1000 );
+		CHTTPFileSink file;
+		file.Open( "SD:doc.bin" );
+		u32 offset = file.GetResumeOffset();
+		u32 status = get( &file, offset );
+		file.Close();
+		printf( "resume at %u: status %u, range \"%s\", file %s\n", offset, status, lastRange, fileMatches( fileName, document, DOC_SIZE ) ? "complete" : "WRONG" );
+		check( offset == 1000 && status == 206 && !strcmp( lastRange, "1000-" ) && fileMatches( fileName, document, DOC_SIZE ), "206 resume" );
+
+		// the same with a chunked 206
+		s.chunked = 1;
+		s.chunkSizes[ 0 ] = 333;
+		setScenario( s );
+		writeFile( fileName, document, 2500 );
+		file.Open( "SD:doc.bin" );
+		status = get( &file, file.GetResumeOffset() );
+		file.Close();
+		check( status == 206 && fileMatches( fileName, document, DOC_SIZE ), "206 chunked resume" );
+
+		memset( &s, 0, sizeof( s ) );
+		s.ignoreRange = 1;
+		setScenario( s );
+		writeFile( fileName, document, 1000 );
+		file.Open( "SD:doc.bin" );
+		status = get( &file, file.GetResumeOffset() );
+		file.Close();
+		printf( "resume ignored by the server: status %u, file %s\n", status, fileMatches( fileName, document, DOC_SIZE ) ? "complete" : "WRONG" );
+		check( status == 200 && fileMatches( fileName, document, DOC_SIZE ), "200 instead of 206" );
+
+		static const char msg416[] = "requested range not satisfiable";
+		memset( &s, 0, sizeof( s ) );
+		s.status = "416 Range Not Satisfiable";
+		s.headers = "Content-Range: bytes */5000\r\n";
+		s.body = (const u8 *)msg416;
+		s.bodyLength = sizeof( msg416 ) - 1;
+		setScenario( s );
+		u32 c0 = nConnections;
+		file.Open( "SD:doc.bin" );
+		status = get( &file, file.GetResumeOffset() );
+		file.Close();
+		memset( &s, 0, sizeof( s ) );
+		setScenario( s );
+		sink.Reset();
+		u32 next = get( &sink );
+		printf( "complete file: status %u, file %s, next request %u on %u new connection(s)\n", status,
+			fileMatches( fileName, document, DOC_SIZE ) ? "unchanged" : "WRONG", next, nConnections - c0 );
+		check( status == 416 && fileMatches( fileName, document, DOC_SIZE ), "416" );
+		check( next == 200 && sink.nLength == DOC_SIZE && nConnections == c0, "keep-alive after 416", nConnections - c0 );
+	}
+
+	// connection closed in the middle of the body, then resumed
+	{
+		memset( &s, 0, sizeof( s ) );
+		s.closeAfter = 2200;
+		s.split[ 0 ] = 1000;
+		setScenario( s );
+		remove( fileName );
+		CHTTPFileSink file;
+		file.Open( "SD:doc.bin" );
+		u32 status = get( &file, file.GetResumeOffset() );
+		file.Close();
+		struct stat st;
+		stat( fileName, &st );
+		u32 have = st.st_size;
+
+		scenario.closeAfter = 0;
+		file.Open( "SD:doc.bin" );
+		u32 offset = file.GetResumeOffset();
+		u32 status2 = get( &file, offset );
+		file.Close();
+		printf( "closed after %u bytes of the response: status %u, %u bytes in the file, resumed at %u: status %u, file %s\n",
+			2200, status, have, offset, status2, fileMatches( fileName, document, DOC_SIZE ) ? "complete" : "WRONG" );
+		check( status == 0 && have > 0 && have < DOC_SIZE && offset == have && status2 == 206 && fileMatches( fileName, document, DOC_SIZE ), "content-length closed mid-body" );
+
+		memset( &s, 0, sizeof( s ) );
+		s.chunked = 1;
+		s.chunkSizes[ 0 ] = 1500;
+		s.closeAfter = 2000;
+		setScenario( s );
+		sink.Reset();
+		status = get( &sink );
+		check( status == 0 && sink.nEnd == 1 && !sink.bComplete && sink.nLength < DOC_SIZE, "chunked closed mid-body" );
+		printf( "chunked, closed in a chunk: status %u, %u bytes, complete %u\n", status, sink.nLength, sink.bComplete );
+	}
+
+	// keep-alive: the server closes an idle connection, announces the close, or the connection expires
+	{
+		memset( &s, 0, sizeof( s ) );
+		s.closeWhenDone = 1;
+		setScenario( s );
+		sink.Reset();
+		u32 status = get( &sink );
+		scenario.closeWhenDone = 0;
+		usleep( 10000 );
+		u32 c0 = nConnections;
+		sink.Reset();
+		u32 status2 = get( &sink );
+		printf( "connection closed by the server while idle: %u then %u, %u new connection(s)\n", status, status2, nConnections - c0 );
+		check( status == 200 && status2 == 200 && sink.nLength == DOC_SIZE && nConnections - c0 == 1, "reconnect after idle close" );
+
+		s.closeWhenDone = 0;
+		s.headers = "Connection: close\r\n";
+		setScenario( s );
+		sink.Reset();
+		get( &sink );
+		c0 = nConnections;
+		scenario.headers = 0;
+		sink.Reset();
+		status = get( &sink );
+		check( status == 200 && nConnections - c0 == 1, "Connection: close" );
+
+		c0 = nConnections;
+		hostClockOffset += 5000000;
+		sink.Reset();
+		status = get( &sink );
+		check( status == 200 && nConnections - c0 == 1, "idle timeout" );
+		sink.Reset();
+		status = get( &sink );
+		check( status == 200 && nConnections - c0 == 1, "reuse after reconnect" );
+
+		static const char msg404[] = "not found";
+		memset( &s, 0, sizeof( s ) );
+		s.status = "404 Not Found";
+		s.chunked = 1;
+		s.body = (const u8 *)msg404;
+		s.bodyLength = sizeof( msg404 ) - 1;
+		setScenario( s );
+		c0 = nConnections;
+		sink.Reset();
+		status = get( &sink );
+		memset( &s, 0, sizeof( s ) );
+		setScenario( s );
+		sink.Reset();
+		status2 = get( &sink );
+		check( status == 404 && status2 == 200 && nConnections == c0, "keep-alive after chunked 404" );
+		printf( "Connection: close, idle timeout, 404: done\n" );
+	}
+
+	remove( fileName );
+	rmdir( tmpDir );
+
+	printf( "%u checks, %u failed\n", checks, failed );
+	return failed ? 2 : 0;
+}
@@ -0,0 +1,364 @@
+//
+// modembench: drives the SwiftLink emulation (CSwiftLink6551 and CModemLink of ../modemlink.h) from a loopback
+// TCP connection to a BBS, the C64 side is simulated the way the launch kernel and a terminal program use it (see readme.txt)
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "modemlink.h"
+#include <circle/net/socket.h>
+
+//
+// the loopback BBS: echoes everything except the command bytes below
+//
+#define CMD_BURST		0x01	// sends BURST_SIZE bytes (more than the input buffer holds)
+#define CMD_PAGE		0x02	// sends PAGE_SIZE bytes
+#define CMD_HANGUP		0x04	// sends "BYE" and closes the connection
+
+#define BURST_SIZE		20000
+#define PAGE_SIZE		1000
+
+static int listenSocket;
+static u16 serverPort;
+
+static u8 pattern( u32 i )
+{
+	return ( i * 7 + 3 ) & 255;	// all byte values, NUL included
+}
+
+static void sendAll( int fd, const u8 *p, u32 n )
+{
+	while ( n > 0 )
+	{
+		ssize_t r = send( fd, p, n, MSG_NOSIGNAL );
+		if ( r <= 0 )
+			return;
+		p += r;
+		n -= r;
+	}
+}
+
+static void *serverThread( void * )
+{
+	static u8 data[ BURST_SIZE ];
+	for ( u32 i = 0; i < BURST_SIZE; i++ )
+		data[ i ] = pattern( i );
+
+	for ( ;; )
+	{
+		int fd = accept( listenSocket, 0, 0 );
+		if ( fd < 0 )
+			continue;
+		int one = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+		u8 c;
+		while ( recv( fd, &c, 1, 0 ) == 1 )
+		{
+			if ( c == CMD_BURST )
+				sendAll( fd, data, BURST_SIZE ); else
+			if ( c == CMD_PAGE )
+				sendAll( fd, data, PAGE_SIZE ); else
+			if ( c == CMD_HANGUP )
+			{
+				sendAll( fd, (const u8 *)"BYE", 3 );
+				break;
+			} else
+				sendAll( fd, &c, 1 );
+		}
+		close( fd );
+	}
+	return 0;
+}
+
+static void startServer()
+{
+	listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in a;
+	memset( &a, 0, sizeof( a ) );
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	a.sin_port = 0;
+	socklen_t al = sizeof( a );
+	if ( bind( listenSocket, (struct sockaddr *)&a, sizeof( a ) ) < 0 || listen( listenSocket, 4 ) < 0 ||
+		 getsockname( listenSocket, (struct sockaddr *)&a, &al ) < 0 )
+	{
+		perror( "server" );
+		exit( 1 );
+	}
+	serverPort = ntohs( a.sin_port );
+
+	pthread_t t;
+	pthread_create( &t, 0, serverThread, 0 );
+}
+
+static u32 failed = 0, checks = 0;
+
+static void check( u32 ok, const char *what, u32 detail = 0 )
+{
+	checks ++;
+	if ( !ok )
+	{
+		failed ++;
+		printf( "  FAILED: %s (%u)\n", what, detail );
+	}
+}
+
+//
+// the emulation: 'now' is the simulated time in microseconds (what CTimer::GetClockTicks returns on the Pi)
+//
+static CNetSubSystem net;
+static CSocket *socketBBS;
+static boolean connected;
+static CModemLink modemLink;
+static CSwiftLink6551 swiftLink;
+static unsigned now = 0;
+
+#define MAX_RECEIVED	( 4 * BURST_SIZE )
+static u8 received[ MAX_RECEIVED ];
+static unsigned receivedTime[ MAX_RECEIVED ];
+static u32 nReceived, nBadStatus;
+
+// as CSidekickNet::modemCarrierLost: the chars which have been received stay, the terminal gets "NO CARRIER"
+static void carrierLost()
+{
+	delete socketBBS;
+	socketBBS = 0;
+	connected = false;
+	static const char msg[] = "\r\nNO CARRIER\r\n";
+	modemLink.WriteToTerminal( (const u8 *)msg, sizeof( msg ) - 1 );
+}
+
+static void pump( boolean bWait )
+{
+	if ( connected && !modemLink.Pump( socketBBS, bWait ) )
+		carrierLost();
+}
+
+// main loop of the launch kernel plus the NMI handler of the terminal program: the 6551 is loaded with the next char,
+// the terminal reads the status register and picks the char up
+static void terminalStep()
+{
+	if ( !swiftLink.Receive( &modemLink, now ) )
+		return;
+
+	if ( !( swiftLink.Read( SWIFTLINK_STATUS, &modemLink, connected ) & ACIA_STATUS_RDRF ) )
+		nBadStatus ++;
+	u8 c = swiftLink.Read( SWIFTLINK_DATA, &modemLink, connected );
+	if ( swiftLink.Read( SWIFTLINK_STATUS, &modemLink, connected ) & ACIA_STATUS_RDRF )
+		nBadStatus ++;
+	if ( nReceived < MAX_RECEIVED )
+	{
+		receivedTime[ nReceived ] = now;
+		received[ nReceived ++ ] = c;
+	}
+}
+
+// runs the simulation until 'count' chars have arrived at the terminal or 'timeout' microseconds have passed,
+// the network is serviced every 'pumpInterval', the simulated time stands still while there is nothing to deliver
+// and the BBS has not answered yet (for one second at most)
+static void run( u32 count, unsigned step, unsigned pumpInterval, unsigned timeout )
+{
+	unsigned start = now, lastPump = now, idle = 0;
+	while ( nReceived < count && now - start < timeout )
+	{
+		if ( now - lastPump >= pumpInterval )
+		{
+			pump( false );
+			lastPump = now;
+		}
+		if ( modemLink.HasCharsForTerminal() || swiftLink.IsReceiveFull() || !connected )
+			idle = 0; else
+		if ( idle < 10000 )
+		{
+			usleep( 100 );
+			idle ++;
+			lastPump -= pumpInterval;
+			continue;
+		}
+		terminalStep();
+		now += step;
+	}
+}
+
+// terminal program sending: waits for TDRE (the network is serviced meanwhile) unless 'ignoreTDRE'
+static void terminalWrite( const u8 *p, u32 n, boolean ignoreTDRE = false )
+{
+	for ( u32 i = 0; i < n; i++ )
+	{
+		if ( !ignoreTDRE )
+			while ( !( swiftLink.Read( SWIFTLINK_STATUS, &modemLink, connected ) & ACIA_STATUS_TDRE ) )
+			{
+				pump( false );
+				terminalStep();
+				now += 100;
+			}
+		swiftLink.Write( SWIFTLINK_DATA, p[ i ], &modemLink );
+	}
+}
+
+// largest number of chars delivered within any 'window' microseconds
+static u32 maxInWindow( u32 from, unsigned window )
+{
+	u32 best = 0, j = from;
+	for ( u32 i = from; i < nReceived; i++ )
+	{
+		while ( receivedTime[ i ] - receivedTime[ j ] >= window )
+			j ++;
+		if ( i - j + 1 > best )
+			best = i - j + 1;
+	}
+	return best;
+}
+
+static u32 matchesPattern( u32 from, u32 n )
+{
+	for ( u32 i = 0; i < n; i++ )
+		if ( received[ from + i ] != pattern( i ) )
+			return 0;
+	return 1;
+}
+
+int main( int argc, char **argv )
+{
+	startServer();
+
+	// the buffers on their own
+	{
+		static u8 data[ MODEM_INPUT_BUFFER_SIZE + 808 ];
+		u32 n = modemLink.WriteToTerminal( data, sizeof( data ) );
+		check( n == MODEM_INPUT_BUFFER_SIZE && modemLink.GetOverruns() == 808, "input buffer overrun", modemLink.GetOverruns() );
+		modemLink.Reset();
+		modemLink.ResetStats();
+	}
+
+	socketBBS = new CSocket( &net, IPPROTO_TCP );
+	CIPAddress ip( htonl( INADDR_LOOPBACK ) );
+	if ( socketBBS->Connect( ip, serverPort ) < 0 )
+	{
+		perror( "connect" );
+		return 1;
+	}
+	connected = true;
+
+	// DTR and RTS asserted, no parity, 8N1, 2400 baud
+	swiftLink.Write( SWIFTLINK_COMMAND, 0x09, &modemLink );
+	swiftLink.Write( SWIFTLINK_CONTROL, 0x18, &modemLink );
+	modemLink.SetBaudRate( 2400 );
+	check( swiftLink.IsDTR() && swiftLink.GetBaudCode() == 8, "command/control registers" );
+	check( !( swiftLink.Read( SWIFTLINK_STATUS, &modemLink, connected ) & ACIA_STATUS_DCD ), "DCD while connected" );
+
+	// a terminal which waits for TDRE never loses a char, the echo comes back complete
+	{
+		static u8 text[ 2000 ];
+		for ( u32 i = 0; i < sizeof( text ); i++ )
+			text[ i ] = 'a' + i % 26;
+		nReceived = 0;
+		terminalWrite( text, sizeof( text ) );
+		run( sizeof( text ), 100, 5000, 60000000 );
+		check( modemLink.GetOverruns() == 0, "no overruns with TDRE", modemLink.GetOverruns() );
+		check( nReceived == sizeof( text ) && !memcmp( received, text, sizeof( text ) ), "echo", nReceived );
+	}
+
+	// a terminal which ignores TDRE: the output buffer holds 512 chars, the rest is counted as overrun
+	{
+		static u8 text[ 600 ];
+		for ( u32 i = 0; i < sizeof( text ); i++ )
+			text[ i ] = 'A' + i % 26;
+		modemLink.ResetStats();
+		nReceived = 0;
+		terminalWrite( text, sizeof( text ), true );
+		check( !( swiftLink.Read( SWIFTLINK_STATUS, &modemLink, connected ) & ACIA_STATUS_TDRE ), "TDRE clear when full" );
+		check( modemLink.GetOverruns() == sizeof( text ) - MODEM_OUTPUT_BUFFER_SIZE, "output buffer overrun", modemLink.GetOverruns() );
+		run( MODEM_OUTPUT_BUFFER_SIZE, 100, 5000, 10000000 );
+		check( nReceived == MODEM_OUTPUT_BUFFER_SIZE && !memcmp( received, text, MODEM_OUTPUT_BUFFER_SIZE ), "echo after overrun", nReceived );
+		check( swiftLink.Read( SWIFTLINK_STATUS, &modemLink, connected ) & ACIA_STATUS_TDRE, "TDRE set after sending" );
+	}
+
+	// pacing at 2400 baud (240 chars/s): the burst is larger than the input buffer, the rest waits in the socket
+	{
+		modemLink.ResetStats();
+		nReceived = 0;
+		u8 cmd = CMD_BURST;
+		unsigned start = now;
+		terminalWrite( &cmd, 1 );
+		run( BURST_SIZE, 100, 5000, 200000000 );
+		unsigned elapsed = now - start;
+		check( nReceived == BURST_SIZE && matchesPattern( 0, BURST_SIZE ), "burst at 2400 baud", nReceived );
+		check( modemLink.GetOverruns() == 0, "no overruns with flow control", modemLink.GetOverruns() );
+		check( maxInWindow( 0, 1000000 ) <= 241, "at most 240 chars per second", maxInWindow( 0, 1000000 ) );
+		// 20000 chars * 4166us = 83.3s
+		check( elapsed >= 83000000 && elapsed <= 84000000, "duration of the burst (ms)", elapsed / 1000 );
+		printf( "2400 baud: %u chars in %u ms, at most %u per second\n", nReceived, elapsed / 1000, maxInWindow( 0, 1000000 ) );
+
+		// idle for a while, this must not allow a burst afterwards
+		now += 10000000;
+		nReceived = 0;
+		cmd = CMD_PAGE;
+		terminalWrite( &cmd, 1 );
+		run( PAGE_SIZE, 100, 5000, 10000000 );
+		check( nReceived == PAGE_SIZE && matchesPattern( 0, PAGE_SIZE ), "page after idle", nReceived );
+		check( maxInWindow( 0, 100000 ) <= 25, "no burst after idle", maxInWindow( 0, 100000 ) );
+	}
+
+	// pacing at 38400 baud (3840 chars/s)
+	{
+		swiftLink.Write( SWIFTLINK_CONTROL, 0x1f, &modemLink );
+		modemLink.SetBaudRate( 38400 );
+		nReceived = 0;
+		u8 cmd = CMD_BURST;
+		unsigned start = now;
+		terminalWrite( &cmd, 1 );
+		run( BURST_SIZE, 20, 5000, 20000000 );
+		unsigned elapsed = now - start;
+		check( nReceived == BURST_SIZE && matchesPattern( 0, BURST_SIZE ), "burst at 38400 baud", nReceived );
+		check( maxInWindow( 0, 1000000 ) <= 3847, "at most 3840 chars per second", maxInWindow( 0, 1000000 ) );
+		// 20000 chars * 260us = 5.2s
+		check( elapsed >= 5150000 && elapsed <= 5400000, "duration of the burst (ms)", elapsed / 1000 );
+		printf( "38400 baud: %u chars in %u ms, at most %u per second\n", nReceived, elapsed / 1000, maxInWindow( 0, 1000000 ) );
+	}
+
+	// RTS deasserted: nothing is delivered and nothing is lost, TCP holds back what does not fit into the input buffer
+	{
+		modemLink.ResetStats();
+		nReceived = 0;
+		u8 cmd = CMD_BURST;
+		terminalWrite( &cmd, 1 );
+		swiftLink.Write( SWIFTLINK_COMMAND, 0x01, &modemLink );
+		run( 1, 100, 5000, 10000000 );
+		check( nReceived == 0 && !swiftLink.IsReceiveFull(), "RTS off", nReceived );
+		check( modemLink.GetCharsForTerminal() <= MODEM_INPUT_BUFFER_SIZE && modemLink.GetCharsForTerminal() > 0, "input buffer while RTS is off", modemLink.GetCharsForTerminal() );
+
+		swiftLink.Write( SWIFTLINK_COMMAND, 0x09, &modemLink );
+		run( BURST_SIZE, 20, 5000, 20000000 );
+		check( nReceived == BURST_SIZE && matchesPattern( 0, BURST_SIZE ) && modemLink.GetOverruns() == 0, "RTS on again", nReceived );
+	}
+
+	// the BBS hangs up: DCD goes up, the rest of the data and "NO CARRIER" still arrive
+	{
+		nReceived = 0;
+		u8 cmd = CMD_HANGUP;
+		terminalWrite( &cmd, 1 );
+		for ( u32 i = 0; i < 2000 && connected; i++ )
+		{
+			pump( false );
+			usleep( 1000 );
+		}
+		check( !connected, "disconnect detected" );
+		check( swiftLink.Read( SWIFTLINK_STATUS, &modemLink, connected ) & ACIA_STATUS_DCD, "DCD after disconnect" );
+		static const char expected[] = "BYE\r\nNO CARRIER\r\n";
+		run( sizeof( expected ) - 1, 20, 5000, 1000000 );
+		check( nReceived == sizeof( expected ) - 1 && !memcmp( received, expected, nReceived ), "data after disconnect", nReceived );
+	}
+
+	check( nBadStatus == 0, "RDRF", nBadStatus );
+
+	printf( "%u checks, %u failed\n", checks, failed );
+	return failed ? 2 : 0;
+}
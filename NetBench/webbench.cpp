@@ -0,0 +1,539 @@
+//
+// webbench: runs CWebRequest (../webrequest.cpp, the HTTP part of the web server) on a loopback connection:
+// multipart parsing, uploads to the SD card, the REST API and the checks of the paths (see readme.txt)
+//
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "webrequest.h"
+#include <circle/logger.h>
+#include <circle/net/socket.h>
+
+CLogger *logger = new CLogger;
+int hostLogVerbose = 0;
+unsigned hostClockOffset = 0;
+
+#define MAX_KERNEL_SIZE		20000
+#define LAUNCH_BUFFER_SIZE	16384
+
+static const char kernelName[] = "SD:kernel_sk64_net.img";
+
+//
+// what the rest of Sidekick64 would do is only recorded here
+//
+static u8 launchBuffer[ LAUNCH_BUFFER_SIZE ];
+static char launchType[ 8 ];
+static u32 launchLength, nLaunches, nRefreshes, nKernels;
+static volatile u32 nHandled;
+static char uploadMsg[ 128 ];
+
+class CHostWebRequest : public CWebRequest
+{
+public:
+	CHostWebRequest( CNetSocket *pSocket ) : CWebRequest( pSocket, MAX_KERNEL_SIZE, launchBuffer, sizeof( launchBuffer ) ) {}
+
+protected:
+	void Launch( const char *pType, unsigned nLength )
+	{
+		strncpy( launchType, pType, sizeof( launchType ) - 1 );
+		launchLength = nLength;
+		nLaunches ++;
+	}
+	void RefreshCaches( void ) { nRefreshes ++; }
+	void KernelSaved( void ) { nKernels ++; }
+	const char *GetKernelFilename( void ) { return kernelName; }
+
+	void HandlePage( void )
+	{
+		SkipBody();
+		strcpy( uploadMsg, m_pUploadMsg ? m_pUploadMsg : "" );
+		const char *pPage = "<html>upload</html>";
+		SendResponse( 200, "text/html", (const u8 *)pPage, strlen( pPage ) );
+	}
+};
+
+static int listenSocket;
+static u16 serverPort;
+
+static void *serverThread( void * )
+{
+	for ( ;; )
+	{
+		int fd = accept( listenSocket, 0, 0 );
+		if ( fd < 0 )
+			continue;
+		int one = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+		CSocket *pSocket = new CSocket( fd );
+		CHostWebRequest *pRequest = new CHostWebRequest( pSocket );
+		pRequest->HandleRequest();
+		delete pRequest;
+		delete pSocket;
+		nHandled ++;
+	}
+	return 0;
+}
+
+static void startServer()
+{
+	listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in a;
+	memset( &a, 0, sizeof( a ) );
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	a.sin_port = 0;
+	socklen_t al = sizeof( a );
+	if ( bind( listenSocket, (struct sockaddr *)&a, sizeof( a ) ) < 0 || listen( listenSocket, 4 ) < 0 ||
+		 getsockname( listenSocket, (struct sockaddr *)&a, &al ) < 0 )
+	{
+		perror( "server" );
+		exit( 1 );
+	}
+	serverPort = ntohs( a.sin_port );
+
+	pthread_t t;
+	pthread_create( &t, 0, serverThread, 0 );
+}
+
+//
+// the client: sends a request (the body in pieces with a pause in between, which makes the server
+// receive them separately) and reads the response until the server closes the connection
+//
+static char response[ 65536 ];
+static const char *responseBody;
+
+static void sendAll( int fd, const void *p, u32 n )
+{
+	while ( n > 0 )
+	{
+		ssize_t r = send( fd, p, n, MSG_NOSIGNAL );
+		if ( r <= 0 )
+			return;
+		p = (const u8 *)p + r;
+		n -= r;
+	}
+}
+
+// returns the status code, 0 if there was no response; 'split' are offsets into the body (0 terminated),
+// with 'abortAt' the connection is closed after this many bytes of the body
+static u32 request( const char *method, const char *path, const char *contentType, const void *body, u32 length,
+					const u32 *split = 0, u32 abortAt = 0, u32 contentLength = ~0u )
+{
+	int fd = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in a;
+	memset( &a, 0, sizeof( a ) );
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	a.sin_port = htons( serverPort );
+	if ( connect( fd, (struct sockaddr *)&a, sizeof( a ) ) < 0 )
+	{
+		perror( "connect" );
+		exit( 1 );
+	}
+	int one = 1;
+	setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+	u32 handled = nHandled;
+
+	char header[ 1024 ];
+	int n = sprintf( header, "%s %s HTTP/1.1\r\nHost: localhost\r\n", method, path );
+	if ( contentType )
+		n += sprintf( header + n, "Content-Type: %s\r\n", contentType );
+	if ( body || contentLength != ~0u )
+		n += sprintf( header + n, "Content-Length: %u\r\n", contentLength != ~0u ? contentLength : length );
+	n += sprintf( header + n, "\r\n" );
+	sendAll( fd, header, n );
+
+	u32 end = abortAt ? abortAt : length, pos = 0;
+	for ( u32 i = 0; split && split[ i ] && split[ i ] < end; i++ )
+	{
+		usleep( 2000 );
+		sendAll( fd, (const u8 *)body + pos, split[ i ] - pos );
+		pos = split[ i ];
+	}
+	if ( pos > 0 )
+		usleep( 2000 );
+	sendAll( fd, (const u8 *)body + pos, end - pos );
+
+	if ( abortAt )
+	{
+		close( fd );
+		while ( nHandled == handled )
+			usleep( 1000 );
+		return 0;
+	}
+
+	u32 l = 0;
+	ssize_t r;
+	while ( l < sizeof( response ) - 1 && ( r = recv( fd, response + l, sizeof( response ) - 1 - l, 0 ) ) > 0 )
+		l += r;
+	response[ l ] = 0;
+	close( fd );
+	while ( nHandled == handled )
+		usleep( 100 );
+
+	u32 status = 0;
+	sscanf( response, "HTTP/1.%*c %u", &status );
+	const char *b = strstr( response, "\r\n\r\n" );
+	responseBody = b ? b + 4 : "";
+	return status;
+}
+
+static u32 failed = 0, checks = 0;
+
+static void check( u32 ok, const char *what, u32 detail = 0 )
+{
+	checks ++;
+	if ( !ok )
+	{
+		failed ++;
+		printf( "  FAILED: %s (%u)\n", what, detail );
+	}
+}
+
+static char tmpDir[ 256 ];
+
+static char *hostFile( const char *name )
+{
+	static char buf[ 512 ];
+	snprintf( buf, sizeof( buf ), "%s/%s", tmpDir, name );
+	return buf;
+}
+
+static u32 fileMatches( const char *name, const void *p, u32 n )
+{
+	static u8 buf[ 65536 ];
+	FILE *f = fopen( hostFile( name ), "rb" );
+	if ( !f )
+		return 0;
+	u32 l = fread( buf, 1, sizeof( buf ), f );
+	fclose( f );
+	return l == n && memcmp( buf, p, n ) == 0;
+}
+
+static u32 fileExists( const char *name )
+{
+	struct stat st;
+	return stat( hostFile( name ), &st ) == 0;
+}
+
+static void writeFile( const char *name, const void *p, u32 n )
+{
+	FILE *f = fopen( hostFile( name ), "wb" );
+	fwrite( p, 1, n, f );
+	fclose( f );
+}
+
+//
+// multipart bodies
+//
+static const char boundary[] = "----skBoundary7MA4YWxk";
+static const char multipartType[] = "multipart/form-data; boundary=----skBoundary7MA4YWxk";
+
+// the file data contains things which look like the start of a delimiter
+static u8 fileData[ 300 ];
+static u32 fileSize;
+
+static void makeFileData()
+{
+	static const char tricky[] = "\r\n------skBoundary7MA4\r\n--\r\n------skBoundary7MA4YWx";
+	u32 n = 0;
+	for ( u32 i = 0; i < 100; i++ )
+		fileData[ n++ ] = i * 13 + 1;
+	memcpy( fileData + n, tricky, sizeof( tricky ) - 1 );
+	n += sizeof( tricky ) - 1;
+	for ( u32 i = 0; i < 60; i++ )
+		fileData[ n++ ] = i == 30 ? 0 : 'a' + i % 26;
+	fileData[ n++ ] = '\r';
+	fileSize = n;
+}
+
+// a text field and a file
+static u32 buildMultipart( char *out, const char *fieldName, const char *fileName, const u8 *data, u32 size )
+{
+	char *p = out;
+	p += sprintf( p, "--%s\r\nContent-Disposition: form-data; name=\"note\"\r\n\r\nhello\r\n", boundary );
+	p += sprintf( p, "--%s\r\nContent-Disposition: form-data; name=\"%s\"; filename=\"%s\"\r\n"
+					 "Content-Type: application/octet-stream\r\n\r\n", boundary, fieldName, fileName );
+	memcpy( p, data, size );
+	p += size;
+	p += sprintf( p, "\r\n--%s--\r\n", boundary );
+	return p - out;
+}
+
+// collects the parts the parser finds
+#define PART_SIZE	512
+
+class CPartCollector : public CMultipartParser
+{
+public:
+	void Reset( void ) { nParts = 0; memset( length, 0, sizeof( length ) ); }
+
+	class CPartSink : public CHTTPStreamSink
+	{
+	public:
+		boolean Write( const u8 *pData, unsigned nLength )
+		{
+			if ( *pLength + nLength > PART_SIZE )
+				return false;
+			memcpy( pData_ + *pLength, pData, nLength );
+			*pLength += nLength;
+			return true;
+		}
+		u8 *pData_;
+		u32 *pLength;
+	};
+
+	CHTTPStreamSink *BeginPart( const char *pHeader )
+	{
+		if ( nParts >= 4 )
+			return 0;
+		strncpy( header[ nParts ], pHeader, sizeof( header[ 0 ] ) - 1 );
+		sink.pData_ = data[ nParts ];
+		sink.pLength = &length[ nParts ];
+		nParts ++;
+		return &sink;
+	}
+	boolean EndPart( CHTTPStreamSink *pSink ) { return true; }
+
+	CPartSink sink;
+	char header[ 4 ][ 256 ];
+	u8 data[ 4 ][ PART_SIZE ];
+	u32 length[ 4 ];
+	u32 nParts;
+};
+
+static u32 partsOK( CPartCollector &c )
+{
+	return c.IsComplete() && c.nParts == 2 &&
+		   c.length[ 0 ] == 5 && !memcmp( c.data[ 0 ], "hello", 5 ) && strstr( c.header[ 0 ], "name=\"note\"" ) &&
+		   c.length[ 1 ] == fileSize && !memcmp( c.data[ 1 ], fileData, fileSize ) && strstr( c.header[ 1 ], "filename=\"a.prg\"" );
+}
+
+int main( int argc, char **argv )
+{
+	if ( argc > 1 && !strcmp( argv[ 1 ], "-v" ) )
+		hostLogVerbose = 1;
+
+	strcpy( tmpDir, "/tmp/webbenchXXXXXX" );
+	if ( !mkdtemp( tmpDir ) )
+	{
+		perror( "mkdtemp" );
+		return 1;
+	}
+	hostSDRoot = tmpDir;
+	mkdir( hostFile( "up" ), 0755 );
+
+	makeFileData();
+	static char body[ 4096 ];
+	u32 bodyLength = buildMultipart( body, "file", "a.prg", fileData, fileSize );
+
+	// the parser on its own: the body in two pieces split at every offset, and byte by byte
+	{
+		static CPartCollector c;
+		u32 bad = 0;
+		for ( u32 i = 0; i <= bodyLength; i++ )
+		{
+			c.Reset();
+			boolean ok = c.Begin( multipartType ) && c.Parse( (const u8 *)body, i ) && c.Parse( (const u8 *)body + i, bodyLength - i );
+			if ( !ok || !partsOK( c ) )
+				bad ++;
+		}
+		check( bad == 0, "parser: split at every offset", bad );
+
+		c.Reset();
+		boolean ok = c.Begin( multipartType );
+		for ( u32 i = 0; i < bodyLength; i++ )
+			ok = ok && c.Parse( (const u8 *)body + i, 1 );
+		check( ok && partsOK( c ), "parser: byte by byte" );
+
+		c.Reset();
+		ok = c.Begin( multipartType ) && c.Parse( (const u8 *)body, bodyLength - 8 );
+		check( ok && !c.IsComplete(), "parser: incomplete body" );
+		c.Reset();
+		check( !c.Begin( "multipart/form-data" ), "parser: no boundary" );
+		printf( "multipart parser: done\n" );
+	}
+
+	startServer();
+
+	// upload through the API with the body split at every offset on its way to the server
+	{
+		u32 bad = 0;
+		for ( u32 i = 1; i < bodyLength; i++ )
+		{
+			unlink( hostFile( "up/a.prg" ) );
+			u32 split[ 2 ] = { i, 0 };
+			u32 status = request( "POST", "/api/upload?path=SD:up", multipartType, body, bodyLength, split );
+			if ( status != 200 || !strstr( responseBody, "\"files\":1" ) || !fileMatches( "up/a.prg", fileData, fileSize ) || fileExists( "up/a.prg.part" ) )
+				bad ++;
+		}
+		check( bad == 0, "upload: split at every offset", bad );
+		printf( "multipart upload, %u splits: done\n", bodyLength - 1 );
+	}
+
+	// paths: only absolute ones on the SD card, no way out of it
+	{
+		writeFile( "../webbench_victim", "x", 1 );
+		static const char *bad[] = { "../webbench_victim", "SD:../webbench_victim", "SD:up/../../webbench_victim",
+									 "/tmp/webbench_victim", "webbench_victim", "SD%3A..%2Fwebbench_victim", "" };
+		u32 rejected = 0, n = sizeof( bad ) / sizeof( bad[ 0 ] );
+		char path[ 512 ];
+		for ( u32 i = 0; i < n; i++ )
+		{
+			sprintf( path, "/api/delete?path=%s", bad[ i ] );
+			rejected += request( "POST", path, 0, 0, 0 ) == 400 && strstr( responseBody, "\"ok\":false" );
+			sprintf( path, "/api/list?path=%s", bad[ i ] );
+			rejected += request( "GET", path, 0, 0, 0 ) == 400;
+			sprintf( path, "/api/launch?path=%s.prg", bad[ i ] );
+			rejected += request( "POST", path, 0, 0, 0 ) == 400;
+			sprintf( path, "/api/upload?path=%s", bad[ i ] );
+			rejected += request( "POST", path, "application/octet-stream", "evil", 4 ) == 400;
+		}
+		check( rejected == 4 * n, "invalid paths rejected", 4 * n - rejected );
+		check( fileMatches( "../webbench_victim", "x", 1 ), "file outside SD: untouched" );
+		unlink( hostFile( "../webbench_victim" ) );
+
+		// the file name in a multipart upload: directories are stripped, ".." is refused
+		static char b[ 4096 ];
+		u32 l = buildMultipart( b, "file", "../evil.prg", (const u8 *)"evil", 4 );
+		u32 status = request( "POST", "/api/upload?path=SD:up", multipartType, b, l );
+		check( status == 200 && strstr( responseBody, "\"files\":1" ) && !fileExists( "evil.prg" ) && fileMatches( "up/evil.prg", "evil", 4 ), "multipart file name with ../" );
+		l = buildMultipart( b, "file", "..", (const u8 *)"evil", 4 );
+		status = request( "POST", "/api/upload?path=SD:up", multipartType, b, l );
+		check( status == 200 && strstr( responseBody, "\"files\":0" ) && !fileExists( "up/...part" ), "multipart file name .." );
+		l = buildMultipart( b, "file", "C:\\games\\dir/b.prg", (const u8 *)"bbbb", 4 );
+		status = request( "POST", "/api/upload?path=SD:up", multipartType, b, l );
+		check( status == 200 && strstr( responseBody, "\"files\":1" ) && fileMatches( "up/b.prg", "bbbb", 4 ), "multipart file name with directories" );
+		printf( "paths: done\n" );
+	}
+
+	// raw upload, list, launch, delete
+	{
+		static u8 raw[ 10000 ];
+		for ( u32 i = 0; i < sizeof( raw ); i++ )
+			raw[ i ] = i * 7;
+		u32 split[ 3 ] = { 1, 5000, 0 };
+		u32 refreshes = nRefreshes;
+		u32 status = request( "PUT", "/api/upload?path=SD:up/raw.prg", "application/octet-stream", raw, sizeof( raw ), split );
+		check( status == 200 && strstr( responseBody, "{\"ok\":true,\"size\":10000}" ) && fileMatches( "up/raw.prg", raw, sizeof( raw ) ) &&
+			   !fileExists( "up/raw.prg.part" ) && nRefreshes > refreshes, "raw upload" );
+
+		status = request( "POST", "/api/upload?path=SD:up/cut.prg", "application/octet-stream", raw, sizeof( raw ), 0, 3000 );
+		check( !fileExists( "up/cut.prg" ) && !fileExists( "up/cut.prg.part" ), "raw upload aborted" );
+
+		mkdir( hostFile( "up/sub" ), 0755 );
+		status = request( "GET", "/api/list?path=SD:up", 0, 0, 0 );
+		check( status == 200 && !strncmp( responseBody, "{\"ok\":true,\"path\":\"SD:up\",\"entries\":[", 37 ) &&
+			   strstr( responseBody, "{\"name\":\"raw.prg\",\"dir\":false,\"size\":10000}" ) &&
+			   strstr( responseBody, "{\"name\":\"sub\",\"dir\":true," ) && !strstr( responseBody, ".part" ), "list" );
+		check( request( "GET", "/api/list?path=SD:nothere", 0, 0, 0 ) == 404, "list of a missing directory" );
+		check( request( "GET", "/api/list", 0, 0, 0 ) == 200 && strstr( responseBody, "{\"name\":\"up\",\"dir\":true," ), "list without path" );
+
+		u32 launches = nLaunches;
+		status = request( "POST", "/api/launch?path=SD:up/raw.prg", 0, 0, 0 );
+		check( status == 200 && nLaunches == launches + 1 && !strcmp( launchType, "prg" ) && launchLength == sizeof( raw ) &&
+			   !memcmp( launchBuffer, raw, sizeof( raw ) ) && strstr( responseBody, "\"size\":10000" ), "launch from SD" );
+		writeFile( "up/GAME.D64", raw, 100 );
+		status = request( "POST", "/api/launch?path=SD:up/GAME.D64", 0, 0, 0 );
+		check( status == 200 && !strcmp( launchType, "d64" ) && launchLength == 100, "launch, extension in upper case" );
+		writeFile( "up/notes.txt", raw, 100 );
+		launches = nLaunches;
+		check( request( "POST", "/api/launch?path=SD:up/notes.txt", 0, 0, 0 ) == 404 && nLaunches == launches, "launch, unknown type" );
+		check( request( "POST", "/api/launch?path=SD:up/none.prg", 0, 0, 0 ) == 404 && nLaunches == launches, "launch, missing file" );
+
+		status = request( "POST", "/api/launch?type=crt", "application/octet-stream", raw, 4000, split );
+		check( status == 200 && nLaunches == launches + 1 && !strcmp( launchType, "crt" ) && launchLength == 4000 && !memcmp( launchBuffer, raw, 4000 ), "launch body" );
+		launches = nLaunches;
+		check( request( "POST", "/api/launch?type=exe", "application/octet-stream", raw, 100 ) == 400, "launch body, unknown type" );
+		check( request( "POST", "/api/launch", "application/octet-stream", raw, 100 ) == 400, "launch without path or type" );
+		static u8 big[ LAUNCH_BUFFER_SIZE + 1 ];
+		check( request( "POST", "/api/launch?type=prg", "application/octet-stream", big, sizeof( big ) ) == 413, "launch body too large" );
+		check( nLaunches == launches, "no launch after errors", nLaunches - launches );
+
+		check( request( "DELETE", "/api/delete?path=SD:up/raw.prg", 0, 0, 0 ) == 200 && !strcmp( responseBody, "{\"ok\":true}" ) && !fileExists( "up/raw.prg" ), "delete" );
+		check( request( "POST", "/api/delete?path=SD:up/raw.prg", 0, 0, 0 ) == 404, "delete a missing file" );
+		check( request( "GET", "/api/delete?path=SD:up/b.prg", 0, 0, 0 ) == 404 && fileExists( "up/b.prg" ), "delete needs POST or DELETE" );
+		check( request( "GET", "/api/nothing", 0, 0, 0 ) == 404 && strstr( responseBody, "unknown request" ), "unknown command" );
+		printf( "upload, list, launch, delete: done\n" );
+	}
+
+	// the HTML form: a kernel image or a file to launch
+	{
+		static u8 kernel[ 15000 ], oldKernel[ 100 ];
+		for ( u32 i = 0; i < sizeof( kernel ); i++ )
+			kernel[ i ] = i * 3 + 1;
+		memset( oldKernel, 0x55, sizeof( oldKernel ) );
+		writeFile( kernelName + 3, oldKernel, sizeof( oldKernel ) );
+
+		static char b[ 65536 ];
+		u32 l = buildMultipart( b, "kernelimg", "kernel_sk64_net.img", kernel, sizeof( kernel ) );
+		u32 split[ 2 ] = { l / 2, 0 };
+		u32 status = request( "POST", "/", multipartType, b, l, 0, l - 100 );
+		check( fileMatches( kernelName + 3, oldKernel, sizeof( oldKernel ) ) && !fileExists( "kernel_sk64_net.img.part" ) && nKernels == 0, "kernel upload aborted" );
+
+		static u8 tooBig[ MAX_KERNEL_SIZE + 1 ];
+		static char b2[ 65536 ];
+		u32 l2 = buildMultipart( b2, "kernelimg", "kernel_sk64_net.img", tooBig, sizeof( tooBig ) );
+		status = request( "POST", "/", multipartType, b2, l2 );
+		check( status == 200 && fileMatches( kernelName + 3, oldKernel, sizeof( oldKernel ) ) && !fileExists( "kernel_sk64_net.img.part" ) &&
+			   nKernels == 0 && !strcmp( uploadMsg, "Upload failed" ), "kernel image too large" );
+
+		status = request( "POST", "/upload.html", multipartType, b, l, split );
+		check( status == 200 && fileMatches( kernelName + 3, kernel, sizeof( kernel ) ) && !fileExists( "kernel_sk64_net.img.part" ) &&
+			   nKernels == 1 && !strcmp( uploadMsg, "Now rebooting into new kernel..." ), "kernel upload" );
+
+		l = buildMultipart( b, "kernelimg", "other.img", kernel, 100 );
+		status = request( "POST", "/", multipartType, b, l );
+		check( status == 200 && nKernels == 1 && !strcmp( uploadMsg, "Invalid request (1)" ), "form: not a kernel image" );
+
+		u32 launches = nLaunches;
+		l = buildMultipart( b, "file", "Game.SID", kernel, 5000 );
+		status = request( "POST", "/", multipartType, b, l, split );
+		check( status == 200 && nLaunches == launches + 1 && !strcmp( launchType, "sid" ) && launchLength == 5000 &&
+			   !memcmp( launchBuffer, kernel, 5000 ) && !strcmp( uploadMsg, "Now launching payload..." ), "form: file to launch" );
+
+		check( request( "POST", "/api/upload?path=SD:up", multipartType, body, bodyLength ) == 200, "keep-alive of the server" );
+		printf( "HTML form: done\n" );
+	}
+
+	// requests the server does not take
+	{
+		int fd = socket( AF_INET, SOCK_STREAM, 0 );
+		struct sockaddr_in a;
+		memset( &a, 0, sizeof( a ) );
+		a.sin_family = AF_INET;
+		a.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+		a.sin_port = htons( serverPort );
+		connect( fd, (struct sockaddr *)&a, sizeof( a ) );
+		u32 handled = nHandled;
+		static const char chunked[] = "POST /api/upload?path=SD:up/c.prg HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nabcd\r\n0\r\n\r\n";
+		sendAll( fd, chunked, sizeof( chunked ) - 1 );
+		u32 l = 0;
+		ssize_t r;
+		while ( ( r = recv( fd, response + l, sizeof( response ) - 1 - l, 0 ) ) > 0 )
+			l += r;
+		response[ l ] = 0;
+		close( fd );
+		while ( nHandled == handled )
+			usleep( 100 );
+		check( !strncmp( response, "HTTP/1.0 400", 12 ) && !fileExists( "up/c.prg" ), "chunked request body" );
+	}
+
+	char cmd[ 300 ];
+	sprintf( cmd, "rm -rf %s", tmpDir );
+	if ( system( cmd ) != 0 )
+		printf( "cannot remove %s\n", tmpDir );
+
+	printf( "%u checks, %u failed\n", checks, failed );
+	return failed ? 2 : 0;
+}
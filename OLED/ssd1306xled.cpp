@@ -136,17 +136,25 @@ void ssd1306_xfer_stop(void)
 void ssd1306_send_byte(uint8_t byte)
 {
 	uint8_t i;
+	// SDA is only written when it changes: the FIQ would skip these entries anyway, but has to fetch them first
+	uint32_t sda = 2;
 	for (i = 0; i < 8; i++)
 	{
-		if ((byte << i) & 0x80)
-			DIGITAL_WRITE_HIGH(SSD1306_SDA);
-		else
-			DIGITAL_WRITE_LOW(SSD1306_SDA);
+		uint32_t bit = ((byte << i) & 0x80) ? 1 : 0;
+		if (bit != sda)
+		{
+			if (bit)
+				DIGITAL_WRITE_HIGH(SSD1306_SDA);
+			else
+				DIGITAL_WRITE_LOW(SSD1306_SDA);
+			sda = bit;
+		}
 		
 		DIGITAL_WRITE_HIGH(SSD1306_SCL);
 		DIGITAL_WRITE_LOW(SSD1306_SCL);
 	}
-	DIGITAL_WRITE_HIGH(SSD1306_SDA);
+	if (sda != 1)
+		DIGITAL_WRITE_HIGH(SSD1306_SDA);
 	DIGITAL_WRITE_HIGH(SSD1306_SCL);
 	DIGITAL_WRITE_LOW(SSD1306_SCL);
 }
@@ -209,12 +217,17 @@ void ssd1306_init(void)
 }
 
 
+// the init sequence selects horizontal addressing mode: the page/column commands (0xB0, 0x00, 0x10) are
+// ignored there, the position is set with a column (0x21) and page (0x22) window starting at (x, y)
 void ssd1306_setpos(uint8_t x, uint8_t y)
 {
 	ssd1306_send_command_start();
-	ssd1306_send_byte(0xb0 + y);
-	ssd1306_send_byte(((x & 0xf0) >> 4) | 0x10); // | 0x10
-/* TODO: Verify correctness */	ssd1306_send_byte((x & 0x0f)); // | 0x01
+	ssd1306_send_byte(0x21);
+	ssd1306_send_byte(x);
+	ssd1306_send_byte(127);
+	ssd1306_send_byte(0x22);
+	ssd1306_send_byte(y);
+	ssd1306_send_byte(7);
 	ssd1306_send_command_stop();
 }
 
@@ -0,0 +1,7 @@
+//
+// oled.cpp includes Circle's bcm2835.h, nothing is needed from it on the host
+//
+#ifndef _circle_bcm2835_h
+#define _circle_bcm2835_h
+
+#endif
@@ -0,0 +1,7 @@
+//
+// oled.cpp includes Circle's memio.h, nothing is needed from it on the host
+//
+#ifndef _circle_memio_h
+#define _circle_memio_h
+
+#endif
@@ -0,0 +1,9 @@
+//
+// minimal replacement of Circle's util.h for building the OLED code on the host
+//
+#ifndef _circle_util_h
+#define _circle_util_h
+
+#include <string.h>
+
+#endif
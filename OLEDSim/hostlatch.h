@@ -0,0 +1,38 @@
+//
+// host replacement for the parts of latch.h, lowlevel_arm64.h and helpers.h used by oled.cpp and OLED/ssd1306xled.cpp
+// (the Makefile defines the include guards of these headers and includes this file instead)
+//
+// putI2CCommand appends to a plain array instead of the 2-bit packed ring buffer of the FIQ, the simulator in
+// oledsim.cpp then replays the entries as prepareOutputLatch/outputLatch would
+//
+#ifndef _hostlatch_h
+#define _hostlatch_h
+
+#include <circle/types.h>
+
+#define MAX_I2C_ENTRIES		( 1 << 20 )
+
+extern u8 i2cEntry[ MAX_I2C_ENTRIES ];
+extern u32 nI2CEntries;
+
+static inline void putI2CCommand( u32 c )
+{
+	if ( nI2CEntries < MAX_I2C_ENTRIES )
+		i2cEntry[ nI2CEntries ++ ] = c & 3;
+}
+
+static inline boolean bufferEmptyI2C()
+{
+	return nI2CEntries == 0;
+}
+
+// on the C64 this busy-waits until the FIQ has output everything, here the entries are simply kept for the simulator
+static inline void flushI2CBuffer( bool withoutCycleCounter = false )
+{
+	(void)withoutCycleCounter;
+}
+
+class CLogger;
+extern int readFile( CLogger *logger, const char *DRIVE, const char *FILENAME, u8 *data, u32 *size );
+
+#endif
@@ -0,0 +1,390 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  |
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   |
+        \/         \/    \/     \/       \/     \/            \/       \/      |__|
+
+ oledsim.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - simulation of the OLED output via the latch (runs on the host)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hostlatch.h"
+#include "oled.h"
+#include "OLED/ssd1306xled.h"
+#include "splash_sid.h"
+
+#ifndef min
+#define min( a, b ) ( ((a)<(b))?(a):(b) )
+#endif
+#ifndef max
+#define max( a, b ) ( ((a)>(b))?(a):(b) )
+#endif
+
+u8 i2cEntry[ MAX_I2C_ENTRIES ];
+u32 nI2CEntries = 0;
+
+CLogger *logger = NULL;
+
+int readFile( CLogger *logger, const char *DRIVE, const char *FILENAME, u8 *data, u32 *size )
+{
+	return 0;
+}
+
+// the SID kernels call prepareOutputLatch() (i.e. output one latch change) in every 2nd FIQ, i.e. C64 cycle
+#define BUS_CYCLES_PER_LATCH_STEP	2
+#define C64_CLOCK					985248
+
+//
+// the FIQ side: prepareOutputLatch() + outputLatch(), and an SSD1306 listening to SDA/SCL
+//
+static struct
+{
+	u32 sda, scl, lastSDAValue;
+
+	u64 entries, skipped, latchSteps;
+
+	// I2C receiver
+	u32 inTransfer, bit, byte, byteIdx, isData;
+
+	// command waiting for its arguments
+	u32 cmd, args, nArgs;
+	u8  arg[ 2 ];
+
+	// SSD1306: addressing mode (0x20), column and page window (0x21, 0x22) and the address pointer
+	u32 mode, colStart, colEnd, pageStart, pageEnd;
+	u32 page, col, dataBytes;
+	u8  ram[ 128 * 64 / 8 ];
+} sim;
+
+#define MODE_HORIZONTAL		0
+#define MODE_VERTICAL		1
+#define MODE_PAGE			2
+
+static void ssd1306Reset()
+{
+	memset( &sim, 0, sizeof( sim ) );
+	sim.sda = sim.scl = 1;
+	sim.lastSDAValue = 255;
+
+	// state after power-on as in the datasheet
+	sim.mode = MODE_PAGE;
+	sim.colEnd = 127;
+	sim.pageEnd = 7;
+}
+
+// data byte: the address pointer advances as selected by the addressing mode
+static void ssd1306Data( u8 b )
+{
+	sim.ram[ sim.page * 128 + sim.col ] = b;
+	sim.dataBytes ++;
+
+	switch ( sim.mode )
+	{
+	case MODE_HORIZONTAL:
+		if ( sim.col ++ == sim.colEnd )
+		{
+			sim.col = sim.colStart;
+			sim.page = ( sim.page == sim.pageEnd ) ? sim.pageStart : sim.page + 1;
+		}
+		break;
+	case MODE_VERTICAL:
+		if ( sim.page ++ == sim.pageEnd )
+		{
+			sim.page = sim.pageStart;
+			sim.col = ( sim.col == sim.colEnd ) ? sim.colStart : sim.col + 1;
+		}
+		break;
+	default:
+		// page addressing mode: the column wraps around, the page stays
+		sim.col = ( sim.col + 1 ) & 127;
+		break;
+	}
+}
+
+// a command with all its arguments
+static void ssd1306Command( u8 b )
+{
+	switch ( b )
+	{
+	case 0x20:
+		sim.mode = sim.arg[ 0 ] & 3;
+		return;
+	case 0x21:
+		// column window, ignored in page addressing mode
+		if ( sim.mode == MODE_PAGE ) return;
+		sim.col = sim.colStart = sim.arg[ 0 ] & 127;
+		sim.colEnd = sim.arg[ 1 ] & 127;
+		return;
+	case 0x22:
+		// page window, ignored in page addressing mode
+		if ( sim.mode == MODE_PAGE ) return;
+		sim.page = sim.pageStart = sim.arg[ 0 ] & 7;
+		sim.pageEnd = sim.arg[ 1 ] & 7;
+		return;
+	}
+
+	// page and column start address, only for page addressing mode
+	if ( sim.mode != MODE_PAGE )
+		return;
+
+	if ( ( b & 0xf8 ) == 0xb0 ) sim.page = b & 7; else
+	if ( ( b & 0xf0 ) == 0x00 ) sim.col = ( sim.col & 0xf0 ) | ( b & 15 ); else
+	if ( ( b & 0xf0 ) == 0x10 ) sim.col = ( sim.col & 0x0f ) | ( ( b & 7 ) << 4 );
+}
+
+static void ssd1306Byte( u8 b )
+{
+	if ( sim.byteIdx ++ == 0 )
+	{
+		if ( b != SSD1306_SA )
+			sim.inTransfer = 0;
+		return;
+	}
+
+	if ( sim.byteIdx == 2 )
+	{
+		sim.isData = ( b == 0x40 );
+		sim.args = 0;
+		return;
+	}
+
+	if ( sim.isData )
+	{
+		ssd1306Data( b );
+		return;
+	}
+
+	// arguments of a previous command
+	if ( sim.args )
+	{
+		sim.arg[ sim.nArgs ++ ] = b;
+		if ( -- sim.args == 0 )
+			ssd1306Command( sim.cmd );
+		return;
+	}
+
+	sim.cmd = b;
+	sim.nArgs = 0;
+	if ( b == 0x21 || b == 0x22 ) sim.args = 2; else
+	if ( b == 0x20 || b == 0x81 || b == 0xa8 || b == 0xd3 || b == 0xd5 || b == 0xd9 || b == 0xda || b == 0xdb || b == 0x8d )
+		sim.args = 1; else
+		ssd1306Command( b );
+}
+
+static void i2cLines( u32 sda, u32 scl )
+{
+	if ( sim.scl && scl )
+	{
+		// SDA changes while SCL is high: start or stop condition
+		if ( sim.sda && !sda )
+		{
+			sim.inTransfer = 1;
+			sim.bit = sim.byte = sim.byteIdx = 0;
+		} else
+		if ( !sim.sda && sda )
+			sim.inTransfer = 0;
+	} else
+	if ( !sim.scl && scl && sim.inTransfer )
+	{
+		// rising SCL: 8 data bits, then the acknowledge slot
+		if ( sim.bit < 8 )
+		{
+			sim.byte = ( sim.byte << 1 ) | sda;
+			if ( ++ sim.bit == 8 )
+				ssd1306Byte( sim.byte & 255 );
+		} else
+			sim.bit = sim.byte = 0;
+	}
+
+	sim.sda = sda;
+	sim.scl = scl;
+}
+
+// replays the buffer as prepareOutputLatch() in latch.h: SDA entries which do not change SDA are skipped
+// without a latch step, every other entry takes one step
+static void drainI2CBuffer()
+{
+	for ( u32 i = 0; i < nI2CEntries; i++ )
+	{
+		u32 c = i2cEntry[ i ];
+		sim.entries ++;
+
+		if ( !( c & 2 ) )
+		{
+			if ( ( c & 1 ) == sim.lastSDAValue )
+			{
+				sim.skipped ++;
+				continue;
+			}
+			sim.lastSDAValue = c & 1;
+			i2cLines( c & 1, sim.scl );
+		} else
+			i2cLines( sim.sda, c & 1 );
+
+		sim.latchSteps ++;
+	}
+	nI2CEntries = 0;
+}
+
+//
+// the kernel side: the OLED oscilloscope of oscilloscope_hack.h, transferred as in the main loop of kernel_sid.cpp
+//
+#define WORKLOAD_SILENCE	0
+#define WORKLOAD_TONE		1
+#define WORKLOAD_MUSIC		2
+#define WORKLOAD_NOISE		3
+#define NUM_WORKLOADS		4
+
+static const char *workloadName[ NUM_WORKLOADS ] = { "silence", "tone", "music", "noise" };
+
+static s32 sampleValue( u32 workload, double t )
+{
+	switch ( workload )
+	{
+	default:
+	case WORKLOAD_SILENCE:
+		return 0;
+	case WORKLOAD_TONE:
+		return (s32)( 4000 * sin( 2 * M_PI * 220 * t ) );
+	case WORKLOAD_MUSIC:
+	{
+		// a few notes changing every 1/8 s with a decaying envelope
+		static const double freq[ 8 ] = { 110, 165, 220, 147, 196, 131, 262, 175 };
+		u32 note = (u32)( t * 8 ) & 7;
+		double env = exp( -6 * fmod( t, 0.125 ) / 0.125 );
+		return (s32)( env * ( 3000 * sin( 2 * M_PI * freq[ note ] * t ) + 1500 * ( fmod( freq[ note ] * 2 * t, 1.0 ) - 0.5 ) ) );
+	}
+	case WORKLOAD_NOISE:
+		return ( rand() % 12000 ) - 6000;
+	}
+}
+
+static void renderScope( u32 workload, double t )
+{
+	memcpy( oledFrameBuffer, raspi_sid_splash, 128 * 64 / 8 );
+
+	// one column per 4 samples at 44.1 kHz
+	for ( u32 xpos = 0; xpos < 128; xpos++, t += 4 / 44100.0 )
+	{
+		s32 y = 32 + min( 29, max( -29, sampleValue( workload, t ) / 192 ) );
+		oledSetPixel( xpos, y );
+		oledClearPixel( xpos, y - 1 );
+		oledClearPixel( xpos, y + 1 );
+	}
+}
+
+static u32 verifyFrame()
+{
+	u32 errors = 0;
+	for ( u32 i = 0; i < 128 * 64 / 8; i++ )
+		if ( sim.ram[ i ] != oledFrameBuffer[ i ] )
+			errors ++;
+	return errors;
+}
+
+static void usage()
+{
+	printf( "usage: oledsim [options]\n" );
+	printf( "  -n frames      number of frames per workload (default 200)\n" );
+}
+
+int main( int argc, char **argv )
+{
+	u32 nFrames = 200;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[ i ], "-n" ) == 0 && i + 1 < argc )
+		{
+			int n = atoi( argv[ ++i ] );
+			nFrames = max( 1, n );
+			continue;
+		}
+		usage();
+		return 1;
+	}
+
+	int result = 0;
+
+	printf( "%-8s %-6s %10s %10s %10s %10s %10s %8s\n", "workload", "update", "bytes", "entries", "skipped", "steps", "cycles", "fps" );
+
+	for ( u32 workload = 0; workload < NUM_WORKLOADS; workload++ )
+	for ( int full = 1; full >= 0; full-- )
+	{
+		ssd1306Reset();
+		srand( 1 );
+
+		// as the SID kernel: initialization and splash screen, then scope frames
+		splashScreen( raspi_sid_splash );
+		drainI2CBuffer();
+
+		u64 entries = sim.entries, skipped = sim.skipped, steps = sim.latchSteps, dataBytes = sim.dataBytes;
+		u32 errors = 0;
+		double t = 0;
+
+		for ( u32 f = 0; f < nFrames; f++ )
+		{
+			u64 frameSteps = sim.latchSteps;
+
+			renderScope( workload, t );
+
+			if ( full )
+				oledInvalidate();
+
+			sendFramebufferStart();
+			while ( !sendFramebufferDone() )
+				sendFramebufferNext( 1 );
+			drainI2CBuffer();
+
+			if ( verifyFrame() )
+				errors ++;
+
+			// the next frame is rendered after the transfer (and the rendering of 128 columns)
+			t += ( sim.latchSteps - frameSteps ) * BUS_CYCLES_PER_LATCH_STEP / (double)C64_CLOCK + 128 * 4 / 44100.0;
+		}
+
+		entries = sim.entries - entries;
+		skipped = sim.skipped - skipped;
+		steps = sim.latchSteps - steps;
+		dataBytes = sim.dataBytes - dataBytes;
+
+		double cycles = steps * BUS_CYCLES_PER_LATCH_STEP / (double)nFrames;
+		printf( "%-8s %-6s %10.1f %10.1f %10.1f %10.1f %10.1f %8.1f\n", workloadName[ workload ], full ? "full" : "dirty",
+			dataBytes / (double)nFrames, entries / (double)nFrames, skipped / (double)nFrames, steps / (double)nFrames,
+			cycles, cycles > 0 ? C64_CLOCK / cycles : 0.0 );
+
+		if ( errors )
+		{
+			printf( "%u of %u frames differ on the simulated display\n", errors, nFrames );
+			result = 2;
+		}
+	}
+
+	printf( "(per frame: data bytes, buffer entries, entries skipped by the FIQ, latch steps, C64 cycles, max. frames per second)\n" );
+
+	return result;
+}
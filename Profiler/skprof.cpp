@@ -0,0 +1,333 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ skprof.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - symbolizer for the samples of the profiler (profiler.h)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+//
+// symbolizer for the samples of the profiler (see ../profiler.h): the addresses are resolved by addr2line using
+// the kernel's ELF file, functions inlined at an address become frames of their own (the sampler does not walk the stack)
+//
+typedef struct
+{
+	std::vector<std::string> frames;		// outermost first
+	std::string location;					// file:line of the address
+} SYMBOL;
+
+static const char *addr2line = "aarch64-none-elf-addr2line";
+
+static void usage()
+{
+	fprintf( stderr, "usage: skprof [options] -e kernel8.elf prof000.skp [prof001.skp ...]\n"
+					 "  -e file    ELF file of the kernel which recorded the samples\n"
+					 "  -t tool    addr2line of the cross toolchain (default %s)\n"
+					 "  -c ctx     only the samples of one context (menu, net, sid, kernel)\n"
+					 "  -l         source line of the sampled address as the innermost frame\n"
+					 "  -f n       flat profile of the n functions with most samples instead of folded stacks\n", addr2line );
+}
+
+static u8 *readWholeFile( const char *fn, u32 *size )
+{
+	FILE *f = fopen( fn, "rb" );
+	if ( f == NULL )
+		return NULL;
+
+	fseek( f, 0, SEEK_END );
+	*size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+
+	u8 *data = new u8[ *size + 1 ];
+	if ( fread( data, 1, *size, f ) != *size )
+	{
+		delete [] data;
+		data = NULL;
+	}
+	fclose( f );
+
+	return data;
+}
+
+static void finishSymbol( SYMBOL *s, std::vector<std::string> &lines )
+{
+	if ( s == NULL )
+		return;
+
+	// pairs of function and file:line, from the innermost inlined function to the one containing it
+	// (GNU addr2line may report the containing function for both, such frames are merged)
+	for ( size_t i = 0; i < lines.size(); i += 2 )
+		if ( s->frames.size() == 0 || s->frames.front() != lines[ i ] )
+			s->frames.insert( s->frames.begin(), lines[ i ] );
+	if ( lines.size() > 1 )
+		s->location = lines[ 1 ];
+
+	lines.clear();
+}
+
+// resolves all addresses with one call of addr2line
+static int symbolize( const char *elf, const std::map<u32, u32> &counts, std::map<u32, SYMBOL> &symbols )
+{
+	char tmp[] = "/tmp/skprofXXXXXX";
+	int fd = mkstemp( tmp );
+	if ( fd < 0 )
+		return 0;
+
+	FILE *f = fdopen( fd, "w" );
+	for ( std::map<u32, u32>::const_iterator it = counts.begin(); it != counts.end(); it++ )
+		fprintf( f, "0x%08x\n", it->first );
+	fclose( f );
+
+	// -a prints each address before its function/location pairs
+	std::string cmd = std::string( addr2line ) + " -a -f -i -C -e '" + elf + "' < " + tmp;
+	FILE *p = popen( cmd.c_str(), "r" );
+	if ( p == NULL )
+	{
+		remove( tmp );
+		return 0;
+	}
+
+	char line[ 4096 ];
+	SYMBOL *cur = NULL;
+	std::vector<std::string> lines;
+
+	while ( fgets( line, sizeof( line ), p ) )
+	{
+		line[ strcspn( line, "\r\n" ) ] = 0;
+
+		if ( line[ 0 ] == '0' && line[ 1 ] == 'x' )
+		{
+			finishSymbol( cur, lines );
+			cur = &symbols[ (u32)strtoul( line, NULL, 16 ) ];
+		} else
+		if ( cur != NULL && line[ 0 ] != 0 )		// llvm-symbolizer separates the addresses by empty lines
+			lines.push_back( line );
+	}
+	finishSymbol( cur, lines );
+
+	int ok = pclose( p ) == 0;
+	remove( tmp );
+
+	return ok && symbols.size() == counts.size();
+}
+
+// flamegraph.pl separates the frames by ';' and the count by the last ' '
+static std::string frameName( const std::string &s )
+{
+	std::string r = s;
+	for ( size_t i = 0; i < r.size(); i++ )
+		if ( r[ i ] == ';' ) r[ i ] = ','; else
+		if ( r[ i ] == ' ' ) r[ i ] = '_';
+	return r;
+}
+
+int main( int argc, char **argv )
+{
+	const char *elf = NULL;
+	int onlyContext = -1, withLines = 0, flat = 0;
+	std::vector<const char *> files;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[ i ], "-l" ) == 0 )
+		{
+			withLines = 1;
+			continue;
+		}
+		if ( strcmp( argv[ i ], "-c" ) == 0 && i + 1 < argc )
+		{
+			i ++;
+			for ( onlyContext = 0; onlyContext < PROFILE_CONTEXTS; onlyContext++ )
+				if ( strcmp( argv[ i ], profileContextName[ onlyContext ] ) == 0 )
+					break;
+			if ( onlyContext < PROFILE_CONTEXTS )
+				continue;
+		} else
+		if ( argv[ i ][ 0 ] == '-' && i + 1 < argc )
+		{
+			switch ( argv[ i ][ 1 ] )
+			{
+			case 'e': elf = argv[ ++i ]; continue;
+			case 't': addr2line = argv[ ++i ]; continue;
+			case 'f': flat = atoi( argv[ ++i ] ); continue;
+			}
+		} else
+		if ( argv[ i ][ 0 ] != '-' )
+		{
+			files.push_back( argv[ i ] );
+			continue;
+		}
+		usage();
+		return 1;
+	}
+
+	if ( elf == NULL || files.size() == 0 )
+	{
+		usage();
+		return 1;
+	}
+
+	// samples per (context, address), several dumps (e.g. fetched one after the other from the web server) are merged
+	std::map<u32, u32> counts[ PROFILE_CONTEXTS ], allAddresses;
+	u32 delayed[ PROFILE_CONTEXTS ] = { 0 };
+	u32 nSamples = 0, nDropped = 0, rate = 0;
+
+	for ( size_t i = 0; i < files.size(); i++ )
+	{
+		u32 size;
+		u8 *data = readWholeFile( files[ i ], &size );
+		if ( data == NULL || size < sizeof( PROFILE_HEADER ) )
+		{
+			fprintf( stderr, "cannot read %s\n", files[ i ] );
+			return 1;
+		}
+
+		PROFILE_HEADER hdr;
+		memcpy( &hdr, data, sizeof( PROFILE_HEADER ) );
+		if ( hdr.magic != PROFILE_MAGIC || hdr.version != PROFILE_VERSION ||
+			 size < sizeof( PROFILE_HEADER ) + hdr.nSamples * sizeof( PROFILE_SAMPLE ) )
+		{
+			fprintf( stderr, "%s is not a profile (or an unsupported version)\n", files[ i ] );
+			return 1;
+		}
+
+		if ( rate != 0 && hdr.rate != rate )
+			fprintf( stderr, "%s: recorded at %u Hz instead of %u Hz\n", files[ i ], hdr.rate, rate );
+		rate = hdr.rate;
+
+		const PROFILE_SAMPLE *s = (const PROFILE_SAMPLE *)( data + sizeof( PROFILE_HEADER ) );
+		for ( u32 j = 0; j < hdr.nSamples; j++ )
+		{
+			u32 ctx = s[ j ].context & ~PROFILE_DELAYED;
+			if ( ctx >= PROFILE_CONTEXTS || ( onlyContext >= 0 && (int)ctx != onlyContext ) )
+				continue;
+
+			if ( s[ j ].context & PROFILE_DELAYED )
+				delayed[ ctx ] ++; else
+			{
+				counts[ ctx ][ s[ j ].pc ] ++;
+				allAddresses[ s[ j ].pc ] ++;
+			}
+			nSamples ++;
+		}
+		nDropped += hdr.nDropped;
+
+		delete [] data;
+	}
+
+	fprintf( stderr, "%u samples at %u Hz (%.1f s), %u dropped\n", nSamples, rate, rate ? nSamples / (double)rate : 0.0, nDropped );
+
+	std::map<u32, SYMBOL> symbols;
+	if ( allAddresses.size() && !symbolize( elf, allAddresses, symbols ) )
+	{
+		fprintf( stderr, "cannot resolve the addresses with %s\n", addr2line );
+		return 1;
+	}
+
+	// folded stacks: one line per (context, address), flamegraph.pl adds up identical stacks
+	std::map<std::string, u32> folded;
+
+	for ( int c = 0; c < PROFILE_CONTEXTS; c++ )
+	{
+		if ( delayed[ c ] )
+			folded[ std::string( profileContextName[ c ] ) + ";[IRQs disabled]" ] += delayed[ c ];
+
+		for ( std::map<u32, u32>::iterator it = counts[ c ].begin(); it != counts[ c ].end(); it++ )
+		{
+			const SYMBOL &sym = symbols[ it->first ];
+			std::string stack = profileContextName[ c ];
+
+			for ( size_t f = 0; f < sym.frames.size(); f++ )
+			{
+				if ( sym.frames[ f ] == "??" )
+				{
+					char a[ 16 ];
+					sprintf( a, "0x%08x", it->first );
+					stack += std::string( ";" ) + a;
+				} else
+					stack += ";" + frameName( sym.frames[ f ] );
+			}
+
+			if ( withLines && sym.location.size() && sym.location[ 0 ] != '?' )
+			{
+				// without the directory
+				size_t p = sym.location.find_last_of( '/' );
+				stack += ";" + frameName( p == std::string::npos ? sym.location : sym.location.substr( p + 1 ) );
+			}
+
+			folded[ stack ] += it->second;
+		}
+	}
+
+	if ( flat == 0 )
+	{
+		for ( std::map<std::string, u32>::iterator it = folded.begin(); it != folded.end(); it++ )
+			printf( "%s %u\n", it->first.c_str(), it->second );
+		return 0;
+	}
+
+	// flat profile: samples of the innermost frame (self) and of all stacks containing a function (total)
+	std::map<std::string, u32> self, total;
+	for ( std::map<std::string, u32>::iterator it = folded.begin(); it != folded.end(); it++ )
+	{
+		std::vector<std::string> frames;
+		size_t a = it->first.find( ';' );
+		while ( a != std::string::npos )
+		{
+			size_t b = it->first.find( ';', a + 1 );
+			frames.push_back( it->first.substr( a + 1, b == std::string::npos ? std::string::npos : b - a - 1 ) );
+			a = b;
+		}
+		if ( withLines && frames.size() > 1 )
+			frames.pop_back();
+
+		self[ frames.back() ] += it->second;
+		std::map<std::string, int> seen;
+		for ( size_t f = 0; f < frames.size(); f++ )
+			if ( seen[ frames[ f ] ]++ == 0 )
+				total[ frames[ f ] ] += it->second;
+	}
+
+	std::vector<std::pair<u32, std::string> > order;
+	for ( std::map<std::string, u32>::iterator it = self.begin(); it != self.end(); it++ )
+		order.push_back( std::make_pair( it->second, it->first ) );
+	std::sort( order.rbegin(), order.rend() );
+
+	printf( "  self%%  total%%  function\n" );
+	for ( int i = 0; i < flat && i < (int)order.size(); i++ )
+		printf( "%6.2f  %6.2f  %s\n", 100.0 * order[ i ].first / nSamples, 100.0 * total[ order[ i ].second ] / nSamples, order[ i ].second.c_str() );
+
+	return 0;
+}
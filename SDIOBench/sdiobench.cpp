@@ -0,0 +1,455 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sdiobench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - host tool: checks and measures the asynchronous file access
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+//
+// sdiobench: checks the request queue and the streams of ../sdio.cpp against a model of the file contents, and compares
+// the time the menu cannot react to a key press and the time a sequential reader waits for data with and without sdio.cpp
+//
+// the FatFs glue (../sdiofs.cpp) is replaced by files in a directory on the host plus a timing model of the SD card
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include "sdio.h"
+
+//
+// glue: "SD:" is a directory on the host, time is simulated
+//
+static std::string root;
+static FILE *file = NULL;
+static std::string fileName;
+
+// SD card model (in microseconds): a command costs a fixed latency, transfers are limited by the bandwidth
+static double simTime = 0;
+static double cmdLatency = 250, bytesPerUs = 20;	// 20 MB/s
+static u32 reopenRate = 0;							// other code accesses the SD card after 1/n of the calls of sdioPoll (0 = never)
+static u32 fileInvalid = 0;
+
+static u32 rnd = 12345;
+static u32 random32()
+{
+	rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+	return rnd;
+}
+
+static std::string hostPath( const char *FILENAME )
+{
+	const char *n = strncmp( FILENAME, "SD:", 3 ) == 0 ? FILENAME + 3 : FILENAME;
+	return root + "/" + n;
+}
+
+int sdioFsSize( const char *FILENAME, u32 *size )
+{
+	simTime += cmdLatency;
+	FILE *f = fopen( hostPath( FILENAME ).c_str(), "rb" );
+	if ( !f )
+		return 0;
+	fseek( f, 0, SEEK_END );
+	*size = ftell( f );
+	fclose( f );
+	return 1;
+}
+
+int sdioFsOpen( const char *FILENAME, u32 write, u32 create )
+{
+	simTime += cmdLatency;
+	std::string p = hostPath( FILENAME );
+	if ( write && !create )
+	{
+		file = fopen( p.c_str(), "r+b" );
+		if ( !file )
+			file = fopen( p.c_str(), "w+b" );
+	} else
+		file = fopen( p.c_str(), write ? "w+b" : "rb" );
+	fileName = FILENAME;
+	fileInvalid = 0;
+	return file != NULL;
+}
+
+static int transfer( u32 offset, u8 *data, u32 size, u32 *bytes, u32 write )
+{
+	if ( !file )
+		return SDIO_FS_ERROR;
+	// as FatFs after the drive has been unmounted and mounted again
+	if ( fileInvalid )
+	{
+		fileInvalid = 0;
+		fclose( file );
+		file = NULL;
+		return SDIO_FS_REOPEN;
+	}
+	if ( (u32)ftell( file ) != offset )
+	{
+		simTime += cmdLatency;
+		fseek( file, offset, SEEK_SET );
+	}
+	*bytes = write ? fwrite( data, 1, size, file ) : fread( data, 1, size, file );
+	simTime += cmdLatency + *bytes / bytesPerUs;
+	return SDIO_FS_OK;
+}
+
+int sdioFsRead( u32 offset, u8 *data, u32 size, u32 *bytes )
+{
+	return transfer( offset, data, size, bytes, 0 );
+}
+
+int sdioFsWrite( u32 offset, const u8 *data, u32 size, u32 *bytes )
+{
+	return transfer( offset, (u8*)data, size, bytes, 1 );
+}
+
+void sdioFsClose()
+{
+	if ( file )
+		fclose( file );
+	file = NULL;
+}
+
+//
+// checks
+//
+static u32 errors = 0;
+
+static u32 poll()
+{
+	u32 r = sdioPoll();
+	if ( reopenRate && random32() % reopenRate == 0 )
+		fileInvalid = 1;
+	return r;
+}
+
+static void check( bool ok, const char *what )
+{
+	if ( !ok && errors ++ < 10 )
+		printf( "mismatch: %s\n", what );
+}
+
+static std::map< std::string, std::vector< u8 > > model;
+
+static void createFile( const char *name, u32 size )
+{
+	std::vector< u8 > &d = model[ name ];
+	d.resize( size );
+	for ( u32 i = 0; i < size; i++ )
+		d[ i ] = random32();
+	FILE *f = fopen( hostPath( name ).c_str(), "wb" );
+	fwrite( d.data(), 1, size, f );
+	fclose( f );
+}
+
+static const char *names[] = { "SD:a.crt", "SD:b.d64", "SD:c.prg", "SD:d.sid" };
+
+// random reads and writes, several requests in flight, polled in between
+static void checkRequests()
+{
+	struct PENDING { s32 req; std::string name; u32 write, ofs, size; std::vector< u8 > data; u8 *dest; };
+	std::vector< PENDING > pending;
+	static u8 dest[ 16 ][ 256 * 1024 ];
+	u32 destUsed[ 16 ] = { 0 };
+
+	for ( u32 it = 0; it < 4000; it++ )
+	{
+		u32 r = random32() % 10;
+		if ( r < 4 && pending.size() < SDIO_REQUESTS )
+		{
+			PENDING p;
+			p.name = names[ random32() % 4 ];
+			u32 fsize = model[ p.name ].size();
+			p.write = random32() % 4 == 0;
+			p.ofs = random32() % ( fsize + 1 );
+			p.size = 1 + random32() % ( 200 * 1024 );
+			p.dest = NULL;
+
+			// writes must not overlap pending requests of the same file (the order is kept, but the model is updated at submission)
+			bool overlap = false;
+			for ( auto &q : pending )
+				if ( q.name == p.name && ( p.write || q.write ) && p.ofs < q.ofs + q.size && q.ofs < p.ofs + p.size )
+					overlap = true;
+			if ( overlap )
+				continue;
+
+			if ( p.write )
+			{
+				if ( p.ofs == 0 ) p.ofs = 1;	// offset 0 truncates, which the model does not do
+				p.data.resize( p.size );
+				for ( auto &b : p.data ) b = random32();
+				p.req = sdioWrite( p.name.c_str(), p.ofs, p.size, p.data.data() );
+			} else
+			{
+				s32 d = -1;
+				if ( p.size > SDIO_BUFFER_SIZE || random32() % 2 )
+					for ( u32 i = 0; i < 16; i++ )
+						if ( !destUsed[ i ] ) { d = i; break; }
+				if ( d < 0 && p.size > SDIO_BUFFER_SIZE )
+					continue;
+				if ( d >= 0 ) { destUsed[ d ] = 1; p.dest = dest[ d ]; }
+				p.req = sdioRead( p.name.c_str(), p.ofs, p.size, p.dest );
+				if ( p.req < 0 && d >= 0 ) destUsed[ d ] = 0;
+			}
+			if ( p.req < 0 )
+				continue;
+
+			if ( p.write )
+			{
+				std::vector< u8 > &m = model[ p.name ];
+				if ( m.size() < p.ofs + p.size )
+					m.resize( p.ofs + p.size );
+				memcpy( &m[ p.ofs ], p.data.data(), p.size );
+			} else
+			{
+				std::vector< u8 > &m = model[ p.name ];
+				u32 n = p.ofs < m.size() ? std::min( (u32)m.size() - p.ofs, p.size ) : 0;
+				p.data.assign( m.begin() + p.ofs, m.begin() + p.ofs + n );
+			}
+			pending.push_back( std::move( p ) );	// keeps p.data where the write request points to
+		} else
+		if ( r < 8 )
+			poll(); else
+		if ( !pending.empty() )
+		{
+			u32 i = random32() % pending.size();
+			PENDING &p = pending[ i ];
+
+			// cancelling reads is fine, writes are completed as their data is in the model
+			if ( !p.write && random32() % 8 == 0 )
+			{
+				sdioRelease( p.req );
+			} else
+			{
+				check( sdioWait( p.req ) == SDIO_DONE, "request failed" );
+				if ( !p.write )
+				{
+					check( sdioBytes( p.req ) == p.data.size(), "number of bytes read" );
+					check( memcmp( sdioData( p.req ), p.data.data(), p.data.size() ) == 0, "data read" );
+				} else
+					check( sdioBytes( p.req ) == p.size, "number of bytes written" );
+				sdioRelease( p.req );
+			}
+			for ( u32 d = 0; d < 16; d++ )
+				if ( p.dest == dest[ d ] ) destUsed[ d ] = 0;
+			pending.erase( pending.begin() + i );
+		}
+	}
+
+	for ( auto &p : pending )
+	{
+		sdioWait( p.req );
+		sdioRelease( p.req );
+	}
+	while ( sdioPoll() );
+
+	// written data ends up in the files
+	for ( auto &m : model )
+	{
+		FILE *f = fopen( hostPath( m.first.c_str() ).c_str(), "rb" );
+		std::vector< u8 > d( m.second.size() + 1 );
+		u32 n = fread( d.data(), 1, d.size(), f );
+		fclose( f );
+		check( n == m.second.size() && memcmp( d.data(), m.second.data(), n ) == 0, "file contents after writing" );
+	}
+}
+
+// sequential reads with random sizes and occasional seeks
+static void checkStreams()
+{
+	for ( u32 it = 0; it < 200; it++ )
+	{
+		const char *name = names[ random32() % 4 ];
+		std::vector< u8 > &m = model[ name ];
+
+		SDIO_STREAM s;
+		check( sdioStreamOpen( &s, name ) != 0, "stream open" );
+
+		u32 pos = 0;
+		static u8 buf[ 100000 ];
+		for ( u32 k = 0; k < 100; k++ )
+		{
+			if ( random32() % 16 == 0 )
+			{
+				pos = random32() % ( m.size() + 1 );
+				sdioStreamSeek( &s, pos );
+			}
+			u32 size = random32() % ( random32() % 2 ? 300 : 100000 );
+			u32 n = sdioStreamRead( &s, buf, size );
+			u32 expect = std::min( size, (u32)m.size() - pos );
+			check( n == expect, "stream: number of bytes" );
+			check( memcmp( buf, &m[ pos ], n ) == 0, "stream: data" );
+			pos += n;
+			if ( random32() % 2 )
+				poll();
+		}
+		sdioStreamClose( &s );
+	}
+	while ( sdioPoll() );
+}
+
+//
+// timing (simulated)
+//
+
+// longest time the main loop is blocked while a 1 MB image is read: in one go, or by sdioPoll in chunks
+static void benchResponsiveness()
+{
+	static u8 data[ 1032 * 1024 ];
+	u32 size = model[ "SD:a.crt" ].size();
+
+	double t0 = simTime;
+	u32 bytes;
+	sdioFsOpen( "SD:a.crt", 0, 0 );
+	sdioFsRead( 0, data, size, &bytes );
+	sdioFsClose();
+	double blocking = simTime - t0;
+
+	s32 req = sdioRead( "SD:a.crt", 0, size, data );
+	double maxStep = 0, total = 0;
+	for ( ;; )
+	{
+		t0 = simTime;
+		u32 more = sdioPoll();
+		maxStep = std::max( maxStep, simTime - t0 );
+		total += simTime - t0;
+		if ( !more ) break;
+	}
+	sdioRelease( req );
+
+	printf( "reading %d bytes: blocking %.1f ms, sdioPoll %.1f ms in total, main loop blocked for at most %.2f ms\n", size, blocking / 1000, total / 1000, maxStep / 1000 );
+}
+
+// a reader consumes 'piece' bytes per iteration of its main loop, in between the loop is idle for 'idle' us
+// (sdioPoll is called then): time the reader is delayed by reading, synchronous reads vs. stream with read-ahead
+static void benchReadAhead( u32 piece, double idle )
+{
+	static u8 buf[ 65536 ];
+	const char *name = "SD:a.crt";
+	u32 size = model[ name ].size();
+
+	// synchronous: read each piece when it is needed
+	double wait0 = 0;
+	sdioFsOpen( name, 0, 0 );
+	for ( u32 pos = 0; pos < size; pos += piece )
+	{
+		double t = simTime;
+		u32 bytes;
+		sdioFsRead( pos, buf, std::min( piece, size - pos ), &bytes );
+		wait0 += simTime - t;
+		simTime += idle;
+	}
+	sdioFsClose();
+
+	// stream: the idle time of the loop is used by sdioPoll (which has to fit in, otherwise the loop is late)
+	double wait1 = 0, late = 0;
+	SDIO_STREAM s;
+	sdioStreamOpen( &s, name );
+	for ( u32 pos = 0; pos < size; pos += piece )
+	{
+		double t = simTime;
+		sdioStreamRead( &s, buf, std::min( piece, size - pos ) );
+		wait1 += simTime - t;
+
+		t = simTime;
+		double end = simTime + idle;
+		while ( simTime < end && sdioPoll() );
+		late += std::max( 0.0, simTime - end );
+		simTime = std::max( simTime, end );
+	}
+	sdioStreamClose( &s );
+	while ( sdioPoll() );
+
+	printf( "  %6d bytes per iteration, idle %5.0f us: reader delayed by %6.1f ms synchronously, %6.1f ms with read-ahead (%5.1f ms waiting, %5.1f ms polls exceeding the idle time)\n",
+		piece, idle, wait0 / 1000, ( wait1 + late ) / 1000, wait1 / 1000, late / 1000 );
+}
+
+// CPU time of the queue itself (glue without latency, real time)
+static void benchOverhead()
+{
+	double l = cmdLatency, b = bytesPerUs;
+	static u8 data[ 4096 ];
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	const u32 n = 100000;
+	for ( u32 i = 0; i < n; i++ )
+	{
+		s32 r = sdioRead( "SD:c.prg", ( i * 4096 ) % 60000, 4096, data );
+		sdioWait( r );
+		sdioRelease( r );
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	sdioFsOpen( "SD:c.prg", 0, 0 );
+	for ( u32 i = 0; i < n; i++ )
+	{
+		u32 bytes;
+		sdioFsRead( ( i * 4096 ) % 60000, data, 4096, &bytes );
+	}
+	sdioFsClose();
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	cmdLatency = l; bytesPerUs = b;
+	printf( "4k reads on the host: %.2f us per request via sdio.cpp, %.2f us directly\n",
+		std::chrono::duration< double, std::micro >( t1 - t0 ).count() / n, std::chrono::duration< double, std::micro >( t2 - t1 ).count() / n );
+}
+
+int main( int argc, char **argv )
+{
+	root = argc > 1 ? argv[ 1 ] : "/tmp/sdiobench";
+	std::string mk = "mkdir -p '" + root + "'";
+	if ( system( mk.c_str() ) != 0 )
+		return 1;
+
+	createFile( "SD:a.crt", 1032 * 1024 );
+	createFile( "SD:b.d64", 174848 );
+	createFile( "SD:c.prg", 60000 );
+	createFile( "SD:d.sid", 4000 );
+
+	checkRequests();
+	checkStreams();
+	reopenRate = 7;
+	checkRequests();
+	checkStreams();
+	reopenRate = 0;
+	printf( "requests and streams checked against the model: %d mismatches\n", errors );
+
+	createFile( "SD:a.crt", 1032 * 1024 );
+
+	benchResponsiveness();
+	printf( "sequential reading of %d bytes (SD: %.0f us per command, %.0f MB/s):\n", (u32)model[ "SD:a.crt" ].size(), cmdLatency, bytesPerUs );
+	benchReadAhead( 8192, 0 );
+	benchReadAhead( 8192, 500 );
+	benchReadAhead( 8192, 2000 );
+	benchReadAhead( 16400, 1000 );
+	benchReadAhead( 16400, 4000 );
+	benchOverhead();
+
+	return errors ? 2 : 0;
+}
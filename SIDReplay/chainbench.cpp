@@ -0,0 +1,618 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ chainbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - checks and worst case paths of bus device chains (buschain.h)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BUSCHAIN_HOST
+#include "buschain.h"
+#include "sidrec.h"
+
+#ifndef min
+#define min( a, b ) ( ((a)<(b))?(a):(b) )
+#endif
+#ifndef max
+#define max( a, b ) ( ((a)>(b))?(a):(b) )
+#endif
+
+//
+// replay bus: the signals come from a trace instead of the GPIOs
+//
+typedef struct
+{
+	u32 g2, g3, data;
+} BUS_TRACE;
+
+class CBusReplay : public CBusCycle
+{
+public:
+	const BUS_TRACE *cur;
+	u32 out, probes, gpio;
+
+	inline void start()							{ g2 = cur->g2; }
+	inline void readRest()						{ g3 = cur->g3; }
+	inline void put( u32 D )					{ out = D; }
+	inline u32  get()							{ return cur->data; }
+	inline void finish()						{}
+	inline void setClr( u32 set, u32 clr )		{ gpio = ( gpio | set ) & ~clr; }
+	inline void preloadL1( const void *p )		{ __builtin_prefetch( p ); }
+	inline void preloadL2( const void *p )		{ __builtin_prefetch( p ); }
+	inline void probe()							{ probes ++; }
+};
+
+// for the time measurements: without counting, as CBusFIQ
+class CBusReplayTimed : public CBusReplay
+{
+public:
+	inline void probe()							{}
+};
+
+// the signals of an access of the CPU to 'addr' (with the address decoding of the cartridge port and the kernal adapter)
+static BUS_TRACE busAccess( u32 addr, u32 write, u32 data = 0, u32 reset = 0 )
+{
+	BUS_TRACE t;
+
+	t.g2 = ( ( addr & 255 ) << A0 ) | bCS | ( write ? 0 : bRW ) | ( reset ? 0 : bRESET );
+	t.g3 = ( ( ( addr >> 8 ) & 31 ) << A8 ) | bIO1 | bIO2 | bROML | bROMH | bCS | bBA;
+	t.data = data & 255;
+
+	if ( addr >= 0x8000 && addr < 0xa000 ) t.g3 &= ~bROML;
+	if ( addr >= 0xa000 && addr < 0xc000 ) t.g3 &= ~bROMH;
+	if ( addr >= 0xe000 )				   t.g3 &= ~( bROMH | bCS );
+	if ( addr >= 0xd400 && addr < 0xd800 ) t.g2 &= ~bCS;
+	if ( addr >= 0xde00 && addr < 0xdf00 ) t.g3 &= ~bIO1;
+	if ( addr >= 0xdf00 && addr < 0xe000 ) t.g3 &= ~bIO2;
+
+	return t;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static u32 errors = 0;
+
+#define CHECK( cond, ... ) if ( !( cond ) ) { if ( errors ++ < 10 ) { printf( "  error: " ); printf( __VA_ARGS__ ); printf( "\n" ); } }
+
+//
+// the devices and their state, as a kernel would set them up
+//
+static BUSCHAIN_COUNTERS counters;
+
+static u8 kernalROM[ 8192 ];
+
+static BUSDEV_GEORAM geo;
+static u8 geoModel[ 4096 * 1024 ];
+
+static BUSDEV_CRT crt;
+static u8 crtROM[ 64 * 16384 ];
+
+static BUSDEV_SIDCAPTURE sidCapture;
+#define SID_RING_SIZE ( 1024 * 128 )
+static u32 sidRingBuf[ SID_RING_SIZE ];
+static u64 sidRingTime[ SID_RING_SIZE ];
+
+static BUSDEV_LAUNCH launch;
+static u8 prgData[ 65536 ], launchCode[ 65536 ];
+static u32 prgSize;
+
+typedef CDevKernal< kernalROM >			DevKernal;
+typedef CDevGeoRAM< &geo >				DevGeoRAM;
+typedef CDevCRT< &crt >					DevCRT;
+typedef CDevSIDCapture< &sidCapture >	DevSID;
+typedef CDevLaunch< &launch >			DevLaunch;
+
+static void setupDevices()
+{
+	srand( 1 );
+
+	for ( u32 i = 0; i < sizeof( kernalROM ); i++ )
+		kernalROM[ i ] = rand();
+
+	geo.reg[ 0 ] = geo.reg[ 1 ] = 0;
+	geo.RAM = (u8 *)calloc( 4096 * 1024, 1 );
+	geo.sizeKB = 4096;
+	memset( geoModel, 0, sizeof( geoModel ) );
+
+	for ( u32 i = 0; i < sizeof( crtROM ); i++ )
+		crtROM[ i ] = rand();
+	crt.rom = crtROM;
+	crt.bank = 0;
+	crt.bankMask = 63;
+
+	sidCapture.ringBuf = sidRingBuf;
+	sidCapture.ringTime = sidRingTime;
+	sidCapture.ringWrite = 0;
+	sidCapture.ringMask = SID_RING_SIZE - 1;
+
+	// a .PRG loaded to $0801, with the computations of launchGetProgram (launch.h)
+	prgSize = 40000 + 2;
+	prgData[ 0 ] = 0x01; prgData[ 1 ] = 0x08;
+	for ( u32 i = 2; i < sizeof( prgData ); i++ )
+		prgData[ i ] = rand();
+	for ( u32 i = 0; i < sizeof( launchCode ); i++ )
+		launchCode[ i ] = rand();
+
+	memset( &launch, 0, sizeof( launch ) );
+	launch.prgData = prgData;
+	launch.launchCode = launchCode;
+	u32 startAddr = prgData[ 0 ] + prgData[ 1 ] * 256;
+	launch.prgSizeBelowA000 = 0xa000 - startAddr;
+	if ( launch.prgSizeBelowA000 > prgSize - 2 )
+	{
+		launch.prgSizeBelowA000 = prgSize - 2;
+		launch.prgSizeAboveA000 = 0;
+	} else
+		launch.prgSizeAboveA000 = prgSize - launch.prgSizeBelowA000;
+	launch.prgPages = ( prgSize - 2 + 255 ) >> 8;
+	launch.prgLastPage = launch.prgPages - 1;
+	launch.transferPart = 1;
+	launch.configSet = bGAME | bNMI | bDMA;
+	launch.configClr = bEXROM | bCTRL257;
+
+	counters.c64CycleCount = counters.resetCounter = 0;
+}
+
+//
+// runs one cycle through a chain, returns the byte put on the bus or -1
+//
+template <class... DEVS>
+static s32 cycle( CBusReplay &b, const BUS_TRACE &t, u32 *probes = NULL )
+{
+	b.cur = &t;
+	b.probes = 0;
+	b.out = 0;
+	u32 served = busChainCycle< CBusReplay, &counters, DEVS... >( b );
+	if ( probes ) *probes = b.probes;
+	return ( served && ( t.g2 & bRW ) ) ? (s32)b.out : ( served ? 256 : -1 );
+}
+
+template <class... DEVS>
+static s32 access( CBusReplay &b, u32 addr, u32 write, u32 data = 0, u32 reset = 0 )
+{
+	BUS_TRACE t = busAccess( addr, write, data, reset );
+	return cycle<DEVS...>( b, t );
+}
+
+//
+// functional checks of the chains against the behavior of the hand-written kernels
+//
+template <class... DEVS>
+static void checkKernal( CBusReplay &b )
+{
+	for ( u32 a = 0xe000; a <= 0xffff; a++ )
+	{
+		s32 v = access<DEVS...>( b, a, 0 );
+		CHECK( v == kernalROM[ a & 8191 ], "kernal read $%04x: %d instead of %d", a, v, kernalROM[ a & 8191 ] );
+	}
+}
+
+// random accesses to the GeoRAM window and registers, compared to a model
+template <class... DEVS>
+static void checkGeoRAM( CBusReplay &b, u32 n, u32 firstIO1 )
+{
+	u32 page = 0, block = 0;
+	for ( u32 i = 0; i < n; i++ )
+	{
+		u32 r = rand() % 16;
+		u32 ofs = firstIO1 + rand() % ( 256 - firstIO1 );
+		if ( r == 0 )
+		{
+			page = rand() & 63;
+			access<DEVS...>( b, 0xdf00, 1, page );
+		} else
+		if ( r == 1 )
+		{
+			block = rand() & 255;
+			access<DEVS...>( b, 0xdf01, 1, block );
+		} else
+		if ( r < 8 )
+		{
+			u32 D = rand() & 255;
+			access<DEVS...>( b, 0xde00 + ofs, 1, D );
+			geoModel[ block * 16384 + page * 256 + ofs ] = D;
+		} else
+		{
+			s32 v = access<DEVS...>( b, 0xde00 + ofs, 0 );
+			u32 e = geoModel[ block * 16384 + page * 256 + ofs ];
+			CHECK( v == (s32)e, "GeoRAM read block %d page %d offset %d: %d instead of %d", block, page, ofs, v, e );
+		}
+	}
+	s32 v = access<DEVS...>( b, 0xdf01, 0 );
+	CHECK( v == (s32)block, "GeoRAM block register: %d instead of %d", v, block );
+}
+
+// the .PRG transfer as done by the launch code (byte by byte and in blocks), then disabling the cartridge
+template <class... DEVS>
+static void checkLaunch( CBusReplay &b )
+{
+	// part below $a000, then above
+	for ( u32 part = 0; part < 2; part++ )
+	{
+		access<DEVS...>( b, part ? 0xde02 : 0xde00, 1, 0 );
+		u32 size = part ? launch.prgSizeAboveA000 : launch.prgSizeBelowA000;
+		u32 ofs = part ? launch.prgSizeBelowA000 + 2 : 0;
+		s32 pages = access<DEVS...>( b, 0xde01, 0 );
+		CHECK( pages == (s32)( ( size + 255 ) >> 8 ), "launch: %d pages instead of %d", pages, ( size + 255 ) >> 8 );
+		for ( u32 i = 0; i < size; i++ )
+		{
+			// cycles not belonging to the cartridge in between
+			access<DEVS...>( b, 0x0801 + ( i & 0x3fff ), 1, i );
+			s32 v = access<DEVS...>( b, 0xde00, 0 );
+			CHECK( v == prgData[ ofs + i ], "launch: byte %d of part %d is %d instead of %d", i, part, v, prgData[ ofs + i ] );
+		}
+	}
+
+	// block transfer
+	s32 pages = access<DEVS...>( b, 0xde03, 0 );
+	CHECK( pages == (s32)launch.prgPages, "launch: %d pages for the block transfer instead of %d", pages, launch.prgPages );
+	for ( u32 first = 0; first < launch.prgPages; first += 32 )
+	{
+		access<DEVS...>( b, 0xde03, 1, first );
+		for ( u32 a = 0; a < 8192; a += 7 )
+		{
+			u32 p = first + ( a >> 8 );
+			if ( p > launch.prgLastPage ) p = launch.prgLastPage;
+			s32 v = access<DEVS...>( b, 0x8000 + a, 0 );
+			CHECK( v == prgData[ 2 + p * 256 + ( a & 255 ) ], "launch: block %d, offset %d", first, a );
+		}
+	}
+	access<DEVS...>( b, 0xde04, 1, 0 );
+	s32 v = access<DEVS...>( b, 0x8010, 0 );
+	CHECK( v == launchCode[ 0x10 ], "launch: launch code not visible after $de04" );
+
+	// disable, everything goes to the next devices now
+	b.gpio = 0;
+	access<DEVS...>( b, 0xdf00, 1, 123 );
+	CHECK( launch.disableCart && ( b.gpio & bGAME ) && ( b.gpio & bEXROM ), "launch: writing 123 to $df00 did not disable the cartridge" );
+	v = access<DEVS...>( b, 0x8010, 0 );
+	CHECK( v == -1, "launch: ROML still served after disabling" );
+}
+
+template <class... DEVS>
+static void checkReset( CBusReplay &b )
+{
+	for ( u32 i = 0; i < 5; i++ )
+		access<DEVS...>( b, 0xfffc, 0, 0, 1 );
+	CHECK( !launch.disableCart && !( b.gpio & bEXROM ), "launch: not enabled again after a reset" );
+}
+
+// bank switching, the SID writes are interleaved
+template <class... DEVS>
+static void checkCRTAndSID( CBusReplay &b, u32 n )
+{
+	u32 ring = sidCapture.ringWrite;
+	for ( u32 i = 0; i < n; i++ )
+	{
+		u32 bank = rand() & 63;
+		access<DEVS...>( b, 0xde00, 1, bank );
+		for ( u32 j = 0; j < 16; j++ )
+		{
+			u32 a = 0x8000 + ( rand() & 0x3fff );
+			s32 v = access<DEVS...>( b, a, 0 );
+			u32 e = crtROM[ bank * 16384 + ( a - 0x8000 ) ];
+			CHECK( v == (s32)e, "CRT bank %d $%04x: %d instead of %d", bank, a, v, e );
+		}
+
+		u32 reg = rand() % 25, D = rand() & 255;
+		access<DEVS...>( b, 0xd400 + reg, 1, D );
+		u32 g = sidRingBuf[ ring ];
+		CHECK( ( ( g >> A0 ) & 255 ) == reg && ( ( g >> D0 ) & 255 ) == D && sidRingTime[ ring ] == counters.c64CycleCount,
+			"SID write %d: register/data/cycle do not match", i );
+		ring = ( ring + 1 ) & ( SID_RING_SIZE - 1 );
+	}
+}
+
+// the SID register writes of a recording of the SID kernel (see sidreplay), in real time (cycles without access in between)
+template <class... DEVS>
+static void checkRecording( CBusReplay &b, const char *filename )
+{
+	FILE *f = fopen( filename, "rb" );
+	if ( f == NULL )
+	{
+		printf( "cannot open %s\n", filename );
+		errors ++;
+		return;
+	}
+	fseek( f, 0, SEEK_END );
+	u32 size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	u8 *rec = (u8 *)malloc( size );
+	if ( fread( rec, 1, size, f ) != size || size < sizeof( SIDREC_HEADER ) || ((SIDREC_HEADER *)rec)->magic != SIDREC_MAGIC )
+	{
+		printf( "%s is not a recording\n", filename );
+		errors ++;
+		fclose( f );
+		return;
+	}
+	fclose( f );
+
+	BUS_TRACE idle = busAccess( 0x1000, 0 );
+	u32 pos = sizeof( SIDREC_HEADER ), ring = sidCapture.ringWrite, nWrites = 0;
+	u64 nCycles = 0;
+
+	double t0 = now();
+	while ( pos < size )
+	{
+		u32 delta, type, reg, data;
+		u32 n = sidrecGetEvent( &rec[ pos ], size - pos, &delta, &type, &reg, &data );
+		if ( n == 0 )
+			break;
+		pos += n;
+
+		for ( u32 i = 1; i < delta; i++ )
+			cycle<DEVS...>( b, idle );
+		nCycles += delta;
+
+		if ( type != SIDREC_SID1 && type != SIDREC_SID2 )
+			continue;
+
+		access<DEVS...>( b, 0xd400 + reg + ( type == SIDREC_SID2 ? 0x20 : 0 ), 1, data );
+		u32 g = sidRingBuf[ ring ];
+		CHECK( ( ( g >> A0 ) & 31 ) == reg && ( ( g >> D0 ) & 255 ) == data, "recording: SID write %d does not match", nWrites );
+		ring = ( ring + 1 ) & ( SID_RING_SIZE - 1 );
+		nWrites ++;
+	}
+	double t = now() - t0;
+
+	printf( "recording %s: %d SID writes in %llu cycles, %.1f ns per cycle\n\n", filename, nWrites, (unsigned long long)nCycles, t * 1e9 / max( (u64)1, nCycles ) );
+	free( rec );
+}
+
+//
+// worst case path: every kind of access (and cycles which no device handles) is replayed separately,
+// the number of devices asked and the time per cycle are reported
+//
+#define TRACE_LENGTH 4096
+
+typedef BUS_TRACE (*ACCESS_GEN)( u32 i );
+
+static BUS_TRACE genIdle( u32 i )		{ return busAccess( ( i * 37 ) & 0x7fff, i & 1, i ); }
+static BUS_TRACE genKernal( u32 i )		{ return busAccess( 0xe000 + ( ( i * 13 ) & 0x1fff ), 0 ); }
+static BUS_TRACE genGeoRAM( u32 i )		{ return ( i & 63 ) == 0 ? busAccess( 0xdf00 + ( i & 64 ? 1 : 0 ), 1, i >> 7 ) : busAccess( 0xde01 + ( i % 255 ), i & 1, i ); }
+static BUS_TRACE genLaunch( u32 i )		{ return ( i & 255 ) == 0 ? busAccess( 0xde00, 1 ) : ( i & 1 ? busAccess( 0xde00, 0 ) : busAccess( 0x8000 + ( i & 511 ), 0 ) ); }
+static BUS_TRACE genCRT( u32 i )		{ return ( i & 63 ) == 0 ? busAccess( 0xde00, 1, i >> 6 ) : busAccess( 0x8000 + ( ( i * 29 ) & 0x3fff ), 0 ); }
+static BUS_TRACE genSID( u32 i )		{ return busAccess( 0xd400 + ( i % 25 ), 1, i ); }
+
+typedef struct
+{
+	const char	*name;
+	ACCESS_GEN	gen;
+	u32			position;		// of the device in the chain (1 = first), 0 = no device
+} ACCESS_KIND;
+
+static double bestTime( void (*f)( CBusReplay &, const BUS_TRACE *, u32 ), CBusReplay &b, const BUS_TRACE *trace, u32 repeat )
+{
+	double best = 1e30;
+	for ( u32 r = 0; r < 5; r++ )
+	{
+		double t0 = now();
+		for ( u32 i = 0; i < repeat; i++ )
+			f( b, trace, TRACE_LENGTH );
+		best = min( best, now() - t0 );
+	}
+	return best * 1e9 / ( (double)repeat * TRACE_LENGTH );
+}
+
+static volatile u32 sink;
+
+template <class... DEVS>
+static void replayTrace( CBusReplay &b, const BUS_TRACE *trace, u32 n )
+{
+	CBusReplayTimed bt;
+	bt.gpio = b.gpio;
+	bt.out = 0;
+	u32 s = 0;
+	for ( u32 i = 0; i < n; i++ )
+	{
+		bt.cur = &trace[ i ];
+		busChainCycle< CBusReplayTimed, &counters, DEVS... >( bt );
+		s += bt.out;
+	}
+	sink = s;
+}
+
+// the hand-written handlers of kernel_kernal.cpp and kernel_georam.cpp on the same replay bus, for comparison
+static void replayHandKernal( CBusReplay &bus, const BUS_TRACE *trace, u32 n )
+{
+	CBusReplay b = bus;
+	u32 s = 0;
+	for ( u32 i = 0; i < n; i++ )
+	{
+		b.cur = &trace[ i ];
+		b.start();
+		counters.c64CycleCount ++;
+		if ( b.reset() ) counters.resetCounter ++; else counters.resetCounter = 0;
+		b.readRest();
+		if ( b.romh() && b.kernal() )
+			b.put( kernalROM[ b.addr() ] );
+		b.finish();
+		s += b.out;
+	}
+	sink = s;
+}
+
+static void replayHandGeoRAM( CBusReplay &bus, const BUS_TRACE *trace, u32 n )
+{
+	CBusReplay b = bus;
+	u32 s = 0;
+	for ( u32 i = 0; i < n; i++ )
+	{
+		b.cur = &trace[ i ];
+		b.start();
+		u8 *w = &geo.RAM[ geo.reg[ 1 ] * 16384 + geo.reg[ 0 ] * 256 ];
+		b.preloadL1( &w[ 0 ] ); b.preloadL1( &w[ 64 ] ); b.preloadL1( &w[ 128 ] ); b.preloadL1( &w[ 192 ] );
+		counters.c64CycleCount ++;
+		if ( b.reset() ) counters.resetCounter ++; else counters.resetCounter = 0;
+		b.readRest();
+		if ( b.io1() || b.io2() )
+		{
+			u32 A = b.addrIO();
+			if ( b.cpuReads() )
+				b.put( b.io1() ? w[ A ] : ( A < 2 ? geo.reg[ A & 1 ] : 0 ) ); else
+			{
+				u32 D = b.get();
+				if ( b.io1() )
+					w[ A ] = D; else
+				if ( A & 1 )
+					geo.reg[ 1 ] = D & ( ( geo.sizeKB / 16 ) - 1 ); else
+					geo.reg[ 0 ] = D & 63;
+			}
+		}
+		b.finish();
+		s += b.out;
+	}
+	sink = s;
+}
+
+template <class... DEVS>
+static void worstCase( CBusReplay &b, const char *name, const ACCESS_KIND *kinds, u32 nKinds, u32 repeat,
+					   void (*hand)( CBusReplay &, const BUS_TRACE *, u32 ) = NULL, const char *handName = NULL )
+{
+	static BUS_TRACE trace[ TRACE_LENGTH ];
+	const u32 nDevices = CBusChain<DEVS...>::nDevices;
+
+	printf( "chain %s (%d devices)\n", name, nDevices );
+	printf( "  %-12s %8s %8s %10s\n", "access", "devices", "served", "ns/cycle" );
+
+	double worst = 0;
+	const char *worstName = "";
+	for ( u32 k = 0; k < nKinds; k++ )
+	{
+		for ( u32 i = 0; i < TRACE_LENGTH; i++ )
+			trace[ i ] = kinds[ k ].gen( i );
+
+		// the path: number of devices asked per cycle, and whether the right device handled it
+		u32 maxProbes = 0, nServed = 0;
+		for ( u32 i = 0; i < TRACE_LENGTH; i++ )
+		{
+			u32 probes;
+			s32 v = cycle<DEVS...>( b, trace[ i ], &probes );
+			maxProbes = max( maxProbes, probes );
+			if ( v >= 0 ) nServed ++;
+		}
+
+		u32 expect = kinds[ k ].position ? kinds[ k ].position : nDevices;
+		CHECK( maxProbes == expect, "%s: %s asks %d devices instead of %d", name, kinds[ k ].name, maxProbes, expect );
+		CHECK( ( nServed == ( kinds[ k ].position ? TRACE_LENGTH : 0 ) ), "%s: %s, %d of %d cycles served", name, kinds[ k ].name, nServed, TRACE_LENGTH );
+
+		double ns = bestTime( replayTrace<DEVS...>, b, trace, repeat );
+		printf( "  %-12s %8d %7d%% %10.2f\n", kinds[ k ].name, maxProbes, nServed * 100 / TRACE_LENGTH, ns );
+
+		if ( ns > worst )
+		{
+			worst = ns;
+			worstName = kinds[ k ].name;
+		}
+
+		if ( hand && kinds[ k ].position )
+			printf( "  %-12s %8s %8s %10.2f\n", handName, "", "", bestTime( hand, b, trace, repeat ) );
+	}
+	printf( "  worst case: %s, %.2f ns/cycle\n\n", worstName, worst );
+}
+
+int main( int argc, char **argv )
+{
+	u32 repeat = 200;
+	const char *recording = NULL;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( argv[ i ][ 0 ] == '-' && argv[ i ][ 1 ] == 'r' && i + 1 < argc )
+		{
+			repeat = atoi( argv[ ++i ] );
+			repeat = max( 1, repeat );
+			continue;
+		}
+		if ( argv[ i ][ 0 ] != '-' && recording == NULL )
+		{
+			recording = argv[ i ];
+			continue;
+		}
+		printf( "usage: chainbench [-r repeat] [rec000.skr]\n" );
+		return 1;
+	}
+
+	CBusReplay b;
+	b.gpio = 0;
+	setupDevices();
+
+	//
+	// functional checks
+	//
+	checkKernal< DevKernal >( b );
+	checkGeoRAM< DevGeoRAM >( b, 200000, 0 );
+
+	// kernel_rkl.cpp: launcher, kernal and GeoRAM
+	checkLaunch< DevLaunch, DevKernal, DevGeoRAM >( b );
+	checkKernal< DevLaunch, DevKernal, DevGeoRAM >( b );
+	checkGeoRAM< DevLaunch, DevKernal, DevGeoRAM >( b, 200000, 0 );
+	checkReset< DevLaunch, DevKernal, DevGeoRAM >( b );
+
+	// a combination without a hand-written kernel: cartridge ROM, SID and GeoRAM (the cartridge has priority at $de00)
+	checkCRTAndSID< DevCRT, DevSID, DevGeoRAM >( b, 20000 );
+	checkGeoRAM< DevCRT, DevSID, DevGeoRAM >( b, 200000, 1 );
+
+	if ( recording )
+		checkRecording< DevCRT, DevSID, DevGeoRAM >( b, recording );
+
+	printf( "functional checks: %s\n\n", errors ? "FAILED" : "ok" );
+
+	//
+	// worst case paths
+	//
+	const ACCESS_KIND kindsKernal[] = { { "RAM", genIdle, 0 }, { "kernal", genKernal, 1 } };
+	worstCase< DevKernal >( b, "kernal", kindsKernal, 2, repeat, replayHandKernal, "hand-written" );
+
+	const ACCESS_KIND kindsGeoRAM[] = { { "RAM", genIdle, 0 }, { "GeoRAM", genGeoRAM, 1 } };
+	worstCase< DevGeoRAM >( b, "GeoRAM", kindsGeoRAM, 2, repeat, replayHandGeoRAM, "hand-written" );
+
+	launch.disableCart = 0;
+	const ACCESS_KIND kindsRKL[] = { { "RAM", genIdle, 0 }, { "launch", genLaunch, 1 }, { "kernal", genKernal, 2 } };
+	worstCase< DevLaunch, DevKernal, DevGeoRAM >( b, "launch+kernal+GeoRAM", kindsRKL, 3, repeat );
+	launch.disableCart = 1;
+	const ACCESS_KIND kindsRKLDisabled[] = { { "GeoRAM", genGeoRAM, 3 } };
+	worstCase< DevLaunch, DevKernal, DevGeoRAM >( b, "launch+kernal+GeoRAM (launcher disabled)", kindsRKLDisabled, 1, repeat );
+
+	const ACCESS_KIND kindsCSG[] = { { "RAM", genIdle, 0 }, { "CRT", genCRT, 1 }, { "SID", genSID, 2 }, { "GeoRAM", genGeoRAM, 3 } };
+	worstCase< DevCRT, DevSID, DevGeoRAM >( b, "CRT+SID+GeoRAM", kindsCSG, 4, repeat );
+
+	if ( errors )
+	{
+		printf( "%d errors\n", errors );
+		return 2;
+	}
+
+	return 0;
+}
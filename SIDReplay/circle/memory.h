@@ -0,0 +1,7 @@
+//
+// reSID includes Circle's memory.h, nothing is needed from it on the host
+//
+#ifndef _circle_memory_h
+#define _circle_memory_h
+
+#endif
@@ -0,0 +1,24 @@
+//
+// minimal replacement of Circle's types.h for building reSID, FMOPL and sidrec.h on the host
+//
+#ifndef _circle_types_h
+#define _circle_types_h
+
+#include <stdint.h>
+
+typedef uint8_t		u8;
+typedef uint16_t	u16;
+typedef uint32_t	u32;
+typedef uint64_t	u64;
+typedef int8_t		s8;
+typedef int16_t		s16;
+typedef int32_t		s32;
+typedef int64_t		s64;
+
+typedef uintptr_t	uintptr;
+
+typedef int		boolean;
+#define FALSE		0
+#define TRUE		1
+
+#endif
@@ -0,0 +1,485 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ readbackbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - validation of the OSC3/ENV3 run-ahead model against reSID (runs on the host)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#include "sidrec.h"
+#include "audioengine.h"
+#include "sidreadback.h"
+
+using namespace reSID;
+
+//
+// Validates the run-ahead model of ../sidreadback.h: a C64 program (synthetic, or the SID1/SID2 writes of a recording
+// with reads inserted) is replayed against
+//   - a reference reSID clocked cycle by cycle, i.e. the exact OSC3/ENV3 value of every read
+//   - the emulation loop of kernel_sid.cpp (audioEmulateToNextSample, steps of at most 256 cycles) and its
+//     outRegisters[ 27/28 ], updated whenever the main loop gets to run
+//   - the run-ahead model, fed and advanced whenever the main loop gets to run, read by the "FIQ handler" with the
+//     fallback to outRegisters if there is no valid prediction
+// The main loop runs every 'gapMin'..'gapMax' cycles and is sometimes stalled for longer (e.g. while passing samples
+// to the HDMI sound device).
+//
+
+#define CLOCKFREQ		985248
+#define SAMPLERATE		44100
+
+typedef struct
+{
+	u64 cycle;
+	u32 read;		// 0: write, 1: read
+	u32 reg, value;	// writes to SID2 have bit 5 set in reg, SID1 ignores them
+} EVENT;
+
+static std::vector<EVENT> events;
+static u32 rnd = 0x2468ace1;
+static u32 rnd32( u32 n )
+{
+	rnd = rnd * 1664525 + 1013904223;
+	return ( rnd >> 8 ) % n;
+}
+
+static void addWrite( u64 cycle, u32 reg, u32 value )
+{
+	EVENT e = { cycle, 0, reg, value };
+	events.push_back( e );
+}
+
+static void addRead( u64 cycle, u32 reg )
+{
+	EVENT e = { cycle, 1, reg, 0 };
+	events.push_back( e );
+}
+
+static bool eventOrder( const EVENT &a, const EVENT &b )
+{
+	return a.cycle < b.cycle;
+}
+
+// one bus access per cycle: reads which collide with another access are moved
+static void sortEvents()
+{
+	std::stable_sort( events.begin(), events.end(), eventOrder );
+	for ( size_t i = 1; i < events.size(); i++ )
+		if ( events[ i ].cycle <= events[ i - 1 ].cycle )
+			events[ i ].cycle = events[ i - 1 ].cycle + 1;
+	std::stable_sort( events.begin(), events.end(), eventOrder );
+}
+
+//
+// synthetic programs
+//
+enum { PROG_RNG = 0, PROG_ENV, PROG_SYNC, PROG_PLAYER, PROG_DIGI, NUM_PROGS };
+static const char *progName[ NUM_PROGS ] = { "rng", "env", "sync", "player", "digi" };
+
+static void makeProgram( u32 prog, u64 nCycles )
+{
+	events.clear();
+
+	switch ( prog )
+	{
+	case PROG_RNG:
+		// the usual random number generator: voice 3 noise at the highest frequency, OSC3 read in a loop
+		addWrite( 100, 0x0e, 0xff );
+		addWrite( 108, 0x0f, 0xff );
+		addWrite( 116, 0x12, 0x80 );
+		for ( u64 c = 200; c < nCycles; c += 8 + rnd32( 60 ) )
+			addRead( c, 0x1b );
+		break;
+
+	case PROG_ENV:
+		// notes with different ADSR on voice 3, ENV3 read to drive an effect (and OSC3 of the triangle)
+		for ( u64 c = 100; c < nCycles; c += 5000 + rnd32( 20000 ) )
+		{
+			addWrite( c, 0x13, rnd32( 256 ) );
+			addWrite( c + 8, 0x14, rnd32( 256 ) );
+			addWrite( c + 16, 0x0f, 4 + rnd32( 40 ) );
+			addWrite( c + 24, 0x12, 0x11 );
+			addWrite( c + 2000 + rnd32( 6000 ), 0x12, 0x10 );
+		}
+		for ( u64 c = 200; c < nCycles; c += 20 + rnd32( 200 ) )
+			addRead( c, rnd32( 4 ) ? 0x1c : 0x1b );
+		break;
+
+	case PROG_SYNC:
+		// voice 3 synced and ring modulated by voice 2, which is synced by voice 1, frequencies change now and then; at
+		// times voice 3 (or voice 2) runs on its own, voices 1 and 2 then lag behind in the model
+		addWrite( 100, 0x01, 0x10 );
+		addWrite( 108, 0x08, 0x23 );
+		addWrite( 116, 0x0b, 0x22 );
+		addWrite( 124, 0x0f, 0x31 );
+		addWrite( 132, 0x12, 0x16 );
+		for ( u64 c = 1000; c < nCycles; c += 3000 + rnd32( 10000 ) )
+		{
+			addWrite( c, 0x01, rnd32( 64 ) );
+			addWrite( c + 8, 0x08, rnd32( 64 ) );
+			addWrite( c + 16, 0x0f, rnd32( 256 ) );
+			addWrite( c + 24, 0x12, rnd32( 3 ) == 0 ? 0x20 : rnd32( 2 ) ? 0x16 : 0x22 );
+			addWrite( c + 32, 0x0b, rnd32( 3 ) == 0 ? 0x20 : 0x22 );
+		}
+		for ( u64 c = 200; c < nCycles; c += 10 + rnd32( 100 ) )
+			addRead( c, 0x1b );
+		break;
+
+	case PROG_PLAYER:
+		// a player writing all voices once per frame, reading OSC3/ENV3 a few times per frame every other half second
+		for ( u64 frame = 0; frame * 19656 < nCycles; frame++ )
+		{
+			u64 c = frame * 19656 + 3150;
+			for ( u32 v = 0; v < 3; v++ )
+			{
+				u32 f = 0x800 + v * 0x500 + rnd32( 0x100 );
+				addWrite( c += 8, v * 7 + 0, f & 255 );
+				addWrite( c += 8, v * 7 + 1, f >> 8 );
+				addWrite( c += 8, v * 7 + 2, 0x00 );
+				addWrite( c += 8, v * 7 + 3, 0x08 );
+				addWrite( c += 8, v * 7 + 5, 0x28 );
+				addWrite( c += 8, v * 7 + 6, 0x89 );
+				addWrite( c += 8, v * 7 + 4, ( v == 2 ? 0x80 : 0x40 ) | ( ( frame % 12 ) < 8 ? 1 : 0 ) );
+			}
+			addWrite( c += 8, 0x16, 0x40 + ( frame & 63 ) );
+			addWrite( c += 8, 0x17, 0x31 );
+			addWrite( c += 8, 0x18, 0x1f );
+			for ( u32 i = 0; ( frame / 25 ) % 2 == 0 && i < 4; i++ )
+				addRead( frame * 19656 + rnd32( 19656 ), rnd32( 2 ) ? 0x1b : 0x1c );
+		}
+		break;
+
+	case PROG_DIGI:
+		// OSC3 random numbers while a sample is played through the volume register and SID2 plays notes
+		addWrite( 100, 0x0e, 0xff );
+		addWrite( 108, 0x0f, 0xff );
+		addWrite( 116, 0x12, 0x80 );
+		for ( u64 c = 200; c < nCycles; c += 120 + rnd32( 8 ) )
+			addWrite( c, 0x18, rnd32( 16 ) );
+		for ( u64 frame = 0; frame * 19656 < nCycles; frame++ )
+			for ( u32 r = 0; r < 7; r++ )
+				addWrite( frame * 19656 + 3150 + r * 8, 0x20 | r, rnd32( 256 ) );
+		for ( u64 c = 200; c < nCycles; c += 8 + rnd32( 60 ) )
+			addRead( c, 0x1b );
+		break;
+	}
+
+	sortEvents();
+}
+
+// the SID1 writes of a recording, with reads every 'readInterval' cycles on average
+static int loadRecording( const char *filename, u32 readInterval, SIDREC_HEADER *hdr )
+{
+	FILE *f = fopen( filename, "rb" );
+	if ( f == NULL )
+		return 0;
+	fseek( f, 0, SEEK_END );
+	u32 size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	std::vector<u8> data( size + 1 );
+	size = fread( &data[ 0 ], 1, size, f );
+	fclose( f );
+
+	if ( size < sizeof( SIDREC_HEADER ) )
+		return 0;
+	memcpy( hdr, &data[ 0 ], sizeof( SIDREC_HEADER ) );
+	if ( hdr->magic != SIDREC_MAGIC || hdr->version != SIDREC_VERSION )
+		return 0;
+
+	events.clear();
+	u64 cycle = 0;
+	u32 pos = sizeof( SIDREC_HEADER ), delta, type, reg, value, n;
+	while ( ( n = sidrecGetEvent( &data[ pos ], size - pos, &delta, &type, &reg, &value ) ) != 0 )
+	{
+		pos += n;
+		cycle += delta;
+		if ( type == SIDREC_SID1 || ( type == SIDREC_SIDN && ( value >> 8 ) == 0 ) )
+			addWrite( cycle, reg, value & 255 ); else
+		if ( type == SIDREC_SID2 || type == SIDREC_SIDN )
+			addWrite( cycle, 0x20 | reg, value & 255 );
+	}
+
+	for ( u64 c = 100; c < cycle; c += 1 + rnd32( 2 * readInterval ) )
+		addRead( c, rnd32( 2 ) ? 0x1b : 0x1c );
+
+	sortEvents();
+	return 1;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//
+// the emulation loop of kernel_sid.cpp for SID1 (writes which have been captured up to a cycle)
+//
+class CKernelSources
+{
+public:
+	SID *sid;
+	size_t *ring, ringWrite;		// events[ ring[ i ] ] are the writes captured by the "FIQ handler"
+	size_t ringRead;
+	u32 outRegisters[ 32 ];
+
+	u32 nextEvent( u64 *t )
+	{
+		if ( ringRead == ringWrite )
+			return 0;
+		*t = events[ ring[ ringRead ] ].cycle;
+		return 1;
+	}
+
+	void applyEvent()
+	{
+		const EVENT &e = events[ ring[ ringRead ++ ] ];
+		if ( e.reg < 0x20 )
+			sid->write( e.reg, e.value );
+	}
+
+	void clock( u32 cycles )
+	{
+		sid->clock( cycles );
+		outRegisters[ 27 ] = sid->read( 27 );
+		outRegisters[ 28 ] = sid->read( 28 );
+	}
+};
+
+static SID *newSID( chip_model model )
+{
+	SID *s = new SID;
+	for ( int j = 0; j < 25; j++ )
+		s->write( j, 0 );
+	s->set_chip_model( model );
+	s->set_sampling_parameters( CLOCKFREQ, SAMPLE_FAST, SAMPLERATE );
+	return s;
+}
+
+typedef struct
+{
+	u32 nReads, oldWrong, predicted, predictedWrong, newWrong;
+	double timeModel, timeSID;
+	u64 nCycles;
+} RESULT;
+
+static void run( chip_model model, u32 gapMin, u32 gapMax, u32 stallEvery, u32 stallLength, RESULT *r )
+{
+	memset( r, 0, sizeof( RESULT ) );
+
+	SID *ref = newSID( model );
+	SID *emu = newSID( model );
+
+	CSIDReadBack *readBack = new CSIDReadBack;
+	readBack->init( model, model == MOS8580 );
+
+	std::vector<size_t> ring;
+	CKernelSources src;
+	src.sid = emu;
+	src.ring = NULL;
+	src.ringRead = src.ringWrite = 0;
+	memset( src.outRegisters, 0, sizeof( src.outRegisters ) );
+
+	AUDIO_SAMPLE_CLOCK sampleClock = { 0 };
+	audioClockInit( &sampleClock, CLOCKFREQ, SAMPLERATE );
+	unsigned long long nCyclesEmulated = 0;
+
+	u64 nCycles = events.empty() ? 0 : events.back().cycle + 1;
+	for ( size_t i = 0; i < events.size(); i++ )
+		if ( !events[ i ].read )
+			ring.push_back( i );
+	src.ring = ring.empty() ? NULL : &ring[ 0 ];
+
+	size_t e = 0, readBackRing = 0;
+	u32 nWrites = 0, nWritesPassed = 0;		// writes to registers $00-$14 of SID1 ("FIQ handler" and main loop)
+	u64 nextMainLoop = gapMin;
+
+	for ( u64 t = 0; t < nCycles; t++ )
+	{
+		// the reference is at cycle t (writes at cycle t take effect after t cycles, as in audioengine.h)
+		if ( t > 0 )
+			ref->clock();
+
+		// "FIQ handler"
+		if ( e < events.size() && events[ e ].cycle == t )
+		{
+			const EVENT &ev = events[ e ++ ];
+			if ( ev.read )
+			{
+				u32 exact = ref->read( ev.reg );
+				u32 old = src.outRegisters[ ev.reg ], D;
+				u32 pred = readBack->read( t, nWrites, ev.reg, &D );
+				if ( !pred )
+					D = old;
+				r->nReads ++;
+				r->oldWrong += old != exact;
+				r->predicted += pred;
+				r->predictedWrong += pred && D != exact;
+				r->newWrong += D != exact;
+			} else
+			{
+				if ( ev.reg < 0x20 )
+					ref->write( ev.reg, ev.value );
+				if ( ev.reg <= 0x14 )
+					nWrites ++;
+				src.ringWrite ++;
+			}
+		}
+
+		// main loop
+		if ( t == nextMainLoop )
+		{
+			double t0 = now();
+			while ( t > nCyclesEmulated )
+				audioEmulateToNextSample( src, &sampleClock, nCyclesEmulated, t, 256 );
+			double t1 = now();
+
+			while ( readBackRing != src.ringWrite )
+			{
+				const EVENT &w = events[ ring[ readBackRing ++ ] ];
+				if ( w.reg <= 0x14 )
+				{
+					readBack->write( w.cycle, w.reg, w.value );
+					nWritesPassed ++;
+				}
+			}
+			readBack->runAhead( t, nWritesPassed );
+			double t2 = now();
+
+			r->timeSID += t1 - t0;
+			r->timeModel += t2 - t1;
+
+			nextMainLoop = t + gapMin + rnd32( gapMax - gapMin + 1 );
+			if ( stallEvery && rnd32( stallEvery ) == 0 )
+				nextMainLoop += stallLength;
+		}
+	}
+
+	r->nCycles = nCycles;
+
+	delete readBack;
+	delete emu;
+	delete ref;
+}
+
+
+static void report( const char *name, RESULT *r )
+{
+	printf( "%-8s %7u reads, outRegisters wrong %5.1f%%, predicted %5.1f%% (%u wrong), with fallback wrong %5.1f%%, "
+		"model %.1f ns/cycle (SID emulation %.1f)\n", name, r->nReads,
+		r->nReads ? 100.0 * r->oldWrong / r->nReads : 0.0, r->nReads ? 100.0 * r->predicted / r->nReads : 0.0, r->predictedWrong,
+		r->nReads ? 100.0 * r->newWrong / r->nReads : 0.0, r->timeModel * 1e9 / r->nCycles, r->timeSID * 1e9 / r->nCycles );
+}
+
+static void usage()
+{
+	printf( "usage: readbackbench [options] [recording.skr]\n" );
+	printf( "  -g min max     cycles between two runs of the main loop (default 20 100)\n" );
+	printf( "  -t n length    stall the main loop for 'length' cycles once every n runs on average (default 200 2000)\n" );
+	printf( "  -i cycles      average distance of the reads inserted into a recording (default 500)\n" );
+	printf( "  -s seconds     length of the synthetic programs (default 5)\n" );
+	printf( "  -m model       6581 (default) or 8580\n" );
+}
+
+int main( int argc, char **argv )
+{
+	const char *fileRec = NULL;
+	u32 gapMin = 20, gapMax = 100, stallEvery = 200, stallLength = 2000, readInterval = 500, sidModel = 6581;
+	double seconds = 5.0;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[ i ], "-g" ) == 0 && i + 2 < argc )
+		{
+			gapMin = atoi( argv[ ++i ] );
+			gapMax = atoi( argv[ ++i ] );
+			continue;
+		}
+		if ( strcmp( argv[ i ], "-t" ) == 0 && i + 2 < argc )
+		{
+			stallEvery = atoi( argv[ ++i ] );
+			stallLength = atoi( argv[ ++i ] );
+			continue;
+		}
+		if ( argv[ i ][ 0 ] == '-' && i + 1 < argc )
+		{
+			switch ( argv[ i ][ 1 ] )
+			{
+			case 'i': readInterval = atoi( argv[ ++i ] ); continue;
+			case 's': seconds = atof( argv[ ++i ] ); continue;
+			case 'm': sidModel = atoi( argv[ ++i ] ); continue;
+			}
+		} else
+		if ( argv[ i ][ 0 ] != '-' && fileRec == NULL )
+		{
+			fileRec = argv[ i ];
+			continue;
+		}
+		usage();
+		return 1;
+	}
+
+	if ( gapMin < 1 || gapMax < gapMin || readInterval < 1 || ( sidModel != 6581 && sidModel != 8580 ) )
+	{
+		usage();
+		return 1;
+	}
+
+	printf( "main loop every %u-%u cycles, stalled for %u cycles once every %u runs\n", gapMin, gapMax, stallLength, stallEvery );
+
+	RESULT r;
+	u32 failed = 0;
+
+	if ( fileRec )
+	{
+		SIDREC_HEADER hdr;
+		if ( !loadRecording( fileRec, readInterval, &hdr ) )
+		{
+			fprintf( stderr, "cannot read %s\n", fileRec );
+			return 1;
+		}
+		run( hdr.sidModel[ 0 ] == 8580 ? MOS8580 : MOS6581, gapMin, gapMax, stallEvery, stallLength, &r );
+		report( "rec", &r );
+		failed += r.predictedWrong;
+	} else
+	{
+		chip_model model = sidModel == 8580 ? MOS8580 : MOS6581;
+		for ( u32 p = 0; p < NUM_PROGS; p++ )
+		{
+			makeProgram( p, (u64)( seconds * CLOCKFREQ ) );
+			run( model, gapMin, gapMax, stallEvery, stallLength, &r );
+			report( progName[ p ], &r );
+			failed += r.predictedWrong;
+		}
+	}
+
+	return failed ? 2 : 0;
+}
@@ -0,0 +1,322 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sidgen.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - synthetic multi-SID recordings for benchmarks (runs on the host)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sidrec.h"
+
+//
+// Writes synthetic recordings in the format of ../sidrec.h for benchmarks of the multi-SID emulation: a simple
+// player (called once per PAL frame like most C64 music routines) drives bass, lead and drum voices with gate
+// on/off, release phases, rests and sections in which voices or whole SIDs are silent. As real players do, the
+// registers of every active voice and the filter are written in every frame, even if unchanged.
+//
+//   2sid    SID1 and SID2 (SIDREC_SID1/SID2), SID2 drops out every other section
+//   3sid    three SIDs (SIDREC_SIDN), the 3rd one only plays in every other section
+//   8sid    three SIDs play as in 3sid, SIDs 4-8 only play a short jingle at the start and stay silent afterwards
+//   dense   all 8 SIDs with all voices sounding all the time (worst case, nothing is idle)
+//
+
+#define CLOCKFREQ		985248
+#define SAMPLERATE		44100
+#define FRAME_CYCLES	19656		// 312 rasterlines of 63 cycles
+#define FRAMES_PER_STEP	6
+#define STEPS_PER_SECTION	128
+
+enum { KIND_2SID = 0, KIND_3SID, KIND_8SID, KIND_DENSE, NUM_KINDS };
+static const char *kindName[ NUM_KINDS ] = { "2sid", "3sid", "8sid", "dense" };
+
+static u8 *buffer;
+static u32 bufferSize, bufferMax;
+static u32 nEvents;
+static u64 lastCycle;
+static u32 kind;
+
+static u32 rnd = 0x12345678;
+static u32 rnd32( u32 n )
+{
+	rnd = rnd * 1664525 + 1013904223;
+	return ( rnd >> 8 ) % n;
+}
+
+static void put( u64 cycle, u32 sid, u32 reg, u32 data )
+{
+	if ( bufferSize + SIDREC_MAX_EVENT > bufferMax )
+	{
+		bufferMax *= 2;
+		buffer = (u8 *)realloc( buffer, bufferMax );
+	}
+
+	if ( kind == KIND_2SID )
+		bufferSize += sidrecPutEvent( &buffer[ bufferSize ], (u32)( cycle - lastCycle ), sid ? SIDREC_SID2 : SIDREC_SID1, reg, data ); else
+		bufferSize += sidrecPutEvent( &buffer[ bufferSize ], (u32)( cycle - lastCycle ), SIDREC_SIDN, reg, data | ( sid << 8 ) );
+
+	lastCycle = cycle;
+	nEvents ++;
+}
+
+// SID frequency register value of a MIDI note number (PAL clock)
+static u32 noteFreq( u32 note )
+{
+	double hz = 440.0 * pow( 2.0, ( (int)note - 69 ) / 12.0 );
+	u32 f = (u32)( hz * 16777216.0 / CLOCKFREQ + 0.5 );
+	return f > 0xffff ? 0xffff : f;
+}
+
+typedef struct
+{
+	u32 note, gate, gateFrames, waveform, pw, vibrato;
+} VOICE;
+
+typedef struct
+{
+	VOICE v[ 3 ];
+	u32 cutoff, playing, written;
+	u32 bassNote, leadNote;
+} PLAYER;
+
+static const u32 scale[ 8 ] = { 0, 2, 3, 5, 7, 8, 10, 12 };
+
+// a new step of the tune: decides the notes, the gate on/off is done per frame
+static void playerStep( PLAYER *P, u32 sidIdx, u32 step )
+{
+	u32 dense = kind == KIND_DENSE;
+
+	// bass: eighth notes with rests
+	VOICE *b = &P->v[ 0 ];
+	if ( dense || rnd32( 10 ) < 7 )
+	{
+		b->note = 36 + sidIdx * 2 + scale[ ( step / 4 + sidIdx ) & 7 ] - ( ( step & 2 ) ? 12 : 0 ) + 12;
+		b->gate = 1; b->gateFrames = dense ? 1000 : 3;
+	}
+
+	// lead: longer notes, sometimes a long rest in which the release decays to zero
+	VOICE *l = &P->v[ 1 ];
+	if ( ( step & 1 ) == 0 )
+	{
+		if ( dense || rnd32( 10 ) < 6 )
+		{
+			l->note = 60 + scale[ rnd32( 8 ) ] + ( sidIdx & 1 ) * 12;
+			l->gate = 1; l->gateFrames = dense ? 1000 : 4 + rnd32( 8 );
+		}
+	}
+
+	// drums: noise on every 2nd step
+	VOICE *d = &P->v[ 2 ];
+	if ( dense || ( step & 1 ) == 0 )
+	{
+		d->note = ( step & 2 ) ? 80 : 50;
+		d->gate = 1; d->gateFrames = dense ? 1000 : 1;
+	}
+}
+
+// one call of the player: writes the registers of the SID as a C64 music routine would
+static u64 playerFrame( PLAYER *P, u32 sidIdx, u64 cycle, u32 frame )
+{
+	static const u8 waveform[ 3 ] = { 0x40, 0x20, 0x80 };
+	static const u8 AD[ 3 ] = { 0x09, 0x2a, 0x00 };
+	static const u8 SR[ 3 ] = { 0x88, 0xa9, 0x08 };
+
+	// LDA/STA pairs
+	const u32 W = 8;
+
+	if ( !P->written )
+	{
+		for ( u32 i = 0; i < 3; i++ )
+		{
+			put( cycle += W, sidIdx, i * 7 + 5, AD[ i ] );
+			put( cycle += W, sidIdx, i * 7 + 6, SR[ i ] );
+		}
+		P->written = 1;
+	}
+
+	for ( u32 i = 0; i < 3; i++ )
+	{
+		VOICE *v = &P->v[ i ];
+
+		u32 f = noteFreq( v->note );
+		if ( i == 1 && v->gate )
+			f += (u32)( f * 0.006 * sin( frame * 0.8 ) );			// vibrato
+		u32 pw = 0x800 + (u32)( 0x600 * sin( frame * 0.05 + sidIdx ) );	// PWM
+
+		u32 ctrl = waveform[ i ];
+		if ( v->gate )
+		{
+			if ( v->gateFrames == 0 )
+				v->gate = 0; else
+				v->gateFrames --;
+		}
+		ctrl |= v->gate;
+
+		put( cycle += W, sidIdx, i * 7 + 0, f & 255 );
+		put( cycle += W, sidIdx, i * 7 + 1, f >> 8 );
+		put( cycle += W, sidIdx, i * 7 + 2, pw & 255 );
+		put( cycle += W, sidIdx, i * 7 + 3, pw >> 8 );
+		put( cycle += W, sidIdx, i * 7 + 4, ctrl );
+	}
+
+	// filter sweep on the lead voice
+	P->cutoff = 0x200 + (u32)( 0x180 * sin( frame * 0.01 + sidIdx ) );
+	put( cycle += W, sidIdx, 0x15, P->cutoff & 7 );
+	put( cycle += W, sidIdx, 0x16, P->cutoff >> 3 );
+	put( cycle += W, sidIdx, 0x17, 0x62 );
+	put( cycle += W, sidIdx, 0x18, 0x1f );
+
+	return cycle;
+}
+
+// whether the SID plays in a section (silent SIDs receive no writes, but keep their last register values)
+static u32 sidPlays( u32 sidIdx, u32 section, u32 frame )
+{
+	switch ( kind )
+	{
+	case KIND_2SID:	return sidIdx == 0 || ( section & 1 ) == 0;
+	case KIND_3SID:	return sidIdx < 2 || ( section & 1 ) == 0;
+	case KIND_8SID:	return sidIdx < 2 || ( sidIdx == 2 && ( section & 1 ) == 0 ) || ( sidIdx > 2 && frame < 100 );
+	default:		return 1;
+	}
+}
+
+static void usage()
+{
+	printf( "usage: sidgen [options] kind recording.skr\n" );
+	printf( "  kind           2sid, 3sid, 8sid (silent SIDs and voices) or dense (nothing silent)\n" );
+	printf( "  -s seconds     length (default 60)\n" );
+	printf( "  -m model       6581 (default) or 8580\n" );
+}
+
+int main( int argc, char **argv )
+{
+	const char *fileOut = NULL;
+	double seconds = 60.0;
+	u32 model = 6581;
+	kind = NUM_KINDS;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( argv[ i ][ 0 ] == '-' && i + 1 < argc )
+		{
+			switch ( argv[ i ][ 1 ] )
+			{
+			case 's': seconds = atof( argv[ ++i ] ); continue;
+			case 'm': model = atoi( argv[ ++i ] ); continue;
+			}
+		} else
+		if ( kind == NUM_KINDS )
+		{
+			for ( kind = 0; kind < NUM_KINDS; kind++ )
+				if ( strcmp( argv[ i ], kindName[ kind ] ) == 0 )
+					break;
+			if ( kind < NUM_KINDS )
+				continue;
+		} else
+		if ( fileOut == NULL )
+		{
+			fileOut = argv[ i ];
+			continue;
+		}
+		usage();
+		return 1;
+	}
+
+	if ( kind == NUM_KINDS || fileOut == NULL || ( model != 6581 && model != 8580 ) )
+	{
+		usage();
+		return 1;
+	}
+
+	bufferMax = 1 << 20;
+	buffer = (u8 *)malloc( bufferMax );
+	bufferSize = sizeof( SIDREC_HEADER );
+
+	u32 nSIDs = kind == KIND_2SID ? 2 : ( kind == KIND_3SID ? 3 : 8 );
+
+	PLAYER player[ 8 ];
+	memset( player, 0, sizeof( player ) );
+
+	u32 nFrames = (u32)( seconds * CLOCKFREQ / FRAME_CYCLES );
+	u64 cycle = 0;
+
+	for ( u32 frame = 0; frame < nFrames; frame++ )
+	{
+		u32 step = frame / FRAMES_PER_STEP;
+		u32 section = step / STEPS_PER_SECTION;
+
+		// the player starts at a rasterline interrupt and handles one SID after the other
+		u64 c = (u64)frame * FRAME_CYCLES + 50 * 63;
+		for ( u32 s = 0; s < nSIDs; s++ )
+		{
+			if ( !sidPlays( s, section, frame ) )
+			{
+				// the player stops the SID with a gate off and leaves it alone afterwards
+				if ( player[ s ].playing )
+				{
+					for ( u32 i = 0; i < 3; i++ )
+						player[ s ].v[ i ].gate = 0;
+					c = playerFrame( &player[ s ], s, c, frame );
+					player[ s ].playing = 0;
+				}
+				continue;
+			}
+			player[ s ].playing = 1;
+			if ( frame % FRAMES_PER_STEP == 0 )
+				playerStep( &player[ s ], s, step );
+			c = playerFrame( &player[ s ], s, c, frame );
+		}
+		cycle = c;
+	}
+
+	SIDREC_HEADER *h = (SIDREC_HEADER *)buffer;
+	memset( h, 0, sizeof( SIDREC_HEADER ) );
+	h->magic = SIDREC_MAGIC;
+	h->version = SIDREC_VERSION;
+	h->clockFreq = CLOCKFREQ;
+	h->sampleRate = SAMPLERATE;
+	h->sidModel[ 0 ] = h->sidModel[ 1 ] = model;
+	for ( u32 i = 0; i < 4; i++ )
+		h->volume[ i ] = 256;
+	h->nEvents = nEvents;
+	h->nCycles = (u32)cycle;
+
+	FILE *f = fopen( fileOut, "wb" );
+	if ( f == NULL || fwrite( buffer, 1, bufferSize, f ) != bufferSize )
+	{
+		fprintf( stderr, "cannot write %s\n", fileOut );
+		return 1;
+	}
+	fclose( f );
+
+	printf( "%s: %s, %u SIDs (%u), %u events, %.2f s\n", fileOut, kindName[ kind ], nSIDs, model, nEvents, cycle / (double)CLOCKFREQ );
+
+	free( buffer );
+	return 0;
+}
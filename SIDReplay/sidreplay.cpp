@@ -0,0 +1,766 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  |
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   |
+        \/         \/    \/     \/       \/     \/            \/       \/      |__|
+
+ sidreplay.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - offline renderer for register stream recordings of the SID kernel (runs on the host)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "sidrec.h"
+#include "audioengine.h"
+#include "resid/sid.h"
+#include "fmopl.h"
+#include "TEDsoundBL.h"
+
+#define TSF_IMPLEMENTATION
+#define TSF_NO_STDIO
+#include "tsf.h"
+
+using namespace reSID;
+
+#ifndef min
+#define min( a, b ) ( ((a)<(b))?(a):(b) )
+#endif
+#ifndef max
+#define max( a, b ) ( ((a)>(b))?(a):(b) )
+#endif
+
+// the emulation is set up exactly as in initSID() of kernel_sid.cpp (kernel_sid8.cpp uses 8 SIDs)
+#define NUM_SIDS 8
+
+// the kernels whose emulation loop and mixer are reproduced
+#define CONFIG_SID		0		// kernel_sid.cpp: 2 SIDs, OPL, MIDI
+#define CONFIG_SID8		1		// kernel_sid8.cpp: 8 SIDs, SID1 writes go to the even, SID2 writes to the odd ones
+#define CONFIG_SID264	2		// kernel_sid264.cpp: 2 SIDs, OPL, TED sound (playing a constant tone here)
+#define NUM_CONFIGS		3
+
+static const char *configName[ NUM_CONFIGS ] = { "sid", "sid8", "sid264" };
+
+// longest step before OSC3/ENV3 are read back, as in the kernels
+static const u32 configMaxStep[ NUM_CONFIGS ] = { 256, 256, 16 };
+
+static SIDREC_HEADER hdr;
+static u8 *events;
+static u32 eventsSize;
+
+static u32 config = CONFIG_SID;
+static u32 nSIDs;
+
+// idle fast path of reSID (see SID::enable_idle_skip), can be disabled for comparisons
+static bool idleSkip = true;
+
+static SID *sid[ NUM_SIDS ];
+static u32 outRegisters[ 32 ];		// read-back registers, as in the kernels
+static FM_OPL *pOPL = NULL;
+static TEDBL tedSound;
+static tsf *TinySoundFont = NULL;
+
+#define MIDI_BUF_SIZE_BITS	5
+static const int midiBufferSize = 1 << MIDI_BUF_SIZE_BITS;
+static float midiSampleBuffer[ 1 << MIDI_BUF_SIZE_BITS ];
+static int midiBufferOfs;
+
+static u8 *readWholeFile( const char *filename, u32 *size )
+{
+	FILE *f = fopen( filename, "rb" );
+	if ( f == NULL )
+		return NULL;
+
+	fseek( f, 0, SEEK_END );
+	*size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+
+	u8 *data = new u8[ *size + 1 ];
+	if ( fread( data, 1, *size, f ) != *size )
+	{
+		delete [] data;
+		data = NULL;
+	}
+	fclose( f );
+	return data;
+}
+
+static void initEmulation( const char *soundfont )
+{
+	nSIDs = ( config == CONFIG_SID8 ) ? 8 : 2;
+
+	for ( u32 i = 0; i < nSIDs; i++ )
+	{
+		sid[ i ] = new SID;
+
+		// reSID leaves the oscillators at a random phase (like a real SID after power up), but renders need to be reproducible
+		SID::State state = sid[ i ]->read_state();
+		for ( int j = 0; j < 3; j++ )
+			state.accumulator[ j ] = 0;
+		sid[ i ]->write_state( state );
+
+		for ( int j = 0; j < 25; j++ )
+			sid[ i ]->write( j, 0 );
+
+		if ( hdr.sidModel[ i & 1 ] == 6581 )
+		{
+			sid[ i ]->set_chip_model( MOS6581 );
+		} else
+		{
+			sid[ i ]->set_chip_model( MOS8580 );
+			if ( hdr.sidDigiBoost[ i & 1 ] == 0 )
+			{
+				sid[ i ]->set_voice_mask( 0x07 );
+				sid[ i ]->input( 0 );
+			} else
+			{
+				sid[ i ]->set_voice_mask( 0x0f );
+				sid[ i ]->input( -32768 );
+			}
+		}
+
+		int SID_passband = 90;
+		int SID_gain = 97;
+		int SID_filterbias = 500;
+
+		sid[ i ]->enable_idle_skip( idleSkip );
+		sid[ i ]->adjust_filter_bias( SID_filterbias / 1000.0f );
+		sid[ i ]->set_sampling_parameters( hdr.clockFreq, SAMPLE_FAST, hdr.sampleRate, hdr.sampleRate * SID_passband / 200.0f, SID_gain / 100.0f );
+	}
+
+	if ( ( hdr.flags & SIDREC_FLAG_OPL ) && config != CONFIG_SID8 )
+	{
+		pOPL = ym3812_init( 3579545, hdr.sampleRate );
+		ym3812_reset_chip( pOPL );
+	}
+
+	if ( config == CONFIG_SID264 )
+	{
+		tedBLSetVolume( &tedSound, 128, 0 );
+		tedBLInit( &tedSound, hdr.clockFreq, hdr.sampleRate );
+		tedBLWrite( &tedSound, 0, 0, 0x80 );
+		tedBLWrite( &tedSound, 0, 4, 0x03 );
+		tedBLWrite( &tedSound, 0, 1, 0x40 );
+		tedBLWrite( &tedSound, 0, 2, 0x03 );
+		tedBLWrite( &tedSound, 0, 3, 0x38 );
+	}
+
+	if ( ( hdr.flags & SIDREC_FLAG_MIDI ) && soundfont && config == CONFIG_SID )
+	{
+		u32 size;
+		u8 *data = readWholeFile( soundfont, &size );
+		if ( data )
+		{
+			TinySoundFont = tsf_load_memory( data, size );
+			delete [] data;
+		}
+		if ( TinySoundFont )
+		{
+			tsf_set_output( TinySoundFont, TSF_MONO, hdr.sampleRate, 0.0f );
+			tsf_set_volume( TinySoundFont, 0.5f * (float)hdr.midiVolume / 15.0f );
+			tsf_set_max_voices( TinySoundFont, 64 );
+			tsf_channel_set_bank_preset( TinySoundFont, 9, 128, 0 );
+		} else
+			fprintf( stderr, "cannot load soundfont %s, MIDI events are ignored\n", soundfont );
+	}
+	memset( midiSampleBuffer, 0, sizeof( midiSampleBuffer ) );
+	midiBufferOfs = midiBufferSize;
+}
+
+static void quitEmulation()
+{
+	for ( u32 i = 0; i < nSIDs; i++ )
+		delete sid[ i ];
+	if ( pOPL )
+		ym3812_shutdown( pOPL );
+	if ( TinySoundFont )
+		tsf_close( TinySoundFont );
+	pOPL = NULL;
+	TinySoundFont = NULL;
+}
+
+static void applyMIDI( u32 data )
+{
+	if ( TinySoundFont == NULL )
+		return;
+
+	u8 MC = data & 255;
+	u8 MD1 = ( data >> 8 ) & 255;
+	u8 MD2 = ( data >> 16 ) & 255;
+
+	u8 channel = MC & 0x0f;
+	MC &= 0xf0;
+
+	switch ( MC )
+	{
+	default:
+		break;
+	case 0x90: // note on
+		tsf_channel_note_on( TinySoundFont, channel, MD1, (float)MD2 / 127.0f );
+		break;
+	case 0x80: // note off
+		tsf_channel_note_off( TinySoundFont, channel, MD1 );
+		break;
+	case 0xc0: // program change
+		tsf_channel_set_presetnumber( TinySoundFont, channel, MD1, ( channel == 9 ) );
+		break;
+	case 0xe0: // pitch bend
+		tsf_channel_set_pitchwheel( TinySoundFont, channel, MD1 | ( MD2 << 7 ) );
+		break;
+	case 0xb0: // control change
+		tsf_channel_midi_control( TinySoundFont, channel, MD1, MD2 );
+		break;
+	}
+}
+
+// same dispatch as in the main loop of kernel_sid.cpp (kernel_sid8.cpp: SID1/SID2 to the even/odd SIDs)
+static void dispatchEvent( u32 type, u32 reg, u32 data )
+{
+	u32 sid2Disabled = hdr.flags & SIDREC_FLAG_SID2_DISABLED;
+	u32 sid2Same = hdr.flags & SIDREC_FLAG_SID2_SAME;
+
+	switch ( type )
+	{
+	case SIDREC_MIDI:
+		applyMIDI( data );
+		break;
+	case SIDREC_OPL:
+		if ( pOPL )
+			ym3812_write( pOPL, ( reg & ( 1 << 4 ) ) ? 1 : 0, data );
+		break;
+	case SIDREC_RESET:
+		for ( u32 i = 0; i < nSIDs; i++ )
+			for ( int j = 0; j < 25; j++ )
+				sid[ i ]->write( j, 0 );
+		if ( pOPL )
+			ym3812_reset_chip( pOPL );
+		if ( TinySoundFont )
+			tsf_reset( TinySoundFont );
+		break;
+	case SIDREC_SIDN:
+		// recordings with more than two SIDs: kernel_sid.cpp only has SID1 and SID2
+		if ( config == CONFIG_SID8 )
+			sid[ data >> 8 ]->write( reg, data & 255 ); else
+		if ( ( data >> 8 ) < 2 )
+			dispatchEvent( SIDREC_SID1 + ( data >> 8 ), reg, data & 255 );
+		break;
+	default:
+		if ( config == CONFIG_SID8 )
+		{
+			for ( u32 i = ( type == SIDREC_SID2 ) ? 1 : 0; i < nSIDs; i += 2 )
+				sid[ i ]->write( reg, data );
+		} else
+		if ( type == SIDREC_SID2 && !sid2Disabled && !sid2Same )
+		{
+			sid[ 1 ]->write( reg, data );
+		} else
+		{
+			sid[ 0 ]->write( reg, data );
+			if ( !sid2Disabled && sid2Same )
+				sid[ 1 ]->write( reg, data );
+		}
+		break;
+	}
+}
+
+//
+// the recorded events as sound sources for the emulation engine (see audioengine.h)
+//
+class CReplaySources
+{
+public:
+	u32 pos, pending;
+	u32 type, reg, data;
+	unsigned long long time;
+	unsigned long long *nCyclesEmulated;
+	unsigned long long totalCycles;
+	AUDIO_SAMPLE_CLOCK *sampleClock;
+	u32 sid2Enabled;
+
+	void readEvent()
+	{
+		u32 delta = 0;
+		u32 n = sidrecGetEvent( &events[ pos ], eventsSize - pos, &delta, &type, &reg, &data );
+		pending = n ? 1 : 0;
+		pos += n;
+		time += delta;
+	}
+
+	u32 nextEvent( u64 *t )
+	{
+		*t = time;
+		return pending;
+	}
+
+	void applyEvent()
+	{
+		dispatchEvent( type, reg, data );
+
+		if ( type == SIDREC_RESET )
+		{
+			// the kernel restarts its cycle and sample counters after a reset
+			*nCyclesEmulated = time = 0;
+			audioClockInit( sampleClock, hdr.clockFreq, hdr.sampleRate );
+		}
+
+		readEvent();
+	}
+
+	void clock( u32 cycles )
+	{
+		if ( config == CONFIG_SID8 )
+		{
+			for ( u32 i = 0; i < nSIDs; i++ )
+				sid[ i ]->clock( cycles );
+		} else
+		{
+			sid[ 0 ]->clock( cycles );
+			if ( sid2Enabled )
+				sid[ 1 ]->clock( cycles );
+		}
+
+		outRegisters[ 27 ] = sid[ 0 ]->read( 27 );
+		outRegisters[ 28 ] = sid[ 0 ]->read( 28 );
+
+		totalCycles += cycles;
+	}
+};
+
+static void mixSample( s32 *left, s32 *right, u32 sid2Enabled, unsigned long long cycle )
+{
+	if ( config == CONFIG_SID8 )
+	{
+		// as in kernel_sid8.cpp
+		s32 l = 0, r = 0;
+		for ( u32 i = 0; i < nSIDs; i += 2 )
+		{
+			r += sid[ i ]->output();
+			l += sid[ i + 1 ]->output();
+		}
+		*left  = max( -32767, min( 32767, l >> 1 ) );
+		*right = max( -32767, min( 32767, r >> 1 ) );
+		return;
+	}
+
+	s32 val1 = sid[ 0 ]->output();
+	s32 val2 = sid2Enabled ? sid[ 1 ]->output() : 0;
+	s32 valOPL = 0;
+	if ( pOPL )
+		ym3812_update_one( pOPL, &valOPL, 1 );
+
+	s32 valMIDI = 0;
+	if ( TinySoundFont )
+	{
+		if ( midiBufferOfs >= midiBufferSize )
+		{
+			tsf_render_float( TinySoundFont, &midiSampleBuffer[0], midiBufferSize, 0 );
+			midiBufferOfs = 0;
+		}
+
+		valMIDI = midiSampleBuffer[ midiBufferOfs ] * 32767.0f;
+		midiSampleBuffer[ midiBufferOfs ] = 0.0f;
+		midiBufferOfs ++;
+		if ( valMIDI < -31768+2 ) valMIDI = -31768+2;
+		if ( valMIDI >  31767-2 ) valMIDI =  31767-2;
+	}
+
+	// kernel_sid264.cpp adds the TED output with its own volume (here: 0.5)
+	if ( config == CONFIG_SID264 )
+		valMIDI = tedBLSample( &tedSound, cycle ) >> 8;
+
+	s32 volume[ 6 ];
+	for ( u32 i = 0; i < 6; i++ )
+		volume[ i ] = hdr.volume[ i ];
+
+	sidMixSample( val1, val2, valOPL, valMIDI, volume, left, right );
+}
+
+//
+// renders the recording, returns the number of stereo samples written to 'out' (if not NULL)
+// 'tailCycles' are emulated after the last event to let the sound decay
+//
+static u32 render( s16 *out, u32 maxSamples, u32 tailCycles, unsigned long long *emulatedCycles )
+{
+	u32 nSamples = 0;
+	unsigned long long nCyclesEmulated = 0;
+	unsigned long long endTime = 0;
+
+	AUDIO_SAMPLE_CLOCK sampleClock = { 0 };
+	audioClockInit( &sampleClock, hdr.clockFreq, hdr.sampleRate );
+
+	CReplaySources src;
+	src.pos = 0;
+	src.time = 0;
+	src.type = src.reg = src.data = 0;
+	src.totalCycles = 0;
+	src.nCyclesEmulated = &nCyclesEmulated;
+	src.sampleClock = &sampleClock;
+	src.sid2Enabled = !( hdr.flags & SIDREC_FLAG_SID2_DISABLED ) || config == CONFIG_SID8;
+	src.readEvent();
+
+	while ( nSamples < maxSamples )
+	{
+		// on the RPi the emulation is also limited by the progress of the C64, offline we are never waiting
+		unsigned long long cycleLimit = ~0ULL;
+
+		if ( !src.pending )
+		{
+			if ( endTime == 0 )
+				endTime = nCyclesEmulated + tailCycles;
+			if ( nCyclesEmulated >= endTime )
+				break;
+			cycleLimit = endTime;
+		}
+
+		if ( !audioEmulateToNextSample( src, &sampleClock, nCyclesEmulated, cycleLimit, configMaxStep[ config ] ) )
+			continue;
+
+		s32 left, right;
+		mixSample( &left, &right, src.sid2Enabled, nCyclesEmulated );
+
+		if ( out )
+		{
+			out[ nSamples * 2 + 0 ] = left;
+			out[ nSamples * 2 + 1 ] = right;
+		}
+		nSamples ++;
+	}
+
+	*emulatedCycles = src.totalCycles;
+	return nSamples;
+}
+
+static void putLE( u8 *p, u32 v, u32 bytes )
+{
+	for ( u32 i = 0; i < bytes; i++ )
+		p[ i ] = ( v >> ( i * 8 ) ) & 255;
+}
+
+static int writeWAV( const char *filename, const s16 *samples, u32 nSamples, u32 sampleRate )
+{
+	u8 h[ 44 ];
+	u32 dataSize = nSamples * 4;
+	memcpy( &h[ 0 ], "RIFF", 4 );	putLE( &h[ 4 ], 36 + dataSize, 4 );
+	memcpy( &h[ 8 ], "WAVEfmt ", 8 );
+	putLE( &h[ 16 ], 16, 4 );		putLE( &h[ 20 ], 1, 2 );			putLE( &h[ 22 ], 2, 2 );
+	putLE( &h[ 24 ], sampleRate, 4 );	putLE( &h[ 28 ], sampleRate * 4, 4 );
+	putLE( &h[ 32 ], 4, 2 );		putLE( &h[ 34 ], 16, 2 );
+	memcpy( &h[ 36 ], "data", 4 );	putLE( &h[ 40 ], dataSize, 4 );
+
+	FILE *f = fopen( filename, "wb" );
+	if ( f == NULL )
+		return 0;
+
+	// samples are stored little endian, as on the RPi and all common hosts
+	int ok = fwrite( h, 1, 44, f ) == 44 && fwrite( samples, 4, nSamples, f ) == nSamples;
+	fclose( f );
+	return ok;
+}
+
+// returns the 16 bit stereo samples of a WAV file (no conversion)
+static s16 *readWAV( const char *filename, u32 *nSamples )
+{
+	u32 size;
+	u8 *data = readWholeFile( filename, &size );
+	if ( data == NULL || size < 12 || memcmp( data, "RIFF", 4 ) || memcmp( &data[ 8 ], "WAVE", 4 ) )
+	{
+		delete [] data;
+		return NULL;
+	}
+
+	u32 p = 12;
+	while ( p + 8 <= size )
+	{
+		u32 chunkSize = data[ p + 4 ] | ( data[ p + 5 ] << 8 ) | ( data[ p + 6 ] << 16 ) | ( data[ p + 7 ] << 24 );
+		if ( memcmp( &data[ p ], "data", 4 ) == 0 )
+		{
+			chunkSize = min( chunkSize, size - p - 8 );
+			*nSamples = chunkSize / 4;
+			s16 *s = new s16[ *nSamples * 2 + 1 ];
+			memcpy( s, &data[ p + 8 ], *nSamples * 4 );
+			delete [] data;
+			return s;
+		}
+		p += 8 + chunkSize + ( chunkSize & 1 );
+	}
+
+	delete [] data;
+	return NULL;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// loads the reSID filter tables from 'filename' (like prepareSIDFilterTables in ../sound.cpp), or computes them
+// and writes the file if it is missing or stems from a different build
+static void prepareFilterTables( const char *filename )
+{
+	u32 size = reSID::Filter::tables_size(), fileSize;
+	double t = now();
+	const char *source = "computed";
+
+	u8 *data = filename ? readWholeFile( filename, &fileSize ) : NULL;
+	if ( data && fileSize == size && reSID::Filter::load_tables( data, size ) )
+	{
+		source = "loaded";
+	} else
+	{
+		reSID::Filter::build_tables();
+		delete [] data;
+		data = new u8[ size ];
+		if ( filename && reSID::Filter::save_tables( data, size ) )
+		{
+			FILE *f = fopen( filename, "wb" );
+			if ( f == NULL || fwrite( data, 1, size, f ) != size )
+				fprintf( stderr, "cannot write %s\n", filename );
+			if ( f )
+				fclose( f );
+		}
+	}
+	delete [] data;
+
+	printf( "filter tables %s in %.3f s, %u KB\n", source, now() - t, size / 1024 );
+}
+
+// renders 'repeat' times, returns the best speed in emulated seconds per second
+static double renderTimed( s16 *samples, u32 maxSamples, u32 tailCycles, int repeat, const char *fileSF2, u32 *nSamples, unsigned long long *emulatedCycles )
+{
+	double best = 0.0;
+
+	for ( int r = 0; r < repeat || r == 0; r++ )
+	{
+		initEmulation( fileSF2 );
+
+		double t0 = now();
+		*nSamples = render( samples, maxSamples, tailCycles, emulatedCycles );
+		double t = now() - t0;
+
+		quitEmulation();
+
+		double speed = ( *emulatedCycles / (double)hdr.clockFreq ) / t;
+		if ( speed > best )
+			best = speed;
+	}
+
+	return best;
+}
+
+static void usage()
+{
+	printf( "usage: sidreplay [options] recording.skr\n" );
+	printf( "  -o file.wav    write the rendered audio\n" );
+	printf( "  -d file.wav    compare the rendered audio to a reference\n" );
+	printf( "  -m file.sf2    soundfont for MIDI events (otherwise they are ignored)\n" );
+	printf( "  -r n           render n times and report the best speed (default 1)\n" );
+	printf( "  -c config      emulation/mixer of the kernel: sid (default), sid8 or sid264\n" );
+	printf( "  -b             benchmark all configurations\n" );
+	printf( "  -t seconds     time to render after the last event (default 1)\n" );
+	printf( "  -f file        load the reSID filter tables from file (computed and written if missing)\n" );
+	printf( "  -i             disable the idle fast path of reSID\n" );
+	printf( "  -x             render with and without the idle fast path, compare and report both speeds\n" );
+}
+
+int main( int argc, char **argv )
+{
+	const char *fileRec = NULL, *fileOut = NULL, *fileRef = NULL, *fileSF2 = NULL, *fileTables = NULL;
+	int repeat = 1, benchmark = 0, compareIdle = 0;
+	double tail = 1.0;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[ i ], "-b" ) == 0 )
+		{
+			benchmark = 1;
+			continue;
+		}
+		if ( strcmp( argv[ i ], "-i" ) == 0 )
+		{
+			idleSkip = false;
+			continue;
+		}
+		if ( strcmp( argv[ i ], "-x" ) == 0 )
+		{
+			compareIdle = 1;
+			continue;
+		}
+		if ( strcmp( argv[ i ], "-c" ) == 0 && i + 1 < argc )
+		{
+			i ++;
+			for ( config = 0; config < NUM_CONFIGS; config++ )
+				if ( strcmp( argv[ i ], configName[ config ] ) == 0 )
+					break;
+			if ( config < NUM_CONFIGS )
+				continue;
+		} else
+		if ( argv[ i ][ 0 ] == '-' && i + 1 < argc )
+		{
+			switch ( argv[ i ][ 1 ] )
+			{
+			case 'o': fileOut = argv[ ++i ]; continue;
+			case 'd': fileRef = argv[ ++i ]; continue;
+			case 'm': fileSF2 = argv[ ++i ]; continue;
+			case 'r': repeat = atoi( argv[ ++i ] ); continue;
+			case 't': tail = atof( argv[ ++i ] ); continue;
+			case 'f': fileTables = argv[ ++i ]; continue;
+			}
+		} else
+		if ( argv[ i ][ 0 ] != '-' && fileRec == NULL )
+		{
+			fileRec = argv[ i ];
+			continue;
+		}
+		usage();
+		return 1;
+	}
+
+	if ( fileRec == NULL )
+	{
+		usage();
+		return 1;
+	}
+
+	u32 size;
+	u8 *rec = readWholeFile( fileRec, &size );
+	if ( rec == NULL || size < sizeof( SIDREC_HEADER ) )
+	{
+		fprintf( stderr, "cannot read %s\n", fileRec );
+		return 1;
+	}
+
+	memcpy( &hdr, rec, sizeof( SIDREC_HEADER ) );
+	if ( hdr.magic != SIDREC_MAGIC || hdr.version != SIDREC_VERSION || hdr.clockFreq == 0 || hdr.sampleRate == 0 )
+	{
+		fprintf( stderr, "%s is not a SID kernel recording (or an unsupported version)\n", fileRec );
+		return 1;
+	}
+
+	events = rec + sizeof( SIDREC_HEADER );
+	eventsSize = size - sizeof( SIDREC_HEADER );
+
+	printf( "%s: %u events, %.2f s, SID1 %u, SID2 %s%u, %s%s%s\n", fileRec, hdr.nEvents, hdr.nCycles / (double)hdr.clockFreq,
+		hdr.sidModel[ 0 ], ( hdr.flags & SIDREC_FLAG_SID2_DISABLED ) ? "disabled " : "", hdr.sidModel[ 1 ],
+		( hdr.flags & SIDREC_FLAG_OPL ) ? "OPL " : "", ( hdr.flags & SIDREC_FLAG_MIDI ) ? "MIDI " : "",
+		( hdr.flags & SIDREC_FLAG_TRUNCATED ) ? "(truncated)" : "" );
+
+	prepareFilterTables( fileTables );
+
+	u32 tailCycles = (u32)( tail * hdr.clockFreq );
+	u32 maxSamples = (u32)( ( (unsigned long long)hdr.nCycles + tailCycles ) * hdr.sampleRate / hdr.clockFreq ) + hdr.sampleRate;
+	s16 *samples = new s16[ (size_t)maxSamples * 2 ];
+
+	u32 nSamples = 0;
+	unsigned long long emulatedCycles = 0;
+
+	if ( benchmark )
+	{
+		u32 selected = config;
+		for ( config = 0; config < NUM_CONFIGS; config++ )
+		{
+			double best = renderTimed( samples, maxSamples, tailCycles, repeat, fileSF2, &nSamples, &emulatedCycles );
+			printf( "%-8s %.1f emulated seconds per second\n", configName[ config ], best );
+		}
+		config = selected;
+	}
+
+	// reference without the idle fast path of reSID
+	s16 *samplesFull = NULL;
+	u32 nSamplesFull = 0;
+	if ( compareIdle )
+	{
+		samplesFull = new s16[ (size_t)maxSamples * 2 ];
+		idleSkip = false;
+		double bestFull = renderTimed( samplesFull, maxSamples, tailCycles, repeat, fileSF2, &nSamplesFull, &emulatedCycles );
+		idleSkip = true;
+		printf( "without idle fast path: %.1f emulated seconds per second\n", bestFull );
+	}
+
+	double best = renderTimed( samples, maxSamples, tailCycles, repeat, fileSF2, &nSamples, &emulatedCycles );
+
+	printf( "rendered %.2f s of audio (%s), %.1f emulated seconds per second\n", emulatedCycles / (double)hdr.clockFreq, configName[ config ], best );
+
+	if ( fileOut && !writeWAV( fileOut, samples, nSamples, hdr.sampleRate ) )
+	{
+		fprintf( stderr, "cannot write %s\n", fileOut );
+		return 1;
+	}
+
+	int result = 0;
+	if ( samplesFull )
+	{
+		if ( nSamplesFull == nSamples && memcmp( samplesFull, samples, (size_t)nSamples * 4 ) == 0 )
+			printf( "identical with and without idle fast path\n" ); else
+		{
+			printf( "differs without idle fast path\n" );
+			result = 2;
+		}
+		delete [] samplesFull;
+	}
+
+	if ( fileRef )
+	{
+		u32 nRef;
+		s16 *ref = readWAV( fileRef, &nRef );
+		if ( ref == NULL )
+		{
+			fprintf( stderr, "cannot read %s\n", fileRef );
+			return 1;
+		}
+
+		u32 n = min( nRef, nSamples ) * 2;
+		u32 nDiff = 0, maxDiff = 0, firstDiff = 0;
+		double sumSq = 0.0;
+		for ( u32 i = 0; i < n; i++ )
+		{
+			int d = abs( (int)samples[ i ] - (int)ref[ i ] );
+			if ( d == 0 )
+				continue;
+			if ( nDiff ++ == 0 )
+				firstDiff = i / 2;
+			if ( (u32)d > maxDiff )
+				maxDiff = d;
+			sumSq += (double)d * d;
+		}
+
+		if ( nDiff == 0 && nRef == nSamples )
+			printf( "identical to %s\n", fileRef ); else
+		{
+			printf( "differs from %s: %u of %u values, first at sample %u, max %u, rms %.2f", fileRef, nDiff, n, firstDiff, maxDiff, n ? sqrt( sumSq / n ) : 0.0 );
+			if ( nRef != nSamples )
+				printf( ", length %u vs. %u samples", nSamples, nRef );
+			printf( "\n" );
+			result = 2;
+		}
+		delete [] ref;
+	}
+
+	delete [] samples;
+	delete [] rec;
+
+	return result;
+}
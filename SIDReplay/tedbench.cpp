@@ -0,0 +1,384 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  |
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   |
+        \/         \/    \/     \/       \/     \/            \/       \/      |__|
+
+ tedbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - speed and spectral comparison of TEDsoundBL.h and TEDsound.h (runs on the host)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "audioengine.h"
+#include "TEDsoundBL.h"
+#include "TEDsound.h"
+
+#ifndef min
+#define min( a, b ) ( ((a)<(b))?(a):(b) )
+#endif
+#ifndef max
+#define max( a, b ) ( ((a)>(b))?(a):(b) )
+#endif
+
+// as kernel_sid264.cpp (CLOCKFREQ with the default SID clock)
+#define CLOCKFREQ	1773447
+#define SAMPLERATE	44100
+
+//
+// a list of register writes with their cycle, rendered by both implementations
+//
+typedef struct
+{
+	u64 cycle;
+	u32 reg, value;
+} TED_WRITE;
+
+static TED_WRITE *writes;
+static u32 nWrites, maxWrites;
+
+static void addWrite( u64 cycle, u32 reg, u32 value )
+{
+	if ( nWrites == maxWrites )
+	{
+		maxWrites = maxWrites ? maxWrites * 2 : 1024;
+		writes = (TED_WRITE*)realloc( writes, maxWrites * sizeof( TED_WRITE ) );
+	}
+	writes[ nWrites ].cycle = cycle;
+	writes[ nWrites ].reg = reg;
+	writes[ nWrites ].value = value;
+	nWrites ++;
+}
+
+// TED frequency register value for a square wave of (about) 'hz'
+static u32 tedFreqValue( double hz )
+{
+	s32 period = (s32)( TEDBL_TICK_RATE / ( 2.0 * hz ) + 0.5 );
+	return max( 0, min( 0x3fd, 0x3fe - period ) );
+}
+
+static double tedFrequency( u32 value )
+{
+	return TEDBL_TICK_RATE / ( 2.0 * ( 0x3fe - value ) );
+}
+
+static void tone( u64 cycle, u32 voice, u32 value )
+{
+	addWrite( cycle, voice ? 1 : 0, value & 255 );
+	addWrite( cycle, voice ? 2 : 4, value >> 8 );
+}
+
+// TEDsound.h: writes take effect at the next sample, the Digiblaster value is held until then (as before in kernel_sid264.cpp)
+static void renderOld( s32 *out, u32 nSamples )
+{
+	// tedSoundInit() does not reset the registers
+	tedSoundInit( SAMPLERATE );
+	writeSoundReg( 3, 0 );
+
+	AUDIO_SAMPLE_CLOCK c = { 0 };
+	audioClockInit( &c, CLOCKFREQ, SAMPLERATE );
+
+	s32 digi = 0;
+	u32 w = 0;
+	for ( u32 i = 0; i < nSamples; i++ )
+	{
+		while ( w < nWrites && writes[ w ].cycle < c.nextSample )
+		{
+			if ( writes[ w ].reg == TEDBL_DIGIBLASTER )
+				digi = (s32)writes[ w ].value - 128; else
+				writeSoundReg( writes[ w ].reg, writes[ w ].value );
+			w ++;
+		}
+		out[ i ] = TEDcalcNextSample() * 256 + 2 * digi * 256;
+		audioClockNextSample( &c );
+	}
+}
+
+static void renderNew( s32 *out, u32 nSamples )
+{
+	TEDBL t;
+	tedBLSetVolume( &t, 256, 256 );
+	tedBLInit( &t, CLOCKFREQ, SAMPLERATE );
+
+	AUDIO_SAMPLE_CLOCK c = { 0 };
+	audioClockInit( &c, CLOCKFREQ, SAMPLERATE );
+
+	u32 w = 0;
+	for ( u32 i = 0; i < nSamples; i++ )
+	{
+		while ( w < nWrites && writes[ w ].cycle < c.nextSample )
+		{
+			tedBLWrite( &t, writes[ w ].cycle, writes[ w ].reg, writes[ w ].value );
+			w ++;
+		}
+		out[ i ] = tedBLSample( &t, c.nextSample );
+		audioClockNextSample( &c );
+	}
+}
+
+//
+// spectral check: the pitch of the fundamental, and the ratio of the energy at the expected frequencies
+// (harmonics of the measured fundamental) to everything else (aliasing, jitter)
+//
+#define FFT_BITS	16
+#define FFT_SIZE	( 1 << FFT_BITS )
+#define FFT_SKIP	4096		// samples skipped before the analysis (settling)
+#define PEAK_BINS	6			// bins around an expected frequency (window main lobe)
+
+static void fft( double *re, double *im, u32 n )
+{
+	for ( u32 i = 1, j = 0; i < n; i++ )
+	{
+		u32 bit = n >> 1;
+		for ( ; j & bit; bit >>= 1 )
+			j ^= bit;
+		j ^= bit;
+		if ( i < j )
+		{
+			double t = re[ i ]; re[ i ] = re[ j ]; re[ j ] = t;
+			t = im[ i ]; im[ i ] = im[ j ]; im[ j ] = t;
+		}
+	}
+
+	for ( u32 len = 2; len <= n; len <<= 1 )
+	{
+		double a = -2 * M_PI / len;
+		for ( u32 i = 0; i < n; i += len )
+			for ( u32 k = 0; k < len / 2; k++ )
+			{
+				double wr = cos( a * k ), wi = sin( a * k );
+				double *r0 = &re[ i + k ], *i0 = &im[ i + k ], *r1 = &re[ i + k + len / 2 ], *i1 = &im[ i + k + len / 2 ];
+				double tr = *r1 * wr - *i1 * wi, ti = *r1 * wi + *i1 * wr;
+				*r1 = *r0 - tr; *i1 = *i0 - ti;
+				*r0 += tr; *i0 += ti;
+			}
+	}
+}
+
+// fills 'expected' with the frequencies which belong to the signal with fundamental 'f0', returns their number
+typedef u32 (*EXPECTED_FREQUENCIES)( double f0, double *expected );
+
+static u32 squareHarmonics( double f0, double *expected )
+{
+	u32 n = 0;
+	for ( u32 k = 1; k * f0 < SAMPLERATE / 2; k += 2 )
+		expected[ n ++ ] = k * f0;
+	return n;
+}
+
+// images of a zero-order hold at the Digiblaster write rate
+#define DIGI_RATE	8000.0
+
+static u32 holdImages( double f0, double *expected )
+{
+	u32 n = 0;
+	for ( u32 k = 0; k * DIGI_RATE < SAMPLERATE / 2 + f0; k++ )
+	{
+		if ( k )
+			expected[ n ++ ] = k * DIGI_RATE - f0;
+		expected[ n ++ ] = k * DIGI_RATE + f0;
+	}
+	return n;
+}
+
+static void analyze( const s32 *samples, double f0, EXPECTED_FREQUENCIES expectedFrequencies, double *cents, double *ratio )
+{
+	static double re[ FFT_SIZE ], im[ FFT_SIZE ], power[ FFT_SIZE / 2 ];
+	static u8 isSignal[ FFT_SIZE / 2 ];
+	double expected[ 1024 ];
+
+	for ( u32 i = 0; i < FFT_SIZE; i++ )
+	{
+		// Blackman-Harris window
+		double x = 2 * M_PI * i / ( FFT_SIZE - 1 );
+		double w = 0.35875 - 0.48829 * cos( x ) + 0.14128 * cos( 2 * x ) - 0.01168 * cos( 3 * x );
+		re[ i ] = samples[ FFT_SKIP + i ] * w;
+		im[ i ] = 0.0;
+	}
+	fft( re, im, FFT_SIZE );
+
+	for ( u32 b = 0; b < FFT_SIZE / 2; b++ )
+		power[ b ] = re[ b ] * re[ b ] + im[ b ] * im[ b ] + 1e-30;
+
+	// the fundamental: strongest bin within +-3% of 'f0', refined by parabolic interpolation
+	const double binHz = SAMPLERATE / (double)FFT_SIZE;
+	u32 lo = (u32)( f0 * 0.97 / binHz ), hi = (u32)( f0 * 1.03 / binHz ), peak = lo;
+	for ( u32 b = lo; b <= hi; b++ )
+		if ( power[ b ] > power[ peak ] )
+			peak = b;
+
+	double a = log( power[ peak - 1 ] ), m = log( power[ peak ] ), c = log( power[ peak + 1 ] );
+	double fm = ( peak + 0.5 * ( a - c ) / ( a - 2 * m + c ) ) * binHz;
+	*cents = 1200.0 * log2( fm / f0 );
+
+	memset( isSignal, 0, sizeof( isSignal ) );
+	u32 nExpected = expectedFrequencies( fm, expected );
+	for ( u32 i = 0; i < nExpected; i++ )
+	{
+		s32 bin = (s32)( expected[ i ] / binHz + 0.5 );
+		for ( s32 b = bin - PEAK_BINS; b <= bin + PEAK_BINS; b++ )
+			if ( b >= 0 && b < FFT_SIZE / 2 )
+				isSignal[ b ] = 1;
+	}
+
+	// DC is ignored
+	double sig = 0.0, other = 0.0;
+	for ( u32 b = PEAK_BINS + 1; b < FFT_SIZE / 2; b++ )
+		if ( isSignal[ b ] ) sig += power[ b ]; else other += power[ b ];
+
+	*ratio = 10.0 * log10( sig / other );
+}
+
+static void compare( const char *name, double f0, EXPECTED_FREQUENCIES expectedFrequencies )
+{
+	u32 n = FFT_SKIP + FFT_SIZE;
+	s32 *out = new s32[ n ];
+	double cents[ 2 ], ratio[ 2 ];
+
+	renderOld( out, n );
+	analyze( out, f0, expectedFrequencies, &cents[ 0 ], &ratio[ 0 ] );
+	renderNew( out, n );
+	analyze( out, f0, expectedFrequencies, &cents[ 1 ], &ratio[ 1 ] );
+
+	printf( "%-28s %7.1f ct %7.1f dB %7.1f ct %7.1f dB\n", name, cents[ 0 ], ratio[ 0 ], cents[ 1 ], ratio[ 1 ] );
+	delete [] out;
+}
+
+static void spectralChecks()
+{
+	char name[ 64 ];
+
+	printf( "%-28s %21s %21s\n", "", "TEDsound.h", "TEDsoundBL.h" );
+	printf( "%-28s %10s %10s %10s %10s\n", "pitch error, signal/alias", "cents", "ratio", "cents", "ratio" );
+
+	const double freqs[] = { 220, 880, 2637, 5274, 9000 };
+	for ( u32 f = 0; f < sizeof( freqs ) / sizeof( freqs[ 0 ] ); f++ )
+	{
+		u32 v = tedFreqValue( freqs[ f ] );
+
+		nWrites = 0;
+		tone( 0, 0, v );
+		addWrite( 0, 3, 0x18 );		// voice 1, volume 8
+
+		sprintf( name, "square %.1f Hz", tedFrequency( v ) );
+		compare( name, tedFrequency( v ), squareHarmonics );
+	}
+
+	// Digiblaster: a 997 Hz sine written at 8 kHz
+	nWrites = 0;
+	const double fs = 997.0;
+	for ( u32 i = 0; i < ( FFT_SKIP + FFT_SIZE ) * DIGI_RATE / SAMPLERATE + 1; i++ )
+		addWrite( (u64)( i * (double)CLOCKFREQ / DIGI_RATE ), TEDBL_DIGIBLASTER, 128 + (s32)( 100 * sin( 2 * M_PI * fs * i / DIGI_RATE ) ) );
+
+	compare( "Digiblaster 997 Hz at 8 kHz", fs, holdImages );
+}
+
+//
+// benchmark: a 50 Hz player changing both voices (sometimes noise), and Digiblaster samples
+//
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void benchmark( u32 seconds, u32 repeat )
+{
+	nWrites = 0;
+	srand( 1 );
+
+	u64 frame = CLOCKFREQ / 50;
+	for ( u64 c = 0; c < (u64)seconds * CLOCKFREQ; c += frame )
+	{
+		tone( c, 0, tedFreqValue( 110 << ( rand() % 4 ) ) );
+		tone( c + 40, 1, tedFreqValue( 55 * ( 1 + rand() % 16 ) ) );
+		addWrite( c + 80, 3, ( rand() % 4 == 0 ) ? 0x58 : 0x38 );
+	}
+
+	u32 nSamples = seconds * SAMPLERATE;
+	s32 *out = new s32[ nSamples ];
+
+	printf( "\n%-32s %11s %11s\n", "million samples per second", "TEDsound.h", "TEDsoundBL.h" );
+
+	for ( u32 test = 0; test < 2; test++ )
+	{
+		if ( test == 1 )
+		{
+			// Digiblaster playback at 8 kHz in addition
+			for ( u64 c = 0; c < (u64)seconds * CLOCKFREQ; c += CLOCKFREQ / 8000 )
+				addWrite( c + 1, TEDBL_DIGIBLASTER, rand() & 255 );
+
+			// keep the writes sorted
+			for ( u32 i = 1; i < nWrites; i++ )
+				for ( u32 j = i; j > 0 && writes[ j - 1 ].cycle > writes[ j ].cycle; j-- )
+				{
+					TED_WRITE t = writes[ j ]; writes[ j ] = writes[ j - 1 ]; writes[ j - 1 ] = t;
+				}
+		}
+
+		double best[ 2 ] = { 0, 0 };
+		for ( u32 r = 0; r < repeat; r++ )
+			for ( u32 impl = 0; impl < 2; impl++ )
+			{
+				double t = now();
+				if ( impl == 0 ) renderOld( out, nSamples ); else renderNew( out, nSamples );
+				t = now() - t;
+				best[ impl ] = max( best[ impl ], nSamples / t / 1e6 );
+			}
+
+		printf( "%-32s %11.1f %11.1f\n", test ? "50 Hz player + Digiblaster" : "50 Hz player", best[ 0 ], best[ 1 ] );
+	}
+
+	delete [] out;
+}
+
+int main( int argc, char **argv )
+{
+	u32 seconds = 60, repeat = 3;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( argv[ i ][ 0 ] == '-' && i + 1 < argc )
+		{
+			switch ( argv[ i ][ 1 ] )
+			{
+			case 's': seconds = atoi( argv[ ++i ] ); continue;
+			case 'r': repeat = atoi( argv[ ++i ] ); continue;
+			}
+		}
+		printf( "usage: tedbench [-s seconds] [-r repeat]\n" );
+		return 1;
+	}
+
+	seconds = max( 1, seconds );
+	repeat = max( 1, repeat );
+
+	spectralChecks();
+	benchmark( seconds, repeat );
+
+	return 0;
+}
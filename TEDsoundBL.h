@@ -0,0 +1,363 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ TEDsoundBL.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - band-limited TED sound and Digiblaster (edge based, timestamped register writes)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _tedsoundbl_h
+#define _tedsoundbl_h
+
+#include <circle/types.h>
+#include <circle/util.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//
+// Band-limited TED sound and Digiblaster for kernel_sid264.cpp (and SIDReplay)
+//
+// The sound model is the one of TEDsound.h (Yape): two square wave voices (the 2nd one optionally playing
+// noise) whose flip-flops toggle when their 10 bit counters overflow, and the DA mode. Instead of stepping the
+// flip-flops once per output sample, the time of every edge is computed from the counters, and each level
+// change (edges, register writes, Digiblaster writes) is added as a band-limited step at its exact position:
+// a windowed sinc impulse is added to a small delta buffer which is integrated when the samples are output.
+//
+// Register writes are applied with the cycle at which the C16/+4 did them (e.g. when applying the events of
+// the ring buffer in audioEmulateToNextSample), the samples are requested with the cycle of the sample boundary.
+// All work is per edge or write, per sample only the delta buffers are integrated.
+//
+#define TEDBL_TICK_RATE		( 312 * 114 * 500 / 10 / 8 )	// TED sound clock, as TED_SOUND_CLOCK / 8 in TEDsound.h
+#define TEDBL_TAPS			16								// length of the band-limited impulse (output delay is half of it)
+#define TEDBL_PHASE_BITS	5								// sub-sample resolution of the step positions
+#define TEDBL_PHASES		( 1 << TEDBL_PHASE_BITS )
+#define TEDBL_BUF_SIZE		32								// delta buffer, power of 2 > TEDBL_TAPS + 1
+#define TEDBL_FROZEN		( ~0ULL )
+
+// register index for Digiblaster ($FD5E) writes, 0-4 are the TED sound registers $FF0E-$FF12
+#define TEDBL_DIGIBLASTER	5
+
+typedef struct
+{
+	// TED sound registers and state (as in TEDsound.h)
+	u32 freq[ 2 ];
+	u32 period[ 2 ];				// ticks between two flip-flop toggles, 0 = stopped (frequency $3FE)
+	u64 untilEdge[ 2 ];				// 32.32 fixed point ticks until the next toggle
+	u32 volume, channelStatus[ 2 ], noiseStatus;
+	u32 flipFlop, noiseCounter;
+	u32 daStatus;
+	s32 daLevel;
+
+	// timing
+	u64 lastCycle;
+	u64 now;						// 32.32 ticks since the last sample
+	u64 ticksPerCycle;				// 32.32 fixed point
+	u32 samplesPerTick;				// 16.16 fixed point
+	u32 minPeriod;					// voices toggling faster are above the Nyquist frequency
+	u64 maxCycles;					// longest step which is synthesized (after pauses)
+
+	// synthesis
+	s32 levelTED, levelDigi;
+	s32 bufTED[ TEDBL_BUF_SIZE ], bufDigi[ TEDBL_BUF_SIZE ];
+	s32 integTED, integDigi;
+	u32 outIdx;
+	s32 volumeTED, volumeDigi;
+} TEDBL;
+
+static s16 tedBLImpulse[ TEDBL_PHASES ][ TEDBL_TAPS ];
+static s32 tedBLVolumeTable[ 64 ];
+static u8  tedBLNoise[ 256 ];
+static u32 tedBLTablesReady = 0;
+
+static void tedBLBuildTables()
+{
+	// impulse for a step at fraction f after a sample: tap j is output j + 1 - f samples after the step
+	// (Blackman windowed sinc, cut-off at 0.45 * sample rate, every phase sums up to exactly 1 << 15)
+	const double fc = 0.45, c = TEDBL_TAPS / 2;
+	for ( u32 p = 0; p < TEDBL_PHASES; p++ )
+	{
+		double h[ TEDBL_TAPS ], sum = 0.0;
+		for ( u32 j = 0; j < TEDBL_TAPS; j++ )
+		{
+			double x = j + 1 - p / (double)TEDBL_PHASES - c;
+			double s = ( x == 0.0 ) ? 2 * fc : sin( 2 * M_PI * fc * x ) / ( M_PI * x );
+			double w = 0.42 + 0.5 * cos( M_PI * x / c ) + 0.08 * cos( 2 * M_PI * x / c );
+			h[ j ] = ( x <= -c || x >= c ) ? 0.0 : s * w;
+			sum += h[ j ];
+		}
+
+		s32 total = 0, center = 0;
+		for ( u32 j = 0; j < TEDBL_TAPS; j++ )
+		{
+			tedBLImpulse[ p ][ j ] = (s16)floor( h[ j ] / sum * 32768.0 + 0.5 );
+			total += tedBLImpulse[ p ][ j ];
+			if ( h[ j ] > h[ center ] )
+				center = j;
+		}
+		// rounding error goes to the largest tap, otherwise the integrated output would drift
+		tedBLImpulse[ p ][ center ] += 32768 - total;
+	}
+
+	// volume and noise tables as in tedSoundInit() of TEDsound.h
+	for ( int i = 0; i < 64; i++ )
+	{
+		int v = ( 586 + ( ( ( i & 0x0F ) < 9 ? ( i & 0x0F ) : 8 ) - 1 ) * 1024 ) << ( ( ( i & 0x30 ) == 0x30 ) ? 1 : 0 );
+		tedBLVolumeTable[ i ] = ( i & 0x0F && i & 0x30 ) ? v / -2 : v / 2;
+	}
+
+	int im = 0xa8;
+	for ( int i = 0; i < 256; i++ )
+	{
+		tedBLNoise[ i ] = ( im & 1 ) * 0x20;
+		im = ( im << 1 ) + ( 1 ^ ( ( im >> 7 ) & 1 ) ^ ( ( im >> 5 ) & 1 ) ^ ( ( im >> 4 ) & 1 ) ^ ( ( im >> 1 ) & 1 ) );
+	}
+
+	tedBLTablesReady = 1;
+}
+
+static inline s32 tedBLVoiceLevel( TEDBL *t, u32 v )
+{
+	u32 mask = v ? ( t->channelStatus[ 1 ] | t->noiseStatus ) : t->channelStatus[ 0 ];
+
+	// too fast to be heard: the average of both levels
+	if ( t->period[ v ] && t->period[ v ] < t->minPeriod )
+		return ( tedBLVolumeTable[ t->volume | mask ] + tedBLVolumeTable[ t->volume ] ) / 2;
+
+	u32 bits = t->flipFlop & t->channelStatus[ v ];
+	if ( v )
+		bits |= tedBLNoise[ t->noiseCounter ] & t->noiseStatus;
+
+	return tedBLVolumeTable[ t->volume | bits ];
+}
+
+static inline s32 tedBLLevel( TEDBL *t )
+{
+	if ( t->daStatus )
+		return t->daLevel;
+	return tedBLVoiceLevel( t, 0 ) + tedBLVoiceLevel( t, 1 );
+}
+
+// adds a band-limited step of height 'delta' at 'pos' (32.32 ticks after the last sample)
+static inline void tedBLStep( TEDBL *t, s32 *buf, u64 pos, s32 delta )
+{
+	u64 p = ( pos >> 16 ) * t->samplesPerTick;		// 32.32 samples
+	u32 ofs = p >> 32;
+	if ( ofs > TEDBL_BUF_SIZE - TEDBL_TAPS )
+		ofs = TEDBL_BUF_SIZE - TEDBL_TAPS;
+
+	const s16 *h = tedBLImpulse[ ( p >> ( 32 - TEDBL_PHASE_BITS ) ) & ( TEDBL_PHASES - 1 ) ];
+	u32 i = t->outIdx + ofs;
+	for ( u32 j = 0; j < TEDBL_TAPS; j++ )
+		buf[ ( i + j ) & ( TEDBL_BUF_SIZE - 1 ) ] += delta * h[ j ];
+}
+
+static inline void tedBLUpdateLevel( TEDBL *t )
+{
+	s32 l = tedBLLevel( t );
+	if ( l != t->levelTED )
+	{
+		tedBLStep( t, t->bufTED, t->now, l - t->levelTED );
+		t->levelTED = l;
+	}
+}
+
+// runs the oscillators up to 'cycle' and adds the steps of all flip-flop toggles
+static inline void tedBLAdvance( TEDBL *t, u64 cycle )
+{
+	if ( cycle <= t->lastCycle )
+		return;
+
+	u64 cycles = cycle - t->lastCycle;
+	t->lastCycle = cycle;
+	if ( cycles > t->maxCycles )
+		cycles = t->maxCycles;
+
+	u64 dt = cycles * t->ticksPerCycle;
+
+	if ( !t->daStatus )
+	{
+		for ( u32 v = 0; v < 2; v++ )
+		{
+			if ( t->period[ v ] == 0 )
+				continue;
+
+			u64 period = (u64)t->period[ v ] << 32;
+			u64 &e = t->untilEdge[ v ];
+
+			if ( t->period[ v ] < t->minPeriod )
+			{
+				// the level stays at the average, only the state is updated
+				if ( e <= dt )
+				{
+					u64 n = ( dt - e ) / period + 1;
+					t->flipFlop ^= ( n & 1 ) << ( 4 + v );
+					if ( v )
+						t->noiseCounter = ( t->noiseCounter + n ) & 255;
+					e += n * period;
+				}
+			} else
+			{
+				while ( e <= dt )
+				{
+					s32 before = tedBLVoiceLevel( t, v );
+					t->flipFlop ^= 0x10 << v;
+					if ( v )
+						t->noiseCounter = ( t->noiseCounter + 1 ) & 255;
+					s32 delta = tedBLVoiceLevel( t, v ) - before;
+					if ( delta )
+					{
+						tedBLStep( t, t->bufTED, t->now + e, delta );
+						t->levelTED += delta;
+					}
+					e += period;
+				}
+			}
+			e -= dt;
+		}
+	}
+
+	t->now += dt;
+}
+
+static inline void tedBLSetFreq( TEDBL *t, u32 v )
+{
+	u32 period = 0x3ff - ( ( t->freq[ v ] + 1 ) & 0x3ff );
+
+	if ( period == 0 )
+	{
+		// frequency $3FE: the flip-flop is set and stays
+		t->flipFlop |= 0x10 << v;
+		t->untilEdge[ v ] = TEDBL_FROZEN;
+	} else
+	if ( t->period[ v ] == 0 )
+		t->untilEdge[ v ] = 1ULL << 32;
+
+	// otherwise the counter keeps running and the new value is used after the next overflow
+	t->period[ v ] = period;
+}
+
+// a write to the TED sound registers ( reg = 0-4 for $FF0E-$FF12 ) or the Digiblaster ( reg = TEDBL_DIGIBLASTER )
+static inline void tedBLWrite( TEDBL *t, u64 cycle, u32 reg, u8 value )
+{
+	tedBLAdvance( t, cycle );
+
+	switch ( reg )
+	{
+	case 0:
+		t->freq[ 0 ] = ( t->freq[ 0 ] & 0x300 ) | value;
+		tedBLSetFreq( t, 0 );
+		break;
+	case 1:
+		t->freq[ 1 ] = ( t->freq[ 1 ] & 0x300 ) | value;
+		tedBLSetFreq( t, 1 );
+		break;
+	case 2:
+		t->freq[ 1 ] = ( t->freq[ 1 ] & 0xff ) | ( ( value & 3 ) << 8 );
+		tedBLSetFreq( t, 1 );
+		break;
+	case 3:
+		if ( ( t->daStatus = value & 0x80 ) )
+		{
+			t->flipFlop = 0x30;
+			for ( u32 v = 0; v < 2; v++ )
+				t->untilEdge[ v ] = t->period[ v ] ? (u64)t->period[ v ] << 32 : TEDBL_FROZEN;
+			t->noiseCounter = 0xff;
+			t->daLevel = tedBLVolumeTable[ value & 0x3f ];
+		}
+		t->volume = value & 0x0f;
+		t->channelStatus[ 0 ] = value & 0x10;
+		t->channelStatus[ 1 ] = value & 0x20;
+		t->noiseStatus = ( ( value & 0x40 ) >> 1 ) & ( t->channelStatus[ 1 ] ^ 0x20 );
+		break;
+	case 4:
+		t->freq[ 0 ] = ( t->freq[ 0 ] & 0xff ) | ( ( value & 3 ) << 8 );
+		tedBLSetFreq( t, 0 );
+		break;
+	case TEDBL_DIGIBLASTER:
+		{
+			s32 l = (s32)value - 128;
+			tedBLStep( t, t->bufDigi, t->now, l - t->levelDigi );
+			t->levelDigi = l;
+		}
+		return;
+	default:
+		return;
+	}
+
+	tedBLUpdateLevel( t );
+}
+
+// returns the sample at 'cycle', i.e. TED output * volumeTED + 2 * Digiblaster output * volumeDigi
+// (as it was mixed in kernel_sid264.cpp, i.e. before the final >> 8)
+static inline s32 tedBLSample( TEDBL *t, u64 cycle )
+{
+	tedBLAdvance( t, cycle );
+
+	u32 i = t->outIdx & ( TEDBL_BUF_SIZE - 1 );
+	t->integTED += t->bufTED[ i ];
+	t->integDigi += t->bufDigi[ i ];
+	t->bufTED[ i ] = t->bufDigi[ i ] = 0;
+	t->outIdx ++;
+	t->now = 0;
+
+	return ( t->integTED >> 15 ) * t->volumeTED + 2 * ( t->integDigi >> 15 ) * t->volumeDigi;
+}
+
+static inline void tedBLSetVolume( TEDBL *t, s32 volumeTED, s32 volumeDigi )
+{
+	t->volumeTED = volumeTED;
+	t->volumeDigi = volumeDigi;
+}
+
+// resets the TED sound state, 'cycle' is the current cycle (counting with 'clockFreq')
+static void tedBLInit( TEDBL *t, u32 clockFreq, u32 sampleRate, u64 cycle = 0 )
+{
+	if ( !tedBLTablesReady )
+		tedBLBuildTables();
+
+	s32 volumeTED = t->volumeTED, volumeDigi = t->volumeDigi;
+	memset( t, 0, sizeof( TEDBL ) );
+	tedBLSetVolume( t, volumeTED, volumeDigi );
+
+	t->ticksPerCycle = ( (u64)TEDBL_TICK_RATE << 32 ) / clockFreq;
+	t->samplesPerTick = ( (u64)sampleRate << 16 ) / TEDBL_TICK_RATE;
+	t->minPeriod = ( TEDBL_TICK_RATE + sampleRate - 1 ) / sampleRate;
+	t->maxCycles = clockFreq / 100;
+	t->lastCycle = cycle;
+
+	// counters running with reload value 0, as after tedSoundInit()
+	for ( u32 v = 0; v < 2; v++ )
+	{
+		t->period[ v ] = 0x3ff;
+		t->untilEdge[ v ] = (u64)0x3ff << 32;
+	}
+
+	t->levelTED = tedBLLevel( t );
+	t->integTED = t->levelTED << 15;
+}
+
+#endif
@@ -0,0 +1,320 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ vdcbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - checks and measures the 80 column renderer (vdc.h)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+//
+// vdcbench: drives the VDC register interface of ../vdc.h with the bus accesses a C64 program would make and renders
+// the result into an in-memory framebuffer as kernel_vdc.cpp does. Every frame is also drawn completely and compared.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "vdc.h"
+
+//
+// replay bus (as SIDReplay/chainbench.cpp)
+//
+typedef struct
+{
+	u32 g2, g3, data;
+} BUS_TRACE;
+
+// not a bus access: the main loop executes a pending block fill/copy (while the C64 polls the status)
+#define TRACE_BLOCKSTEP		0xffffffff
+
+class CBusReplay : public CBusCycle
+{
+public:
+	const BUS_TRACE *cur;
+	u32 out;
+
+	inline void start()							{ g2 = cur->g2; }
+	inline void readRest()						{ g3 = cur->g3; }
+	inline void put( u32 D )					{ out = D; }
+	inline u32  get()							{ return cur->data; }
+	inline void finish()						{}
+	inline void setClr( u32 set, u32 clr )		{}
+	inline void preloadL1( const void *p )		{ __builtin_prefetch( p ); }
+	inline void preloadL2( const void *p )		{ __builtin_prefetch( p ); }
+	inline void probe()							{}
+};
+
+static BUS_TRACE busAccess( u32 addr, u32 write, u32 data = 0 )
+{
+	BUS_TRACE t;
+
+	t.g2 = ( ( addr & 255 ) << A0 ) | bCS | ( write ? 0 : bRW ) | bRESET;
+	t.g3 = ( ( ( addr >> 8 ) & 31 ) << A8 ) | bIO1 | bIO2 | bROML | bROMH | bCS | bBA;
+	t.data = data & 255;
+
+	if ( addr >= 0xde00 && addr < 0xdf00 ) t.g3 &= ~bIO1;
+	if ( addr >= 0xdf00 && addr < 0xe000 ) t.g3 &= ~bIO2;
+
+	return t;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static BUSCHAIN_COUNTERS counters;
+static VDC_STATE vdc;
+typedef CDevVDC< &vdc > DevVDC;
+
+static u32 replay( const std::vector<BUS_TRACE> &trace )
+{
+	CBusReplay b;
+	u32 D = 0;
+
+	for ( size_t i = 0; i < trace.size(); i++ )
+	{
+		if ( trace[ i ].g2 == TRACE_BLOCKSTEP )
+		{
+			vdcBlockStep( &vdc );
+			continue;
+		}
+		b.cur = &trace[ i ];
+		busChainCycle< CBusReplay, &counters, DevVDC >( b );
+		D += b.out;
+	}
+	return D;
+}
+
+//
+// what a driver on the C64 does (as the screen editor of the C128 in 80 column mode)
+//
+static std::vector<BUS_TRACE> trace;
+
+static void vdcReg( u32 r, u32 v )
+{
+	trace.push_back( busAccess( 0xde00, 1, r ) );
+	trace.push_back( busAccess( 0xde01, 1, v ) );
+}
+
+static void vdcData( u32 v )
+{
+	trace.push_back( busAccess( 0xde01, 1, v ) );
+}
+
+static void vdcAddr( u32 a )
+{
+	vdcReg( 18, a >> 8 );
+	vdcReg( 19, a & 255 );
+	trace.push_back( busAccess( 0xde00, 1, 31 ) );
+}
+
+// R30 starts the operation, the driver polls the status until it is done
+static void vdcBlock( u32 n )
+{
+	vdcReg( 30, n & 255 );
+	trace.push_back( { TRACE_BLOCKSTEP, 0, 0 } );
+	trace.push_back( busAccess( 0xde00, 0 ) );
+}
+
+static void vdcCopy( u32 dst, u32 src, u32 n )
+{
+	vdcReg( 24, 0xa0 );
+	vdcReg( 32, src >> 8 );
+	vdcReg( 33, src & 255 );
+	vdcReg( 18, dst >> 8 );
+	vdcReg( 19, dst & 255 );
+	for ( ; n > 256; n -= 256 )
+		vdcBlock( 0 );
+	vdcBlock( n );
+}
+
+static void vdcFill( u32 dst, u32 value, u32 n )
+{
+	vdcReg( 24, 0x20 );
+	vdcAddr( dst );
+	vdcData( value );
+	n --;
+	for ( ; n > 256; n -= 256 )
+		vdcBlock( 0 );
+	vdcBlock( n );
+}
+
+#define SCREEN		0x0000
+#define ATTR		0x0800
+#define CHARSET		0x2000
+
+// a line of text with random length and color
+static void newLine( u32 row )
+{
+	u32 l = rand() % VDC_COLUMNS, color = 1 + rand() % 15;
+
+	vdcAddr( SCREEN + row * VDC_COLUMNS );
+	for ( u32 i = 0; i < l; i++ )
+		vdcData( ( rand() % 8 ) ? 1 + rand() % 63 : 32 );
+
+	// a few underlined, blinking and reversed characters
+	vdcAddr( ATTR + row * VDC_COLUMNS );
+	for ( u32 i = 0; i < l; i++ )
+	{
+		u32 r = rand() % 64;
+		vdcData( color | ( r == 0 ? 0x20 : r == 1 ? 0x10 : r == 2 ? 0x40 : 0 ) );
+	}
+}
+
+static void scroll()
+{
+	vdcCopy( SCREEN, SCREEN + VDC_COLUMNS, VDC_COLUMNS * ( VDC_ROWS - 1 ) );
+	vdcCopy( ATTR, ATTR + VDC_COLUMNS, VDC_COLUMNS * ( VDC_ROWS - 1 ) );
+	vdcFill( SCREEN + VDC_COLUMNS * ( VDC_ROWS - 1 ), 32, VDC_COLUMNS );
+	vdcFill( ATTR + VDC_COLUMNS * ( VDC_ROWS - 1 ), 15, VDC_COLUMNS );
+	newLine( VDC_ROWS - 1 );
+	vdcReg( 14, ( SCREEN + VDC_COLUMNS * ( VDC_ROWS - 1 ) ) >> 8 );
+	vdcReg( 15, ( SCREEN + VDC_COLUMNS * ( VDC_ROWS - 1 ) ) & 255 );
+}
+
+static void typeChar( u32 pos )
+{
+	vdcAddr( SCREEN + pos );
+	vdcData( 1 + rand() % 63 );
+	vdcReg( 14, ( SCREEN + pos + 1 ) >> 8 );
+	vdcReg( 15, ( SCREEN + pos + 1 ) & 255 );
+}
+
+static void setup()
+{
+	vdcInit( &vdc );
+	trace.clear();
+
+	// character set: 512 glyphs with 16 bytes each (8 used), glyph 32 is empty
+	vdcAddr( CHARSET );
+	for ( u32 g = 0; g < 512; g++ )
+		for ( u32 y = 0; y < 16; y++ )
+			vdcData( ( y < 8 && ( g & 255 ) != 32 ) ? rand() : 0 );
+
+	vdcFill( SCREEN, 32, VDC_CELLS );
+	vdcFill( ATTR, 15, VDC_CELLS );
+	for ( u32 r = 0; r < VDC_ROWS; r++ )
+		newLine( r );
+
+	replay( trace );
+	trace.clear();
+}
+
+//
+// the measurements
+//
+static u32 scaleY = 2;
+static u8 *fb, *fbRef;
+static u32 pitch = VDC_WIDTH;
+static VDC_RENDER render, renderRef;
+static u32 differences = 0;
+
+static void compareFrames( u32 frame )
+{
+	if ( memcmp( fb, fbRef, VDC_HEIGHT * scaleY * pitch ) == 0 )
+		return;
+	if ( differences ++ < 10 )
+		printf( "  frame %u differs from the complete redraw\n", frame );
+}
+
+static void run( const char *name, void ( *step )( u32 ), u32 frames )
+{
+	srand( 1 );
+	setup();
+	vdcRender( &render, &vdc, 0 );
+
+	double tBus = 0, tRender = 0, tFull = 0;
+	u64 accesses = 0, cells = 0;
+
+	for ( u32 f = 0; f < frames; f++ )
+	{
+		u64 us = (u64)f * VDC_FRAME_US;
+
+		trace.clear();
+		step( f );
+		accesses += trace.size();
+
+		double t0 = now();
+		replay( trace );
+		double t1 = now();
+		cells += vdcRender( &render, &vdc, us );
+		double t2 = now();
+		vdcRender( &renderRef, &vdc, us, 1 );
+		double t3 = now();
+
+		tBus += t1 - t0;
+		tRender += t2 - t1;
+		tFull += t3 - t2;
+
+		compareFrames( f );
+	}
+
+	printf( "%-8s %8u %10.0f %10.2f %10.1f %10.1f %10.1f %10.0f\n", name, frames, (double)accesses / frames,
+		accesses ? tBus * 1e9 / accesses : 0.0, (double)cells / frames, tRender * 1e6 / frames, tFull * 1e6 / frames,
+		frames / ( tBus + tRender ) );
+}
+
+static void stepScroll( u32 f )	{ scroll(); }
+static void stepType( u32 f )	{ typeChar( ( f * 7 ) % VDC_CELLS ); }
+static void stepIdle( u32 f )	{}
+
+int main( int argc, char **argv )
+{
+	u32 frames = 2000;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			frames = atoi( argv[ ++i ] ); else
+		if ( !strcmp( argv[ i ], "-1" ) )
+			scaleY = 1; else
+		{
+			fprintf( stderr, "usage: vdcbench [-n frames] [-1 (single lines)]\n" );
+			return 1;
+		}
+	}
+
+	fb = (u8 *)calloc( VDC_HEIGHT * scaleY, pitch );
+	fbRef = (u8 *)calloc( VDC_HEIGHT * scaleY, pitch );
+	vdcRenderInit( &render, fb, pitch, scaleY );
+	vdcRenderInit( &renderRef, fbRef, pitch, scaleY );
+
+	printf( "framebuffer %ux%u, 8 bit\n\n", VDC_WIDTH, VDC_HEIGHT * scaleY );
+	printf( "per frame: bus accesses, ns per access (FIQ device and block fills/copies), cells drawn, us for drawing\n"
+			"the changed cells, us for drawing all cells, frames per second (bus accesses and drawing the changes)\n\n" );
+	printf( "workload   frames   accesses  ns/access      cells changed us    full us   frames/s\n" );
+
+	run( "scroll", stepScroll, frames );
+	run( "type", stepType, frames );
+	run( "idle", stepIdle, frames );
+
+	printf( "\nrendering: %s (%u differences)\n", differences ? "FAILED" : "ok", differences );
+
+	return differences ? 2 : 0;
+}
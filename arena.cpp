@@ -0,0 +1,98 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ arena.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - launch-scoped memory arena for the kernels
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "arena.h"
+#include "lowlevel_arm64.h"
+
+typedef struct
+{
+	const char	*name;
+	u32			offset, size;
+} ARENA_REGION;
+
+static u8 arenaPool[ ARENA_SIZE ] AAA;
+
+static const char *arenaKernel = "menu";
+static u32 arenaUsed = 0, arenaPeak = 0;
+
+// regions are only recorded for the log
+static ARENA_REGION region[ ARENA_REGIONS ];
+static u32 nRegions = 0, nRegionsTotal = 0;
+
+void arenaBegin( const char *kernel )
+{
+	arenaKernel = kernel;
+	arenaUsed = arenaPeak = 0;
+	nRegions = nRegionsTotal = 0;
+}
+
+void arenaEnd( CLogger *logger )
+{
+	logger->Write( "Arena", LogNotice, "%s: peak usage %d of %d KB, %d regions", arenaKernel, ( arenaPeak + 1023 ) / 1024, ARENA_SIZE / 1024, nRegionsTotal );
+
+	for ( u32 i = 0; i < nRegions; i++ )
+		logger->Write( "Arena", LogNotice, "  %-12s %7d KB at %d", region[ i ].name, ( region[ i ].size + 1023 ) / 1024, region[ i ].offset );
+}
+
+void *arenaAlloc( CLogger *logger, const char *name, u32 size, u32 align )
+{
+	u32 offset = ( arenaUsed + align - 1 ) & ~( align - 1 );
+
+	if ( offset + size > ARENA_SIZE || offset + size < offset )
+	{
+		logger->Write( "Arena", LogPanic, "%s: cannot allocate %d bytes for '%s' (%d of %d bytes in use)", arenaKernel, size, name, arenaUsed, ARENA_SIZE );
+		return 0;
+	}
+
+	arenaUsed = offset + size;
+	if ( arenaUsed > arenaPeak )
+		arenaPeak = arenaUsed;
+
+	if ( nRegions < ARENA_REGIONS )
+	{
+		region[ nRegions ].name = name;
+		region[ nRegions ].offset = offset;
+		region[ nRegions ].size = size;
+		nRegions ++;
+	}
+	nRegionsTotal ++;
+
+	return &arenaPool[ offset ];
+}
+
+u32 arenaMark()
+{
+	return arenaUsed;
+}
+
+void arenaRelease( u32 mark )
+{
+	if ( mark < arenaUsed )
+		arenaUsed = mark;
+}
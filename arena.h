@@ -0,0 +1,58 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ arena.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - launch-scoped memory arena for the kernels
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _arena_h
+#define _arena_h
+
+#include <circle/types.h>
+#include <circle/logger.h>
+
+// Only one kernel runs at a time: instead of each kernel keeping its own large buffers (flash images, geoRAM, 
+// TFT buffers, ...) in the image, they claim named regions from one pool when they start. The menu releases 
+// all regions of a kernel when it returns (arenaBegin) and writes the peak usage to the log (arenaEnd).
+// Buffers which a FIQ handler accesses by name stay static arrays, as a pointer would cost an extra load there.
+#ifndef ARENA_SIZE
+#define ARENA_SIZE			( 5 * 1024 * 1024 )
+#endif
+#define ARENA_REGIONS		16
+
+// starts a new launch (releasing all regions), 'kernel' is the name used in the log
+extern void  arenaBegin( const char *kernel );
+
+// logs the peak usage and the regions of the current launch
+extern void  arenaEnd( CLogger *logger );
+
+// returns a region of 'size' bytes aligned to 'align' (a power of 2), panics if the arena is exhausted
+extern void *arenaAlloc( CLogger *logger, const char *name, u32 size, u32 align = 128 );
+
+// temporary regions: everything allocated after arenaMark is released by arenaRelease
+extern u32   arenaMark();
+extern void  arenaRelease( u32 mark );
+
+#endif
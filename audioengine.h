@@ -0,0 +1,152 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ audioengine.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - event driven emulation of the sound sources (shared by the SID kernels)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _audioengine_h
+#define _audioengine_h
+
+#include <circle/types.h>
+
+//
+// Event driven audio emulation shared by kernel_sid.cpp, kernel_sid8.cpp, kernel_sid264.cpp and SIDReplay
+//
+// The sound sources are clocked in one step up to the next event, which is the next register write,
+// the next sample boundary or the next read-back deadline (the longest step the caller allows before it
+// wants to update e.g. OSC3/ENV3), whichever comes first. All register writes which are due are applied
+// at once, not one per step.
+//
+// Sample boundaries are tracked with a 32.32 fixed-point phase accumulator: sample n is ready at cycle
+// ceil( n * clockFreq / sampleRate ), as with computing nCyclesEmulated * SAMPLERATE / CLOCKFREQ after each
+// step, but without a 64 bit division. Changing the sample rate only affects the following samples.
+//
+typedef struct
+{
+	u32 clockFreq, sampleRate;
+	u32 cyclesPerSample, cyclesPerSampleFrac;	// 32.32 fixed point
+	u64 position;								// exact position of the next sample: integer part ...
+	u32 phase;									// ... and fraction
+	u64 nextSample;								// first cycle at which the next sample is ready
+	u64 samplesElapsed;
+} AUDIO_SAMPLE_CLOCK;
+
+static inline void audioClockSetRate( AUDIO_SAMPLE_CLOCK *c, u32 clockFreq, u32 sampleRate )
+{
+	if ( c->clockFreq == clockFreq && c->sampleRate == sampleRate )
+		return;
+
+	u64 cps = ( (u64)clockFreq << 32 ) / (u64)sampleRate;
+	c->clockFreq = clockFreq;
+	c->sampleRate = sampleRate;
+	c->cyclesPerSample = cps >> 32;
+	c->cyclesPerSampleFrac = cps & 0xffffffff;
+}
+
+// advances to the next sample boundary
+static inline void audioClockNextSample( AUDIO_SAMPLE_CLOCK *c )
+{
+	u32 p = c->phase + c->cyclesPerSampleFrac;
+	c->position += c->cyclesPerSample + ( p < c->phase ? 1 : 0 );
+	c->phase = p;
+	c->nextSample = c->position + ( p ? 1 : 0 );
+	c->samplesElapsed ++;
+}
+
+// restarts at cycle 0 (the 1st sample is ready after one sample period)
+static inline void audioClockInit( AUDIO_SAMPLE_CLOCK *c, u32 clockFreq, u32 sampleRate )
+{
+	c->clockFreq = c->sampleRate = 0;
+	audioClockSetRate( c, clockFreq, sampleRate );
+	c->position = 0;
+	c->phase = 0;
+	audioClockNextSample( c );
+	c->samplesElapsed = 0;
+}
+
+// for the PWM output in the FIQ handlers: returns 1 once for every sample boundary passed by 'cycle',
+// a counter which went backwards (C64 reset) restarts the clock
+static inline u32 audioClockPoll( AUDIO_SAMPLE_CLOCK *c, u64 cycle )
+{
+	if ( c->sampleRate == 0 )
+		return 0;
+
+	if ( cycle + c->cyclesPerSample + 1 < c->nextSample )
+	{
+		audioClockInit( c, c->clockFreq, c->sampleRate );
+		return 0;
+	}
+
+	if ( cycle < c->nextSample )
+		return 0;
+
+	audioClockNextSample( c );
+	return 1;
+}
+
+//
+// Emulates until the next sample is ready or 'cycleLimit' is reached.
+// Returns 1 if a sample is ready (the caller then reads the outputs of the sources and mixes), 0 otherwise.
+//
+// The sources are given by 'S' which provides
+//   u32  nextEvent( u64 *time )    returns 1 if an event (register write etc.) is pending and its time
+//   void applyEvent()              applies the pending event and removes it
+//   void clock( u32 cycles )       clocks all sources which are not rendered per sample
+// 'maxStep' is the read-back deadline, i.e. the longest step clock() is called with.
+//
+template <class S>
+static inline u32 audioEmulateToNextSample( S &s, AUDIO_SAMPLE_CLOCK *c, unsigned long long &nCyclesEmulated, unsigned long long cycleLimit, u32 maxStep )
+{
+	u64 t = 0;
+
+	while ( true )
+	{
+		while ( s.nextEvent( &t ) && nCyclesEmulated >= t )
+			s.applyEvent();
+
+		if ( nCyclesEmulated >= c->nextSample )
+		{
+			audioClockNextSample( c );
+			return 1;
+		}
+
+		if ( nCyclesEmulated >= cycleLimit )
+			return 0;
+
+		u64 next = c->nextSample;
+		if ( cycleLimit < next )
+			next = cycleLimit;
+		if ( s.nextEvent( &t ) && t < next )
+			next = t;
+
+		u32 cycles = ( next - nCyclesEmulated > (u64)maxStep ) ? maxStep : (u32)( next - nCyclesEmulated );
+
+		s.clock( cycles );
+		nCyclesEmulated += cycles;
+	}
+}
+
+#endif
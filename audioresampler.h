@@ -0,0 +1,173 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ audioresampler.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - asynchronous sample rate conversion with drift compensation for the HDMI output
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _audioresampler_h
+#define _audioresampler_h
+
+#include <circle/types.h>
+
+//
+// Asynchronous sample rate conversion for the HDMI output of kernel_sid.cpp (and HDMISim)
+//
+// The emulation renders at a fixed rate derived from the measured C64 clock (see audioengine.h), while the HDMI
+// audio runs from the clock of the RPi. Both drift apart slowly, which the resampler compensates: every input frame
+// is followed by zero, one or two output frames, interpolated (4-point cubic Hermite) at a fractional position
+// between the 2nd and 3rd newest input frame, i.e. with a delay of 2 frames. The ratio of input frames per output
+// frame comes from a PI controller on the occupancy of the output queue (frames rendered but not yet sent to the
+// GPU), measured whenever the sound device asks for data: the integral term follows the clock drift, the
+// proportional term pulls the occupancy to the target latency. As the device takes its data in chunks and the main
+// loop renders in bursts, the occupancy error is smoothed before.
+//
+
+#define AUDIO_RESAMPLER_MAX_OUT		2			// output frames per input frame at most
+
+#define AUDIO_RATE_BANDWIDTH		0.05f		// natural frequency of the control loop in Hz
+#define AUDIO_RATE_DAMPING			1.0f
+#define AUDIO_RATE_SMOOTHING		0.25f		// time constant of the error smoothing in seconds
+#define AUDIO_RATE_MAX_CORRECTION	0.005f		// at most 0.5% faster or slower than the input (about 9 cents)
+
+typedef struct
+{
+	float x[ 4 ][ 2 ];		// the latest 4 input frames, the newest one is x[ ( n - 1 ) & 3 ]
+	u32 n;
+	u64 pos, step;			// position of the next output frame after the 3rd newest input frame and the input
+							// frames per output frame (both 32.32 fixed point)
+} AUDIO_RESAMPLER;
+
+typedef struct
+{
+	float target;			// occupancy in frames
+	float sampleRate;
+	float kp, ki;
+	float error;			// smoothed occupancy error in frames
+	float integral;			// the integral term, i.e. the estimated relative drift
+	float correction;		// current output of the controller
+	u32 nUpdates;
+} AUDIO_RATE_CONTROL;
+
+static inline void audioResamplerInit( AUDIO_RESAMPLER *r )
+{
+	for ( u32 i = 0; i < 4; i++ )
+		r->x[ i ][ 0 ] = r->x[ i ][ 1 ] = 0.0f;
+	r->n = 0;
+	r->pos = 0;
+	r->step = 1ULL << 32;
+}
+
+// 'ratio' = input frames per output frame
+static inline void audioResamplerSetRatio( AUDIO_RESAMPLER *r, float ratio )
+{
+	r->step = (u64)( (double)ratio * 4294967296.0 );
+}
+
+static inline s16 audioResamplerClip( float v )
+{
+	if ( v > 32767.0f ) return 32767;
+	if ( v < -32768.0f ) return -32768;
+	return (s16)v;
+}
+
+// adds one input frame, writes the output frames (interleaved left/right) to 'out' and returns their number
+static inline u32 audioResamplerPut( AUDIO_RESAMPLER *r, s32 left, s32 right, s16 *out )
+{
+	u32 i = r->n ++ & 3;
+	r->x[ i ][ 0 ] = (float)left;
+	r->x[ i ][ 1 ] = (float)right;
+
+	const float *xm1 = r->x[ ( i + 1 ) & 3 ], *x0 = r->x[ ( i + 2 ) & 3 ], *x1 = r->x[ ( i + 3 ) & 3 ], *x2 = r->x[ i ];
+
+	u32 nOut = 0;
+	while ( r->pos < ( 1ULL << 32 ) )
+	{
+		float t = (float)(u32)r->pos * ( 1.0f / 4294967296.0f );
+
+		for ( u32 c = 0; c < 2; c++ )
+		{
+			float c1 = 0.5f * ( x1[ c ] - xm1[ c ] );
+			float c2 = xm1[ c ] - 2.5f * x0[ c ] + 2.0f * x1[ c ] - 0.5f * x2[ c ];
+			float c3 = 0.5f * ( x2[ c ] - xm1[ c ] ) + 1.5f * ( x0[ c ] - x1[ c ] );
+			*out ++ = audioResamplerClip( ( ( c3 * t + c2 ) * t + c1 ) * t + x0[ c ] );
+		}
+
+		nOut ++;
+		r->pos += r->step;
+	}
+	r->pos -= 1ULL << 32;
+
+	return nOut;
+}
+
+// 'targetFrames' is the occupancy the controller keeps, 'sampleRate' the nominal rate of input and output
+static inline void audioRateControlInit( AUDIO_RATE_CONTROL *c, u32 targetFrames, u32 sampleRate )
+{
+	// the occupancy changes with sampleRate * ( drift - correction ) frames per second, the gains place both poles
+	// of the closed loop at the given natural frequency and damping
+	const float omega = 2.0f * 3.14159265f * AUDIO_RATE_BANDWIDTH;
+
+	c->target = (float)targetFrames;
+	c->sampleRate = (float)sampleRate;
+	c->kp = 2.0f * AUDIO_RATE_DAMPING * omega / c->sampleRate;
+	c->ki = omega * omega / c->sampleRate;
+	c->error = c->integral = c->correction = 0.0f;
+	c->nUpdates = 0;
+}
+
+// 'occupancy' is the number of frames in the output queue, 'elapsed' the number of input frames since the last
+// update; returns the ratio for audioResamplerSetRatio()
+static inline float audioRateControlUpdate( AUDIO_RATE_CONTROL *c, u32 occupancy, u32 elapsed )
+{
+	float dt = (float)elapsed / c->sampleRate;
+	float e = (float)occupancy - c->target;
+
+	// the first measurement initializes the smoothing
+	if ( c->nUpdates ++ == 0 )
+		c->error = e; else
+		c->error += dt / ( dt + AUDIO_RATE_SMOOTHING ) * ( e - c->error );
+
+	// anti windup: the integral only changes if the output is not at its limit (or moves away from it)
+	float integral = c->integral + c->ki * c->error * dt;
+	float u = c->kp * c->error + integral;
+
+	if ( u > AUDIO_RATE_MAX_CORRECTION )
+	{
+		u = AUDIO_RATE_MAX_CORRECTION;
+		if ( integral < c->integral ) c->integral = integral;
+	} else
+	if ( u < -AUDIO_RATE_MAX_CORRECTION )
+	{
+		u = -AUDIO_RATE_MAX_CORRECTION;
+		if ( integral > c->integral ) c->integral = integral;
+	} else
+		c->integral = integral;
+
+	c->correction = u;
+	return 1.0f + u;
+}
+
+#endif
@@ -0,0 +1,415 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ buschain.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - bus device chains composed into FIQ handlers
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _buschain_h
+#define _buschain_h
+
+#include <circle/types.h>
+#include "gpio_defs.h"
+
+//
+// Bus device chain: a FIQ handler is composed at compile time from a list of devices (kernal replacement, GeoRAM,
+// cartridge ROM, launcher, SID capture, ...). For every bus cycle the devices are asked in the order of the list,
+// the first one whose address match succeeds serves the cycle. All calls are inlined, there is no runtime dispatch:
+//
+//   static BUSCHAIN_COUNTERS counters;
+//   static BUSDEV_GEORAM geoRAM;
+//   m_InputPin.ConnectInterrupt( busChainFIQ< &counters, CDevKernal< kernalROM >, CDevGeoRAM< &geoRAM > >, 0 );
+//
+// A device is a class with the static members (BUS is CBusFIQ on the RPi, or the replay bus of the host tools)
+//   void prefetch( BUS &b )	called while the multiplexers switch (only A0-A7, RW, RESET, CS are known)
+//   u32  match( BUS &b )		returns 1 if the device handles this cycle (all signals are known)
+//   u32  read( BUS &b )		returns the byte for the CPU (if match returned 1 and the CPU reads)
+//   void write( BUS &b )		handles a write (if match returned 1), the data has to be read with b.get() if needed
+//   void after( BUS &b )		called after the bus has been released (if the device handled the cycle)
+//
+
+// for the main loop (e.g. TEST_FOR_JUMP_TO_MAINMENU)
+typedef struct
+{
+	u64 c64CycleCount;
+	u32 resetCounter;
+} BUSCHAIN_COUNTERS;
+
+// the signals of one bus cycle as read from the GPIOs (same as the macros in helpers.h)
+class CBusCycle
+{
+public:
+	u32 g2, g3;
+	u64 c64Cycle;
+	u32 resetCounter;
+
+	inline u32 io1()			{ return !( g3 & bIO1 ); }
+	inline u32 io2()			{ return !( g3 & bIO2 ); }
+	inline u32 roml()			{ return !( g3 & bROML ); }
+	inline u32 romh()			{ return !( g3 & bROMH ); }
+	inline u32 kernal()			{ return !( g3 & bCS ); }
+	inline u32 sid()			{ return !( g2 & bCS ); }
+	inline u32 cpuReads()		{ return g2 & bRW; }
+	inline u32 cpuWrites()		{ return !( g2 & bRW ); }
+	inline u32 reset()			{ return !( g2 & bRESET ); }
+	inline u32 addrIO()			{ return ( g2 >> A0 ) & 255; }
+	inline u32 addr()			{ return ( ( g2 >> A0 ) & 255 ) | ( ( ( g3 >> A8 ) & 31 ) << 8 ); }
+	inline u32 addrCacheOpt()	{ return ( ( ( g2 >> A0 ) & 255 ) << 5 ) | ( ( g3 >> A8 ) & 31 ); }	// as GET_ADDRESS_CACHEOPT
+};
+
+#ifndef BUSCHAIN_HOST
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+#include "lowlevel_arm64.h"
+#include "latch.h"
+#include "helpers.h"
+
+// the bus as seen from the FIQ handler, the timing is the one of START_AND_READ_ADDR0to7_RW_RESET_CS etc.
+class CBusFIQ : public CBusCycle
+{
+public:
+	u64 armCycleCounter;
+
+	__attribute__( ( always_inline ) ) inline void start()
+	{
+		RESTART_CYCLE_COUNTER
+		WAIT_UP_TO_CYCLE( WAIT_FOR_SIGNALS );
+		g2 = read32( ARM_GPIO_GPLEV0 );
+		write32( ARM_GPIO_GPSET0, bCTRL257 );
+	}
+
+	__attribute__( ( always_inline ) ) inline void readRest()
+	{
+		WAIT_UP_TO_CYCLE( WAIT_CYCLE_MULTIPLEXER );
+		g3 = read32( ARM_GPIO_GPLEV0 );
+	}
+
+	__attribute__( ( always_inline ) ) inline void put( u32 D )				{ WRITE_D0to7_TO_BUS( D ) }
+	__attribute__( ( always_inline ) ) inline u32  get()					{ register u32 D; READ_D0to7_FROM_BUS( D ) return D; }
+	__attribute__( ( always_inline ) ) inline void finish()					{ FINISH_BUS_HANDLING }
+	__attribute__( ( always_inline ) ) inline void finishLatch()				{ OUTPUT_LATCH_AND_FINISH_BUS_HANDLING }
+	__attribute__( ( always_inline ) ) inline void setClr( u32 set, u32 clr )	{ SETCLR_GPIO( set, clr ) }
+	__attribute__( ( always_inline ) ) inline void set( u32 set )				{ SET_GPIO( set ) }
+	__attribute__( ( always_inline ) ) inline void clr( u32 clr )				{ CLR_GPIO( clr ) }
+	__attribute__( ( always_inline ) ) inline void setLED( u32 f )			{ setLatchFIQ( f ); }
+	__attribute__( ( always_inline ) ) inline void clrLED( u32 f )			{ clrLatchFIQ( f ); }
+	__attribute__( ( always_inline ) ) inline void waitTriggerDMA()			{ WAIT_UP_TO_CYCLE( WAIT_TRIGGER_DMA ); }
+	__attribute__( ( always_inline ) ) inline void waitReleaseDMA()			{ WAIT_UP_TO_CYCLE( WAIT_RELEASE_DMA ); }
+	__attribute__( ( always_inline ) ) inline void preloadL1( const void *p )	{ CACHE_PRELOADL1STRM( p ); }
+	__attribute__( ( always_inline ) ) inline void preloadL2( const void *p )	{ CACHE_PRELOADL2KEEP( p ); }
+	__attribute__( ( always_inline ) ) inline void preloadL2Strm( const void *p )	{ CACHE_PRELOADL2STRM( p ); }
+	__attribute__( ( always_inline ) ) inline void preloadBank( const void *p )	{ CACHE_PRELOAD_DATA_CACHE( p, 8192, CACHE_PRELOADL2STRM ) }
+
+	// used by the host tools to count the address matches, nothing to do here
+	__attribute__( ( always_inline ) ) inline void probe()					{}
+};
+#endif
+
+//
+// the chain
+//
+template <class... DEVS> class CBusChain;
+
+template <> class CBusChain<>
+{
+public:
+	enum { nDevices = 0 };
+	template <class BUS> static inline void prefetch( BUS &b ) {}
+	template <class BUS> static inline u32 access( BUS &b ) { return 0; }
+};
+
+template <class DEV, class... REST> class CBusChain<DEV, REST...>
+{
+public:
+	enum { nDevices = 1 + sizeof...( REST ) };
+
+	template <class BUS> __attribute__( ( always_inline ) ) static inline void prefetch( BUS &b )
+	{
+		DEV::prefetch( b );
+		CBusChain<REST...>::prefetch( b );
+	}
+
+	template <class BUS> __attribute__( ( always_inline ) ) static inline u32 access( BUS &b )
+	{
+		b.probe();
+		if ( DEV::match( b ) )
+		{
+			if ( b.cpuReads() )
+				b.put( DEV::read( b ) ); else
+				DEV::write( b );
+			b.finish();
+			DEV::after( b );
+			return 1;
+		}
+		return CBusChain<REST...>::access( b );
+	}
+};
+
+// one bus cycle: the FIQ handler of a chain on the RPi, or called by the host tools with a replay bus,
+// returns 1 if a device handled the cycle
+template <class BUS, BUSCHAIN_COUNTERS *C, class... DEVS>
+__attribute__( ( always_inline ) ) inline u32 busChainCycle( BUS &b )
+{
+	b.start();
+
+	C->c64CycleCount ++;
+	if ( b.reset() )
+		C->resetCounter ++; else
+		C->resetCounter = 0;
+	b.c64Cycle = C->c64CycleCount;
+	b.resetCounter = C->resetCounter;
+
+	CBusChain<DEVS...>::prefetch( b );
+
+	b.readRest();
+
+	if ( CBusChain<DEVS...>::access( b ) )
+		return 1;
+
+	b.finish();
+	return 0;
+}
+
+#ifndef BUSCHAIN_HOST
+template <BUSCHAIN_COUNTERS *C, class... DEVS>
+void busChainFIQ( void *pParam )
+{
+	CBusFIQ b;
+	busChainCycle< CBusFIQ, C, DEVS... >( b );
+}
+#endif
+
+//
+// devices
+//
+class CDevNone
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b ) {}
+	template <class BUS> static inline void after( BUS &b ) {}
+};
+
+// kernal replacement (the latch has to be set up with LATCH_ENABLE_KERNAL), as kernel_kernal.cpp
+template <u8 *ROM>
+class CDevKernal : public CDevNone
+{
+public:
+	template <class BUS> static inline u32 match( BUS &b )	{ return b.cpuReads() && b.romh() && b.kernal(); }
+	template <class BUS> static inline u32 read( BUS &b )	{ return ROM[ b.addr() ]; }
+	template <class BUS> static inline void write( BUS &b )	{}
+};
+
+// GeoRAM/NeoRAM: 256 byte window in IO1, the registers in IO2 (A0 = 0: page, A0 = 1: 16k block), as kernel_georam.cpp
+typedef struct
+{
+	u8  reg[ 2 ];
+	u8  *RAM;
+	u32 sizeKB;
+} BUSDEV_GEORAM;
+
+template <BUSDEV_GEORAM *S>
+class CDevGeoRAM : public CDevNone
+{
+public:
+	static inline u8 *window()	{ return &S->RAM[ S->reg[ 1 ] * 16384 + S->reg[ 0 ] * 256 ]; }
+
+	template <class BUS> static inline void prefetch( BUS &b )
+	{
+		u8 *w = window();
+		b.preloadL1( &w[ 0 ] );   b.preloadL1( &w[ 64 ] );
+		b.preloadL1( &w[ 128 ] ); b.preloadL1( &w[ 192 ] );
+	}
+
+	template <class BUS> static inline u32 match( BUS &b )	{ return b.io1() || b.io2(); }
+
+	template <class BUS> static inline u32 read( BUS &b )
+	{
+		if ( b.io1() )
+			return window()[ b.addrIO() ];
+		return b.addrIO() < 2 ? S->reg[ b.addrIO() & 1 ] : 0;
+	}
+
+	template <class BUS> static inline void write( BUS &b )
+	{
+		u32 D = b.get();
+		if ( b.io1() )
+			window()[ b.addrIO() ] = D; else
+		if ( b.addrIO() & 1 )
+			S->reg[ 1 ] = D & ( ( S->sizeKB / 16 ) - 1 ); else
+			S->reg[ 0 ] = D & 63;
+	}
+};
+
+// cartridge ROM with 8k (ROML) or 16k (ROML+ROMH) banks, the bank is selected by writing to $de00
+// (normal and Ocean type cartridges), bank b is stored at rom[ b * 16384 ] (ROML) and rom[ b * 16384 + 8192 ] (ROMH)
+typedef struct
+{
+	u8  *rom;
+	u32 bank, bankMask;
+} BUSDEV_CRT;
+
+template <BUSDEV_CRT *S>
+class CDevCRT : public CDevNone
+{
+public:
+	template <class BUS> static inline u32 match( BUS &b )
+	{
+		return ( b.cpuReads() && ( b.roml() || b.romh() ) ) || ( b.cpuWrites() && b.io1() && b.addrIO() == 0 );
+	}
+
+	template <class BUS> static inline u32 read( BUS &b )	{ return S->rom[ S->bank * 16384 + ( b.romh() ? 8192 : 0 ) + b.addr() ]; }
+	template <class BUS> static inline void write( BUS &b )	{ S->bank = b.get() & S->bankMask; }
+};
+
+// SID register writes are stored with their cycle in a ring buffer (as in kernel_sid.cpp), reads are not served
+typedef struct
+{
+	u32 *ringBuf;
+	u64 *ringTime;
+	u32 ringWrite, ringMask;
+} BUSDEV_SIDCAPTURE;
+
+template <BUSDEV_SIDCAPTURE *S>
+class CDevSIDCapture : public CDevNone
+{
+public:
+	template <class BUS> static inline u32 match( BUS &b )	{ return b.cpuWrites() && b.sid(); }
+	template <class BUS> static inline u32 read( BUS &b )	{ return 0; }
+
+	template <class BUS> static inline void write( BUS &b )
+	{
+		u32 D = b.get();
+		S->ringBuf[ S->ringWrite ] = ( b.g2 & A_FLAG ) | ( D << D0 );
+		S->ringTime[ S->ringWrite ] = b.c64Cycle;
+		S->ringWrite = ( S->ringWrite + 1 ) & S->ringMask;
+	}
+};
+
+// the .PRG launcher (protocol of LAUNCH_FIQ in launch.h): the launch code is visible in ROML, the .PRG is read byte
+// by byte from $de00 (or 8k blocks selected with $de03 are visible in ROML), writing 123 to $df00 disables the cartridge.
+// A reset (longer than 3 cycles) enables it again
+typedef struct
+{
+	u8  *prgData, *launchCode;
+	u32 prgSizeBelowA000, prgSizeAboveA000, prgPages, prgLastPage;
+	u32 currentOfs, transferPart, romlWindow, romlFirstPage;
+	u32 disableCart, ultimaxDisabled;
+	u32 configSet, configClr;		// GAME/EXROM while the cartridge is active
+	u32 nextByte;
+} BUSDEV_LAUNCH;
+
+template <BUSDEV_LAUNCH *S>
+class CDevLaunch
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b )
+	{
+		if ( b.resetCounter > 3 && ( S->disableCart || S->ultimaxDisabled ) )
+		{
+			S->disableCart = S->ultimaxDisabled = 0;
+			b.setClr( S->configSet | bNMI, S->configClr );
+		}
+	}
+
+	template <class BUS> static inline u32 match( BUS &b )
+	{
+		return !S->disableCart && ( b.io1() || ( b.cpuWrites() && b.io2() ) || ( b.cpuReads() && b.roml() ) );
+	}
+
+	template <class BUS> static inline u32 read( BUS &b )
+	{
+		if ( b.roml() )
+		{
+			if ( S->romlWindow )
+			{
+				u32 a = b.addr(), p = S->romlFirstPage + ( a >> 8 );
+				if ( p > S->prgLastPage ) p = S->prgLastPage;
+				return S->prgData[ 2 + ( p << 8 ) + ( a & 255 ) ];
+			}
+			return S->launchCode[ b.addr() ];
+		}
+
+		switch ( b.addrIO() )
+		{
+		case 3:
+			return S->prgPages;
+		case 1:
+			return ( ( S->transferPart == 1 ? S->prgSizeAboveA000 : S->prgSizeBelowA000 ) + 255 ) >> 8;
+		default:
+			S->currentOfs ++;
+			return S->nextByte;
+		}
+	}
+
+	template <class BUS> static inline void write( BUS &b )
+	{
+		if ( b.io2() )
+		{
+			u32 D = b.get();
+			if ( b.addrIO() == 0 && D == 1 )
+			{
+				b.setClr( bGAME | bEXROM | bNMI, 0 );
+				S->ultimaxDisabled = 1;
+			} else
+			if ( b.addrIO() == 0 && D == 123 )
+			{
+				b.setClr( bGAME | bEXROM | bNMI, 0 );
+				S->disableCart = 1;
+			}
+			return;
+		}
+
+		switch ( b.addrIO() )
+		{
+		case 3:
+			S->romlFirstPage = b.get();
+			S->romlWindow = 1;
+			break;
+		case 4:
+			S->romlWindow = 0;
+			break;
+		case 2:
+			S->currentOfs = S->prgSizeBelowA000 + 2;
+			S->transferPart = 1;
+			break;
+		default:
+			S->currentOfs = 0;
+			S->transferPart = 0;
+			break;
+		}
+	}
+
+	// fetch the next byte while the C64 is busy with something else
+	template <class BUS> static inline void after( BUS &b )
+	{
+		if ( b.io1() )
+		{
+			b.preloadL2( &S->prgData[ S->currentOfs ] );
+			S->nextByte = S->prgData[ S->currentOfs ];
+		}
+	}
+};
+
+#endif
@@ -35,9 +35,12 @@
 #include "c64screen.h"
 #include "lowlevel_arm64.h"
 #include "dirscan.h"
+#include "dirindex.h"
 #include "config.h"
 #include "crt.h"
 #include "kernel_menu.h"
+#include "calibration.h"
+#include "imagecache.h"
 #include "PSID/psid64/psid64.h"
 
 const int VK_AT = 64;
@@ -106,7 +109,7 @@ u8 c64color[ 40 * 25 + 1024 * 4 ];
 boolean errorSticky = false;
 char *errorMsg = NULL;
 
-char errorMessages[8][41] = {
+char errorMessages[11][41] = {
 //   1234567890123456789012345678901234567890
 	"                NO ERROR                ",
 	"  ERROR: UNKNOWN/UNSUPPORTED .CRT TYPE  ",
@@ -116,6 +119,9 @@ char errorMessages[8][41] = {
 	"         WRONG SYSTEM, NO C128!         ",
 	"         SID-WIRE NOT DETECTED!         ",
 	"         DISK2EASYFLASH FAILED!         ",
+	"   TIMING CALIBRATION, PLEASE WAIT...   ",
+	"    TIMING CALIBRATED, PROFILE SAVED    ",
+	"       TIMING CALIBRATION FAILED!       ",
 };
 
 /*char *extraMsg = NULL;
@@ -625,6 +631,51 @@ void snapJoy( int dir )
 		joyIdx = oldJoyIdx;
 }
 
+// path of an entry in dir[], for files in a .D64 this is the path of the disk image
+static void getEntryPath( s32 c, char *path )
+{
+	s32 n = 0;
+	u32 nodes[ 256 ];
+
+	nodes[ n ++ ] = c;
+	while ( dir[ c ].parent != 0xffffffff )
+		c = nodes[ n ++ ] = dir[ c ].parent;
+
+	s32 stopPath = ( dir[ nodes[ 0 ] ].f & DIR_FILE_IN_D64 ) ? 1 : 0;
+
+	strcpy( path, "SD:" );
+	for ( s32 i = n - 1; i >= stopPath; i -- )
+	{
+		if ( i != n-1 )
+			strcat( path, "\\" );
+		strcat( path, (char*)dir[ nodes[i] ].name );
+	}
+}
+
+// time the cursor has to rest on an entry before its image is read into the cache (in microseconds)
+#define PREFETCH_DELAY	250000
+
+static u64 prefetchKeyTime = 0;
+static u32 prefetchPending = 0;
+
+// called from the main loop while there is nothing else to do
+void prefetchBrowserEntry()
+{
+	if ( !prefetchPending || menuScreen != MENU_BROWSER || typeInName || CTimer::GetClockTicks() - prefetchKeyTime < PREFETCH_DELAY )
+		return;
+
+	prefetchPending = 0;
+
+	if ( cursorPos < 0 || cursorPos >= nDirEntries ||
+		 !( dir[ cursorPos ].f & ( DIR_PRG_FILE | DIR_CRT_FILE | DIR_SID_FILE | DIR_D64_FILE | DIR_FILE_IN_D64 ) ) )
+		return;
+
+	char path[ 8192 ];
+	getEntryPath( cursorPos, path );
+
+	imageCachePrefetch( logger, DRIVE, path );
+}
+
 // ugly, hard-coded handling of UI
 void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal, char *menuItemStr, u32 *startC128 = NULL )
 {
@@ -634,6 +685,9 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 
 	lastKeyDebug = k;
 
+	prefetchKeyTime = CTimer::GetClockTicks();
+	prefetchPending = 1;
+
 	if ( menuScreen == MENU_MAIN )
 	{
 		if ( k == VK_SHIFT_RETURN )
@@ -1080,8 +1134,7 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 		{
 			int found = -1;
 			int searchPos = cursorPos;
-			int c, l, ls;
-			char name[512], search[32];
+			int c;
 
 			int key = k;
 			if ( key >= 'a' && key <= 'z' )
@@ -1121,24 +1174,9 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 						typeCurPos ++; 
 				}
 
-				ls = min( 32, strlen( (const char*)searchName ) );
-				for ( int i = 0; i < ls; i++ )
-					search[ i ] = convChar( searchName[ i ], 3);
-
-				while ( found == -1 && searchPos < nDirEntries && searchPos >= 0)
-				{
-					// convert name for search
-					memset( name, 0, 512 );
-					l = min( ls, (int)strlen( (const char*)dir[ searchPos ].name ) );
-					for ( c = 0; c < l; c++ )
-					{
-						if ( search[ c ] != convChar( dir[ searchPos ].name[ c ], 3 ) )
-							break;
-					}
-					if ( c == l )
-						found = searchPos; else
-						searchPos += (k == VIRTK_SEARCH_UP) ? -1 : 1;
-				}
+				// names starting with the search string are preferred, otherwise any name containing it
+				dirIndexSearch( (const char*)searchName );
+				found = dirIndexFind( searchPos, (k == VIRTK_SEARCH_UP) ? -1 : 1 );
 				if ( found != -1 )
 				{
 					cursorPos = scrollPos = found;
@@ -1218,38 +1256,21 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 				// build path
 				char path[ 8192 ] = {0};
 				char d64file[ 128 ] = {0};
-				s32 n = 0, c = cursorPos;
+				s32 c = cursorPos;
 				u32 fileIndex = 0xffffffff;
-				u32 nodes[ 256 ];
-
-				nodes[ n ++ ] = c;
 
 				s32 curC = c;
 
 				if ( (dir[ c ].f & DIR_FILE_IN_D64 && ((dir[ c ].f>>SHIFT_TYPE)&7) == 2) || dir[ c ].f & DIR_PRG_FILE || dir[ c ].f & DIR_CRT_FILE || dir[ c ].f & DIR_BIN_FILE )
 				{
-					while ( dir[ c ].parent != 0xffffffff )
-					{
-						//logger->Write( "exec", LogNotice, "node %d: '%s'", dir[c].parent, dir[dir[c].parent].name );
-						c = nodes[ n ++ ] = dir[ c ].parent;
-					}
-
-					int stopPath = 0;
 					if ( dir[ cursorPos ].f & DIR_FILE_IN_D64 )
 					{
 						//logger->Write( "exec", LogNotice, "d64file: '%s'", dir[ cursorPos ].name[128] );
 						strcpy( d64file, (char*)&dir[ cursorPos ].name[128] );
 						fileIndex = dir[ cursorPos ].f & ((1<<SHIFT_TYPE)-1);
-						stopPath = 1;
 					}
 
-					strcat( path, "SD:" );
-					for ( s32 i = n - 1; i >= stopPath; i -- )
-					{
-						if ( i != n-1 )
-							strcat( path, "\\" );
-						strcat( path, (char*)dir[ nodes[i] ].name );
-					}
+					getEntryPath( c, path );
 
 
 					if ( dir[ curC ].f & DIR_PRG_FILE ) 
@@ -1320,26 +1341,14 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 							menuScreen = MENU_ERROR;
 						} else
 						{
-							extern u8 d64buf[ 1024 * 1024 ];
-							extern int readD64File( CLogger *logger, const char *DRIVE, const char *FILENAME, u8 *data, u32 *size );
-
+							u8 *img;
 							u32 imgsize = 0;
-#ifndef WITH_NET
-							// mount file system
-							FATFS m_FileSystem;
-							if ( f_mount( &m_FileSystem, DRIVE, 1 ) != FR_OK )
-								logger->Write( "RaspiMenu", LogPanic, "Cannot mount drive: %s", DRIVE );
-#endif
+
 							//logger->Write( "exec", LogNotice, "path '%s'", path );
-							if ( !readD64File( logger, "", path, d64buf, &imgsize ) )
+							if ( !imageCacheLoad( logger, DRIVE, path, &img, &imgsize ) )
 								return;
 
-#ifndef WITH_NET
-							// unmount file system
-							if ( f_mount( 0, DRIVE, 0 ) != FR_OK )
-								logger->Write( "RaspiMenu", LogPanic, "Cannot unmount drive: %s", DRIVE );
-#endif
-							if ( d64ParseExtract( d64buf, imgsize, D64_GET_FILE + fileIndex, prgDataLaunch, (s32*)&prgSizeLaunch ) == 0 )
+							if ( d64ParseExtract( img, imgsize, D64_GET_FILE + fileIndex, prgDataLaunch, (s32*)&prgSizeLaunch ) == 0 )
 							{
 								strcpy( FILENAME, path );
 								//logger->Write( "RaspiMenu", LogNotice, "loaded: %d bytes", prgSizeLaunch );
@@ -1354,20 +1363,7 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 
 				if ( dir[ c ].f & DIR_SID_FILE  )
 				{
-					while ( dir[ c ].parent != 0xffffffff )
-					{
-						c = nodes[ n ++ ] = dir[ c ].parent;
-					}
-
-					int stopPath = 0;
-
-					strcat( path, "SD:" );
-					for ( s32 i = n - 1; i >= stopPath; i -- )
-					{
-						if ( i != n-1 )
-							strcat( path, "\\" );
-						strcat( path, (char*)dir[ nodes[i] ].name );
-					}
+					getEntryPath( c, path );
 					logger->Write( "exec", LogNotice, "sid file: '%s'", path );
 
 					if ( ( subSID && octaSIDMode && !wireSIDAvailable ) ||
@@ -1378,10 +1374,10 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 						menuScreen = MENU_ERROR;
 					} else
 					{
-						unsigned char sidData[ 65536 ];
+						u8 *sidData = NULL;
 						u32 sidSize = 0;
 
-						if ( readFile( logger, DRIVE, path, sidData, &sidSize ) )
+						if ( imageCacheLoad( logger, DRIVE, path, &sidData, &sidSize ) )
 						{
 							logger->Write( "exec", LogNotice, "bytes: '%d'", sidSize );
 						}
@@ -1660,6 +1656,15 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 			previousMenuScreen = menuScreen;
 			menuScreen = MENU_ERROR;
 		}
+		if( (k == 't' || k == 'T') && typeInName == 0 && !calibActive )
+		{
+			// append the calibration loop to the code the C64 executes after fetching the screen
+			requestTimingCalibration();
+			injectTimingCalibration();
+			errorMsg = errorMessages[ 8 ];
+			previousMenuScreen = menuScreen;
+			menuScreen = MENU_ERROR;
+		}
 
 		applySIDSettings();
 	} else
@@ -2124,10 +2129,11 @@ void printSettingsScreen()
 	clearC64();
 	//               "012345678901234567890123456789012345XXXX"
 	printC64( 0,  1, "   .- Sidekick64 -- Frenetic -.         ", skinValues.SKIN_MENU_TEXT_HEADER, 0 );
-	printC64( 0, 23, "    F5 Back to Menu, S Save Settings    ", skinValues.SKIN_MENU_TEXT_HEADER, 0 );
+	printC64( 0, 23, "  F5 Back to Menu, S Save, T Calibrate  ", skinValues.SKIN_MENU_TEXT_HEADER, 0 );
 	//               "012345678901234567890123456789012345XXXX"
-	printC64( 4, 23, "F5", skinValues.SKIN_MENU_TEXT_FOOTER, 128, 0 );
-	printC64( 21, 23, "S", skinValues.SKIN_MENU_TEXT_FOOTER, 128, 0 );
+	printC64( 2, 23, "F5", skinValues.SKIN_MENU_TEXT_FOOTER, 128, 0 );
+	printC64( 19, 23, "S", skinValues.SKIN_MENU_TEXT_FOOTER, 128, 0 );
+	printC64( 27, 23, "T", skinValues.SKIN_MENU_TEXT_FOOTER, 128, 0 );
 
 	s32 x = 1, x2 = 7,y1 = 1-1, y2 = 1-2;
 	s32 l = curSettingsLine;
@@ -2249,6 +2255,11 @@ void printSettingsScreen()
 
 	printSidekickLogo();
 
+	if ( activeTimingProfile >= 0 )
+		sprintf( t, "timing profile %s", timingProfileName[ activeTimingProfile ] ); else
+		sprintf( t, "timing profile default" );
+	printC64( ( 40 - strlen( t ) ) / 2, 24, t, skinValues.SKIN_MENU_TEXT_SYSINFO, 0 );
+
 	if ( !wireSIDAvailable )
 	{
 		for ( int i = 12 * 40; i < 20 * 40; i++ )
@@ -2263,6 +2274,11 @@ void printSettingsScreen()
 		injectPOKE( 53272, 23 ); 
 }
 
+void showTimingCalibrationResult( u32 result )
+{
+	setErrorMsg( errorMessages[ ( result == CALIB_OK ) ? 9 : 10 ] );
+}
+
 void clearErrorMsg()
 {
 	if ( errorMsg != NULL && menuScreen == MENU_ERROR)
@@ -45,6 +45,7 @@ extern void printC64( u32 x, u32 y, const char *t, u8 color, u8 flag = 0, u32 co
 extern void printBrowserScreen();
 extern void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal, char *menuItemStr, u32 *startForC128 );
 extern void renderC64();
+extern void prefetchBrowserEntry();
 extern void readSettingsFile();
 extern void applySIDSettings();
 extern void settingsGetGEORAMInfo( char *filename, u32 *size );
@@ -52,6 +53,7 @@ extern void setErrorMsg( char * msg );
 extern void setErrorMsg2( char * msg, boolean );
 extern void renderErrorMsg();
 extern void clearErrorMsg();
+extern void showTimingCalibrationResult( u32 result );
 #ifdef WITH_NET
 extern boolean isAutomaticScreenRefreshNeeded();
 #endif
@@ -0,0 +1,384 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ calibration.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - bus timing calibration and per-machine timing profiles
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <circle/util.h>
+#include <circle/logger.h>
+#include "lowlevel_arm64.h"
+#include "helpers.h"
+#include "config.h"
+#include "calibration.h"
+
+volatile u32 calibActive = 0, calibDone = 0, calibAck = 0;
+volatile u32 calibSamples = 0, calibErrors = 0;
+u32 calibPatternIdx = 0, calibLastServed = 0;
+u8  calibPattern[ 256 ] AA;
+
+u32 machineNTSC = 0;
+u32 machineClockMeasured = 0;
+int activeTimingProfile = -2;		// -2 = nothing applied yet, -1 = default values from the config file
+
+//
+// PAL/NTSC detection: PAL machines run at 985248 Hz, NTSC at 1022727 Hz
+//
+#define PHI2_MEASURE_TIME		250000		// in microseconds
+#define PHI2_NTSC_THRESHOLD		1004000
+
+static u32 phi2StartCycles;
+static u32 phi2StartTicks = 0;
+
+// returns 1 once the measurement is complete
+u32 timingMeasurePhi2( u32 phi2Cycles, u32 clockTicks )
+{
+	if ( machineClockMeasured )
+		return 0;
+
+	if ( phi2StartTicks == 0 )
+	{
+		phi2StartCycles = phi2Cycles;
+		phi2StartTicks = clockTicks;
+		return 0;
+	}
+
+	u32 dt = clockTicks - phi2StartTicks;
+	if ( dt < PHI2_MEASURE_TIME )
+		return 0;
+
+	u64 hz = (u64)( phi2Cycles - phi2StartCycles ) * 1000000 / dt;
+	machineNTSC = ( hz > PHI2_NTSC_THRESHOLD ) ? 1 : 0;
+	machineClockMeasured = 1;
+
+	return 1;
+}
+
+const char *getMachineTimingProfileName()
+{
+	if ( modeC128 )
+		return machineNTSC ? "C128_NTSC" : "C128_PAL";
+
+	if ( machineNTSC )
+		return modeVIC ? "C64_NTSC_NEWVIC" : "C64_NTSC_OLDVIC";
+
+	return modeVIC ? "C64_PAL_NEWVIC" : "C64_PAL_OLDVIC";
+}
+
+// selects the profile matching the detected machine (or the default timings), returns 1 if the timings changed
+u32 applyMachineTimingProfile()
+{
+	if ( calibActive || !machineClockMeasured )
+		return 0;
+
+	int p = getTimingProfile( getMachineTimingProfileName() );
+
+	if ( p == activeTimingProfile )
+		return 0;
+
+	if ( p >= 0 )
+		applyTimingValues( timingProfileValues[ p ] ); else
+		applyTimingValues( timingValues );
+
+	activeTimingProfile = p;
+
+	return 1;
+}
+
+//
+// pass window search
+//
+void sweepBegin( TIMING_SWEEP *s, s32 start, s32 step, s32 limitLo, s32 limitHi )
+{
+	s->start   = start;
+	s->step    = step;
+	s->limitLo = limitLo;
+	s->limitHi = limitHi;
+	s->cur     = start;
+	s->dir     = 1;
+	s->passLo  = s->passHi = -1;
+}
+
+// feed the result for the value 's->cur', returns 1 if another value needs to be tested (which is then in 's->cur')
+u32 sweepNext( TIMING_SWEEP *s, u32 passed )
+{
+	if ( passed )
+	{
+		if ( s->passLo < 0 )
+		{
+			s->passLo = s->passHi = s->cur;
+		} else
+		{
+			s->passLo = min( s->passLo, s->cur );
+			s->passHi = max( s->passHi, s->cur );
+		}
+	}
+
+	if ( s->dir == 1 )
+	{
+		if ( passed && s->cur + s->step <= s->limitHi )
+		{
+			s->cur += s->step;
+			return 1;
+		}
+
+		// the start value failed: there is no known good value to search from
+		if ( s->passLo < 0 )
+		{
+			s->dir = 0;
+			return 0;
+		}
+
+		s->dir = -1;
+		s->cur = s->start - s->step;
+		if ( s->cur < s->limitLo )
+		{
+			s->dir = 0;
+			return 0;
+		}
+		return 1;
+	}
+
+	if ( s->dir == -1 && passed && s->cur - s->step >= s->limitLo )
+	{
+		s->cur -= s->step;
+		return 1;
+	}
+
+	s->dir = 0;
+	return 0;
+}
+
+s32 sweepCenter( TIMING_SWEEP *s )
+{
+	if ( s->passLo < 0 )
+		return s->start;
+	return ( s->passLo + s->passHi ) / 2;
+}
+
+//
+// calibration state machine
+//
+// the C64 runs a loop reading a pattern byte from IO2 and writing it back (both go through the FIQ handler)
+// for each tested value we wait for a few transfers to settle and then require CALIB_SAMPLES error free ones
+//
+#define CALIB_SETTLE_SAMPLES	64
+#define CALIB_SAMPLES			4096
+#define CALIB_STEP				5
+#define CALIB_TIMEOUT			150000		// in microseconds, one transfer of the loop takes 17 cycles (+ badlines), CALIB_SAMPLES about 75ms
+#define CALIB_TIMEOUT_FIRST		2000000		// the C64 first needs to fetch the screen and start the loop
+#define CALIB_MAX_LOST			3
+
+#define CALIB_STATE_SETTLE		0
+#define CALIB_STATE_MEASURE		1
+
+// the values exercised by the IO2 read/write access in the menu FIQ handler
+#define CALIB_PARAMS 3
+static u32 *calibParamValue[ CALIB_PARAMS ] = { &WAIT_CYCLE_READ, &WAIT_CYCLE_WRITEDATA, &WAIT_CYCLE_MULTIPLEXER };
+static const int calibParamIndex[ CALIB_PARAMS ] = { 1, 2, 6 };
+
+static u32 calibRequested = 0;
+static u32 calibState, calibParam, calibLost;
+static u32 calibBaseSamples, calibBaseErrors;
+static u32 calibProbeStart, calibTimeout;
+static u32 calibOriginal[ CALIB_PARAMS ];
+static s32 calibWindow[ CALIB_PARAMS ][ 2 ];
+static TIMING_SWEEP sweep;
+
+void requestTimingCalibration()
+{
+	calibRequested = 1;
+}
+
+u32 timingCalibrationRequested()
+{
+	return calibRequested;
+}
+
+static void startProbe( u32 clockTicks )
+{
+	*calibParamValue[ calibParam ] = sweep.cur;
+	calibState = CALIB_STATE_SETTLE;
+	calibBaseSamples = calibSamples;
+	calibBaseErrors = calibErrors;
+	calibProbeStart = clockTicks;
+}
+
+static void startParam( u32 clockTicks )
+{
+	s32 v = *calibParamValue[ calibParam ];
+	s32 lo = 150, hi = 800;
+
+	// the address lines must be sampled before the data is put on/read from the bus
+	if ( calibParamValue[ calibParam ] == &WAIT_CYCLE_MULTIPLEXER )
+	{
+		lo = WAIT_FOR_SIGNALS + CALIB_STEP;
+		hi = min( WAIT_CYCLE_READ, WAIT_CYCLE_WRITEDATA ) - 50;
+	}
+
+	sweepBegin( &sweep, v, CALIB_STEP, lo, hi );
+	startProbe( clockTicks );
+}
+
+void beginTimingCalibration( u32 clockTicks )
+{
+	calibRequested = 0;
+
+	// a few patterns with many toggling bits first, then pseudo random values
+	const u8 fixed[ 8 ] = { 0x00, 0xff, 0x55, 0xaa, 0x0f, 0xf0, 0x33, 0xcc };
+	u32 lfsr = 0xace1;
+	for ( u32 i = 0; i < 256; i++ )
+	{
+		if ( i < 8 )
+			calibPattern[ i ] = fixed[ i ]; else
+		{
+			lfsr = ( lfsr >> 1 ) ^ ( -( lfsr & 1 ) & 0xb400 );
+			calibPattern[ i ] = lfsr & 255;
+		}
+	}
+	calibPatternIdx = 0;
+
+	for ( u32 i = 0; i < CALIB_PARAMS; i++ )
+	{
+		calibOriginal[ i ] = *calibParamValue[ i ];
+		calibWindow[ i ][ 0 ] = calibWindow[ i ][ 1 ] = -1;
+	}
+
+	calibParam = 0;
+	calibLost = 0;
+	calibTimeout = CALIB_TIMEOUT_FIRST;
+	calibDone = 0;
+	calibAck = 0;
+	calibActive = 1;
+
+	startParam( clockTicks );
+}
+
+static u32 finishTimingCalibration( u32 result )
+{
+	if ( result == CALIB_OK )
+	{
+		int p = getTimingProfile( getMachineTimingProfileName(), 1 );
+		if ( p >= 0 )
+		{
+			int *v = timingProfileValues[ p ];
+			v[ 0 ] = WAIT_FOR_SIGNALS;
+			v[ 1 ] = WAIT_CYCLE_READ;
+			v[ 2 ] = WAIT_CYCLE_WRITEDATA;
+			v[ 3 ] = WAIT_CYCLE_READ_BADLINE;
+			v[ 4 ] = WAIT_CYCLE_READ_VIC2;
+			v[ 5 ] = WAIT_CYCLE_WRITEDATA_VIC2;
+			v[ 6 ] = WAIT_CYCLE_MULTIPLEXER;
+			v[ 7 ] = WAIT_CYCLE_MULTIPLEXER_VIC2;
+			v[ 8 ] = WAIT_TRIGGER_DMA;
+			v[ 9 ] = WAIT_RELEASE_DMA;
+
+			for ( u32 i = 0; i < CALIB_PARAMS; i++ )
+			{
+				timingProfileWindow[ p ][ calibParamIndex[ i ] ][ 0 ] = calibWindow[ i ][ 0 ];
+				timingProfileWindow[ p ][ calibParamIndex[ i ] ][ 1 ] = calibWindow[ i ][ 1 ];
+			}
+		}
+		activeTimingProfile = p;
+	} else
+	{
+		for ( u32 i = 0; i < CALIB_PARAMS; i++ )
+			*calibParamValue[ i ] = calibOriginal[ i ];
+	}
+
+	calibActive = 0;
+	calibDone = 1;
+
+	return result;
+}
+
+static u32 probeResult( u32 passed, u32 noProgress, u32 clockTicks )
+{
+	if ( noProgress )
+	{
+		// no transfers at all: the C64 is (probably) not running the loop anymore
+		if ( ++calibLost >= CALIB_MAX_LOST )
+			return finishTimingCalibration( CALIB_LOST_C64 );
+	} else
+		calibLost = 0;
+
+	calibTimeout = CALIB_TIMEOUT;
+
+	if ( sweepNext( &sweep, passed ) )
+	{
+		startProbe( clockTicks );
+		return CALIB_RUNNING;
+	}
+
+	if ( sweep.passLo < 0 )
+		return finishTimingCalibration( calibLost ? CALIB_LOST_C64 : CALIB_FAILED );
+
+	calibWindow[ calibParam ][ 0 ] = sweep.passLo;
+	calibWindow[ calibParam ][ 1 ] = sweep.passHi;
+	*calibParamValue[ calibParam ] = sweepCenter( &sweep );
+
+	if ( ++calibParam >= CALIB_PARAMS )
+		return finishTimingCalibration( CALIB_OK );
+
+	startParam( clockTicks );
+	return CALIB_RUNNING;
+}
+
+// to be called repeatedly while 'calibActive' is set, returns CALIB_RUNNING until the calibration is finished
+u32 stepTimingCalibration( u32 clockTicks )
+{
+	if ( !calibActive )
+		return CALIB_FAILED;
+
+	u32 samples = calibSamples - calibBaseSamples;
+	u32 timeout = ( clockTicks - calibProbeStart ) > calibTimeout;
+
+	if ( calibState == CALIB_STATE_SETTLE )
+	{
+		if ( samples >= CALIB_SETTLE_SAMPLES )
+		{
+			calibState = CALIB_STATE_MEASURE;
+			calibBaseSamples = calibSamples;
+			calibBaseErrors = calibErrors;
+			calibProbeStart = clockTicks;
+		} else
+		if ( timeout )
+			return probeResult( 0, samples == 0, clockTicks );
+
+		return CALIB_RUNNING;
+	}
+
+	if ( calibErrors != calibBaseErrors )
+		return probeResult( 0, 0, clockTicks );
+
+	if ( samples >= CALIB_SAMPLES )
+		return probeResult( 1, 0, clockTicks );
+
+	if ( timeout )
+		return probeResult( 0, samples == 0, clockTicks );
+
+	return CALIB_RUNNING;
+}
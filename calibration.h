@@ -0,0 +1,81 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ calibration.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - bus timing calibration and per-machine timing profiles
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _calibration_h
+#define _calibration_h
+
+#include <circle/types.h>
+
+// IO2-registers used by the calibration loop which is injected into the C64 (see injectTimingCalibration)
+#define CALIB_PORT_PATTERN	6		// read:  next test pattern byte
+#define CALIB_PORT_ECHO		7		// write: C64 writes back the byte it has just read
+#define CALIB_PORT_DONE		8		// read:  returns CALIB_DONE_MAGIC when the sweep is finished
+#define CALIB_DONE_MAGIC	0xa5
+
+#define CALIB_RUNNING		0
+#define CALIB_OK			1
+#define CALIB_FAILED		2
+#define CALIB_LOST_C64		3
+
+// state shared with the FIQ handler of the menu
+extern volatile u32 calibActive, calibDone, calibAck;
+extern volatile u32 calibSamples, calibErrors;
+extern u32 calibPatternIdx, calibLastServed;
+extern u8  calibPattern[ 256 ];
+
+// machine type: C64/C128 and VIC-revision are reported by the menu code on the C64, PAL/NTSC is measured on the RPi
+extern u32 machineNTSC;
+extern u32 machineClockMeasured;
+extern int activeTimingProfile;
+
+extern u32 timingMeasurePhi2( u32 phi2Cycles, u32 clockTicks );
+extern const char *getMachineTimingProfileName();
+extern u32 applyMachineTimingProfile();
+
+// search for the pass window of one timing value: starting from a known good value,
+// the window is extended upwards and then downwards until the first failure (or a limit) is reached
+typedef struct
+{
+	s32 start, step, limitLo, limitHi;
+	s32 cur, dir;
+	s32 passLo, passHi;
+} TIMING_SWEEP;
+
+extern void sweepBegin( TIMING_SWEEP *s, s32 start, s32 step, s32 limitLo, s32 limitHi );
+extern u32  sweepNext( TIMING_SWEEP *s, u32 passed );
+extern s32  sweepCenter( TIMING_SWEEP *s );
+
+// calibration state machine, driven by the main loop of the menu
+extern void requestTimingCalibration();
+extern u32  timingCalibrationRequested();
+extern void beginTimingCalibration( u32 clockTicks );
+extern u32  stepTimingCalibration( u32 clockTicks );
+
+#endif
@@ -0,0 +1,477 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ cartmapper.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - cartridge mapper descriptions compiled into FIQ handlers
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _cartmapper_h
+#define _cartmapper_h
+
+#include "buschain.h"
+
+//
+// Cartridge mappers: a bank switching scheme is described by a CART_MAPPER (which ROM areas are served, where the
+// register is, how it selects the bank and the GAME/EXROM configuration, what happens on reset) and cartMapperFIQ<>
+// generates the FIQ handler at compile time. All fields are constants, everything a mapper does not use is removed by
+// the compiler:
+//
+//   static volatile EFSTATE ef;
+//   m_InputPin.ConnectInterrupt( cartMapperFIQ< mapperOcean, volatile EFSTATE, &ef >, FIQ_PARENT );
+//
+// The state ST has to provide the members of EFSTATE used below (see kernel_ef.cpp), HOOKS adds what cannot be
+// described (e.g. the EEPROM of GMOD2). CRTLoad/mapperbench replays bus traces through the generated handlers and the
+// former hand-written ones of kernel_ef.cpp and compares the results and timings. Zaxxon, Dinamic, Epyx Fastload
+// and Simons' Basic stay hand-written in kernel_ef.cpp, generated they were slower.
+//
+
+#ifdef BUSCHAIN_HOST
+#define LATCH_LED0 			(1<<D1)
+#define LATCH_LED1 			(1<<D2)
+#endif
+
+// areas
+#define CART_ROML			1
+#define CART_ROMH			2
+#define CART_IO1			4
+#define CART_IO2			8
+
+// register accesses
+#define CART_ON_READ		1
+#define CART_ON_WRITE		2
+
+// ROM layout in flash_cacheoptimized (see copyCRTChip in crt.cpp)
+#define CART_LAYOUT_8K		0	// 8k per bank (ROMH mirrors ROML)
+#define CART_LAYOUT_16K		1	// 16k per bank, ROML and ROMH bytes interleaved
+
+// how an access to the register selects the bank
+#define CART_BANK_KEEP		0
+#define CART_BANK_DATA		1	// the byte written
+#define CART_BANK_ADDRESS	2	// A0-A7
+#define CART_BANK_ZERO		3
+
+// GAME/EXROM configurations
+#define CART_KEEP			0
+#define CART_8K				1
+#define CART_16K			2
+#define CART_ULTIMAX		3
+#define CART_OFF			4
+#define CART_OFF_UNTIL_RESET 5	// also no more ROM reads until reset (reg2 = 1)
+#define CART_CONFIG_DATA	6	// config[ ( D >> configShift ) & configMask ] of the byte written
+
+// what the cartridge puts on the bus when the register is read
+#define CART_REGREAD_NONE	0
+#define CART_REGREAD_REG	1	// reg2 (the last write & regMask)
+#define CART_REGREAD_HOOK	2	// HOOKS::regRead
+
+struct CART_MAPPER
+{
+	u8  layout = CART_LAYOUT_8K;
+	u8  romAreas = CART_ROML;
+
+	// the register is in regArea and responds if ( A0-A7 & regAddrMask ) == regAddr
+	u8  regArea = 0, regAccess = 0;
+	u8  regAddrMask = 0, regAddr = 0;
+
+	// bank = ( ( value & bankMask ) ^ bankXor ), with bankWrap also & ( nBanks - 1 )
+	u8  readBank = CART_BANK_KEEP, writeBank = CART_BANK_KEEP;
+	u8  bankMask = 0x3f, bankXor = 0, bankWrap = 0;
+
+	u8  writeConfig = CART_KEEP;
+	u8  configShift = 0, configMask = 0;
+	u8  config[ 4 ] = { CART_KEEP, CART_KEEP, CART_KEEP, CART_KEEP };
+
+	u8  regRead = CART_REGREAD_NONE, regMask = 0;
+
+	// reset (RESET low for more than 3 cycles): configuration (resetConfigLarge if set and there are more than 32 banks),
+	// with resetBank the bank is reset as well
+	u8  resetConfig = CART_KEEP, resetConfigLarge = CART_KEEP;
+	u8  resetBank = 0;
+
+	// fast start (EF_FAST_START): stall the C64 (DMA) if it switches to a bank which is not loaded yet
+	u8  stallMissingBank = 0;
+
+	// LEDs which are turned on by register accesses (LED0 is turned off every 8192 cycles, the others on reset)
+	u32 led = 0;
+
+	constexpr u32 offUntilReset() const
+	{
+		return config[ 0 ] == CART_OFF_UNTIL_RESET || config[ 1 ] == CART_OFF_UNTIL_RESET ||
+			   config[ 2 ] == CART_OFF_UNTIL_RESET || config[ 3 ] == CART_OFF_UNTIL_RESET;
+	}
+};
+
+//
+// the mappers of kernel_ef.cpp
+//
+
+// Ocean: up to 64 8k-banks in ROML and ROMH, $de00 selects the bank
+constexpr CART_MAPPER cartOcean()
+{
+	CART_MAPPER m;
+	m.romAreas			= CART_ROML | CART_ROMH;
+	m.regArea			= CART_IO1;
+	m.regAccess			= CART_ON_WRITE;
+	m.writeBank			= CART_BANK_DATA;
+	m.bankMask			= 0x3f;
+	m.resetConfig		= CART_16K;
+	m.resetConfigLarge	= CART_8K;
+	m.resetBank			= 1;
+#ifdef EF_FAST_START
+	m.stallMissingBank	= 1;
+#endif
+	m.led				= LATCH_LED0;
+	return m;
+}
+
+// Prophet 64: 32 8k-banks, $df00 selects the bank, bit 5 disables the cartridge
+constexpr CART_MAPPER cartProphet()
+{
+	CART_MAPPER m;
+	m.regArea			= CART_IO2;
+	m.regAccess			= CART_ON_WRITE;
+	m.regAddrMask		= 0xff;
+	m.writeBank			= CART_BANK_DATA;
+	m.bankMask			= 0x1f;
+	m.writeConfig		= CART_CONFIG_DATA;
+	m.configShift		= 5;
+	m.configMask		= 1;
+	m.config[ 0 ]		= CART_8K;
+	m.config[ 1 ]		= CART_OFF;
+	m.resetConfig		= CART_8K;
+	m.resetBank			= 1;
+	m.led				= LATCH_LED0;
+	return m;
+}
+
+// RGCD: 8 8k-banks, $de00 bits 0-2 select the bank, bit 3 disables the cartridge until reset
+// (Hucky: the same with inverted bank bits, it starts with bank 7)
+constexpr CART_MAPPER cartRGCD( u8 bankXor )
+{
+	CART_MAPPER m;
+	m.regArea			= CART_IO1;
+	m.regAccess			= CART_ON_WRITE;
+	m.writeBank			= CART_BANK_DATA;
+	m.bankMask			= 7;
+	m.bankXor			= bankXor;
+	m.bankWrap			= 1;
+	m.writeConfig		= CART_CONFIG_DATA;
+	m.configShift		= 3;
+	m.configMask		= 1;
+	m.config[ 1 ]		= CART_OFF_UNTIL_RESET;
+	m.resetConfig		= CART_8K;
+	m.resetBank			= 1;
+	m.led				= LATCH_LED0;
+	return m;
+}
+
+// GMOD2: 64 8k-banks, $de00 bits 0-5 select the bank, bits 6-7 the configuration, and drive the EEPROM (hooks)
+constexpr CART_MAPPER cartGMOD2()
+{
+	CART_MAPPER m;
+	m.regArea			= CART_IO1;
+	m.regAccess			= CART_ON_READ | CART_ON_WRITE;
+	m.writeBank			= CART_BANK_DATA;
+	m.bankMask			= 0x3f;
+	m.writeConfig		= CART_CONFIG_DATA;
+	m.configShift		= 6;
+	m.configMask		= 3;
+	m.config[ 0 ]		= CART_8K;
+	m.config[ 1 ]		= CART_OFF;
+	m.config[ 2 ]		= CART_8K;
+	m.config[ 3 ]		= CART_ULTIMAX;
+	m.regRead			= CART_REGREAD_HOOK;
+	m.resetConfig		= CART_8K;
+	m.resetBank			= 1;
+	return m;
+}
+
+// C64 Games System: 64 8k-banks, writing to $de00+n selects bank n, reading from IO1 selects bank 0
+constexpr CART_MAPPER cartC64GS()
+{
+	CART_MAPPER m;
+	m.regArea			= CART_IO1;
+	m.regAccess			= CART_ON_READ | CART_ON_WRITE;
+	m.readBank			= CART_BANK_ZERO;
+	m.writeBank			= CART_BANK_ADDRESS;
+	m.bankMask			= 0x3f;
+	m.resetConfig		= CART_8K;
+	m.resetBank			= 1;
+	m.led				= LATCH_LED0 | LATCH_LED1;
+	return m;
+}
+
+// Comal 80: 4 16k-banks, $de00 bits 0-1 select the bank, bit 6 disables the cartridge, the register can be read back
+constexpr CART_MAPPER cartComal80()
+{
+	CART_MAPPER m;
+	m.layout			= CART_LAYOUT_16K;
+	m.romAreas			= CART_ROML | CART_ROMH;
+	m.regArea			= CART_IO1;
+	m.regAccess			= CART_ON_READ | CART_ON_WRITE;
+	m.writeBank			= CART_BANK_DATA;
+	m.bankMask			= 3;
+	m.writeConfig		= CART_CONFIG_DATA;
+	m.configShift		= 6;
+	m.configMask		= 1;
+	m.config[ 0 ]		= CART_16K;
+	m.config[ 1 ]		= CART_OFF;
+	m.regRead			= CART_REGREAD_REG;
+	m.regMask			= 0xc7;
+	return m;
+}
+
+static constexpr CART_MAPPER mapperOcean		= cartOcean();
+static constexpr CART_MAPPER mapperProphet		= cartProphet();
+static constexpr CART_MAPPER mapperRGCD		= cartRGCD( 0 );
+static constexpr CART_MAPPER mapperHucky		= cartRGCD( 7 );
+static constexpr CART_MAPPER mapperGMOD2		= cartGMOD2();
+static constexpr CART_MAPPER mapperC64GS		= cartC64GS();
+static constexpr CART_MAPPER mapperComal80		= cartComal80();
+
+//
+// the generated handler
+//
+class CCartNoHooks
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b ) {}
+	template <class BUS> static inline u32  regRead( BUS &b ) { return 0; }
+	template <class BUS> static inline void regWrite( BUS &b, u32 D ) {}
+};
+
+template <class BUS>
+__attribute__( ( always_inline ) ) inline void cartSetConfig( BUS &b, u32 config )
+{
+	switch ( config )
+	{
+	case CART_8K:		b.setClr( bGAME, bEXROM ); break;
+	case CART_16K:		b.clr( bGAME | bEXROM ); break;
+	case CART_ULTIMAX:	b.setClr( bEXROM, bGAME ); break;
+	case CART_OFF:		b.set( bGAME | bEXROM ); break;
+	}
+}
+
+// DMA and NMI are released together with the configuration
+template <class BUS>
+__attribute__( ( always_inline ) ) inline void cartSetConfigDMANMI( BUS &b, u32 config )
+{
+	switch ( config )
+	{
+	case CART_8K:		b.setClr( bDMA | bNMI | bGAME, bEXROM ); break;
+	case CART_16K:		b.setClr( bDMA | bNMI, bGAME | bEXROM ); break;
+	case CART_ULTIMAX:	b.setClr( bDMA | bNMI | bEXROM, bGAME ); break;
+	case CART_OFF:		b.set( bDMA | bNMI | bGAME | bEXROM ); break;
+	default:			b.set( bDMA | bNMI ); break;
+	}
+}
+
+template <const CART_MAPPER &M, class ST, ST *S, class BUS>
+__attribute__( ( always_inline ) ) inline void cartSelectBank( BUS &b, u32 source, u32 value )
+{
+	if ( source == CART_BANK_KEEP )
+		return;
+
+	if ( source == CART_BANK_ZERO )
+		value = 0;
+
+	u32 bank = ( value & M.bankMask ) ^ M.bankXor;
+	if ( M.bankWrap )
+		bank &= S->nBanks - 1;
+
+	if ( M.layout == CART_LAYOUT_8K )
+	{
+		// redundant writes (GMOD2 drives its EEPROM through this register) do not reload the cache
+		u8 *p = &S->flash_cacheoptimized[ bank * 8192 ];
+		S->reg0 = bank;
+		if ( S->flashBank != p )
+		{
+			S->flashBank = p;
+			b.preloadBank( p );
+		}
+	} else
+	{
+		S->reg0 = bank;
+		S->flashBank = &S->flash_cacheoptimized[ bank * 8192 * 2 ];
+	}
+}
+
+template <const CART_MAPPER &M, class ST, ST *S, class BUS>
+__attribute__( ( always_inline ) ) inline void cartSetConfigWrite( BUS &b, u32 config )
+{
+	if ( config == CART_OFF_UNTIL_RESET )
+	{
+		S->reg2 = 1;
+		b.set( bDMA | bNMI | bGAME | bEXROM );
+	} else
+		cartSetConfig( b, config );
+}
+
+template <const CART_MAPPER &M, class BUS>
+__attribute__( ( always_inline ) ) inline u32 cartRegisterAccess( BUS &b )
+{
+	if ( !( ( ( M.regArea & CART_IO1 ) && b.io1() ) || ( ( M.regArea & CART_IO2 ) && b.io2() ) ) )
+		return 0;
+	return ( b.addrIO() & M.regAddrMask ) == M.regAddr;
+}
+
+template <const CART_MAPPER &M, class ST, ST *S, class HOOKS = CCartNoHooks, class BUS>
+__attribute__( ( always_inline ) ) inline void cartMapperCycle( BUS &b )
+{
+	register u32 D, addr;
+	register u8 *flashBankR = S->flashBank;
+
+	b.start();
+
+	if ( M.layout == CART_LAYOUT_8K )
+		b.preloadL2Strm( &S->flashBank[ b.addrIO() << 5 ] );
+	HOOKS::prefetch( b );
+
+	S->c64CycleCount ++;
+	if ( b.reset() )
+		S->resetCounter2 ++; else
+		S->resetCounter2 = 0;
+
+	b.readRest();
+
+	addr = b.addrCacheOpt();
+
+	if ( b.cpuReads() )
+	{
+		if ( ( ( ( M.romAreas & CART_ROML ) && b.roml() ) || ( ( M.romAreas & CART_ROMH ) && b.romh() ) ) &&
+			 !( M.offUntilReset() && S->reg2 ) )
+		{
+			if ( M.layout == CART_LAYOUT_8K )
+				D = S->flashBank[ addr ]; else
+			{
+				D = *(u32*)&flashBankR[ addr * 2 ];
+				if ( ( M.romAreas & CART_ROMH ) && b.romh() )
+					D >>= 8;
+			}
+			b.put( D );
+		} else
+		if ( ( M.regAccess & CART_ON_READ ) && cartRegisterAccess<M>( b ) )
+		{
+			if ( M.led )
+				b.setLED( M.led );
+			cartSelectBank<M, ST, S>( b, M.readBank, b.addrIO() );
+
+			if ( M.regRead == CART_REGREAD_REG )
+				b.put( S->reg2 ); else
+			if ( M.regRead == CART_REGREAD_HOOK )
+				b.put( HOOKS::regRead( b ) );
+		}
+	} else
+	if ( ( M.regAccess & CART_ON_WRITE ) && cartRegisterAccess<M>( b ) )
+	{
+		D = b.get();
+		if ( M.led )
+			b.setLED( M.led );
+
+		if ( M.writeConfig == CART_CONFIG_DATA )
+		{
+			// one branch per entry, each with constant GPIO writes
+			switch ( ( D >> M.configShift ) & M.configMask )
+			{
+			case 0:  cartSetConfigWrite<M, ST, S>( b, M.config[ 0 ] ); break;
+			case 1:  cartSetConfigWrite<M, ST, S>( b, M.config[ 1 ] ); break;
+			case 2:  cartSetConfigWrite<M, ST, S>( b, M.config[ 2 ] ); break;
+			default: cartSetConfigWrite<M, ST, S>( b, M.config[ 3 ] ); break;
+			}
+		} else
+			cartSetConfig( b, M.writeConfig );
+
+		HOOKS::regWrite( b, D );
+
+		if ( M.regMask )
+			S->reg2 = D & M.regMask;
+
+		cartSelectBank<M, ST, S>( b, M.writeBank, M.writeBank == CART_BANK_ADDRESS ? b.addrIO() : D );
+
+		if ( M.stallMissingBank && !S->bankResident[ S->reg0 ] )
+		{
+			if ( S->releaseDMA == 0 )
+			{
+				b.waitTriggerDMA();
+				b.clr( bDMA );
+			}
+			S->releaseDMA = 0;
+			S->bankMissing = 1;
+		}
+	}
+
+	// the main loop has read the bank the C64 is waiting for
+	if ( M.stallMissingBank && S->bankMissing && S->bankResident[ S->reg0 ] )
+	{
+		S->bankMissing = 0;
+		b.preloadBank( S->flashBank );
+		b.waitReleaseDMA();
+		b.set( bDMA );
+	}
+
+	if ( b.reset() )
+		S->resetCounter ++; else
+		S->resetCounter = 0;
+
+	if ( S->resetCounter > 3 && S->resetCounter < 0x8000000 )
+	{
+		S->resetCounter = 0x8000000;
+		if ( M.resetBank )
+		{
+			S->releaseDMA = 0;
+			S->bankMissing = 0;
+			if ( M.offUntilReset() )
+				S->reg2 = 0;
+			cartSelectBank<M, ST, S>( b, CART_BANK_ZERO, 0 );
+		}
+		if ( M.led & ~LATCH_LED0 )
+			b.clrLED( M.led & ~LATCH_LED0 );
+		if ( M.resetConfigLarge && S->nBanks > 32 )
+			cartSetConfigDMANMI( b, M.resetConfigLarge ); else
+			cartSetConfigDMANMI( b, M.resetConfig );
+		b.finish();
+		return;
+	}
+
+	if ( M.led )
+	{
+		static u32 cycleCount = 0;
+		if ( !( ( ++cycleCount ) & 8191 ) )
+			b.clrLED( LATCH_LED0 );
+	}
+
+	b.finishLatch();
+}
+
+#ifndef BUSCHAIN_HOST
+template <const CART_MAPPER &M, class ST, ST *S, class HOOKS = CCartNoHooks>
+void cartMapperFIQ( void *pParam )
+{
+	CBusFIQ b;
+	cartMapperCycle< M, ST, S, HOOKS >( b );
+}
+#endif
+
+#endif
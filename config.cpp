@@ -34,6 +34,9 @@
 #include "config.h"
 #include "helpers.h"
 #include "linux/kernel.h"
+#include "profiler.h"
+#include "logring.h"
+#include <stdio.h>
 
 //#define DEBUG_OUT
 
@@ -41,6 +44,9 @@ u32 skinFontLoaded;
 char skinFontFilename[ 1024 ];
 union T_SKIN_VALUES	skinValues;
 int screenType;
+u32 recordSIDStream = 0;
+u32 exactSIDReadBack = 0;
+u32 hdmiLatency = 40;
 
 #ifdef WITH_NET
 	char netSidekickHostname[ 256 ];
@@ -95,6 +101,85 @@ int getNextLine()
 }
 
 int timingValues[ TIMING_NAMES ] = { 40, 475, 470, 400, 425, 505, 200, 265, 600, 600 };
+
+int  nTimingProfiles = 0;
+char timingProfileName[ MAX_TIMING_PROFILES ][ 32 ];
+int  timingProfileValues[ MAX_TIMING_PROFILES ][ TIMING_NAMES ];
+int  timingProfileWindow[ MAX_TIMING_PROFILES ][ TIMING_NAMES ][ 2 ];
+
+// returns the index of the profile 'name', optionally creates it (initialized with the default timings)
+int getTimingProfile( const char *name, int create )
+{
+	for ( int i = 0; i < nTimingProfiles; i++ )
+		if ( strcmp( timingProfileName[ i ], name ) == 0 )
+			return i;
+
+	if ( !create || nTimingProfiles >= MAX_TIMING_PROFILES )
+		return -1;
+
+	int p = nTimingProfiles ++;
+	memset( timingProfileName[ p ], 0, 32 );
+	strncpy( timingProfileName[ p ], name, 31 );
+	memcpy( timingProfileValues[ p ], timingValues, sizeof( int ) * TIMING_NAMES );
+	for ( int i = 0; i < TIMING_NAMES; i++ )
+		timingProfileWindow[ p ][ i ][ 0 ] = timingProfileWindow[ p ][ i ][ 1 ] = -1;
+	return p;
+}
+
+void applyTimingValues( int *v )
+{
+	WAIT_FOR_SIGNALS = v[ 0 ];
+	WAIT_CYCLE_READ = v[ 1 ];
+	WAIT_CYCLE_WRITEDATA = v[ 2 ];
+	WAIT_CYCLE_READ_BADLINE = v[ 3 ];
+	WAIT_CYCLE_READ_VIC2 = v[ 4 ];
+	WAIT_CYCLE_WRITEDATA_VIC2 = v[ 5 ];
+	WAIT_CYCLE_MULTIPLEXER = v[ 6 ];
+	WAIT_CYCLE_MULTIPLEXER_VIC2 = v[ 7 ];
+	WAIT_TRIGGER_DMA = v[ 8 ];
+	WAIT_RELEASE_DMA = v[ 9 ];
+}
+
+// parses the optional comment of calibrated values, e.g. WAIT_CYCLE_READ 480 "pass 420-540"
+static void parsePassWindow( char *rest, int *window )
+{
+	if ( rest == NULL || strncmp( rest, "pass ", 5 ) != 0 )
+		return;
+
+	char *sep = strchr( rest, '-' );
+	if ( sep == NULL )
+		return;
+
+	*sep = 0;
+	window[ 0 ] = atoi( rest + 5 );
+	window[ 1 ] = atoi( sep + 1 );
+}
+
+// TIMING_PROFILE <name> starts a profile, all following timing values belong to it
+static int parseTimingLine( char *ptr, char *rest, int *curProfile )
+{
+	if ( strcmp( ptr, "TIMING_PROFILE" ) == 0 )
+	{
+		ptr = strtok_r( NULL, " \t", &rest );
+		if ( ptr )
+			*curProfile = getTimingProfile( ptr, 1 );
+		return 1;
+	}
+
+	for ( int i = 0; i < TIMING_NAMES; i++ )
+		if ( strcmp( ptr, timingNames[ i ] ) == 0 && ( ptr = strtok_r( NULL, "\"", &rest ) ) )
+		{
+			if ( *curProfile >= 0 )
+			{
+				timingProfileValues[ *curProfile ][ i ] = atoi( ptr );
+				parsePassWindow( rest, timingProfileWindow[ *curProfile ][ i ] );
+			} else
+				timingValues[ i ] = atoi( ptr );
+			return 1;
+		}
+
+	return 0;
+}
 int menuX[ 5 ], menuY[ 5 ], menuItems[ 5 ];
 char menuText[ 5 ][ MAX_ITEMS ][ 32 ], menuFile[ 5 ][ MAX_ITEMS ][ 2048 ];
 int menuItemPos[ 5 ][ MAX_ITEMS ][ 2 ];
@@ -120,6 +205,8 @@ int readConfig( CLogger *logger, char *DRIVE, char *FILENAME )
 	cfgPos = cfg;
 
 	screenType = 0;
+	nTimingProfiles = 0;
+	int curTimingProfile = -1;
 
 	while ( *cfgPos != 0 )
 	{
@@ -171,16 +258,13 @@ int readConfig( CLogger *logger, char *DRIVE, char *FILENAME )
 						break;
 					}
 
-				for ( int i = 0; i < TIMING_NAMES; i++ )
-					if ( strcmp( ptr, timingNames[ i ] ) == 0 && ( ptr = strtok_r( NULL, "\"", &rest ) ) )
-					{
-						timingValues[ i ] = atoi( ptr );
-						while ( *ptr == '\t' || *ptr == ' ' ) ptr++;
-					#ifdef DEBUG_OUT
-						logger->Write( "RaspiMenu", LogNotice, "  %s >%d< (%s)", timingNames[ i ], timingValues[ i ], ptr );
-					#endif
-						break;
-					}
+				if ( parseTimingLine( ptr, rest, &curTimingProfile ) )
+				{
+				#ifdef DEBUG_OUT
+					logger->Write( "RaspiMenu", LogNotice, "  timing >%s< (profile %d)", ptr, curTimingProfile );
+				#endif
+					continue;
+				}
 
 				for ( int i = 0; i < SKIN_NAMES; i++ )
 					if ( strcmp( ptr, skinNames[ i ] ) == 0 && ( ptr = strtok_r( NULL, "\"", &rest ) ) )
@@ -211,6 +295,47 @@ int readConfig( CLogger *logger, char *DRIVE, char *FILENAME )
 						screenType = 1;
 				}
 
+				// records the register writes in the SID kernel to SD:SIDREC/ (see sidrec.h)
+				if ( strcmp( ptr, "SID_RECORD" ) == 0 )
+				{
+					char *v = strtok_r( NULL, " \t", &rest );
+					recordSIDStream = ( v && atoi( v ) == 1 );
+				}
+
+				// OSC3/ENV3 of SID1 are read back from a model running ahead of the C64 (see sidreadback.h); the model runs
+				// in the main loop and costs 10-27 ns per C64 cycle on the host, one to four times the SID emulation itself
+				if ( strcmp( ptr, "SID_EXACT_READBACK" ) == 0 )
+				{
+					char *v = strtok_r( NULL, " \t", &rest );
+					exactSIDReadBack = ( v && atoi( v ) == 1 );
+				}
+
+				// target latency of the HDMI sound output of the SID kernel in ms (see audioresampler.h)
+				if ( strcmp( ptr, "HDMI_LATENCY" ) == 0 )
+				{
+					char *v = strtok_r( NULL, " \t", &rest );
+					int l = v ? atoi( v ) : 40;
+					hdmiLatency = l < 20 ? 20 : ( l > 120 ? 120 : l );
+				}
+
+				// samples the main loops at the given rate in Hz and saves them to SD:PROFILE/ (see profiler.h)
+				if ( strcmp( ptr, "PROFILE" ) == 0 )
+				{
+					char *v = strtok_r( NULL, " \t", &rest );
+					profileRate = v ? atoi( v ) : 0;
+				}
+
+				// level of the deferred log messages of a subsystem, e.g. "LOG_LEVEL modem debug" (see logring.h)
+				if ( strcmp( ptr, "LOG_LEVEL" ) == 0 )
+				{
+					char *s = strtok_r( NULL, " \t", &rest );
+					char *l = s ? strtok_r( NULL, " \t", &rest ) : NULL;
+					int sub = s ? logRingSubsystem( s ) : -1;
+					int level = l ? logRingParseLevel( l ) : -1;
+					if ( sub >= 0 && level >= 0 )
+						logRingLevel[ sub ] = level;
+				}
+
 #ifdef WITH_NET
 				if ( strcmp( ptr, "NET_SIDEKICK_HOSTNAME" ) == 0 )
 				{
@@ -289,16 +414,56 @@ int readConfig( CLogger *logger, char *DRIVE, char *FILENAME )
 		}
 	}
 
-	WAIT_FOR_SIGNALS = timingValues[ 0 ];
-	WAIT_CYCLE_READ = timingValues[ 1 ];
-	WAIT_CYCLE_WRITEDATA = timingValues[ 2 ];
-	WAIT_CYCLE_READ_BADLINE = timingValues[ 3 ];
-	WAIT_CYCLE_READ_VIC2 = timingValues[ 4 ];
-	WAIT_CYCLE_WRITEDATA_VIC2 = timingValues[ 5 ];
-	WAIT_CYCLE_MULTIPLEXER = timingValues[ 6 ];
-	WAIT_CYCLE_MULTIPLEXER_VIC2 = timingValues[ 7 ];
-	WAIT_TRIGGER_DMA = timingValues[ 8 ];
-	WAIT_RELEASE_DMA = timingValues[ 9 ];
+	applyTimingValues( timingValues );
 
 	return 1;
 }
+
+// reads additional (e.g. calibrated) timing profiles, existing profiles with the same name are overwritten
+int readTimingProfiles( CLogger *logger, char *DRIVE, char *FILENAME )
+{
+	u32 cfgBytes;
+	memset( cfg, 0, 16384 );
+
+	if ( !readFile( logger, DRIVE, FILENAME, (u8*)cfg, &cfgBytes ) )
+		return 0;
+
+	cfgPos = cfg;
+	int curTimingProfile = -1;
+
+	while ( *cfgPos != 0 )
+	{
+		if ( getNextLine() && curLine[ 0 ] )
+		{
+			char *rest = NULL;
+			char *ptr = strtok_r( curLine, " \t", &rest );
+
+			// values outside a profile are ignored, the defaults only come from the main config file
+			if ( ptr && ( curTimingProfile >= 0 || strcmp( ptr, "TIMING_PROFILE" ) == 0 ) )
+				parseTimingLine( ptr, rest, &curTimingProfile );
+		}
+	}
+
+	return 1;
+}
+
+int writeTimingProfiles( CLogger *logger, char *DRIVE, char *FILENAME )
+{
+	u32 cfgBytes = 0;
+	memset( cfg, 0, 16384 );
+
+	for ( int p = 0; p < nTimingProfiles; p++ )
+	{
+		cfgBytes += sprintf( &cfg[ cfgBytes ], "TIMING_PROFILE %s\r\n", timingProfileName[ p ] );
+		for ( int i = 0; i < TIMING_NAMES; i++ )
+		{
+			cfgBytes += sprintf( &cfg[ cfgBytes ], "%s %d", timingNames[ i ], timingProfileValues[ p ][ i ] );
+			if ( timingProfileWindow[ p ][ i ][ 0 ] >= 0 )
+				cfgBytes += sprintf( &cfg[ cfgBytes ], " \"pass %d-%d\"", timingProfileWindow[ p ][ i ][ 0 ], timingProfileWindow[ p ][ i ][ 1 ] );
+			cfgBytes += sprintf( &cfg[ cfgBytes ], "\r\n" );
+		}
+		cfgBytes += sprintf( &cfg[ cfgBytes ], "\r\n" );
+	}
+
+	return writeFile( logger, DRIVE, FILENAME, (u8*)cfg, cfgBytes );
+}
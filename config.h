@@ -35,6 +35,7 @@ extern int menuX[ 5 ], menuY[ 5 ], menuItems[ 5 ];
 extern char menuText[ 5 ][ MAX_ITEMS ][ 32 ], menuFile[ 5 ][ MAX_ITEMS ][ 2048 ];
 extern int menuItemPos[ 5 ][ MAX_ITEMS ][ 2 ];
 extern int screenType;
+extern u32 recordSIDStream;
 
 #define TIMING_NAMES 10
 const char timingNames[TIMING_NAMES][32] = {
@@ -81,7 +82,19 @@ const char skinNames[SKIN_NAMES][40] = {
 	"SKIN_ERROR_TEXT"
 };
 
+// named timing profiles (e.g. one per machine type), selected automatically once the machine type is known
+#define MAX_TIMING_PROFILES	8
+extern int  nTimingProfiles;
+extern char timingProfileName[ MAX_TIMING_PROFILES ][ 32 ];
+extern int  timingProfileValues[ MAX_TIMING_PROFILES ][ TIMING_NAMES ];
+extern int  timingProfileWindow[ MAX_TIMING_PROFILES ][ TIMING_NAMES ][ 2 ];
+extern int  timingValues[ TIMING_NAMES ];
+
 extern int readConfig( CLogger *logger, char *DRIVE, char *FILENAME );
+extern int readTimingProfiles( CLogger *logger, char *DRIVE, char *FILENAME );
+extern int writeTimingProfiles( CLogger *logger, char *DRIVE, char *FILENAME );
+extern int getTimingProfile( const char *name, int create = 0 );
+extern void applyTimingValues( int *v );
 extern int getMainMenuSelection( int key, char **FILE, int *addIdx = 0 );
 extern void printMainMenu();
 
@@ -0,0 +1,402 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ copro.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - math and 3D coprocessor in IO2
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "copro.h"
+#include <circle/util.h>
+
+#ifndef min
+#define min( a, b ) ( ((a)<(b))?(a):(b) )
+#define max( a, b ) ( ((a)>(b))?(a):(b) )
+#endif
+
+s32 coproSinTab[ 1026 ];
+
+//
+// floating point functions (only the main loop may use the floating point registers)
+//
+#define PI		3.14159265358979323846
+
+static double fsqrt( double x )
+{
+#ifdef __aarch64__
+	double r;
+	asm volatile ( "fsqrt %d0, %d1" : "=w" ( r ) : "w" ( x ) );
+	return r;
+#else
+	return __builtin_sqrt( x );
+#endif
+}
+
+static double fsin( double x )
+{
+	// reduce to [-pi/2, pi/2], the series converges quickly there
+	x -= 2 * PI * (double)(s64)( x / ( 2 * PI ) + ( x < 0 ? -0.5 : 0.5 ) );
+	if ( x > PI / 2 ) x = PI - x;
+	if ( x < -PI / 2 ) x = -PI - x;
+
+	double x2 = x * x, t = x, s = x;
+	for ( u32 i = 2; i < 26; i += 2 )
+	{
+		t *= -x2 / ( i * ( i + 1 ) );
+		s += t;
+	}
+	return s;
+}
+
+static double fcos( double x )
+{
+	return fsin( x + PI / 2 );
+}
+
+static double fatan( double x )
+{
+	s32 neg = x < 0;
+	if ( neg ) x = -x;
+
+	u32 inv = x > 1;
+	if ( inv ) x = 1 / x;
+
+	// atan( x ) = 2 * atan( x / ( 1 + sqrt( 1 + x^2 ) ) ), applied twice: |x| < 0.2
+	x = x / ( 1 + fsqrt( 1 + x * x ) );
+	x = x / ( 1 + fsqrt( 1 + x * x ) );
+
+	double x2 = x * x, t = x, s = x;
+	for ( u32 i = 3; i < 40; i += 2 )
+	{
+		t *= -x2;
+		s += t / i;
+	}
+	s *= 4;
+
+	if ( inv ) s = PI / 2 - s;
+	return neg ? -s : s;
+}
+
+static double fatan2( double y, double x )
+{
+	if ( x > 0 ) return fatan( y / x );
+	if ( x < 0 ) return y >= 0 ? fatan( y / x ) + PI : fatan( y / x ) - PI;
+	if ( y > 0 ) return PI / 2;
+	if ( y < 0 ) return -PI / 2;
+	return 0;
+}
+
+void coproInit( COPRO_STATE *c )
+{
+	memset( c, 0, sizeof( COPRO_STATE ) );
+
+	for ( u32 i = 0; i <= 1024; i++ )
+		coproSinTab[ i ] = (s32)( fsin( i * PI / 2048 ) * 65536 + 0.5 );
+	coproSinTab[ 1025 ] = coproSinTab[ 1024 ];
+}
+
+//
+// the RAM of the coprocessor, all addresses wrap at 64k
+//
+static inline s32 rd16( const u8 *ram, u32 a )
+{
+	return (s16)( ram[ a & 0xffff ] | ( ram[ ( a + 1 ) & 0xffff ] << 8 ) );
+}
+
+static inline s32 rd32( const u8 *ram, u32 a )
+{
+	return (s32)( (u32)rd16( ram, a ) & 0xffff ) | ( (u32)rd16( ram, a + 2 ) << 16 );
+}
+
+static inline void wr16( u8 *ram, u32 a, s32 v )
+{
+	ram[ a & 0xffff ] = v & 255;
+	ram[ ( a + 1 ) & 0xffff ] = ( v >> 8 ) & 255;
+}
+
+static inline s32 sat16( s64 v )
+{
+	return v < -32767 ? -32767 : ( v > 32767 ? 32767 : (s32)v );
+}
+
+//
+// rasterization into the C64 hires bitmap layout: 40 cells of 8x8 pixels per row, 8 bytes per cell
+//
+static inline void plot( u8 *ram, u32 bitmap, s32 x, s32 y, u32 mode )
+{
+	if ( (u32)x >= COPRO_BITMAP_WIDTH || (u32)y >= COPRO_BITMAP_HEIGHT )
+		return;
+
+	u8 *p = &ram[ ( bitmap + ( y >> 3 ) * 320 + ( x & ~7 ) + ( y & 7 ) ) & 0xffff ];
+	u8 m = 0x80 >> ( x & 7 );
+
+	if ( mode == 0 ) *p |= m; else
+	if ( mode == 1 ) *p &= ~m; else
+		*p ^= m;
+}
+
+static inline void span( u8 *ram, u32 bitmap, s32 y, s32 x0, s32 x1, u32 mode )
+{
+	u32 row = bitmap + ( y >> 3 ) * 320 + ( y & 7 );
+
+	for ( s32 x = x0; x <= x1; )
+	{
+		// the pixels of this byte
+		u32 first = x & 7, last = ( x1 - ( x & ~7 ) ) < 7 ? x1 - ( x & ~7 ) : 7;
+		u8 m = ( 0xff >> first ) & ( 0xff << ( 7 - last ) );
+		u8 *p = &ram[ ( row + ( x & ~7 ) ) & 0xffff ];
+
+		if ( mode == 0 ) *p |= m; else
+		if ( mode == 1 ) *p &= ~m; else
+			*p ^= m;
+
+		x = ( x & ~7 ) + 8;
+	}
+}
+
+// Bresenham, the pixels outside of the bitmap are skipped
+void coproLine( u8 *ram, u32 bitmap, s32 x0, s32 y0, s32 x1, s32 y1, u32 mode )
+{
+	s32 dx = x1 - x0, dy = y1 - y0;
+	s32 sx = dx < 0 ? -1 : 1, sy = dy < 0 ? -1 : 1;
+	if ( dx < 0 ) dx = -dx;
+	if ( dy < 0 ) dy = -dy;
+
+	// nothing to draw if both end points are on the same side outside of the bitmap
+	if ( ( x0 < 0 && x1 < 0 ) || ( y0 < 0 && y1 < 0 ) ||
+		 ( x0 >= COPRO_BITMAP_WIDTH && x1 >= COPRO_BITMAP_WIDTH ) || ( y0 >= COPRO_BITMAP_HEIGHT && y1 >= COPRO_BITMAP_HEIGHT ) )
+		return;
+
+	s32 err = dx - dy;
+	while ( true )
+	{
+		plot( ram, bitmap, x0, y0, mode );
+		if ( x0 == x1 && y0 == y1 )
+			break;
+		s32 e2 = 2 * err;
+		if ( e2 > -dy ) { err -= dy; x0 += sx; }
+		if ( e2 < dx )  { err += dx; y0 += sy; }
+	}
+}
+
+static inline s64 floorDiv( s64 n, s64 d )
+{
+	return n >= 0 ? n / d : -( ( -n + d - 1 ) / d );
+}
+
+// the pixels (x, y) on or inside the triangle are set, row by row the exact intersections with the edges are used
+void coproTriangle( u8 *ram, u32 bitmap, s32 x0, s32 y0, s32 x1, s32 y1, s32 x2, s32 y2, u32 mode )
+{
+	s32 x[ 3 ] = { x0, x1, x2 }, y[ 3 ] = { y0, y1, y2 };
+
+	s32 ymin = min( y0, min( y1, y2 ) ), ymax = max( y0, max( y1, y2 ) );
+	if ( ymin < 0 ) ymin = 0;
+	if ( ymax > COPRO_BITMAP_HEIGHT - 1 ) ymax = COPRO_BITMAP_HEIGHT - 1;
+
+	for ( s32 yy = ymin; yy <= ymax; yy++ )
+	{
+		s64 left = 0x7fffffff, right = -0x7fffffff;
+
+		for ( u32 e = 0; e < 3; e++ )
+		{
+			s32 xa = x[ e ], ya = y[ e ], xb = x[ ( e + 1 ) % 3 ], yb = y[ ( e + 1 ) % 3 ];
+
+			if ( ya == yb )
+			{
+				if ( ya == yy )
+				{
+					left = min( left, (s64)min( xa, xb ) );
+					right = max( right, (s64)max( xa, xb ) );
+				}
+				continue;
+			}
+
+			if ( yy < min( ya, yb ) || yy > max( ya, yb ) )
+				continue;
+
+			// x = xa + ( yy - ya ) * ( xb - xa ) / ( yb - ya )
+			s64 n = (s64)xa * ( yb - ya ) + (s64)( yy - ya ) * ( xb - xa ), d = yb - ya;
+			if ( d < 0 ) { n = -n; d = -d; }
+
+			left = min( left, -floorDiv( -n, d ) );
+			right = max( right, floorDiv( n, d ) );
+		}
+
+		if ( left < 0 ) left = 0;
+		if ( right > COPRO_BITMAP_WIDTH - 1 ) right = COPRO_BITMAP_WIDTH - 1;
+		if ( left <= right )
+			span( ram, bitmap, yy, (s32)left, (s32)right, mode );
+	}
+}
+
+//
+// the queued commands
+//
+static inline float asFloat( u32 v )
+{
+	union { u32 u; float f; } c;
+	c.u = v;
+	return c.f;
+}
+
+static inline u32 asU32( float v )
+{
+	union { u32 u; float f; } c;
+	c.f = v;
+	return c.u;
+}
+
+static inline s32 toS32( double v )
+{
+	if ( !( v > -2147483648.0 ) ) return v != v ? 0 : (s32)0x80000000;
+	if ( v >= 2147483647.0 ) return 0x7fffffff;
+	return (s32)v;
+}
+
+static void xform( u8 *ram, u32 mat, u32 src, u32 dst, u32 n, s32 focal, s32 cx, s32 cy )
+{
+	s32 m[ 12 ];
+	for ( u32 i = 0; i < 12; i++ )
+		m[ i ] = rd32( ram, mat + i * 4 );
+
+	for ( u32 i = 0; i < n; i++, src += 6, dst += 6 )
+	{
+		s64 x = rd16( ram, src ), y = rd16( ram, src + 2 ), z = rd16( ram, src + 4 );
+
+		// 16.16
+		s64 X = m[ 0 ] * x + m[ 1 ] * y + m[ 2 ] * z + m[ 3 ];
+		s64 Y = m[ 4 ] * x + m[ 5 ] * y + m[ 6 ] * z + m[ 7 ];
+		s64 Z = m[ 8 ] * x + m[ 9 ] * y + m[ 10 ] * z + m[ 11 ];
+
+		if ( focal == 0 )
+		{
+			wr16( ram, dst, sat16( X >> 16 ) );
+			wr16( ram, dst + 2, sat16( Y >> 16 ) );
+			wr16( ram, dst + 4, sat16( Z >> 16 ) );
+		} else
+		if ( Z < 65536 )
+		{
+			// behind the camera (or too close)
+			wr16( ram, dst, COPRO_INVALID );
+			wr16( ram, dst + 2, COPRO_INVALID );
+			wr16( ram, dst + 4, sat16( Z >> 16 ) );
+		} else
+		{
+			wr16( ram, dst, sat16( cx + X * focal / Z ) );
+			wr16( ram, dst + 2, sat16( cy - Y * focal / Z ) );
+			wr16( ram, dst + 4, sat16( Z >> 16 ) );
+		}
+	}
+}
+
+void coproRunJob( COPRO_STATE *c, COPRO_JOB *j )
+{
+	u32 *r = j->reg;
+	u8 *ram = c->ram;
+
+	// the 16 bit parameters
+	s32 P[ 8 ];
+	for ( u32 i = 0; i < 8; i++ )
+		P[ i ] = (s16)( r[ i >> 1 ] >> ( ( i & 1 ) * 16 ) );
+	#define U( i ) ( (u32)P[ i ] & 0xffff )
+
+	float a = asFloat( r[ 0 ] ), b = asFloat( r[ 1 ] );
+
+	switch ( j->cmd )
+	{
+	case COPRO_FADD:	c->reg[ 2 ] = asU32( a + b ); break;
+	case COPRO_FSUB:	c->reg[ 2 ] = asU32( a - b ); break;
+	case COPRO_FMUL:	c->reg[ 2 ] = asU32( a * b ); break;
+	case COPRO_FDIV:	c->reg[ 2 ] = asU32( a / b ); break;
+	case COPRO_FSQRT:	c->reg[ 2 ] = asU32( (float)fsqrt( a ) ); break;
+	case COPRO_ITOF:	c->reg[ 2 ] = asU32( (float)(s32)r[ 0 ] ); break;
+	case COPRO_FTOI:	c->reg[ 2 ] = toS32( a ); break;
+	case COPRO_FIXTOF:	c->reg[ 2 ] = asU32( (float)( (s32)r[ 0 ] / 65536.0 ) ); break;
+	case COPRO_FTOFIX:	c->reg[ 2 ] = toS32( a * 65536.0 ); break;
+	case COPRO_FSIN:	c->reg[ 2 ] = asU32( (float)fsin( a ) ); break;
+	case COPRO_FCOS:	c->reg[ 2 ] = asU32( (float)fcos( a ) ); break;
+	case COPRO_FATAN2:	c->reg[ 2 ] = asU32( (float)fatan2( a, b ) ); break;
+	case COPRO_ATAN2:
+	{
+		double t = fatan2( (s32)r[ 0 ], (s32)r[ 1 ] ) * ( 65536 / ( 2 * PI ) );
+		c->reg[ 2 ] = (u32)(s32)( t + ( t < 0 ? 65536 - 0.5 : 0.5 ) ) & 0xffff;
+		break;
+	}
+
+	case COPRO_XFORM:
+		xform( ram, U( 0 ), U( 1 ), U( 2 ), U( 3 ), P[ 4 ], P[ 5 ], P[ 6 ] );
+		break;
+	case COPRO_CLEAR:
+		for ( u32 i = 0; i < 8000; i++ )
+			ram[ ( U( 0 ) + i ) & 0xffff ] = P[ 1 ];
+		break;
+	case COPRO_LINE:
+		coproLine( ram, U( 0 ), P[ 1 ], P[ 2 ], P[ 3 ], P[ 4 ], P[ 5 ] );
+		break;
+	case COPRO_TRIANGLE:
+		coproTriangle( ram, U( 0 ), P[ 1 ], P[ 2 ], P[ 3 ], P[ 4 ], P[ 5 ], P[ 6 ], P[ 7 ] );
+		break;
+	case COPRO_LINES:
+	case COPRO_TRIANGLES:
+	{
+		u32 nv = j->cmd == COPRO_LINES ? 2 : 3;
+		for ( u32 i = 0; i < U( 3 ); i++ )
+		{
+			s32 vx[ 3 ], vy[ 3 ], valid = 1;
+			for ( u32 k = 0; k < nv; k++ )
+			{
+				u32 v = U( 1 ) + ram[ ( U( 2 ) + i * nv + k ) & 0xffff ] * 6;
+				vx[ k ] = rd16( ram, v );
+				vy[ k ] = rd16( ram, v + 2 );
+				if ( vx[ k ] == COPRO_INVALID ) valid = 0;
+			}
+			if ( !valid )
+				continue;
+			if ( nv == 2 )
+				coproLine( ram, U( 0 ), vx[ 0 ], vy[ 0 ], vx[ 1 ], vy[ 1 ], P[ 5 ] ); else
+				coproTriangle( ram, U( 0 ), vx[ 0 ], vy[ 0 ], vx[ 1 ], vy[ 1 ], vx[ 2 ], vy[ 2 ], P[ 5 ] );
+		}
+		break;
+	}
+
+	default:
+		c->jobError = 1;
+		break;
+	}
+	#undef U
+}
+
+u32 coproWork( COPRO_STATE *c )
+{
+	u32 n = 0;
+
+	while ( c->queueRead != c->queueWrite )
+	{
+		coproRunJob( c, &c->queue[ c->queueRead ] );
+		c->queueRead = ( c->queueRead + 1 ) & ( COPRO_QUEUE - 1 );
+		n ++;
+	}
+
+	return n;
+}
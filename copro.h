@@ -0,0 +1,319 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ copro.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - math and 3D coprocessor in IO2
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _copro_h
+#define _copro_h
+
+#include "buschain.h"
+
+//
+// Math and 3D coprocessor in IO2: the C64 writes the operands into the register file, a command into $df10 and reads
+// the results. Integer commands are executed by the FIQ handler when the command is written, the results can be read
+// with the next access. Floating point and geometry commands are stored in a queue and executed by the main loop of
+// kernel_copro.cpp (the FIQ handler must not touch the floating point registers), the C64 waits until bit 7 of the
+// status is clear before it reads their results. The geometry commands work on the 64k RAM of the coprocessor, which
+// the C64 reads and writes through an auto-incrementing port.
+//
+// $df00-$df03	A	registers, 32 bit little endian
+// $df04-$df07	B		16 bit operations use the low 16 bits, floats are IEEE 754 single precision, fixed point is 16.16
+// $df08-$df0b	C		results are stored in C (and D)
+// $df0c-$df0f	D		geometry commands take 16 bit parameters P0-P7 (P0 = $df00/01, P1 = $df02/03, ..., P7 = $df0e/0f)
+// $df10		write: command, read: status (bit 7: queue not empty, bit 6: error, bit 5: queue full)
+// $df11		read: number of queued commands
+// $df12/$df13	pointer into the RAM of the coprocessor (low/high)
+// $df14		data port: reads/writes the RAM at the pointer and increments it
+//
+// The error bit is set by a division by zero or a command written while the queue is full, and cleared by the next
+// command. A command written while the queue is full is ignored.
+//
+
+// integer commands (executed immediately)
+#define COPRO_MULS16		0x01	// C = (s16)A * (s16)B
+#define COPRO_MULU16		0x02	// C = (u16)A * (u16)B
+#define COPRO_MULS32		0x03	// D:C = (s32)A * (s32)B (64 bit)
+#define COPRO_MULU32		0x04	// D:C = A * B
+#define COPRO_DIVS16		0x05	// C = (s16)A / (s16)B, D = remainder
+#define COPRO_DIVU16		0x06
+#define COPRO_DIVS32		0x07	// C = (s32)A / (s32)B, D = remainder
+#define COPRO_DIVU32		0x08
+#define COPRO_FIXMUL		0x09	// C = A * B (16.16)
+#define COPRO_FIXDIV		0x0a	// C = A / B (16.16)
+#define COPRO_ISQRT			0x0b	// C = floor( sqrt( A ) ) (A unsigned)
+#define COPRO_FIXSQRT		0x0c	// C = sqrt( A ) (16.16)
+#define COPRO_SINCOS		0x0d	// C = sin( A ), D = cos( A ) (16.16), the angle is the low 16 bits of A, 65536 = 360 degrees
+
+// floating point commands (queued)
+#define COPRO_FADD			0x20	// C = A + B
+#define COPRO_FSUB			0x21	// C = A - B
+#define COPRO_FMUL			0x22	// C = A * B
+#define COPRO_FDIV			0x23	// C = A / B
+#define COPRO_FSQRT			0x24	// C = sqrt( A )
+#define COPRO_ITOF			0x25	// C = (float)(s32)A
+#define COPRO_FTOI			0x26	// C = (s32)A (rounded towards zero)
+#define COPRO_FIXTOF		0x27	// C = A / 65536.0
+#define COPRO_FTOFIX		0x28	// C = A * 65536 (16.16)
+#define COPRO_FSIN			0x29	// C = sin( A ) (radians)
+#define COPRO_FCOS			0x2a	// C = cos( A )
+#define COPRO_FATAN2		0x2b	// C = atan2( A, B ) (A = y, B = x)
+#define COPRO_ATAN2			0x2c	// C = atan2( A, B ) with A, B in 16.16, the angle as for COPRO_SINCOS (0..65535)
+
+// geometry commands (queued), the vertices are 6 bytes (x, y, z as s16), the bitmap has the layout of the C64 hires
+// bitmap (320x200, 8000 bytes), the modes are 0 (set pixels), 1 (clear pixels) and 2 (invert pixels)
+#define COPRO_XFORM			0x40	// P0 matrix (3x4, s32 16.16, row by row), P1 source, P2 destination, P3 number of vertices,
+									// P4 focal length (0: no projection), P5/P6 center of the screen
+#define COPRO_CLEAR			0x41	// P0 bitmap, P1 value
+#define COPRO_LINE			0x42	// P0 bitmap, P1/P2 x0/y0, P3/P4 x1/y1, P5 mode
+#define COPRO_TRIANGLE		0x43	// P0 bitmap, P1/P2 x0/y0, P3/P4 x1/y1, P5/P6 x2/y2, P7 mode
+#define COPRO_LINES			0x44	// P0 bitmap, P1 vertices, P2 index pairs (u8), P3 number of lines, P5 mode
+#define COPRO_TRIANGLES		0x45	// P0 bitmap, P1 vertices, P2 index triples (u8), P3 number of triangles, P5 mode
+
+#define COPRO_STATUS_BUSY	0x80
+#define COPRO_STATUS_ERROR	0x40
+#define COPRO_STATUS_FULL	0x20
+
+// a projected vertex behind the camera
+#define COPRO_INVALID		( (s16)0x8000 )
+
+#define COPRO_BITMAP_WIDTH	320
+#define COPRO_BITMAP_HEIGHT	200
+
+#define COPRO_QUEUE			64
+
+typedef struct
+{
+	u32 cmd;
+	u32 reg[ 4 ];
+} COPRO_JOB;
+
+typedef struct
+{
+	u32 reg[ 4 ];					// A, B, C, D
+	u32 ptr;
+	u32 error;
+
+	COPRO_JOB queue[ COPRO_QUEUE ];
+	volatile u32 queueWrite, queueRead;
+	volatile u32 jobError;			// set by the main loop
+
+	u8 ram[ 65536 ];
+} COPRO_STATE;
+
+// quarter sine wave for COPRO_SINCOS (16.16), 1024 steps and a copy of the last entry
+extern s32 coproSinTab[ 1026 ];
+
+//
+// register interface (called from the FIQ handler, integer only)
+//
+static inline u32 coproISqrt( u64 a )
+{
+	u64 r = 0, b = (u64)1 << 62;
+	while ( b > a ) b >>= 2;
+	while ( b )
+	{
+		if ( a >= r + b )
+		{
+			a -= r + b;
+			r = ( r >> 1 ) + b;
+		} else
+			r >>= 1;
+		b >>= 2;
+	}
+	return (u32)r;
+}
+
+static inline s32 coproSin16( u32 angle )
+{
+	// mirror the angle into the first quarter, interpolate between the table entries (16 steps each)
+	u32 q = ( angle >> 14 ) & 3, p = angle & 16383;
+	if ( q & 1 )
+		p = 16384 - p;
+
+	u32 i = p >> 4, f = p & 15;
+	s32 s = coproSinTab[ i ] + ( ( ( coproSinTab[ i + 1 ] - coproSinTab[ i ] ) * (s32)f ) >> 4 );
+
+	return ( q & 2 ) ? -s : s;
+}
+
+static inline void coproExecute( COPRO_STATE *c, u32 cmd )
+{
+	u32 *r = c->reg;
+	c->error = 0;
+
+	switch ( cmd )
+	{
+	case COPRO_MULS16: r[ 2 ] = (s32)(s16)r[ 0 ] * (s32)(s16)r[ 1 ]; break;
+	case COPRO_MULU16: r[ 2 ] = (u32)(u16)r[ 0 ] * (u32)(u16)r[ 1 ]; break;
+	case COPRO_MULS32:
+	{
+		s64 m = (s64)(s32)r[ 0 ] * (s32)r[ 1 ];
+		r[ 2 ] = (u32)m; r[ 3 ] = (u32)( (u64)m >> 32 );
+		break;
+	}
+	case COPRO_MULU32:
+	{
+		u64 m = (u64)r[ 0 ] * r[ 1 ];
+		r[ 2 ] = (u32)m; r[ 3 ] = (u32)( m >> 32 );
+		break;
+	}
+	case COPRO_DIVS16:
+		if ( (s16)r[ 1 ] == 0 ) { c->error = 1; break; }
+		r[ 2 ] = (s32)(s16)r[ 0 ] / (s16)r[ 1 ];
+		r[ 3 ] = (s32)(s16)r[ 0 ] % (s16)r[ 1 ];
+		break;
+	case COPRO_DIVU16:
+		if ( (u16)r[ 1 ] == 0 ) { c->error = 1; break; }
+		r[ 2 ] = (u16)r[ 0 ] / (u16)r[ 1 ];
+		r[ 3 ] = (u16)r[ 0 ] % (u16)r[ 1 ];
+		break;
+	case COPRO_DIVS32:
+		if ( r[ 1 ] == 0 ) { c->error = 1; break; }
+		// the only overflow: -2^31 / -1
+		if ( r[ 0 ] == 0x80000000 && r[ 1 ] == 0xffffffff ) { r[ 2 ] = 0x80000000; r[ 3 ] = 0; break; }
+		r[ 2 ] = (s32)r[ 0 ] / (s32)r[ 1 ];
+		r[ 3 ] = (s32)r[ 0 ] % (s32)r[ 1 ];
+		break;
+	case COPRO_DIVU32:
+		if ( r[ 1 ] == 0 ) { c->error = 1; break; }
+		r[ 2 ] = r[ 0 ] / r[ 1 ];
+		r[ 3 ] = r[ 0 ] % r[ 1 ];
+		break;
+	case COPRO_FIXMUL: r[ 2 ] = (u32)( ( (s64)(s32)r[ 0 ] * (s32)r[ 1 ] ) >> 16 ); break;
+	case COPRO_FIXDIV:
+		if ( r[ 1 ] == 0 ) { c->error = 1; break; }
+		r[ 2 ] = (u32)( ( (s64)(s32)r[ 0 ] * 65536 ) / (s32)r[ 1 ] );
+		break;
+	case COPRO_ISQRT: r[ 2 ] = coproISqrt( r[ 0 ] ); break;
+	case COPRO_FIXSQRT: r[ 2 ] = coproISqrt( (u64)r[ 0 ] << 16 ); break;
+	case COPRO_SINCOS:
+		r[ 2 ] = coproSin16( r[ 0 ] );
+		r[ 3 ] = coproSin16( r[ 0 ] + 16384 );
+		break;
+	default:
+	{
+		// everything else is executed by the main loop
+		u32 w = c->queueWrite;
+		if ( ( ( w + 1 ) & ( COPRO_QUEUE - 1 ) ) == c->queueRead )
+		{
+			c->error = 1;
+			break;
+		}
+		COPRO_JOB *j = &c->queue[ w ];
+		j->cmd = cmd;
+		j->reg[ 0 ] = r[ 0 ]; j->reg[ 1 ] = r[ 1 ]; j->reg[ 2 ] = r[ 2 ]; j->reg[ 3 ] = r[ 3 ];
+		c->queueWrite = ( w + 1 ) & ( COPRO_QUEUE - 1 );
+		break;
+	}
+	}
+}
+
+static inline u32 coproQueued( COPRO_STATE *c )
+{
+	return ( c->queueWrite - c->queueRead ) & ( COPRO_QUEUE - 1 );
+}
+
+static inline u32 coproStatus( COPRO_STATE *c )
+{
+	u32 n = coproQueued( c );
+	return ( n ? COPRO_STATUS_BUSY : 0 ) | ( n == COPRO_QUEUE - 1 ? COPRO_STATUS_FULL : 0 ) |
+		   ( ( c->error | c->jobError ) ? COPRO_STATUS_ERROR : 0 );
+}
+
+// bus device for the chains of buschain.h
+template <COPRO_STATE *S>
+class CDevCopro : public CDevNone
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b )
+	{
+		b.preloadL1( &S->ram[ S->ptr ] );
+	}
+
+	template <class BUS> static inline u32 match( BUS &b )	{ return b.io2() && b.addrIO() < 0x15; }
+
+	template <class BUS> static inline u32 read( BUS &b )
+	{
+		u32 a = b.addrIO();
+		if ( a < 16 )
+			return ( S->reg[ a >> 2 ] >> ( ( a & 3 ) * 8 ) ) & 255;
+
+		switch ( a )
+		{
+		case 0x10: return coproStatus( S );
+		case 0x11: return coproQueued( S );
+		case 0x12: return S->ptr & 255;
+		case 0x13: return S->ptr >> 8;
+		default:
+		{
+			u32 D = S->ram[ S->ptr ];
+			S->ptr = ( S->ptr + 1 ) & 0xffff;
+			return D;
+		}
+		}
+	}
+
+	template <class BUS> static inline void write( BUS &b )
+	{
+		u32 a = b.addrIO(), D = b.get();
+		if ( a < 16 )
+		{
+			u32 s = ( a & 3 ) * 8;
+			S->reg[ a >> 2 ] = ( S->reg[ a >> 2 ] & ~( 255U << s ) ) | ( D << s );
+			return;
+		}
+
+		switch ( a )
+		{
+		case 0x10:
+			S->jobError = 0;
+			coproExecute( S, D );
+			break;
+		case 0x12: S->ptr = ( S->ptr & 0xff00 ) | D; break;
+		case 0x13: S->ptr = ( S->ptr & 0x00ff ) | ( D << 8 ); break;
+		case 0x14:
+			S->ram[ S->ptr ] = D;
+			S->ptr = ( S->ptr + 1 ) & 0xffff;
+			break;
+		}
+	}
+};
+
+//
+// main loop
+//
+extern void coproInit( COPRO_STATE *c );
+
+// executes the queued commands, returns the number of commands executed
+extern u32 coproWork( COPRO_STATE *c );
+
+// the commands executed by coproWork (used by CoproBench to check them)
+extern void coproRunJob( COPRO_STATE *c, COPRO_JOB *j );
+extern void coproLine( u8 *ram, u32 bitmap, s32 x0, s32 y0, s32 x1, s32 y1, u32 mode );
+extern void coproTriangle( u8 *ram, u32 bitmap, s32 x0, s32 y0, s32 x1, s32 y1, s32 x2, s32 y2, u32 mode );
+
+#endif
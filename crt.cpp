@@ -28,6 +28,7 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "crt.h"
+#include "arena.h"
 
 u32 swapBytesU32( u8 *buf )
 {
@@ -137,11 +138,14 @@ int readCRTHeader( CLogger *logger, CRT_HEADER *crtHeader, const char *DRIVE, co
 // .CRT reading / compatibility function
 void readCRTFile( CLogger *logger, CRT_HEADER * crtHeader, const char *DRIVE, const char *FILENAME, u8 *flash, volatile u8 *bankswitchType, volatile u32 *ROM_LH, volatile u32 *nBanks, bool getRAW )
 {
-		u8 rawCRT[ 1032 * 1024 ];
+		// the raw file is only needed until it is parsed
+		u32 arenaMarker = arenaMark();
+		u8 *rawCRT = (u8 *)arenaAlloc( logger, "rawCRT", 1032 * 1024 );
 		u32 filesize = 0;
 		readCRTFileSimple( logger, (char*)DRIVE, (char*)FILENAME, rawCRT, filesize );
 		// now "parse" the file which we already have in memory
 		parseCRTInMemory( logger, crtHeader, flash, bankswitchType, ROM_LH, nBanks, getRAW, rawCRT, filesize );
+		arenaRelease( arenaMarker );
 }
 
 void readCRTFileSimple( CLogger *logger, const char *DRIVE, const char *FILENAME, u8 * rawCRT, u32 & filesize )
@@ -185,33 +189,10 @@ void readCRTFileSimple( CLogger *logger, const char *DRIVE, const char *FILENAME
 #endif		
 }
 	
-void parseCRTInMemory( CLogger *logger, CRT_HEADER *crtHeader, u8 *flash, volatile u8 *bankswitchType, volatile u32 *ROM_LH, volatile u32 *nBanks, bool getRAW, u8 * rawCRT, u32 & filesize )
+// determines how the cartridge is emulated from the hardware type in the .CRT header
+static void getCRTBankswitchType( CRT_HEADER *header, volatile u8 *bankswitchType, volatile u32 *ROM_LH )
 {
-	CRT_HEADER header;
-	u8 *crt = rawCRT;
-	u8 *crtEnd = crt + filesize;
-
-	readCRT( &header.signature, 16 );
-
-	if ( memcmp( CRT_HEADER_SIG, header.signature, 16 ) )
-	{
-		logger->Write( "RaspiFlash", LogPanic, "no CRT file." );
-	}
-
-	readCRT( &header.length, 4 );
-	readCRT( &header.version, 2 );
-	readCRT( &header.type, 2 );
-	readCRT( &header.exrom, 1 );
-	readCRT( &header.game, 1 );
-	readCRT( &header.reserved, 6 );
-	readCRT( &header.name, 32 );
-	header.name[ 32 ] = 0;
-
-	header.length = swapBytesU32( (u8*)&header.length );
-	header.version = swapBytesU16( (u8*)&header.version );
-	header.type = swapBytesU16( (u8*)&header.type );
-
-	switch ( header.type ) {
+	switch ( header->type ) {
 	case 32:
 		//logger->Write( "RaspiFlash", LogNotice, "EasyFlash CRT" );
 		*bankswitchType = BS_EASYFLASH;
@@ -231,7 +212,7 @@ void parseCRTInMemory( CLogger *logger, CRT_HEADER *crtHeader, u8 *flash, volati
 		*ROM_LH = bROML;
 		break;
 	case 57:
-		if ( header.reserved[ 0 ] == 0 )
+		if ( header->reserved[ 0 ] == 0 )
 			*bankswitchType = BS_RGCD; else
 			*bankswitchType = BS_HUCKY; 
 		*ROM_LH = bROML;
@@ -288,6 +269,143 @@ void parseCRTInMemory( CLogger *logger, CRT_HEADER *crtHeader, u8 *flash, volati
 		*ROM_LH = 0;
 		break;
 	}
+}
+
+// copies the ROM data of one CHIP packet (the header is already parsed into 'chip') into 'flash', returns the number of bytes used
+static u32 copyCRTChip( CHIP_HEADER *chip, u8 *data, u8 *flash, u8 bankswitchType, u16 crtType, volatile u32 *ROM_LH, bool getRAW )
+{
+	u8 *crt = data;
+
+	// MagicDesk and some others only uses the low-bank
+	if ( bankswitchType == BS_MAGICDESK || 
+		 bankswitchType == BS_C64GS || 
+		 bankswitchType == BS_FUNPLAY || 
+		 bankswitchType == BS_PROPHET || 
+		 bankswitchType == BS_OCEAN || 
+		 bankswitchType == BS_GMOD2 || 
+		 bankswitchType == BS_HUCKY || 
+		 bankswitchType == BS_RGCD || 
+		 crtType == 36 /* Retro Replay */ )
+	{
+		*ROM_LH = bROML;
+
+		u32 nBytes = min( 8192, chip->rom_length );
+
+		if ( getRAW )
+		{
+			for ( register u32 i = 0; i < nBytes; i++ )
+				flash[ chip->bank * 8192 + i ] = crt[ i ];
+		} else
+		{
+			for ( register u32 i = 0; i < nBytes; i++ )
+			{
+				u32 realAdr = ( ( i & 255 ) << 5 ) | ( ( i >> 8 ) & 31 );
+				flash[ chip->bank * 8192 + realAdr ] = crt[ i ];
+			}
+		}
+
+		crt += nBytes;
+	} else
+	{
+		if ( chip->adr == 0x8000 )
+		{
+			*ROM_LH |= bROML;
+
+			u32 nBytes = min( 8192, chip->rom_length );
+
+			if ( getRAW )
+			{
+				//logger->Write( "RaspiFlash", LogNotice, "bank=%d, bytes=%d", chip->bank, chip->rom_length );
+				for ( register u32 i = 0; i < nBytes; i++ )
+					flash[ ( chip->bank * 8192 + i ) * 2 + 0 ] = crt[ i ];
+			} else
+			{
+				for ( register u32 i = 0; i < nBytes; i++ )
+				{
+					u32 realAdr = ( ( i & 255 ) << 5 ) | ( ( i >> 8 ) & 31 );
+					flash[ ( chip->bank * 8192 + realAdr ) * 2 + 0 ] = crt[ i ];
+				}
+			}
+
+			crt += nBytes;
+
+			if ( chip->rom_length > 8192 )
+			{
+				*ROM_LH |= bROMH;
+
+				nBytes = min( 8192, chip->rom_length - 8192 );
+
+				if ( getRAW )
+				{
+					for ( register u32 i = 0; i < nBytes; i++ )
+						flash[ ( chip->bank * 8192 + i ) * 2 + 1 ] = crt[ i ];
+				} else
+				{
+					for ( register u32 i = 0; i < nBytes; i++ )
+					{
+						u32 realAdr = ( ( i & 255 ) << 5 ) | ( ( i >> 8 ) & 31 );
+						flash[ ( chip->bank * 8192 + realAdr ) * 2 + 1 ] = crt[ i ];
+					}
+				}
+
+				crt += nBytes;
+			}
+		} else
+		{
+			u32 ofs = 0;
+			// todo: calculate offset correctly!
+			if ( chip->adr == 0xf000 || chip->adr == 0xb000 )
+				ofs = 4096;
+
+			*ROM_LH |= bROMH;
+
+			if ( getRAW )
+			{
+				for ( register u32 i = 0; i < 8192 - ofs; i++ )
+					flash[ ( chip->bank * 8192 + i + ofs ) * 2 + 1 ] = crt[ i ];
+			} else
+			{
+				for ( register u32 i = 0; i < 8192 - ofs; i++ )
+				{
+					u32 realAdr = ( ( (i+ofs) & 255 ) << 5 ) | ( ( (i+ofs) >> 8 ) & 31 );
+					flash[ ( chip->bank * 8192 + realAdr ) * 2 + 1 ] = crt[ i ];
+				}
+			}
+
+			crt += 8192 - ofs;
+		}
+	}
+
+	return (u32)( crt - data );
+}
+
+void parseCRTInMemory( CLogger *logger, CRT_HEADER *crtHeader, u8 *flash, volatile u8 *bankswitchType, volatile u32 *ROM_LH, volatile u32 *nBanks, bool getRAW, u8 * rawCRT, u32 & filesize )
+{
+	CRT_HEADER header;
+	u8 *crt = rawCRT;
+	u8 *crtEnd = crt + filesize;
+
+	readCRT( &header.signature, 16 );
+
+	if ( memcmp( CRT_HEADER_SIG, header.signature, 16 ) )
+	{
+		logger->Write( "RaspiFlash", LogPanic, "no CRT file." );
+	}
+
+	readCRT( &header.length, 4 );
+	readCRT( &header.version, 2 );
+	readCRT( &header.type, 2 );
+	readCRT( &header.exrom, 1 );
+	readCRT( &header.game, 1 );
+	readCRT( &header.reserved, 6 );
+	readCRT( &header.name, 32 );
+	header.name[ 32 ] = 0;
+
+	header.length = swapBytesU32( (u8*)&header.length );
+	header.version = swapBytesU16( (u8*)&header.version );
+	header.type = swapBytesU16( (u8*)&header.type );
+
+	getCRTBankswitchType( &header, bankswitchType, ROM_LH );
 
 	#ifdef CONSOLE_DEBUG
 	logger->Write( "RaspiFlash", LogNotice, "length=%d", header.length );
@@ -333,112 +451,251 @@ void parseCRTInMemory( CLogger *logger, CRT_HEADER *crtHeader, u8 *flash, volati
 		logger->Write( "RaspiFlash", LogNotice, "rom length=%d", chip.rom_length );
 		#endif
 
-		// MagicDesk and some others only uses the low-bank
-		if ( (*bankswitchType) == BS_MAGICDESK || 
-			 (*bankswitchType) == BS_C64GS || 
-			 (*bankswitchType) == BS_FUNPLAY || 
-			 (*bankswitchType) == BS_PROPHET || 
-			 (*bankswitchType) == BS_OCEAN || 
-			 (*bankswitchType) == BS_GMOD2 || 
-			 (*bankswitchType) == BS_HUCKY || 
-			 (*bankswitchType) == BS_RGCD || 
-			 header.type == 36 /* Retro Replay */ )
-		{
-			*ROM_LH = bROML;
+		crt += copyCRTChip( &chip, crt, flash, *bankswitchType, header.type, ROM_LH, getRAW );
 
-			u32 nBytes = min( 8192, chip.rom_length );
+		if ( chip.bank > *nBanks )
+			*nBanks = chip.bank;
+	}
 
-			if ( getRAW )
-			{
-				for ( register u32 i = 0; i < nBytes; i++ )
-					flash[ chip.bank * 8192 + i ] = crt[ i ];
-			} else
-			{
-				for ( register u32 i = 0; i < nBytes; i++ )
-				{
-					u32 realAdr = ( ( i & 255 ) << 5 ) | ( ( i >> 8 ) & 31 );
-					flash[ chip.bank * 8192 + realAdr ] = crt[ i ];
-				}
-			}
+	memcpy( crtHeader, &header, sizeof( CRT_HEADER ) );
+	(*nBanks) ++;
+}
 
-			crt += nBytes;
-		} else
-		{
-			if ( chip.adr == 0x8000 )
-			{
-				*ROM_LH |= bROML;
+//
+// .CRT reading chip by chip: crtStreamOpen reads the header, every call of crtStreamNextChip reads and copies one CHIP packet
+// (this allows to start a cartridge before all banks are loaded), crtStreamClose/crtStreamResume allow accessing other files in between
+//
+static u8 chipData[ 16384 ];
 
-				u32 nBytes = min( 8192, chip.rom_length );
+static void parseChipHeader( CHIP_HEADER *chip, u8 *rawChip )
+{
+	u8 *crt = rawChip;
+
+	readCRT( &chip->signature, 4 );
+	readCRT( &chip->total_length, 4 );
+	readCRT( &chip->type, 2 );
+	readCRT( &chip->bank, 2 );
+	readCRT( &chip->adr, 2 );
+	readCRT( &chip->rom_length, 2 );
+
+	chip->total_length = swapBytesU32( (u8*)&chip->total_length );
+	chip->type = swapBytesU16( (u8*)&chip->type );
+	chip->bank = swapBytesU16( (u8*)&chip->bank );
+	chip->adr = swapBytesU16( (u8*)&chip->adr );
+	chip->rom_length = swapBytesU16( (u8*)&chip->rom_length );
+}
 
-				if ( getRAW )
-				{
-					//logger->Write( "RaspiFlash", LogNotice, "bank=%d, bytes=%d", chip.bank, chip.rom_length );
-					for ( register u32 i = 0; i < nBytes; i++ )
-						flash[ ( chip.bank * 8192 + i ) * 2 + 0 ] = crt[ i ];
-				} else
-				{
-					for ( register u32 i = 0; i < nBytes; i++ )
-					{
-						u32 realAdr = ( ( i & 255 ) << 5 ) | ( ( i >> 8 ) & 31 );
-						flash[ ( chip.bank * 8192 + realAdr ) * 2 + 0 ] = crt[ i ];
-					}
-				}
+// ROML (1) and/or ROMH (2) filled by a CHIP packet, and the number of ROM bytes copyCRTChip uses of it
+static u32 chipHalves( CHIP_HEADER *chip, u8 bankswitchType, u32 *nUsed )
+{
+	if ( bankswitchType != BS_EASYFLASH )
+	{
+		*nUsed = min( 8192, chip->rom_length );
+		return 1;
+	}
 
-				crt += nBytes;
+	if ( chip->adr == 0x8000 )
+	{
+		*nUsed = min( 16384, chip->rom_length );
+		return ( chip->rom_length > 8192 ) ? 3 : 1;
+	}
 
-				if ( chip.rom_length > 8192 )
-				{
-					*ROM_LH |= bROMH;
+	*nUsed = ( chip->adr == 0xf000 || chip->adr == 0xb000 ) ? 4096 : 8192;
+	return 2;
+}
 
-					nBytes = min( 8192, chip.rom_length - 8192 );
+// EasyFlash: the CHIP packets of a bank need not be adjacent (e.g. all ROML packets first, then all ROMH packets),
+// the headers are read beforehand to know which halves a bank is complete with
+static void scanCRTChips( CLogger *logger, CRT_STREAM *s, volatile u32 *nBanks )
+{
+	u32 pos = 64, maxBank = 0;
 
-					if ( getRAW )
-					{
-						for ( register u32 i = 0; i < nBytes; i++ )
-							flash[ ( chip.bank * 8192 + i ) * 2 + 1 ] = crt[ i ];
-					} else
-					{
-						for ( register u32 i = 0; i < nBytes; i++ )
-						{
-							u32 realAdr = ( ( i & 255 ) << 5 ) | ( ( i >> 8 ) & 31 );
-							flash[ ( chip.bank * 8192 + realAdr ) * 2 + 1 ] = crt[ i ];
-						}
-					}
+	while ( pos + 16 <= s->filesize )
+	{
+		CHIP_HEADER chip;
+		u8 rawChip[ 16 ];
+		u32 nBytesRead, nUsed;
 
-					crt += nBytes;
-				}
-			} else
-			{
-				u32 ofs = 0;
-				// todo: calculate offset correctly!
-				if ( chip.adr == 0xf000 || chip.adr == 0xb000 )
-					ofs = 4096;
+		if ( f_lseek( &s->file, pos ) != FR_OK ||
+			 f_read( &s->file, rawChip, 16, &nBytesRead ) != FR_OK || nBytesRead != 16 )
+			logger->Write( "RaspiFlash", LogPanic, "Read error" );
 
-				*ROM_LH |= bROMH;
+		parseChipHeader( &chip, rawChip );
 
-				if ( getRAW )
-				{
-					for ( register u32 i = 0; i < 8192 - ofs; i++ )
-						flash[ ( chip.bank * 8192 + i + ofs ) * 2 + 1 ] = crt[ i ];
-				} else
-				{
-					for ( register u32 i = 0; i < 8192 - ofs; i++ )
-					{
-						u32 realAdr = ( ( (i+ofs) & 255 ) << 5 ) | ( ( (i+ofs) >> 8 ) & 31 );
-						flash[ ( chip.bank * 8192 + realAdr ) * 2 + 1 ] = crt[ i ];
-					}
-				}
+		if ( memcmp( CHIP_HEADER_SIG, chip.signature, 4 ) )
+			logger->Write( "RaspiFlash", LogPanic, "no valid CHIP section." );
 
-				crt += 8192 - ofs;
-			}
-		}
+		s->bankHalves[ chip.bank & 127 ] |= chipHalves( &chip, s->bankswitchType, &nUsed );
+		if ( chip.bank > maxBank )
+			maxBank = chip.bank;
 
-		if ( chip.bank > *nBanks )
-			*nBanks = chip.bank;
+		pos += 16 + nUsed;
 	}
 
+	*nBanks = maxBank + 1;
+
+	if ( f_lseek( &s->file, 64 ) != FR_OK )
+		logger->Write( "RaspiFlash", LogPanic, "Read error" );
+}
+
+static void openCRTStreamFile( CLogger *logger, CRT_STREAM *s, const char *DRIVE, const char *FILENAME )
+{
+#ifndef WITH_NET
+	// mount file system
+	if ( f_mount( &s->fileSystem, DRIVE, 1 ) != FR_OK )
+		logger->Write( "RaspiFlash", LogPanic, "Cannot mount drive: %s", DRIVE );
+	s->drive = DRIVE;
+#endif
+
+	if ( f_open( &s->file, FILENAME, FA_READ | FA_OPEN_EXISTING ) != FR_OK )
+		logger->Write( "RaspiFlash", LogPanic, "Cannot open file: %s", FILENAME );
+
+	s->open = 1;
+}
+
+void crtStreamOpen( CLogger *logger, CRT_STREAM *s, CRT_HEADER *crtHeader, const char *DRIVE, const char *FILENAME, volatile u8 *bankswitchType, volatile u32 *ROM_LH, volatile u32 *nBanks )
+{
+	CRT_HEADER header;
+
+	openCRTStreamFile( logger, s, DRIVE, FILENAME );
+
+	// get filesize
+	FILINFO info;
+	f_stat( FILENAME, &info );
+	s->filesize = min( (u32)info.fsize, 1032 * 1024 );
+
+	u8 rawCRT[ 64 ];
+	u32 nBytesRead;
+	if ( f_read( &s->file, rawCRT, 64, &nBytesRead ) != FR_OK || nBytesRead != 64 )
+		logger->Write( "RaspiFlash", LogPanic, "Read error" );
+
+	u8 *crt = rawCRT;
+
+	readCRT( &header.signature, 16 );
+
+	if ( memcmp( CRT_HEADER_SIG, header.signature, 16 ) )
+	{
+		logger->Write( "RaspiFlash", LogPanic, "no CRT file." );
+	}
+
+	readCRT( &header.length, 4 );
+	readCRT( &header.version, 2 );
+	readCRT( &header.type, 2 );
+	readCRT( &header.exrom, 1 );
+	readCRT( &header.game, 1 );
+	readCRT( &header.reserved, 6 );
+	readCRT( &header.name, 32 );
+	header.name[ 32 ] = 0;
+
+	header.length = swapBytesU32( (u8*)&header.length );
+	header.version = swapBytesU16( (u8*)&header.version );
+	header.type = swapBytesU16( (u8*)&header.type );
+
+	getCRTBankswitchType( &header, bankswitchType, ROM_LH );
+
+	s->pos = 64;
+	s->crtType = header.type;
+	s->bankswitchType = *bankswitchType;
+
+	// the number of banks is known when the last CHIP packet has been read, until then we assume all packets contain 8k
+	*nBanks = ( s->filesize - 64 ) / ( 16 + 8192 );
+	if ( s->bankswitchType == BS_EASYFLASH )
+		*nBanks /= 2;
+	s->maxBank = 0;
+
+	// the other types have one 8k chip per bank
+	memset( s->bankHalves, s->bankswitchType == BS_EASYFLASH ? 0 : 1, 128 );
+	memset( s->bankLoaded, 0, 128 );
+	if ( s->bankswitchType == BS_EASYFLASH )
+		scanCRTChips( logger, s, nBanks );
+
 	memcpy( crtHeader, &header, sizeof( CRT_HEADER ) );
-	(*nBanks) ++;
+}
+
+// returns the bank of the CHIP packet which has been copied to 'flash', or -1 if the end of the file is reached
+int crtStreamNextChip( CLogger *logger, CRT_STREAM *s, u8 *flash, volatile u32 *ROM_LH, volatile u32 *nBanks, bool getRAW )
+{
+	if ( !s->open || s->pos + 16 > s->filesize )
+	{
+		*nBanks = s->maxBank + 1;
+		return -1;
+	}
+
+	CHIP_HEADER chip;
+	u8 rawChip[ 16 ];
+	u32 nBytesRead;
+
+	if ( f_read( &s->file, rawChip, 16, &nBytesRead ) != FR_OK || nBytesRead != 16 )
+		logger->Write( "RaspiFlash", LogPanic, "Read error" );
+
+	parseChipHeader( &chip, rawChip );
+
+	if ( memcmp( CHIP_HEADER_SIG, chip.signature, 4 ) )
+	{
+		logger->Write( "RaspiFlash", LogPanic, "no valid CHIP section." );
+	}
+
+	s->pos += 16;
+
+	// read the ROM data of this packet only (copyCRTChip may look at up to 16k)
+	u32 nBytes = 0;
+	if ( chip.total_length > 16 )
+		nBytes = min( min( chip.total_length - 16, 16384 ), s->filesize - s->pos );
+
+	if ( f_read( &s->file, chipData, nBytes, &nBytesRead ) != FR_OK || nBytesRead != nBytes )
+		logger->Write( "RaspiFlash", LogError, "Read error" );
+
+	memset( &chipData[ nBytes ], 0, 16384 - nBytes );
+
+	u32 nUsed = copyCRTChip( &chip, chipData, flash, s->bankswitchType, s->crtType, ROM_LH, getRAW );
+
+	// same as parseCRTInMemory: the next packet starts after the bytes which have been used
+	s->pos += nUsed;
+	if ( nUsed != nBytes )
+		f_lseek( &s->file, s->pos );
+
+	u32 nUsedScan;
+	s->bankLoaded[ chip.bank & 127 ] |= chipHalves( &chip, s->bankswitchType, &nUsedScan );
+
+	if ( chip.bank > s->maxBank )
+		s->maxBank = chip.bank;
+	if ( s->maxBank + 1 > *nBanks )
+		*nBanks = s->maxBank + 1;
+
+	return chip.bank;
+}
+
+// all CHIP packets of a bank have been copied (banks not contained in the file are complete at the end of the file only)
+int crtStreamBankComplete( CRT_STREAM *s, u32 bank )
+{
+	u32 halves = s->bankHalves[ bank & 127 ];
+	return halves && ( s->bankLoaded[ bank & 127 ] & halves ) == halves;
+}
+
+void crtStreamClose( CLogger *logger, CRT_STREAM *s )
+{
+	if ( !s->open )
+		return;
+
+	if ( f_close( &s->file ) != FR_OK )
+		logger->Write( "RaspiFlash", LogPanic, "Cannot close file" );
+
+#ifndef WITH_NET
+	// unmount file system
+	if ( f_mount( 0, s->drive, 0 ) != FR_OK )
+		logger->Write( "RaspiFlash", LogPanic, "Cannot unmount drive: %s", s->drive );
+#endif
+
+	s->open = 0;
+}
+
+// continues reading after crtStreamClose
+void crtStreamResume( CLogger *logger, CRT_STREAM *s, const char *DRIVE, const char *FILENAME )
+{
+	openCRTStreamFile( logger, s, DRIVE, FILENAME );
+
+	if ( f_lseek( &s->file, s->pos ) != FR_OK )
+		logger->Write( "RaspiFlash", LogPanic, "Cannot seek in file: %s", FILENAME );
 }
 
 // very lazy implementation of writing changes back to a .CRT file:
@@ -475,7 +732,8 @@ void writeChanges2CRTFile( CLogger *logger, const char *DRIVE, const char *FILEN
 
 	// read data in one big chunk
 	u32 nBytesRead;
-	u8 rawCRT[ 1027 * 1024 ];
+	u32 arenaMarker = arenaMark();
+	u8 *rawCRT = (u8 *)arenaAlloc( logger, "rawCRT", 1027 * 1024 );
 	result = f_read( &file, rawCRT, filesize, &nBytesRead );
 
 	if ( result != FR_OK )
@@ -516,6 +774,7 @@ void writeChanges2CRTFile( CLogger *logger, const char *DRIVE, const char *FILEN
 		if ( f_mount( 0, DRIVE, 0 ) != FR_OK )
 			logger->Write( "RaspiFlash", LogPanic, "Cannot unmount drive: %s", DRIVE );
 		#endif
+		arenaRelease( arenaMarker );
 		return;
 	}
 
@@ -622,6 +881,8 @@ void writeChanges2CRTFile( CLogger *logger, const char *DRIVE, const char *FILEN
 	if ( f_close( &file ) != FR_OK )
 		logger->Write( "RaspiFlash", LogPanic, "Cannot close file" );
 
+	arenaRelease( arenaMarker );
+
 #ifndef WITH_NET
 	// unmount file system
 	if ( f_mount( 0, DRIVE, 0 ) != FR_OK )
@@ -82,6 +82,23 @@ typedef struct  {
 	u8  data[ 8192 ];
 } CHIP_HEADER;
 
+// state of reading a .CRT chip by chip (see crtStreamOpen)
+typedef struct {
+	FIL	file;
+#ifndef WITH_NET
+	FATFS fileSystem;
+	const char *drive;
+#endif
+	u32 open;
+	u32 filesize, pos;
+	u16 crtType;
+	u8  bankswitchType;
+	u32 maxBank;
+	// ROML (bit 0) and ROMH (bit 1) of each bank: contained in the file, and copied so far
+	u8  bankHalves[ 128 ];
+	u8  bankLoaded[ 128 ];
+} CRT_STREAM;
+
 int  readCRTHeader( CLogger *logger, CRT_HEADER *crtHeader, const char *DRIVE, const char *FILENAME );
 void readCRTFile( CLogger *logger, CRT_HEADER *crtHeader, const char *DRIVE, const char *FILENAME, u8 *flash, volatile u8 *bankswitchType, volatile u32 *ROM_LH, volatile u32 *nBanks, bool getRAW = false );
 void readCRTFileSimple( CLogger *logger, const char *DRIVE, const char *FILENAME, u8 * rawCRT, u32 & filesize );
@@ -89,4 +106,10 @@ void writeChanges2CRTFile( CLogger *logger, const char *DRIVE, const char *FILEN
 int  checkCRTFile( CLogger *logger, const char *DRIVE, const char *FILENAME, u32 *error );
 void parseCRTInMemory( CLogger *logger, CRT_HEADER *crtHeader, u8 *flash, volatile u8 *bankswitchType, volatile u32 *ROM_LH, volatile u32 *nBanks, bool getRAW, u8 * rawCRT, u32 & filesize );
 
+void crtStreamOpen( CLogger *logger, CRT_STREAM *s, CRT_HEADER *crtHeader, const char *DRIVE, const char *FILENAME, volatile u8 *bankswitchType, volatile u32 *ROM_LH, volatile u32 *nBanks );
+int  crtStreamNextChip( CLogger *logger, CRT_STREAM *s, u8 *flash, volatile u32 *ROM_LH, volatile u32 *nBanks, bool getRAW = false );
+int  crtStreamBankComplete( CRT_STREAM *s, u32 bank );
+void crtStreamClose( CLogger *logger, CRT_STREAM *s );
+void crtStreamResume( CLogger *logger, CRT_STREAM *s, const char *DRIVE, const char *FILENAME );
+
 #endif
@@ -0,0 +1,282 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ decrunch.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - decrunch service in IO2/ROML
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "decrunch.h"
+#include <circle/util.h>
+
+#define LZ4_MAGIC			0x184d2204
+#define LZ4_MAGIC_LEGACY	0x184c2102
+#define LZ4_SKIPPABLE		0x184d2a50		// 0x184d2a50 - 0x184d2a5f
+
+#define DECRUNCH_ERROR		-1
+#define DECRUNCH_ABORTED	-2
+
+// the output and (if the service is running) the request it belongs to
+typedef struct
+{
+	u8  *out;
+	u32 pos, max;
+	DECRUNCH_STATE *S;
+	u32 seq;
+} DECRUNCH_OUTPUT;
+
+// makes the bytes written so far visible to the FIQ handler, returns 0 if there is a newer request
+static inline u32 publish( DECRUNCH_OUTPUT *o )
+{
+	if ( o->S == NULL )
+		return 1;
+	__atomic_store_n( &o->S->outWritten, o->pos, __ATOMIC_RELEASE );
+	return o->S->requestSeq == o->seq;
+}
+
+static inline u32 get32( const u8 *p )
+{
+	return p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 ) | ( (u32)p[ 3 ] << 24 );
+}
+
+static int copyStored( const u8 *in, u32 n, DECRUNCH_OUTPUT *o )
+{
+	if ( n > o->max - o->pos )
+		return DECRUNCH_ERROR;
+
+	// in steps, the C64 can start reading early
+	while ( n )
+	{
+		u32 l = n > 4096 ? 4096 : n;
+		memcpy( &o->out[ o->pos ], in, l );
+		o->pos += l; in += l; n -= l;
+		if ( !publish( o ) )
+			return DECRUNCH_ABORTED;
+	}
+	return 0;
+}
+
+// one LZ4 block: sequences of literals and a match, the last sequence has literals only
+static int lz4Block( const u8 *in, u32 n, DECRUNCH_OUTPUT *o )
+{
+	const u8 *end = in + n;
+	u8 *out = o->out;
+	u32 pos = o->pos, max = o->max;
+
+	while ( in < end )
+	{
+		u32 token = *in ++;
+
+		u32 lit = token >> 4;
+		if ( lit == 15 )
+		{
+			u32 b;
+			do {
+				if ( in >= end ) return DECRUNCH_ERROR;
+				b = *in ++;
+				lit += b;
+			} while ( b == 255 );
+		}
+		if ( lit > (u32)( end - in ) || lit > max - pos )
+			return DECRUNCH_ERROR;
+
+		memcpy( &out[ pos ], in, lit );
+		in += lit; pos += lit;
+
+		if ( in == end )
+			break;
+
+		if ( end - in < 2 )
+			return DECRUNCH_ERROR;
+		u32 ofs = in[ 0 ] | ( in[ 1 ] << 8 );
+		in += 2;
+		if ( ofs == 0 || ofs > pos )
+			return DECRUNCH_ERROR;
+
+		u32 len = token & 15;
+		if ( len == 15 )
+		{
+			u32 b;
+			do {
+				if ( in >= end ) return DECRUNCH_ERROR;
+				b = *in ++;
+				len += b;
+			} while ( b == 255 );
+		}
+		len += 4;
+		if ( len > max - pos )
+			return DECRUNCH_ERROR;
+
+		// matches may overlap their own output (runs)
+		const u8 *m = &out[ pos - ofs ];
+		if ( ofs >= len )
+			memcpy( &out[ pos ], m, len ); else
+			for ( u32 i = 0; i < len; i++ )
+				out[ pos + i ] = m[ i ];
+		pos += len;
+
+		o->pos = pos;
+		if ( !publish( o ) )
+			return DECRUNCH_ABORTED;
+	}
+
+	o->pos = pos;
+	return publish( o ) ? 0 : DECRUNCH_ABORTED;
+}
+
+// LZ4 frames (one or more, skippable frames are skipped), a legacy frame or a stored file
+static int decrunch( const u8 *src, u32 size, DECRUNCH_OUTPUT *o )
+{
+	u32 p = 0;
+	int r;
+
+	if ( size < 4 || ( get32( src ) != LZ4_MAGIC && get32( src ) != LZ4_MAGIC_LEGACY && ( get32( src ) & ~15 ) != LZ4_SKIPPABLE ) )
+	{
+		if ( o->S ) o->S->outSize = size;
+		if ( ( r = copyStored( src, size, o ) ) < 0 )
+			return r;
+		return o->pos;
+	}
+
+	while ( p + 4 <= size )
+	{
+		u32 magic = get32( &src[ p ] );
+		p += 4;
+
+		if ( ( magic & ~15 ) == LZ4_SKIPPABLE )
+		{
+			if ( p + 4 > size ) return DECRUNCH_ERROR;
+			p += 4 + get32( &src[ p ] );
+			continue;
+		}
+
+		if ( magic == LZ4_MAGIC_LEGACY )
+		{
+			// blocks of up to 8 MB, each with its compressed size, until the data ends or a new frame starts
+			while ( p + 4 <= size )
+			{
+				u32 n = get32( &src[ p ] );
+				if ( n == LZ4_MAGIC_LEGACY || n == LZ4_MAGIC || ( n & ~15 ) == LZ4_SKIPPABLE )
+					break;
+				p += 4;
+				if ( n > size - p ) return DECRUNCH_ERROR;
+				if ( ( r = lz4Block( &src[ p ], n, o ) ) < 0 ) return r;
+				p += n;
+			}
+			continue;
+		}
+
+		if ( magic != LZ4_MAGIC || p + 3 > size )
+			return DECRUNCH_ERROR;
+
+		// frame descriptor: FLG, BD, content size, dictionary ID, header checksum
+		u32 flg = src[ p ];
+		if ( ( flg >> 6 ) != 1 || ( flg & 1 ) )
+			return DECRUNCH_ERROR;			// unknown version or a dictionary
+		p += 2;
+		if ( flg & 8 )
+		{
+			if ( p + 8 > size ) return DECRUNCH_ERROR;
+			if ( o->S && get32( &src[ p + 4 ] ) == 0 ) o->S->outSize = o->pos + get32( &src[ p ] );
+			p += 8;
+		}
+		p ++;
+
+		while ( true )
+		{
+			if ( p + 4 > size ) return DECRUNCH_ERROR;
+			u32 n = get32( &src[ p ] );
+			p += 4;
+			if ( n == 0 )
+				break;
+
+			u32 stored = n & 0x80000000;
+			n &= 0x7fffffff;
+			if ( n > size - p ) return DECRUNCH_ERROR;
+
+			if ( stored )
+				r = copyStored( &src[ p ], n, o ); else
+				r = lz4Block( &src[ p ], n, o );
+			if ( r < 0 ) return r;
+
+			p += n + ( ( flg & 0x10 ) ? 4 : 0 );	// block checksum (not checked)
+		}
+		p += ( flg & 4 ) ? 4 : 0;					// content checksum (not checked)
+	}
+
+	return o->pos;
+}
+
+void decrunchInit( DECRUNCH_STATE *S, u8 *out, u32 outMax )
+{
+	memset( S, 0, sizeof( DECRUNCH_STATE ) );
+	S->out = out;
+	S->outMax = outMax;
+}
+
+int decrunchAddFile( DECRUNCH_STATE *S, u8 *data, u32 size )
+{
+	if ( S->nFiles >= DECRUNCH_MAX_FILES )
+		return -1;
+	S->file[ S->nFiles ] = data;
+	S->fileSize[ S->nFiles ] = size;
+	return S->nFiles ++;
+}
+
+u32 decrunchWork( DECRUNCH_STATE *S )
+{
+	u32 seq = S->requestSeq;
+	if ( seq == S->doneSeq )
+		return 0;
+
+	u32 idx = S->request;
+
+	S->outWritten = S->outSize = 0;
+	__atomic_store_n( &S->outSeq, seq, __ATOMIC_RELEASE );
+
+	int r = DECRUNCH_ERROR;
+	if ( idx < S->nFiles )
+	{
+		DECRUNCH_OUTPUT o = { S->out, 0, S->outMax, S, seq };
+		r = decrunch( S->file[ idx ], S->fileSize[ idx ], &o );
+	}
+
+	// a newer request is handled with the next call
+	if ( r == DECRUNCH_ABORTED )
+		return 1;
+
+	S->error = r < 0;
+	if ( r >= 0 )
+		S->outSize = r;
+	__atomic_store_n( &S->doneSeq, seq, __ATOMIC_RELEASE );
+
+	return 1;
+}
+
+int decrunchBuffer( const u8 *src, u32 size, u8 *out, u32 outMax )
+{
+	DECRUNCH_OUTPUT o = { out, 0, outMax, NULL, 0 };
+	int r = decrunch( src, size, &o );
+	return r < 0 ? -1 : r;
+}
@@ -0,0 +1,184 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ decrunch.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - decrunch service in IO2/ROML
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _decrunch_h
+#define _decrunch_h
+
+#include "buschain.h"
+
+//
+// Decrunch service in IO2: the C64 requests a packed file by its index, the main loop of kernel_decrunch.cpp decrunches
+// it into a staging buffer and the C64 reads the output while it is being produced, either byte by byte from a data
+// port or in 8k windows in ROML. The FIQ handler only serves bytes which the main loop has already written.
+//
+// $df10		write: index of the file to decrunch (restarts the output), read: status (bit 7: busy, bit 6: error,
+//				bit 5: ROML window on)
+// $df11		read: next output byte (only valid if $df12 is not 0, otherwise 0 is returned and the position stays)
+// $df12		read: number of output bytes ready at the read position (at most 255)
+// $df13-$df15	read: size of the output (24 bit, final when the busy bit is clear)
+// $df16/$df17	write: first 256-byte page (low/high) of the output shown in ROML ($8000-$9fff), $df16 turns the window on
+// $df18		write: turns the ROML window off
+// $df19		read: number of files
+//
+// The files are LZ4 frames (as written by the lz4 command line tool, also the legacy format of 'lz4 -l'), everything
+// else is served as it is.
+//
+
+#define DECRUNCH_STATUS_BUSY	0x80
+#define DECRUNCH_STATUS_ERROR	0x40
+#define DECRUNCH_STATUS_WINDOW	0x20
+
+#define DECRUNCH_MAX_FILES		64
+
+typedef struct
+{
+	// the packed files
+	u8  *file[ DECRUNCH_MAX_FILES ];
+	u32 fileSize[ DECRUNCH_MAX_FILES ];
+	u32 nFiles;
+
+	// staging buffer for the output
+	u8  *out;
+	u32 outMax;
+
+	// written by the FIQ handler: every request increments requestSeq
+	volatile u32 request, requestSeq;
+	u32 readPos;
+	u32 window, windowPage;
+
+	// written by the main loop: outWritten/outSize are valid for the request outSeq, doneSeq is the last one finished
+	volatile u32 outSeq, outWritten, outSize, doneSeq, error;
+} DECRUNCH_STATE;
+
+//
+// register interface (called from the FIQ handler)
+//
+static inline u32 decrunchReady( DECRUNCH_STATE *S )
+{
+	if ( S->outSeq != S->requestSeq )
+		return 0;
+	return S->outWritten - S->readPos;
+}
+
+static inline u32 decrunchStatus( DECRUNCH_STATE *S )
+{
+	u32 s = S->window ? DECRUNCH_STATUS_WINDOW : 0;
+	if ( S->doneSeq != S->requestSeq )
+		return s | DECRUNCH_STATUS_BUSY;
+	return s | ( S->error ? DECRUNCH_STATUS_ERROR : 0 );
+}
+
+// bus device for the chains of buschain.h, put it before CDevLaunch (which takes all writes to IO2)
+template <DECRUNCH_STATE *S>
+class CDevDecrunch : public CDevNone
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b )
+	{
+		b.preloadL1( &S->out[ S->readPos ] );
+
+		// a reset turns the window off, the launcher sets GAME/EXROM again
+		if ( b.resetCounter > 3 )
+			S->window = 0;
+	}
+
+	template <class BUS> static inline u32 match( BUS &b )
+	{
+		return ( b.io2() && b.addrIO() >= 0x10 && b.addrIO() < 0x1a ) || ( S->window && b.cpuReads() && b.roml() );
+	}
+
+	template <class BUS> static inline u32 read( BUS &b )
+	{
+		if ( b.roml() )
+			return S->out[ ( ( S->windowPage << 8 ) + b.addr() ) & ( S->outMax - 1 ) ];
+
+		switch ( b.addrIO() )
+		{
+		case 0x10: return decrunchStatus( S );
+		case 0x11:
+			if ( decrunchReady( S ) == 0 )
+				return 0;
+			return S->out[ S->readPos ++ ];
+		case 0x12:
+		{
+			u32 n = decrunchReady( S );
+			return n > 255 ? 255 : n;
+		}
+		case 0x13: return S->outSeq == S->requestSeq ? S->outSize & 255 : 0;
+		case 0x14: return S->outSeq == S->requestSeq ? ( S->outSize >> 8 ) & 255 : 0;
+		case 0x15: return S->outSeq == S->requestSeq ? ( S->outSize >> 16 ) & 255 : 0;
+		case 0x19: return S->nFiles;
+		default: return 0;
+		}
+	}
+
+	template <class BUS> static inline void write( BUS &b )
+	{
+		u32 D = b.get();
+
+		switch ( b.addrIO() )
+		{
+		case 0x10:
+			S->request = D;
+			S->readPos = 0;
+			S->requestSeq = S->requestSeq + 1;
+			break;
+		case 0x16:
+			S->windowPage = ( S->windowPage & 0xff00 ) | D;
+			S->window = 1;
+			b.setClr( bGAME, bEXROM );
+			break;
+		case 0x17:
+			S->windowPage = ( S->windowPage & 0x00ff ) | ( D << 8 );
+			break;
+		case 0x18:
+			S->window = 0;
+			b.setClr( bGAME | bEXROM, 0 );
+			break;
+		}
+	}
+};
+
+//
+// main loop
+//
+
+// 'out' is the staging buffer of 'outMax' bytes (a power of 2)
+extern void decrunchInit( DECRUNCH_STATE *S, u8 *out, u32 outMax );
+
+// registers a packed file, returns its index or -1 if there are too many
+extern int  decrunchAddFile( DECRUNCH_STATE *S, u8 *data, u32 size );
+
+// decrunches the file of the latest request if there is a new one, returns 1 if it did so
+extern u32  decrunchWork( DECRUNCH_STATE *S );
+
+// decrunches a file without the register interface (used by DecrunchBench), returns the output size or -1 on errors
+extern int  decrunchBuffer( const u8 *src, u32 size, u8 *out, u32 outMax );
+
+#endif
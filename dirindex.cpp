@@ -0,0 +1,348 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ dirindex.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - type-to-find index for the file browser
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "dirindex.h"
+#include "dirscan.h"
+
+#include <string.h>
+
+// ids are stored in lists of 64-byte blocks (the block added last is the head of the list)
+#define DIRINDEX_BLOCK_IDS	15
+#define DIRINDEX_BLOCKS		( MAX_DIR_ENTRIES * 8 )
+#define DIRINDEX_NONE		0xffffffff
+#define DIRINDEX_MAX_QUERY	32
+
+typedef struct
+{
+	u32 next;
+	u32 id[ DIRINDEX_BLOCK_IDS ];
+} IDBLOCK;
+
+typedef struct
+{
+	u32 head, count;
+} IDLIST;
+
+// exact lists for the first character, the first two characters, all characters and all bigrams of the names,
+// trigrams are hashed (candidates from these lists need to be checked)
+#define TRIGRAM_BUCKETS		8192
+static IDLIST listFirst[ 256 ], listFirst2[ 65536 ], listChar[ 256 ], listBigram[ 65536 ], listTrigram[ TRIGRAM_BUCKETS ];
+
+static IDBLOCK block[ DIRINDEX_BLOCKS ];
+static u32 nBlocks = 0;
+static u32 indexOverflow = 0;
+
+// position in dir[] for each id
+static u32 dirPos[ MAX_DIR_ENTRIES ];
+static u32 nIds = 0;
+
+// result of the last search: ids of the names starting with the query, or (if there are none) containing it
+typedef struct
+{
+	u32 valid;
+	u32 n;
+	u32 id[ MAX_DIR_ENTRIES ];
+} IDSET;
+
+static IDSET prefixSet, substringSet;
+static u8  query[ DIRINDEX_MAX_QUERY + 1 ];
+static u32 queryLength = 0;
+static IDSET *result = &prefixSet;
+
+static inline u8 fold( u8 c )
+{
+	if ( c >= 'A' && c <= 'Z' )
+		return c + 'a' - 'A';
+	return c;
+}
+
+static inline u32 bigram( const u8 *s )
+{
+	return ( fold( s[ 0 ] ) << 8 ) | fold( s[ 1 ] );
+}
+
+static inline u32 trigramBucket( const u8 *s )
+{
+	u32 t = ( fold( s[ 0 ] ) << 16 ) | ( fold( s[ 1 ] ) << 8 ) | fold( s[ 2 ] );
+	return ( t * 2654435761u ) >> 19;
+}
+
+static void clearList( IDLIST *l, u32 n )
+{
+	for ( u32 i = 0; i < n; i++ )
+	{
+		l[ i ].head = DIRINDEX_NONE;
+		l[ i ].count = 0;
+	}
+}
+
+void dirIndexClear()
+{
+	clearList( listFirst, 256 );
+	clearList( listFirst2, 65536 );
+	clearList( listChar, 256 );
+	clearList( listBigram, 65536 );
+	clearList( listTrigram, TRIGRAM_BUCKETS );
+	nIds = nBlocks = indexOverflow = 0;
+	prefixSet.valid = substringSet.valid = 0;
+	prefixSet.n = substringSet.n = 0;
+	result = &prefixSet;
+}
+
+static void addToList( IDLIST *l, u32 id )
+{
+	u32 slot = l->count % DIRINDEX_BLOCK_IDS;
+
+	// ids are added in increasing order, a name is added at most once per list
+	if ( l->count && block[ l->head ].id[ ( l->count - 1 ) % DIRINDEX_BLOCK_IDS ] == id )
+		return;
+
+	if ( slot == 0 )
+	{
+		if ( nBlocks >= DIRINDEX_BLOCKS )
+		{
+			indexOverflow = 1;
+			return;
+		}
+		block[ nBlocks ].next = l->head;
+		l->head = nBlocks ++;
+	}
+
+	block[ l->head ].id[ slot ] = id;
+	l->count ++;
+}
+
+static void indexName( u32 id, const u8 *name )
+{
+	if ( !name[ 0 ] )
+		return;
+
+	addToList( &listFirst[ fold( name[ 0 ] ) ], id );
+	if ( name[ 1 ] )
+		addToList( &listFirst2[ bigram( name ) ], id );
+
+	for ( u32 i = 0; name[ i ]; i++ )
+		addToList( &listChar[ fold( name[ i ] ) ], id );
+
+	for ( u32 i = 0; name[ i + 1 ]; i++ )
+	{
+		addToList( &listBigram[ bigram( &name[ i ] ) ], id );
+		if ( name[ i + 2 ] )
+			addToList( &listTrigram[ trigramBucket( &name[ i ] ) ], id );
+	}
+}
+
+// entries [first, first + count) have been inserted, all entries behind them have been moved by 'count'
+void dirIndexAdd( s32 first, s32 count )
+{
+	for ( s32 p = first + count; p < nDirEntries; p++ )
+		dirPos[ dir[ p ].id ] = p;
+
+	for ( s32 p = first; p < first + count; p++ )
+	{
+		u32 id = nIds ++;
+		dir[ p ].id = id;
+		dirPos[ id ] = p;
+		indexName( id, dir[ p ].name );
+	}
+
+	// the new entries are not part of the last result
+	prefixSet.valid = substringSet.valid = 0;
+}
+
+static inline u32 startsWith( const u8 *name, const u8 *q, u32 ql )
+{
+	for ( u32 j = 0; j < ql; j++ )
+		if ( fold( name[ j ] ) != q[ j ] )
+			return 0;
+	return 1;
+}
+
+static inline u32 contains( const u8 *name, const u8 *q, u32 ql )
+{
+	for ( u32 i = 0; name[ i ]; i++ )
+	{
+		u32 j = 0;
+		while ( j < ql && fold( name[ i + j ] ) == q[ j ] )
+			j ++;
+		if ( j == ql )
+			return 1;
+	}
+	return 0;
+}
+
+// copies the ids of a list to 'ids', returns their number
+static u32 getList( IDLIST *l, u32 *ids )
+{
+	u32 n = 0;
+	for ( u32 b = l->head, k = ( l->count - 1 ) % DIRINDEX_BLOCK_IDS + 1; b != DIRINDEX_NONE; b = block[ b ].next, k = DIRINDEX_BLOCK_IDS )
+	{
+		memcpy( &ids[ n ], block[ b ].id, k * sizeof( u32 ) );
+		n += k;
+	}
+	return n;
+}
+
+// keeps the ids whose names start with (or contain) the query
+static void filter( IDSET *s, u32 prefix )
+{
+	u32 n = 0;
+	for ( u32 i = 0; i < s->n; i++ )
+	{
+		const u8 *name = dir[ dirPos[ s->id[ i ] ] ].name;
+		if ( prefix ? startsWith( name, query, queryLength ) : contains( name, query, queryLength ) )
+			s->id[ n ++ ] = s->id[ i ];
+	}
+	s->n = n;
+}
+
+// can the result for the previous query be narrowed down (instead of starting from a list of the index)?
+static inline u32 extendsPrevious( IDSET *s, u32 listCount )
+{
+	return s->valid && s->n <= listCount;
+}
+
+u32 dirIndexSearch( const char *q )
+{
+	u8  prev[ DIRINDEX_MAX_QUERY + 1 ];
+	u32 prevLength = queryLength;
+	memcpy( prev, query, prevLength );
+
+	u32 ql = 0;
+	while ( ql < DIRINDEX_MAX_QUERY && q[ ql ] )
+	{
+		query[ ql ] = fold( q[ ql ] );
+		ql ++;
+	}
+	query[ ql ] = 0;
+	queryLength = ql;
+
+	// same query (search for the next/previous match)
+	if ( ql == prevLength && !memcmp( query, prev, ql ) && result->valid )
+		return result->n;
+
+	// the results of the previous query can only be narrowed down if the new query extends it
+	if ( ql <= prevLength || memcmp( query, prev, prevLength ) )
+		prefixSet.valid = substringSet.valid = 0;
+
+	result = &prefixSet;
+	if ( ql == 0 )
+	{
+		prefixSet.n = 0;
+		return 0;
+	}
+
+	//
+	// names starting with the query
+	//
+	IDLIST *l = ql == 1 ? &listFirst[ query[ 0 ] ] : &listFirst2[ bigram( query ) ];
+
+	if ( indexOverflow )
+	{
+		prefixSet.n = nIds;
+		for ( u32 i = 0; i < nIds; i++ )
+			prefixSet.id[ i ] = i;
+		filter( &prefixSet, 1 );
+	} else
+	if ( extendsPrevious( &prefixSet, l->count ) )
+		filter( &prefixSet, 1 ); else
+	{
+		prefixSet.n = getList( l, prefixSet.id );
+		if ( ql > 2 )
+			filter( &prefixSet, 1 );
+	}
+	prefixSet.valid = 1;
+
+	if ( prefixSet.n )
+	{
+		substringSet.valid = 0;
+		return prefixSet.n;
+	}
+
+	//
+	// no name starts with the query: names containing it
+	//
+	result = &substringSet;
+
+	l = NULL;
+	if ( ql == 1 )
+		l = &listChar[ query[ 0 ] ]; else
+	if ( ql == 2 )
+		l = &listBigram[ bigram( query ) ]; else
+	if ( ql > 2 )
+	{
+		// the trigram of the query with the fewest names
+		for ( u32 i = 0; i + 2 < ql; i++ )
+		{
+			IDLIST *t = &listTrigram[ trigramBucket( &query[ i ] ) ];
+			if ( l == NULL || t->count < l->count )
+				l = t;
+		}
+	}
+
+	if ( l == NULL || indexOverflow )
+	{
+		substringSet.n = nIds;
+		for ( u32 i = 0; i < nIds; i++ )
+			substringSet.id[ i ] = i;
+		filter( &substringSet, 0 );
+	} else
+	if ( extendsPrevious( &substringSet, l->count ) )
+		filter( &substringSet, 0 ); else
+	{
+		substringSet.n = getList( l, substringSet.id );
+		if ( ql > 2 )
+			filter( &substringSet, 0 );
+	}
+	substringSet.valid = 1;
+
+	return substringSet.n;
+}
+
+s32 dirIndexFind( s32 pos, s32 direction )
+{
+	s32 best = -1;
+
+	for ( u32 i = 0; i < result->n; i++ )
+	{
+		s32 p = dirPos[ result->id[ i ] ];
+
+		if ( direction > 0 )
+		{
+			if ( p >= pos && ( best < 0 || p < best ) )
+				best = p;
+		} else
+		{
+			if ( p <= pos && p > best )
+				best = p;
+		}
+	}
+
+	return best;
+}
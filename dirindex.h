@@ -0,0 +1,49 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ dirindex.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - type-to-find index for the file browser
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _dirindex_h
+#define _dirindex_h
+
+#include <circle/types.h>
+
+// n-gram index over the names in dir[] (see dirscan.h) for the type-to-find search in the browser:
+// it is extended whenever entries are inserted into dir[], each entry gets an id (DIRENTRY::id) which
+// does not change when entries are moved, the position of an id in dir[] is kept up to date
+extern void dirIndexClear();
+extern void dirIndexAdd( s32 first, s32 count );
+
+// computes the entries whose name starts with 'query' (case insensitive), or if there are none, the entries
+// containing it. If 'query' extends the previous one, only the previous matches are checked (if these are
+// fewer than the candidates from the index), returns the number of matches
+extern u32  dirIndexSearch( const char *query );
+
+// position of the nearest match at or after (direction > 0) or at or before (direction < 0) 'pos', or -1
+extern s32  dirIndexFind( s32 pos, s32 direction );
+
+#endif
@@ -30,6 +30,7 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "dirscan.h"
+#include "dirindex.h"
 #include "linux/kernel.h"
 #include <circle/util.h>
 
@@ -522,6 +523,7 @@ void readDirectory( int mode, const char *DIRPATH, DIRENTRY *d, s32 *n, u32 pare
 void insertDirectoryContents( int node, char *basePath, int listAll )
 {
 	s32 tempEntries = dir[ node ].next;
+	s32 firstNew = tempEntries;
 	u32 nAdded = 0;
 	char path[ 2048 ];
 	sprintf( path, "%s%s", basePath, dir[ node ].name );
@@ -542,6 +544,7 @@ void insertDirectoryContents( int node, char *basePath, int listAll )
 #endif
 
 	nDirEntries += tempEntries - dir[ node ].next;
+	dirIndexAdd( firstNew, tempEntries - firstNew );
 	dir[ node ].next += nAdded;
 }
 
@@ -585,6 +588,9 @@ void scanDirectories( char *DRIVE )
 
 	//insertDirectoryContents( 0, "SD:" );
 
+	dirIndexClear();
+	dirIndexAdd( 0, nDirEntries );
+
 #ifndef WITH_NET
 
 	// unmount file system
@@ -610,6 +616,9 @@ void scanDirectories264( char *DRIVE )
 	APPEND_SUBTREE( "D264", "SD:D264", 0 )
 	APPEND_SUBTREE( "PRG264", "SD:PRG264", 0 )
 
+	dirIndexClear();
+	dirIndexAdd( 0, nDirEntries );
+
 #ifndef WITH_NET
 	// unmount file system
 	if ( f_mount( 0, DRIVE, 0 ) != FR_OK )
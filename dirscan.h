@@ -48,6 +48,7 @@ typedef struct
 {
 	u8	name[ 256 ];
 	u32 f, parent, next, level, size;
+	u32 id;		// stable id for the search index (see dirindex.h)
 } DIRENTRY;
 
 // file type requires 3 bits
@@ -65,7 +66,9 @@ typedef struct
 #define DIR_BIN_FILE	(1<<31)
 
 
+#ifndef MAX_DIR_ENTRIES
 #define MAX_DIR_ENTRIES		16384
+#endif
 extern DIRENTRY dir[ MAX_DIR_ENTRIES ];
 extern s32 nDirEntries;
 
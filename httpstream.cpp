@@ -0,0 +1,664 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ httpstream.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - streaming HTTP client (keep-alive, chunked transfer)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "httpstream.h"
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <circle/net/in.h>
+#include <circle/net/socket.h>
+#ifdef WITH_TLS
+#include <circle-mbedtls/tlssimpleclientsocket.h>
+using namespace CircleMbedTLS;
+#endif
+
+extern CLogger *logger;
+
+// most servers drop idle keep-alive connections after 5 seconds, we reconnect a bit earlier
+#define HTTP_IDLE_TIMEOUT	4000000
+
+//
+// sinks
+//
+boolean CHTTPBufferSink::Begin( unsigned nOffset, unsigned nTotalLength )
+{
+	if ( nOffset > m_nSize || nTotalLength > m_nSize )
+		return false;
+	m_nLength = nOffset;
+	return true;
+}
+
+boolean CHTTPBufferSink::Write( const u8 *pData, unsigned nLength )
+{
+	if ( m_nLength + nLength > m_nSize )
+		return false;
+	memcpy( &m_pBuffer[ m_nLength ], pData, nLength );
+	m_nLength += nLength;
+	return true;
+}
+
+CHTTPFileSink::~CHTTPFileSink( void )
+{
+	Close();
+}
+
+boolean CHTTPFileSink::Open( const char *pFilename )
+{
+	Close();
+	if ( f_open( &m_File, pFilename, FA_WRITE | FA_OPEN_ALWAYS ) != FR_OK )
+	{
+		logger->Write( "HTTPFileSink", LogNotice, "Cannot open file: %s", pFilename );
+		return false;
+	}
+	m_bOpen = true;
+	m_nLength = (unsigned)f_size( &m_File );
+	return f_lseek( &m_File, m_nLength ) == FR_OK;
+}
+
+void CHTTPFileSink::Close( void )
+{
+	if ( !m_bOpen )
+		return;
+	if ( f_close( &m_File ) != FR_OK )
+		logger->Write( "HTTPFileSink", LogError, "Cannot close file" );
+	m_bOpen = false;
+}
+
+boolean CHTTPFileSink::Begin( unsigned nOffset, unsigned nTotalLength )
+{
+	if ( !m_bOpen || nOffset > m_nLength )
+		return false;
+
+	// the server did not honor the range request (or we are restarting): discard what we have
+	if ( nOffset < m_nLength )
+	{
+		if ( f_lseek( &m_File, nOffset ) != FR_OK || f_truncate( &m_File ) != FR_OK )
+			return false;
+		m_nLength = nOffset;
+	}
+	return true;
+}
+
+boolean CHTTPFileSink::Write( const u8 *pData, unsigned nLength )
+{
+	UINT nBytesWritten;
+	if ( !m_bOpen || f_write( &m_File, pData, nLength, &nBytesWritten ) != FR_OK || nBytesWritten != nLength )
+	{
+		logger->Write( "HTTPFileSink", LogError, "Write error" );
+		return false;
+	}
+	m_nLength += nLength;
+	return true;
+}
+
+boolean CHTTPTeeSink::Begin( unsigned nOffset, unsigned nTotalLength )
+{
+	if ( !m_pFirst->Begin( nOffset, nTotalLength ) )
+		return false;
+	if ( !m_bSecondFailed && !m_pSecond->Begin( nOffset, nTotalLength ) )
+		m_bSecondFailed = true;
+	return true;
+}
+
+boolean CHTTPTeeSink::Write( const u8 *pData, unsigned nLength )
+{
+	if ( !m_pFirst->Write( pData, nLength ) )
+		return false;
+	if ( !m_bSecondFailed && !m_pSecond->Write( pData, nLength ) )
+		m_bSecondFailed = true;
+	return true;
+}
+
+void CHTTPTeeSink::End( boolean bComplete )
+{
+	m_pFirst->End( bComplete );
+	if ( !m_bSecondFailed )
+		m_pSecond->End( bComplete );
+}
+
+class CHTTPDiscardSink : public CHTTPStreamSink
+{
+public:
+	boolean Write( const u8 *pData, unsigned nLength ) { return true; };
+};
+
+//
+// multipart/form-data
+//
+CMultipartParser::CMultipartParser( void )
+:	m_nState( MULTIPART_STATE_ERROR ),
+	m_nDelimiterLength( 0 ),
+	m_nMatched( 0 ),
+	m_nHeaderLength( 0 ),
+	m_nBoundaryEndLength( 0 ),
+	m_pSink( 0 )
+{
+}
+
+boolean CMultipartParser::Begin( const char *pContentType )
+{
+	m_nState = MULTIPART_STATE_ERROR;
+
+	const char *p = strstr( pContentType, "boundary=" );
+	if ( p == 0 )
+		return false;
+	p += 9;
+
+	boolean bQuoted = ( *p == '"' );
+	if ( bQuoted )
+		p++;
+
+	strcpy( m_Delimiter, "\r\n--" );
+	unsigned l = 4;
+	while ( *p && *p != '"' && ( bQuoted || ( *p != ';' && *p != ' ' && *p != '\t' ) ) )
+	{
+		if ( l >= sizeof( m_Delimiter ) - 1 )
+			return false;
+		m_Delimiter[ l++ ] = *p++;
+	}
+	if ( l == 4 )
+		return false;
+	m_Delimiter[ l ] = 0;
+	m_nDelimiterLength = l;
+
+	// the first boundary is not preceded by CR/LF: pretend we have already seen it
+	m_nMatched = 2;
+	m_pSink = 0;
+	m_nState = MULTIPART_STATE_PREAMBLE;
+	return true;
+}
+
+boolean CMultipartParser::Emit( const u8 *pData, unsigned nLength )
+{
+	if ( m_nState != MULTIPART_STATE_DATA || m_pSink == 0 || nLength == 0 )
+		return true;
+	return m_pSink->Write( pData, nLength );
+}
+
+boolean CMultipartParser::Parse( const u8 *pData, unsigned nLength )
+{
+	// start of the data which has not been passed on yet
+	unsigned nRunStart = 0;
+
+	for ( unsigned i = 0; i < nLength; i++ )
+	{
+		u8 c = pData[ i ];
+		switch ( m_nState )
+		{
+		case MULTIPART_STATE_PREAMBLE:
+		case MULTIPART_STATE_DATA:
+			if ( c == (u8)m_Delimiter[ m_nMatched ] )
+			{
+				if ( m_nMatched == 0 && !Emit( &pData[ nRunStart ], i - nRunStart ) )
+					break;
+				if ( ++m_nMatched == m_nDelimiterLength )
+				{
+					if ( m_nState == MULTIPART_STATE_DATA && !EndPart( m_pSink ) )
+					{
+						m_nState = MULTIPART_STATE_ERROR;
+						return false;
+					}
+					m_pSink = 0;
+					m_nMatched = 0;
+					m_nBoundaryEndLength = 0;
+					m_nState = MULTIPART_STATE_BOUNDARY_END;
+				}
+				continue;
+			}
+			if ( m_nMatched > 0 )
+			{
+				// no delimiter after all: what we have matched is data, 
+				// a new delimiter can only start here as the boundary itself cannot contain CR
+				if ( !Emit( (const u8 *)m_Delimiter, m_nMatched ) )
+					break;
+				m_nMatched = ( c == '\r' ) ? 1 : 0;
+				nRunStart = i + m_nMatched;
+			}
+			continue;
+
+		case MULTIPART_STATE_BOUNDARY_END:
+			// "--" after the delimiter ends the body, CR/LF starts the next part
+			m_BoundaryEnd[ m_nBoundaryEndLength++ ] = c;
+			if ( m_nBoundaryEndLength < 2 )
+				continue;
+			if ( m_BoundaryEnd[ 0 ] == '-' && m_BoundaryEnd[ 1 ] == '-' )
+			{
+				m_nState = MULTIPART_STATE_DONE;
+				continue;
+			}
+			if ( m_BoundaryEnd[ 0 ] != '\r' || m_BoundaryEnd[ 1 ] != '\n' )
+				break;
+			m_nHeaderLength = 0;
+			m_nState = MULTIPART_STATE_HEADER;
+			continue;
+
+		case MULTIPART_STATE_HEADER:
+			if ( m_nHeaderLength >= MULTIPART_MAX_HEADER - 1 )
+				break;
+			m_Header[ m_nHeaderLength++ ] = c;
+			if ( ( m_nHeaderLength == 2 && memcmp( m_Header, "\r\n", 2 ) == 0 ) ||
+				 ( m_nHeaderLength >= 4 && memcmp( &m_Header[ m_nHeaderLength - 4 ], "\r\n\r\n", 4 ) == 0 ) )
+			{
+				m_Header[ m_nHeaderLength ] = 0;
+				m_nState = MULTIPART_STATE_DATA;
+				m_pSink = BeginPart( m_Header );
+				m_nMatched = 0;
+				nRunStart = i + 1;
+			}
+			continue;
+
+		case MULTIPART_STATE_DONE:
+			// ignore the epilogue
+			return true;
+
+		default:
+			return false;
+		}
+
+		// we only get here if something went wrong
+		m_nState = MULTIPART_STATE_ERROR;
+		return false;
+	}
+
+	if ( m_nMatched == 0 && !Emit( &pData[ nRunStart ], nLength - nRunStart ) )
+	{
+		m_nState = MULTIPART_STATE_ERROR;
+		return false;
+	}
+	return true;
+}
+
+//
+// header parsing helpers
+//
+static boolean matchHeader( const char *pLine, const char *pName, const char **pValue )
+{
+	while ( *pName )
+	{
+		char a = *pLine++, b = *pName++;
+		if ( a >= 'A' && a <= 'Z' ) a += 'a' - 'A';
+		if ( a != b )
+			return false;
+	}
+	if ( *pLine++ != ':' )
+		return false;
+	while ( *pLine == ' ' || *pLine == '\t' )
+		pLine++;
+	*pValue = pLine;
+	return true;
+}
+
+static boolean containsToken( const char *pValue, const char *pToken )
+{
+	unsigned l = strlen( pToken );
+	for ( ; *pValue; pValue++ )
+	{
+		unsigned i;
+		for ( i = 0; i < l; i++ )
+		{
+			char a = pValue[ i ];
+			if ( a >= 'A' && a <= 'Z' ) a += 'a' - 'A';
+			if ( a != pToken[ i ] )
+				break;
+		}
+		if ( i == l )
+			return true;
+	}
+	return false;
+}
+
+static unsigned parseDecimal( const char *p )
+{
+	unsigned v = 0;
+	while ( *p >= '0' && *p <= '9' )
+		v = v * 10 + ( *p++ - '0' );
+	return v;
+}
+
+// returns false if there is no hex digit at all
+static boolean parseHex( const char *p, unsigned *v )
+{
+	*v = 0;
+	const char *s = p;
+	for ( ;; p++ )
+	{
+		if ( *p >= '0' && *p <= '9' ) *v = ( *v << 4 ) | ( *p - '0' ); else
+		if ( *p >= 'a' && *p <= 'f' ) *v = ( *v << 4 ) | ( *p - 'a' + 10 ); else
+		if ( *p >= 'A' && *p <= 'F' ) *v = ( *v << 4 ) | ( *p - 'A' + 10 ); else
+			break;
+	}
+	return p != s;
+}
+
+//
+// client
+//
+#ifdef WITH_TLS
+CHTTPStreamClient::CHTTPStreamClient( CNetSubSystem *pNet, CTLSSimpleSupport *pTLSSupport )
+:	m_pNet( pNet ),
+	m_pTLSSupport( pTLSSupport )
+#else
+CHTTPStreamClient::CHTTPStreamClient( CNetSubSystem *pNet )
+:	m_pNet( pNet )
+#endif
+{
+	for ( unsigned i = 0; i < HTTP_MAX_CONNECTIONS; i++ )
+		m_Conn[ i ].pSocket = 0;
+}
+
+CHTTPStreamClient::~CHTTPStreamClient( void )
+{
+	CloseAll();
+}
+
+void CHTTPStreamClient::Close( TConnection *pConn )
+{
+	if ( pConn->pSocket )
+		delete pConn->pSocket;
+	pConn->pSocket = 0;
+}
+
+void CHTTPStreamClient::CloseAll( void )
+{
+	for ( unsigned i = 0; i < HTTP_MAX_CONNECTIONS; i++ )
+		Close( &m_Conn[ i ] );
+}
+
+CHTTPStreamClient::TConnection *CHTTPStreamClient::Connect( CIPAddress &rIP, u16 nPort, const char *pHost, boolean &bReused )
+{
+	unsigned now = CTimer::GetClockTicks();
+	TConnection *pConn = 0;
+
+	// reuse an open connection to the same server, otherwise replace a free or the least recently used one
+	for ( unsigned i = 0; i < HTTP_MAX_CONNECTIONS; i++ )
+	{
+		TConnection *c = &m_Conn[ i ];
+		if ( c->pSocket && c->ip == rIP && c->nPort == nPort )
+		{
+			if ( now - c->nLastUsed < HTTP_IDLE_TIMEOUT )
+			{
+				bReused = true;
+				return c;
+			}
+			Close( c );
+		}
+		if ( pConn == 0 || ( pConn->pSocket && ( !c->pSocket || c->nLastUsed < pConn->nLastUsed ) ) )
+			pConn = c;
+	}
+
+	Close( pConn );
+	bReused = false;
+
+#ifdef WITH_TLS
+	if ( nPort == 443 )
+	{
+		CTLSSimpleClientSocket *pTLSSocket = new CTLSSimpleClientSocket( m_pTLSSupport, IPPROTO_TCP );
+		if ( pTLSSocket->Setup( pHost ) != 0 )
+		{
+			delete pTLSSocket;
+			return 0;
+		}
+		pConn->pSocket = pTLSSocket;
+	} else
+#endif
+		pConn->pSocket = new CSocket( m_pNet, IPPROTO_TCP );
+
+	if ( pConn->pSocket->Connect( rIP, nPort ) < 0 )
+	{
+		logger->Write( "HTTPStream", LogWarning, "Cannot connect to %s:%u", pHost, nPort );
+		Close( pConn );
+		return 0;
+	}
+
+	pConn->ip.Set( rIP );
+	pConn->nPort = nPort;
+	pConn->nRxPos = pConn->nRxLength = 0;
+	return pConn;
+}
+
+boolean CHTTPStreamClient::Fill( TConnection *pConn )
+{
+	int n = pConn->pSocket->Receive( pConn->rxBuffer, HTTP_RX_BUFFER_SIZE, 0 );
+	if ( n <= 0 )
+		return false;
+	pConn->nRxPos = 0;
+	pConn->nRxLength = n;
+	return true;
+}
+
+// reads one line without the CR/LF, overlong lines are truncated
+boolean CHTTPStreamClient::ReadLine( TConnection *pConn, char *pLine )
+{
+	unsigned l = 0;
+	for ( ;; )
+	{
+		if ( pConn->nRxPos >= pConn->nRxLength && !Fill( pConn ) )
+			return false;
+
+		char c = pConn->rxBuffer[ pConn->nRxPos++ ];
+		if ( c == '\n' )
+			break;
+		if ( c != '\r' && l < HTTP_MAX_LINE - 1 )
+			pLine[ l++ ] = c;
+	}
+	pLine[ l ] = 0;
+	return true;
+}
+
+boolean CHTTPStreamClient::ReadBody( TConnection *pConn, CHTTPStreamSink *pSink, unsigned nLength )
+{
+	while ( nLength > 0 )
+	{
+		if ( pConn->nRxPos >= pConn->nRxLength && !Fill( pConn ) )
+			return false;
+
+		unsigned n = pConn->nRxLength - pConn->nRxPos;
+		if ( n > nLength )
+			n = nLength;
+		if ( !pSink->Write( &pConn->rxBuffer[ pConn->nRxPos ], n ) )
+			return false;
+		pConn->nRxPos += n;
+		nLength -= n;
+	}
+	return true;
+}
+
+boolean CHTTPStreamClient::ReadUntilClose( TConnection *pConn, CHTTPStreamSink *pSink )
+{
+	for ( ;; )
+	{
+		if ( pConn->nRxPos < pConn->nRxLength )
+		{
+			if ( !pSink->Write( &pConn->rxBuffer[ pConn->nRxPos ], pConn->nRxLength - pConn->nRxPos ) )
+				return false;
+			pConn->nRxPos = pConn->nRxLength;
+		}
+		if ( !Fill( pConn ) )
+			return true;
+	}
+}
+
+boolean CHTTPStreamClient::ReadChunked( TConnection *pConn, CHTTPStreamSink *pSink )
+{
+	char line[ HTTP_MAX_LINE ];
+	for ( ;; )
+	{
+		unsigned nChunkSize;
+		if ( !ReadLine( pConn, line ) || !parseHex( line, &nChunkSize ) )
+			return false;
+
+		if ( nChunkSize == 0 )
+			break;
+
+		// chunk data is followed by CR/LF
+		if ( !ReadBody( pConn, pSink, nChunkSize ) || !ReadLine( pConn, line ) )
+			return false;
+	}
+
+	// skip trailer
+	do {
+		if ( !ReadLine( pConn, line ) )
+			return false;
+	} while ( line[ 0 ] != 0 );
+
+	return true;
+}
+
+unsigned CHTTPStreamClient::Request( TConnection *pConn, const char *pHost, const char *pPath, CHTTPStreamSink *pSink, unsigned nOffset, boolean &bKeepAlive, boolean &bResponse )
+{
+	CString request;
+	request.Format( "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: Sidekick64\r\nConnection: keep-alive\r\n", pPath, pHost );
+	if ( nOffset > 0 )
+	{
+		CString range;
+		range.Format( "Range: bytes=%u-\r\n", nOffset );
+		request.Append( range );
+	}
+	request.Append( "\r\n" );
+
+	bKeepAlive = bResponse = false;
+	if ( pConn->pSocket->Send( (const char *)request, request.GetLength(), 0 ) < 0 )
+		return 0;
+
+	// status line and header
+	char line[ HTTP_MAX_LINE ];
+	unsigned nStatus;
+	do {
+		if ( !ReadLine( pConn, line ) || strncmp( line, "HTTP/1.", 7 ) != 0 )
+			return 0;
+		bResponse = true;
+		nStatus = parseDecimal( &line[ 9 ] );
+		bKeepAlive = line[ 7 ] == '1';
+
+		// skip header of '100 continue' responses
+		if ( nStatus == 100 )
+			do {
+				if ( !ReadLine( pConn, line ) )
+					return 0;
+			} while ( line[ 0 ] != 0 );
+	} while ( nStatus == 100 );
+
+	boolean bChunked = false, bHasLength = false;
+	unsigned nLength = 0, nRangeStart = 0;
+	for ( ;; )
+	{
+		const char *v;
+		if ( !ReadLine( pConn, line ) )
+			return 0;
+		if ( line[ 0 ] == 0 )
+			break;
+
+		if ( matchHeader( line, "content-length", &v ) )
+		{
+			nLength = parseDecimal( v );
+			bHasLength = true;
+		} else
+		if ( matchHeader( line, "transfer-encoding", &v ) )
+			bChunked = containsToken( v, "chunked" ); else
+		if ( matchHeader( line, "connection", &v ) )
+		{
+			if ( containsToken( v, "close" ) )
+				bKeepAlive = false; else
+			if ( containsToken( v, "keep-alive" ) )
+				bKeepAlive = true;
+		} else
+		if ( matchHeader( line, "content-range", &v ) )
+		{
+			// "bytes <first>-<last>/<total>"
+			while ( *v && ( *v < '0' || *v > '9' ) )
+				v++;
+			nRangeStart = parseDecimal( v );
+		}
+	}
+
+	// the length of the body is only known if it is sent with a length or chunked
+	if ( !bChunked && !bHasLength && nStatus != 204 && nStatus != 304 )
+		bKeepAlive = false;
+
+	if ( nStatus != 200 && nStatus != 206 )
+	{
+		// skip the body of the error response to keep the connection usable
+		if ( bKeepAlive )
+		{
+			CHTTPDiscardSink discard;
+			if ( bChunked )
+				bKeepAlive = ReadChunked( pConn, &discard ); else
+				bKeepAlive = ReadBody( pConn, &discard, nLength );
+		}
+		return nStatus;
+	}
+
+	unsigned nStart = ( nStatus == 206 ) ? nRangeStart : 0;
+	if ( !pSink->Begin( nStart, bHasLength ? nStart + nLength : 0 ) )
+	{
+		bKeepAlive = false;
+		return 0;
+	}
+
+	boolean bComplete;
+	if ( bChunked )
+		bComplete = ReadChunked( pConn, pSink ); else
+	if ( bHasLength )
+		bComplete = ReadBody( pConn, pSink, nLength ); else
+		bComplete = ReadUntilClose( pConn, pSink );
+
+	pSink->End( bComplete );
+
+	if ( !bComplete )
+	{
+		bKeepAlive = false;
+		return 0;
+	}
+
+	return nStatus;
+}
+
+unsigned CHTTPStreamClient::Get( CIPAddress &rIP, u16 nPort, const char *pHost, const char *pPath, CHTTPStreamSink *pSink, unsigned nOffset )
+{
+	// a reused connection might have been closed by the server in the meantime: retry once with a new one
+	for ( unsigned attempt = 0; attempt < 2; attempt++ )
+	{
+		boolean bReused, bKeepAlive, bResponse;
+		TConnection *pConn = Connect( rIP, nPort, pHost, bReused );
+		if ( pConn == 0 )
+			return 0;
+
+		unsigned nStatus = Request( pConn, pHost, pPath, pSink, nOffset, bKeepAlive, bResponse );
+
+		pConn->nLastUsed = CTimer::GetClockTicks();
+
+		if ( !bKeepAlive )
+			Close( pConn );
+
+		if ( nStatus != 0 || !bReused || bResponse )
+			return nStatus;
+	}
+	return 0;
+}
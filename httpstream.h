@@ -0,0 +1,222 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ httpstream.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - streaming HTTP client (keep-alive, chunked transfer)
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _httpstream_h
+#define _httpstream_h
+
+#include <circle/types.h>
+#include <circle/string.h>
+#include <circle/net/ipaddress.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/netsocket.h>
+#include <fatfs/ff.h>
+
+#ifdef WITH_TLS
+#include <circle-mbedtls/tlssimplesupport.h>
+#endif
+
+// number of connections which are kept open (e.g. one to the SKTP server and one to CSDB)
+#define HTTP_MAX_CONNECTIONS	2
+#define HTTP_RX_BUFFER_SIZE		4096
+#define HTTP_MAX_LINE			512
+
+//
+// receives the body of a response while it is being downloaded
+//
+class CHTTPStreamSink
+{
+public:
+	virtual ~CHTTPStreamSink( void ) {};
+
+	// called once the header has been parsed: 'nOffset' is the position of the first byte which 
+	// will be delivered (non-zero when a range request was answered), 'nTotalLength' is 0 if unknown
+	virtual boolean Begin( unsigned nOffset, unsigned nTotalLength ) { return true; };
+	// returning false aborts the transfer
+	virtual boolean Write( const u8 *pData, unsigned nLength ) = 0;
+	virtual void End( boolean bComplete ) {};
+};
+
+// stores the body in a fixed size memory block
+class CHTTPBufferSink : public CHTTPStreamSink
+{
+public:
+	CHTTPBufferSink( u8 *pBuffer, unsigned nSize ) : m_pBuffer( pBuffer ), m_nSize( nSize ), m_nLength( 0 ) {};
+
+	boolean Begin( unsigned nOffset, unsigned nTotalLength );
+	boolean Write( const u8 *pData, unsigned nLength );
+
+	unsigned GetLength( void ) { return m_nLength; };
+
+private:
+	u8       *m_pBuffer;
+	unsigned m_nSize;
+	unsigned m_nLength;
+};
+
+// writes the body to a file, an existing file is continued (see GetResumeOffset)
+class CHTTPFileSink : public CHTTPStreamSink
+{
+public:
+	CHTTPFileSink( void ) : m_bOpen( false ), m_nLength( 0 ) {};
+	~CHTTPFileSink( void );
+
+	boolean Open( const char *pFilename );
+	void Close( void );
+
+	// number of bytes which are already in the file
+	unsigned GetResumeOffset( void ) { return m_nLength; };
+
+	boolean Begin( unsigned nOffset, unsigned nTotalLength );
+	boolean Write( const u8 *pData, unsigned nLength );
+
+private:
+	FIL      m_File;
+	boolean  m_bOpen;
+	unsigned m_nLength;
+};
+
+// forwards the body to two sinks, the transfer continues if only the second one fails
+class CHTTPTeeSink : public CHTTPStreamSink
+{
+public:
+	CHTTPTeeSink( CHTTPStreamSink *pFirst, CHTTPStreamSink *pSecond ) : m_pFirst( pFirst ), m_pSecond( pSecond ), m_bSecondFailed( false ) {};
+
+	boolean Begin( unsigned nOffset, unsigned nTotalLength );
+	boolean Write( const u8 *pData, unsigned nLength );
+	void End( boolean bComplete );
+
+	boolean HasSecondFailed( void ) { return m_bSecondFailed; };
+
+private:
+	CHTTPStreamSink *m_pFirst, *m_pSecond;
+	boolean m_bSecondFailed;
+};
+
+//
+// incremental parser for multipart/form-data bodies: the body can be fed in arbitrary pieces,
+// the data of each part is passed on to the sink returned by BeginPart
+//
+#define MULTIPART_MAX_BOUNDARY	72
+#define MULTIPART_MAX_HEADER	1024
+
+class CMultipartParser
+{
+public:
+	CMultipartParser( void );
+	virtual ~CMultipartParser( void ) {};
+
+	// 'pContentType' is the value of the Content-Type header, returns false if there is no boundary
+	boolean Begin( const char *pContentType );
+
+	// returns false if the body is malformed or a sink failed
+	boolean Parse( const u8 *pData, unsigned nLength );
+
+	// true once the closing boundary has been seen
+	boolean IsComplete( void ) { return m_nState == MULTIPART_STATE_DONE; };
+
+protected:
+	// return 0 to skip the part
+	virtual CHTTPStreamSink *BeginPart( const char *pHeader ) = 0;
+	virtual boolean EndPart( CHTTPStreamSink *pSink ) = 0;
+
+private:
+	enum
+	{
+		MULTIPART_STATE_PREAMBLE = 0,
+		MULTIPART_STATE_BOUNDARY_END,
+		MULTIPART_STATE_HEADER,
+		MULTIPART_STATE_DATA,
+		MULTIPART_STATE_DONE,
+		MULTIPART_STATE_ERROR
+	};
+
+	boolean Emit( const u8 *pData, unsigned nLength );
+
+	unsigned m_nState;
+	// "\r\n--" followed by the boundary
+	char     m_Delimiter[ MULTIPART_MAX_BOUNDARY + 5 ];
+	unsigned m_nDelimiterLength;
+	unsigned m_nMatched;
+	char     m_Header[ MULTIPART_MAX_HEADER ];
+	unsigned m_nHeaderLength;
+	char     m_BoundaryEnd[ 2 ];
+	unsigned m_nBoundaryEndLength;
+	CHTTPStreamSink *m_pSink;
+};
+
+//
+// HTTP/1.1 client with persistent connections and chunked transfer decoding
+//
+class CHTTPStreamClient
+{
+public:
+#ifdef WITH_TLS
+	CHTTPStreamClient( CNetSubSystem *pNet, CircleMbedTLS::CTLSSimpleSupport *pTLSSupport );
+#else
+	CHTTPStreamClient( CNetSubSystem *pNet );
+#endif
+	~CHTTPStreamClient( void );
+
+	// returns the HTTP status code (200 or 206 on success) or 0 if the connection failed,
+	// with 'nOffset' > 0 the remaining part of the document is requested
+	unsigned Get( CIPAddress &rIP, u16 nPort, const char *pHost, const char *pPath, CHTTPStreamSink *pSink, unsigned nOffset = 0 );
+
+	void CloseAll( void );
+
+private:
+	typedef struct
+	{
+		CNetSocket *pSocket;
+		CIPAddress  ip;
+		u16         nPort;
+		unsigned    nLastUsed;
+		u8          rxBuffer[ HTTP_RX_BUFFER_SIZE ];
+		unsigned    nRxPos, nRxLength;
+	} TConnection;
+
+	TConnection *Connect( CIPAddress &rIP, u16 nPort, const char *pHost, boolean &bReused );
+	void Close( TConnection *pConn );
+
+	unsigned Request( TConnection *pConn, const char *pHost, const char *pPath, CHTTPStreamSink *pSink, unsigned nOffset, boolean &bKeepAlive, boolean &bResponse );
+
+	boolean Fill( TConnection *pConn );
+	boolean ReadLine( TConnection *pConn, char *pLine );
+	boolean ReadBody( TConnection *pConn, CHTTPStreamSink *pSink, unsigned nLength );
+	boolean ReadUntilClose( TConnection *pConn, CHTTPStreamSink *pSink );
+	boolean ReadChunked( TConnection *pConn, CHTTPStreamSink *pSink );
+
+	CNetSubSystem *m_pNet;
+#ifdef WITH_TLS
+	CircleMbedTLS::CTLSSimpleSupport *m_pTLSSupport;
+#endif
+	TConnection m_Conn[ HTTP_MAX_CONNECTIONS ];
+};
+
+#endif
@@ -0,0 +1,237 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ imagecache.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - RAM cache of launched and highlighted images
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "imagecache.h"
+#include "lowlevel_arm64.h"
+#include "helpers.h"
+#include "sdio.h"
+#include <circle/timer.h>
+#include <circle/util.h>
+
+typedef struct
+{
+	char	filename[ 1024 ];
+	u32		size;
+	u16		fdate, ftime;		// to detect files which changed after they have been cached
+	u32		lastUsed;
+	s32		req;				// read request (sdio.h) while the file is still being read, otherwise -1
+	u8		*data;
+} IMAGECACHE_SLOT;
+
+static u8 imageCachePool[ IMAGE_CACHE_SLOTS * IMAGE_CACHE_SLOT_SIZE ] AAA;
+static IMAGECACHE_SLOT slot[ IMAGE_CACHE_SLOTS ];
+static u32 useCounter = 0;
+
+static IMAGECACHE_SLOT *prefetchSlot = NULL;
+
+static u32 statLaunches = 0, statHits = 0;
+static u32 statPrefetches = 0, statPrefetchesAborted = 0;
+
+#ifndef WITH_NET
+static FATFS m_FileSystem;
+#endif
+
+static void mountDrive( CLogger *logger, const char *DRIVE )
+{
+#ifndef WITH_NET
+	if ( f_mount( &m_FileSystem, DRIVE, 1 ) != FR_OK )
+		logger->Write( "RaspiMenu", LogPanic, "Cannot mount drive: %s", DRIVE );
+#endif
+}
+
+static void unmountDrive( CLogger *logger, const char *DRIVE )
+{
+#ifndef WITH_NET
+	if ( f_mount( 0, DRIVE, 0 ) != FR_OK )
+		logger->Write( "RaspiMenu", LogPanic, "Cannot unmount drive: %s", DRIVE );
+#endif
+}
+
+static void freeSlot( IMAGECACHE_SLOT *s )
+{
+	if ( s->filename[ 0 ] && s->req >= 0 )
+	{
+		if ( sdioState( s->req ) == SDIO_QUEUED )
+			statPrefetchesAborted ++;
+		sdioRelease( s->req );
+	}
+	s->req = -1;
+	s->filename[ 0 ] = 0;
+}
+
+// returns 0 if the pending read of a slot failed
+static int completeSlot( IMAGECACHE_SLOT *s )
+{
+	if ( s->req < 0 )
+		return 1;
+
+	u32 ok = sdioWait( s->req ) == SDIO_DONE && sdioBytes( s->req ) == s->size;
+
+	sdioRelease( s->req );
+	s->req = -1;
+
+	if ( !ok )
+		s->filename[ 0 ] = 0;
+
+	return ok;
+}
+
+// returns the slot caching (or reading) the current version of the file (described by 'info'), or NULL
+static IMAGECACHE_SLOT *findSlot( const char *FILENAME, FILINFO *info )
+{
+	for ( u32 i = 0; i < IMAGE_CACHE_SLOTS; i++ )
+	{
+		IMAGECACHE_SLOT *s = &slot[ i ];
+
+		if ( s->filename[ 0 ] == 0 || strcmp( s->filename, FILENAME ) != 0 )
+			continue;
+
+		if ( s->size == (u32)info->fsize && s->fdate == info->fdate && s->ftime == info->ftime )
+		{
+			s->lastUsed = ++ useCounter;
+			return s;
+		}
+
+		// outdated
+		freeSlot( s );
+		return NULL;
+	}
+
+	return NULL;
+}
+
+// empty or least recently used slot
+static IMAGECACHE_SLOT *allocSlot()
+{
+	IMAGECACHE_SLOT *s = &slot[ 0 ];
+
+	for ( u32 i = 0; i < IMAGE_CACHE_SLOTS; i++ )
+	{
+		if ( slot[ i ].filename[ 0 ] == 0 )
+		{
+			s = &slot[ i ];
+			break;
+		}
+		if ( slot[ i ].lastUsed < s->lastUsed )
+			s = &slot[ i ];
+	}
+
+	freeSlot( s );
+	s->data = &imageCachePool[ ( s - slot ) * IMAGE_CACHE_SLOT_SIZE ];
+
+	return s;
+}
+
+// requests reading the file into a slot
+static IMAGECACHE_SLOT *readSlot( const char *FILENAME, FILINFO *info )
+{
+	if ( info->fsize == 0 || info->fsize > IMAGE_CACHE_SLOT_SIZE || strlen( FILENAME ) >= 1024 )
+		return NULL;
+
+	IMAGECACHE_SLOT *s = allocSlot();
+
+	s->req = sdioRead( FILENAME, 0, (u32)info->fsize, s->data );
+	if ( s->req < 0 )
+		return NULL;
+
+	strcpy( s->filename, FILENAME );
+	s->size = (u32)info->fsize;
+	s->fdate = info->fdate;
+	s->ftime = info->ftime;
+	s->lastUsed = ++ useCounter;
+
+	return s;
+}
+
+int imageCacheLoad( CLogger *logger, const char *DRIVE, const char *FILENAME, u8 **data, u32 *size, u32 readOnMiss )
+{
+	u64 t0 = CTimer::GetClockTicks();
+
+	mountDrive( logger, DRIVE );
+
+	FILINFO info;
+	u32 found = f_stat( FILENAME, &info ) == FR_OK;
+
+	unmountDrive( logger, DRIVE );
+
+	IMAGECACHE_SLOT *s = found ? findSlot( FILENAME, &info ) : NULL;
+	u32 hit = s != NULL;
+	u32 prefetching = hit && s->req >= 0 && sdioState( s->req ) == SDIO_QUEUED;
+
+	if ( found && !s && readOnMiss )
+		s = readSlot( FILENAME, &info );
+
+	if ( s && !completeSlot( s ) )
+	{
+		logger->Write( "RaspiMenu", LogError, "Read error" );
+		s = NULL;
+	}
+
+	u32 t = (u32)( CTimer::GetClockTicks() - t0 );
+
+	statLaunches ++;
+	if ( hit )
+		statHits ++;
+
+	logger->Write( "RaspiMenu", LogNotice, "image cache %s: %s, %d bytes in %d us (%d of %d launches from cache, %d of %d prefetches aborted)",
+		prefetching ? "hit (prefetch completed)" : ( hit ? "hit" : "miss" ), FILENAME, s ? s->size : 0, t, statHits, statLaunches, statPrefetchesAborted, statPrefetches );
+
+	if ( !s )
+		return 0;
+
+	*data = s->data;
+	*size = s->size;
+
+	return 1;
+}
+
+int imageCachePrefetch( CLogger *logger, const char *DRIVE, const char *FILENAME )
+{
+	mountDrive( logger, DRIVE );
+
+	FILINFO info;
+	u32 found = f_stat( FILENAME, &info ) == FR_OK;
+
+	unmountDrive( logger, DRIVE );
+
+	if ( !found )
+		return 0;
+
+	if ( findSlot( FILENAME, &info ) )
+		return 1;
+
+	// only the most recent prefetch is continued
+	if ( prefetchSlot && prefetchSlot->req >= 0 && sdioState( prefetchSlot->req ) == SDIO_QUEUED )
+		freeSlot( prefetchSlot );
+
+	statPrefetches ++;
+	prefetchSlot = readSlot( FILENAME, &info );
+
+	return prefetchSlot != NULL;
+}
@@ -0,0 +1,51 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ imagecache.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - RAM cache of launched and highlighted images
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _imagecache_h
+#define _imagecache_h
+
+#include <circle/types.h>
+#include <circle/logger.h>
+
+// the largest images are .CRTs (see readCRTFileSimple)
+#define IMAGE_CACHE_SLOTS		16
+#define IMAGE_CACHE_SLOT_SIZE	( 1032 * 1024 )
+
+// LRU cache of recently launched and highlighted images (.PRG, .CRT, .D64, .SID) in RAM.
+// A cached image is only used if size and time stamp of the file on the SD card did not change.
+
+// returns 1 and the image if it is cached, otherwise reads it into the cache if 'readOnMiss' is set.
+// Every call counts as a launch for the statistics which are written to the log
+extern int imageCacheLoad( CLogger *logger, const char *DRIVE, const char *FILENAME, u8 **data, u32 *size, u32 readOnMiss = 1 );
+
+// requests reading FILENAME into the cache (unless it is cached already), the file is read by sdioPoll (see sdio.h)
+// while the main loop is idle. A prefetch which has not been completed is cancelled by the next one
+extern int imageCachePrefetch( CLogger *logger, const char *DRIVE, const char *FILENAME );
+
+#endif
@@ -29,6 +29,7 @@
 */
 
 #include "kernel_ar.h"
+#include "arena.h"
 #include "crt.h"
 #ifdef COMPILE_MENU
 #include "kernel_menu.h"
@@ -71,7 +72,8 @@ static unsigned char kernalROM[ 8192 ] AAA;
 
 // ... flash/ROM (32k) and RAM (8k)
 //u8 flash_cacheoptimized_pool[ 5 * 8192 + 1024 ] AAA;
-extern u8 flash_cacheoptimized_pool[ 1024 * 1024 + 1024 ] AAA;
+#define FLASH_POOL_SIZE ( 1024 * 1024 + 8 * 1024 )
+static u8 *flash_cacheoptimized_pool;	// claimed from the launch arena (arena.h)
 
 __attribute__( ( always_inline ) ) inline void setGAMEEXROM( u32 f )
 {
@@ -178,6 +180,8 @@ void CKernel::Run( void )
 	m_EMMC.Initialize();
 	#endif
 
+	flash_cacheoptimized_pool = (u8 *)arenaAlloc( logger, "flash", FLASH_POOL_SIZE );
+
 	// load kernal is any
 	u32 kernalSize = 0; // should always be 8192
 	if ( FILENAME_KERNAL != NULL )
@@ -199,7 +203,7 @@ void CKernel::Run( void )
 	memset( (void*)&ar, sizeof( ar ), 0 );
 	ar.bAtomicPower = header.type == 9 ? 1 : 0;
 
-	ar.flash_cacheoptimized = (u8 *)( ( (u64)&flash_cacheoptimized_pool[0] + 128 ) & ~127 );
+	ar.flash_cacheoptimized = flash_cacheoptimized_pool;
 	for ( u32 b = 0; b < 4; b++ )
 		for ( u32 i = 0; i < 8192; i++ )
 			ar.flash_cacheoptimized[ ( b * 8192 + ADDR_LINEAR2CACHE( i ) ) ] = temp[ (b * 8192 + i) * 2 ];
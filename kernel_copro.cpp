@@ -0,0 +1,81 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ kernel_copro.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - Sidekick Copro: math and 3D coprocessor for C64 programs
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "kernel_copro.h"
+
+static BUSCHAIN_COUNTERS counters;
+static COPRO_STATE copro AAA;
+
+void CKernelCopro::Run( void )
+{
+	// setup control lines, initialize latch and software I2C buffer
+	initLatch();
+	SETCLR_GPIO( bDMA | bEXROM | bNMI | bGAME, 0 );
+	latchSetClearImm( LATCH_RESET, LATCH_LED_ALL | LATCH_ENABLE_KERNAL );
+
+	coproInit( &copro );
+
+	logger->Write( "Copro", LogNotice, "math and 3D coprocessor at $df00-$df14" );
+
+	DisableIRQs();
+
+	// setup FIQ
+	m_InputPin.ConnectInterrupt( FIQ_HANDLER, FIQ_PARENT );
+	m_InputPin.EnableInterrupt ( GPIOInterruptOnRisingEdge );
+
+	counters.c64CycleCount = counters.resetCounter = 0;
+
+	// floating point and geometry commands run here, interrupted by the FIQ handler for every bus cycle
+	while ( true )
+	{
+		CACHE_PRELOAD_INSTRUCTION_CACHE( (void*)&FIQ_HANDLER, 2048 );
+
+		coproWork( &copro );
+	}
+
+	// and we'll never reach this...
+	m_InputPin.DisableInterrupt();
+}
+
+void CKernelCopro::FIQHandler( void *pParam )
+{
+	// a chain with the coprocessor registers only (see buschain.h and copro.h)
+	CBusFIQ b;
+	busChainCycle< CBusFIQ, &counters, CDevCopro< &copro > >( b );
+}
+
+int main()
+{
+	CKernelCopro kernel;
+	if ( kernel.Initialize() )
+		kernel.Run();
+
+	halt();
+	return EXIT_HALT;
+}
@@ -0,0 +1,164 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ kernel_decrunch.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - Sidekick Decrunch: .PRG launcher with a decrunch service for loaders
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "kernel_decrunch.h"
+
+static const char DRIVE[] = "SD:";
+static const char FILENAME[] = "SD:C64/test.prg";				// .PRG to start
+static const char FILENAME_CBM80[] = "SD:C64/launch.cbm80";	// launch code (CBM80 8k cart)
+static const char DIRECTORY_PACKED[] = "SD:C64/DECRUNCH";		// the packed files 00.lz4, 01.lz4, ...
+
+#define PACKED_POOL_SIZE	( 2 * 1024 * 1024 )
+#define STAGING_SIZE		( 1024 * 1024 )
+
+static BUSCHAIN_COUNTERS counters;
+static BUSDEV_LAUNCH launch AAA;
+static DECRUNCH_STATE decrunch AAA;
+
+static u8 prgData[ 65536 ] AAA;
+static u8 launchCode[ 65536 ] AAA;
+
+// reads the packed files (numbered from 00, up to the first missing one) into one pool
+static void loadPackedFiles()
+{
+	FATFS fs;
+	if ( f_mount( &fs, DRIVE, 1 ) != FR_OK )
+		logger->Write( "Decrunch", LogPanic, "Cannot mount drive: %s", DRIVE );
+
+	u8 *pool = (u8 *)arenaAlloc( logger, "packed files", PACKED_POOL_SIZE );
+	u32 used = 0;
+
+	for ( u32 i = 0; i < DECRUNCH_MAX_FILES; i++ )
+	{
+		char name[ 64 ];
+		FIL file;
+		FILINFO info;
+		UINT n;
+
+		sprintf( name, "%s/%02d.lz4", DIRECTORY_PACKED, i );
+		if ( f_stat( name, &info ) != FR_OK )
+			break;
+		if ( info.fsize > PACKED_POOL_SIZE - used )
+		{
+			logger->Write( "Decrunch", LogWarning, "no space left for %s", name );
+			break;
+		}
+		if ( f_open( &file, name, FA_READ | FA_OPEN_EXISTING ) != FR_OK )
+			break;
+		f_read( &file, &pool[ used ], (u32)info.fsize, &n );
+		f_close( &file );
+
+		decrunchAddFile( &decrunch, &pool[ used ], n );
+		used = ( used + n + 127 ) & ~127;
+	}
+
+	if ( f_mount( 0, DRIVE, 0 ) != FR_OK )
+		logger->Write( "Decrunch", LogPanic, "Cannot unmount drive: %s", DRIVE );
+
+	logger->Write( "Decrunch", LogNotice, "%u packed files, %u bytes", decrunch.nFiles, used );
+}
+
+void CKernelDecrunch::Run( void )
+{
+	// setup control lines, initialize latch and software I2C buffer
+	initLatch();
+	latchSetClearImm( 0, LATCH_RESET | LATCH_LED_ALL | LATCH_ENABLE_KERNAL );
+
+	m_EMMC.Initialize();
+
+	// the .PRG and the launch code as in kernel_launch.cpp, see launchGetProgram (launch.h)
+	u32 size, prgSize;
+	readFile( logger, (char*)DRIVE, (char*)FILENAME_CBM80, launchCode, &size );
+	readFile( logger, (char*)DRIVE, (const char*)FILENAME, prgData, &prgSize );
+
+	memset( &launch, 0, sizeof( launch ) );
+	launch.prgData = prgData;
+	launch.launchCode = launchCode;
+	u32 startAddr = prgData[ 0 ] + prgData[ 1 ] * 256;
+	launch.prgSizeBelowA000 = 0xa000 - startAddr;
+	if ( launch.prgSizeBelowA000 > prgSize - 2 )
+	{
+		launch.prgSizeBelowA000 = prgSize - 2;
+		launch.prgSizeAboveA000 = 0;
+	} else
+		launch.prgSizeAboveA000 = prgSize - launch.prgSizeBelowA000;
+	launch.prgPages = ( prgSize - 2 + 255 ) >> 8;
+	if ( launch.prgPages > 255 ) launch.prgPages = 255;
+	launch.prgLastPage = launch.prgPages ? launch.prgPages - 1 : 0;
+	launch.transferPart = 1;
+	launch.configSet = bGAME | bNMI | bDMA;
+	launch.configClr = bEXROM | bCTRL257;
+
+	// the decrunch service stays in IO2 after the launch code disabled the cartridge
+	arenaBegin( "decrunch" );
+	decrunchInit( &decrunch, (u8 *)arenaAlloc( logger, "decrunch staging", STAGING_SIZE ), STAGING_SIZE );
+	loadPackedFiles();
+	arenaEnd( logger );
+
+	SETCLR_GPIO( launch.configSet, launch.configClr );
+
+	DisableIRQs();
+
+	// setup FIQ
+	m_InputPin.ConnectInterrupt( FIQ_HANDLER, FIQ_PARENT );
+	m_InputPin.EnableInterrupt ( GPIOInterruptOnRisingEdge );
+
+	counters.c64CycleCount = counters.resetCounter = 0;
+
+	// ready to go
+	latchSetClear( LATCH_RESET, 0 );
+
+	// the files are decrunched here, interrupted by the FIQ handler for every bus cycle
+	while ( true )
+	{
+		CACHE_PRELOAD_INSTRUCTION_CACHE( (void*)&FIQ_HANDLER, 2048 );
+
+		decrunchWork( &decrunch );
+	}
+
+	// and we'll never reach this...
+	m_InputPin.DisableInterrupt();
+}
+
+void CKernelDecrunch::FIQHandler( void *pParam )
+{
+	// the decrunch service before the launcher, which takes all writes to IO2 (see buschain.h and decrunch.h)
+	CBusFIQ b;
+	busChainCycle< CBusFIQ, &counters, CDevDecrunch< &decrunch >, CDevLaunch< &launch > >( b );
+}
+
+int main()
+{
+	CKernelDecrunch kernel;
+	if ( kernel.Initialize() )
+		kernel.Run();
+
+	halt();
+	return EXIT_HALT;
+}
@@ -0,0 +1,114 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ kernel_decrunch.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - Sidekick Decrunch: .PRG launcher with a decrunch service for loaders
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _kernel_decrunch_h
+#define _kernel_decrunch_h
+
+#define USE_HDMI_VIDEO
+
+#include <circle/startup.h>
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+#include <circle/memory.h>
+#include <circle/koptions.h>
+#include <circle/devicenameservice.h>
+#include <circle/screen.h>
+#include <circle/interrupt.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/sched/scheduler.h>
+#include <circle/types.h>
+#include <circle/gpioclock.h>
+#include <circle/gpiopin.h>
+#include <circle/gpiopinfiq.h>
+#include <circle/gpiomanager.h>
+#include <circle/util.h>
+
+#include <SDCard/emmc.h>
+#include <fatfs/ff.h>
+
+#include "lowlevel_arm64.h"
+#include "gpio_defs.h"
+#include "latch.h"
+#include "helpers.h"
+#include "arena.h"
+#include "decrunch.h"
+
+CLogger	*logger;
+#define FIQ_HANDLER	(this->FIQHandler)
+#define FIQ_PARENT	this
+
+class CKernelDecrunch
+{
+public:
+	CKernelDecrunch( void )
+		: m_CPUThrottle( CPUSpeedMaximum ),
+	#ifdef USE_HDMI_VIDEO
+		m_Screen( m_Options.GetWidth(), m_Options.GetHeight() ),
+	#endif
+		m_Timer( &m_Interrupt ),
+		m_Logger( m_Options.GetLogLevel(), &m_Timer ),
+		m_InputPin( PHI2, GPIOModeInput, &m_Interrupt ),
+		m_EMMC( &m_Interrupt, &m_Timer, 0 )
+	{
+	}
+
+	~CKernelDecrunch( void )
+	{
+	}
+
+	boolean Initialize( void )
+	{
+		STANDARD_SETUP_TIMER_INTERRUPT_CYCLECOUNTER_GPIO
+		logger = &m_Logger;
+		return bOK;
+	}
+
+	void Run( void );
+
+private:
+	static void FIQHandler( void *pParam );
+
+	// do not change this order
+	CMemorySystem		m_Memory;
+	CKernelOptions		m_Options;
+	CDeviceNameService	m_DeviceNameService;
+	CCPUThrottle		m_CPUThrottle;
+#ifdef USE_HDMI_VIDEO
+	CScreenDevice		m_Screen;
+#endif
+	CInterruptSystem	m_Interrupt;
+	CTimer				m_Timer;
+	CLogger				m_Logger;
+	CScheduler			m_Scheduler;
+	CGPIOPinFIQ			m_InputPin;
+	CEMMCDevice			m_EMMC;
+};
+
+#endif
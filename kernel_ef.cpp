@@ -28,6 +28,8 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "kernel_ef.h"
+#include "arena.h"
+#include "cartmapper.h"
 
 // use this, it you want LEDs to show EF accesses
 #define LED
@@ -86,6 +88,11 @@ typedef struct
 	// this is for orchestration of DMA-enforced stalling of the C64 to warm up caches
 	u32 releaseDMA;
 
+	// fast start: banks which are loaded already, the C64 is stalled (bankMissing = 1) until the selected one is
+	u8  bankResident[ 128 ];
+	u32 bankMissing;
+	u8  eapiErased[ EASYFLASH_BANKS ];
+
 	u32 flashFitsInCache;
 
 	// EAPI
@@ -113,8 +120,9 @@ typedef struct
 
 static unsigned char kernalROM[ 8192 ] AAA;
 
-// ... flash
-u8 flash_cacheoptimized_pool[ 1024 * 1024 + 8 * 1024 ] AAA;
+// ... flash (claimed from the launch arena, see arena.h)
+#define FLASH_POOL_SIZE ( 1024 * 1024 + 8 * 1024 )
+static u8 *flash_cacheoptimized_pool;
 
 static volatile EFSTATE ef AAA;
 
@@ -182,6 +190,10 @@ __attribute__( ( always_inline ) ) inline void eapiEraseSector( u8 bank, u32 add
 	for ( u32 i = 0; i < 8192 * 8; i++, p += 2 )
 		*p = 0xff;
 
+	// remember for banks which are still to be read from the .CRT (see streamNextChip)
+	for ( u32 i = 0; i < 8; i++ )
+		ef.eapiErased[ bank + i ] |= ( ( addr & 0xff00 ) != 0x8000 ) ? 2 : 1;
+
 	eapiSendReply( EAPI_REPLY_OK );
 }
 
@@ -301,6 +313,7 @@ void initEF()
 	ef.cyclesSinceReset = 0;
 
 	ef.releaseDMA = 0;
+	ef.bankMissing = 0;
 
 	ef.eapiState = EAPI_STATE_MAIN;
 	ef.eapiBufCountIn = 0;
@@ -401,6 +414,62 @@ __attribute__( ( always_inline ) ) inline void prefetchComplete()
 		CACHE_PRELOAD_DATA_CACHE( kernalROM, 8192, CACHE_PRELOADL2KEEP );
 }
 
+static u32 crtStreaming = 0;
+
+#ifdef EF_FAST_START
+static CRT_STREAM crtStream;
+static const char *crtStreamFilename;
+
+// reads the next CHIP packet of the .CRT: a bank is complete once its ROML and/or ROMH packets contained in the file
+// have been read (see crtStreamBankComplete), banks not contained in the file once the file ends
+static void streamNextChip()
+{
+	if ( !crtStream.open )
+		crtStreamResume( logger, &crtStream, DRIVE, crtStreamFilename );
+
+	s32 bank = crtStreamNextChip( logger, &crtStream, (u8*)ef.flash_cacheoptimized, &ef.ROM_LH, &ef.nBanks );
+
+	// the C64 may have erased sectors (EAPI) which were not loaded at that time
+	if ( bank >= 0 && bank < EASYFLASH_BANKS && ef.eapiErased[ bank ] )
+	{
+		for ( u32 h = 0; h < 2; h++ )
+			if ( ef.eapiErased[ bank ] & ( 1 << h ) )
+			{
+				u8 *p = &ef.flash_cacheoptimized[ bank * 8192 * 2 + h ];
+				for ( u32 i = 0; i < 8192; i++, p += 2 )
+					*p = 0xff;
+			}
+	}
+
+	if ( bank >= 0 && crtStreamBankComplete( &crtStream, bank ) )
+	{
+		// the data must be written before the FIQ handler can see the bank as resident
+		DataMemBarrier();
+		ef.bankResident[ bank & 127 ] = 1;
+	}
+
+	if ( bank < 0 )
+	{
+		crtStreamClose( logger, &crtStream );
+		for ( u32 i = 0; i < 128; i++ )
+			ef.bankResident[ i ] = 1;
+		crtStreaming = 0;
+	}
+}
+#endif
+
+// stops reading the .CRT in the main loop, with 'complete' set the remaining banks are read before (e.g. to write changes back)
+static void finishStreaming( u32 complete )
+{
+#ifdef EF_FAST_START
+	while ( crtStreaming && complete )
+		streamNextChip();
+
+	crtStreamClose( logger, &crtStream );
+	crtStreaming = 0;
+#endif
+}
+
 static u32 LED_INIT1_HIGH;	
 static u32 LED_INIT1_LOW;	
 static u32 LED_INIT2_HIGH;	
@@ -444,15 +513,44 @@ static bool irqFallingEdge = true;
 
 static void KernelEFFIQHandler_nobank( void *pParam );
 static void KernelEFFIQHandler_Zaxxon( void *pParam );
-static void KernelEFFIQHandler_Prophet( void *pParam );
-static void KernelEFFIQHandler_Ocean( void *pParam );
-static void KernelEFFIQHandler_RGCD( void *pParam );
-static void KernelEFFIQHandler_GMOD2( void *pParam );
-static void KernelEFFIQHandler_C64GS( void *pParam );
 static void KernelEFFIQHandler_Dinamic( void *pParam );
-static void KernelEFFIQHandler_SimonsBasic( void *pParam );
-static void KernelEFFIQHandler_Comal80( void *pParam );
 static void KernelEFFIQHandler_EpyxFL( void *pParam );
+static void KernelEFFIQHandler_SimonsBasic( void *pParam );
+
+// the handlers of the other bank switching schemes are generated from their descriptions in cartmapper.h
+#define EF_MAPPER_FIQ( M )	cartMapperFIQ< M, volatile EFSTATE, &ef >
+
+// GMOD2: the EEPROM is connected to $de00 (bits 4-6) and read back in bit 7
+extern int m93c86_addr;
+extern uint8_t m93c86_data[ M93C86_SIZE ];
+
+class CGMOD2EEPROM : public CCartNoHooks
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b )
+	{
+		CACHE_PRELOADL2STRMW( &m93c86_data[ m93c86_addr * 2 ] );
+		ef.mainloopCount = 0;
+	}
+
+	template <class BUS> static inline u32 regRead( BUS &b )
+	{
+		return ef.eeprom_cs ? m93c86_read_data() << 7 : 0;
+	}
+
+	template <class BUS> static inline void regWrite( BUS &b, u32 D )
+	{
+		ef.eeprom_cs = ( D >> 6 ) & 1;
+		ef.eeprom_data = ( D >> 4 ) & 1;
+		ef.eeprom_clock = ( D >> 5 ) & 1;
+		m93c86_write_select( (uint8_t)ef.eeprom_cs );
+		if ( ef.eeprom_cs ) 
+		{
+			m93c86_write_data( (uint8_t)( ef.eeprom_data ) );
+			m93c86_write_clock( (uint8_t)( ef.eeprom_clock ) );
+		}
+	}
+};
 
 static void KernelEFFIQHandler( void *pParam );
 void KernelEFRun( CGPIOPinFIQ m_InputPin, CKernelMenu *kernelMenu, const char *FILENAME, const char *menuItemStr, bool hasData = false, u8 *crtDataExt = NULL, u32 crtSizeExt = 0, const char *FILENAME_KERNAL = NULL )
@@ -472,6 +570,8 @@ void CKernelEF::Run( void )
 	m_EMMC.Initialize();
 	#endif
 
+	flash_cacheoptimized_pool = (u8 *)arenaAlloc( logger, "flash", FLASH_POOL_SIZE );
+
 	// load kernal is any
 	u32 kernalSize = 0; // should always be 8192
 	if ( FILENAME_KERNAL != NULL )
@@ -485,12 +585,31 @@ void CKernelEF::Run( void )
 	bool getRAW = false;
 
 	// read .CRT
-	ef.flash_cacheoptimized = (u8 *)( ( (u64)&flash_cacheoptimized_pool[ 0 ] + 128 ) & ~127 );
+	ef.flash_cacheoptimized = flash_cacheoptimized_pool;
+	memset( (void*)ef.bankResident, 1, 128 );
+	memset( (void*)ef.eapiErased, 0, EASYFLASH_BANKS );
 	#ifdef COMPILE_MENU
 	if ( !hasData )
 	{
 	#endif
+	#ifdef EF_FAST_START
+		// read the .CRT chip by chip: if the FIQ handler can stall the C64 on a bank switch, we only wait for bank 0
+		crtStreamOpen( logger, &crtStream, &header, DRIVE, FILENAME, &ef.bankswitchType, &ef.ROM_LH, &ef.nBanks );
+		crtStreamFilename = FILENAME;
+		crtStreaming = 1;
+
+		u32 fastStart = ( ef.bankswitchType == BS_EASYFLASH || ef.bankswitchType == BS_MAGICDESK || ef.bankswitchType == BS_OCEAN ) ? 1 : 0;
+		if ( fastStart )
+			memset( (void*)ef.bankResident, 0, 128 );
+
+		while ( crtStreaming && ( !fastStart || !ef.bankResident[ 0 ] ) )
+			streamNextChip();
+
+		// other files are read before the C64 starts, the main loop resumes reading the .CRT
+		crtStreamClose( logger, &crtStream );
+	#else
 		readCRTFile( logger, &header, (char*)DRIVE, (char*)FILENAME, (u8*)ef.flash_cacheoptimized, &ef.bankswitchType, &ef.ROM_LH, &ef.nBanks, getRAW );
+	#endif
 	#ifdef COMPILE_MENU
 	}
 	else{
@@ -639,30 +758,22 @@ void CKernelEF::Run( void )
 	// setup FIQ
 	TGPIOInterruptHandler *myHandler = FIQ_HANDLER;
 	#ifdef COMPILE_MENU
-	if ( ef.bankswitchType == BS_NONE )
-		myHandler = KernelEFFIQHandler_nobank;
-	if ( ef.bankswitchType == BS_ZAXXON )
-		myHandler = KernelEFFIQHandler_Zaxxon;
-	if ( ef.bankswitchType == BS_PROPHET )
-		myHandler = KernelEFFIQHandler_Prophet;
-	if ( ef.bankswitchType == BS_FUNPLAY )
-		ef.bankswitchType = BS_MAGICDESK;
-	if ( ef.bankswitchType == BS_OCEAN )
-		myHandler = KernelEFFIQHandler_Ocean;
-	if ( ef.bankswitchType == BS_RGCD || ef.bankswitchType == BS_HUCKY )
-		myHandler = KernelEFFIQHandler_RGCD;
-	if ( ef.bankswitchType == BS_GMOD2 )
-		myHandler = KernelEFFIQHandler_GMOD2;
-	if ( ef.bankswitchType == BS_C64GS )
-		myHandler = KernelEFFIQHandler_C64GS;
-	if ( ef.bankswitchType == BS_DINAMIC )
-		myHandler = KernelEFFIQHandler_Dinamic;
-	if ( ef.bankswitchType == BS_COMAL80 )
-		myHandler = KernelEFFIQHandler_Comal80;
-	if ( ef.bankswitchType == BS_EPYXFL )
-		myHandler = KernelEFFIQHandler_EpyxFL;
-	if ( ef.bankswitchType == BS_SIMONSBASIC )
-		myHandler = KernelEFFIQHandler_SimonsBasic;
+	switch ( ef.bankswitchType )
+	{
+	case BS_NONE:			myHandler = KernelEFFIQHandler_nobank; break;
+	case BS_FUNPLAY:		ef.bankswitchType = BS_MAGICDESK; break;
+	case BS_ZAXXON:			myHandler = KernelEFFIQHandler_Zaxxon; break;
+	case BS_PROPHET:		myHandler = EF_MAPPER_FIQ( mapperProphet ); break;
+	case BS_OCEAN:			myHandler = EF_MAPPER_FIQ( mapperOcean ); break;
+	case BS_RGCD:			myHandler = EF_MAPPER_FIQ( mapperRGCD ); break;
+	case BS_HUCKY:			myHandler = EF_MAPPER_FIQ( mapperHucky ); break;
+	case BS_GMOD2:			myHandler = cartMapperFIQ< mapperGMOD2, volatile EFSTATE, &ef, CGMOD2EEPROM >; break;
+	case BS_C64GS:			myHandler = EF_MAPPER_FIQ( mapperC64GS ); break;
+	case BS_DINAMIC:		myHandler = KernelEFFIQHandler_Dinamic; break;
+	case BS_COMAL80:		myHandler = EF_MAPPER_FIQ( mapperComal80 ); break;
+	case BS_EPYXFL:			myHandler = KernelEFFIQHandler_EpyxFL; break;
+	case BS_SIMONSBASIC:	myHandler = KernelEFFIQHandler_SimonsBasic; break;
+	}
 	#endif
 	m_InputPin.ConnectInterrupt( myHandler, FIQ_PARENT );
 
@@ -742,10 +853,18 @@ void CKernelEF::Run( void )
 	{
 		#ifdef COMPILE_MENU
 		TEST_FOR_JUMP_TO_MAINMENU2FIQs_CB( ef.c64CycleCount, ef.resetCounter2, 
-		{ if ( ef.eapiCRTModified ) writeChanges2CRTFile( logger, (char*)DRIVE, (char*)FILENAME, (u8*)ef.flash_cacheoptimized, false );} 
+		{ finishStreaming( ef.eapiCRTModified ); if ( ef.eapiCRTModified ) writeChanges2CRTFile( logger, (char*)DRIVE, (char*)FILENAME, (u8*)ef.flash_cacheoptimized, false );} 
 		{ if ( ef.bankswitchType == BS_GMOD2 ) { extern uint8_t m93c86_data[M93C86_SIZE]; char fn[ 4096 ]; sprintf( fn, "%s.eeprom", FILENAME ); writeFile( logger, DRIVE, fn, m93c86_data, 2048 ); } } )
 		#endif
 
+		#ifdef EF_FAST_START
+		// load the remaining banks while the C64 is running
+		if ( crtStreaming )
+		{
+			streamNextChip();
+			continue;
+		}
+		#endif
 
 	#if 1
 		// if the C64 is turned off and the CRT has been modified => write back to SD
@@ -803,6 +922,23 @@ void CKernelEF::Run( void )
 	}	
 
 
+#ifdef EF_FAST_START
+// the C64 switched to a bank which is not loaded yet => stall it (DMA) until the main loop has read the bank
+#define STALL_IF_BANK_MISSING							\
+	if ( !ef.bankResident[ ef.reg0 ] ) {				\
+		if ( ef.releaseDMA == 0 ) {						\
+			WAIT_UP_TO_CYCLE( WAIT_TRIGGER_DMA );		\
+			CLR_GPIO( bDMA );							\
+		}												\
+		ef.releaseDMA = 0;								\
+		ef.bankMissing = 1;								\
+	}
+#define BANK_ARRIVED ( ef.bankMissing && ef.bankResident[ ef.reg0 ] )
+#else
+#define STALL_IF_BANK_MISSING
+#define BANK_ARRIVED 0
+#endif
+
 #define HANDLE_KERNAL_IF_REQUIRED \
 	if ( ef.hasKernal && ROMH_ACCESS && KERNAL_ACCESS ) {	\
 		WRITE_D0to7_TO_BUS( kernalROM[ GET_ADDRESS ] );		\
@@ -811,184 +947,197 @@ void CKernelEF::Run( void )
 	}
 
 
-//#ifdef COMPILE_MENU
-#if 1
-static void KernelEFFIQHandler_Prophet( void *pParam )
+#if 0
+this is an example of how to slow down the C64 using DMA
+static void KernelEFFIQHandler_nobank( void *pParam )
 {
 	register u32 D, addr;
+	register u8 *flashBankR = ef.flashBank;
 
 	START_AND_READ_ADDR0to7_RW_RESET_CS
 
-	addr = GET_ADDRESS0to7 << 5;
-	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
-
 	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
 
 	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
 
 	addr = GET_ADDRESS_CACHEOPT;
-
-	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
+	static int firstByte = 0;
+	//
+	// starting from here: CPU communication
+	//
+	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
 	{
-		D = ef.flashBank[ addr ];
+		D = *(u32*)&flashBankR[ addr * 2 ];
+		if ( ROMH_ACCESS )
+			D >>= 8; 
+
 		WRITE_D0to7_TO_BUS( D )
-	} else
-	if ( CPU_WRITES_TO_BUS && IO2_ACCESS && GET_IO12_ADDRESS == 0 )
-	{
-		READ_D0to7_FROM_BUS( D )
-		setLatchFIQ( LATCH_LED0 );
+		firstByte = 1;
 
-		if ( ( D >> 5 ) & 1 )
-		{ // cartridge off 
-			SET_GPIO( bGAME | bEXROM );
-		} else
-		{ // cartridge on
-			SETCLR_GPIO( bGAME, bEXROM );
-		}
+		goto cleanup;
+	}
 
-		ef.reg0 = D & 0x1f;
-		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
-	} 
-		
-	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	TRIGGER_DMA_COUNT_WRITES
+
+	static int bremse = 0;
+	static int triggerDMA = 0;
+	if ( firstByte )
+	if ( ++bremse > 100000 && TRIGGER_CAN_ASSERT_DMA )
+	{
+		TRIGGER_DMA( 50000 )
+		bremse = 0;
+		goto cleanup;
+	}
+
+	// reset handling: when button #2 is pressed together with #1 then the EF ram is erased, DMA is released as well
+	if ( !( g2 & bRESET ) ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
 	
 	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
 	{
 		ef.resetCounter = 0x8000000;
-		ef.releaseDMA = 0;
-		ef.reg0 = 0;
-		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
-		SETCLR_GPIO( bGAME | bDMA | bNMI, bEXROM );
+		SET_GPIO( bDMA | bNMI ); 
 		FINISH_BUS_HANDLING
 		return;
 	}
 
+cleanup:
+	HANDLE_DMA_TRIGGER_RELEASE
+
 	//CLEAR_LEDS_EVERY_8K_CYCLES
-	static u32 cycleCount = 0;
+	/*static u32 cycleCount = 0;
 	if ( !((++cycleCount)&8191) )
-		clrLatchFIQ( LATCH_LED0 );
+		clrLatchFIQ( LATCH_LED0 );*/
 
 	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
 }
 #endif
 
 
-static volatile u32 forceRead; 
 
-static void KernelEFFIQHandler_GMOD2( void *pParam )
+
+#ifdef COMPILE_MENU
+static void KernelEFFIQHandler_nobank( void *pParam )
+#else
+void CKernelEF::FIQHandler (void *pParam)
+#endif
 {
 	register u32 D, addr;
+	register u8 *flashBankR = ef.flashBank;
 
-	START_AND_READ_ADDR0to7_RW_RESET_CS
+	// after this call we have some time (until signals are valid, multiplexers have switched, the RPi can/should read again)
+	START_AND_READ_ADDR0to7_RW_RESET_CS_NO_MULTIPLEX
 
 	addr = GET_ADDRESS0to7 << 5;
-	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
+	CACHE_PRELOADL2KEEP( &flashBankR[ addr * 2 ] );
+
+	if ( VIC_HALF_CYCLE )
+	{
+		// FINETUNED = experimental code to explore VIC2-timings
+		#ifdef FINETUNED
+		WAIT_UP_TO_CYCLE( 100 );
+		g2 = read32( ARM_GPIO_GPLEV0 );	
+		SET_GPIO( bCTRL257 );	
+		register u32 t;
+		READ_CYCLE_COUNTER( t );
+		WAIT_UP_TO_CYCLE_AFTER( 75+50, t );
+		g3 = read32( ARM_GPIO_GPLEV0 );	
+		#else
+		READ_ADDR0to7_RW_RESET_CS_AND_MULTIPLEX
+		WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA_VIC2
+		#endif
 
-	extern int m93c86_addr;
-	extern uint8_t m93c86_data[M93C86_SIZE];
-	CACHE_PRELOADL2STRMW( &m93c86_data[ m93c86_addr * 2 ] );
+		if ( ROMH_ACCESS ) 
+		{
+			D = *(u8*)&flashBankR[ GET_ADDRESS_CACHEOPT * 2 + 1 ];
+			WRITE_D0to7_TO_BUS_VIC( D )
+		}
 
-	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
+		FINISH_BUS_HANDLING
+		return;
+	}  
 
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
+	SET_GPIO( bCTRL257 );	
 
-	ef.mainloopCount = 0;
+	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
 
-	TRIGGER_DMA_COUNT_WRITES
+	// read the rest of the signals
+	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
 
 	addr = GET_ADDRESS_CACHEOPT;
-	
 
-	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
-	{
-		D = ef.flashBank[ addr ];
-		WRITE_D0to7_TO_BUS( D )
-	} else
-	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
-	{
-		if (ef.eeprom_cs) {
-			D = m93c86_read_data() << 7;
-			WRITE_D0to7_TO_BUS( D )
-		} else
-			WRITE_D0to7_TO_BUS( 0 )
-	} else
-	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	// VIC2 read during badline?
+	if ( VIC_BADLINE )
 	{
-		READ_D0to7_FROM_BUS( D )
-
-		if ( ( D & 0xc0 ) == 0xc0 ) {
-			SETCLR_GPIO( bEXROM, bGAME ); 
-		} else if ( ( D & 0x40 ) == 0x00 ) {
-			SETCLR_GPIO( bGAME, bEXROM ); 
-		} else if ( ( D & 0x40 ) == 0x40 ) {
-			SET_GPIO( bGAME | bEXROM ); 
-		}
-		ef.eeprom_cs = ( D >> 6 ) & 1;
-		ef.eeprom_data = ( D >> 4 ) & 1;
-		ef.eeprom_clock = ( D >> 5 ) & 1;
-		m93c86_write_select( (uint8_t)ef.eeprom_cs );
-		if ( ef.eeprom_cs ) {
-			m93c86_write_data( (uint8_t)( ef.eeprom_data ) );
-			m93c86_write_clock( (uint8_t)( ef.eeprom_clock ) );
-		}
+		if ( !ef.LONGBOARD )
+			READ_ADDR8to12_ROMLH_IO12_BA
 
-		if ( ef.reg0 != (D & 0x3f) )
+		if ( ROMH_ACCESS ) 
 		{
-			ef.reg0 = D & 0x3f;
-			ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
-			CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+			D = *(u8*)&flashBankR[ addr * 2 + 1 ];
+			WRITE_D0to7_TO_BUS_BADLINE( D )
 		}
-	} 
+		FINISH_BUS_HANDLING
+		return;
+	}
+
+	//
+	// starting from here: CPU communication
+	//
+	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
+	{
+		D = *(u32*)&flashBankR[ addr * 2 ];
+		if ( ROMH_ACCESS )
+			D >>= 8; 
 
+		WRITE_D0to7_TO_BUS( D )
+		goto cleanup;
+	}
 
-	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	// reset handling: when button #2 is pressed together with #1 then the EF ram is erased, DMA is released as well
+	if ( !( g2 & bRESET ) ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
 	
 	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
 	{
 		ef.resetCounter = 0x8000000;
-		ef.releaseDMA = 0;
-		ef.reg0 = 0;
-		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
-		SETCLR_GPIO( bGAME | bDMA | bNMI, bEXROM );
+		SET_GPIO( bDMA | bNMI ); 
 		FINISH_BUS_HANDLING
 		return;
 	}
 
-	HANDLE_DMA_TRIGGER_RELEASE
+cleanup:
 
 	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
 }
 
-static void KernelEFFIQHandler_Ocean( void *pParam )
+#ifdef COMPILE_MENU
+// Zaxxon, Dinamic, Epyx Fastload and Simons' Basic stay hand-written: generated from a description in
+// cartmapper.h, their handlers took more time per cycle in CRTLoad/mapperbench
+
+static void KernelEFFIQHandler_Zaxxon( void *pParam )
 {
 	register u32 D, addr;
+	register u8 *flashBankR = ef.flashBank;
+	register u8 *bank0 = &ef.flash_cacheoptimized[ 0 ];
 
 	START_AND_READ_ADDR0to7_RW_RESET_CS
 
-	addr = GET_ADDRESS0to7 << 5;
-	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
-
 	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
 
 	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
 
 	addr = GET_ADDRESS_CACHEOPT;
 
-	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
+	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
 	{
-		D = ef.flashBank[ addr ];
+		D = *(u8*)&bank0[ (addr&0b1111111101111) * 2 + 0 ];
+		ef.reg0 = GET_ADDRESS & 0x1000 ? 1 : 0;
+		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 * 2 ];
 		WRITE_D0to7_TO_BUS( D )
-	} 
-	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	} else
+	if ( CPU_READS_FROM_BUS && ROMH_ACCESS )
 	{
-		READ_D0to7_FROM_BUS( D )
-		setLatchFIQ( LATCH_LED0 );
-		ef.reg0 = D & 0x3f;
-		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
+		D = *(u8*)&flashBankR[ ( addr & 0x3fff ) * 2 + 1 ];
+		WRITE_D0to7_TO_BUS( D )
 	} 
 
 	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
@@ -996,61 +1145,41 @@ static void KernelEFFIQHandler_Ocean( void *pParam )
 	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
 	{
 		ef.resetCounter = 0x8000000;
-		ef.releaseDMA = 0;
-		ef.reg0 = 0;
-		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
-		if ( ef.nBanks > 32 )
-			{SETCLR_GPIO( bDMA | bNMI | bGAME, bEXROM );} else
-			{SETCLR_GPIO( bDMA | bNMI, bEXROM | bGAME );} 
+		SET_GPIO( bDMA | bNMI ); 
 		FINISH_BUS_HANDLING
 		return;
 	}
 
-	//CLEAR_LEDS_EVERY_8K_CYCLES
-	static u32 cycleCount = 0;
-	if ( !((++cycleCount)&8191) )
-		clrLatchFIQ( LATCH_LED0 );
-
 	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
-}
 
-static void KernelEFFIQHandler_RGCD( void *pParam )
+static void KernelEFFIQHandler_Dinamic( void *pParam )
 {
 	register u32 D, addr;
+	register u8 *flashBankR = ef.flashBank;
 
 	START_AND_READ_ADDR0to7_RW_RESET_CS
 
-	addr = GET_ADDRESS0to7 << 5;
-	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
-
 	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
 
 	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
 
 	addr = GET_ADDRESS_CACHEOPT;
 
-	if ( CPU_READS_FROM_BUS && ROML_ACCESS && !ef.reg2 )
+	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
 	{
-		D = ef.flashBank[ addr ];
+		D = *(u32*)&flashBankR[ addr * 2 ];
+
 		WRITE_D0to7_TO_BUS( D )
-	} 
+	} else
 
-	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
+	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
 	{
-		READ_D0to7_FROM_BUS( D )
-		setLatchFIQ( LATCH_LED0 );
-		if ( D & 8 )
+		addr = GET_IO12_ADDRESS;
+		if ( ( addr & 0x0f ) == addr )
 		{
-			ef.reg2 = 1;
-			SET_GPIO( bDMA | bNMI | bGAME | bEXROM );
+			ef.reg0 = addr & 0x0f;
+			ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 * 2 ];
 		}
-		D &= 7;
-		if ( ef.bankswitchType == BS_HUCKY )
-			ef.reg0 = (D ^ 7) & (ef.nBanks - 1); else
-			ef.reg0 = D & (ef.nBanks - 1); 
-		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
 	} 
 
 	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
@@ -1058,284 +1187,14 @@ static void KernelEFFIQHandler_RGCD( void *pParam )
 	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
 	{
 		ef.resetCounter = 0x8000000;
-		ef.releaseDMA = 0;
-		ef.reg0 = ef.reg2 = 0;
-		if ( ef.bankswitchType == BS_HUCKY )
-			ef.reg0 = 7 & (ef.nBanks - 1);
-		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
-		SETCLR_GPIO( bDMA | bNMI | bGAME, bEXROM );
+		SET_GPIO( bDMA | bNMI ); 
 		FINISH_BUS_HANDLING
 		return;
 	}
 
-	//CLEAR_LEDS_EVERY_8K_CYCLES
-	static u32 cycleCount = 0;
-	if ( !((++cycleCount)&8191) )
-		clrLatchFIQ( LATCH_LED0 );
-
 	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
 }
 
-
-static void KernelEFFIQHandler_Zaxxon( void *pParam )
-{
-	register u32 D, addr;
-	register u8 *flashBankR = ef.flashBank;
-	register u8 *bank0 = &ef.flash_cacheoptimized[ 0 ];
-
-	START_AND_READ_ADDR0to7_RW_RESET_CS
-
-	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
-
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
-
-	addr = GET_ADDRESS_CACHEOPT;
-
-	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
-	{
-		D = *(u8*)&bank0[ (addr&0b1111111101111) * 2 + 0 ];
-		ef.reg0 = GET_ADDRESS & 0x1000 ? 1 : 0;
-		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 * 2 ];
-		WRITE_D0to7_TO_BUS( D )
-	} else
-	if ( CPU_READS_FROM_BUS && ROMH_ACCESS )
-	{
-		D = *(u8*)&flashBankR[ ( addr & 0x3fff ) * 2 + 1 ];
-		WRITE_D0to7_TO_BUS( D )
-	} 
-
-	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
-	
-	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
-	{
-		ef.resetCounter = 0x8000000;
-		SET_GPIO( bDMA | bNMI ); 
-		FINISH_BUS_HANDLING
-		return;
-	}
-
-	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
-}
-
-
-static void KernelEFFIQHandler_C64GS( void *pParam )
-{
-	register u32 D, addr;
-
-	START_AND_READ_ADDR0to7_RW_RESET_CS
-
-	addr = GET_ADDRESS0to7 << 5;
-	CACHE_PRELOADL2STRM( &ef.flashBank[ addr ] );
-
-	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
-
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
-
-
-	addr = GET_ADDRESS_CACHEOPT;
-
-	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
-	{
-		D = ef.flashBank[ addr ];
-		WRITE_D0to7_TO_BUS( D )
-	} else
-
-	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
-	{
-		setLatchFIQ( LATCH_LED0 | LATCH_LED1 );
-		ef.reg0 = 0;
-		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
-	} else
-
-	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
-	{
-		READ_D0to7_FROM_BUS( D )
-		setLatchFIQ( LATCH_LED0 | LATCH_LED1 );
-		ef.reg0 = GET_IO12_ADDRESS & 0x3f;
-		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 ];
-		CACHE_PRELOAD_DATA_CACHE( ef.flashBank, 8192, CACHE_PRELOADL2STRM )
-	} 
-
-	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
-	
-	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
-	{
-		ef.resetCounter = 0x8000000;
-		ef.releaseDMA = 0;
-		ef.reg0 = 0;
-		ef.flashBank = &ef.flash_cacheoptimized[ 0 ];
-		clrLatchFIQ( LATCH_LED1 );
-		SETCLR_GPIO( bGAME | bDMA | bNMI, bEXROM );
-		FINISH_BUS_HANDLING
-		return;
-	}
-
-	if ( ef.releaseDMA > 0 && --ef.releaseDMA == 0 )
-	{
-		WAIT_UP_TO_CYCLE( WAIT_RELEASE_DMA ); 
-		SET_GPIO( bDMA ); 
-		clrLatchFIQ( LATCH_LED1 );
-	}
-
-	//CLEAR_LEDS_EVERY_8K_CYCLES
-	static u32 cycleCount = 0;
-	if ( !((++cycleCount)&8191) )
-		clrLatchFIQ( LATCH_LED0 );
-
-	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
-}
-
-
-
-static void KernelEFFIQHandler_Dinamic( void *pParam )
-{
-	register u32 D, addr;
-	register u8 *flashBankR = ef.flashBank;
-
-	START_AND_READ_ADDR0to7_RW_RESET_CS
-
-	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
-
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
-
-	addr = GET_ADDRESS_CACHEOPT;
-
-	if ( CPU_READS_FROM_BUS && ROML_ACCESS )
-	{
-		D = *(u32*)&flashBankR[ addr * 2 ];
-
-		WRITE_D0to7_TO_BUS( D )
-	} else
-
-	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
-	{
-		addr = GET_IO12_ADDRESS;
-		if ( ( addr & 0x0f ) == addr )
-		{
-			ef.reg0 = addr & 0x0f;
-			ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 * 2 ];
-		}
-	} 
-
-	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
-	
-	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
-	{
-		ef.resetCounter = 0x8000000;
-		SET_GPIO( bDMA | bNMI ); 
-		FINISH_BUS_HANDLING
-		return;
-	}
-
-	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
-}
-
-
-
-static void KernelEFFIQHandler_Comal80( void *pParam )
-{
-	register u32 D, addr;
-	register u8 *flashBankR = ef.flashBank;
-
-	START_AND_READ_ADDR0to7_RW_RESET_CS
-
-	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
-
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
-
-	addr = GET_ADDRESS_CACHEOPT;
-
-	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
-	{
-		D = *(u32*)&flashBankR[ addr * 2 ];
-		if ( ROMH_ACCESS )
-			D >>= 8; 
-
-		WRITE_D0to7_TO_BUS( D )
-	} else
-
-	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
-	{
-		WRITE_D0to7_TO_BUS( ef.reg2 )
-	} else
-
-	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
-	{
-		READ_D0to7_FROM_BUS( D )
-
-		ef.reg2 = D & 0xc7;
-		ef.reg0 = D & 3;
-		ef.flashBank = &ef.flash_cacheoptimized[ ef.reg0 * 8192 * 2 ];
-
-		if ( D & 0x40 )
-			{SET_GPIO( bEXROM | bGAME );} else
-			{CLR_GPIO( bEXROM | bGAME );}
-	}
-
-
-	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
-	
-	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
-	{
-		ef.resetCounter = 0x8000000;
-		SET_GPIO( bDMA | bNMI ); 
-		FINISH_BUS_HANDLING
-		return;
-	}
-
-	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
-}
-
-
-static void KernelEFFIQHandler_SimonsBasic( void *pParam )
-{
-	register u32 D, addr;
-	register u8 *flashBankR = ef.flashBank;
-
-	START_AND_READ_ADDR0to7_RW_RESET_CS
-
-	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
-
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
-
-	addr = GET_ADDRESS_CACHEOPT;
-
-	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
-	{
-		D = *(u32*)&flashBankR[ addr * 2 ];
-		if ( ROMH_ACCESS )
-			D >>= 8; 
-
-		WRITE_D0to7_TO_BUS( D )
-	} else
-
-	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
-	{
-		SETCLR_GPIO( bGAME, bEXROM );
-	} else
-
-	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
-	{
-		CLR_GPIO( bGAME | bEXROM );
-	}
-
-	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
-	
-	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
-	{
-		ef.resetCounter = 0x8000000;
-		SETCLR_GPIO( bDMA | bNMI, bGAME | bEXROM );
-		FINISH_BUS_HANDLING
-		return;
-	}
-
-	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
-}
-
-
-
 static void KernelEFFIQHandler_EpyxFL( void *pParam )
 {
 	register u32 D, addr;
@@ -1391,12 +1250,7 @@ static void KernelEFFIQHandler_EpyxFL( void *pParam )
 	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
 }
 
-
-
-
-#if 0
-this is an example of how to slow down the C64 using DMA
-static void KernelEFFIQHandler_nobank( void *pParam )
+static void KernelEFFIQHandler_SimonsBasic( void *pParam )
 {
 	register u32 D, addr;
 	register u8 *flashBankR = ef.flashBank;
@@ -1408,10 +1262,7 @@ static void KernelEFFIQHandler_nobank( void *pParam )
 	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
 
 	addr = GET_ADDRESS_CACHEOPT;
-	static int firstByte = 0;
-	//
-	// starting from here: CPU communication
-	//
+
 	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
 	{
 		D = *(u32*)&flashBankR[ addr * 2 ];
@@ -1419,142 +1270,31 @@ static void KernelEFFIQHandler_nobank( void *pParam )
 			D >>= 8; 
 
 		WRITE_D0to7_TO_BUS( D )
-		firstByte = 1;
-
-		goto cleanup;
-	}
-
-	TRIGGER_DMA_COUNT_WRITES
-
-	static int bremse = 0;
-	static int triggerDMA = 0;
-	if ( firstByte )
-	if ( ++bremse > 100000 && TRIGGER_CAN_ASSERT_DMA )
-	{
-		TRIGGER_DMA( 50000 )
-		bremse = 0;
-		goto cleanup;
-	}
-
-	// reset handling: when button #2 is pressed together with #1 then the EF ram is erased, DMA is released as well
-	if ( !( g2 & bRESET ) ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
-	
-	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
-	{
-		ef.resetCounter = 0x8000000;
-		SET_GPIO( bDMA | bNMI ); 
-		FINISH_BUS_HANDLING
-		return;
-	}
-
-cleanup:
-	HANDLE_DMA_TRIGGER_RELEASE
-
-	//CLEAR_LEDS_EVERY_8K_CYCLES
-	/*static u32 cycleCount = 0;
-	if ( !((++cycleCount)&8191) )
-		clrLatchFIQ( LATCH_LED0 );*/
-
-	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
-}
-#endif
-
-
-
-
-#ifdef COMPILE_MENU
-static void KernelEFFIQHandler_nobank( void *pParam )
-#else
-void CKernelEF::FIQHandler (void *pParam)
-#endif
-{
-	register u32 D, addr;
-	register u8 *flashBankR = ef.flashBank;
-
-	// after this call we have some time (until signals are valid, multiplexers have switched, the RPi can/should read again)
-	START_AND_READ_ADDR0to7_RW_RESET_CS_NO_MULTIPLEX
-
-	addr = GET_ADDRESS0to7 << 5;
-	CACHE_PRELOADL2KEEP( &flashBankR[ addr * 2 ] );
-
-	if ( VIC_HALF_CYCLE )
-	{
-		// FINETUNED = experimental code to explore VIC2-timings
-		#ifdef FINETUNED
-		WAIT_UP_TO_CYCLE( 100 );
-		g2 = read32( ARM_GPIO_GPLEV0 );	
-		SET_GPIO( bCTRL257 );	
-		register u32 t;
-		READ_CYCLE_COUNTER( t );
-		WAIT_UP_TO_CYCLE_AFTER( 75+50, t );
-		g3 = read32( ARM_GPIO_GPLEV0 );	
-		#else
-		READ_ADDR0to7_RW_RESET_CS_AND_MULTIPLEX
-		WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA_VIC2
-		#endif
-
-		if ( ROMH_ACCESS ) 
-		{
-			D = *(u8*)&flashBankR[ GET_ADDRESS_CACHEOPT * 2 + 1 ];
-			WRITE_D0to7_TO_BUS_VIC( D )
-		}
-
-		FINISH_BUS_HANDLING
-		return;
-	}  
-
-	SET_GPIO( bCTRL257 );	
-
-	UPDATE_COUNTERS_MIN( ef.c64CycleCount, ef.resetCounter2 )
-
-	// read the rest of the signals
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
-
-	addr = GET_ADDRESS_CACHEOPT;
+	} else
 
-	// VIC2 read during badline?
-	if ( VIC_BADLINE )
+	if ( CPU_READS_FROM_BUS && IO1_ACCESS )
 	{
-		if ( !ef.LONGBOARD )
-			READ_ADDR8to12_ROMLH_IO12_BA
-
-		if ( ROMH_ACCESS ) 
-		{
-			D = *(u8*)&flashBankR[ addr * 2 + 1 ];
-			WRITE_D0to7_TO_BUS_BADLINE( D )
-		}
-		FINISH_BUS_HANDLING
-		return;
-	}
+		SETCLR_GPIO( bGAME, bEXROM );
+	} else
 
-	//
-	// starting from here: CPU communication
-	//
-	if ( CPU_READS_FROM_BUS && ROML_OR_ROMH_ACCESS )
+	if ( CPU_WRITES_TO_BUS && IO1_ACCESS )
 	{
-		D = *(u32*)&flashBankR[ addr * 2 ];
-		if ( ROMH_ACCESS )
-			D >>= 8; 
-
-		WRITE_D0to7_TO_BUS( D )
-		goto cleanup;
+		CLR_GPIO( bGAME | bEXROM );
 	}
 
-	// reset handling: when button #2 is pressed together with #1 then the EF ram is erased, DMA is released as well
-	if ( !( g2 & bRESET ) ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
+	if ( CPU_RESET ) { ef.resetCounter ++; } else { ef.resetCounter = 0; }
 	
 	if ( ef.resetCounter > 3 && ef.resetCounter < 0x8000000 )
 	{
 		ef.resetCounter = 0x8000000;
-		SET_GPIO( bDMA | bNMI ); 
+		SETCLR_GPIO( bDMA | bNMI, bGAME | bEXROM );
 		FINISH_BUS_HANDLING
 		return;
 	}
 
-cleanup:
-
 	OUTPUT_LATCH_AND_FINISH_BUS_HANDLING
 }
+#endif
 
 
 
@@ -1723,6 +1463,7 @@ void CKernelEF::FIQHandler (void *pParam)
 						ef.releaseDMA = NUM_DMA_CYCLES;
 						prefetchHeuristic();
 					}
+					STALL_IF_BANK_MISSING
 				} else 
 					setGAMEEXROM();
 			}
@@ -1751,6 +1492,7 @@ void CKernelEF::FIQHandler (void *pParam)
 				ef.releaseDMA = NUM_DMA_CYCLES;
 				prefetchHeuristic();
 			}
+			STALL_IF_BANK_MISSING
 
 			setGAMEEXROM();
 		}
@@ -1785,6 +1527,14 @@ void CKernelEF::FIQHandler (void *pParam)
 
 cleanup:
 
+	// the bank the C64 is waiting for has been loaded: prefetch and release DMA as after a regular bank switch
+	if ( BANK_ARRIVED )
+	{
+		ef.bankMissing = 0;
+		ef.releaseDMA = NUM_DMA_CYCLES;
+		prefetchHeuristic();
+	}
+
 	if ( ef.releaseDMA > 0 && --ef.releaseDMA == 0 )
 	{
 		WAIT_UP_TO_CYCLE( WAIT_RELEASE_DMA ); 
@@ -42,6 +42,10 @@
 
 #define USE_HDMI_VIDEO
 
+// start EasyFlash, Magic Desk and Ocean cartridges as soon as bank 0 is loaded, the other banks are read in the main loop
+// (the C64 is stalled using DMA when it switches to a bank which has not been loaded yet)
+#define EF_FAST_START
+
 #include <circle/startup.h>
 #include <circle/bcm2835.h>
 #include <circle/memio.h>
@@ -29,6 +29,7 @@
 */
 
 #include "kernel_fc3.h"
+#include "arena.h"
 
 // we will read this .CRT file 
 static const char DRIVE[] = "SD:";
@@ -71,7 +72,8 @@ static unsigned char kernalROM[ 8192 ] AAA;
 
 // ... flash/ROM
 //static u8 flash_cacheoptimized_pool[ 16 * 8192 * 2 + 128 ] AAA;
-extern u8 flash_cacheoptimized_pool[ 1024 * 1024 + 1024 ] AAA;
+#define FLASH_POOL_SIZE ( 1024 * 1024 + 8 * 1024 )
+static u8 *flash_cacheoptimized_pool;	// claimed from the launch arena (arena.h)
 
 static void initFC3()
 {
@@ -136,6 +138,8 @@ void CKernelFC3::Run( void )
 	m_EMMC.Initialize();
 	#endif
 
+	flash_cacheoptimized_pool = (u8 *)arenaAlloc( logger, "flash", FLASH_POOL_SIZE );
+
 	// load kernal is any
 	u32 kernalSize = 0; // should always be 8192
 	if ( FILENAME_KERNAL != NULL )
@@ -146,7 +150,7 @@ void CKernelFC3::Run( void )
 	} else
 		fc3.hasKernal = 0;
 
-	fc3.flash_cacheoptimized = (u8 *)( ( (u64)&flash_cacheoptimized_pool[0] + 128 ) & ~127 );
+	fc3.flash_cacheoptimized = flash_cacheoptimized_pool;
 
 	CRT_HEADER header;
 	u32 ROM_LH;
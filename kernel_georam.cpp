@@ -28,6 +28,7 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "kernel_georam.h"
+#include "arena.h"
 
 // let them blink
 #define LED
@@ -56,8 +57,7 @@ typedef struct
 
 volatile static GEOSTATE geo AAA;
 
-// geoRAM memory pool 
-static u8  geoRAM_Pool[ geoSizeKB * 1024 + 128 ] AA;
+// geoRAM memory (claimed from the launch arena)
 
 // u8* to current window
 #define GEORAM_WINDOW (&geo.RAM[ ( geo.reg[ 1 ] * 16384 ) + ( geo.reg[ 0 ] * 256 ) ])
@@ -66,7 +66,7 @@ static u8  geoRAM_Pool[ geoSizeKB * 1024 + 128 ] AA;
 void geoRAM_Init()
 {
 	geo.reg[ 0 ] = geo.reg[ 1 ] = 0;
-	geo.RAM = (u8*)( ( (u64)&geoRAM_Pool[0] + 128 ) & ~127 );
+	geo.RAM = (u8*)arenaAlloc( logger, "geoRAM", geoSizeKB * 1024 );
 	memset( geo.RAM, 0, geoSizeKB * 1024 );
 
 	geo.c64CycleCount = 0;
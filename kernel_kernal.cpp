@@ -28,6 +28,7 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "kernel_kernal.h"
+#include "buschain.h"
 
 // we will read this kernal .bin file
 static const char DRIVE[] = "SD:";
@@ -39,8 +40,7 @@ static const char FILENAME_SPLASH_RGB[] = "SD:SPLASH/sk64_kernal.tga";
 static u32 allUsedLEDs = 0;
 
 // for rebooting the RPi
-static u64 c64CycleCount = 0;
-static u32 resetCounter = 0;
+static BUSCHAIN_COUNTERS counters;
 
 #ifdef COMPILE_MENU
 void KernelKernalRun( CGPIOPinFIQ m_InputPin, CKernelMenu *kernelMenu, char *FILENAME )
@@ -96,7 +96,7 @@ void CKernelKernal::Run( void )
 	FORCE_READ_LINEAR( kernalROM, 8192 );
 	FORCE_READ_LINEAR( &FIQ_HANDLER, 2048 );
 
-	c64CycleCount = resetCounter = 0;
+	counters.c64CycleCount = counters.resetCounter = 0;
 
 	// ready to go
 	latchSetClearImm( LATCH_ENABLE_KERNAL | LATCH_RESET, allUsedLEDs );
@@ -105,7 +105,7 @@ void CKernelKernal::Run( void )
 	while ( true )
 	{
 		#ifdef COMPILE_MENU
-		TEST_FOR_JUMP_TO_MAINMENU( c64CycleCount, resetCounter )
+		TEST_FOR_JUMP_TO_MAINMENU( counters.c64CycleCount, counters.resetCounter )
 		#endif
 
 		asm volatile ("wfi");
@@ -121,18 +121,8 @@ void KernelKernalFIQHandler( void *pParam )
 void CKernelKernal::FIQHandler (void *pParam)
 #endif
 {
-	// after this call we have some time (until signals are valid, multiplexers have switched, the RPi can/should read again)
-	START_AND_READ_ADDR0to7_RW_RESET_CS
-
-	// update some counters
-	UPDATE_COUNTERS_MIN( c64CycleCount, resetCounter )
-
-	// read the rest of the signals
-	WAIT_AND_READ_ADDR8to12_ROMLH_IO12_BA
-
-	if ( ROMH_ACCESS && KERNAL_ACCESS )
-		WRITE_D0to7_TO_BUS( kernalROM[ GET_ADDRESS ] );
-
-	FINISH_BUS_HANDLING
+	// a chain with the kernal replacement only (see buschain.h)
+	CBusFIQ b;
+	busChainCycle< CBusFIQ, &counters, CDevKernal< kernalROM > >( b );
 }
 
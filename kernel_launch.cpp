@@ -43,13 +43,11 @@ unsigned swiftLinkCounter = 0; //for debugging register communication
 //char swiftLinkReceived[ swiftLinkLogLengthMax ];
 
 unsigned char swiftLinkByte = 0; //incoming byte from frontend
-unsigned char swiftLinkResponse = 0; //byte that comes to frontend from terminal
+static CSwiftLink6551 swiftLink; //6551 registers, the receive data register holds the byte that comes to frontend from terminal
+static CModemLink *modemLink = NULL; //buffers of the modem emulation, owned by pSidekickNet
 unsigned swiftLinkDoNMI = 0;
 //unsigned swiftLinkReceivedCounter = 0; //byte count sent from terminal to frontend
-unsigned swiftLinkBaud = 0;
 unsigned swiftLinkBaudOld = 0;
-u32 swiftLinkRegisterCmd = 0,
-		swiftLinkRegisterCtrl = 0;
 bool swiftLinkReleaseDMA = false;
 unsigned swiftLinknetDelayDMA = swiftLinknetDelayDMADefault;
 
@@ -76,6 +74,9 @@ u32 prgSize;
 unsigned char prgData[ 65536 ] AAA;
 static u32 startAddr, prgSizeAboveA000, prgSizeBelowA000;
 
+// block transfer: the C64 selects the first page of an 8k window of the .PRG which is then visible in ROML
+static u32 romlWindow, romlFirstPage, prgPages, prgLastPage, prgLastPageBytes;
+
 // in case the launch code starts with the loading address
 #define LAUNCH_BYTES_TO_SKIP	0
 static unsigned char launchCode[ 65536 ] AAA;
@@ -205,12 +206,20 @@ void CKernelLaunch::Run( void )
 	} else
 		prgSizeAboveA000 = prgSize - prgSizeBelowA000;
 
+	// number of 256-byte pages (without the load address), pages beyond the last one repeat the last one
+	prgPages = ( prgSize - 2 + 255 ) >> 8;
+	if ( prgPages > 255 ) prgPages = 255;
+	prgLastPage = prgPages ? prgPages - 1 : 0;
+	// bytes used in the last page (0 = all 256)
+	prgLastPageBytes = prgPages < 255 ? ( ( prgSize - 2 ) & 255 ) : 0;
+
 	resetFromCodeState = 0;
 
 	#ifdef WITH_NET
 	swiftLinkEnabled = false; //too early to enable here
 	swiftLinkByte = 0;
-	swiftLinkResponse = 0;
+	swiftLink.Reset();
+	modemLink = pSidekickNet->getModemLink();
 	swiftLinkDoNMI = 0;
 	#ifdef SW_DEBUG
 	swiftLinkCounter = 0;
@@ -219,9 +228,6 @@ void CKernelLaunch::Run( void )
 	//swiftLinkReceivedCounter = 0;
 	//swiftLinkReceived[0] = '\0';
 	#endif
-	swiftLinkRegisterCmd = 0;
-	swiftLinkRegisterCtrl = 0;
-	swiftLinkBaud = 0;
 	swiftLinkBaudOld = 0;
 	
 	unsigned keepNMILow = 0;
@@ -251,6 +257,7 @@ void CKernelLaunch::Run( void )
 // this code is in here twice?
 	c64CycleCount = resetCounter = 0;
 	disableCart = transferStarted = currentOfs = 0;
+	romlWindow = 0;
 	transferPart = 1;
 
 	// warm caches
@@ -268,6 +275,7 @@ void CKernelLaunch::Run( void )
 
 	c64CycleCount = resetCounter = 0;
 	disableCart = transferStarted = currentOfs = 0;
+	romlWindow = 0;
 	transferPart = 1;
 	CACHE_PRELOADL2KEEP( &prgData[ prgSizeBelowA000 + 2 ] );
 	CACHE_PRELOADL2KEEP( &prgData[ 0 ] );
@@ -320,11 +328,11 @@ void CKernelLaunch::Run( void )
 				//pSidekickNet->getModemEmuType() == 1 && 
 				pSidekickNet->isModemSocketConnected() &&
 				//!isDoubleDirect &&
-				(swiftLinkResponse == 0) && //there is no char prepared to be sent to frontend
-				(!pSidekickNet->areCharsInInputBuffer() || pSidekickNet->areCharsInOutputBuffer());
+				!swiftLink.IsReceiveFull() && //there is no char prepared to be sent to frontend
+				(!modemLink->HasCharsForTerminal() || modemLink->HasCharsFromTerminal());
 */				
 
-			if ( swiftLinkEnabled && !pSidekickNet->usesWLAN() && pSidekickNet->isModemSocketConnected() && swiftLinkResponse == 0 && swiftLinknetDelayDMA > 0)
+			if ( swiftLinkEnabled && !pSidekickNet->usesWLAN() && pSidekickNet->isModemSocketConnected() && !swiftLink.IsReceiveFull() && swiftLinknetDelayDMA > 0)
 				swiftLinknetDelayDMA--;
 
 			if (swiftLinkReleaseDMA) //swiftLinkDirectNetAccess || 
@@ -393,11 +401,11 @@ void CKernelLaunch::Run( void )
 					#endif
 					
 					
-					if  ( swiftLinkEnabled && swiftLinkBaud != swiftLinkBaudOld)
+					if  ( swiftLinkEnabled && swiftLink.GetBaudCode() != swiftLinkBaudOld)
 					{
-						swiftLinkBaudOld = swiftLinkBaud;
+						swiftLinkBaudOld = swiftLink.GetBaudCode();
 						unsigned baud = 0;
-						switch ( swiftLinkBaud )
+						switch ( swiftLinkBaudOld )
 						{
 							case  0: baud = 99999;	break; //enable enhanced speed!
 							case  5: baud = 300;	break;
@@ -474,26 +482,18 @@ void CKernelLaunch::Run( void )
 				keepNMILow == 0 && 
 				swiftLinkDoNMI == 0  
 			){
-				if ( swiftLinkResponse == 0 )
+				if ( !swiftLink.IsReceiveFull() )
 				{
-					if ( pSidekickNet->areCharsInInputBuffer())
-					{
-					unsigned char tmpOutput = pSidekickNet->getCharFromInputBuffer();
-					if ( tmpOutput > 0)
-					{
-						swiftLinkResponse = tmpOutput;
-//						swiftLinkReceived[swiftLinkReceivedCounter++] = tmpOutput;
-//						swiftLinkReceived[swiftLinkReceivedCounter] = '\0';
+					//RTS: the terminal program deasserts it (command register bits 2/3 = 0) when it cannot take more chars
+					if ( swiftLink.Receive( modemLink, CTimer::GetClockTicks() ) )
 						swiftLinkDoNMI = swiftLinkNmiDelay;
-					}
-				}
 				}
 				else
 					swiftLinkDoNMI = swiftLinkNmiDelay;
 			}
 
 			if ( swiftLinkDoNMI > 0 ){
-				/*if (swiftLinkResponse == 0)
+				/*if (!swiftLink.IsReceiveFull())
 				{
 					swiftLinkDoNMI = 0; // turn it off
 				}	
@@ -501,7 +501,7 @@ void CKernelLaunch::Run( void )
 				if ( swiftLinkDoNMI > 1)
 					swiftLinkDoNMI--;
 					//check for disabled receive interrupts
-				if ( (swiftLinkRegisterCmd & 1) != 0 && swiftLinkDoNMI == 1)
+				if ( swiftLink.IsDTR() && swiftLinkDoNMI == 1)
 //				if ( swiftLinkDoNMI == 1)
 				{
 						swiftLinkDoNMI = 0;
@@ -583,42 +583,17 @@ void CKernelLaunch::FIQHandler (void *pParam)
 		{
 			if ( IO1_ACCESS && CPU_READS_FROM_BUS ) // && (GET_IO12_ADDRESS >= 0x00 && GET_IO12_ADDRESS <= 0x03))
 			{
-				u32 D = 0;
-				bool hasReadByte = false;
-				if ( GET_IO12_ADDRESS == 0x01){ //status register
-					if ( swiftLinkResponse == 0)
-						D = 16 + 32; //set transmit flag ( +DSR), show that we are ready to get next byte from C64
-					else
-						D = 8; //8; //set data register flag, show c64 that it may now pick up a byte
-				}
-				else if ( GET_IO12_ADDRESS == 0x00) //data register
-				{ 
-					hasReadByte = true;
-					if ( swiftLinkResponse > 0)
-					{
-						D = swiftLinkResponse;
-						swiftLinkResponse = 0;
-					}
-					else 
-					  D = 72;//fake echo
-					#ifdef SW_DEBUG
+				u32 D = swiftLink.Read( GET_IO12_ADDRESS, modemLink, pSidekickNet->isModemSocketConnected() );
+				#ifdef SW_DEBUG
+				if ( GET_IO12_ADDRESS == SWIFTLINK_DATA )
 					swiftLinkDataReads++;
-					#endif
-				}
-				if ( GET_IO12_ADDRESS == 0x03) //control register
-				{ 
-					D = swiftLinkRegisterCtrl;
-				}
-				else if ( GET_IO12_ADDRESS == 0x02) // command register
-				{
-					D = swiftLinkRegisterCmd;
-				}
+				#endif
 				WRITE_D0to7_TO_BUS( D )
 
 				if ( pSidekickNet->isModemSocketConnected() && 
-				 	(!pSidekickNet->areCharsInInputBuffer() // hasReadByte &&  
+				 	(!modemLink->HasCharsForTerminal() // hasReadByte &&  
 					||	swiftLinknetDelayDMA < 1 )
-					//swiftLinkResponse == 0 && //there is no char prepared to be sent to frontend
+					//!swiftLink.IsReceiveFull() && //there is no char prepared to be sent to frontend
 				){
 					//FINISH_BUS_HANDLING
 					WAIT_UP_TO_CYCLE( WAIT_TRIGGER_DMA );
@@ -631,9 +606,9 @@ void CKernelLaunch::FIQHandler (void *pParam)
 				}
 				
 /*				
-				if ( !hasReadByte && pSidekickNet->isModemSocketConnected() &&
-					(swiftLinkResponse == 0) && //there is no char prepared to be sent to frontend
-					!pSidekickNet->areCharsInInputBuffer()
+				if ( GET_IO12_ADDRESS != SWIFTLINK_DATA && pSidekickNet->isModemSocketConnected() &&
+					!swiftLink.IsReceiveFull() && //there is no char prepared to be sent to frontend
+					!modemLink->HasCharsForTerminal()
 				){
 					WAIT_UP_TO_CYCLE( WAIT_TRIGGER_DMA );
 					CLR_GPIO( bDMA );
@@ -685,19 +660,9 @@ void CKernelLaunch::FIQHandler (void *pParam)
 				}
 				#endif
 */				
-				if ( GET_IO12_ADDRESS == 0x03) //control register
-				{ 
-					swiftLinkBaud = hl;
-					swiftLinkRegisterCtrl = D;
-				}
-				else if ( GET_IO12_ADDRESS == 0x02) //command register
-				{ 
-					swiftLinkRegisterCmd = D;
-				}
-				else if ( GET_IO12_ADDRESS == 0x00) //data register
+				if ( swiftLink.Write( GET_IO12_ADDRESS, D, modemLink ) ) //data register
 				{
 					swiftLinkByte = D;
-					pSidekickNet->addToModemOutputBuffer( D );
 					//pSidekickNet->handleModemEmulation( true );
 					if ( pSidekickNet->isModemSocketConnected() || D == 13)
 					{
@@ -719,8 +684,8 @@ void CKernelLaunch::FIQHandler (void *pParam)
 				#endif
 				
 				if ( pSidekickNet->isModemSocketConnected() &&
-					(swiftLinkResponse == 0) && //there is no char prepared to be sent to frontend
-					!pSidekickNet->areCharsInInputBuffer() && 
+					!swiftLink.IsReceiveFull() && //there is no char prepared to be sent to frontend
+					!modemLink->HasCharsForTerminal() && 
 					swiftLinknetDelayDMA < 1
 				){
 					WAIT_UP_TO_CYCLE( WAIT_TRIGGER_DMA );
@@ -760,9 +725,17 @@ void CKernelLaunch::FIQHandler (void *pParam)
 	}
  	#endif
 
-	// access to CBM80 ROM (launch code)
+	// access to CBM80 ROM (launch code), or the 8k window of the .PRG during a block transfer
 	if ( CPU_READS_FROM_BUS && ACCESS( ROM_LH ) )
-		WRITE_D0to7_TO_BUS( launchCode[ GET_ADDRESS + LAUNCH_BYTES_TO_SKIP ] );
+	{
+		if ( romlWindow )
+		{
+			u32 a = GET_ADDRESS, p = romlFirstPage + ( a >> 8 );
+			if ( p > prgLastPage ) p = prgLastPage;
+			WRITE_D0to7_TO_BUS( prgData[ 2 + ( p << 8 ) + ( a & 255 ) ] );
+		} else
+			WRITE_D0to7_TO_BUS( launchCode[ GET_ADDRESS + LAUNCH_BYTES_TO_SKIP ] );
+	}
 
 	if ( IO1_ACCESS ) 
 	{
@@ -770,7 +743,25 @@ void CKernelLaunch::FIQHandler (void *pParam)
 		{
 			transferStarted = 1;
 
-			// any write to IO1 will (re)start the PRG transfer
+			// $DE03 -> the 8k window in ROML starts at page D of the .PRG (block transfer)
+			if ( GET_IO12_ADDRESS == 3 )
+			{
+				READ_D0to7_FROM_BUS( D )
+				romlFirstPage = D;
+				romlWindow = 1;
+				FINISH_BUS_HANDLING
+				return;
+			}
+
+			// $DE04 -> ROML shows the launch code again
+			if ( GET_IO12_ADDRESS == 4 )
+			{
+				romlWindow = 0;
+				FINISH_BUS_HANDLING
+				return;
+			}
+
+			// any other write to IO1 will (re)start the PRG transfer
 			if ( GET_IO12_ADDRESS == 2 )
 			{
 				currentOfs = prgSizeBelowA000 + 2;
@@ -790,6 +781,22 @@ void CKernelLaunch::FIQHandler (void *pParam)
 		} else
 		// if ( CPU_READS_FROM_BUS ) 
 		{
+			if ( GET_IO12_ADDRESS == 3 )
+			{
+				// $DE03 -> number of 256-byte pages for the block transfer
+				WRITE_D0to7_TO_BUS( prgPages )
+				FINISH_BUS_HANDLING
+				return;
+			}
+
+			if ( GET_IO12_ADDRESS == 5 )
+			{
+				// $DE05 -> bytes used in the last page (0 = 256)
+				WRITE_D0to7_TO_BUS( prgLastPageBytes )
+				FINISH_BUS_HANDLING
+				return;
+			}
+
 			if ( GET_IO12_ADDRESS == 1 )	
 			{
 				// $DE01 -> get number of 256-byte pages
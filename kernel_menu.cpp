@@ -34,6 +34,12 @@ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
 #include "config.h"
 #include "c64screen.h"
 #include "charlogo.h"
+#include "calibration.h"
+#include "imagecache.h"
+#include "sdio.h"
+#include "arena.h"
+#include "profiler.h"
+#include "logring.h"
 
 // we will read these files
 static const char DRIVE[] = "SD:";
@@ -59,6 +65,7 @@ CSidekickNet *pSidekickNet = 0;//used for c64screen to display net config params
 static const char FILENAME_PRG[] = "SD:C64/rpimenu.prg";		// .PRG to start
 static const char FILENAME_CBM80[] = "SD:C64/launch.cbm80";		// launch code (CBM80 8k cart)
 static const char FILENAME_CONFIG[] = "SD:C64/sidekick64.cfg";		
+static const char FILENAME_TIMING[] = "SD:C64/sidekick64_timing.cfg";		
 static const char FILENAME_SIDKICK_CONFIG[] = "SD:C64/SIDKick_CFG.prg";		
 
 
@@ -85,6 +92,10 @@ static u32	transferStarted = 0;
 static u32	currentOfs      = 0;
 static u32  transferPart    = 0;
 
+// block transfer: the C64 selects the first page of an 8k window of the .PRG which is then visible in ROML
+static u32  romlWindow      = 0;
+static u32  romlFirstPage, prgPages, prgLastPage, prgLastPageBytes;
+
 // the menu .PRG and program to launch
 static u32 prgSize AAA;
 static unsigned char prgData[ 65536 ] AAA;
@@ -108,6 +119,7 @@ unsigned char charset[ 4096 ] AAA;
 u32 releaseDMA = 0;
 u32 doneWithHandling = 0;
 u32 c64CycleCount = 0;
+static u32 phi2Cycles = 0;
 u32 nBytesRead = 0;
 u32 first = 1;
 
@@ -128,6 +140,33 @@ static u32 launchKernel = 0;
 static u32 lastChar = 0;
 static u32 startForC128 = 0;
 
+// for the arena statistics in the log
+static const char *arenaKernelName( u32 k )
+{
+	switch ( k )
+	{
+	case 2:  return "kernal";
+	case 3:
+	case 10: return "geoRAM";
+	case 4:
+	case 40:
+	case 41: return "prg";
+	case 5:
+	case 99: return "easyflash";
+	case 6:
+	case 60: return "fc3";
+	case 61: return "kcs";
+	case 62: return "ss5";
+	case 7:
+	case 70: return "ar";
+	case 8:  return "sid";
+	case 9:
+	case 95: return "cart128";
+	case 11: return "launch";
+	default: return "unknown";
+	}
+}
+
 static u32 screenTransferBytes;
 static u8 *screenTransfer = &c64screen[ 0 ];
 static u32 colorTransferBytes;
@@ -286,6 +325,7 @@ void activateCart()
 	initScreenAndLEDCodes();
 	disableCart = 0;
 	transferStarted = 0;
+	romlWindow = 0;
 
 	latchSetClearImm( LED_ACTIVATE_CART1_HIGH, LED_ACTIVATE_CART1_LOW | LATCH_RESET | LATCH_ENABLE_KERNAL );
 	SETCLR_GPIO( configGAMEEXROMSet | bNMI | bDMA, configGAMEEXROMClr | bCTRL257 );
@@ -424,6 +464,11 @@ boolean CKernelMenu::Initialize( void )
 	memcpy( &prgData[0], RPIMENUPRG, prgSize );
 	logger->Write( "SidekickMenu", LogNotice, "rpimenu.prg was read from memory." );
 	#endif
+
+	prgPages = ( prgSize - 2 + 255 ) >> 8;
+	if ( prgPages > 255 ) prgPages = 255;
+	prgLastPage = prgPages ? prgPages - 1 : 0;
+	prgLastPageBytes = prgPages < 255 ? ( ( prgSize - 2 ) & 255 ) : 0;
 	
 	latchSetClearImm( LED_INIT3_HIGH, LED_INIT3_LOW );
 
@@ -438,6 +483,9 @@ boolean CKernelMenu::Initialize( void )
 		logger->Write( "SidekickMenu", LogPanic, "error reading .cfg" );
 	}
 
+	// calibrated timing profiles (optional)
+	readTimingProfiles( logger, (char*)DRIVE, (char*)FILENAME_TIMING );
+
 	u32 t;
 	if ( skinFontFilename[0] != 0 && readFile( logger, (char*)DRIVE, (char*)skinFontFilename, charset, &t ) )
 	{
@@ -491,6 +539,36 @@ void injectPOKE( u32 a, u8 d )
 	injectCode[ injectCodeOfs++ ] = ((a)>>8)&255;
 }
 
+// timing calibration: the loop is copied to the tape buffer ($0334) because code fetched from IO2
+// would not survive the sweep, it reads test patterns from IO2 and writes them back until told to stop
+#define CALIB_LOOP_OFS	128
+
+void injectTimingCalibration()
+{
+	const u8 loop[ 16 ] = {
+		0x78,						// sei
+		0xAD, CALIB_PORT_PATTERN, 0xDF,	// loop: lda $df06
+		0x8D, CALIB_PORT_ECHO, 0xDF,	//       sta $df07
+		0xAD, CALIB_PORT_DONE, 0xDF,	//       lda $df08
+		0xC9, CALIB_DONE_MAGIC,		//       cmp #$a5
+		0xD0, 0xF3,					//       bne loop
+		0x58,						// cli
+		0x60 };						// rts
+
+	memcpy( &injectCode[ CALIB_LOOP_OFS ], loop, 16 );
+
+	const u8 copy[ 14 ] = {
+		0xA2, 0x0F,					//    ldx #15
+		0xBD, CALIB_LOOP_OFS, 0xDF,	// l: lda $df80,x
+		0x9D, 0x34, 0x03,			//    sta $0334,x
+		0xCA,						//    dex
+		0x10, 0xF7,					//    bpl l
+		0x4C, 0x34, 0x03 };			//    jmp $0334
+
+	memcpy( &injectCode[ injectCodeOfs ], copy, 14 );
+	injectCodeOfs += 14;
+}
+
 
 u32 updateLogo = 0;
 unsigned char tftC128Logo[ 240 * 240 * 2 ];
@@ -516,6 +594,7 @@ boolean CKernelMenu::handleNetwork( boolean doRender)
 	//handleC64 - processes the key the user has pressed to determine how 
 	//the screen has to change (e.g. jump from page a to page b)
 	DisableFIQInterrupt();
+	profileSetContext( PROFILE_CTX_NET );
 	if (doRender)
 		handleC64( lastChar, &launchKernel, FILENAME, filenameKernal, menuItemStr, &startForC128 );
 
@@ -526,7 +605,7 @@ boolean CKernelMenu::handleNetwork( boolean doRender)
 	m_SidekickNet.handleQueuedNetworkAction();
 	if (m_SidekickNet.IsRunning()){
 		if ( m_SidekickNet.isDownloadReadyForLaunch()){
-			logger->Write( "RaspiMenu", LogNotice, "Download is ready for launch" );
+			LOGRING( LOGRING_MENU, LogNotice, "RaspiMenu", "Download is ready for launch" );
 			u32 launchKernelTmp = m_SidekickNet.getCSDBDownloadLaunchType();
 			if (launchKernelTmp > 0)
 			{
@@ -566,6 +645,9 @@ boolean CKernelMenu::handleNetwork( boolean doRender)
 	if ( m_SidekickNet.isSKTPScreenActive())
 		delayHandleNetworkValue = 1200000;
 	
+	// the messages of the network code and the web server are formatted here instead of where they occur
+	logRingFlush( logger );
+	profileSetContext( PROFILE_CTX_MENU );
 	enableFIQInterrupt();
 	return doRender;
 }
@@ -692,6 +774,42 @@ void CKernelMenu::Run( void )
 			latchSetClear( l_on, l_off );
 		}
 
+		// PAL/NTSC is known after a short measurement of the C64's clock
+		if ( timingMeasurePhi2( phi2Cycles, m_Timer.GetClockTicks() ) )
+			applyMachineTimingProfile();
+
+		if ( calibActive )
+		{
+			u32 result = stepTimingCalibration( m_Timer.GetClockTicks() );
+			if ( result != CALIB_RUNNING )
+			{
+				// the C64 leaves the calibration loop after reading the done-flag, if it doesn't it crashed during the sweep
+				u32 t = m_Timer.GetClockTicks();
+				while ( !calibAck && m_Timer.GetClockTicks() - t < 100000 )
+					asm volatile ("wfi");
+
+				if ( result == CALIB_OK )
+					writeTimingProfiles( logger, (char*)DRIVE, (char*)FILENAME_TIMING );
+
+				showTimingCalibrationResult( result );
+				renderC64();
+				warmCache( pFIQ );
+
+				if ( calibAck )
+				{
+					// NMI makes the menu code on the C64 fetch the screen again
+					CLR_GPIO( bNMI );
+					DELAY( 1 << 10 );
+					SET_GPIO( bNMI );
+				} else
+				{
+					latchSetClearImm( LATCH_LED0, LATCH_RESET );
+					DELAY(1<<20);
+					latchSetClearImm( LATCH_RESET | LATCH_LED0, 0 );
+				}
+			}
+		}
+
 		#ifdef WITH_NET
 		if ( keepNMILow > 0 ){
 				keepNMILow --;
@@ -736,6 +854,13 @@ void CKernelMenu::Run( void )
 			#ifdef WITH_NET
 			autoRefreshTimeLookup = 0; //prevent broken screen in system information screen on continuous keypress
 			#endif
+
+			// machine type might have been reported by the C64 -> choose timing profile
+			applyMachineTimingProfile();
+
+			// the calibration loop has been injected, the C64 will execute it after fetching the screen
+			if ( timingCalibrationRequested() )
+				beginTimingCalibration( m_Timer.GetClockTicks() );
 		}
 		#ifdef WITH_NET
 		else
@@ -812,6 +937,13 @@ void CKernelMenu::Run( void )
 		}
 		#endif
 
+		// while the cursor rests on an entry in the browser, its image is read into the cache (one chunk per iteration)
+		if ( !updateMenu && !calibActive )
+		{
+			prefetchBrowserEntry();
+			sdioPoll();
+			logRingFlush( logger, 1 );
+		}
 	}
 	
 	DisableFIQInterrupt();
@@ -829,6 +961,8 @@ void CKernelMenu::FIQHandler (void *pParam)
 {
 	register u32 D;
 
+	phi2Cycles ++;
+
 	if ( updateMenu && !doneWithHandling )
 		return;
 
@@ -871,7 +1005,13 @@ void CKernelMenu::FIQHandler (void *pParam)
 
 	if ( CPU_READS_FROM_BUS && ACCESS( ROM_LH ) )
 	{
-		WRITE_D0to7_TO_BUS( cartCBM80[ GET_ADDRESS ] );
+		if ( romlWindow )
+		{
+			u32 a = GET_ADDRESS, p = romlFirstPage + ( a >> 8 );
+			if ( p > prgLastPage ) p = prgLastPage;
+			WRITE_D0to7_TO_BUS( prgData[ 2 + ( p << 8 ) + ( a & 255 ) ] );
+		} else
+			WRITE_D0to7_TO_BUS( cartCBM80[ GET_ADDRESS ] );
 		nBytesRead ++;
 		FINISH_BUS_HANDLING
 		return;
@@ -882,6 +1022,18 @@ void CKernelMenu::FIQHandler (void *pParam)
 	{
 		u32 A = GET_IO12_ADDRESS;
 			
+		if ( A == 3 )
+		{
+			// $DE03 -> number of 256-byte pages for the block transfer
+			WRITE_D0to7_TO_BUS( prgPages )
+			FINISH_BUS_HANDLING
+		} else
+		if ( A == 5 )
+		{
+			// $DE05 -> bytes used in the last page of the block transfer (0 = 256)
+			WRITE_D0to7_TO_BUS( prgLastPageBytes )
+			FINISH_BUS_HANDLING
+		} else
 		if ( A == 1 )	
 		{
 			// $DE01 -> get number of 256-byte pages
@@ -910,6 +1062,18 @@ void CKernelMenu::FIQHandler (void *pParam)
 	if ( CPU_WRITES_TO_BUS && IO1_ACCESS ) // write to IO1
 	{
 		u32 A = GET_IO12_ADDRESS;
+
+		// $DE03 -> the 8k window in ROML starts at page D of the .PRG, $DE04 -> launch code again
+		if ( A == 3 || A == 4 )
+		{
+			READ_D0to7_FROM_BUS( D )
+			romlFirstPage = D;
+			romlWindow = ( A == 3 );
+			transferStarted = 1;
+			FINISH_BUS_HANDLING
+			return;
+		}
+
 		if ( A == 2 )
 			transferPart = 1; else
 			transferPart = 0;
@@ -961,6 +1125,12 @@ void CKernelMenu::FIQHandler (void *pParam)
 			charsetTransfer = &charset[ 0 ];
 			CACHE_PRELOADL2STRM( charsetTransfer );
 		} else
+		if ( A == CALIB_PORT_ECHO )
+		{
+			calibSamples ++;
+			if ( D != calibLastServed )
+				calibErrors ++;
+		} else
 		if ( A == 16 )
 		{
 			wireKernalDetectMode = 1;
@@ -1008,6 +1178,15 @@ void CKernelMenu::FIQHandler (void *pParam)
 		if ( A == 4 )
 		{
 			D = *( charsetTransfer ++ );
+		} else
+		if ( A == CALIB_PORT_PATTERN )
+		{
+			D = calibLastServed = calibPattern[ ( calibPatternIdx ++ ) & 255 ];
+		} else
+		if ( A == CALIB_PORT_DONE )
+		{
+			D = calibDone ? CALIB_DONE_MAGIC : 0;
+			calibAck |= calibDone;
 		} else
 			D = injectCode[ A ];
 
@@ -1052,6 +1231,11 @@ int main( void )
 	CKernelMenu kernel;
 	kernel.Initialize();
 
+	// the profiler can also be started/stopped through the web server
+	profileInit( pInterrupt );
+	if ( profileRate )
+		profileStart( profileRate );
+
 	extern void KernelKernalRun( CGPIOPinFIQ m_InputPin, CKernelMenu *kernelMenu, char *FILENAME );
 	//extern void KernelGeoRAMRun( CGPIOPinFIQ m_InputPin, CKernelMenu *kernelMenu ); unused
 	extern void KernelLaunchRun( CGPIOPinFIQ m_InputPin, CKernelMenu *kernelMenu, const char *FILENAME, bool hasData = false, u8 *prgDataExt = NULL, u32 prgSizeExt = 0, u32 c128PRG = 0, u32 playingPSID = 0 );
@@ -1077,6 +1261,7 @@ int main( void )
 	{
 		latchSetClearImm( LATCH_LED1, 0 );
 
+		profileSetContext( PROFILE_CTX_MENU );
 		kernel.Run();
 		if ( kernel.isRebootRequested() ) break;
 
@@ -1098,10 +1283,19 @@ int main( void )
 		u32 loadC128PRG = 0;
 		u32 playingPSID = 0;
 
+		// images read from the cache (or into it) are handed over to the kernels
+		u8 *imageData = NULL;
+		u32 imageSize = 0;
+		bool hasImage = false;
+
 		CleanDataCache();
 		InvalidateDataCache();
 		InvalidateInstructionCache();
 
+		// the kernel claims its large buffers from the arena, they are released when it returns
+		arenaBegin( arenaKernelName( launchKernel ) );
+		profileSetContext( PROFILE_CTX_KERNEL );
+
 		/* for debugging purposes only*/
 		if ( launchKernel == 255 ) 
 		{
@@ -1123,27 +1317,29 @@ int main( void )
 			if ( strstr( FILENAME, "PRG128" ) )
 				loadC128PRG = 1;
 
+			hasImage = imageCacheLoad( logger, DRIVE, FILENAME, &imageData, &imageSize );
+
 			if ( subSID ) {
 				applySIDSettings();
 				if ( octaSIDMode )
-					KernelSIDRun8( kernel.m_InputPin, &kernel, FILENAME, false, NULL, 0, loadC128PRG ); else
-					KernelSIDRun( kernel.m_InputPin, &kernel, FILENAME, false, NULL, 0, loadC128PRG ); 
+					KernelSIDRun8( kernel.m_InputPin, &kernel, FILENAME, hasImage, imageData, imageSize, loadC128PRG ); else
+					KernelSIDRun( kernel.m_InputPin, &kernel, FILENAME, hasImage, imageData, imageSize, loadC128PRG ); 
 				break;
 			}
 			if ( subGeoRAM ) {
 				settingsGetGEORAMInfo( geoRAMFile, &geoRAMSize );
 				if ( subHasKernal == -1 ) {
-					KernelRKLRun( kernel.m_InputPin, &kernel, NULL, FILENAME, geoRAMFile, geoRAMSize, false, NULL, 0, loadC128PRG ); 
+					KernelRKLRun( kernel.m_InputPin, &kernel, NULL, FILENAME, geoRAMFile, geoRAMSize, hasImage, imageData, imageSize, loadC128PRG ); 
 					break;
 				} else {
-					KernelRKLRun( kernel.m_InputPin, &kernel, filenameKernal, FILENAME, geoRAMFile, geoRAMSize, false, NULL, 0, loadC128PRG ); 
+					KernelRKLRun( kernel.m_InputPin, &kernel, filenameKernal, FILENAME, geoRAMFile, geoRAMSize, hasImage, imageData, imageSize, loadC128PRG ); 
 					break;
 				}
 			} else {
 				if ( subHasKernal == -1 ) {
-					KernelLaunchRun( kernel.m_InputPin, &kernel, FILENAME, false, NULL, 0, loadC128PRG );
+					KernelLaunchRun( kernel.m_InputPin, &kernel, FILENAME, hasImage, imageData, imageSize, loadC128PRG );
 				} else {
-					KernelRKLRun( kernel.m_InputPin, &kernel, filenameKernal, FILENAME, NULL, 0, false, NULL, 0, loadC128PRG ); 
+					KernelRKLRun( kernel.m_InputPin, &kernel, filenameKernal, FILENAME, NULL, 0, hasImage, imageData, imageSize, loadC128PRG ); 
 				}
 				break;
 			}
@@ -1151,7 +1347,7 @@ int main( void )
 		case 41:
 			playingPSID = 1; // intentionally no break
 		case 40: // launch something from a disk image or PRG in memory (e.g. a converted .SID-file)
-			logger->Write( "RaspiMenu", LogNotice, "filename from d64: %s", FILENAME );
+			LOGRING( LOGRING_MENU, LogNotice, "RaspiMenu", "filename from d64: %s", FILENAME );
 			#ifdef WITH_NET
 			if ( modeC128 && strstr( FILENAME, "128" ) )
 				startForC128 = 1;
@@ -1178,9 +1374,11 @@ int main( void )
 			}
 			break;
 		case 5:
+			// not cached: the .CRT is streamed by the kernel (which starts the C64 early)
+			hasImage = imageCacheLoad( logger, DRIVE, FILENAME, &imageData, &imageSize, 0 );
 			if ( subHasKernal == -1 )
-				KernelEFRun( kernel.m_InputPin, &kernel, FILENAME, menuItemStr, false, NULL, 0 );else
-		 		KernelEFRun( kernel.m_InputPin, &kernel, FILENAME, menuItemStr, false, NULL, 0, filenameKernal ); 
+				KernelEFRun( kernel.m_InputPin, &kernel, FILENAME, menuItemStr, hasImage, imageData, imageSize );else
+		 		KernelEFRun( kernel.m_InputPin, &kernel, FILENAME, menuItemStr, hasImage, imageData, imageSize, filenameKernal ); 
 			break;
 		case 99:
 			if ( subHasKernal == -1 )
@@ -1241,6 +1439,10 @@ int main( void )
 		default:
 			break;
 		}
+		arenaEnd( logger );
+		logRingFlush( logger );
+		if ( profileRate )
+			profileSave( logger );
 		#ifdef WITH_NET
 		pSidekickNet->setCurrentKernel( (char*)"m" );
 		#endif
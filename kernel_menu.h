@@ -103,6 +103,7 @@ extern CLogger *logger;
 
 void startInjectCode();
 void injectPOKE( u32 a, u8 d );
+void injectTimingCalibration();
 
 class CKernelMenu
 {
@@ -34,6 +34,7 @@
 #include "config.h"
 #include "264screen.h"
 #include "charlogo.h"
+#include "logring.h"
 
 // we will read these files
 static const char DRIVE[] = "SD:";
@@ -463,6 +464,8 @@ boolean CKernelMenu::handleNetwork( boolean doRender)
 	if ( m_SidekickNet.isSKTPScreenActive() )
 		delayHandleNetworkValue = 1100000;
 	
+	// messages of the web server (formatted here instead of in the request handling)
+	logRingFlush( logger );
 	enableFIQInterrupt();
 	return doRender;
 }
@@ -908,6 +911,7 @@ int main( void )
 		default:
 			break;
 		}
+		logRingFlush( logger );
 	}
 
 	logger->Write( "RaspiMenu", LogNotice, "Rebooting..." );
@@ -29,6 +29,7 @@
 */
 
 #include "kernel_rkl.h"
+#include "arena.h"
 
 #ifdef WITH_NETRAM
 extern CSidekickNet * pSidekickNet;
@@ -110,8 +111,7 @@ typedef struct
 
 volatile static GEOSTATE geo AAA;
 
-// geoRAM memory pool 
-static u8  geoRAM_Pool[ MAX_GEORAM_SIZE * 1024 + 128 ] AA;
+// geoRAM memory (claimed from the launch arena)
 
 // u8* to current window
 #define GEORAM_WINDOW (&geo.RAM[ ( geo.reg[ 1 ] * 16384 ) + ( geo.reg[ 0 ] * 256 ) ])
@@ -120,7 +120,7 @@ static u8  geoRAM_Pool[ MAX_GEORAM_SIZE * 1024 + 128 ] AA;
 static void geoRAM_Init()
 {
 	geo.reg[ 0 ] = geo.reg[ 1 ] = 0;
-	geo.RAM = (u8*)( ( (u64)&geoRAM_Pool[0] + 128 ) & ~127 );
+	geo.RAM = (u8*)arenaAlloc( logger, "geoRAM", MAX_GEORAM_SIZE * 1024 );
 	memset( geo.RAM, 0, geoSizeKB * 1024 );
 
 	geo.c64CycleCount = 0;
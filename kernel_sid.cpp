@@ -30,9 +30,14 @@
 */
 #include <math.h>
 #include "kernel_sid.h"
+#include "arena.h"
+#include "sidrec.h"
+#include "audioengine.h"
+#include "audioresampler.h"
 #ifdef COMPILE_MENU
 #include "kernel_menu.h"
 #include "launch.h"
+#include "profiler.h"
 
 static u32 launchPrg;
 #endif
@@ -44,6 +49,7 @@ static u32 launchPrg;
 static const char FILENAME_SPLASH_RGB[] = "SD:SPLASH/sk64_sid_bg2.tga";
 static const char FILENAME_SPLASH_RGB2[] = "SD:SPLASH/sk64_sid_bg.tga";
 static const char FILENAME_LED_RGB[] = "SD:SPLASH/sk64_sid_led.tga";
+static const char FILENAME_FILTER_TABLES[] = "SD:C64/residfilter.bin";
 
 //                 _________.___________         ____                      ________    ______  ____________  
 //_______   ____  /   _____/|   \______ \       /  _ \       ___.__. _____ \_____  \  /  __  \/_   \_____  \ 
@@ -52,6 +58,7 @@ static const char FILENAME_LED_RGB[] = "SD:SPLASH/sk64_sid_led.tga";
 // |__|    \___  >_______  /|___/_______  /    \_____\ \     / ____|__|_|  /______  /\______  /|___\_______ \
 //             \/        \/             \/            \/     \/          \/       \/        \/             \/
 #include "resid/sid.h"
+#include "sidreadback.h"
 using namespace reSID;
 
 u32 CLOCKFREQ = 985248;	// exact clock frequency of the C64 will be measured at start up
@@ -135,6 +142,7 @@ u32 cfgSID2_Addr = 0;
 s32 cfgVolSID1_Left, cfgVolSID1_Right;
 s32 cfgVolSID2_Left, cfgVolSID2_Right;
 s32 cfgVolOPL_Left, cfgVolOPL_Right;
+s32 cfgMixVolume[ 6 ];			// the six values above in the order used by sidMixSample
 s32 cfgMIDI = 0, cfgSoundFont = 0, cfgMIDIVolume = 0;
 
 extern u32 wireSIDAvailable;
@@ -211,6 +219,13 @@ void setSIDConfiguration( u32 mode, u32 sid1, u32 sid2, u32 sid2addr, u32 rr, u3
 	cfgMIDI = MIDI;
 	cfgSoundFont = soundfont;
 	cfgMIDIVolume = midiVol;
+
+	cfgMixVolume[ 0 ] = cfgVolSID1_Left;
+	cfgMixVolume[ 1 ] = cfgVolSID1_Right;
+	cfgMixVolume[ 2 ] = cfgVolSID2_Left;
+	cfgMixVolume[ 3 ] = cfgVolSID2_Right;
+	cfgMixVolume[ 4 ] = cfgVolOPL_Left;
+	cfgMixVolume[ 5 ] = cfgVolOPL_Right;
 }
 
 //  __     __                __      ___                   ___ 
@@ -221,6 +236,10 @@ void initSID()
 {
 	resetCounter = 0;
 
+	#ifdef COMPILE_MENU
+	prepareSIDFilterTables( logger, DRIVE, FILENAME_FILTER_TABLES );
+	#endif
+
 	for ( int i = 0; i < NUM_SIDS; i++ )
 	{
 		sid[ i ] = new SID;
@@ -391,8 +410,7 @@ static void initVisualization()
 	ledValueAvg[0] = ledValueAvg[1] = ledValueAvg[2] = 0.01f;
 }
 
-static unsigned char tftBackground2[ 240 * 240 * 2 ];
-static unsigned char tftLEDs[ 240 * 240 * 2 ];
+static unsigned char *tftBackground2, *tftLEDs;
 
 static u32 vu_Mode = 0;
 static u32 vuMeter[4] = { 0, 0, 0, 0 };
@@ -403,11 +421,140 @@ static u32 allUsedLEDs = 0;
 static int busValue = 0;
 static int busValueTTL = 0;
 static unsigned long long nCyclesEmulated = 0;
-static unsigned long long samplesElapsed = 0;
+static AUDIO_SAMPLE_CLOCK sampleClock;
+#ifdef USE_PWM_DIRECT
+static AUDIO_SAMPLE_CLOCK sampleClockPWM;
+#endif
 
 static u32 resetFromCodeState = 0;
 static u32 _playingPSID = 0;
 
+#ifdef COMPILE_MENU
+//
+// recording of the register write stream (SID_RECORD in the config file, format see sidrec.h)
+// events are collected in RAM while playing and written to SD:SIDREC/ when returning to the menu
+//
+#define SIDREC_BUFFER_SIZE	( 8 * 1024 * 1024 )
+
+extern u32 recordSIDStream;
+
+static u8 *sidRecBuffer = NULL;
+static u32 sidRecSize, sidRecEvents, sidRecFlags;
+static unsigned long long sidRecLastCycle, sidRecCycles;
+
+static void sidrecPut( unsigned long long cycle, u32 type, u32 reg, u32 data )
+{
+	if ( sidRecSize + SIDREC_MAX_EVENT > SIDREC_BUFFER_SIZE )
+	{
+		sidRecFlags |= SIDREC_FLAG_TRUNCATED;
+		return;
+	}
+
+	// cycle stamps are monotonic except after a reset, where the events start over at 0
+	u32 delta = ( cycle > sidRecLastCycle ) ? cycle - sidRecLastCycle : 0;
+	sidRecSize += sidrecPutEvent( &sidRecBuffer[ sidRecSize ], delta, type, reg, data );
+	sidRecLastCycle += delta;
+	sidRecCycles += delta;
+	sidRecEvents ++;
+}
+
+static void sidrecStart()
+{
+	if ( !recordSIDStream )
+		return;
+
+	sidRecBuffer = new u8[ SIDREC_BUFFER_SIZE ];
+	sidRecSize = sizeof( SIDREC_HEADER );
+	sidRecEvents = sidRecFlags = 0;
+	sidRecLastCycle = sidRecCycles = 0;
+}
+
+// called whenever the emulation restarts at cycle 0
+static void sidrecReset( unsigned long long cycle )
+{
+	if ( sidRecBuffer == NULL || sidRecEvents == 0 )
+		return;
+
+	sidrecPut( cycle, SIDREC_RESET, 0, 0 );
+	sidRecLastCycle = 0;
+}
+
+// classifies a ring buffer entry the same way the main loop does
+static void sidrecRecord( u32 g, unsigned long long cycle )
+{
+	if ( cfgMIDI && ( g & ( 1 << 31 ) ) )
+	{
+		sidrecPut( cycle, SIDREC_MIDI, 0, g & 0xffffff );
+		return;
+	}
+
+	unsigned char A, D;
+	decodeGPIO( g, &A, &D );
+
+	if ( cfgEmulateOPL2 && ( g & bIO2 ) )
+		sidrecPut( cycle, SIDREC_OPL, A, D ); else
+	if ( g & SID2_MASK )
+		sidrecPut( cycle, SIDREC_SID2, A, D ); else
+		sidrecPut( cycle, SIDREC_SID1, A, D );
+}
+
+static void sidrecSave()
+{
+	if ( sidRecBuffer == NULL )
+		return;
+
+	if ( sidRecEvents > 0 )
+	{
+		SIDREC_HEADER *h = (SIDREC_HEADER*)sidRecBuffer;
+		memset( h, 0, sizeof( SIDREC_HEADER ) );
+		h->magic = SIDREC_MAGIC;
+		h->version = SIDREC_VERSION;
+		h->flags = sidRecFlags;
+		if ( cfgEmulateOPL2 )		h->flags |= SIDREC_FLAG_OPL;
+		if ( cfgSID2_Disabled )		h->flags |= SIDREC_FLAG_SID2_DISABLED;
+		if ( cfgSID2_PlaySameAsSID1 )	h->flags |= SIDREC_FLAG_SID2_SAME;
+		if ( cfgMIDI )				h->flags |= SIDREC_FLAG_MIDI;
+		h->clockFreq = CLOCKFREQ;
+		h->sampleRate = SAMPLERATE;
+		for ( u32 i = 0; i < 2; i++ )
+		{
+			h->sidModel[ i ] = SID_MODEL[ i ];
+			h->sidDigiBoost[ i ] = SID_DigiBoost[ i ];
+		}
+		h->soundFont = cfgSoundFont;
+		h->midiVolume = cfgMIDIVolume;
+		for ( u32 i = 0; i < 6; i++ )
+			h->volume[ i ] = cfgMixVolume[ i ];
+		h->nEvents = sidRecEvents;
+		h->nCycles = (u32)sidRecCycles;
+
+		// first unused file name
+		char filename[ 64 ];
+		u32 size;
+		for ( u32 i = 0; i < 1000; i++ )
+		{
+			sprintf( filename, "SD:SIDREC/rec%03d.skr", i );
+			if ( !getFileSize( logger, DRIVE, filename, &size ) )
+				break;
+		}
+
+		if ( writeFile( logger, DRIVE, filename, sidRecBuffer, sidRecSize ) )
+			logger->Write( "", LogNotice, "recorded %u register writes to %s", sidRecEvents, filename );
+	}
+
+	delete [] sidRecBuffer;
+	sidRecBuffer = NULL;
+}
+#endif
+
+static void resetSampleClocks()
+{
+	audioClockInit( &sampleClock, CLOCKFREQ, SAMPLERATE );
+	#ifdef USE_PWM_DIRECT
+	audioClockInit( &sampleClockPWM, CLOCKFREQ, SAMPLERATE );
+	#endif
+}
+
 static void prepareOnReset( bool refresh = false )
 {
 #ifdef SUPPORT_MIDI
@@ -458,7 +605,8 @@ static void prepareOnReset( bool refresh = false )
 		FORCE_READ_LINEAR32a( (void*)&FIQ_HANDLER, 6*1024, 32768 );
 	}
 
-	resetCounter = cycleCountC64 = nCyclesEmulated = samplesElapsed = 0;
+	resetCounter = cycleCountC64 = nCyclesEmulated = 0;
+	resetSampleClocks();
 }
 
 //static u32 haltC64 = 0, letgoC64 = 0;
@@ -468,14 +616,25 @@ static int startVCHIQ = 0;
 
 #define SAMPLERATE 44100
 
-u32 SAMPLERATE_ADJUSTED = SAMPLERATE;
-extern u32 nSamplesPrecompute;
-u32 trackSampleProgress;
+// HDMI output: the emulation renders at SAMPLERATE (relative to the measured C64 clock), the resampler follows the
+// clock of the HDMI audio and keeps the frames in PCMBuffer and the sound queue at the target latency (HDMI_LATENCY
+// in the config file, in ms)
+#ifdef COMPILE_MENU
+extern u32 hdmiLatency;
+#else
+static const u32 hdmiLatency = 40;
+#endif
+
+static AUDIO_RESAMPLER hdmiResampler;
+static AUDIO_RATE_CONTROL hdmiRateControl;
+static u64 hdmiSamplesAtUpdate;
 
-static s32 avgSamplesAvail = 0;
-static s32 avgCounter = 0;
-static u32 adjustRateAllowed = 0;
-static u32 targetSamplesAvail = 0, targetCount = 0;
+static void resetHDMIResampler()
+{
+	audioResamplerInit( &hdmiResampler );
+	audioRateControlInit( &hdmiRateControl, hdmiLatency * SAMPLERATE / 1000, SAMPLERATE );
+	hdmiSamplesAtUpdate = 0;
+}
 
 u32 fillSoundBuffer;
 extern bool CVCHIQ_CB_Manual;
@@ -491,6 +650,167 @@ static u32 midiBufferOfs = midiBufferSize;
 
 
 
+//
+// the sound sources for the event driven emulation (see audioengine.h)
+//
+class CSIDSources
+{
+public:
+	// how far did we consume the commands in the ring buffer?
+	unsigned int ringRead;
+
+	u32 nextEvent( u64 *time )
+	{
+		if ( ringRead == ringWrite )
+			return 0;
+		*time = ringTime[ ringRead ];
+		return 1;
+	}
+
+	void applyEvent()
+	{
+		#ifdef COMPILE_MENU
+		if ( sidRecBuffer )
+			sidrecRecord( ringBufGPIO[ ringRead ], ringTime[ ringRead ] );
+		#endif
+
+#ifdef SUPPORT_MIDI
+		if ( cfgMIDI && (ringBufGPIO[ ringRead ] & (1<<31)) ) // MIDI
+		{
+			register u8 MC = ringBufGPIO[ ringRead ] & 255;
+			register u8 MD1 = ( ringBufGPIO[ ringRead ] >> 8 ) & 255;
+			register u8 MD2 = ( ringBufGPIO[ ringRead ] >> 16 ) & 255;
+			register u16 pitch;
+
+			register u8 channel = MC & 0x0f;
+			MC &= 0xf0;
+
+			switch ( MC )
+			{
+			default:
+				break;
+			case 0x90: // note on
+				tsf_channel_note_on( TinySoundFont, channel, MD1, (float)MD2 / 127.0f ); 
+				break;
+			case 0x80: // note off
+				tsf_channel_note_off( TinySoundFont, channel, MD1 ); 
+				break;
+			case 0xc0: // program change
+				tsf_channel_set_presetnumber( TinySoundFont, channel, MD1, ( channel == 9 ) );
+				break;
+			/*case 0xd0: // pressure change
+				break;*/
+			case 0xe0: // pitch bend
+				pitch = MD1 | ( MD2 << 7 );
+				tsf_channel_set_pitchwheel( TinySoundFont, channel, pitch );
+				break;
+			case 0xb0: // control change
+				tsf_channel_midi_control( TinySoundFont, channel, MD1, MD2 );
+				break;
+			}		
+		} else
+#endif
+		{
+			unsigned char A, D;
+			decodeGPIO( ringBufGPIO[ ringRead ], &A, &D );
+
+			#ifdef EMULATE_OPL2
+			if ( cfgEmulateOPL2 && (ringBufGPIO[ ringRead ] & bIO2) )
+			{
+				if ( ( ( A & ( 1 << 4 ) ) == 0 ) )
+					ym3812_write( pOPL, 0, D ); else
+					ym3812_write( pOPL, 1, D );
+			} else
+			#endif
+			//#if !defined(SID2_DISABLED) && !defined(SID2_PLAY_SAME_AS_SID1)
+			// TODO: generic masks
+			if ( !cfgSID2_Disabled && !cfgSID2_PlaySameAsSID1 && (ringBufGPIO[ ringRead ] & SID2_MASK) )
+			{
+				sid[ 1 ]->write( A & 31, D );
+			} else
+			//#endif
+			{
+				sid[ 0 ]->write( A & 31, D );
+				//outRegisters[ A & 31 ] = D;
+				//#if !defined(SID2_DISABLED) && defined(SID2_PLAY_SAME_AS_SID1)
+				if ( !cfgSID2_Disabled && cfgSID2_PlaySameAsSID1 )
+					sid[ 1 ]->write( A & 31, D );
+				//#endif
+			}
+		}
+		ringRead++;
+		ringRead &= ( RING_SIZE - 1 );
+	}
+
+	void clock( u32 cycles )
+	{
+		sid[ 0 ]->clock( cycles );
+		#ifndef SID2_DISABLED
+		if ( !cfgSID2_Disabled )
+			sid[ 1 ]->clock( cycles );
+		#endif
+
+		outRegisters[ 27 ] = sid[ 0 ]->read( 27 );
+		outRegisters[ 28 ] = sid[ 0 ]->read( 28 );
+		if ( !cfgSID2_Disabled )
+		{
+			outRegisters_2[ 27 ] = 0;
+			outRegisters_2[ 28 ] = 0;
+		}
+	}
+};
+
+static CSIDSources soundSources;
+
+//
+// exact read-back of OSC3/ENV3 of SID1 (SID_EXACT_READBACK in the config file, see sidreadback.h)
+//
+#ifdef COMPILE_MENU
+extern u32 exactSIDReadBack;
+#else
+static const u32 exactSIDReadBack = 0;
+#endif
+
+static CSIDReadBack readBack;
+static u32 readBackActive = 0, readBackRing;
+
+// writes to the registers $00-$14 of SID1 counted by the FIQ handler and passed to the model by the main loop, other
+// writes do not invalidate the predictions (SID2 writes are ignored unless they are played by SID1)
+static volatile u32 readBackWrites;
+static u32 readBackWritesPassed, readBackIgnore;
+
+// passes the SID1 writes captured since the last call to the model and extends its predictions
+static void readBackRunAhead()
+{
+	// all entries up to this position have been written at or before the cycle read afterwards
+	u32 w = __atomic_load_n( &ringWrite, __ATOMIC_ACQUIRE );
+	unsigned long long cycle = cycleCountC64;
+
+	while ( readBackRing != w )
+	{
+		u32 g = ringBufGPIO[ readBackRing ];
+
+		// same routing as CSIDSources::applyEvent()
+		if ( !( cfgMIDI && ( g & ( 1 << 31 ) ) ) &&
+			 !( cfgEmulateOPL2 && ( g & bIO2 ) ) &&
+			 !( !cfgSID2_Disabled && !cfgSID2_PlaySameAsSID1 && ( g & SID2_MASK ) ) )
+		{
+			unsigned char A, D;
+			decodeGPIO( g, &A, &D );
+			if ( ( A & 31 ) <= 0x14 )
+			{
+				readBack.write( ringTime[ readBackRing ], A & 31, D );
+				readBackWritesPassed ++;
+			}
+		}
+
+		readBackRing ++;
+		readBackRing &= ( RING_SIZE - 1 );
+	}
+
+	readBack.runAhead( cycle, readBackWritesPassed );
+}
+
 #ifdef COMPILE_MENU
 void KernelSIDFIQHandler( void *pParam );
 
@@ -592,6 +912,9 @@ void CKernel::Run( void )
 		tftPrepareDirtyUpdates();
 		tftUse12BitColor();
 
+		tftBackground2 = (unsigned char *)arenaAlloc( logger, "tftBackground", 240 * 240 * 2 );
+		tftLEDs = (unsigned char *)arenaAlloc( logger, "tftLEDs", 240 * 240 * 2 );
+
 		memcpy( tftBackground2, tftBackground, 240 * 240 * 2 );
 		tftLoadBackgroundTGA( DRIVE, FILENAME_LED_RGB, 8 );
 		memcpy( tftLEDs, tftBackground, 240 * 240 * 2 );
@@ -605,6 +928,15 @@ void CKernel::Run( void )
 	//logger->Write( "", LogNotice, "initialize SIDs..." );
 	initSID();
 
+	readBackActive = cfgRegisterRead && exactSIDReadBack;
+	if ( readBackActive )
+		readBack.init( SID_MODEL[ 0 ] == 6581 ? MOS6581 : MOS8580, SID_MODEL[ 0 ] == 8580 );
+	readBackIgnore = ( !cfgSID2_Disabled && !cfgSID2_PlaySameAsSID1 ) ? SID2_MASK : 0;
+
+	#ifdef COMPILE_MENU
+	sidrecStart();
+	#endif
+
 	//
 	// MIDI
 	//
@@ -644,6 +976,7 @@ void CKernel::Run( void )
 	//
 	startVCHIQ = 0;
 	initSoundOutput( &m_pSound, pVCHIQ, outputPWM, outputHDMI );
+	resetHDMIResampler();
 
 	#ifdef COMPILE_MENU
 	disableCart = 0;
@@ -709,10 +1042,10 @@ void CKernel::Run( void )
 	//logger->Write( "", LogNotice, "start emulating..." );
 	cycleCountC64 = 0;
 	nCyclesEmulated = 0;
-	samplesElapsed = 0;
+	resetSampleClocks();
 
-	// how far did we consume the commands in the ring buffer?
-	unsigned int ringRead = 0;
+	unsigned int &ringRead = soundSources.ringRead;
+	ringRead = 0;
 
 	#ifdef COMPILE_MENU
 	prepareOnReset( true );
@@ -765,8 +1098,10 @@ startHereAfterReset:
 	resetReleased = 0;
 	resetCounter = cycleCountC64 = 0;
 	nCyclesEmulated = 0;
-	samplesElapsed = 0;
+	resetSampleClocks();
 	ringRead = ringWrite = 0;
+	readBackRing = 0;
+	readBackWrites = readBackWritesPassed = 0;
 
 	latchSetClear( 0, allUsedLEDs );
 
@@ -777,6 +1112,11 @@ startHereAfterReset:
 	#endif
 
 	fillSoundBuffer = 0;
+
+	#ifdef COMPILE_MENU
+	profileSetContext( PROFILE_CTX_SID );
+	#endif
+
 	// new main loop mainloop
 	while ( true )
 	{
@@ -795,7 +1135,7 @@ startHereAfterReset:
 		}
 		if ( cycleCountC64 > 2000000 && resetCounter > 500000 ) {
 			CVCHIQ_CB_Manual = false;
-			//logger->Write( "", LogNotice, "adjusted sample rate: %u Hz", (u32)SAMPLERATE_ADJUSTED );
+			sidrecSave();
 			quitSID();
 			EnableIRQs();
 			m_InputPin.DisableInterrupt();
@@ -806,6 +1146,10 @@ startHereAfterReset:
 
 		if ( resetReleased == 1 )
 		{
+			#ifdef COMPILE_MENU
+			sidrecReset( nCyclesEmulated );
+			#endif
+
 			if ( m_pSound )
 			{
 				if ( outputHDMI )
@@ -817,11 +1161,7 @@ startHereAfterReset:
 				}
 				nSamplesInThisRun = startVCHIQ = 0;
 				initSoundOutput( &m_pSound, pVCHIQ, outputPWM, outputHDMI );
-				avgSamplesAvail = 0;
-				avgCounter = 0;
-				adjustRateAllowed = 0;
-				targetSamplesAvail = 0;
-				targetCount = 0;
+				resetHDMIResampler();
 			}
 
 			resetReleased = 0xff;
@@ -845,6 +1185,9 @@ startHereAfterReset:
 
 			ringRead = ringWrite;
 
+			if ( readBackActive )
+				readBack.reset();
+
 			prepareOnReset( true );
 			latchSetClear( allUsedLEDs, LATCH_RESET );
 			DELAY(1<<10);
@@ -884,6 +1227,9 @@ startHereAfterReset:
 		{
 			CACHE_PRELOAD_INSTRUCTION_CACHE( (void*)&FIQ_HANDLER, 6*1024 );
 
+			if ( readBackActive )
+				readBackRunAhead();
+
 		#ifdef USE_VCHIQ_SOUND
 			if ( outputHDMI )
 			{
@@ -897,7 +1243,10 @@ startHereAfterReset:
 					CVCHIQ_CB_Device = NULL;
 				}
 
-				if ( samplesElapsed > (8+1) * nSamplesPrecompute / 2 && !startVCHIQ )
+				extern u32 samplesInBuffer();
+
+				// the queue is still empty when the device starts (it plays two chunks of silence first)
+				if ( samplesInBuffer() / 2 >= hdmiRateControl.target && !startVCHIQ )
 				{
 					m_pSound->Start();
 					fillSoundBuffer = 1;
@@ -909,13 +1258,22 @@ startHereAfterReset:
 				{
 					fillSoundBuffer = 0;
 
-					extern u32 samplesInBuffer();
 					#define TYPE		s16
 					#define TYPE_SIZE	sizeof (s16)
 
-					s32 nFramesComputed = samplesInBuffer();
-					s32 nFramesMax = m_pSound->GetQueueSizeFrames() - m_pSound->GetQueueFramesAvail();
-					trackSampleProgress = 1024 * 1024 + ( nFramesComputed - nFramesMax );
+					// samplesInBuffer() counts samples, PCMBuffer holds interleaved frames
+					s32 nFramesComputed = samplesInBuffer() / 2;
+					s32 nFramesQueued = m_pSound->GetQueueFramesAvail();
+					s32 nFramesMax = m_pSound->GetQueueSizeFrames() - nFramesQueued;
+
+					// the occupancy does not depend on how many frames are written to the queue now
+					audioResamplerSetRatio( &hdmiResampler, audioRateControlUpdate( &hdmiRateControl,
+						nFramesComputed + nFramesQueued, (u32)( sampleClock.samplesElapsed - hdmiSamplesAtUpdate ) ) );
+					hdmiSamplesAtUpdate = sampleClock.samplesElapsed;
+
+					// the VCHIQ callbacks are handled in this loop once playback runs steadily
+					if ( hdmiRateControl.nUpdates > 150 )
+						CVCHIQ_CB_Manual = true;
 
 					s32 nWriteFrames = min( nFramesComputed, nFramesMax );
 
@@ -946,41 +1304,6 @@ startHereAfterReset:
 				}
 				if ( nSamplesInThisRun > 2205 / 8 )
 				{
-					if ( trackSampleProgress )
-					{
-						avgSamplesAvail += (s32)trackSampleProgress - 1024 * 1024;
-						avgCounter ++;
-
-						if ( avgCounter > 50 )
-						{
-							s32 avail = (s32)avgSamplesAvail / avgCounter;
-							if ( targetSamplesAvail == 0 && ++ targetCount > 2 )
-								CVCHIQ_CB_Manual = true; 
-							if ( targetSamplesAvail == 0 && ++ targetCount > 10 )
-								targetSamplesAvail = max( avail, (s32)nSamplesPrecompute );
-
-							if ( targetSamplesAvail != 0 )
-							{
-								if ( avail < (s32)targetSamplesAvail )
-								{
-									if ( avail < 5 * (s32)targetSamplesAvail / 100 && SAMPLERATE_ADJUSTED < SAMPLERATE )
-										SAMPLERATE_ADJUSTED = SAMPLERATE; else
-										SAMPLERATE_ADJUSTED ++; 
-								} else
-								if ( avail > (s32)targetSamplesAvail )
-								{
-									if ( avail > 105 * (s32)targetSamplesAvail / 100 && SAMPLERATE_ADJUSTED > SAMPLERATE )
-										SAMPLERATE_ADJUSTED = SAMPLERATE; else
-										SAMPLERATE_ADJUSTED --; 
-								}
-								adjustRateAllowed = 0;
-							}
-							//logger->Write( "", LogNotice, "samples ahead: %d (target: %d), rate: %u Hz", avail, targetSamplesAvail, SAMPLERATE_ADJUSTED );
-							avgSamplesAvail = avgCounter = 0;
-						}
-						trackSampleProgress = 0;
-					}
-
 					{
 						if ( nCyclesEmulated < (2*64000) )
 						{
@@ -1000,152 +1323,11 @@ startHereAfterReset:
 
 			CACHE_PRELOADL2STRMW( &smpCur );
 
-		#ifdef SMPCARRY
-
-			static u32 carrySamples = 0;
-			u32 samplesToEmulateX65536 = ( ( unsigned long long )65536 * ( unsigned long long )CLOCKFREQ ) / ( unsigned long long )SAMPLERATE + ( unsigned long long )carrySamples;
-
-			u32 samplesToEmulate = samplesToEmulateX65536 >> 16;
-			carrySamples = (samplesToEmulateX65536 & 65535);
-
-//			do 
-			{ // do SID emulation until time passed to create an additional sample (i.e. there may be several cycles until a sample value is created)
-				#ifdef USE_PWM_DIRECT
-				u32 cyclesToEmulate = samplesToEmulate;
-				#else			
-				u32 cyclesToEmulate = 2;
-				#endif
-
-		#else
-			unsigned long long samplesElapsedBefore = samplesElapsed;
+			// emulate up to the next sample, but not beyond the cycle the C64 has reached
+			audioClockSetRate( &sampleClock, CLOCKFREQ, SAMPLERATE );
+			if ( !audioEmulateToNextSample( soundSources, &sampleClock, nCyclesEmulated, cycleCount, 256 ) )
+				goto NoSampleGeneratedYet;
 
-			long long cycleNextSampleReady = ( ( unsigned long long )(samplesElapsedBefore+1) * ( unsigned long long )CLOCKFREQ ) / ( unsigned long long )SAMPLERATE_ADJUSTED;
-			u32 cyclesToNextSample = cycleNextSampleReady - nCyclesEmulated;
-
-			do { // do SID emulation until time passed to create an additional sample (i.e. there may be several cycles until a sample value is created)
-				u32 cyclesToEmulate = min( 256, cycleCount - nCyclesEmulated );
-		#endif
-
-				if ( cyclesToEmulate > cyclesToNextSample )
-					cyclesToEmulate = cyclesToNextSample;
-
-				if ( ringRead != ringWrite )
-				{
-					int cyclesToNextWrite = (signed long long)ringTime[ ringRead ] - (signed long long)nCyclesEmulated;
-
-					if ( (int)cyclesToEmulate > cyclesToNextWrite && cyclesToNextWrite > 0 )
-						cyclesToEmulate = cyclesToNextWrite;
-				}
-				if ( cyclesToEmulate == 0 )
-					cyclesToEmulate = 1;
-				
-				if ( cyclesToEmulate > 0 )
-				{
-					sid[ 0 ]->clock( cyclesToEmulate );
-					#ifndef SID2_DISABLED
-					if ( !cfgSID2_Disabled )
-						sid[ 1 ]->clock( cyclesToEmulate );
-					#endif
-
-					outRegisters[ 27 ] = sid[ 0 ]->read( 27 );
-					outRegisters[ 28 ] = sid[ 0 ]->read( 28 );
-					if ( !cfgSID2_Disabled )
-					{
-						outRegisters_2[ 27 ] = 0;
-						outRegisters_2[ 28 ] = 0;
-					}
-
-					nCyclesEmulated += cyclesToEmulate;
-					cyclesToNextSample -= cyclesToEmulate;
-				}
-
-
-				// apply register updates (we do one-cycle emulation steps, but in case we need to catch up...)
-				unsigned int readUpTo = ringWrite;
-
-				if ( ringRead != readUpTo && nCyclesEmulated >= ringTime[ ringRead ] )
-				{
-#ifdef SUPPORT_MIDI
-					if ( cfgMIDI && (ringBufGPIO[ ringRead ] & (1<<31)) ) // MIDI
-					{
-						register u8 MC = ringBufGPIO[ ringRead ] & 255;
-						register u8 MD1 = ( ringBufGPIO[ ringRead ] >> 8 ) & 255;
-						register u8 MD2 = ( ringBufGPIO[ ringRead ] >> 16 ) & 255;
-						register u16 pitch;
-
-						register u8 channel = MC & 0x0f;
-						MC &= 0xf0;
-
-						switch ( MC )
-						{
-						default:
-							break;
-						case 0x90: // note on
-							tsf_channel_note_on( TinySoundFont, channel, MD1, (float)MD2 / 127.0f ); 
-							break;
-						case 0x80: // note off
-							tsf_channel_note_off( TinySoundFont, channel, MD1 ); 
-							break;
-						case 0xc0: // program change
-							tsf_channel_set_presetnumber( TinySoundFont, channel, MD1, ( channel == 9 ) );
-							break;
-						/*case 0xd0: // pressure change
-							break;*/
-						case 0xe0: // pitch bend
-							pitch = MD1 | ( MD2 << 7 );
-							tsf_channel_set_pitchwheel( TinySoundFont, channel, pitch );
-							break;
-						case 0xb0: // control change
-							tsf_channel_midi_control( TinySoundFont, channel, MD1, MD2 );
-							break;
-						}		
-					} else
-#endif
-					{
-
-						unsigned char A, D;
-						decodeGPIO( ringBufGPIO[ ringRead ], &A, &D );
-
-						#ifdef EMULATE_OPL2
-						if ( cfgEmulateOPL2 && (ringBufGPIO[ ringRead ] & bIO2) )
-						{
-							if ( ( ( A & ( 1 << 4 ) ) == 0 ) )
-								ym3812_write( pOPL, 0, D ); else
-								ym3812_write( pOPL, 1, D );
-						} else
-						#endif
-						//#if !defined(SID2_DISABLED) && !defined(SID2_PLAY_SAME_AS_SID1)
-						// TODO: generic masks
-						if ( !cfgSID2_Disabled && !cfgSID2_PlaySameAsSID1 && (ringBufGPIO[ ringRead ] & SID2_MASK) )
-						{
-							sid[ 1 ]->write( A & 31, D );
-						} else
-						//#endif
-						{
-							sid[ 0 ]->write( A & 31, D );
-							//outRegisters[ A & 31 ] = D;
-							//#if !defined(SID2_DISABLED) && defined(SID2_PLAY_SAME_AS_SID1)
-							if ( !cfgSID2_Disabled && cfgSID2_PlaySameAsSID1 )
-								sid[ 1 ]->write( A & 31, D );
-							//#endif
-						}
-					}
-					ringRead++;
-					ringRead &= ( RING_SIZE - 1 );
-				}
-
-
-		#ifdef SMPCARRY
-			}
-		#else
-//				samplesElapsed = ( ( unsigned long long )nCyclesEmulated * ( unsigned long long )SAMPLERATE ) / ( unsigned long long )CLOCKFREQ;
-				samplesElapsed = ( ( unsigned long long )nCyclesEmulated * ( unsigned long long )SAMPLERATE_ADJUSTED ) / ( unsigned long long )CLOCKFREQ;
-
-				if ( nCyclesEmulated >= cycleCount && samplesElapsed == samplesElapsedBefore )
-					goto NoSampleGeneratedYet;
-
-			} while ( samplesElapsed == samplesElapsedBefore );
-		#endif
 			CACHE_PRELOADL2STRMW( &sampleBuffer[ smpCur ] );
 			val1 = sid[ 0 ]->output();
 			val2 = 0;
@@ -1168,7 +1350,7 @@ startHereAfterReset:
 			//
 			// mixer
 			//
-			register s32 left, right;
+			s32 left, right;
 
 #ifdef SUPPORT_MIDI
 			register s32 midiSampleLeft;
@@ -1188,18 +1370,12 @@ startHereAfterReset:
 				midiSampleLeft = max( -31768+2, min( 31767-2, midiSampleLeft ) );
 			}
 #endif
-			// yes, it's 1 byte shifted in the buffer, need to fix
-			right = ( val1 * cfgVolSID1_Left  + val2 * cfgVolSID2_Left  + valOPL * cfgVolOPL_Left ) >> 8;
-			left  = ( val1 * cfgVolSID1_Right + val2 * cfgVolSID2_Right + valOPL * cfgVolOPL_Right ) >> 8;
-
 #ifdef SUPPORT_MIDI
-			right += midiSampleLeft;
-			left  += midiSampleLeft;
+			sidMixSample( val1, val2, valOPL, midiSampleLeft, cfgMixVolume, &left, &right );
+#else
+			sidMixSample( val1, val2, valOPL, 0, cfgMixVolume, &left, &right );
 #endif
 
-			right = max( -31768+2, min( 31767-2, right ) );
-			left  = max( -31768+2, min( 31767-2, left ) );
-
 			#ifdef USE_PWM_DIRECT
 			if ( outputPWM )
 				putSample( left, right );
@@ -1207,8 +1383,13 @@ startHereAfterReset:
 			#ifdef USE_VCHIQ_SOUND
 			if ( outputHDMI )
 			{
-				putSample( left );
-				putSample( right );
+				s16 hdmiOut[ 2 * AUDIO_RESAMPLER_MAX_OUT ];
+				u32 n = audioResamplerPut( &hdmiResampler, left, right, hdmiOut );
+				for ( u32 i = 0; i < n; i++ )
+				{
+					putSample( hdmiOut[ 2 * i + 0 ] );
+					putSample( hdmiOut[ 2 * i + 1 ] );
+				}
 			}
 			#endif
 
@@ -1351,6 +1532,8 @@ void CKernel::FIQHandler (void *pParam)
 		CACHE_PRELOADL1STRMW( &ringWrite );
 		CACHE_PRELOADL1STRM( &sampleBuffer[ smpLast ] );
 		CACHE_PRELOADL1STRM( &outRegisters[ 16 ] );
+		if ( readBackActive )
+			CACHE_PRELOADL1STRM( readBack.slot( cycleCountC64 ) );
 	}
 	#endif
 
@@ -1404,7 +1587,11 @@ void CKernel::FIQHandler (void *pParam)
 			} else
 			{
 				if ( A >= 0x19 && A <= 0x1c )
-					D = outRegisters[ A ]; else
+				{
+					// OSC3/ENV3 from the run-ahead model if its prediction is valid
+					if ( !( A >= 0x1b && readBackActive && readBack.read( cycleCountC64, readBackWrites, A, &D ) ) )
+						D = outRegisters[ A ];
+				} else
 					D = busValue;
 			}
 		}
@@ -1558,6 +1745,10 @@ void CKernel::FIQHandler (void *pParam)
 		ringTime[ ringWrite ] = cycleCountC64;
 		ringWrite ++;
 		ringWrite &= ( RING_SIZE - 1 );
+
+		// writes which change OSC3/ENV3 predictions of the run-ahead model
+		if ( ( A & 31 ) <= 0x14 && !( remapAddr & readBackIgnore ) )
+			readBackWrites ++;
 		
 		FINISH_BUS_HANDLING
 		return;
@@ -1574,6 +1765,9 @@ void CKernel::FIQHandler (void *pParam)
 		ringWrite ++;
 		ringWrite &= ( RING_SIZE - 1 );
 
+		if ( ( A & 31 ) <= 0x14 && !readBackIgnore )
+			readBackWrites ++;
+
 		FINISH_BUS_HANDLING
 		return;
 	}
@@ -1669,13 +1863,9 @@ void CKernel::FIQHandler (void *pParam)
 	#ifdef USE_PWM_DIRECT
 	if ( outputPWM )
 	{
-		static unsigned long long samplesElapsedBeforeFIQ = 0;
-
-		unsigned long long samplesElapsedFIQ = ( ( unsigned long long )cycleCountC64 * ( unsigned long long )SAMPLERATE ) / ( unsigned long long )CLOCKFREQ;
-		if ( samplesElapsedFIQ != samplesElapsedBeforeFIQ && !CPU_RESET )
+		if ( !CPU_RESET && audioClockPoll( &sampleClockPWM, cycleCountC64 ) )
 		{
 			write32( ARM_GPIO_GPCLR0, bCTRL257 ); 
-			samplesElapsedBeforeFIQ = samplesElapsedFIQ;
 
 			u32 s = getSample();
 			u16 s1 = s & 65535;
@@ -30,6 +30,7 @@
 */
 #include <math.h>
 #include "kernel_sid264.h"
+#include "audioengine.h"
 #ifdef COMPILE_MENU
 #include "kernel_menu.h"
 #include "launch264.h"
@@ -43,6 +44,7 @@ static const char DRIVE[] = "SD:";
 static const char FILENAME_SPLASH_RGB[] = "SD:SPLASH/sk64_sid_bg2.tga";
 static const char FILENAME_SPLASH_RGB2[] = "SD:SPLASH/sk64_sid_bg.tga";
 static const char FILENAME_LED_RGB[] = "SD:SPLASH/sk64_sid_led.tga";
+static const char FILENAME_FILTER_TABLES[] = "SD:C16/residfilter.bin";
 
 //                 _________.___________         ____                      ________    ______  ____________  
 //_______   ____  /   _____/|   \______ \       /  _ \       ___.__. _____ \_____  \  /  __  \/_   \_____  \ 
@@ -89,7 +91,7 @@ u32 resetCounter,
 	cyclesSinceReset,  
 	resetPressed, resetReleased;
 
-s32 outputDigiblaster = 0, digiblasterVolume = 256, tedVolume = 0;
+s32 digiblasterVolume = 256, tedVolume = 0;
 
 // hack
 static u32 h_nRegOffset;
@@ -155,8 +157,10 @@ void setSIDConfiguration( u32 mode, u32 sid1, u32 sid2, u32 sid2addr, u32 rr, u3
 //___  ___  __      ___                      ___    __       
 // |  |__  |  \    |__   |\/| |  | |     /\   |  | /  \ |\ | 
 // |  |___ |__/    |___  |  | \__/ |___ /~~\  |  | \__/ | \| 
-// taken directly from Yape, please see license in the header file                                                           
-#include "TEDsound.h"
+// the sound model is taken from Yape, please see license in TEDsound.h (the Digiblaster is rendered by the same engine)
+#include "TEDsoundBL.h"
+
+static TEDBL tedSound;
 
 
 //  __     __                __      ___                   ___ 
@@ -167,6 +171,8 @@ void initSID()
 {
 	resetCounter = 0;
 
+	prepareSIDFilterTables( logger, DRIVE, FILENAME_FILTER_TABLES );
+
 	for ( int i = 0; i < NUM_SIDS; i++ )
 	{
 		sid[ i ] = new SID;
@@ -201,15 +207,13 @@ void initSID()
 	}
 #endif
 
-	outputDigiblaster = 0;
-
 	// ring buffer init
 	ringWrite = 0;
 	for ( int i = 0; i < RING_SIZE; i++ )
 		ringTime[ i ] = 0;
 
-
-	tedSoundInit( SAMPLERATE );
+	tedBLSetVolume( &tedSound, tedVolume, digiblasterVolume );
+	tedBLInit( &tedSound, CLOCKFREQ, SAMPLERATE );
 }
 
 void quitSID()
@@ -222,8 +226,6 @@ unsigned long long cycleCountC64;
 
 // to do: integrate HDMI audio out
 #define SAMPLERATE 44100
-u32 SAMPLERATE_ADJUSTED = SAMPLERATE;
-u32 trackSampleProgress;
 u32 fillSoundBuffer;
 
 #ifdef COMPILE_MENU
@@ -318,6 +320,81 @@ static u32 vu_nLEDs = 0;
 
 static u32 allUsedLEDs = 0;
 
+//
+// the sound sources for the event driven emulation (see audioengine.h)
+//
+class CSID264Sources
+{
+public:
+	// how far did we consume the commands in the ring buffer?
+	unsigned int ringRead;
+
+	u32 nextEvent( u64 *time )
+	{
+		if ( ringRead == ringWrite )
+			return 0;
+		*time = ringTime[ ringRead ];
+		return 1;
+	}
+
+	void applyEvent()
+	{
+		unsigned char A, D;
+		decodeGPIO( ringBufGPIO[ ringRead ], &A, &D );
+
+		u32 tedCommand = ( ringBufGPIO[ ringRead ] >> A6 ) & 1;
+
+		if ( tedCommand )
+		{
+			tedBLWrite( &tedSound, ringTime[ ringRead ], A, D );
+		} else
+		#ifdef EMULATE_OPL2
+		if ( cfgEmulateOPL2 && (ringBufGPIO[ ringRead ] & bIO2) )
+		{
+			if ( ( ( A & ( 1 << 4 ) ) == 0 ) )
+				ym3812_write( pOPL, 0, D ); else
+				ym3812_write( pOPL, 1, D );
+		} else
+		#endif
+		//#if !defined(SID2_DISABLED) && !defined(SID2_PLAY_SAME_AS_SID1)
+		// TODO: generic masks
+		if ( !cfgSID2_Disabled && !cfgSID2_PlaySameAsSID1 && (ringBufGPIO[ ringRead ] & SID2_MASK) )
+		{
+			sid[ 1 ]->write( A & 31, D );
+		} else
+		//#endif
+		{
+			sid[ 0 ]->write( A & 31, D );
+			outRegisters[ A & 31 ] = D;
+			//#if !defined(SID2_DISABLED) && defined(SID2_PLAY_SAME_AS_SID1)
+			if ( !cfgSID2_Disabled && cfgSID2_PlaySameAsSID1 )
+				sid[ 1 ]->write( A & 31, D );
+			//#endif
+		}
+
+		ringRead++;
+		ringRead &= ( RING_SIZE - 1 );
+	}
+
+	void clock( u32 cycles )
+	{
+		sid[ 0 ]->clock( cycles );
+		#ifndef SID2_DISABLED
+		if ( !cfgSID2_Disabled )
+			sid[ 1 ]->clock( cycles );
+		#endif
+
+		outRegisters[ 27 ] = sid[ 0 ]->read( 27 );
+		outRegisters[ 28 ] = sid[ 0 ]->read( 28 );
+	}
+};
+
+static CSID264Sources soundSources;
+
+#ifdef USE_PWM_DIRECT
+static AUDIO_SAMPLE_CLOCK sampleClockPWM;
+#endif
+
 #ifdef COMPILE_MENU
 void KernelSIDFIQHandler( void *pParam );
 
@@ -508,10 +585,15 @@ void CKernel::Run( void )
 //	logger->Write( "", LogNotice, "start emulating..." );
 	cycleCountC64 = 0;
 	unsigned long long nCyclesEmulated = 0;
-	unsigned long long samplesElapsed = 0;
+	AUDIO_SAMPLE_CLOCK sampleClock = { 0 };
+	audioClockInit( &sampleClock, CLOCKFREQ, SAMPLERATE );
+	#ifdef USE_PWM_DIRECT
+	audioClockInit( &sampleClockPWM, CLOCKFREQ, SAMPLERATE );
+	#endif
+	tedBLInit( &tedSound, CLOCKFREQ, SAMPLERATE );
 
-	// how far did we consume the commands in the ring buffer?
-	unsigned int ringRead = 0;
+	unsigned int &ringRead = soundSources.ringRead;
+	ringRead = 0;
 
 	#ifdef COMPILE_MENU
 	// let's be very convincing about the caches ;-)
@@ -549,7 +631,8 @@ void CKernel::Run( void )
 	resetCounter = 0;
 	cycleCountC64 = 0;
 	nCyclesEmulated = 0;
-	samplesElapsed = 0;
+	audioClockInit( &sampleClock, CLOCKFREQ, SAMPLERATE );
+	tedBLInit( &tedSound, CLOCKFREQ, SAMPLERATE );
 	ringRead = 0;
 	for ( int i = 0; i < NUM_SIDS; i++ )
 		for ( int j = 0; j < 24; j++ )
@@ -633,70 +716,10 @@ void CKernel::Run( void )
 			nSamplesInThisRun++;
 		#endif
 
-			unsigned long long samplesElapsedBefore = samplesElapsed;
-
-			do { // do SID emulation until time passed to create an additional sample (i.e. there may be several cycles until a sample value is created)
-				#ifdef USE_PWM_DIRECT
-				u32 cyclesToEmulate = 16;
-				#else			
-				u32 cyclesToEmulate = 2;
-				#endif
-				sid[ 0 ]->clock( cyclesToEmulate );
-				#ifndef SID2_DISABLED
-				if ( !cfgSID2_Disabled )
-					sid[ 1 ]->clock( cyclesToEmulate );
-				#endif
-
-				outRegisters[ 27 ] = sid[ 0 ]->read( 27 );
-				outRegisters[ 28 ] = sid[ 0 ]->read( 28 );
-
-				nCyclesEmulated += cyclesToEmulate;
-
-				// apply register updates (we do one-cycle emulation steps, but in case we need to catch up...)
-				unsigned int readUpTo = ringWrite;
-
-				if ( ringRead != readUpTo && nCyclesEmulated >= ringTime[ ringRead ] )
-				{
-					unsigned char A, D;
-					decodeGPIO( ringBufGPIO[ ringRead ], &A, &D );
-
-					u32 tedCommand = ( ringBufGPIO[ ringRead ] >> A6 ) & 1;
-
-					if ( tedCommand )
-					{
-						writeSoundReg( A, D );
-					} else
-					#ifdef EMULATE_OPL2
-					if ( cfgEmulateOPL2 && (ringBufGPIO[ ringRead ] & bIO2) )
-					{
-						if ( ( ( A & ( 1 << 4 ) ) == 0 ) )
-							ym3812_write( pOPL, 0, D ); else
-							ym3812_write( pOPL, 1, D );
-					} else
-					#endif
-					//#if !defined(SID2_DISABLED) && !defined(SID2_PLAY_SAME_AS_SID1)
-					// TODO: generic masks
-					if ( !cfgSID2_Disabled && !cfgSID2_PlaySameAsSID1 && (ringBufGPIO[ ringRead ] & SID2_MASK) )
-					{
-						sid[ 1 ]->write( A & 31, D );
-					} else
-					//#endif
-					{
-						sid[ 0 ]->write( A & 31, D );
-						outRegisters[ A & 31 ] = D;
-						//#if !defined(SID2_DISABLED) && defined(SID2_PLAY_SAME_AS_SID1)
-						if ( !cfgSID2_Disabled && cfgSID2_PlaySameAsSID1 )
-							sid[ 1 ]->write( A & 31, D );
-						//#endif
-					}
-
-					ringRead++;
-					ringRead &= ( RING_SIZE - 1 );
-				}
-
-				samplesElapsed = ( ( unsigned long long )nCyclesEmulated * ( unsigned long long )SAMPLERATE ) / ( unsigned long long )CLOCKFREQ;
-
-			} while ( samplesElapsed == samplesElapsedBefore );
+			// emulate up to the next sample, but not beyond the cycle the C64/C16 has reached
+			// (steps of at most 16 cycles to keep OSC3/ENV3 for read-back up to date)
+			if ( !audioEmulateToNextSample( soundSources, &sampleClock, nCyclesEmulated, cycleCount, 16 ) )
+				continue;
 
 			s16 val1 = sid[ 0 ]->output();
 			s16 val2 = 0;
@@ -721,14 +744,12 @@ void CKernel::Run( void )
 			//
 			s32 left, right;
 
-			short tedV = 0;
-
-			if ( tedVolume > 0 )
-				tedV = TEDcalcNextSample();
+			// TED sound and Digiblaster, already weighted with their volumes
+			s32 valTED = tedBLSample( &tedSound, nCyclesEmulated );
 
 			// yes, it's 1 byte shifted in the buffer, need to fix
-			right = ( val1 * cfgVolSID1_Left  + val2 * cfgVolSID2_Left  + valOPL * cfgVolOPL_Left + 2 * outputDigiblaster * digiblasterVolume + tedV * tedVolume ) >> 8;
-			left  = ( val1 * cfgVolSID1_Right + val2 * cfgVolSID2_Right + valOPL * cfgVolOPL_Right + 2 * outputDigiblaster * digiblasterVolume + tedV * tedVolume ) >> 8;
+			right = ( val1 * cfgVolSID1_Left  + val2 * cfgVolSID2_Left  + valOPL * cfgVolOPL_Left + valTED ) >> 8;
+			left  = ( val1 * cfgVolSID1_Right + val2 * cfgVolSID2_Right + valOPL * cfgVolOPL_Right + valTED ) >> 8;
 
 			right = max( -32767, min( 32767, right ) );
 			left  = max( -32767, min( 32767, left ) );
@@ -796,10 +817,6 @@ void CKernel::Run( void )
 }
 
 
-#ifdef USE_PWM_DIRECT
-static unsigned long long samplesElapsedBeforeFIQ = 0;
-#endif
-
 
 #ifdef COMPILE_MENU
 void KernelSIDFIQHandler( void *pParam )
@@ -807,7 +824,6 @@ void KernelSIDFIQHandler( void *pParam )
 void CKernel::FIQHandler (void *pParam)
 #endif
 {
-	unsigned long long samplesElapsedFIQ;
 	static s32 latchDelayOut = 10;
 
 	register u32 D;
@@ -988,10 +1004,14 @@ void CKernel::FIQHandler (void *pParam)
 
 	if ( BUS_AVAILABLE264 && ( GET_ADDRESS264 == 0xfd5e ) && CPU_WRITES_TO_BUS )
 	{
+		// goes through the ring buffer (as a TED command) to be rendered at the right time
 		#pragma GCC diagnostic push
 		#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
-		outputDigiblaster = (s32)D - 128;
+		ringBufGPIO[ ringWrite ] = ( TEDBL_DIGIBLASTER << A0 ) | ( 1 << A6 ) | ( D << D0 );
 		#pragma GCC diagnostic pop
+		ringTime[ ringWrite ] = cycleCountC64;
+		ringWrite ++;
+		ringWrite &= ( RING_SIZE - 1 );
 		goto get_out;
 	}
 
@@ -1035,12 +1055,9 @@ void CKernel::FIQHandler (void *pParam)
 	// OPTIONAL
 	//											
 	#ifdef USE_PWM_DIRECT
-	samplesElapsedFIQ = ( ( unsigned long long )cycleCountC64 * ( unsigned long long )SAMPLERATE ) / ( unsigned long long )CLOCKFREQ;
-
-	if ( samplesElapsedFIQ != samplesElapsedBeforeFIQ )
+	if ( audioClockPoll( &sampleClockPWM, cycleCountC64 ) )
 	{
 		write32( ARM_GPIO_GPCLR0, bCTRL257 ); 
-		samplesElapsedBeforeFIQ = samplesElapsedFIQ;
 
 		u32 s = getSample();
 		u16 s1 = s & 65535;
@@ -30,9 +30,13 @@
 */
 #include <math.h>
 #include "kernel_sid8.h"
+#include "arena.h"
+#include "audioengine.h"
+#include "audioresampler.h"
 #ifdef COMPILE_MENU
 #include "kernel_menu.h"
 #include "launch.h"
+#include "profiler.h"
 
 static u32 launchPrg;
 #endif
@@ -40,6 +44,7 @@ static u32 launchPrg;
 static const char FILENAME_SPLASH_RGB[] = "SD:SPLASH/sk64_sid_bg2.tga";
 static const char FILENAME_SPLASH_RGB2[] = "SD:SPLASH/sk64_sid_bg.tga";
 static const char FILENAME_LED_RGB[] = "SD:SPLASH/sk64_sid_led.tga";
+static const char FILENAME_FILTER_TABLES[] = "SD:C64/residfilter.bin";
 
 //                 _________.___________         ____                      ________    ______  ____________  
 //_______   ____  /   _____/|   \______ \       /  _ \       ___.__. _____ \_____  \  /  __  \/_   \_____  \ 
@@ -104,6 +109,10 @@ void initSID8()
 {
 	resetCounter = 0;
 
+	#ifdef COMPILE_MENU
+	prepareSIDFilterTables( logger, DRIVE, FILENAME_FILTER_TABLES );
+	#endif
+
 	for ( int i = 0; i < NUM_SIDS; i++ )
 	{
 		sid[ i ] = new SID;
@@ -238,8 +247,7 @@ static void initVisualization()
 	ledValueAvg[0] = ledValueAvg[1] = ledValueAvg[2] = 0.01f;
 }
 
-static unsigned char tftBackground2[ 240 * 240 * 2 ];
-static unsigned char tftLEDs[ 240 * 240 * 2 ];
+static unsigned char *tftBackground2, *tftLEDs;
 
 static u32 vu_Mode = 0;
 static u32 vuMeter[4] = { 0, 0, 0, 0 };
@@ -248,7 +256,18 @@ static u32 vu_nLEDs = 0xffff;
 static u32 allUsedLEDs = 0;
 
 static unsigned long long nCyclesEmulated = 0;
-static unsigned long long samplesElapsed = 0;
+static AUDIO_SAMPLE_CLOCK sampleClock;
+#ifdef USE_PWM_DIRECT
+static AUDIO_SAMPLE_CLOCK sampleClockPWM;
+#endif
+
+static void resetSampleClocks()
+{
+	audioClockInit( &sampleClock, CLOCKFREQ, SAMPLERATE );
+	#ifdef USE_PWM_DIRECT
+	audioClockInit( &sampleClockPWM, CLOCKFREQ, SAMPLERATE );
+	#endif
+}
 
 static void prepareOnReset( bool refresh = false )
 {
@@ -270,22 +289,70 @@ static void prepareOnReset( bool refresh = false )
 	CACHE_PRELOAD_INSTRUCTION_CACHE( (void*)&FIQ_HANDLER, 4*1024 );
 	FORCE_READ_LINEAR32a( (void*)&FIQ_HANDLER, 4*1024, 32768 );
 
-	resetCounter = cycleCountC64 = nCyclesEmulated = samplesElapsed = 0;
+	resetCounter = cycleCountC64 = nCyclesEmulated = 0;
+	resetSampleClocks();
 }
 
-extern u32 SAMPLERATE_ADJUSTED;
-extern u32 nSamplesPrecompute;
-extern u32 trackSampleProgress;
+// HDMI output: rendered at SAMPLERATE and resampled to the clock of the HDMI audio, as in kernel_sid.cpp
+extern u32 hdmiLatency;
+
+static AUDIO_RESAMPLER hdmiResampler;
+static AUDIO_RATE_CONTROL hdmiRateControl;
+static u64 hdmiSamplesAtUpdate;
 
-static s32 avgSamplesAvail = 0;
-static s32 avgCounter = 0;
-static u32 adjustRateAllowed = 0;
-static u32 targetSamplesAvail = 0, targetCount = 0;
+static void resetHDMIResampler()
+{
+	audioResamplerInit( &hdmiResampler );
+	audioRateControlInit( &hdmiRateControl, hdmiLatency * SAMPLERATE / 1000, SAMPLERATE );
+	hdmiSamplesAtUpdate = 0;
+}
 
 extern u32 fillSoundBuffer;
 extern bool CVCHIQ_CB_Manual;
 
 
+//
+// the sound sources for the event driven emulation (see audioengine.h)
+//
+class CSID8Sources
+{
+public:
+	// how far did we consume the commands in the ring buffer?
+	unsigned int ringRead;
+
+	u32 nextEvent( u64 *time )
+	{
+		if ( ringRead == ringWrite )
+			return 0;
+		*time = ringTime[ ringRead ];
+		return 1;
+	}
+
+	void applyEvent()
+	{
+		u32 rv = ringBufGPIO[ ringRead ];
+		u8 D = rv & 255;
+		u8 A = (rv>>8)&31;
+		u32 whichSID = rv >> 16;
+
+		sid[ whichSID ]->write( A, D );
+
+		ringRead++;
+		ringRead &= ( RING_SIZE - 1 );
+	}
+
+	void clock( u32 cycles )
+	{
+		for ( u32 i = 0; i < NUM_SIDS; i++ )
+			sid[ i ]->clock( cycles );
+
+		outRegisters[ 27 ] = sid[ 0 ]->read( 27 );
+		outRegisters[ 28 ] = sid[ 0 ]->read( 28 );
+	}
+};
+
+static CSID8Sources soundSources;
+
 #ifdef COMPILE_MENU
 void KernelSIDFIQHandler8( void *pParam );
 
@@ -356,6 +423,9 @@ void CKernel::Run( void )
 		tftPrepareDirtyUpdates();
 		tftUse12BitColor();
 
+		tftBackground2 = (unsigned char *)arenaAlloc( logger, "tftBackground", 240 * 240 * 2 );
+		tftLEDs = (unsigned char *)arenaAlloc( logger, "tftLEDs", 240 * 240 * 2 );
+
 		memcpy( tftBackground2, tftBackground, 240 * 240 * 2 );
 		tftLoadBackgroundTGA( DRIVE, FILENAME_LED_RGB, 8 );
 		memcpy( tftLEDs, tftBackground, 240 * 240 * 2 );
@@ -374,6 +444,7 @@ void CKernel::Run( void )
 	//
 	startVCHIQ = 0;
 	initSoundOutput( &m_pSound, pVCHIQ, outputPWM, outputHDMI );
+	resetHDMIResampler();
 
 	#ifdef COMPILE_MENU
 	if ( FILENAME == NULL && !hasData )
@@ -435,10 +506,10 @@ void CKernel::Run( void )
 	//logger->Write( "", LogNotice, "start emulating..." );
 	cycleCountC64 = 0;
 	nCyclesEmulated = 0;
-	samplesElapsed = 0;
+	resetSampleClocks();
 
-	// how far did we consume the commands in the ring buffer?
-	unsigned int ringRead = 0;
+	unsigned int &ringRead = soundSources.ringRead;
+	ringRead = 0;
 
 	#ifdef COMPILE_MENU
 	prepareOnReset( true );
@@ -472,7 +543,7 @@ startHereAfterReset:
 	resetReleased = 0;
 	resetCounter = cycleCountC64 = 0;
 	nCyclesEmulated = 0;
-	samplesElapsed = 0;
+	resetSampleClocks();
 	ringRead = ringWrite = 0;
 
 	latchSetClear( 0, allUsedLEDs );
@@ -485,6 +556,10 @@ startHereAfterReset:
 
 	fillSoundBuffer = 0;
 
+	#ifdef COMPILE_MENU
+	profileSetContext( PROFILE_CTX_SID );
+	#endif
+
 	// new main loop mainloop
 	while ( true )
 	{
@@ -503,7 +578,6 @@ startHereAfterReset:
 		}
 		if ( cycleCountC64 > 2000000 && resetCounter > 500000 ) {
 			CVCHIQ_CB_Manual = false;
-			//logger->Write( "", LogNotice, "adjusted sample rate: %u Hz", (u32)SAMPLERATE_ADJUSTED );
 			quitSID8();
 			EnableIRQs();
 			m_InputPin.DisableInterrupt();
@@ -525,11 +599,7 @@ startHereAfterReset:
 				}
 				nSamplesInThisRun = startVCHIQ = 0;
 				initSoundOutput( &m_pSound, pVCHIQ, outputPWM, outputHDMI );
-				avgSamplesAvail = 0;
-				avgCounter = 0;
-				adjustRateAllowed = 0;
-				targetSamplesAvail = 0;
-				targetCount = 0;
+				resetHDMIResampler();
 			}
 
 			resetReleased = 0xff;
@@ -584,7 +654,10 @@ startHereAfterReset:
 					CVCHIQ_CB_Device = NULL;
 				}
 
-				if ( samplesElapsed > 8 * nSamplesPrecompute / 2 && !startVCHIQ )
+				extern u32 samplesInBuffer();
+
+				// the queue is still empty when the device starts (it plays two chunks of silence first)
+				if ( samplesInBuffer() / 2 >= hdmiRateControl.target && !startVCHIQ )
 				{
 					m_pSound->Start();
 					fillSoundBuffer = 1;
@@ -596,13 +669,20 @@ startHereAfterReset:
 				{
 					fillSoundBuffer = 0;
 
-					extern u32 samplesInBuffer();
 					#define TYPE		s16
 					#define TYPE_SIZE	sizeof (s16)
 
-					s32 nFramesComputed = samplesInBuffer();
-					s32 nFramesMax = m_pSound->GetQueueSizeFrames() - m_pSound->GetQueueFramesAvail();
-					trackSampleProgress = 1024 * 1024 + ( nFramesComputed - nFramesMax );
+					// samplesInBuffer() counts samples, PCMBuffer holds interleaved frames
+					s32 nFramesComputed = samplesInBuffer() / 2;
+					s32 nFramesQueued = m_pSound->GetQueueFramesAvail();
+					s32 nFramesMax = m_pSound->GetQueueSizeFrames() - nFramesQueued;
+
+					audioResamplerSetRatio( &hdmiResampler, audioRateControlUpdate( &hdmiRateControl,
+						nFramesComputed + nFramesQueued, (u32)( sampleClock.samplesElapsed - hdmiSamplesAtUpdate ) ) );
+					hdmiSamplesAtUpdate = sampleClock.samplesElapsed;
+
+					if ( hdmiRateControl.nUpdates > 150 )
+						CVCHIQ_CB_Manual = true;
 
 					s32 nWriteFrames = min( nFramesComputed, nFramesMax );
 
@@ -633,42 +713,6 @@ startHereAfterReset:
 				}
 				if ( nSamplesInThisRun > 2205 / 8 )
 				{
-					//trackSampleProgress = 1024 * 1024 + ( nFramesComputed - nFramesMax );
-					if ( trackSampleProgress )
-					{
-						avgSamplesAvail += (s32)trackSampleProgress - 1024 * 1024;
-						avgCounter ++;
-
-						if ( avgCounter > 50 )
-						{
-							s32 avail = (s32)avgSamplesAvail / avgCounter;
-							if ( targetSamplesAvail == 0 && ++ targetCount > 2 )
-								CVCHIQ_CB_Manual = true; 
-							if ( targetSamplesAvail == 0 && ++ targetCount > 10 )
-								targetSamplesAvail = max( avail, (s32)nSamplesPrecompute );
-
-							if ( targetSamplesAvail != 0 )
-							{
-								if ( avail < (s32)targetSamplesAvail )
-								{
-									if ( avail < 5 * (s32)targetSamplesAvail / 100 && SAMPLERATE_ADJUSTED < SAMPLERATE )
-										SAMPLERATE_ADJUSTED = SAMPLERATE; else
-										SAMPLERATE_ADJUSTED ++; 
-								} else
-								if ( avail > (s32)targetSamplesAvail )
-								{
-									if ( avail > 105 * (s32)targetSamplesAvail / 100 && SAMPLERATE_ADJUSTED > SAMPLERATE )
-										SAMPLERATE_ADJUSTED = SAMPLERATE; else
-										SAMPLERATE_ADJUSTED --; 
-								}
-								adjustRateAllowed = 0;
-							}
-							//logger->Write( "", LogNotice, "samples ahead: %d (target: %d), rate: %u Hz", avail, targetSamplesAvail, SAMPLERATE_ADJUSTED );
-							avgSamplesAvail = avgCounter = 0;
-						}
-						trackSampleProgress = 0;
-					}
-
 					{
 						if ( nCyclesEmulated < (4*256000) )
 						{
@@ -688,44 +732,10 @@ startHereAfterReset:
 
 			CACHE_PRELOADL2STRMW( &smpCur );
 
-			static u32 carrySamples = 0;
-			u32 samplesToEmulateX65536 = ( ( unsigned long long )65536 * ( unsigned long long )CLOCKFREQ ) / ( unsigned long long )SAMPLERATE_ADJUSTED + ( unsigned long long )carrySamples;
-
-			u32 samplesToEmulate = samplesToEmulateX65536 >> 16;
-			carrySamples = (samplesToEmulateX65536 & 65535);
-
-			{
-				u32 cyclesToEmulate = samplesToEmulate;
-
-				for ( u32 i = 0; i < NUM_SIDS; i++ )
-					sid[ i ]->clock( cyclesToEmulate );
-
-				outRegisters[ 27 ] = sid[ 0 ]->read( 27 );
-				outRegisters[ 28 ] = sid[ 0 ]->read( 28 );
-
-				nCyclesEmulated += cyclesToEmulate;
-
-				// apply register updates (we do one-cycle emulation steps, but in case we need to catch up...)
-				unsigned int readUpTo = ringWrite;
-
-				if ( ringRead != readUpTo && nCyclesEmulated >= ringTime[ ringRead ] )
-				{
-					unsigned char A, D;
-
-					u32 rv = ringBufGPIO[ ringRead ];
-					D = rv & 255;
-					A = (rv>>8)&31;
-					u32 whichSID = rv >> 16;
-	
-					sid[ whichSID ]->write( A, D );
-
-					ringRead++;
-					ringRead &= ( RING_SIZE - 1 );
-				}
-
-			}
-
-			samplesElapsed = ( ( unsigned long long )nCyclesEmulated * ( unsigned long long )SAMPLERATE_ADJUSTED ) / ( unsigned long long )CLOCKFREQ;
+			// emulate up to the next sample, but not beyond the cycle the C64 has reached
+			audioClockSetRate( &sampleClock, CLOCKFREQ, SAMPLERATE );
+			if ( !audioEmulateToNextSample( soundSources, &sampleClock, nCyclesEmulated, cycleCount, 256 ) )
+				continue;
 
 			//
 			// mixer
@@ -758,8 +768,13 @@ startHereAfterReset:
 			#ifdef USE_VCHIQ_SOUND
 			if ( outputHDMI )
 			{
-				putSample( left );
-				putSample( right );
+				s16 hdmiOut[ 2 * AUDIO_RESAMPLER_MAX_OUT ];
+				u32 n = audioResamplerPut( &hdmiResampler, left, right, hdmiOut );
+				for ( u32 i = 0; i < n; i++ )
+				{
+					putSample( hdmiOut[ 2 * i + 0 ] );
+					putSample( hdmiOut[ 2 * i + 1 ] );
+				}
 			}
 			#endif
 
@@ -959,14 +974,9 @@ void CKernel::FIQHandler (void *pParam)
 	#ifdef USE_PWM_DIRECT
 	if ( outputPWM )
 	{
-		static unsigned long long samplesElapsedBeforeFIQ = 0;
-
-		unsigned long long samplesElapsedFIQ = ( ( unsigned long long )cycleCountC64 * ( unsigned long long )SAMPLERATE ) / ( unsigned long long )CLOCKFREQ;
-
-		if ( samplesElapsedFIQ != samplesElapsedBeforeFIQ )
+		if ( audioClockPoll( &sampleClockPWM, cycleCountC64 ) )
 		{
 			write32( ARM_GPIO_GPCLR0, bCTRL257 ); 
-			samplesElapsedBeforeFIQ = samplesElapsedFIQ;
 
 			u32 s = getSample();
 			u16 s1 = s & 65535;
@@ -29,6 +29,7 @@
 */
 
 #include "kernel_ssnap5.h"
+#include "arena.h"
 
 // we will read this .CRT file 
 static const char DRIVE[] = "SD:";
@@ -74,7 +75,8 @@ static unsigned char kernalROM[ 8192 ] AAA;
 
 // ... flash/ROM
 //static u8 flash_cacheoptimized_pool[ 16 * 8192 * 2 + 128 ] AAA;
-extern u8 flash_cacheoptimized_pool[ 1024 * 1024 + 1024 ] AAA;
+#define FLASH_POOL_SIZE ( 1024 * 1024 + 8 * 1024 )
+static u8 *flash_cacheoptimized_pool;	// claimed from the launch arena (arena.h)
 
 static __attribute__( ( always_inline ) ) inline void ss5Config( u8 c )
 {
@@ -159,6 +161,8 @@ void CKernelSS5::Run( void )
 	m_EMMC.Initialize();
 	#endif
 
+	flash_cacheoptimized_pool = (u8 *)arenaAlloc( logger, "flash", FLASH_POOL_SIZE );
+
 	// load kernal is any
 	u32 kernalSize = 0; // should always be 8192
 	if ( FILENAME_KERNAL != NULL )
@@ -169,7 +173,7 @@ void CKernelSS5::Run( void )
 	} else
 		ss5.hasKernal = 0;
 
-	ss5.flash_cacheoptimized = (u8 *)( ( (u64)&flash_cacheoptimized_pool[0] + 128 ) & ~127 );
+	ss5.flash_cacheoptimized = flash_cacheoptimized_pool;
 
 	CRT_HEADER header;
 	u32 ROM_LH;
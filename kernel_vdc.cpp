@@ -0,0 +1,94 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ kernel_vdc.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - Sidekick VDC: 80 column text card with HDMI output
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "kernel_vdc.h"
+
+static BUSCHAIN_COUNTERS counters;
+static VDC_STATE vdc AAA;
+static VDC_RENDER render AAA;
+
+void CKernelVDC::Run( void )
+{
+	// setup control lines, initialize latch and software I2C buffer
+	initLatch();
+	SETCLR_GPIO( bDMA | bEXROM | bNMI | bGAME, 0 );
+	latchSetClearImm( LATCH_RESET, LATCH_LED_ALL | LATCH_ENABLE_KERNAL );
+
+	u8 *fb = (u8 *)(uintptr)m_FrameBuffer.GetBuffer();
+	u32 pitch = m_FrameBuffer.GetPitch();
+	memset( fb, 0, VDC_FB_HEIGHT * pitch );
+
+	vdcInit( &vdc );
+	vdcRenderInit( &render, fb + VDC_FB_TOP * pitch, pitch, 2 );
+
+	if ( logger )
+		logger->Write( "VDC", LogNotice, "framebuffer %ux%u, pitch %u", m_FrameBuffer.GetWidth(), m_FrameBuffer.GetHeight(), pitch );
+
+	DisableIRQs();
+
+	// setup FIQ
+	m_InputPin.ConnectInterrupt( FIQ_HANDLER, FIQ_PARENT );
+	m_InputPin.EnableInterrupt ( GPIOInterruptOnRisingEdge );
+
+	counters.c64CycleCount = counters.resetCounter = 0;
+
+	// the block fills/copies and the rendering run here, interrupted by the FIQ handler for every bus cycle
+	while ( true )
+	{
+		CACHE_PRELOAD_INSTRUCTION_CACHE( (void*)&FIQ_HANDLER, 2048 );
+
+		u32 t = CTimer::GetClockTicks();
+		vdc.vblank = ( t % VDC_FRAME_US ) >= VDC_FRAME_US - VDC_VBLANK_US ? VDC_STATUS_VBLANK : 0;
+
+		if ( vdc.blockCount )
+			vdcBlockStep( &vdc );
+
+		vdcRender( &render, &vdc, t );
+	}
+
+	// and we'll never reach this...
+	m_InputPin.DisableInterrupt();
+}
+
+void CKernelVDC::FIQHandler( void *pParam )
+{
+	// a chain with the VDC registers only (see buschain.h and vdc.h)
+	CBusFIQ b;
+	busChainCycle< CBusFIQ, &counters, CDevVDC< &vdc > >( b );
+}
+
+int main()
+{
+	CKernelVDC kernel;
+	if ( kernel.Initialize() )
+		kernel.Run();
+
+	halt();
+	return EXIT_HALT;
+}
@@ -0,0 +1,128 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ kernel_vdc.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - Sidekick VDC: 80 column text card with HDMI output
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _kernel_vdc_h
+#define _kernel_vdc_h
+
+#include <circle/startup.h>
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+#include <circle/memory.h>
+#include <circle/koptions.h>
+#include <circle/devicenameservice.h>
+#include <circle/bcmframebuffer.h>
+#include <circle/interrupt.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/sched/scheduler.h>
+#include <circle/types.h>
+#include <circle/gpioclock.h>
+#include <circle/gpiopin.h>
+#include <circle/gpiopinfiq.h>
+#include <circle/gpiomanager.h>
+#include <circle/util.h>
+
+#include "lowlevel_arm64.h"
+#include "gpio_defs.h"
+#include "latch.h"
+#include "helpers.h"
+#include "vdc.h"
+
+// the 80x25 characters are shown with doubled lines in the middle of a 640x480 screen with 8 bit colors
+#define VDC_FB_WIDTH	640
+#define VDC_FB_HEIGHT	480
+#define VDC_FB_TOP		( ( VDC_FB_HEIGHT - VDC_HEIGHT * 2 ) / 2 )
+
+CLogger	*logger;
+#define FIQ_HANDLER	(this->FIQHandler)
+#define FIQ_PARENT	this
+
+class CKernelVDC
+{
+public:
+	CKernelVDC( void )
+		: m_CPUThrottle( CPUSpeedMaximum ),
+		m_FrameBuffer( VDC_FB_WIDTH, VDC_FB_HEIGHT, 8 ),
+		m_Timer( &m_Interrupt ),
+		m_Logger( m_Options.GetLogLevel(), &m_Timer ),
+		m_InputPin( PHI2, GPIOModeInput, &m_Interrupt )
+	{
+	}
+
+	~CKernelVDC( void )
+	{
+	}
+
+	boolean Initialize( void )
+	{
+		boolean bOK = TRUE;
+		m_CPUThrottle.SetSpeed( CPUSpeedMaximum );
+
+		// the screen shows the VDC output, the log goes to the log device only (e.g. logdev=ttyS1 in cmdline.txt)
+		for ( u32 i = 0; i < 16; i++ )
+			m_FrameBuffer.SetPalette( i, vdcPalette565[ i ] );
+		if ( bOK ) bOK = m_FrameBuffer.Initialize();
+
+		logger = NULL;
+		CDevice *pTarget = m_DeviceNameService.GetDevice( m_Options.GetLogDevice(), FALSE );
+		if ( bOK && pTarget != 0 && m_Logger.Initialize( pTarget ) )
+			logger = &m_Logger;
+
+		if ( bOK ) bOK = m_Interrupt.Initialize();
+		if ( bOK ) bOK = m_Timer.Initialize();
+
+		// initialize ARM cycle counters (for accurate timing)
+		initCycleCounter();
+		// initialize GPIOs
+		gpioInit();
+		// initialize latch and software I2C buffer
+		initLatch();
+
+		return bOK;
+	}
+
+	void Run( void );
+
+private:
+	static void FIQHandler( void *pParam );
+
+	// do not change this order
+	CMemorySystem		m_Memory;
+	CKernelOptions		m_Options;
+	CDeviceNameService	m_DeviceNameService;
+	CCPUThrottle		m_CPUThrottle;
+	CBcmFrameBuffer		m_FrameBuffer;
+	CInterruptSystem	m_Interrupt;
+	CTimer				m_Timer;
+	CLogger				m_Logger;
+	CScheduler			m_Scheduler;
+	CGPIOPinFIQ			m_InputPin;
+};
+
+#endif
@@ -51,6 +51,9 @@ static u32 prgSize;
 static unsigned char prgData[ 65536 ] AAA;
 static u32 startAddr, prgSizeAboveA000, prgSizeBelowA000;
 
+// block transfer: the C64 selects the first page of an 8k window of the .PRG which is then visible in ROML
+static u32 romlWindow, romlFirstPage, prgPages, prgLastPage, prgLastPageBytes;
+
 static volatile u8 forceReadLaunch;
 
 // in case the launch code starts with the loading address
@@ -78,6 +81,13 @@ static int launchGetProgram( const char *FILENAME, bool hasData = false, u8 *prg
 	} else
 		prgSizeAboveA000 = prgSize - prgSizeBelowA000;
 
+	// number of 256-byte pages (without the load address), pages beyond the last one repeat the last one
+	prgPages = ( prgSize - 2 + 255 ) >> 8;
+	if ( prgPages > 255 ) prgPages = 255;
+	prgLastPage = prgPages ? prgPages - 1 : 0;
+	// bytes used in the last page (0 = all 256)
+	prgLastPageBytes = prgPages < 255 ? ( ( prgSize - 2 ) & 255 ) : 0;
+
 	return 1;
 }
 
@@ -111,6 +121,7 @@ static void launchInitLoader( bool ultimax, bool c128 )
 static void launchPrepareAndWarmCache()
 {
 	disableCart = transferStarted = currentOfs = 0;
+	romlWindow = 0;
 	transferPart = 1;
 
 	// launch code / CBM80
@@ -130,6 +141,19 @@ static void launchPrepareAndWarmCache()
 			if ( CPU_WRITES_TO_BUS ) {											\
 				/* any write to IO1 will (re)start the PRG transfer */			\
 				transferStarted = 1;											\
+				/* $DE03 = page shown at $8000 (block transfer), $DE04 = launch code */	\
+				if ( GET_IO12_ADDRESS == 3 ) {									\
+					READ_D0to7_FROM_BUS( D )									\
+					romlFirstPage = D;											\
+					romlWindow = 1;												\
+					FINISH_BUS_HANDLING											\
+					return;														\
+				}																\
+				if ( GET_IO12_ADDRESS == 4 ) {									\
+					romlWindow = 0;												\
+					FINISH_BUS_HANDLING											\
+					return;														\
+				}																\
 				if ( GET_IO12_ADDRESS == 2 ) {									\
 					currentOfs = prgSizeBelowA000 + 2;							\
 					transferPart = 1;											\
@@ -147,6 +171,18 @@ static void launchPrepareAndWarmCache()
 			} else 																\
 			/* if ( CPU_READS_FROM_BUS ) */										\
 			{																	\
+				if ( GET_IO12_ADDRESS == 3 ) {									\
+					/* $DE03 -> number of 256-byte pages for the block transfer */	\
+					WRITE_D0to7_TO_BUS( prgPages )								\
+					FINISH_BUS_HANDLING											\
+					return;														\
+				}																\
+				if ( GET_IO12_ADDRESS == 5 ) {									\
+					/* $DE05 -> bytes used in the last page (0 = 256) */		\
+					WRITE_D0to7_TO_BUS( prgLastPageBytes )						\
+					FINISH_BUS_HANDLING											\
+					return;														\
+				}																\
 				if ( GET_IO12_ADDRESS == 1 ) {									\
 					if ( transferPart == 1 ) /* PRG part above $a000 */			\
 						D = ( prgSizeAboveA000 + 255 ) >> 8;  else				\
@@ -185,8 +221,14 @@ static void launchPrepareAndWarmCache()
 		}																		\
 																				\
 		/* access to CBM80 ROM (launch code) */									\
-		if ( CPU_READS_FROM_BUS && ROML_ACCESS )								\
-			WRITE_D0to7_TO_BUS( launchCode[ GET_ADDRESS + LAUNCH_BYTES_TO_SKIP ] );	\
+		if ( CPU_READS_FROM_BUS && ROML_ACCESS ) {								\
+			if ( romlWindow ) {													\
+				u32 a = GET_ADDRESS, p = romlFirstPage + ( a >> 8 );			\
+				if ( p > prgLastPage ) p = prgLastPage;							\
+				WRITE_D0to7_TO_BUS( prgData[ 2 + ( p << 8 ) + ( a & 255 ) ] );	\
+			} else																\
+				WRITE_D0to7_TO_BUS( launchCode[ GET_ADDRESS + LAUNCH_BYTES_TO_SKIP ] );	\
+		}																		\
 																				\
 		OUTPUT_LATCH_AND_FINISH_BUS_HANDLING									\
 		return;																	\
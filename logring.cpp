@@ -0,0 +1,211 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ logring.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - deferred logging through a ring buffer
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "logring.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+u8 logRingLevel[ LOGRING_SUBSYSTEMS ] = { LogNotice, LogNotice, LogNotice, LogNotice };
+
+LOGRING_ENTRY logRing[ LOGRING_ENTRIES ];
+volatile u32 logRingWritePos = 0, logRingReadPos = 0;
+u32 logRingDropped = 0;
+
+static const char *levelName[ 5 ] = { "panic", "error", "warning", "notice", "debug" };
+
+// appends at most 'size - 1' characters
+static u32 append( char *buf, u32 pos, u32 size, const char *s, u32 l )
+{
+	if ( pos + l > size - 1 )
+		l = size - 1 - pos;
+	memcpy( &buf[ pos ], s, l );
+	return pos + l;
+}
+
+// each conversion is formatted on its own with the type it expects, the arguments were stored as 64 bit values
+u32 logRingFormat( const LOGRING_ENTRY *e, char *buf, u32 size )
+{
+	const char *f = e->format;
+	u32 pos = 0, a = 0;
+
+	while ( *f && pos < size - 1 )
+	{
+		if ( *f != '%' )
+		{
+			const char *n = strchr( f, '%' );
+			u32 l = n ? n - f : strlen( f );
+			pos = append( buf, pos, size, f, l );
+			f += l;
+			continue;
+		}
+
+		if ( f[ 1 ] == '%' )
+		{
+			pos = append( buf, pos, size, "%", 1 );
+			f += 2;
+			continue;
+		}
+
+		// %[flags][width][.precision][length]conversion
+		// (width and precision have at most 2 digits, anything else ends the formatting)
+		char spec[ 16 ];
+		u32 s = 0, longArg = 0;
+		spec[ s++ ] = *(f++);
+		for ( u32 i = 0; i < 3 && *f && strchr( "-+ #0", *f ); i++ )	spec[ s++ ] = *(f++);
+		for ( u32 i = 0; i < 2 && *f >= '0' && *f <= '9'; i++ )		spec[ s++ ] = *(f++);
+		if ( *f == '.' )
+		{
+			spec[ s++ ] = *(f++);
+			for ( u32 i = 0; i < 2 && *f >= '0' && *f <= '9'; i++ )	spec[ s++ ] = *(f++);
+		}
+		while ( *f == 'l' || *f == 'h' || *f == 'z' )
+		{
+			if ( *f == 'l' || *f == 'z' ) longArg = 1;
+			f++;
+		}
+
+		char conv = *f;
+		if ( conv == 0 || a >= LOGRING_ARGS || !strchr( "diuxXocspfeEgG", conv ) )
+			break;
+		f++;
+
+		// all integers are formatted as 'long long'
+		if ( strchr( "diuxXo", conv ) )
+		{
+			spec[ s++ ] = 'l';
+			spec[ s++ ] = 'l';
+		}
+		spec[ s++ ] = conv;
+		spec[ s ] = 0;
+
+		char tmp[ 512 ];
+		u64 v = e->arg[ a ];
+		u32 isString = ( e->strMask >> a ) & 1;
+		a ++;
+
+		switch ( conv )
+		{
+		case 'd': case 'i':
+			// values of 32 bit types were sign extended when they were stored
+			sprintf( tmp, spec, longArg ? (long long)v : (long long)(s32)v );
+			break;
+		case 'u': case 'x': case 'X': case 'o':
+			sprintf( tmp, spec, longArg ? (unsigned long long)v : (unsigned long long)(u32)v );
+			break;
+		case 'c':
+			sprintf( tmp, spec, (int)v );
+			break;
+		case 's':
+			sprintf( tmp, spec, isString ? &e->str[ v ] : "(?)" );
+			break;
+		case 'p':
+			sprintf( tmp, spec, (void *)(uintptr)v );
+			break;
+		default:
+			{
+				double d;
+				memcpy( &d, &v, sizeof( double ) );
+				sprintf( tmp, spec, d );
+			}
+			break;
+		}
+
+		pos = append( buf, pos, size, tmp, strlen( tmp ) );
+	}
+
+	buf[ pos ] = 0;
+	return pos;
+}
+
+u32 logRingFlush( CLogger *logger, u32 maxMessages )
+{
+	u32 n = 0;
+
+	if ( logRingDropped )
+	{
+		logger->Write( "LogRing", LogWarning, "%u messages dropped", logRingDropped );
+		logRingDropped = 0;
+	}
+
+	while ( n < maxMessages && logRingReadPos != logRingWritePos )
+	{
+		u32 r = logRingReadPos;
+		const LOGRING_ENTRY *e = &logRing[ r & ( LOGRING_ENTRIES - 1 ) ];
+
+		char buf[ 512 ];
+		logRingFormat( e, buf, sizeof( buf ) );
+		logger->Write( e->source, (TLogSeverity)e->severity, "%s", buf );
+
+		logRingReadPos = r + 1;
+		n ++;
+	}
+
+	return n;
+}
+
+u32 logRingPending()
+{
+	return logRingWritePos - logRingReadPos;
+}
+
+// the names in the config file might be upper case
+static int equalNoCase( const char *a, const char *b )
+{
+	for ( ; *a && *b; a++, b++ )
+		if ( ( *a | 0x20 ) != ( *b | 0x20 ) )
+			return 0;
+	return *a == *b;
+}
+
+int logRingSubsystem( const char *name )
+{
+	for ( int i = 0; i < LOGRING_SUBSYSTEMS; i++ )
+		if ( equalNoCase( name, logRingSubsystemName[ i ] ) )
+			return i;
+	return -1;
+}
+
+const char *logRingLevelName( u32 level )
+{
+	return level <= LogDebug ? levelName[ level ] : "?";
+}
+
+int logRingParseLevel( const char *level )
+{
+	if ( level[ 0 ] >= '0' && level[ 0 ] <= '9' )
+	{
+		int l = atoi( level );
+		return l <= LogDebug ? l : -1;
+	}
+
+	for ( int i = 0; i <= LogDebug; i++ )
+		if ( equalNoCase( level, levelName[ i ] ) )
+			return i;
+	return -1;
+}
@@ -0,0 +1,170 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ logring.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - deferred logging through a ring buffer
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _logring_h
+#define _logring_h
+
+#include <circle/types.h>
+#include <circle/logger.h>
+#include <string.h>
+
+//
+// Deferred logging for frequently called code (modem emulation, web server, launching from the menu)
+//
+// LOGRING stores the source, the format string (string literals stay in place, their address is the ID) and the raw 
+// arguments in a ring buffer, which takes a few stores. Formatting and the output through CLogger (screen or serial) 
+// are done later by logRingFlush when the main loop is idle. Messages therefore appear after those written directly.
+//
+// String arguments (char pointers) are copied as the memory they point to might be gone when the message is 
+// formatted, all other arguments are stored as 64 bit values. Not to be used in IRQ or FIQ handlers.
+//
+// Messages with a severity above the level of their subsystem are discarded before anything is stored,
+// the levels can be changed at run time (LOG_LEVEL in the config file, /api/log of the web server).
+//
+#define LOGRING_ENTRIES		512				// power of 2
+#define LOGRING_ARGS		6
+#define LOGRING_STRINGS		56				// bytes for the copies of string arguments (per message)
+
+#define LOGRING_MENU		0
+#define LOGRING_NET			1
+#define LOGRING_MODEM		2
+#define LOGRING_WEB			3
+#define LOGRING_SUBSYSTEMS	4
+
+const char logRingSubsystemName[ LOGRING_SUBSYSTEMS ][ 8 ] = { "menu", "net", "modem", "web" };
+
+typedef struct
+{
+	const char	*source;
+	const char	*format;
+	u8			subsystem, severity;
+	u8			strMask;					// bit i set: argument i is an offset into str
+	u8			strUsed;
+	u64			arg[ LOGRING_ARGS ];
+	char		str[ LOGRING_STRINGS ];
+} LOGRING_ENTRY;
+
+extern u8 logRingLevel[ LOGRING_SUBSYSTEMS ];
+
+extern LOGRING_ENTRY logRing[ LOGRING_ENTRIES ];
+extern volatile u32 logRingWritePos, logRingReadPos;
+extern u32 logRingDropped;
+
+#define LOGRING( subsystem, severity, source, ... )								\
+	do {																		\
+		if ( (u32)(severity) <= logRingLevel[ subsystem ] )						\
+			logRingWrite( subsystem, severity, source, __VA_ARGS__ );			\
+	} while ( 0 )
+
+//
+// capturing the arguments
+//
+static inline void logRingPutString( LOGRING_ENTRY *e, u32 i, const char *s )
+{
+	// strings which do not fit are cut, the last byte always stays available for the terminating 0
+	u32 used = e->strUsed;
+	u32 l = s ? strlen( s ) : 0;
+	if ( used + l + 1 > LOGRING_STRINGS )
+		l = LOGRING_STRINGS - 1 - used;
+
+	if ( l )
+		memcpy( &e->str[ used ], s, l );
+	e->str[ used + l ] = 0;
+	e->arg[ i ] = used;
+	e->strMask |= 1 << i;
+	e->strUsed = ( used + l + 1 < LOGRING_STRINGS ) ? used + l + 1 : LOGRING_STRINGS - 1;
+}
+
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, const char *s )	{ logRingPutString( e, i, s ); }
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, char *s )			{ logRingPutString( e, i, s ); }
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, const unsigned char *s ) { logRingPutString( e, i, (const char *)s ); }
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, unsigned char *s )	{ logRingPutString( e, i, (const char *)s ); }
+
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, double v )
+{
+	memcpy( &e->arg[ i ], &v, sizeof( double ) );
+}
+
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, float v )			{ logRingPut( e, i, (double)v ); }
+
+template <typename T>
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, T *p )				{ e->arg[ i ] = (u64)(uintptr)p; }
+
+// integers (sign extended) and enums
+template <typename T>
+static inline void logRingPut( LOGRING_ENTRY *e, u32 i, T v )				{ e->arg[ i ] = (u64)v; }
+
+static inline void logRingCapture( LOGRING_ENTRY *, u32 ) {}
+
+template <typename T, typename... A>
+static inline void logRingCapture( LOGRING_ENTRY *e, u32 i, T v, A... rest )
+{
+	logRingPut( e, i, v );
+	logRingCapture( e, i + 1, rest... );
+}
+
+template <typename... A>
+static inline void logRingWrite( u32 subsystem, u32 severity, const char *source, const char *format, A... args )
+{
+	static_assert( sizeof...( A ) <= LOGRING_ARGS, "too many arguments for LOGRING" );
+
+	u32 w = logRingWritePos;
+	if ( w - logRingReadPos >= LOGRING_ENTRIES )
+	{
+		logRingDropped ++;
+		return;
+	}
+
+	LOGRING_ENTRY *e = &logRing[ w & ( LOGRING_ENTRIES - 1 ) ];
+	e->source = source;
+	e->format = format;
+	e->subsystem = subsystem;
+	e->severity = severity;
+	e->strMask = e->strUsed = 0;
+	logRingCapture( e, 0, args... );
+
+	// the entry is complete before it is published (there is only one core, the consumer is logRingFlush)
+	asm volatile( "" ::: "memory" );
+	logRingWritePos = w + 1;
+}
+
+// formats an entry into 'buf' (at most 'size' bytes including the terminating 0), returns the length
+extern u32  logRingFormat( const LOGRING_ENTRY *e, char *buf, u32 size );
+
+// formats and writes up to 'maxMessages' messages through 'logger', returns the number written
+extern u32  logRingFlush( CLogger *logger, u32 maxMessages = 0xffffffff );
+
+extern u32  logRingPending();
+
+// subsystem by name (-1 if unknown) and level by name ("error", "warning", "notice", "debug") or number
+extern int  logRingSubsystem( const char *name );
+extern int  logRingParseLevel( const char *level );
+extern const char *logRingLevelName( u32 level );
+
+#endif
@@ -0,0 +1,95 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ modemlink.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - data path and 6551 registers of the SwiftLink modem emulation
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "modemlink.h"
+#include <circle/net/socket.h>
+#include <circle/net/in.h>
+
+boolean CModemLink::GetForTerminal( u8 &c, unsigned nNow )
+{
+	if ( m_nCharInterval > 0 && (int)( nNow - m_nNextCharTicks ) < 0 )
+		return false;
+
+	if ( !m_Input.Get( c ) )
+		return false;
+
+	//do not accumulate time while the line was idle, this would allow bursts
+	if ( (int)( nNow - m_nNextCharTicks ) > (int) m_nCharInterval )
+		m_nNextCharTicks = nNow;
+	m_nNextCharTicks += m_nCharInterval;
+	m_nBytesReceived++;
+	return true;
+}
+
+unsigned CModemLink::ReadFromTerminal( u8 *pBuffer, unsigned nMax )
+{
+	unsigned n = 0;
+	while ( n < nMax && m_Output.Get( pBuffer[ n ] ) )
+		n++;
+	return n;
+}
+
+unsigned CModemLink::WriteToTerminal( const u8 *pBuffer, unsigned nLength )
+{
+	unsigned c = 0;
+	while ( c < nLength && m_Input.Put( pBuffer[ c ] ) )
+		c++;
+	m_nOverruns += nLength - c;
+	return c;
+}
+
+boolean CModemLink::Pump( CNetSocket *pSocket, boolean bWait )
+{
+	u8 buffer[ MODEM_RECEIVE_CHUNK ];
+
+	unsigned n = ReadFromTerminal( buffer, MODEM_OUTPUT_BUFFER_SIZE );
+	if ( n > 0 )
+	{
+		if ( pSocket->Send( buffer, n, MSG_DONTWAIT ) < 0 )
+			return false;
+		m_nBytesSent += n;
+		//the answer (e.g. the echo) is usually there soon, wait for it
+		bWait = true;
+	}
+
+	for ( unsigned attempt = 0; attempt <= MODEM_RECEIVE_ATTEMPTS; attempt++ )
+	{
+		//flow control: leave the data in the socket (and let TCP throttle the sender)
+		//as long as the C64 has not caught up
+		if ( m_Input.GetFree() < MODEM_RECEIVE_CHUNK )
+			break;
+
+		int x = pSocket->Receive( buffer, MODEM_RECEIVE_CHUNK, bWait ? 0 : MSG_DONTWAIT );
+		if ( x < 0 )
+			return false;
+		WriteToTerminal( buffer, x );
+		bWait = false;
+	}
+	return true;
+}
@@ -0,0 +1,211 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ modemlink.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - data path and 6551 registers of the SwiftLink modem emulation
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _modemlink_h
+#define _modemlink_h
+
+#include <circle/types.h>
+#include <circle/synchronize.h>
+#include <circle/net/netsocket.h>
+
+//single producer/single consumer ring buffer for the modem emulation:
+//one side is the FIQ handler or the main loop of the kernel, the other one the network code,
+//each index is only written by its own side, so no locking is required (SIZE must be a power of 2)
+template <unsigned SIZE>
+class CModemRingBuffer
+{
+public:
+	CModemRingBuffer() : m_nHead( 0 ), m_nTail( 0 ) {};
+
+	//only call this if neither side is accessing the buffer
+	void Reset() { m_nHead = m_nTail = 0; };
+
+	unsigned GetLength() const { return m_nHead - m_nTail; };
+	unsigned GetFree() const { return SIZE - ( m_nHead - m_nTail ); };
+
+	boolean Put( u8 c )
+	{
+		if ( GetFree() == 0 )
+			return false;
+		m_Data[ m_nHead & ( SIZE - 1 ) ] = c;
+		DataMemBarrier();
+		m_nHead = m_nHead + 1;
+		return true;
+	};
+
+	boolean Get( u8 & c )
+	{
+		if ( m_nHead == m_nTail )
+			return false;
+		DataMemBarrier();
+		c = m_Data[ m_nTail & ( SIZE - 1 ) ];
+		DataMemBarrier();
+		m_nTail = m_nTail + 1;
+		return true;
+	};
+
+private:
+	u8 m_Data[ SIZE ];
+	volatile unsigned m_nHead, m_nTail;
+};
+
+#define MODEM_INPUT_BUFFER_SIZE		8192
+#define MODEM_OUTPUT_BUFFER_SIZE	512
+#define MODEM_RECEIVE_CHUNK			4096
+#define MODEM_RECEIVE_ATTEMPTS		10
+
+//data path of the SwiftLink modem emulation: chars received from the socket wait in the input buffer until
+//the terminal program on the C64 picks them up (paced to the emulated baud rate), chars typed on the C64 wait
+//in the output buffer until the network code sends them
+class CModemLink
+{
+public:
+	CModemLink() : m_nCharInterval( 0 ), m_nNextCharTicks( 0 ), m_nBytesReceived( 0 ), m_nBytesSent( 0 ), m_nOverruns( 0 ) {};
+
+	//only call this if neither side is accessing the buffers
+	void Reset() { m_Input.Reset(); m_Output.Reset(); };
+	void ResetStats() { m_nBytesReceived = m_nBytesSent = m_nOverruns = 0; };
+
+	//one start bit, 8 data bits and one stop bit per char
+	void SetBaudRate( unsigned nRate ) { m_nCharInterval = nRate > 0 ? 10000000 / nRate : 0; };
+
+	//C64 side (FIQ handler and main loop of the launch kernel)
+	boolean IsOutputReady() const { return m_Output.GetFree() > 0; };
+	boolean HasCharsForTerminal() const { return m_Input.GetLength() > 0; };
+	void PutFromTerminal( u8 c )
+	{
+		if ( !m_Output.Put( c ) )
+			m_nOverruns++;
+	};
+	//returns false if there is nothing to deliver yet, chars are paced to the emulated baud rate
+	boolean GetForTerminal( u8 &c, unsigned nNow );
+
+	//network side
+	boolean HasCharsFromTerminal() const { return m_Output.GetLength() > 0; };
+	unsigned GetCharsForTerminal() const { return m_Input.GetLength(); };
+	unsigned ReadFromTerminal( u8 *pBuffer, unsigned nMax );
+	//chars which do not fit anymore are dropped and counted as overrun
+	unsigned WriteToTerminal( const u8 *pBuffer, unsigned nLength );
+	//sends what has been typed on the C64 and receives from the socket as long as the input buffer can take it,
+	//'bWait' waits for the first answer, returns false if the connection has been closed by the other side
+	boolean Pump( CNetSocket *pSocket, boolean bWait );
+
+	unsigned GetBytesReceived() const { return m_nBytesReceived; };
+	unsigned GetBytesSent() const { return m_nBytesSent; };
+	unsigned GetOverruns() const { return m_nOverruns; };
+
+private:
+	CModemRingBuffer<MODEM_OUTPUT_BUFFER_SIZE> m_Output;
+	CModemRingBuffer<MODEM_INPUT_BUFFER_SIZE> m_Input;
+	unsigned m_nCharInterval;
+	unsigned m_nNextCharTicks;
+	unsigned m_nBytesReceived;
+	unsigned m_nBytesSent;
+	volatile unsigned m_nOverruns;
+};
+
+//registers of the 6551 ACIA of the SwiftLink at $DE00-$DE03
+#define SWIFTLINK_DATA			0x00
+#define SWIFTLINK_STATUS		0x01
+#define SWIFTLINK_COMMAND		0x02
+#define SWIFTLINK_CONTROL		0x03
+
+#define ACIA_STATUS_RDRF		0x08	//receive data register full
+#define ACIA_STATUS_TDRE		0x10	//transmit data register empty (our CTS)
+#define ACIA_STATUS_DCD			0x20	//0 = carrier detected, i.e. the socket is connected
+#define ACIA_COMMAND_DTR		0x01	//NMIs for received chars are only raised with DTR
+#define ACIA_COMMAND_RTS		0x0c	//the terminal program deasserts RTS (bits 2/3 = 0) when it cannot take more chars
+
+//the 6551 as seen by the C64, Read/Write are called from the FIQ handler, Receive from the main loop
+class CSwiftLink6551
+{
+public:
+	CSwiftLink6551() { Reset(); };
+
+	void Reset() { m_nCommand = m_nControl = 0; m_nReceived = 0; m_bReceiveFull = false; };
+
+	u8 Read( u32 nRegister, CModemLink *pLink, boolean bConnected )
+	{
+		switch ( nRegister )
+		{
+		case SWIFTLINK_DATA:
+			if ( !m_bReceiveFull )
+				return 72;	//fake echo
+			m_bReceiveFull = false;
+			return m_nReceived;
+		case SWIFTLINK_STATUS:
+			return ( m_bReceiveFull ? ACIA_STATUS_RDRF : 0 ) |
+				   ( pLink->IsOutputReady() ? ACIA_STATUS_TDRE : 0 ) |
+				   ( bConnected ? 0 : ACIA_STATUS_DCD );
+		case SWIFTLINK_COMMAND:
+			return m_nCommand;
+		default:
+			return m_nControl;
+		}
+	};
+
+	//returns true if the C64 has sent a char
+	boolean Write( u32 nRegister, u8 D, CModemLink *pLink )
+	{
+		if ( nRegister == SWIFTLINK_CONTROL )
+			m_nControl = D; else
+		if ( nRegister == SWIFTLINK_COMMAND )
+			m_nCommand = D; else
+		if ( nRegister == SWIFTLINK_DATA )
+		{
+			pLink->PutFromTerminal( D );
+			return true;
+		}
+		return false;
+	};
+
+	//puts the next char into the receive data register if it is empty and RTS is asserted,
+	//returns true if the C64 needs to be told (NMI)
+	boolean Receive( CModemLink *pLink, unsigned nNow )
+	{
+		u8 c;
+		if ( m_bReceiveFull || !( m_nCommand & ACIA_COMMAND_RTS ) || !pLink->GetForTerminal( c, nNow ) )
+			return false;
+		m_nReceived = c;
+		m_bReceiveFull = true;
+		return true;
+	};
+
+	boolean IsReceiveFull() const { return m_bReceiveFull; };
+	boolean IsDTR() const { return m_nCommand & ACIA_COMMAND_DTR; };
+	//baud rate selected by the lower 4 bits of the control register
+	unsigned GetBaudCode() const { return m_nControl & 15; };
+
+private:
+	volatile u8 m_nCommand, m_nControl;
+	volatile u8 m_nReceived;
+	volatile boolean m_bReceiveFull;
+};
+
+#endif
@@ -33,6 +33,7 @@
 
 #include "net.h"
 #include "helpers.h"
+#include "logring.h"
 
 #ifndef IS264
 #include "c64screen.h"
@@ -137,6 +138,7 @@ CSidekickNet::CSidekickNet(
 #endif
 		m_pBBSSocket(0),
 		m_WebServer(0),
+		m_HTTPClient(0),
 #ifdef WITH_USB_SERIAL
 		m_pUSBSerial(0),
 		m_pUSBMidi(0),
@@ -153,6 +155,7 @@ CSidekickNet::CSidekickNet(
 		m_isCSDBDownloadSavingQueued( false ),
 		m_isDownloadReady( false ),
 		m_isDownloadReadyForLaunch( false ),
+		m_isDownloadStreamedToSD( false ),
 		m_isRebootRequested( false ),
 		m_isReturnToMenuRequested( false ),
 		m_networkActionStatusMsg( (char * ) ""),
@@ -186,10 +189,7 @@ CSidekickNet::CSidekickNet(
 		m_modemCommand( (char * ) ""),
 		m_modemCommandLength(0),
 		m_modemEmuType(0),
-		m_modemOutputBufferLength(0),
-		m_modemOutputBufferPos(0),
-		m_modemInputBufferLength(0),
-		m_modemInputBufferPos(0),
+		m_modemSessionStart(0),
 		m_socketPort(0),
 		m_baudRate(1200)
 {
@@ -200,8 +200,6 @@ CSidekickNet::CSidekickNet(
 	m_pTimer->SetTimeZone (nTimeZone);
 	
 	m_modemCommand[0] = '\0';
-	m_modemInputBuffer[0] = '\0';
-	m_modemOutputBuffer[0] = '\0';
 	m_socketHost[0] = '\0';
 	
 	m_CSDBDownloadPath[0] = '\0';
@@ -302,6 +300,9 @@ boolean CSidekickNet::Initialize()
 
 #ifdef WITH_TLS
 	m_TLSSupport = new CTLSSimpleSupport (m_Net);
+	m_HTTPClient = new CHTTPStreamClient (m_Net, m_TLSSupport);
+#else
+	m_HTTPClient = new CHTTPStreamClient (m_Net);
 #endif
 
 	//TODO: the resolves could be postponed to the moment where the first 
@@ -512,6 +513,8 @@ void CSidekickNet::requestReboot(){
 boolean CSidekickNet::disableActiveNetwork(){
 	//FIXME THIS DOES NOT WORK
 	m_isActive = false;
+	if (m_HTTPClient)
+		m_HTTPClient->CloseAll();
 	m_isUSBPrepared = false;
 	m_isPrepared = false;
 	/*
@@ -886,9 +889,8 @@ void CSidekickNet::handleQueuedNetworkAction()
 					logger->Write ("CSidekickNet", LogNotice, "Triggering WLAN keep-alive request...");
 				if (m_SKTPServer.port != 0)
 				{
-					char pResponseBuffer[4097]; //TODO: can we reuse something else existing here?
 					CString path = isSktpSessionActive() ? getSktpPath( 92 ) : "/givemea404response.html";
-					HTTPGet ( m_SKTPServer, path, pResponseBuffer, m_sktpResponseLength);
+					HTTPGet ( m_SKTPServer, path, m_sktpResponseBuffer, sizeof(m_sktpResponseBuffer), m_sktpResponseLength);
 				}
 				else
 					UpdateTime();
@@ -996,9 +998,13 @@ void CSidekickNet::saveDownload2SD()
 		downloadLogMsg.Append( "'" );
 		logger->Write( "saveDownload2SD", LogNotice, downloadLogMsg);
 	}
-	requireCacheWellnessTreatment();
-	writeFile( logger, DRIVE, m_CSDBDownloadSavePath, (u8*) prgDataLaunch, prgSizeLaunch );
-	requireCacheWellnessTreatment();
+	//the download has already been streamed to the SD card while it was received
+	if (!m_isDownloadStreamedToSD)
+	{
+		requireCacheWellnessTreatment();
+		writeFile( logger, DRIVE, m_CSDBDownloadSavePath, (u8*) prgDataLaunch, prgSizeLaunch );
+		requireCacheWellnessTreatment();
+	}
 	logger->Write( "saveDownload2SD", LogNotice, "Finished writing.");
 	m_isDownloadReadyForLaunch = true;
 }
@@ -1033,6 +1039,7 @@ void CSidekickNet::cleanupDownloadData()
 	m_CSDBDownloadSavePath = (char *)"";
 	m_bSaveCSDBDownload2SD = false;
 	m_isDownloadReadyForLaunch = false;
+	m_isDownloadStreamedToSD = false;
 	requireCacheWellnessTreatment();
 }
 
@@ -1185,18 +1192,62 @@ boolean CSidekickNet::UpdateTime(void)
 	return false;
 }
 
+//the download is streamed into prgDataLaunch, and if it is to be saved also into
+//'<save path>.part' on the SD card. An interrupted download is resumed from this file.
 void CSidekickNet::getCSDBBinaryContent( ){
 	assert (m_isActive);
 	unsigned iFileLength = 0;
-	unsigned char prgDataLaunchTemp[ 1027*1024 ]; // TODO do we need this?
-	if ( HTTPGet ( m_CSDBDownloadHost, (char *) m_CSDBDownloadPath, (char *) prgDataLaunchTemp, iFileLength)){
-		if (m_loglevel > 3)
-			logger->Write( "getCSDBBinaryContent", LogNotice, "Got stuff via HTTPS, now doing memcpy");
-		memcpy( prgDataLaunch, prgDataLaunchTemp, iFileLength);
-		prgSizeLaunch = iFileLength;
-		m_isDownloadReady = true;
-		if (m_loglevel > 3)
-			logger->Write( "getCSDBBinaryContent", LogNotice, "memcpy finished.");
+	CHTTPBufferSink ramSink( prgDataLaunch, sizeof(prgDataLaunch) );
+	CHTTPFileSink fileSink;
+	CHTTPTeeSink teeSink( &fileSink, &ramSink );
+	CHTTPStreamSink * pSink = &ramSink;
+	unsigned offset = 0;
+	CString partPath;
+
+	m_isDownloadStreamedToSD = false;
+	if ( m_bSaveCSDBDownload2SD && strcmp( m_CSDBDownloadSavePath, "" ) != 0 )
+	{
+		partPath = m_CSDBDownloadSavePath;
+		partPath.Append( ".part" );
+
+		//prgDataLaunch has to contain the complete file for launching it, so load what we already have
+		u32 size = 0;
+		if ( getFileSize( logger, DRIVE, partPath, &size ) && size > 0 && size <= sizeof(prgDataLaunch) &&
+			 !readFile( logger, DRIVE, partPath, prgDataLaunch, &size ) )
+			f_unlink( partPath );
+
+		if ( fileSink.Open( partPath ) )
+		{
+			pSink = &teeSink;
+			offset = fileSink.GetResumeOffset();
+			if (offset > 0 && m_loglevel > 2)
+				logger->Write( "getCSDBBinaryContent", LogNotice, "Resuming download at %u", offset);
+		}
+	}
+
+	unsigned status = HTTPGetStream( m_CSDBDownloadHost, (char *) m_CSDBDownloadPath, pSink, offset );
+	fileSink.Close();
+	if ( pSink == &teeSink && fileSink.GetResumeOffset() == 0 )
+		f_unlink( partPath );
+	if ( status == 200 || status == 206 ){
+		if ( pSink == &teeSink )
+		{
+			f_unlink( m_CSDBDownloadSavePath );
+			if ( f_rename( partPath, m_CSDBDownloadSavePath ) == FR_OK )
+				m_isDownloadStreamedToSD = true;
+		}
+		iFileLength = ramSink.GetLength();
+		if ( pSink == &teeSink && teeSink.HasSecondFailed() )
+		{
+			//saved, but we cannot keep it in memory
+			//                    "012345678901234567890123456789012345XXXX"
+			setErrorMsgC64((char*)"   Download saved, too large to launch  ", false);
+		}
+		else
+		{
+			prgSizeLaunch = iFileLength;
+			m_isDownloadReady = true;
+		}
 		requireCacheWellnessTreatment();
 	}
 	else if (m_CSDBDownloadHost.port == 443)
@@ -1227,7 +1278,7 @@ void CSidekickNet::updateFrame(){
 	Number.Format ("%05d", m_videoFrameCounter);
 	path.Append( Number );
 	path.Append( ".bin" );
-	HTTPGet ( m_SKTPServer, path, (char*) logo_bg_raw, iFileLength);
+	HTTPGet ( m_SKTPServer, path, (char*) logo_bg_raw, sizeof(logo_bg_raw), iFileLength);
 	m_videoFrameCounter++;
 	if (m_videoFrameCounter > 1500) m_videoFrameCounter = 1;
 }
@@ -1247,7 +1298,7 @@ boolean CSidekickNet::isSktpSessionActive(){
 }
 
 boolean CSidekickNet::launchSktpSession(){
-	char * pResponseBuffer = new char[33];	// +1 for 0-termination
+	char * pResponseBuffer = new char[34];	// +1 for 0-termination
 	CString urlSuffix = "/sktp.php?session=new";
 	if (strcmp(netSktpHostUser,"") != 0)
 	{
@@ -1269,7 +1320,7 @@ boolean CSidekickNet::launchSktpSession(){
 		urlSuffix.Append("264");
 	#endif
 
-	if (HTTPGet ( m_SKTPServer, urlSuffix, pResponseBuffer, m_sktpResponseLength))
+	if (HTTPGet ( m_SKTPServer, urlSuffix, pResponseBuffer, 34, m_sktpResponseLength))
 	{
 		if ( m_sktpResponseLength > 25 && m_sktpResponseLength < 34){
 			m_sktpSessionID = pResponseBuffer;
@@ -1337,8 +1388,9 @@ void CSidekickNet::updateSktpScreenContent(){
 		m_sktpSession = 1;
 	}
 
-	char pResponseBuffer[4097]; //maybe turn this into member var when creating new sktp class?
-	if (HTTPGet ( m_SKTPServer, getSktpPath( m_sktpKey ), pResponseBuffer, m_sktpResponseLength))
+	//the screen content is parsed from this buffer after we return, so it must not live on the stack
+	char * pResponseBuffer = m_sktpResponseBuffer;
+	if (HTTPGet ( m_SKTPServer, getSktpPath( m_sktpKey ), pResponseBuffer, sizeof(m_sktpResponseBuffer), m_sktpResponseLength))
 	{
 		if ( m_sktpResponseLength > 0 )
 		{
@@ -1528,34 +1580,34 @@ unsigned char * CSidekickNet::GetSktpScreenContentChunk( u16 & startPos, u8 &col
   return m_sktpScreenContentChunk;
 }
 
-boolean CSidekickNet::HTTPGet (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned & nLengthRead )
+//fetches a document into a buffer and 0-terminates it, nBufferSize includes the termination
+boolean CSidekickNet::HTTPGet (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned nBufferSize, unsigned & nLengthRead )
 {
 	assert (pBuffer != 0);
-	unsigned nLength = nDocMaxSize;
-	if (m_loglevel > 3)
-		logger->Write( "HTTPGet", LogNotice, target.logPrefix, path );
-#ifdef WITH_TLS	
-	CHTTPClient client( m_TLSSupport, target.ipAddress, target.port, target.hostName, target.port == 443 );
-	CircleMbedTLS::THTTPStatus Status = client.Get (path, (u8 *) pBuffer, &nLength);
-	if (Status != CircleMbedTLS::HTTPOK)
-#else
-	CHTTPClient client( m_Net, target.ipAddress, target.port, target.hostName );
-	::THTTPStatus Status = client.Get (path, (u8 *) pBuffer, &nLength);
-	if (Status != ::HTTPOK)
-	
-#endif	
-
+	assert (nBufferSize > 0);
+	CHTTPBufferSink sink( (u8 *) pBuffer, min( nBufferSize - 1, nDocMaxSize ) );
+	unsigned Status = HTTPGetStream( target, path, &sink );
+	if (Status != 200)
 	{
 		if (m_loglevel > 0)
 			logger->Write( "HTTPGet", LogError, "Failed with status %u, >%s<", Status, path);
 		return false;
 	}
-	assert (nLength <= nDocMaxSize);
-	pBuffer[nLength] = '\0';
-	nLengthRead = nLength;
+	nLengthRead = sink.GetLength();
+	pBuffer[nLengthRead] = '\0';
 	return true;
 }
 
+//returns the HTTP status (200, or 206 if nOffset > 0 and the server supports ranges), 0 if the connection failed
+//the connection to the server is kept open for the next request
+unsigned CSidekickNet::HTTPGetStream (remoteHTTPTarget & target, const char * path, CHTTPStreamSink * pSink, unsigned nOffset )
+{
+	assert (m_HTTPClient != 0);
+	if (m_loglevel > 3)
+		logger->Write( "HTTPGet", LogNotice, target.logPrefix, path );
+	return m_HTTPClient->Get( target.ipAddress, target.port, target.hostName, path, pSink, nOffset );
+}
+
 void CSidekickNet::updateSystemMonitor( size_t freeSpace, unsigned CpuTemp)
 {
 	m_sysMonHeapFree = freeSpace;
@@ -1589,9 +1641,13 @@ void CSidekickNet::requireCacheWellnessTreatment(){
 
 void CSidekickNet::getNetRAM( u8 * content, u32 * size){
 	CString path = "/getNetRam.php";
-	if (!HTTPGet ( m_SKTPServer, path, (char*) content, *size)){
+	//binary content, no 0-termination
+	CHTTPBufferSink sink( content, 4096*1024 );
+	unsigned status = HTTPGetStream ( m_SKTPServer, path, &sink );
+	if (status != 200){
 		logger->Write( "getNetRAM", LogError, "Failed with path >%s<", path);
 	}
+	*size = sink.GetLength();
 }
 
 void CSidekickNet::setCurrentKernel( char * r){
@@ -1623,11 +1679,10 @@ void CSidekickNet::setModemEmuBaudrate( unsigned rate )
 	{
 		m_pUSBSerial->SetBaudRate(rate);
 	}
-	else if ( m_modemEmuType == SK_MODEM_SWIFTLINK )
-	{
-		//...
-	}
+	else 
 	#endif
+	if ( m_modemEmuType == SK_MODEM_SWIFTLINK )
+		m_modemLink.SetBaudRate( rate );
 }
 
 void CSidekickNet::cleanUpModemEmuSocket()
@@ -1635,6 +1690,7 @@ void CSidekickNet::cleanUpModemEmuSocket()
 	logger->Write ("CSidekickNet", LogNotice, "cleanup modem socket connection");
 	if ( m_isBBSSocketConnected )
 	{
+		logger->Write ("CSidekickNet", LogNotice, "modem session: %s", (const char *) getModemStats());
 		m_isBBSSocketConnected = false;
 		delete(m_pBBSSocket);
 		m_pBBSSocket = 0;
@@ -1645,17 +1701,27 @@ void CSidekickNet::cleanUpModemEmuSocket()
 	m_modemCommand[0] = '\0';
 	m_socketHost[0] = '\0';
 
-	m_modemInputBufferPos = 0;
-	m_modemInputBufferLength = 0;
-	m_modemInputBuffer[0] = '\0';
+	m_modemLink.Reset();
 
-	m_modemOutputBufferPos = 0;
-	m_modemOutputBufferLength = 0;
-	m_modemOutputBuffer[0] = '\0';
+}
 
+//the other side has closed the connection: what has been received is still delivered, followed by NO CARRIER,
+//the carrier detect bit of the SwiftLink shows the disconnect right away
+void CSidekickNet::modemCarrierLost()
+{
+	logger->Write ("CSidekickNet", LogNotice, "modem connection closed by remote host");
+	logger->Write ("CSidekickNet", LogNotice, "modem session: %s", (const char *) getModemStats());
+	m_isBBSSocketConnected = false;
+	delete(m_pBBSSocket);
+	m_pBBSSocket = 0;
+	m_isBBSSocketFirstReceive = false;
+	m_modemCommandLength = 0;
+	m_modemCommand[0] = '\0';
+	writeCharsToFrontend((unsigned char *) "\r\nNO CARRIER\r\n", 14);
 }
 
-int CSidekickNet::readCharFromFrontend( unsigned char * buffer)
+//reads up to nMax chars typed on the C64 (the USB modem always delivers one at a time)
+int CSidekickNet::readCharFromFrontend( unsigned char * buffer, unsigned nMax )
 {
 		#ifdef WITH_USB_SERIAL
 		if ( m_modemEmuType == SK_MODEM_USERPORT_USB )
@@ -1666,22 +1732,9 @@ int CSidekickNet::readCharFromFrontend( unsigned char * buffer)
 		#endif
 		if ( m_modemEmuType == SK_MODEM_SWIFTLINK )
 		{
-			if (m_modemOutputBufferLength > 0)
-			{
-				if ( m_modemOutputBufferPos == m_modemOutputBufferLength)
-				{
-					m_modemOutputBufferLength = 0;
-					m_modemOutputBufferPos = 0;
-					//m_modemOutputBuffer = (char * ) "";
-					//m_modemOutputBuffer[0] = '\0';
-					logger->Write ("CSidekickNet", LogNotice, "readCharFromFrontend - resetting m_modemOutputBuffer to empty string");
-				}
-				else{
-					buffer[0] = m_modemOutputBuffer[m_modemOutputBufferPos++];
-					logger->Write ("CSidekickNet", LogNotice, "readCharFromFrontend - got '%u' from m_modemOutputBuffer",buffer[0],buffer[0] );
-					return 1;
-				}
-			}
+			unsigned n = m_modemLink.ReadFromTerminal( buffer, nMax );
+			if ( n > 0 )
+				return n;
 		}
 		buffer[0] = '0';
 		return 0;
@@ -1698,50 +1751,25 @@ int CSidekickNet::writeCharsToFrontend( unsigned char * buffer, unsigned length)
 	#endif
 	if ( m_modemEmuType == SK_MODEM_SWIFTLINK )
 	{
-			if ( m_modemInputBufferLength > 0 && m_modemInputBufferPos == m_modemInputBufferLength )
-			{
-				m_modemInputBufferPos = 0;
-				m_modemInputBufferLength = 0;
-				m_modemInputBuffer[0] = '\0';
-				logger->Write ("CSidekickNet", LogNotice, "writeCharsToFrontend - resetting m_modemInputBuffer to empty string");
-			}
-			//char * tmp;
-			//memcpy( tmp, &buffer[0], length );
-		  //strcat( m_modemInputBuffer, tmp );
-			logger->Write ("CSidekickNet", LogNotice, "writeCharsToFrontend - adding %u to %u chars", length, m_modemInputBufferLength);
-			
-			//FIXME: add sanity length check
-			for ( unsigned c = 0; c < length; c++)
-			{
-				m_modemInputBuffer[m_modemInputBufferLength] = buffer[c];
-				m_modemInputBufferLength++;
-			}
-			m_modemInputBuffer[m_modemInputBufferLength]  = '\0';
-			//strcat( m_modemInputBuffer, buffer );
-			//m_modemInputBufferLength += length;
-			return length;
+			//chars which do not fit anymore are dropped and counted as overrun
+			unsigned c = m_modemLink.WriteToTerminal( buffer, length );
+			if ( c < length )
+				LOGRING( LOGRING_MODEM, LogDebug, "CSidekickNet", "writeCharsToFrontend - overrun, dropped %u chars", length - c);
+			return c;
 	}
 	buffer[0] = '0';
 	return 0;
 }
 
-unsigned char CSidekickNet::getCharFromInputBuffer()
-{
-	if (m_modemInputBufferLength == 0 || m_modemInputBufferPos >= m_modemInputBufferLength ){
-			return 0;
-	}
-	unsigned char payload = m_modemInputBuffer[m_modemInputBufferPos++];
-	return payload;
-}
-
-bool CSidekickNet::areCharsInInputBuffer()
+CString CSidekickNet::getModemStats()
 {
-	return ( m_modemInputBufferLength > 0 && m_modemInputBufferPos < m_modemInputBufferLength );
-}
-
-bool CSidekickNet::areCharsInOutputBuffer()
-{
-	return ( m_modemOutputBufferLength > 0 && m_modemOutputBufferPos < m_modemOutputBufferLength );
+	unsigned seconds = m_pTimer->GetUptime() - m_modemSessionStart;
+	CString stats;
+	stats.Format( "%u bytes received, %u bytes sent, %u cps, %u overruns",
+		m_modemLink.GetBytesReceived(), m_modemLink.GetBytesSent(),
+		seconds > 0 ? ( m_modemLink.GetBytesReceived() + m_modemLink.GetBytesSent() ) / seconds : 0,
+		m_modemLink.GetOverruns() );
+	return stats;
 }
 
 void CSidekickNet::handleModemEmulation( bool silent = false)
@@ -1797,7 +1825,7 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 			{
 				//ignore key
 				if ( !silent)
-					logger->Write ("CSidekickNet", LogNotice, "USB serial read ignored char %u", inputChar[0]);
+					LOGRING( LOGRING_MODEM, LogNotice, "CSidekickNet", "USB serial read ignored char %u", inputChar[0]);
 			}
 			else if (inputChar[0] != 13)
 			{
@@ -2030,11 +2058,26 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 			} //end of return key
 		} //end of read one char from serial
 	} // end of command mode
+	else if ( m_isBBSSocketConnected && m_modemEmuType == SK_MODEM_SWIFTLINK ){
+
+		//the FIQ handler is disabled while we are here, i.e. nothing is taken from the input buffer in the meantime
+		unsigned sent = m_modemLink.GetBytesSent(), waiting = m_modemLink.GetCharsForTerminal();
+		boolean connected = m_modemLink.Pump( m_pBBSSocket, m_isBBSSocketFirstReceive );
+		m_isBBSSocketFirstReceive = false;
+
+		if ( m_modemLink.GetBytesSent() != sent )
+			LOGRING( LOGRING_MODEM, LogDebug, "CSidekickNet", "Terminal: sent %u chars to modem", m_modemLink.GetBytesSent() - sent);
+		if ( m_modemLink.GetCharsForTerminal() != waiting )
+			LOGRING( LOGRING_MODEM, LogDebug, "CSidekickNet", "Terminal: wrote %u chars to frontend", m_modemLink.GetCharsForTerminal() - waiting);
+
+		if ( !connected )
+			modemCarrierLost();
+	}
 	else if ( m_isBBSSocketConnected ){
 
 		//buffers should be at least of size FRAME_BUFFER_SIZE (1600)
 
-		int fromFrontend = readCharFromFrontend( inputChar );
+		int fromFrontend = readCharFromFrontend( inputChar, bsize );
 		if ( fromFrontend > 0 )
 		{
 /*				
@@ -2046,11 +2089,8 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 			else
 */				
 			{
-				//if ( !silent)
-					logger->Write ("CSidekickNet", LogNotice, "Terminal: sent %i chars to modem", fromFrontend);
+				LOGRING( LOGRING_MODEM, LogDebug, "CSidekickNet", "Terminal: sent %i chars to modem", fromFrontend);
 				m_pBBSSocket->Send (inputChar, fromFrontend, MSG_DONTWAIT);
-				if ( m_modemEmuType == SK_MODEM_SWIFTLINK)
-					m_isBBSSocketFirstReceive = true;
 			}
 		}
 		
@@ -2068,18 +2108,12 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 			x = m_pBBSSocket->Receive ( buffer, bsize -2, m_isBBSSocketFirstReceive ? 0 : MSG_DONTWAIT);
 			if (x > 0)
 			{
-				int a = writeCharsToFrontend(buffer, x);
-				logger->Write ("CSidekickNet", LogNotice, "Terminal: wrote %u chars to frontend", x);
+				writeCharsToFrontend(buffer, x);
+				LOGRING( LOGRING_MODEM, LogDebug, "CSidekickNet", "Terminal: wrote %u chars to frontend", x);
 				harvest += x;
 			}
 
-			if ( m_modemEmuType == SK_MODEM_SWIFTLINK && attempts <= 10 ) // && !m_isBBSSocketFirstReceive)
-			{
-				again = true;
-				//m_pScheduler->MsSleep(1);
-				//m_pScheduler->Yield();
-			}
-			else if ( m_modemEmuType == SK_MODEM_USERPORT_USB && attempts <= 5)
+			if ( m_modemEmuType == SK_MODEM_USERPORT_USB && attempts <= 5)
 			{
 				again = true;
 			}
@@ -2091,7 +2125,7 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 			
 		}
 		if (harvest > 0) 
-			logger->Write ("CSidekickNet", LogNotice, "Terminal: %u attempts. harvest %u", attempts, harvest);
+			LOGRING( LOGRING_MODEM, LogDebug, "CSidekickNet", "Terminal: %u attempts. harvest %u", attempts, harvest);
 		
 	}
 }
@@ -2140,6 +2174,8 @@ void CSidekickNet::SocketConnectIP( CIPAddress bbsIP, unsigned port )
 	m_pBBSSocket = new CSocket (m_Net, IPPROTO_TCP);
 	if ( m_pBBSSocket->Connect ( bbsIP, port) == 0)
 	{
+		m_modemSessionStart = m_pTimer->GetUptime();
+		m_modemLink.ResetStats();
 		writeCharsToFrontend((unsigned char *) "CONNECT\r\n", 9);
 		m_isBBSSocketConnected = true;
 		m_isBBSSocketFirstReceive = true;
@@ -2204,12 +2240,6 @@ boolean CSidekickNet::checkShortcut( char * keyword, bool silent )
 	return found;
 }
 
-void CSidekickNet::addToModemOutputBuffer( unsigned char mchar)
-{
-	m_modemOutputBuffer[m_modemOutputBufferLength++] = mchar;
-	m_modemOutputBuffer[m_modemOutputBufferLength] = '\0';
-}
-
 unsigned CSidekickNet::getModemEmuType(){
 	return m_modemEmuType;
 }
@@ -49,6 +49,7 @@
 #include <SDCard/emmc.h>
 
 #include "webserver.h"
+#include "httpstream.h"
 
 #ifndef WITHOUT_STDLIB
 #include <circle_glue.h>
@@ -63,11 +64,13 @@
 #include <wlan/hostap/wpa_supplicant/wpasupplicant.h>
 #endif
 
+#include <circle/synchronize.h>
 #include <circle/net/netsubsystem.h>
 #include <circle/net/socket.h>
 #include <circle/net/dnsclient.h>
 
 #include "lowlevel_arm64.h"
+#include "modemlink.h"
 class CKernelMenu;
 #include "kernel_menu.h"
 
@@ -162,14 +165,12 @@ public:
 	#ifdef WITH_USB_SERIAL
 	boolean isUsbUserportModemConnected();
 	#endif
-	void addToModemOutputBuffer( unsigned char );
-	unsigned char getCharFromInputBuffer();
+	CModemLink *getModemLink(){ return &m_modemLink; };
+	CString getModemStats();
 	void handleModemEmulation(bool);
 	unsigned getModemEmuType();
 	void setModemEmuType(unsigned);
 	bool isModemSocketConnected();
-	bool areCharsInInputBuffer();
-	bool areCharsInOutputBuffer();
 	boolean isWebserverRunning();
 
 
@@ -194,12 +195,14 @@ private:
 	boolean Prepare ();
 	void EnableWebserver();
 	CIPAddress getIPForHost( const char *, bool & );
-	boolean HTTPGet (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned & nLengthRead);
+	boolean HTTPGet (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned nBufferSize, unsigned & nLengthRead);
+	unsigned HTTPGetStream (remoteHTTPTarget & target, const char * path, CHTTPStreamSink * pSink, unsigned nOffset = 0);
 	#ifdef WITH_USB_SERIAL
 	void usbPnPUpdate();
 	#endif
 	void cleanUpModemEmuSocket();
-	int readCharFromFrontend( unsigned char * );
+	void modemCarrierLost();
+	int readCharFromFrontend( unsigned char *, unsigned nMax = 1 );
 	int writeCharsToFrontend( unsigned char * buffer, unsigned length);
 	void SendErrorResponse();
 	void SocketConnect( char *, unsigned, bool );
@@ -230,6 +233,7 @@ private:
 #endif	
 	//CActLED							m_ActLED;
 	CWebServer        * m_WebServer;
+	CHTTPStreamClient * m_HTTPClient;
 #ifdef WITH_USB_SERIAL
 	CUSBSerialFT231XDevice * volatile m_pUSBSerial;
 	CUSBMIDIDevice * volatile m_pUSBMidi;
@@ -249,11 +253,13 @@ private:
 	boolean m_isCSDBDownloadSavingQueued;
 	boolean m_isDownloadReady;
 	boolean m_isDownloadReadyForLaunch;
+	boolean m_isDownloadStreamedToSD;
 	boolean m_isRebootRequested;
 	boolean m_isReturnToMenuRequested;
 	char * m_networkActionStatusMsg;
 	unsigned char * m_sktpScreenContent;
 	char * m_sktpSessionID;
+	char m_sktpResponseBuffer[4097];
 	char m_CSDBDownloadPath[256];
 	char m_CSDBDownloadExtension[4];
 	char m_CSDBDownloadFilename[256];
@@ -286,12 +292,8 @@ private:
 	char * m_modemCommand;
 	unsigned m_modemCommandLength;
 	unsigned m_modemEmuType;
-	unsigned char m_modemOutputBuffer[512];
-	unsigned char m_modemInputBuffer[8192];
-	unsigned m_modemOutputBufferLength;
-	unsigned m_modemOutputBufferPos;
-	unsigned m_modemInputBufferLength;
-	unsigned m_modemInputBufferPos;
+	CModemLink m_modemLink;
+	unsigned m_modemSessionStart;
 	char m_socketHost[256];
 	unsigned m_socketPort;
 	unsigned m_baudRate;
@@ -42,11 +42,52 @@ void oledClear()
 	memset( oledFrameBuffer, 0, 128 * 64 / 8 );
 }
 
-static u32 sfb_j, sfb_y, sfb_x;
+// what the display currently shows: only columns which differ from it are transferred
+static u8 oledShown[ 128 * 64 / 8 ];
+static bool oledShownValid = false;
+
+// changed columns closer than this are sent as one span (setting the column/page window costs about as much as 12 data bytes)
+#define OLED_SPAN_MIN_GAP	12
+
+// transfer state: current page, current column and end of the current span, data transfer started?
+static u32 sfb_y, sfb_x, sfb_end;
+static bool sfb_open;
+
+void oledInvalidate()
+{
+	oledShownValid = false;
+}
+
+static bool columnChanged( u32 x )
+{
+	return !oledShownValid || oledFrameBuffer[ sfb_y * 128 + x ] != oledShown[ sfb_y * 128 + x ];
+}
+
+// searches the next span of changed columns starting at (sfb_x, sfb_y), sets sfb_y = 8 if there is none
+static void findNextSpan()
+{
+	for ( ; sfb_y < 8; sfb_y++, sfb_x = 0 )
+	{
+		while ( sfb_x < 128 && !columnChanged( sfb_x ) )
+			sfb_x ++;
+
+		if ( sfb_x == 128 )
+			continue;
+
+		sfb_end = sfb_x + 1;
+		for ( u32 x = sfb_end; x < 128 && x < sfb_end + OLED_SPAN_MIN_GAP; x++ )
+			if ( columnChanged( x ) )
+				sfb_end = x + 1;
+
+		return;
+	}
+}
 
 void sendFramebufferStart()
 {
-	sfb_j = sfb_y = sfb_x = 0;
+	sfb_y = sfb_x = 0;
+	sfb_open = false;
+	findNextSpan();
 }
 
 bool sendFramebufferDone()
@@ -54,42 +95,42 @@ bool sendFramebufferDone()
 	return (sfb_y == 8);
 }
 
+// sends (at most) nBytes of the changed spans, the column/page window is set at the beginning of each span
 void sendFramebufferNext( u32 nBytes )
 {
 	if( sfb_y == 8 ) return;
 
-	if ( sfb_x == 0 /*&& sfb_y == 0*/ )
+	if ( !sfb_open )
 	{
-		//ssd1306_setpos( 0, sfb_y );
-
 		extern void ssd1306_send_command_start(void);
 		extern void ssd1306_send_command_stop(void);
 		ssd1306_send_command_start();
-		u32 col = 0;
-		ssd1306_send_command( 0xb0 | sfb_y );
-		ssd1306_send_command( 0x00 | (col & 0xf) );
-		ssd1306_send_command( 0x10 | (col >> 4) );
-	  //ssd1306_send_command( 0x81 );
-	  //ssd1306_send_command( 0xcf );
+		ssd1306_send_byte( 0x21 );		// column window (horizontal addressing mode)
+		ssd1306_send_byte( sfb_x );
+		ssd1306_send_byte( sfb_end - 1 );
+		ssd1306_send_byte( 0x22 );		// page window
+		ssd1306_send_byte( sfb_y );
+		ssd1306_send_byte( sfb_y );
 		ssd1306_send_command_stop();
 
 		ssd1306_send_data_start();
+		sfb_open = true;
 	}
 
-	for ( u32 i = 0; i < nBytes; i++ )
+	for ( u32 i = 0; i < nBytes && sfb_x < sfb_end; i++ )
 	{
-		//ssd1306_send_data_start();
-		ssd1306_send_byte( oledFrameBuffer[ sfb_j ++ ] );
-		//ssd1306_send_data_stop();
-		sfb_x ++;
+		u32 j = sfb_y * 128 + sfb_x ++;
+		ssd1306_send_byte( oledShown[ j ] = oledFrameBuffer[ j ] );
 	}
 
-	if ( sfb_x == 128 )
+	if ( sfb_x == sfb_end )
 	{
-		sfb_x = 0; sfb_y ++;
+		ssd1306_send_data_stop();
+		sfb_open = false;
 
+		findNextSpan();
 		if ( sfb_y == 8 )
-			ssd1306_send_data_stop();
+			oledShownValid = true;
 	}
 }
 
@@ -100,10 +141,11 @@ void sendFramebuffer()
 	ssd1306_send_data_start();
 	for ( int y = 0; y < 64 / 8; y++ )
 	{
-		for ( int x = 0; x < 128; x++ )
-			ssd1306_send_byte( oledFrameBuffer[ j++ ] );
+		for ( int x = 0; x < 128; x++, j++ )
+			ssd1306_send_byte( oledShown[ j ] = oledFrameBuffer[ j ] );
 	}
 	ssd1306_send_data_stop();
+	oledShownValid = true;
 }
 
 
@@ -115,25 +157,12 @@ void oledSetContrast( u8 c )
 
 void splashScreen2( const u8 *fb )
 {
-	extern void ssd1306_send_command_start(void);
-	extern void ssd1306_send_command_stop(void);
-
-	//SendCommand(SSD1306_CMD_SET_PAGE | page);		// 0xB0 page address
-	//SendCommand(SSD1306_CMD_SET_COLUMN_LOW | (col & 0xf));	// 0x00 column address lower bits
-	//SendCommand(SSD1306_CMD_SET_COLUMN_HIGH | (col >> 4));	// 0x10 column address upper bits
-
 	flushI2CBuffer( true );
 
 	for ( int y = 0; y < 64 / 8; y++ )
 	{
-		ssd1306_send_command_start();
-		u32 col = 2;
-		ssd1306_send_command( 0xb0 | y );
-		ssd1306_send_command( 0x00 | (col & 0xf) );
-		ssd1306_send_command( 0x10 | (col >> 4) );
-		ssd1306_send_command_stop();
-
-		//ssd1306_setpos( 0, y );
+		// horizontal addressing mode: the page/column commands (0xB0, 0x00, 0x10) would be ignored
+		ssd1306_setpos( 0, y );
 		flushI2CBuffer( true );
 
 		for ( int x = 0; x < 128; x++ )
@@ -166,6 +195,7 @@ void splashScreen2( const u8 *fb )
 
 void splashScreen( const u8 *fb )
 {
+	oledInvalidate();
 	ssd1306_init();
 	//ssd1306_send_command( 0x2E ); // SSD1306_DEACTIVATE_SCROLL
 	splashScreen2( fb );
@@ -65,6 +65,7 @@ static inline void oledClearPixel( u32 x, u32 y )
 }
 
 extern void oledClear();
+extern void oledInvalidate();
 extern void oledSetContrast( u8 c );
 extern void sendFramebuffer();
 extern void sendFramebufferStart();
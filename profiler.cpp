@@ -0,0 +1,188 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ profiler.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - statistical sampling profiler for the main loops
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "profiler.h"
+#include "helpers.h"
+#include <circle/interrupt.h>
+#include <circle/bcm2835.h>
+#include <circle/bcm2835int.h>
+#include <circle/memio.h>
+#include <circle/synchronize.h>
+#include <circle/exceptionstub.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <stdio.h>
+
+static const char DRIVE[] = "SD:";
+
+volatile u32 profileContext = PROFILE_CTX_MENU;
+u32 profileRate = 0;
+
+static CInterruptSystem *profileInterrupt = NULL;
+static PROFILE_SAMPLE *profileBuffer = NULL;
+static volatile u32 profileWritePos = 0, profileReadPos = 0;
+static volatile u32 profileDropped = 0;
+static u32 profileDroppedReported = 0;
+static u32 profileInterval = 0, profileCurRate = 0;
+static boolean profileRunning = FALSE;
+
+#define SYSTIMER_MATCH1		( 1 << 1 )
+
+static void profileIRQHandler( void *pParam )
+{
+	u32 now = read32( ARM_SYSTIMER_CLO );
+	u32 late = now - read32( ARM_SYSTIMER_C1 );
+
+	// rearmed relative to now (not to the last compare value): no catching up after IRQs were disabled for a while
+	write32( ARM_SYSTIMER_C1, now + profileInterval );
+	write32( ARM_SYSTIMER_CS, SYSTIMER_MATCH1 );
+
+	u32 w = profileWritePos;
+	if ( w - profileReadPos >= PROFILE_SAMPLES )
+	{
+		profileDropped ++;
+		return;
+	}
+
+	PROFILE_SAMPLE *s = &profileBuffer[ w & ( PROFILE_SAMPLES - 1 ) ];
+	s->pc = (u32)IRQReturnAddress;
+	s->context = profileContext | ( ( late > profileInterval / 2 ) ? PROFILE_DELAYED : 0 );
+
+	// the sample must be visible before the consumer sees the new write position
+	DataMemBarrier();
+	profileWritePos = w + 1;
+}
+
+void profileInit( CInterruptSystem *pInterrupt )
+{
+	profileInterrupt = pInterrupt;
+}
+
+boolean profileStart( u32 rate )
+{
+	if ( profileInterrupt == NULL || rate < PROFILE_RATE_MIN || rate > PROFILE_RATE_MAX )
+		return FALSE;
+
+	profileStop();
+
+	// allocated on first use, the profiler costs no memory if it is never started
+	if ( profileBuffer == NULL )
+		profileBuffer = new PROFILE_SAMPLE[ PROFILE_SAMPLES ];
+
+	profileReadPos = profileWritePos = 0;
+	profileDropped = profileDroppedReported = 0;
+	profileCurRate = rate;
+	profileInterval = 1000000 / rate;
+
+	profileInterrupt->ConnectIRQ( ARM_IRQ_TIMER1, profileIRQHandler, 0 );
+	write32( ARM_SYSTIMER_CS, SYSTIMER_MATCH1 );
+	write32( ARM_SYSTIMER_C1, read32( ARM_SYSTIMER_CLO ) + profileInterval );
+	profileRunning = TRUE;
+
+	return TRUE;
+}
+
+void profileStop()
+{
+	if ( !profileRunning )
+		return;
+
+	profileInterrupt->DisconnectIRQ( ARM_IRQ_TIMER1 );
+	write32( ARM_SYSTIMER_CS, SYSTIMER_MATCH1 );
+	profileRunning = FALSE;
+}
+
+boolean profileActive()
+{
+	return profileRunning;
+}
+
+u32 profileSamplesAvailable()
+{
+	return profileWritePos - profileReadPos;
+}
+
+u32 profileRead( u8 *buffer, u32 size )
+{
+	if ( size < sizeof( PROFILE_HEADER ) )
+		return 0;
+
+	u32 r = profileReadPos;
+	u32 n = min( profileWritePos - r, ( size - (u32)sizeof( PROFILE_HEADER ) ) / (u32)sizeof( PROFILE_SAMPLE ) );
+	DataMemBarrier();
+
+	PROFILE_SAMPLE *s = (PROFILE_SAMPLE*)( buffer + sizeof( PROFILE_HEADER ) );
+	for ( u32 i = 0; i < n; i++ )
+		s[ i ] = profileBuffer[ ( r + i ) & ( PROFILE_SAMPLES - 1 ) ];
+
+	// frees the entries for the IRQ handler only after they have been copied
+	DataMemBarrier();
+	profileReadPos = r + n;
+
+	// the counter is only written by the IRQ handler
+	u32 dropped = profileDropped - profileDroppedReported;
+	profileDroppedReported += dropped;
+
+	PROFILE_HEADER *h = (PROFILE_HEADER*)buffer;
+	memset( h, 0, sizeof( PROFILE_HEADER ) );
+	h->magic = PROFILE_MAGIC;
+	h->version = PROFILE_VERSION;
+	h->flags = dropped ? PROFILE_FLAG_DROPPED : 0;
+	h->rate = profileCurRate;
+	h->nSamples = n;
+	h->nDropped = dropped;
+
+	return sizeof( PROFILE_HEADER ) + n * sizeof( PROFILE_SAMPLE );
+}
+
+void profileSave( CLogger *logger )
+{
+	if ( profileBuffer == NULL || profileSamplesAvailable() == 0 )
+		return;
+
+	u32 size = sizeof( PROFILE_HEADER ) + PROFILE_SAMPLES * sizeof( PROFILE_SAMPLE );
+	u8 *data = new u8[ size ];
+	size = profileRead( data, size );
+
+	// first unused file name
+	char filename[ 64 ];
+	u32 fsize;
+	for ( u32 i = 0; i < 1000; i++ )
+	{
+		sprintf( filename, "SD:PROFILE/prof%03d.skp", i );
+		if ( !getFileSize( logger, DRIVE, filename, &fsize ) )
+			break;
+	}
+
+	if ( writeFile( logger, DRIVE, filename, data, size ) )
+		logger->Write( "Profiler", LogNotice, "saved %s (%d samples at %d Hz)", filename, ( size - sizeof( PROFILE_HEADER ) ) / sizeof( PROFILE_SAMPLE ), profileCurRate ); else
+		logger->Write( "Profiler", LogNotice, "could not save %s", filename );
+
+	delete [] data;
+}
@@ -0,0 +1,110 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ profiler.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - statistical sampling profiler for the main loops
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _profiler_h
+#define _profiler_h
+
+#include <circle/types.h>
+
+//
+// Statistical sampling profiler for the main loops (not the FIQ handlers)
+//
+// The system timer (compare register C1) raises an IRQ at the sampling rate, its handler records the address 
+// at which the main loop was interrupted together with the context set by the loop (menu, network, SID kernel, ...).
+// The samples go into a ring buffer (single producer: the IRQ handler, single consumer: profileRead) and are
+// either fetched through the web server (/api/profile) or written to SD:PROFILE/ when a kernel returns to the menu
+// (PROFILE <rate in Hz> in the config file). Profiler/skprof turns them into a flame graph using the kernel's ELF.
+//
+// When the profiler is stopped the timer IRQ is not connected, all that remains are the stores of the context.
+//
+// Code running with IRQs disabled cannot be sampled: the IRQ is taken when they are enabled again. Such samples 
+// are marked with PROFILE_DELAYED (the IRQ came more than half an interval late), their address is not meaningful.
+//
+#define PROFILE_MAGIC		0x46504b53		// "SKPF"
+#define PROFILE_VERSION		1
+
+#define PROFILE_SAMPLES		65536			// size of the ring buffer, power of 2
+#define PROFILE_RATE_MIN	10
+#define PROFILE_RATE_MAX	10000			// the system timer counts microseconds
+
+#define PROFILE_CTX_MENU	0
+#define PROFILE_CTX_NET		1
+#define PROFILE_CTX_SID		2
+#define PROFILE_CTX_KERNEL	3				// any other kernel launched from the menu
+#define PROFILE_CONTEXTS	4
+
+#define PROFILE_DELAYED		0x80000000		// flag in PROFILE_SAMPLE.context
+
+const char profileContextName[ PROFILE_CONTEXTS ][ 8 ] = { "menu", "net", "sid", "kernel" };
+
+#define PROFILE_FLAG_DROPPED	1			// the ring buffer ran full, samples were lost
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 flags;
+	u32 rate;					// samples per second
+	u32 nSamples;
+	u32 nDropped;
+	u32 reserved[ 3 ];
+} __attribute__((packed)) PROFILE_HEADER;
+
+typedef struct
+{
+	u32 pc;						// the kernel is linked below 4 GB
+	u32 context;
+} __attribute__((packed)) PROFILE_SAMPLE;
+
+class CInterruptSystem;
+class CLogger;
+
+extern volatile u32 profileContext;
+
+// sampling rate from the config file (0 = off)
+extern u32 profileRate;
+
+static inline void profileSetContext( u32 context )
+{
+	profileContext = context;
+}
+
+extern void profileInit( CInterruptSystem *pInterrupt );
+extern boolean profileStart( u32 rate );
+extern void profileStop();
+extern boolean profileActive();
+extern u32  profileSamplesAvailable();
+
+// removes the samples from the ring buffer and stores them after a PROFILE_HEADER, returns the number of bytes written
+extern u32  profileRead( u8 *buffer, u32 size );
+
+// writes the samples collected so far to SD:PROFILE/profXXX.skp (if there are any)
+extern void profileSave( CLogger *logger );
+
+#endif
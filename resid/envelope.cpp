@@ -202,7 +202,7 @@ void EnvelopeGenerator::reset()
   new_exponential_counter_period = 0;
   reset_rate_counter = false;
 
-  state = RELEASE;
+  state = next_state = RELEASE;
   rate_period = rate_counter_period[release];
   hold_zero = false;
 }
@@ -62,4 +62,25 @@ void ExternalFilter::reset()
   Vhp = 0;
 }
 
+
+// ----------------------------------------------------------------------------
+// Check for a fixpoint of the filter state.
+// clock() integrates in steps of 1 to 8 cycles. A state which is not changed
+// by a single step of any of these sizes is kept by any sequence of steps.
+// ----------------------------------------------------------------------------
+bool ExternalFilter::is_settled(short Vi)
+{
+  int lp = Vlp, hp = Vhp;
+  bool settled = true;
+
+  for (cycle_count delta_t = 1; delta_t <= 8 && settled; delta_t++) {
+    clock(delta_t, Vi);
+    settled = Vlp == lp && Vhp == hp;
+    Vlp = lp;
+    Vhp = hp;
+  }
+
+  return settled;
+}
+
 } // namespace reSID
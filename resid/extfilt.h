@@ -52,6 +52,10 @@ public:
   // Audio output (16 bits).
   short output();
 
+  // Whether clocking with a constant input would leave the filter unchanged
+  // (used by the idle fast path of SID::clock()).
+  bool is_settled(short Vi);
+
 protected:
   // Filter enabled.
   bool enabled;
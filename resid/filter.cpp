@@ -28,6 +28,7 @@
 #include "dac.h"
 #include "spline.h"
 #include <math.h>
+#include <string.h>
 //#include "summer.h"
 //#include "mixer.h"
 
@@ -227,11 +228,12 @@ static model_filter_init_t model_filter_init[2] = {
   }
 };
 
-unsigned short Filter::resonance[16][1 << 16];
+unsigned short Filter::resonance[16][RESID_FILTER_TABLE_SIZE(1 << 16)];
 unsigned short Filter::vcr_kVg[1 << 16];
 unsigned short Filter::vcr_n_Ids_term[1 << 16];
 int Filter::n_snake;
 int Filter::n_param;
+bool Filter::class_init = false;
 
 #if defined(__amiga__) && defined(__mc68000__)
 #undef HAS_LOG1P
@@ -258,9 +260,53 @@ Filter::~Filter()
 // ----------------------------------------------------------------------------
 Filter::Filter()
 {
-  //static bool class_init = 0;
+  if (!class_init) {
+    build_tables();
+  }
+
+  // 6581 DAC bias, 8580 DAC gate voltage; both are changed by
+  // adjust_filter_bias().
+  Vw_bias = 0;
+
+  model_filter_init_t& fi = model_filter_init[1];
+  double Vgt = fi.k * ((4.75 * 1.6) - fi.Vth);
+  kVgt = (int)(model_filter[1].vo_N16 * (Vgt - fi.opamp_voltage[0][0]) + 0.5);
+
+  enable_filter(true);
+  set_chip_model(MOS6581);
+  set_voice_mask(0x07);
+  input(0);
+  reset();
+}
 
-  //if (!class_init) 
+
+// ----------------------------------------------------------------------------
+// With compact tables only every (1 << RESID_FILTER_TABLE_SHIFT)th value is
+// computed, i.e. the loops below step over the table index in these units.
+// The entry following the last one is a copy of it, lookup() interpolates
+// towards it.
+// ----------------------------------------------------------------------------
+static const int table_step = 1 << RESID_FILTER_TABLE_SHIFT;
+
+static inline int table_first(int offset)
+{
+  return (offset + table_step - 1) & ~(table_step - 1);
+}
+
+static inline void table_end(unsigned short* t, int n)
+{
+#if RESID_FILTER_TABLE_SHIFT
+  t[((n - 1) >> RESID_FILTER_TABLE_SHIFT) + 1] = t[(n - 1) >> RESID_FILTER_TABLE_SHIFT];
+#endif
+}
+
+
+// ----------------------------------------------------------------------------
+// Compute the lookup tables shared by all instances (several seconds on a
+// Raspberry Pi, done once).
+// ----------------------------------------------------------------------------
+void Filter::build_tables()
+{
   {
     double tmp_n_param[2];
 
@@ -374,9 +420,10 @@ Filter::Filter()
       for (int n8 = 0; n8 < 16; n8++) {
         int n = n8 << 4;  // Scaled by 2^7
         int x = mf.ak;
-        for (int vi = 0; vi < (1 << 16); vi++) {
-          mf.gain[n8][vi] = solve_gain(opamp, n, vi, x, mf);
+        for (int vi = 0; vi < (1 << 16); vi += table_step) {
+          mf.gain[n8][vi >> RESID_FILTER_TABLE_SHIFT] = solve_gain(opamp, n, vi, x, mf);
         }
+        table_end(mf.gain[n8], 1 << 16);
       }
 
       //mf.summer = new unsigned short[ 1310720 ];
@@ -396,12 +443,13 @@ Filter::Filter()
         int n_idiv = idiv << 7;  // n*idiv, scaled by 2^7
         size = idiv << 16;
         int x = mf.ak;
-        for (int vi = 0; vi < size; vi++) {
-          mf.summer[offset + vi] =
+        for (int vi = table_first(offset) - offset; vi < size; vi += table_step) {
+          mf.summer[(offset + vi) >> RESID_FILTER_TABLE_SHIFT] =
             solve_gain(opamp, n_idiv, vi/idiv, x, mf);
         }
         offset += size;
       }
+      table_end(mf.summer, summer_offset<5>::value);
 
       // The audio mixer operates at n ~ 8/6, and has 8 fundamentally different
       // input configurations (0 - 7 input "resistors").
@@ -419,15 +467,16 @@ Filter::Filter()
           idiv = 1;
         }
         int x = mf.ak;
-        for (int vi = 0; vi < size; vi++) 
+        for (int vi = table_first(offset) - offset; vi < size; vi += table_step) 
         //if ( (offset + vi) < 1835009 )
         {
-          mf.mixer[offset + vi] = 
+          mf.mixer[(offset + vi) >> RESID_FILTER_TABLE_SHIFT] = 
             solve_gain(opamp, n_idiv, vi/idiv, x, mf);
         }
         offset += size;
         size = (l + 1) << 16;
       }
+      table_end(mf.mixer, mixer_offset<8>::value);
 
       // Create lookup table mapping capacitor voltage to op-amp input voltage:
       // vc -> vx
@@ -448,20 +497,17 @@ Filter::Filter()
       // 8580 only
       for (int n8 = 0; n8 < 16; n8++) {
         int x = model_filter[1].ak;
-        for (int vi = 0; vi < (1 << 16); vi++) {
-          resonance[n8][vi] = solve_gain(opamp, resGain[n8], vi, x, model_filter[1]);
+        for (int vi = 0; vi < (1 << 16); vi += table_step) {
+          resonance[n8][vi >> RESID_FILTER_TABLE_SHIFT] = solve_gain(opamp, resGain[n8], vi, x, model_filter[1]);
         }
+        table_end(resonance[n8], 1 << 16);
       }
 
       // scaled 5 bits
       n_param = (int)(tmp_n_param[1] * 32 + 0.5);
 
-      model_filter_init_t& fi = model_filter_init[1];
       model_filter_t& f = model_filter[1];
 
-      double Vgt = fi.k * ((4.75 * 1.6) - fi.Vth);
-      kVgt = (int)(f.vo_N16 * (Vgt - fi.opamp_voltage[0][0]) + 0.5);
-
       // DAC table.
       // W/L ratio for frequency DAC, bits are proportional.
       // scaled 5 bits
@@ -490,8 +536,6 @@ Filter::Filter()
       double N16 = f.vo_N16;
       double vmin = fi.opamp_voltage[0][0];
 
-      Vw_bias = 0;
-
       // Normalized snake current factor, 1 cycle at 1MHz.
       // Fit in 5 bits.
       n_snake = (int)(fi.WL_snake * tmp_n_param[0] + 0.5);
@@ -545,14 +589,92 @@ Filter::Filter()
       }
     }
 
-    //class_init = true;
+    class_init = true;
   }
+}
 
-  enable_filter(true);
-  set_chip_model(MOS6581);
-  set_voice_mask(0x07);
-  input(0);
-  reset();
+
+// ----------------------------------------------------------------------------
+// Save/load the lookup tables, e.g. to a file which is loaded instead of
+// computing the tables at the next start. The data is only valid for the
+// same build of reSID (table layout and resolution are checked).
+// ----------------------------------------------------------------------------
+typedef struct {
+  unsigned int magic;
+  unsigned int size;
+  unsigned int shift;
+  unsigned int checksum;
+} tables_header_t;
+
+static const unsigned int tables_magic = 0x544c4652;  // "RFLT"
+
+static unsigned int tables_checksum(const unsigned char* p, unsigned int size)
+{
+  unsigned int a = 1, b = 0;
+  for (unsigned int i = 0; i < size; i++) {
+    a = (a + p[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+#define FOR_EACH_TABLE(op) \
+  op(model_filter); op(resonance); op(vcr_kVg); op(vcr_n_Ids_term); \
+  op(n_snake); op(n_param)
+
+bool Filter::tables_ready()
+{
+  return class_init;
+}
+
+unsigned int Filter::tables_size()
+{
+  unsigned int size = sizeof(tables_header_t);
+#define ADD_SIZE(t) size += sizeof(t)
+  FOR_EACH_TABLE(ADD_SIZE);
+#undef ADD_SIZE
+  return size;
+}
+
+bool Filter::save_tables(void* buf, unsigned int size)
+{
+  if (!class_init || size < tables_size()) {
+    return false;
+  }
+
+  unsigned char* p = (unsigned char*)buf + sizeof(tables_header_t);
+#define SAVE(t) memcpy(p, &t, sizeof(t)); p += sizeof(t)
+  FOR_EACH_TABLE(SAVE);
+#undef SAVE
+
+  tables_header_t h;
+  h.magic = tables_magic;
+  h.size = tables_size();
+  h.shift = RESID_FILTER_TABLE_SHIFT;
+  h.checksum = tables_checksum((unsigned char*)buf + sizeof(h), h.size - sizeof(h));
+  memcpy(buf, &h, sizeof(h));
+  return true;
+}
+
+bool Filter::load_tables(const void* buf, unsigned int size)
+{
+  tables_header_t h;
+  if (size != tables_size()) {
+    return false;
+  }
+  memcpy(&h, buf, sizeof(h));
+  if (h.magic != tables_magic || h.size != size || h.shift != RESID_FILTER_TABLE_SHIFT ||
+      h.checksum != tables_checksum((const unsigned char*)buf + sizeof(h), size - sizeof(h))) {
+    return false;
+  }
+
+  const unsigned char* p = (const unsigned char*)buf + sizeof(h);
+#define LOAD(t) memcpy(&t, p, sizeof(t)); p += sizeof(t)
+  FOR_EACH_TABLE(LOAD);
+#undef LOAD
+
+  class_init = true;
+  return true;
 }
 
 
@@ -615,6 +737,46 @@ void Filter::set_voice_mask(reg4 mask)
 }
 
 
+// ----------------------------------------------------------------------------
+// Check for a settled filter state.
+// clock() integrates in steps of 1 to 3 cycles. The filter is settled if a
+// single step of any of these sizes leaves all voltages unchanged and only
+// charges the integrator capacitors by a constant amount per cycle (0 for an
+// exact fixpoint). Such a state is kept by any sequence of steps until vc >> 14
+// changes (see clock_settled()), i.e. the filter can be skipped until then, or
+// until the inputs or the registers change.
+// The MOS6581 integrators often never reach a fixpoint, they keep drifting
+// within one step of vc >> 14 and now and then toggle the lowest bits of the
+// outputs.
+// ----------------------------------------------------------------------------
+bool Filter::is_settled(int voice1, int voice2, int voice3)
+{
+  int hp = Vhp, bp = Vbp, bp_x = Vbp_x, bp_vc = Vbp_vc;
+  int lp = Vlp, lp_x = Vlp_x, lp_vc = Vlp_vc;
+  bool settled = true;
+
+  for (cycle_count delta_t = 1; delta_t <= 3 && settled; delta_t++) {
+    clock(delta_t, voice1, voice2, voice3);
+
+    if (delta_t == 1) {
+      dVbp_vc = Vbp_vc - bp_vc;
+      dVlp_vc = Vlp_vc - lp_vc;
+    }
+
+    settled = Vhp == hp && Vbp == bp && Vbp_x == bp_x &&
+      Vbp_vc - bp_vc == dVbp_vc*delta_t &&
+      Vlp == lp && Vlp_x == lp_x && Vlp_vc - lp_vc == dVlp_vc*delta_t &&
+      (Vbp_vc >> 14) == (bp_vc >> 14) && (Vlp_vc >> 14) == (lp_vc >> 14);
+
+    Vhp = hp;
+    Vbp = bp; Vbp_x = bp_x; Vbp_vc = bp_vc;
+    Vlp = lp; Vlp_x = lp_x; Vlp_vc = lp_vc;
+  }
+
+  return settled;
+}
+
+
 // ----------------------------------------------------------------------------
 // SID reset.
 // ----------------------------------------------------------------------------
@@ -629,6 +791,7 @@ void Filter::reset()
   Vhp = 0;
   Vbp = Vbp_x = Vbp_vc = 0;
   Vlp = Vlp_x = Vlp_vc = 0;
+  dVbp_vc = dVlp_vc = 0;
 
   set_w0();
   set_Q();
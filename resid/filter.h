@@ -521,6 +521,23 @@ struct mixer_offset<0>
   enum { value = 0 };
 };
 
+// Resolution of the op-amp gain, summer, mixer and resonance lookup tables.
+// These are indexed by 16 bit voltages and take up ~19MB. With
+// RESID_FILTER_COMPACT defined only every (1 << RESID_FILTER_TABLE_SHIFT)th
+// value is stored and the values in between are linearly interpolated, which
+// shrinks the tables of one chip model to a size that fits in the L2 cache.
+#ifdef RESID_FILTER_COMPACT
+#ifndef RESID_FILTER_TABLE_SHIFT
+#define RESID_FILTER_TABLE_SHIFT 4
+#endif
+// One extra entry for the interpolation at the end of the table.
+#define RESID_FILTER_TABLE_SIZE(n) ((((n) - 1) >> RESID_FILTER_TABLE_SHIFT) + 2)
+#else
+#undef RESID_FILTER_TABLE_SHIFT
+#define RESID_FILTER_TABLE_SHIFT 0
+#define RESID_FILTER_TABLE_SIZE(n) (n)
+#endif
+
 
 class Filter
 {
@@ -528,6 +545,14 @@ public:
   Filter();
   ~Filter();
 
+  // The lookup tables are shared by all instances and computed by the first
+  // constructor call, unless they have been loaded before.
+  static void build_tables();
+  static bool tables_ready();
+  static unsigned int tables_size();
+  static bool save_tables(void* buf, unsigned int size);
+  static bool load_tables(const void* buf, unsigned int size);
+
   void enable_filter(bool enable);
   void adjust_filter_bias(double dac_bias);
   void set_chip_model(chip_model model);
@@ -549,6 +574,12 @@ public:
   // SID audio output (16 bits).
   short output();
 
+  // Whether clocking with constant voice outputs would leave the filter
+  // output unchanged (used by the idle fast path of SID::clock()).
+  bool is_settled(int voice1, int voice2, int voice3);
+  // Clocking of a settled filter, false if it has to be clocked normally.
+  bool clock_settled(cycle_count delta_t);
+
 protected:
 
   void set_sum_mix();
@@ -588,6 +619,8 @@ protected:
   int Vbp_x, Vbp_vc;
   int Vlp; // lowpass
   int Vlp_x, Vlp_vc;
+  // Change of the capacitor voltages per cycle of a settled filter.
+  int dVbp_vc, dVlp_vc;
   // Filter / mixer inputs.
   int ve;
   int v3;
@@ -614,9 +647,9 @@ protected:
     // Reverse op-amp transfer function.
     unsigned short opamp_rev[1 << 16];
     // Lookup tables for gain and summer op-amps in output stage / filter.
-    unsigned short summer[summer_offset<5>::value];
-    unsigned short gain[16][1 << 16];
-    unsigned short mixer[mixer_offset<8>::value];
+    unsigned short summer[RESID_FILTER_TABLE_SIZE(summer_offset<5>::value)];
+    unsigned short gain[16][RESID_FILTER_TABLE_SIZE(1 << 16)];
+    unsigned short mixer[RESID_FILTER_TABLE_SIZE(mixer_offset<8>::value)];
     // Cutoff frequency DAC output voltage table. FC is an 11 bit register.
     unsigned short f0_dac[1 << 11];
   } model_filter_t;
@@ -637,9 +670,11 @@ protected:
   int kVgt;
 
   // Lookup tables for resonance
-  static unsigned short resonance[16][1 << 16];
+  static unsigned short resonance[16][RESID_FILTER_TABLE_SIZE(1 << 16)];
 
-  int solve_gain(opamp_t* opamp, int n, int vi_t, int& x, model_filter_t& mf);
+  static int lookup(const unsigned short* table, int i);
+
+  static int solve_gain(opamp_t* opamp, int n, int vi_t, int& x, model_filter_t& mf);
   int solve_integrate_6581(int dt, int vi_t, int& x, int& vc, model_filter_t& mf);
   int solve_integrate_8580(int dt, int vi_t, int& x, int& vc, model_filter_t& mf);
 
@@ -649,6 +684,8 @@ protected:
   // Common parameters.
   static model_filter_t model_filter[2];
 
+  static bool class_init;
+
 friend class SID;
 };
 
@@ -661,6 +698,22 @@ friend class SID;
 
 #if RESID_INLINING || defined(RESID_FILTER_CC)
 
+// ----------------------------------------------------------------------------
+// Table lookup, interpolating between the stored values of compact tables.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+int Filter::lookup(const unsigned short* table, int i)
+{
+#if RESID_FILTER_TABLE_SHIFT
+  const unsigned short* t = &table[i >> RESID_FILTER_TABLE_SHIFT];
+  int frac = i & ((1 << RESID_FILTER_TABLE_SHIFT) - 1);
+  return t[0] + (((t[1] - t[0])*frac) >> RESID_FILTER_TABLE_SHIFT);
+#else
+  return table[i];
+#endif
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking - 1 cycle.
 // ----------------------------------------------------------------------------
@@ -749,13 +802,13 @@ void Filter::clock(int voice1, int voice2, int voice3)
     // MOS 6581.
     Vlp = solve_integrate_6581(1, Vbp, Vlp_x, Vlp_vc, f);
     Vbp = solve_integrate_6581(1, Vhp, Vbp_x, Vbp_vc, f);
-    Vhp = f.summer[offset + f.gain[_8_div_Q][Vbp] + Vlp + Vi];
+    Vhp = lookup(f.summer, offset + lookup(f.gain[_8_div_Q], Vbp) + Vlp + Vi);
   }
   else {
     // MOS 8580.
     Vlp = solve_integrate_8580(1, Vbp, Vlp_x, Vlp_vc, f);
     Vbp = solve_integrate_8580(1, Vhp, Vbp_x, Vbp_vc, f);
-    Vhp = f.summer[offset + resonance[res][Vbp] + Vlp + Vi];
+    Vhp = lookup(f.summer, offset + lookup(resonance[res], Vbp) + Vlp + Vi);
   }
 }
 
@@ -864,7 +917,7 @@ void Filter::clock(cycle_count delta_t, int voice1, int voice2, int voice3)
       // Calculate filter outputs.
       Vlp = solve_integrate_6581(delta_t_flt, Vbp, Vlp_x, Vlp_vc, f);
       Vbp = solve_integrate_6581(delta_t_flt, Vhp, Vbp_x, Vbp_vc, f);
-      Vhp = f.summer[offset + f.gain[_8_div_Q][Vbp] + Vlp + Vi];
+      Vhp = lookup(f.summer, offset + lookup(f.gain[_8_div_Q], Vbp) + Vlp + Vi);
 
       delta_t -= delta_t_flt;
     }
@@ -879,7 +932,7 @@ void Filter::clock(cycle_count delta_t, int voice1, int voice2, int voice3)
       // Calculate filter outputs.
       Vlp = solve_integrate_8580(delta_t_flt, Vbp, Vlp_x, Vlp_vc, f);
       Vbp = solve_integrate_8580(delta_t_flt, Vhp, Vbp_x, Vbp_vc, f);
-      Vhp = f.summer[offset + resonance[res][Vbp] + Vlp + Vi];
+      Vhp = lookup(f.summer, offset + lookup(resonance[res], Vbp) + Vlp + Vi);
 
       delta_t -= delta_t_flt;
     }
@@ -887,6 +940,36 @@ void Filter::clock(cycle_count delta_t, int voice1, int voice2, int voice3)
 }
 
 
+// ----------------------------------------------------------------------------
+// SID clocking of a settled filter - delta_t cycles.
+// The integrator currents only depend on vi and vx, i.e. the capacitors keep
+// charging by the same amount per cycle until vc >> 14, from which vx and vo
+// are computed, changes. Up to then all voltages stay the same, and since
+// the charge is linear in dt the result does not depend on how clock() would
+// split delta_t.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+bool Filter::clock_settled(cycle_count delta_t)
+{
+  // |dV*_vc| < 1 << 14 (see is_settled()), long calls are only skipped at an
+  // exact fixpoint.
+  if (unlikely(delta_t >= (1 << 14))) {
+    return dVbp_vc == 0 && dVlp_vc == 0;
+  }
+
+  int bp_vc = (Vbp_vc & 0x3fff) + dVbp_vc*delta_t;
+  int lp_vc = (Vlp_vc & 0x3fff) + dVlp_vc*delta_t;
+
+  if (unlikely((unsigned)bp_vc > 0x3fff || (unsigned)lp_vc > 0x3fff)) {
+    return false;
+  }
+
+  Vbp_vc = (Vbp_vc & ~0x3fff) | bp_vc;
+  Vlp_vc = (Vlp_vc & ~0x3fff) | lp_vc;
+  return true;
+}
+
+
 // ----------------------------------------------------------------------------
 // SID audio input (16 bits).
 // ----------------------------------------------------------------------------
@@ -1454,7 +1537,7 @@ for my $mix (0..2**@i-1) {
   }
 
   // Sum the inputs in the mixer and run the mixer output through the gain.
-  return (short)(f.gain[vol][f.mixer[offset + Vi]] - (1 << 15));
+  return (short)(lookup(f.gain[vol], lookup(f.mixer, offset + Vi)) - (1 << 15));
 }
 
 
@@ -61,6 +61,13 @@ SID::SID()
 
   databus_ttl = 0;
 
+  idle_skip = true;
+  idle = false;
+  idle_check = 0;
+  for (int i = 0; i < 3; i++) {
+    idle_output[i] = 0;
+  }
+
   filter = new Filter();
 }
 
@@ -100,6 +107,7 @@ void SID::set_chip_model(chip_model model)
   }
 
   filter->set_chip_model(model);
+  idle = false;
 }
 
 
@@ -116,6 +124,8 @@ void SID::reset()
 
   bus_value = 0;
   bus_value_ttl = 0;
+
+  idle = false;
 }
 
 
@@ -128,6 +138,7 @@ void SID::input(short sample)
 {
   // The input can be used to simulate the MOS8580 "digi boost" hardware hack.
   filter->input(sample);
+  idle = false;
 }
 
 
@@ -200,6 +211,9 @@ void SID::write(reg8 offset, reg8 value)
 // ----------------------------------------------------------------------------
 void SID::write()
 {
+  // Any register may change the voice outputs or the filter parameters.
+  idle = false;
+
   switch (write_address) {
   case 0x00:
     voice[0].wave.writeFREQ_LO(bus_value);
@@ -422,6 +436,8 @@ void SID::write_state(const State& state)
     voice[i].envelope.hold_zero = state.hold_zero[i];
     voice[i].envelope.envelope_pipeline = state.envelope_pipeline[i];
   }
+
+  idle = false;
 }
 
 
@@ -433,6 +449,7 @@ void SID::write_state(const State& state)
 void SID::set_voice_mask(reg4 mask)
 {
   filter->set_voice_mask(mask);
+  idle = false;
 }
 
 
@@ -442,6 +459,7 @@ void SID::set_voice_mask(reg4 mask)
 void SID::enable_filter(bool enable)
 {
   filter->enable_filter(enable);
+  idle = false;
 }
 
 
@@ -453,6 +471,7 @@ void SID::enable_filter(bool enable)
 // ----------------------------------------------------------------------------
 void SID::adjust_filter_bias(double dac_bias) {
   filter->adjust_filter_bias(dac_bias);
+  idle = false;
 }
 
 
@@ -462,6 +481,22 @@ void SID::adjust_filter_bias(double dac_bias) {
 void SID::enable_external_filter(bool enable)
 {
   extfilt.enable_filter(enable);
+  idle = false;
+}
+
+
+// ----------------------------------------------------------------------------
+// Enable the idle fast path of clock(delta_t).
+// A SID whose voices are silent (or otherwise constant) and whose filters
+// have settled produces a constant output, the filters are then skipped until
+// the next register write. The oscillators and envelopes are always clocked,
+// i.e. the output is bit-identical with or without the fast path.
+// ----------------------------------------------------------------------------
+void SID::enable_idle_skip(bool enable)
+{
+  idle_skip = enable;
+  idle = false;
+  idle_check = 0;
 }
 
 
@@ -751,11 +786,45 @@ void SID::clock(cycle_count delta_t)
     voice[i].wave.set_waveform_output(delta_t);
   }
 
+  int voice1 = voice[0].output();
+  int voice2 = voice[1].output();
+  int voice3 = voice[2].output();
+
+  // Settled filters with unchanged inputs keep their output.
+  if (idle) {
+    if (likely(voice1 == idle_output[0] && voice2 == idle_output[1] &&
+               voice3 == idle_output[2] && filter->clock_settled(delta_t))) {
+      return;
+    }
+    idle = false;
+    // A drifting MOS6581 integrator reached the next step, check again soon.
+    idle_check = 1024 - 32;
+  }
+
   // Clock filter.
-  filter->clock(delta_t, voice[0].output(), voice[1].output(), voice[2].output());
+  filter->clock(delta_t, voice1, voice2, voice3);
 
   // Clock external filter.
   extfilt.clock(delta_t, filter->output());
+
+  if (!idle_skip) {
+    return;
+  }
+
+  // Check for settled filters once the voice outputs have been constant for
+  // a while (the check costs about as much as clocking 30 cycles).
+  if (voice1 != idle_output[0] || voice2 != idle_output[1] ||
+      voice3 != idle_output[2]) {
+    idle_output[0] = voice1;
+    idle_output[1] = voice2;
+    idle_output[2] = voice3;
+    idle_check = 0;
+  }
+  else if ((idle_check += delta_t) >= 1024) {
+    idle_check = 0;
+    idle = filter->is_settled(voice1, voice2, voice3) &&
+      extfilt.is_settled(filter->output());
+  }
 }
 
 
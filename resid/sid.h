@@ -42,6 +42,7 @@ public:
   void enable_filter(bool enable);
   void adjust_filter_bias(double dac_bias);
   void enable_external_filter(bool enable);
+  void enable_idle_skip(bool enable);
   bool set_sampling_parameters(double clock_freq, sampling_method method,
   double sample_freq, double pass_freq = -1,
   double filter_scale = 0.97);
@@ -127,6 +128,13 @@ public:
   cycle_count write_pipeline;
   reg8 write_address;
 
+  // Idle fast path of clock(delta_t): the filter and the external filter are
+  // skipped while the voice outputs stay the same and both filters are settled.
+  bool idle_skip;
+  bool idle;
+  int idle_output[3];
+  cycle_count idle_check;
+
   double clock_frequency;
 
   enum {
@@ -227,6 +235,9 @@ void SID::clock()
     write();
   }
 
+  // The single cycle filters may leave the settled state.
+  idle = false;
+
   // Age bus value.
   if (unlikely(!--bus_value_ttl)) {
     bus_value = 0;
@@ -0,0 +1,335 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sdio.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - asynchronous file reading/writing
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sdio.h"
+#include "lowlevel_arm64.h"
+#include <circle/util.h>
+
+typedef struct
+{
+	char	filename[ 1024 ];
+	u32		write;
+	u32		offset, size, transferred;
+	u8		*data;
+	s32		buffer;			// buffer from the pool owned by the request, or -1
+	u32		seq;			// requests are worked on in this order
+	u32		state;
+} SDIO_REQUEST;
+
+static SDIO_REQUEST request[ SDIO_REQUESTS ];
+static u32 seqCounter = 0;
+
+static u8  bufferPool[ SDIO_BUFFERS ][ SDIO_BUFFER_SIZE ] AAA;
+static u32 bufferUsed[ SDIO_BUFFERS ];
+
+// the file of the last request stays open while there are more requests
+static u32  fileOpen = 0, fileWrite;
+static char fileName[ 1024 ];
+
+static s32 allocBuffer()
+{
+	for ( s32 i = 0; i < SDIO_BUFFERS; i++ )
+		if ( !bufferUsed[ i ] )
+		{
+			bufferUsed[ i ] = 1;
+			return i;
+		}
+	return -1;
+}
+
+static s32 submit( const char *FILENAME, u32 write, u32 offset, u32 size, u8 *data )
+{
+	if ( strlen( FILENAME ) >= 1024 )
+		return -1;
+
+	for ( s32 i = 0; i < SDIO_REQUESTS; i++ )
+	{
+		SDIO_REQUEST *r = &request[ i ];
+
+		if ( r->state != SDIO_FREE )
+			continue;
+
+		r->buffer = -1;
+		if ( data == NULL )
+		{
+			if ( size > SDIO_BUFFER_SIZE || ( r->buffer = allocBuffer() ) < 0 )
+				return -1;
+			data = bufferPool[ r->buffer ];
+		}
+
+		strcpy( r->filename, FILENAME );
+		r->write = write;
+		r->offset = offset;
+		r->size = size;
+		r->transferred = 0;
+		r->data = data;
+		r->seq = seqCounter ++;
+		r->state = size ? SDIO_QUEUED : SDIO_DONE;
+		return i;
+	}
+
+	return -1;
+}
+
+s32 sdioRead( const char *FILENAME, u32 offset, u32 size, u8 *data )
+{
+	return submit( FILENAME, 0, offset, size, data );
+}
+
+s32 sdioWrite( const char *FILENAME, u32 offset, u32 size, const u8 *data )
+{
+	return submit( FILENAME, 1, offset, size, (u8*)data );
+}
+
+u32 sdioState( s32 req )
+{
+	return request[ req ].state;
+}
+
+u32 sdioBytes( s32 req )
+{
+	return request[ req ].transferred;
+}
+
+u8 *sdioData( s32 req )
+{
+	return request[ req ].data;
+}
+
+void sdioRelease( s32 req )
+{
+	if ( req < 0 )
+		return;
+
+	SDIO_REQUEST *r = &request[ req ];
+
+	if ( r->buffer >= 0 )
+		bufferUsed[ r->buffer ] = 0;
+
+	r->buffer = -1;
+	r->state = SDIO_FREE;
+}
+
+static void closeFile()
+{
+	if ( fileOpen )
+		sdioFsClose();
+	fileOpen = 0;
+}
+
+static int openFile( SDIO_REQUEST *r )
+{
+	// writing from offset 0 on truncates the file
+	u32 create = r->write && r->offset == 0 && r->transferred == 0;
+
+	if ( fileOpen && !create && fileWrite == r->write && strcmp( fileName, r->filename ) == 0 )
+		return 1;
+
+	closeFile();
+
+	if ( !sdioFsOpen( r->filename, r->write, create ) )
+		return 0;
+
+	fileOpen = 1;
+	fileWrite = r->write;
+	strcpy( fileName, r->filename );
+	return 1;
+}
+
+static int transfer( SDIO_REQUEST *r, u32 size, u32 *bytes )
+{
+	if ( r->write )
+		return sdioFsWrite( r->offset + r->transferred, r->data + r->transferred, size, bytes );
+	return sdioFsRead( r->offset + r->transferred, r->data + r->transferred, size, bytes );
+}
+
+// transfers one chunk of a request
+static void step( SDIO_REQUEST *r )
+{
+	u32 size = r->size - r->transferred, bytes = 0;
+	if ( size > SDIO_CHUNK )
+		size = SDIO_CHUNK;
+
+	int res = openFile( r ) ? transfer( r, size, &bytes ) : SDIO_FS_ERROR;
+
+	if ( res == SDIO_FS_REOPEN )
+	{
+		fileOpen = 0;
+		res = openFile( r ) ? transfer( r, size, &bytes ) : SDIO_FS_ERROR;
+	}
+
+	if ( res != SDIO_FS_OK )
+	{
+		closeFile();
+		r->state = SDIO_FAILED;
+		return;
+	}
+
+	r->transferred += bytes;
+
+	if ( r->transferred == r->size || bytes < size )
+		r->state = SDIO_DONE;
+}
+
+static SDIO_REQUEST *oldestQueued()
+{
+	SDIO_REQUEST *o = NULL;
+
+	for ( u32 i = 0; i < SDIO_REQUESTS; i++ )
+		if ( request[ i ].state == SDIO_QUEUED && ( o == NULL || (s32)( request[ i ].seq - o->seq ) < 0 ) )
+			o = &request[ i ];
+
+	return o;
+}
+
+u32 sdioPoll()
+{
+	SDIO_REQUEST *r = oldestQueued();
+
+	if ( r != NULL )
+		step( r );
+
+	if ( oldestQueued() != NULL )
+		return 1;
+
+	closeFile();
+	return 0;
+}
+
+u32 sdioWait( s32 req )
+{
+	SDIO_REQUEST *r = &request[ req ];
+
+	while ( r->state == SDIO_QUEUED )
+		step( r );
+
+	if ( oldestQueued() == NULL )
+		closeFile();
+
+	return r->state;
+}
+
+//
+// streams
+//
+int sdioStreamOpen( SDIO_STREAM *s, const char *FILENAME )
+{
+	if ( strlen( FILENAME ) >= 1024 || !sdioFsSize( FILENAME, &s->size ) )
+		return 0;
+
+	strcpy( s->filename, FILENAME );
+	s->pos = 0;
+
+	for ( u32 i = 0; i < SDIO_READAHEAD; i++ )
+		s->req[ i ] = s->block[ i ] = s->buffer[ i ] = -1;
+
+	for ( u32 i = 0; i < SDIO_READAHEAD; i++ )
+		if ( ( s->buffer[ i ] = allocBuffer() ) < 0 )
+		{
+			sdioStreamClose( s );
+			return 0;
+		}
+
+	sdioStreamSeek( s, 0 );
+	return 1;
+}
+
+// makes sure buffer i holds (or is going to hold) 'block'
+static void requestBlock( SDIO_STREAM *s, s32 block )
+{
+	u32 i = block % SDIO_READAHEAD;
+
+	if ( s->block[ i ] == block && s->req[ i ] >= 0 )
+		return;
+
+	sdioRelease( s->req[ i ] );
+	s->req[ i ] = -1;
+	s->block[ i ] = block;
+
+	u32 ofs = block * SDIO_BUFFER_SIZE;
+	if ( ofs < s->size )
+		s->req[ i ] = sdioRead( s->filename, ofs, SDIO_BUFFER_SIZE, bufferPool[ s->buffer[ i ] ] );
+}
+
+void sdioStreamSeek( SDIO_STREAM *s, u32 pos )
+{
+	s->pos = pos;
+
+	s32 first = pos / SDIO_BUFFER_SIZE;
+	for ( s32 b = first; b < first + SDIO_READAHEAD; b++ )
+		requestBlock( s, b );
+}
+
+u32 sdioStreamRead( SDIO_STREAM *s, u8 *data, u32 size )
+{
+	u32 total = 0;
+
+	while ( size > 0 && s->pos < s->size )
+	{
+		s32 block = s->pos / SDIO_BUFFER_SIZE;
+		u32 i = block % SDIO_READAHEAD;
+
+		requestBlock( s, block );
+		if ( s->req[ i ] < 0 || sdioWait( s->req[ i ] ) != SDIO_DONE )
+			break;
+
+		u32 ofs = s->pos - block * SDIO_BUFFER_SIZE;
+		u32 avail = sdioBytes( s->req[ i ] );
+		if ( ofs >= avail )
+			break;
+
+		u32 n = avail - ofs;
+		if ( n > size )
+			n = size;
+
+		memcpy( data, &bufferPool[ s->buffer[ i ] ][ ofs ], n );
+		data += n;
+		size -= n;
+		total += n;
+		s->pos += n;
+
+		// block consumed: its buffer is used for the block SDIO_READAHEAD blocks ahead
+		if ( s->pos == (u32)( block + 1 ) * SDIO_BUFFER_SIZE )
+			requestBlock( s, block + SDIO_READAHEAD );
+	}
+
+	return total;
+}
+
+void sdioStreamClose( SDIO_STREAM *s )
+{
+	for ( u32 i = 0; i < SDIO_READAHEAD; i++ )
+	{
+		sdioRelease( s->req[ i ] );
+		s->req[ i ] = -1;
+		if ( s->buffer[ i ] >= 0 )
+			bufferUsed[ s->buffer[ i ] ] = 0;
+		s->buffer[ i ] = -1;
+	}
+}
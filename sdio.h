@@ -0,0 +1,100 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sdio.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - asynchronous file reading/writing
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _sdio_h
+#define _sdio_h
+
+#include <circle/types.h>
+
+// Asynchronous reading/writing of files: requests are queued and worked on in chunks of SDIO_CHUNK bytes by sdioPoll
+// (called from the main loop when there is nothing else to do) in the order they have been submitted, or by sdioWait
+// if the data is needed right away. The file of the current request stays open between the chunks.
+#define SDIO_REQUESTS		16
+#define SDIO_CHUNK			( 32 * 1024 )
+
+// cache line aligned buffers for reads without destination and for streams
+#define SDIO_BUFFERS		8
+#define SDIO_BUFFER_SIZE	( 64 * 1024 )
+
+// number of blocks (of SDIO_BUFFER_SIZE bytes) a stream requests ahead of the read position
+#define SDIO_READAHEAD		3
+
+#define SDIO_FREE			0
+#define SDIO_QUEUED			1
+#define SDIO_DONE			2
+#define SDIO_FAILED			3
+
+// reads 'size' bytes from 'offset' on into 'data', or into a buffer from the pool if 'data' is NULL (then size <= SDIO_BUFFER_SIZE),
+// returns the request or -1 if all requests (or buffers) are in use
+extern s32  sdioRead( const char *FILENAME, u32 offset, u32 size, u8 *data = 0 );
+
+// writes 'size' bytes from 'offset' on, a write from offset 0 creates (or truncates) the file, 'data' must stay valid until the request is done
+extern s32  sdioWrite( const char *FILENAME, u32 offset, u32 size, const u8 *data );
+
+extern u32  sdioState( s32 req );
+extern u32  sdioBytes( s32 req );	// less than requested if the end of the file has been reached
+extern u8  *sdioData( s32 req );
+
+// works on 'req' (only) until it is done, returns SDIO_DONE or SDIO_FAILED
+extern u32  sdioWait( s32 req );
+
+// cancels 'req' if it is still queued and frees it (and its buffer)
+extern void sdioRelease( s32 req );
+
+// works one chunk on the oldest request, closes the file when there is nothing left to do, returns 1 if requests are queued
+extern u32  sdioPoll();
+
+// sequential reading: the stream keeps SDIO_READAHEAD blocks requested ahead of the read position
+typedef struct
+{
+	char	filename[ 1024 ];
+	u32		size, pos;
+	s32		buffer[ SDIO_READAHEAD ];
+	s32		req[ SDIO_READAHEAD ];
+	s32		block[ SDIO_READAHEAD ];	// block in buffer[ i ] (always block % SDIO_READAHEAD == i), or -1
+} SDIO_STREAM;
+
+// returns 0 if the file does not exist or there are not enough free buffers
+extern int  sdioStreamOpen( SDIO_STREAM *s, const char *FILENAME );
+extern u32  sdioStreamRead( SDIO_STREAM *s, u8 *data, u32 size );
+extern void sdioStreamSeek( SDIO_STREAM *s, u32 pos );
+extern void sdioStreamClose( SDIO_STREAM *s );
+
+// file system glue, sdiofs.cpp uses FatFs (the host tool in SDIOBench replaces it)
+#define SDIO_FS_OK			1
+#define SDIO_FS_ERROR		0
+#define SDIO_FS_REOPEN		-1	// the file has been closed by unmounting (other code accesses the SD card in between requests)
+
+extern int  sdioFsSize( const char *FILENAME, u32 *size );
+extern int  sdioFsOpen( const char *FILENAME, u32 write, u32 create );
+extern int  sdioFsRead( u32 offset, u8 *data, u32 size, u32 *bytes );
+extern int  sdioFsWrite( u32 offset, const u8 *data, u32 size, u32 *bytes );
+extern void sdioFsClose();
+
+#endif
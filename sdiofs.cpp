@@ -0,0 +1,128 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sdiofs.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - FatFs glue for asynchronous file reading/writing
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sdio.h"
+#include <SDCard/emmc.h>
+#include <fatfs/ff.h>
+
+// FatFs glue for sdio.cpp: the drive is mounted when needed, other code mounting and unmounting in between
+// requests invalidates the open file, which is then opened again (SDIO_FS_REOPEN)
+static const char DRIVE[] = "SD:";
+
+static FIL file;
+static u32 fileOpen = 0;
+
+#ifndef WITH_NET
+static FATFS fileSystem;
+static u32 mounted = 0;
+
+static int mount()
+{
+	if ( f_mount( &fileSystem, DRIVE, 1 ) != FR_OK )
+		return 0;
+	mounted = 1;
+	return 1;
+}
+#endif
+
+int sdioFsSize( const char *FILENAME, u32 *size )
+{
+	FILINFO info;
+	FRESULT res = f_stat( FILENAME, &info );
+
+#ifndef WITH_NET
+	if ( res == FR_NOT_ENABLED && mount() )
+		res = f_stat( FILENAME, &info );
+#endif
+
+	if ( res != FR_OK )
+		return 0;
+
+	*size = (u32)info.fsize;
+	return 1;
+}
+
+int sdioFsOpen( const char *FILENAME, u32 write, u32 create )
+{
+	BYTE mode = write ? ( FA_WRITE | ( create ? FA_CREATE_ALWAYS : FA_OPEN_ALWAYS ) ) : ( FA_READ | FA_OPEN_EXISTING );
+
+	FRESULT res = f_open( &file, FILENAME, mode );
+
+#ifndef WITH_NET
+	if ( res == FR_NOT_ENABLED && mount() )
+		res = f_open( &file, FILENAME, mode );
+#endif
+
+	fileOpen = res == FR_OK;
+	return fileOpen;
+}
+
+static int seek( u32 offset )
+{
+	if ( f_tell( &file ) == offset )
+		return FR_OK;
+	return f_lseek( &file, offset );
+}
+
+int sdioFsRead( u32 offset, u8 *data, u32 size, u32 *bytes )
+{
+	FRESULT res = (FRESULT)seek( offset );
+	if ( res == FR_OK )
+		res = f_read( &file, data, size, bytes );
+
+	if ( res == FR_INVALID_OBJECT )
+		return SDIO_FS_REOPEN;
+
+	return res == FR_OK ? SDIO_FS_OK : SDIO_FS_ERROR;
+}
+
+int sdioFsWrite( u32 offset, const u8 *data, u32 size, u32 *bytes )
+{
+	FRESULT res = (FRESULT)seek( offset );
+	if ( res == FR_OK )
+		res = f_write( &file, data, size, bytes );
+
+	if ( res == FR_INVALID_OBJECT )
+		return SDIO_FS_REOPEN;
+
+	return res == FR_OK && *bytes == size ? SDIO_FS_OK : SDIO_FS_ERROR;
+}
+
+void sdioFsClose()
+{
+	if ( fileOpen )
+		f_close( &file );
+	fileOpen = 0;
+
+#ifndef WITH_NET
+	if ( mounted )
+		f_mount( 0, DRIVE, 0 );
+	mounted = 0;
+#endif
+}
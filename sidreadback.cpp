@@ -0,0 +1,270 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sidreadback.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - run-ahead model of the SID voice 3 for exact OSC3/ENV3 read-back
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sidreadback.h"
+
+using namespace reSID;
+
+// the oscillators point to their sync source and destination
+void CSIDReadBack::linkModel( MODEL &m )
+{
+	m.voice[ 0 ].set_sync_source( &m.voice[ 2 ] );
+	m.voice[ 1 ].set_sync_source( &m.voice[ 0 ] );
+	m.voice[ 2 ].set_sync_source( &m.voice[ 1 ] );
+}
+
+void CSIDReadBack::copyModel( MODEL &d, const MODEL &s )
+{
+	d = s;
+	linkModel( d );
+}
+
+// one cycle as SID::clock(), only the envelope of voice 3 is needed
+void CSIDReadBack::clockModel( MODEL &m )
+{
+	m.voice[ 2 ].envelope.clock();
+
+	if ( m.coupling == 0 && ( m.outputs & 3 ) == 0 )
+	{
+		m.voice[ 2 ].wave.clock();
+		m.lag ++;
+	} else
+	{
+		for ( int i = 0; i < 3; i++ )
+			m.voice[ i ].wave.clock();
+		for ( int i = 0; i < 3; i++ )
+			m.voice[ i ].wave.synchronize();
+		for ( int i = 0; i < 2; i++ )
+			if ( m.outputs & ( 1 << i ) )
+				m.voice[ i ].wave.set_waveform_output();
+	}
+	m.voice[ 2 ].wave.set_waveform_output();
+
+	if ( m.pending )
+	{
+		m.pending = 0;
+		applyWrite( m, m.pendingReg, m.pendingValue );
+	}
+
+	m.cycle ++;
+}
+
+// voices 1 and 2 are not synced while they lag behind (see MODEL), multi-cycle clocking keeps their accumulators exact
+// (only the pipelines of the noise and pulse outputs are lost, which do not matter here)
+void CSIDReadBack::catchUp( MODEL &m )
+{
+	if ( m.lag )
+	{
+		m.voice[ 0 ].wave.clock( m.lag );
+		m.voice[ 1 ].wave.clock( m.lag );
+		m.lag = 0;
+	}
+}
+
+void CSIDReadBack::applyWrite( MODEL &m, u32 reg, u32 value )
+{
+	if ( reg > 0x14 )
+		return;
+
+	if ( reg < 0x0e || reg == 0x12 )
+		catchUp( m );
+
+	Voice &v = m.voice[ reg / 7 ];
+	switch ( reg % 7 )
+	{
+	case 0: v.wave.writeFREQ_LO( value ); break;
+	case 1: v.wave.writeFREQ_HI( value ); break;
+	case 2: v.wave.writePW_LO( value ); break;
+	case 3: v.wave.writePW_HI( value ); break;
+	case 4:
+		v.writeCONTROL_REG( value );
+		// sync of voices 1 and 2, sync and ring modulation of voice 3
+		m.coupling &= ~( 255 << ( reg / 7 * 8 ) );
+		m.coupling |= ( value & ( reg == 0x12 ? 0x06 : 0x02 ) ) << ( reg / 7 * 8 );
+		if ( m.mos6581 && ( value & 0x20 ) && ( value & 0xd0 ) )
+			m.outputs |= 1 << ( reg / 7 ); else
+			m.outputs &= ~( 1 << ( reg / 7 ) );
+		break;
+	case 5: v.envelope.writeATTACK_DECAY( value ); break;
+	case 6: v.envelope.writeSUSTAIN_RELEASE( value ); break;
+	}
+}
+
+// as SID::write(): on the MOS8580 the write takes effect with the next cycle, a 2nd write before replaces it
+void CSIDReadBack::writeModel( MODEL &m, u32 reg, u32 value )
+{
+	if ( pipelined )
+	{
+		m.pending = 1;
+		m.pendingReg = reg;
+		m.pendingValue = value;
+	} else
+		applyWrite( m, reg, value );
+}
+
+u16 CSIDReadBack::value( MODEL &m )
+{
+	return m.voice[ 2 ].wave.readOSC() | ( m.voice[ 2 ].envelope.readENV() << 8 );
+}
+
+void CSIDReadBack::init( chip_model model, u32 pipelinedWrites )
+{
+	MODEL &m = committed;
+
+	m.cycle = 0;
+	m.pending = 0;
+	m.mos6581 = model == MOS6581;
+	m.outputs = 0;
+	m.coupling = m.lag = 0;
+	for ( int j = 0; j < 25; j++ )
+		applyWrite( m, j, 0 );
+	for ( int i = 0; i < 3; i++ )
+		m.voice[ i ].set_chip_model( model );
+	linkModel( m );
+
+	pipelined = pipelinedWrites;
+	predWrites = ~0;
+	predFirst = predEnd = 0;
+	lastRead = 0;
+	copyModel( ahead, committed );
+	snapshotValid = 0;
+	dirty = 1;
+}
+
+void CSIDReadBack::reset()
+{
+	predEnd = predFirst;
+
+	// the time of the reset is not known exactly, continue from the latest prediction
+	if ( !dirty )
+		copyModel( committed, ahead );
+
+	for ( int j = 0; j < 25; j++ )
+		writeModel( committed, j, 0 );
+	committed.cycle = 0;
+
+	snapshotValid = 0;
+	dirty = 1;
+}
+
+// the first write (or the first idle run of the main loop) after a prediction: continue from the latest state of the
+// run-ahead model up to 'cycle', which is exact as there were no writes in between
+void CSIDReadBack::stopPrediction( u64 cycle )
+{
+	const MODEL *latest = 0;
+
+	if ( ahead.cycle <= cycle )
+		latest = &ahead; else
+	for ( int i = 0; i < READBACK_NSNAPSHOTS; i++ )
+		if ( ( snapshotValid & ( 1 << i ) ) && snapshot[ i ].cycle <= cycle &&
+			 ( latest == 0 || snapshot[ i ].cycle > latest->cycle ) )
+			latest = &snapshot[ i ];
+
+	if ( latest && latest->cycle > committed.cycle )
+		copyModel( committed, *latest );
+
+	dirty = 1;
+}
+
+void CSIDReadBack::write( u64 cycle, u32 reg, u32 value )
+{
+	if ( !dirty )
+		stopPrediction( cycle );
+
+	while ( committed.cycle < cycle )
+		clockModel( committed );
+
+	writeModel( committed, reg, value );
+}
+
+void CSIDReadBack::runAhead( u64 cycle, u32 nWrites )
+{
+	// no reads lately: follow the writes, the predictions restart with the next run after a read (the FIQ handler may
+	// have read after 'cycle' was taken, hence signed; lastRead is kept within reach against the wrap-around, a read
+	// overwritten here only delays the restart to the next read)
+	if ( (s32)( (u32)cycle - lastRead ) >= READBACK_IDLE )
+	{
+		lastRead = (u32)cycle - READBACK_IDLE;
+		predEnd = predFirst;
+		if ( !dirty )
+			stopPrediction( cycle );
+
+		while ( committed.cycle < cycle )
+			clockModel( committed );
+		return;
+	}
+
+	if ( dirty )
+	{
+		// invalid until the predictions are redone
+		predEnd = predFirst;
+
+		while ( committed.cycle < cycle )
+			clockModel( committed );
+
+		copyModel( ahead, committed );
+		snapshotValid = 0;
+		dirty = 0;
+		restartCycle = cycle;
+
+		*slot( ahead.cycle ) = value( ahead );
+		predFirst = (u32)ahead.cycle;
+		predEnd = predFirst;
+		predWrites = nWrites;
+	}
+
+	u64 target = cycle + READBACK_LEAD_MIN + ( cycle - restartCycle );
+	if ( target > cycle + READBACK_LEAD )
+		target = cycle + READBACK_LEAD;
+	if ( ahead.cycle >= target )
+	{
+		predWrites = nWrites;
+		return;
+	}
+
+	// the slots about to be overwritten are not valid anymore
+	if ( (u32)target - predFirst >= READBACK_SLOTS )
+		predFirst = (u32)target - READBACK_SLOTS + 1;
+
+	while ( ahead.cycle < target )
+	{
+		clockModel( ahead );
+		*slot( ahead.cycle ) = value( ahead );
+
+		if ( ( ahead.cycle & ( READBACK_SNAPSHOT - 1 ) ) == 0 )
+		{
+			u32 i = ( ahead.cycle / READBACK_SNAPSHOT ) % READBACK_NSNAPSHOTS;
+			copyModel( snapshot[ i ], ahead );
+			snapshotValid |= 1 << i;
+		}
+	}
+
+	predWrites = nWrites;
+	predEnd = (u32)ahead.cycle + 1;
+}
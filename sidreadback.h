@@ -0,0 +1,144 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sidreadback.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - run-ahead model of the SID voice 3 for exact OSC3/ENV3 read-back
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _sidreadback_h
+#define _sidreadback_h
+
+#include <circle/types.h>
+#include "resid/sid.h"
+
+//
+// Exact read-back of OSC3/ENV3 ($d41b/$d41c) in kernel_sid.cpp: the emulation loop only updates outRegisters after
+// each step, i.e. reads lag the C64 by up to a few hundred cycles. This model consists of the three oscillators and
+// the envelope of voice 3 (reSID's Voice, clocked cycle by cycle as SID::clock() does, without filters). The main loop
+// feeds it the register writes from the ring buffer and runs it ahead of the C64 cycle counter, storing the predicted
+// OSC3/ENV3 value of every cycle in a ring. The FIQ handler reads the entry of the current cycle without waiting.
+//
+// A prediction is only valid if no write to the registers of the model ($00-$14 of SID1) happened after it was made:
+// the FIQ handler counts these writes and compares its count with the one the predictions belong to, otherwise it
+// falls back to outRegisters. Other writes (filter and volume, SID2, OPL, MIDI) keep the predictions. The main loop
+// restarts the prediction from the last write with its next call. If the main loop is stalled for longer than
+// READBACK_LEAD cycles, the predictions run out as well.
+//
+// There is only one core available (the others are disabled), so the run-ahead is done by the main loop, which the
+// FIQ handler preempts. To keep the single-cycle clocking cheap, voices 1 and 2 are only clocked while voice 3 depends
+// on them (see MODEL), and there are no predictions while the C64 does not read OSC3/ENV3: after READBACK_IDLE cycles
+// without a read, the model only follows the writes until the next read (which is answered from outRegisters).
+// SIDReplay/readbackbench compares the model with reSID clocked cycle by cycle and reports the time of both (medians
+// on the host): while predicting, the model costs 13-17 ns per C64 cycle (27 ns if voice 3 is synced or ring
+// modulated), while following the writes 10-14 ns, against 4-14 ns of the whole SID emulation of the main loop. The
+// main loop has this much less headroom, hence the model is off unless SID_EXACT_READBACK is set in the config file.
+//
+
+#define READBACK_SLOTS		4096		// predicted cycles in the ring (power of 2)
+#define READBACK_LEAD		3072		// cycles predicted ahead of the C64 (less than READBACK_SLOTS)
+#define READBACK_LEAD_MIN	512			// right after a write, growing by one per cycle up to READBACK_LEAD
+#define READBACK_SNAPSHOT	256			// distance of the snapshots of the run-ahead model (power of 2)
+#define READBACK_NSNAPSHOTS	16			// covering at least READBACK_LEAD cycles
+#define READBACK_IDLE		100000		// no predictions if OSC3/ENV3 have not been read for this many cycles (5 frames)
+
+class CSIDReadBack
+{
+public:
+	// the model is set up as a new reSID instance after the 25 register writes of 0 in initSID() of kernel_sid.cpp,
+	// 'pipelinedWrites' as SID::write() with SAMPLE_FAST does it on the MOS8580
+	void init( reSID::chip_model model, u32 pipelinedWrites );
+
+	// C64 reset: registers are set to 0 as in kernel_sid.cpp, the cycle counter restarts at 0
+	void reset();
+
+	// main loop: a register write of the C64 at 'cycle' (in the order of the ring buffer)
+	void write( u64 cycle, u32 reg, u32 value );
+
+	// main loop: all writes up to 'cycle' have been passed by write(), 'nWrites' of them to registers $00-$14
+	// (predicts the next cycles, or only clocks the model up to 'cycle' if there was no read for READBACK_IDLE cycles)
+	void runAhead( u64 cycle, u32 nWrites );
+
+	// FIQ handler: returns 1 and the predicted value of $d41b/$d41c in D if there is a valid prediction for 'cycle',
+	// 'nWrites' is the number of writes to registers $00-$14 captured so far
+	inline u32 read( u64 cycle, u32 nWrites, u32 reg, u32 *D )
+	{
+		lastRead = (u32)cycle;
+		if ( nWrites != predWrites || (u32)cycle - predFirst >= predEnd - predFirst )
+			return 0;
+		u32 v = pred[ cycle & ( READBACK_SLOTS - 1 ) ];
+		*D = ( reg == 0x1b ) ? ( v & 255 ) : ( v >> 8 );
+		return 1;
+	}
+
+	inline u16 *slot( u64 cycle )
+	{
+		return &pred[ cycle & ( READBACK_SLOTS - 1 ) ];
+	}
+
+private:
+	typedef struct
+	{
+		reSID::Voice voice[ 3 ];
+		u64 cycle;
+		u32 pending, pendingReg, pendingValue;
+		// voices 1 and 2 only matter through their accumulators, which only depend on their waveform outputs with the
+		// combined sawtooth waveforms of the MOS6581: bit i is set if the output of voice i+1 is computed
+		u32 mos6581, outputs;
+		// sync and ring modulation bits of the control registers: without any of them (and without 'outputs') voice 3
+		// does not depend on voices 1 and 2, these are then not clocked for 'lag' cycles and caught up with the next
+		// write to their registers or to the control register of voice 3
+		u32 coupling, lag;
+	} MODEL;
+
+	static void linkModel( MODEL &m );
+	static void copyModel( MODEL &d, const MODEL &s );
+	static void clockModel( MODEL &m );
+	static void catchUp( MODEL &m );
+	static void applyWrite( MODEL &m, u32 reg, u32 value );
+	void writeModel( MODEL &m, u32 reg, u32 value );
+	void stopPrediction( u64 cycle );
+	static u16 value( MODEL &m );
+
+	// 'committed' includes all writes passed so far, 'ahead' runs ahead of it without writes
+	MODEL committed, ahead;
+	u32 dirty, pipelined;
+	// cycle at which 'ahead' was restarted after the last write (the predictions are wasted at the next write)
+	u64 restartCycle;
+
+	// snapshots of 'ahead' (exact as long as there are no new writes), to catch up with the next write quickly
+	MODEL snapshot[ READBACK_NSNAPSHOTS ];
+	u32 snapshotValid;
+
+	// predictions for the cycles predFirst..predEnd-1 (lower 32 bits, the FIQ handler reads them in one access) and the
+	// number of writes they include
+	volatile u32 predFirst, predEnd;
+	volatile u32 predWrites;
+	u16 pred[ READBACK_SLOTS ];
+
+	// cycle of the last read of OSC3/ENV3 (lower 32 bits, written by the FIQ handler)
+	volatile u32 lastRead;
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sidrec.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - recording format of the SID register write stream
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _sidrec_h
+#define _sidrec_h
+
+#include <circle/types.h>
+
+//
+// Recording format for the SID/OPL/MIDI register write stream as seen by kernel_sid.cpp
+// (written to SD:SIDREC/ when SID_RECORD is enabled in the config file, replayed by SIDReplay/sidreplay)
+//
+// A file consists of a SIDREC_HEADER followed by events. Each event is
+//   - the number of C64 cycles since the previous event as an unsigned LEB128 number
+//   - a tag byte: event type in bits 5..7, register (address & 31) in bits 0..4
+//   - one data byte (SID1, SID2, OPL), two bytes (SIDN: data, number of the SID) or three bytes (MIDI: command,
+//     data 1, data 2)
+// SIDREC_RESET has no data: all chips are reset as done by the kernel when the C64 reset is released.
+// SIDREC_SIDN addresses one of up to 8 SIDs (as in kernel_sid8.cpp), SID1/SID2 are the two SIDs of kernel_sid.cpp.
+//
+// The events are recorded as they arrive: whether SID2 writes go to the 2nd SID, are ignored or
+// also go to SID1 is decided by the configuration stored in the header (same logic as the kernel).
+//
+#define SIDREC_MAGIC		0x52534b53		// "SKSR"
+#define SIDREC_VERSION		1
+
+#define SIDREC_SID1			0
+#define SIDREC_SID2			1
+#define SIDREC_OPL			2
+#define SIDREC_MIDI			3
+#define SIDREC_RESET		4
+#define SIDREC_SIDN			5		// data: byte written | ( number of the SID << 8 )
+
+#define SIDREC_FLAG_OPL				1
+#define SIDREC_FLAG_SID2_DISABLED	2
+#define SIDREC_FLAG_SID2_SAME		4
+#define SIDREC_FLAG_MIDI			8
+#define SIDREC_FLAG_TRUNCATED		16		// the recording buffer ran full
+
+// longest encoding of one event
+#define SIDREC_MAX_EVENT	9
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 flags;
+	u32 clockFreq;
+	u32 sampleRate;
+	u16 sidModel[ 2 ];			// 6581 or 8580
+	u8  sidDigiBoost[ 2 ];
+	u8  soundFont;				// SD:MIDI/instrumentXX.sf2
+	u8  midiVolume;
+	s16 volume[ 6 ];			// SID1 left/right, SID2 left/right, OPL left/right (mixer factors, 256 = 1.0)
+	u32 nEvents;
+	u32 nCycles;				// C64 cycles from the start to the last event
+	u32 reserved[ 4 ];
+} __attribute__((packed)) SIDREC_HEADER;
+
+// appends an event at p, returns the number of bytes written
+static inline u32 sidrecPutEvent( u8 *p, u32 deltaCycles, u32 type, u32 reg, u32 data )
+{
+	u8 *s = p;
+
+	while ( deltaCycles >= 0x80 )
+	{
+		*(p++) = ( deltaCycles & 0x7f ) | 0x80;
+		deltaCycles >>= 7;
+	}
+	*(p++) = deltaCycles;
+
+	*(p++) = ( type << 5 ) | ( reg & 31 );
+
+	if ( type == SIDREC_MIDI )
+	{
+		*(p++) = data & 255;
+		*(p++) = ( data >> 8 ) & 255;
+		*(p++) = ( data >> 16 ) & 255;
+	} else
+	if ( type == SIDREC_SIDN )
+	{
+		*(p++) = data & 255;
+		*(p++) = ( data >> 8 ) & 7;
+	} else
+	if ( type != SIDREC_RESET )
+		*(p++) = data;
+
+	return p - s;
+}
+
+// decodes the event at p (at most 'size' bytes available), returns the number of bytes consumed or 0 if the event is incomplete
+static inline u32 sidrecGetEvent( const u8 *p, u32 size, u32 *deltaCycles, u32 *type, u32 *reg, u32 *data )
+{
+	const u8 *s = p, *e = p + size;
+
+	u32 d = 0, shift = 0;
+	do {
+		if ( p >= e || shift > 28 )
+			return 0;
+		d |= ( *p & 0x7f ) << shift;
+		shift += 7;
+	} while ( *(p++) & 0x80 );
+
+	if ( p >= e )
+		return 0;
+
+	*deltaCycles = d;
+	*type = *p >> 5;
+	*reg  = *(p++) & 31;
+
+	if ( *type == SIDREC_MIDI )
+	{
+		if ( p + 3 > e )
+			return 0;
+		*data = p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 );
+		p += 3;
+	} else
+	if ( *type == SIDREC_SIDN )
+	{
+		if ( p + 2 > e )
+			return 0;
+		*data = p[ 0 ] | ( ( p[ 1 ] & 7 ) << 8 );
+		p += 2;
+	} else
+	if ( *type != SIDREC_RESET )
+	{
+		if ( p >= e )
+			return 0;
+		*data = *(p++);
+	} else
+		*data = 0;
+
+	return p - s;
+}
+
+//
+// the mixer of kernel_sid.cpp (shared with the offline renderer)
+// SID and OPL outputs are scaled by the volume factors (256 = 1.0), MIDI is added unscaled
+//
+static inline void sidMixSample( s32 valSID1, s32 valSID2, s32 valOPL, s32 valMIDI, const s32 *volume, s32 *left, s32 *right )
+{
+	// yes, it's 1 byte shifted in the buffer, need to fix
+	s32 r = ( valSID1 * volume[ 0 ] + valSID2 * volume[ 2 ] + valOPL * volume[ 4 ] ) >> 8;
+	s32 l = ( valSID1 * volume[ 1 ] + valSID2 * volume[ 3 ] + valOPL * volume[ 5 ] ) >> 8;
+
+	r += valMIDI;
+	l += valMIDI;
+
+	if ( r < -31768+2 ) r = -31768+2;
+	if ( r >  31767-2 ) r =  31767-2;
+	if ( l < -31768+2 ) l = -31768+2;
+	if ( l >  31767-2 ) l =  31767-2;
+
+	*right = r;
+	*left  = l;
+}
+
+#endif
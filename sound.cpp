@@ -28,6 +28,7 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "kernel_sid.h"
+#include "resid/sid.h"
 
 #define WRITE_CHANNELS		2		// 1: Mono, 2: Stereo
 #define CHUNK_SIZE			2000	// number of samples, written to sound device at once
@@ -73,8 +74,6 @@ void initSoundOutput( CSoundBaseDevice **m_pSound, CVCHIQDevice *m_VCHIQ, u32 ou
 		( *m_pSound )->RegisterNeedDataCallback( cbSound, (void*)( *m_pSound ) );
 	}
 
-	extern u32 SAMPLERATE_ADJUSTED;
-	SAMPLERATE_ADJUSTED = SAMPLERATE;
 	FirstBufferUpdate = 1;
 
 	clearSoundBuffer();
@@ -232,11 +231,10 @@ void cbSound( void *d )
 	return; 
 
 	CSoundBaseDevice *m_pSound = (CSoundBaseDevice*)d;
-	extern u32 trackSampleProgress;
 
-	s32 nFramesComputed = samplesInBuffer();
+	// samplesInBuffer() counts samples, PCMBuffer holds interleaved frames
+	s32 nFramesComputed = samplesInBuffer() / 2;
 	s32 nFramesMax = m_pSound->GetQueueSizeFrames() - m_pSound->GetQueueFramesAvail();
-	trackSampleProgress = 1024 * 1024 + ( nFramesComputed - nFramesMax );
 
 	s32 nWriteFrames = min( nFramesComputed, nFramesMax );
 
@@ -255,6 +253,33 @@ void cbSound( void *d )
 
 #endif
 
+//
+// the reSID filter tables are computed by the first SID created (several seconds), unless they are loaded
+// from FILENAME before; if the file is missing or from a different build it is (re)written after computing
+//
+void prepareSIDFilterTables( CLogger *logger, const char *DRIVE, const char *FILENAME )
+{
+	if ( reSID::Filter::tables_ready() )
+		return;
+
+	u32 size = reSID::Filter::tables_size(), fileSize;
+	u8 *data = new u8[ size ];
+
+	if ( getFileSize( logger, DRIVE, FILENAME, &fileSize ) && fileSize == size &&
+		 readFile( logger, DRIVE, FILENAME, data, &fileSize ) && reSID::Filter::load_tables( data, size ) )
+	{
+		delete [] data;
+		return;
+	}
+
+	reSID::Filter::build_tables();
+
+	if ( reSID::Filter::save_tables( data, size ) )
+		writeFile( logger, DRIVE, FILENAME, data, size );
+
+	delete [] data;
+}
+
 void clearSoundBuffer()
 {
 #ifdef USE_PWM_DIRECT
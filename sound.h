@@ -38,6 +38,7 @@ extern u32 PWMRange;
 
 extern void initSoundOutput( CSoundBaseDevice **m_pSound = NULL, CVCHIQDevice *m_VCHIQ = NULL, u32 outputPWM = 0, u32 outputHDMI = 0 );
 extern void clearSoundBuffer();
+extern void prepareSIDFilterTables( CLogger *logger, const char *DRIVE, const char *FILENAME );
 
 extern u32 sampleBuffer[ 128 ];
 extern u32 smpLast, smpCur;
@@ -0,0 +1,335 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ vdc.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - 80 column text display with a VDC-like register interface
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "vdc.h"
+#include <circle/util.h>
+
+// the 8563 colors are RGBI (bit 3 red, 2 green, 1 blue, 0 intensity)
+const u16 vdcPalette565[ 16 ] = {
+	0x0000, 0x52aa, 0x0015, 0x52bf, 0x0540, 0x57ea, 0x0555, 0x57ff, 0xa800, 0xfaaa, 0xa815, 0xfabf, 0xaaa0, 0xffea, 0xad55, 0xffff };
+const u32 vdcPaletteRGB[ 16 ] = {
+	0x000000, 0x555555, 0x0000aa, 0x5555ff, 0x00aa00, 0x55ff55, 0x00aaaa, 0x55ffff, 0xaa0000, 0xff5555, 0xaa00aa, 0xff55ff, 0xaa5500, 0xffff55, 0xaaaaaa, 0xffffff };
+
+// one byte of a glyph expanded to 8 pixels (leftmost pixel in the lowest byte), 0xff where the pixel is set
+static u64 expand[ 256 ];
+
+// the content of a cell as drawn, equal keys result in equal pixels
+#define KEY_GLYPH			511
+#define KEY_FG_SHIFT		9
+#define KEY_BG_SHIFT		13
+#define KEY_UNDERLINE		( 1 << 17 )
+#define KEY_CURSOR			( 1 << 18 )
+#define KEY_CURSOR_SHIFT	19
+#define KEY_UL_SHIFT		25
+#define KEY_HIDDEN			( 1 << 28 )
+#define KEY_NONE			0xffffffff
+
+// what is the same for all cells of a frame
+typedef struct
+{
+	u32 screen, attr, charBase;
+	u32 attributes, reverse, fg, bg;
+	u32 blinkOn, underline;
+	u32 cursorCell, cursorKey;
+} VDC_FRAME;
+
+void vdcInit( VDC_STATE *v )
+{
+	memset( v, 0, sizeof( VDC_STATE ) );
+
+	// as set up by the C128 kernal: screen at $0000, attributes at $0800, character set at $2000
+	v->reg[ 10 ] = 0x60;
+	v->reg[ 11 ] = 7;
+	v->reg[ 20 ] = 0x08;
+	v->reg[ 24 ] = 0x20;
+	v->reg[ 25 ] = 0x47;
+	v->reg[ 26 ] = 0xf0;
+	v->reg[ 28 ] = 0x20;
+	v->reg[ 29 ] = 7;
+	v->changed = 1;
+}
+
+void vdcRenderInit( VDC_RENDER *r, u8 *fb, u32 pitch, u32 scaleY )
+{
+	for ( u32 i = 0; i < 256; i++ )
+	{
+		u64 e = 0;
+		for ( u32 x = 0; x < 8; x++ )
+			if ( i & ( 128 >> x ) )
+				e |= (u64)0xff << ( x * 8 );
+		expand[ i ] = e;
+	}
+
+	memset( r, 0, sizeof( VDC_RENDER ) );
+	r->fb = fb;
+	r->pitch = pitch;
+	r->scaleY = scaleY;
+	r->cursorCell = KEY_NONE;
+	for ( u32 i = 0; i < VDC_CELLS; i++ )
+		r->shadow[ i ] = KEY_NONE;
+}
+
+void vdcBlockStep( VDC_STATE *v )
+{
+	u32 n = v->blockCount;
+	if ( !n )
+		return;
+
+	u32 copy = v->reg[ 24 ] & 0x80;
+	u32 u = v->update, s = v->source;
+	u8 fill = v->reg[ 31 ];
+
+	// the dirty bits are collected per word, the FIQ handler may set bits of the same word meanwhile
+	u32 word = u >> 5, bits = 0;
+
+	for ( u32 i = 0; i < n; i++ )
+	{
+		if ( ( u >> 5 ) != word )
+		{
+			__atomic_fetch_or( &v->dirty[ word ], bits, __ATOMIC_RELAXED );
+			word = u >> 5;
+			bits = 0;
+		}
+
+		v->ram[ u ] = copy ? v->ram[ s ] : fill;
+		bits |= 1U << ( u & 31 );
+
+		u = ( u + 1 ) & VDC_RAM_MASK;
+		s = ( s + 1 ) & VDC_RAM_MASK;
+	}
+	__atomic_fetch_or( &v->dirty[ word ], bits, __ATOMIC_RELAXED );
+
+	v->update = u;
+	if ( copy )
+		v->source = s;
+
+	v->blockCount = 0;
+}
+
+static void setupFrame( VDC_STATE *v, VDC_FRAME *f, u64 us )
+{
+	u8 *reg = v->reg;
+	u64 frame = us / VDC_FRAME_US;
+
+	f->screen   = ( ( reg[ 12 ] << 8 ) | reg[ 13 ] ) & VDC_RAM_MASK;
+	f->attr     = ( ( reg[ 20 ] << 8 ) | reg[ 21 ] ) & VDC_RAM_MASK;
+	f->charBase = ( ( reg[ 28 ] & 0xe0 ) << 8 ) & VDC_RAM_MASK;
+	f->attributes = reg[ 25 ] & 0x40;
+	f->reverse  = ( reg[ 24 ] >> 6 ) & 1;
+	f->fg       = reg[ 26 ] >> 4;
+	f->bg       = reg[ 26 ] & 15;
+	f->blinkOn  = ( frame / ( ( reg[ 24 ] & 0x20 ) ? 32 : 16 ) ) & 1;
+
+	f->underline = 0;
+	if ( ( reg[ 29 ] & 31 ) < 8 )
+		f->underline = KEY_UNDERLINE | ( ( reg[ 29 ] & 31 ) << KEY_UL_SHIFT );
+
+	// cursor modes: solid, off, blinking with 1/16 or 1/32 of the frame rate
+	u32 mode = ( reg[ 10 ] >> 5 ) & 3;
+	u32 start = reg[ 10 ] & 31, end = reg[ 11 ] & 31;
+	if ( end > 7 ) end = 7;
+
+	f->cursorCell = KEY_NONE;
+	f->cursorKey = 0;
+	if ( ( mode == 0 || ( mode >= 2 && ( ( frame / ( mode == 2 ? 16 : 32 ) ) & 1 ) ) ) && start <= end )
+	{
+		f->cursorCell = ( ( ( reg[ 14 ] << 8 ) | reg[ 15 ] ) - f->screen ) & VDC_RAM_MASK;
+		f->cursorKey = KEY_CURSOR | ( start << KEY_CURSOR_SHIFT ) | ( end << ( KEY_CURSOR_SHIFT + 3 ) );
+	}
+}
+
+// is a 32 byte word at offset 'o' (relative to the start of an area of 'l' bytes) completely inside/outside of it
+static inline u32 inside( u32 o, u32 l )	{ return o <= l - 32; }
+static inline u32 outside( u32 o, u32 l )	{ return o >= l && o <= VDC_RAM_SIZE - 32; }
+
+static inline u32 cellKey( VDC_STATE *v, VDC_FRAME *f, u32 c )
+{
+	u32 ch = v->ram[ ( f->screen + c ) & VDC_RAM_MASK ];
+	u32 fg = f->fg, bg = f->bg, rev = f->reverse, extra = 0;
+
+	if ( f->attributes )
+	{
+		u32 a = v->ram[ ( f->attr + c ) & VDC_RAM_MASK ];
+		ch |= ( a & 0x80 ) << 1;
+		fg = a & 15;
+		rev ^= ( a >> 6 ) & 1;
+		if ( a & 0x20 )
+			extra = f->underline;
+		if ( ( a & 0x10 ) && !f->blinkOn )
+		{
+			ch = 0;
+			extra = KEY_HIDDEN;
+		}
+	}
+
+	if ( rev )
+	{
+		u32 t = fg; fg = bg; bg = t;
+	}
+
+	u32 key = ch | ( fg << KEY_FG_SHIFT ) | ( bg << KEY_BG_SHIFT ) | extra;
+
+	if ( c == f->cursorCell )
+		key |= f->cursorKey;
+
+	return key;
+}
+
+static inline void drawCell( VDC_RENDER *r, VDC_STATE *v, VDC_FRAME *f, u32 row, u32 col, u32 key )
+{
+	const u8 *g = &v->ram[ ( f->charBase + ( key & KEY_GLYPH ) * 16 ) & VDC_RAM_MASK ];
+	u64 fg = ( ( key >> KEY_FG_SHIFT ) & 15 ) * 0x0101010101010101ULL;
+	u64 bg = ( ( key >> KEY_BG_SHIFT ) & 15 ) * 0x0101010101010101ULL;
+
+	u32 ul = ( key & KEY_UNDERLINE ) ? ( key >> KEY_UL_SHIFT ) & 7 : 8;
+	u32 cs = 8, ce = 0;
+	if ( key & KEY_CURSOR )
+	{
+		cs = ( key >> KEY_CURSOR_SHIFT ) & 7;
+		ce = ( key >> ( KEY_CURSOR_SHIFT + 3 ) ) & 7;
+	}
+
+	u8 *p = r->fb + row * 8 * r->scaleY * r->pitch + col * 8;
+
+	for ( u32 y = 0; y < 8; y++ )
+	{
+		u64 m = ( key & KEY_HIDDEN ) ? 0 : expand[ g[ y ] ];
+		if ( y == ul ) m = ~0ULL;
+		if ( y >= cs && y <= ce ) m = ~m;
+
+		u64 px = ( m & fg ) | ( ~m & bg );
+		for ( u32 s = 0; s < r->scaleY; s++ )
+		{
+			*(u64 *)p = px;
+			p += r->pitch;
+		}
+	}
+}
+
+u32 vdcRender( VDC_RENDER *r, VDC_STATE *v, u64 us, u32 full )
+{
+	VDC_FRAME f;
+	setupFrame( v, &f, us );
+
+	// register changes and blinking may change any cell: compare all of them with what is shown
+	u32 rescan = __atomic_exchange_n( &v->changed, 0, __ATOMIC_RELAXED );
+
+	if ( f.blinkOn != r->blinkPhase )
+	{
+		r->blinkPhase = f.blinkOn;
+		rescan = 1;
+	}
+
+	// the cursor moved, blinks or changed its shape: only the old and the new cell
+	if ( f.cursorCell != r->cursorCell || f.cursorKey != r->cursorKey )
+	{
+		if ( r->cursorCell < VDC_CELLS ) r->cellDirty[ r->cursorCell ] = 1;
+		if ( f.cursorCell < VDC_CELLS ) r->cellDirty[ f.cursorCell ] = 1;
+		r->cursorCell = f.cursorCell;
+		r->cursorKey = f.cursorKey;
+	}
+
+	// map the written bytes to cells and glyphs
+	u32 glyphs = 0;
+	for ( u32 i = 0; i < VDC_RAM_SIZE / 32; i++ )
+	{
+		if ( !v->dirty[ i ] )
+			continue;
+
+		u32 d = __atomic_exchange_n( &v->dirty[ i ], 0, __ATOMIC_RELAXED ), o;
+
+		// 32 bytes written (block copies and fills) only to the screen or only to the attributes
+		if ( d == 0xffffffff && outside( ( i * 32 - f.charBase ) & VDC_RAM_MASK, 512 * 16 ) )
+		{
+			u32 os = ( i * 32 - f.screen ) & VDC_RAM_MASK;
+			u32 oa = ( i * 32 - f.attr ) & VDC_RAM_MASK;
+			if ( inside( os, VDC_CELLS ) && ( !f.attributes || outside( oa, VDC_CELLS ) ) )
+			{
+				memset( &r->cellDirty[ os ], 1, 32 );
+				continue;
+			}
+			if ( f.attributes && inside( oa, VDC_CELLS ) && outside( os, VDC_CELLS ) )
+			{
+				memset( &r->cellDirty[ oa ], 1, 32 );
+				continue;
+			}
+		}
+
+		while ( d )
+		{
+			u32 a = i * 32 + __builtin_ctz( d );
+			d &= d - 1;
+
+			if ( ( o = ( a - f.screen ) & VDC_RAM_MASK ) < VDC_CELLS )
+				r->cellDirty[ o ] = 1;
+			if ( f.attributes && ( o = ( a - f.attr ) & VDC_RAM_MASK ) < VDC_CELLS )
+				r->cellDirty[ o ] = 1;
+			if ( ( o = ( a - f.charBase ) & VDC_RAM_MASK ) < 512 * 16 && ( o & 15 ) < 8 )
+			{
+				r->glyphDirty[ o >> 9 ] |= 1U << ( ( o >> 4 ) & 31 );
+				glyphs = 1;
+			}
+		}
+	}
+
+	if ( glyphs )
+		rescan = 1;
+
+	u32 drawn = 0;
+	for ( u32 row = 0, c = 0; row < VDC_ROWS; row++ )
+	{
+		// do not let the C64 wait for a block copy until the frame is drawn
+		if ( v->blockCount )
+			vdcBlockStep( v );
+
+		for ( u32 col = 0; col < VDC_COLUMNS; col++, c++ )
+		{
+			if ( !( full | rescan | r->cellDirty[ c ] ) )
+				continue;
+			r->cellDirty[ c ] = 0;
+
+			u32 key = cellKey( v, &f, c );
+			if ( !full && key == r->shadow[ c ] &&
+				 !( glyphs && ( r->glyphDirty[ ( key & KEY_GLYPH ) >> 5 ] & ( 1U << ( key & 31 ) ) ) ) )
+				continue;
+
+			r->shadow[ c ] = key;
+			drawCell( r, v, &f, row, col, key );
+			drawn ++;
+		}
+	}
+
+	if ( glyphs )
+		memset( r->glyphDirty, 0, sizeof( r->glyphDirty ) );
+
+	r->frames ++;
+	r->cellsDrawn += drawn;
+
+	return drawn;
+}
@@ -0,0 +1,215 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ vdc.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - 80 column text display with a VDC-like register interface
+ Copyright (c) 2019-2021 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _vdc_h
+#define _vdc_h
+
+#include "buschain.h"
+
+//
+// 80 column text display with a register interface similar to the VDC (8563) of the C128: the C64 selects a register
+// by writing its number to $de00 and reads/writes it through $de01 (mirrored across IO1, A0 selects the port). The
+// video RAM is accessed through the update address (R18/R19) and R31 which increments the address after each access,
+// R30 starts a block fill (R24 bit 7 = 0) or copy (R24 bit 7 = 1, source in R32/R33) which is executed outside the FIQ
+// handler, bit 7 of the status register ($de00) is clear until it is done. Additionally IO2 shows a 256 byte window
+// of the video RAM (page in R38), which the 8563 does not have.
+//
+// The FIQ handler does O(1) work for every access: it stores the value and marks the written byte in a dirty bitmap.
+// The renderer (vdcRender) runs in the main loop of kernel_vdc.cpp, it takes the dirty bits and redraws only the
+// character cells whose glyph, attribute or colors changed into an 8 bit framebuffer. It does not depend on Circle and
+// is also built by VDCBench/vdcbench.
+//
+// Supported: screen (R12/R13) and attribute (R20/R21) start, character set (R28, 16 bytes per glyph, 8 lines shown),
+// attributes (R25 bit 6: alternate character set, reverse, underline, blink, RGBI color), colors (R26), reverse
+// screen and blink rate (R24), cursor (R10/R11, R14/R15) and the underline line (R29). The screen is always 80x25
+// characters, the timing registers (R0-R9, R22, R23, R27, R34-R37) are stored, but have no effect.
+//
+
+#define VDC_RAM_SIZE		16384
+#define VDC_RAM_MASK		( VDC_RAM_SIZE - 1 )
+#define VDC_REGS			64
+#define VDC_COLUMNS			80
+#define VDC_ROWS			25
+#define VDC_CELLS			( VDC_COLUMNS * VDC_ROWS )
+#define VDC_WIDTH			( VDC_COLUMNS * 8 )
+#define VDC_HEIGHT			( VDC_ROWS * 8 )
+
+// status register: bit 7 ready, bit 5 vertical blank, bits 2-0 version (8563 R2)
+#define VDC_STATUS_READY	0x80
+#define VDC_STATUS_VBLANK	0x20
+#define VDC_VERSION			0x02
+
+// the IO2 window page (not present in the 8563)
+#define VDC_REG_WINDOW		38
+
+// the blink rates are fractions of the frame rate (50 Hz), the status shows the vertical blank in the last 1.6 ms
+#define VDC_FRAME_US		20000
+#define VDC_VBLANK_US		1600
+
+typedef struct
+{
+	u8  reg[ VDC_REGS ];
+	u32 sel;						// selected register
+	u32 update, source;				// R18/R19, R32/R33
+	volatile u32 blockCount;		// bytes of a pending block fill/copy
+	volatile u32 changed;			// a register affecting the whole screen was written (not the cursor)
+	volatile u32 vblank;
+	u32 dirty[ VDC_RAM_SIZE / 32 ];	// one bit per byte of video RAM
+	u8  ram[ VDC_RAM_SIZE ];
+} VDC_STATE;
+
+//
+// register interface (called from the FIQ handler)
+//
+static inline void vdcWriteRAM( VDC_STATE *v, u32 a, u32 D )
+{
+	v->ram[ a ] = D;
+	v->dirty[ a >> 5 ] |= 1U << ( a & 31 );
+}
+
+static inline u32 vdcReadStatus( VDC_STATE *v )
+{
+	return ( v->blockCount ? 0 : VDC_STATUS_READY ) | v->vblank | VDC_VERSION;
+}
+
+static inline u32 vdcReadData( VDC_STATE *v )
+{
+	u32 D;
+
+	switch ( v->sel )
+	{
+	case 31:
+		D = v->ram[ v->update ];
+		v->update = ( v->update + 1 ) & VDC_RAM_MASK;
+		return D;
+	case 18: return v->update >> 8;
+	case 19: return v->update & 255;
+	case 32: return v->source >> 8;
+	case 33: return v->source & 255;
+	default: return v->reg[ v->sel ];
+	}
+}
+
+static inline void vdcWriteData( VDC_STATE *v, u32 D )
+{
+	switch ( v->sel )
+	{
+	case 31:
+		v->reg[ 31 ] = D;
+		vdcWriteRAM( v, v->update, D );
+		v->update = ( v->update + 1 ) & VDC_RAM_MASK;
+		break;
+	case 30:
+		v->reg[ 30 ] = D;
+		v->blockCount = D ? D : 256;
+		break;
+	case 18: v->update = ( ( D << 8 ) | ( v->update & 255 ) ) & VDC_RAM_MASK; break;
+	case 19: v->update = ( v->update & 0xff00 ) | D; break;
+	case 32: v->source = ( ( D << 8 ) | ( v->source & 255 ) ) & VDC_RAM_MASK; break;
+	case 33: v->source = ( v->source & 0xff00 ) | D; break;
+	case 12: case 13: case 20: case 21: case 24: case 25: case 26: case 28: case 29:
+		v->reg[ v->sel ] = D;
+		v->changed = 1;
+		break;
+	default:
+		v->reg[ v->sel ] = D;
+		break;
+	}
+}
+
+static inline u32 vdcWindowAddr( VDC_STATE *v, u32 A )
+{
+	return ( ( v->reg[ VDC_REG_WINDOW ] << 8 ) | A ) & VDC_RAM_MASK;
+}
+
+// bus device for the chains of buschain.h
+template <VDC_STATE *S>
+class CDevVDC : public CDevNone
+{
+public:
+	template <class BUS> static inline void prefetch( BUS &b )
+	{
+		b.preloadL1( &S->ram[ S->update ] );
+	}
+
+	template <class BUS> static inline u32 match( BUS &b )	{ return b.io1() || b.io2(); }
+
+	template <class BUS> static inline u32 read( BUS &b )
+	{
+		if ( b.io2() )
+			return S->ram[ vdcWindowAddr( S, b.addrIO() ) ];
+		if ( b.addrIO() & 1 )
+			return vdcReadData( S );
+		return vdcReadStatus( S );
+	}
+
+	template <class BUS> static inline void write( BUS &b )
+	{
+		u32 D = b.get();
+		if ( b.io2() )
+			vdcWriteRAM( S, vdcWindowAddr( S, b.addrIO() ), D ); else
+		if ( b.addrIO() & 1 )
+			vdcWriteData( S, D ); else
+			S->sel = D & ( VDC_REGS - 1 );
+	}
+};
+
+//
+// main loop
+//
+typedef struct
+{
+	u8  *fb;						// 8 bit per pixel, the palette index is the RGBI color
+	u32 pitch, scaleY;				// the pitch has to be a multiple of 8, scaleY = 2 doubles the lines
+
+	u32 shadow[ VDC_CELLS ];		// what each cell shows (see cellKey in vdc.cpp)
+	u8  cellDirty[ VDC_CELLS ];
+	u32 glyphDirty[ 512 / 32 ];
+	u32 blinkPhase;
+	u32 cursorCell, cursorKey;		// where and how the cursor is shown
+
+	// statistics
+	u32 frames, cellsDrawn;
+} VDC_RENDER;
+
+// the RGBI colors as RGB565 (e.g. for CBcmFrameBuffer::SetPalette) and RGB888
+extern const u16 vdcPalette565[ 16 ];
+extern const u32 vdcPaletteRGB[ 16 ];
+
+extern void vdcInit( VDC_STATE *v );
+extern void vdcRenderInit( VDC_RENDER *r, u8 *fb, u32 pitch, u32 scaleY );
+
+// executes a pending block fill/copy
+extern void vdcBlockStep( VDC_STATE *v );
+
+// redraws the changed cells ('us' is a time stamp in microseconds for blinking), returns the number of cells drawn,
+// with 'full' all cells are drawn
+extern u32 vdcRender( VDC_RENDER *r, VDC_STATE *v, u64 us, u32 full = 0 );
+
+#endif
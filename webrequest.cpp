@@ -0,0 +1,855 @@
+//
+// webrequest.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2015  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "webrequest.h"
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <circle/sched/scheduler.h>
+#include <circle/timer.h>
+#include <circle/net/in.h>
+#include <assert.h>
+
+extern CLogger *logger;
+
+static const char FromWebServer[] = "webserver";
+
+CWebRequest::CWebRequest (CNetSocket *pSocket, unsigned nMaxKernelSize, u8 *pLaunchBuffer, unsigned nLaunchBufferSize)
+:	m_pUploadMsg (0),
+	m_pSocket (pSocket),
+	m_nMaxKernelSize (nMaxKernelSize),
+	m_pLaunchBuffer (pLaunchBuffer),
+	m_nLaunchBufferSize (nLaunchBufferSize),
+	m_nBodyLeft (0),
+	m_bChunked (FALSE),
+	m_nRxPos (0),
+	m_nRxLength (0)
+{
+}
+
+//
+// receiving the request
+//
+#define WEBSERVER_TIMEOUT	10000000		// in microseconds
+
+boolean CWebRequest::Fill (void)
+{
+	unsigned nStart = CTimer::GetClockTicks ();
+	for (;;)
+	{
+		int nResult = m_pSocket->Receive (m_RxBuffer, WEBSERVER_RX_BUFFER_SIZE, MSG_DONTWAIT);
+		if (nResult > 0)
+		{
+			m_nRxPos = 0;
+			m_nRxLength = nResult;
+			return TRUE;
+		}
+
+		if (nResult < 0 || CTimer::GetClockTicks () - nStart > WEBSERVER_TIMEOUT)
+			return FALSE;
+
+		CScheduler::Get ()->MsSleep (1);
+	}
+}
+
+// returns the value of a header field (case insensitive name), or 0 if the line is another one
+static const char *GetHeaderValue (const char *pLine, const char *pName)
+{
+	for (; *pName; pLine++, pName++)
+	{
+		char c = *pLine;
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if (c != *pName)
+			return 0;
+	}
+	if (*pLine++ != ':')
+		return 0;
+	while (*pLine == ' ' || *pLine == '\t')
+		pLine++;
+	return pLine;
+}
+
+boolean CWebRequest::ReceiveHeader (void)
+{
+	unsigned nLength = 0;
+	for (;;)
+	{
+		if (m_nRxPos >= m_nRxLength && !Fill ())
+			return FALSE;
+
+		if (nLength >= WEBSERVER_MAX_HEADER - 1)
+			return FALSE;
+
+		m_Header[nLength++] = m_RxBuffer[m_nRxPos++];
+		if (nLength >= 4 && memcmp (&m_Header[nLength - 4], "\r\n\r\n", 4) == 0)
+			break;
+	}
+	m_Header[nLength] = '\0';
+
+	// request line: <method> <path>[?<params>] HTTP/1.x
+	char *p = m_Header;
+	char *pEnd = strchr (p, ' ');
+	if (pEnd == 0 || pEnd - p >= (int) sizeof m_Method)
+		return FALSE;
+	memcpy (m_Method, p, pEnd - p);
+	m_Method[pEnd - p] = '\0';
+
+	p = pEnd + 1;
+	pEnd = strchr (p, ' ');
+	char *pLineEnd = strstr (p, "\r\n");
+	if (pEnd == 0 || pEnd > pLineEnd)
+		return FALSE;
+	*pEnd = '\0';
+
+	char *pParams = strchr (p, '?');
+	if (pParams != 0)
+		*pParams++ = '\0';
+	else
+		pParams = (char *) "";
+	if (strlen (p) >= WEBSERVER_MAX_PATH || strlen (pParams) >= WEBSERVER_MAX_PATH)
+		return FALSE;
+	strcpy (m_Path, p);
+	strcpy (m_Params, pParams);
+
+	// header fields
+	m_nBodyLeft = 0;
+	m_bChunked = FALSE;
+	m_ContentType[0] = '\0';
+	for (p = pLineEnd + 2; *p != '\r'; p = pLineEnd + 2)
+	{
+		pLineEnd = strstr (p, "\r\n");
+		*pLineEnd = '\0';
+
+		const char *pValue;
+		if ((pValue = GetHeaderValue (p, "content-length")) != 0)
+		{
+			m_nBodyLeft = 0;
+			while (*pValue >= '0' && *pValue <= '9')
+				m_nBodyLeft = m_nBodyLeft * 10 + *pValue++ - '0';
+		}
+		else if ((pValue = GetHeaderValue (p, "content-type")) != 0)
+		{
+			strncpy (m_ContentType, pValue, sizeof m_ContentType - 1);
+			m_ContentType[sizeof m_ContentType - 1] = '\0';
+		}
+		else if ((pValue = GetHeaderValue (p, "transfer-encoding")) != 0)
+			m_bChunked = TRUE;
+	}
+
+	return TRUE;
+}
+
+// returns the next piece of the request body, 0 at its end and -1 if the connection broke
+int CWebRequest::ReceiveBody (const u8 **ppData)
+{
+	if (m_nBodyLeft == 0)
+		return 0;
+
+	if (m_nRxPos >= m_nRxLength && !Fill ())
+		return -1;
+
+	unsigned nLength = m_nRxLength - m_nRxPos;
+	if (nLength > m_nBodyLeft)
+		nLength = m_nBodyLeft;
+
+	*ppData = &m_RxBuffer[m_nRxPos];
+	m_nRxPos += nLength;
+	m_nBodyLeft -= nLength;
+
+	return nLength;
+}
+
+boolean CWebRequest::ReceiveBodyTo (CHTTPStreamSink *pSink)
+{
+	const u8 *pData;
+	int nLength;
+	while ((nLength = ReceiveBody (&pData)) > 0)
+	{
+		if (!pSink->Write (pData, nLength))
+			return FALSE;
+	}
+	return nLength == 0;
+}
+
+boolean CWebRequest::ReceiveMultipart (CMultipartParser *pParser)
+{
+	if (!pParser->Begin (m_ContentType))
+		return FALSE;
+
+	const u8 *pData;
+	int nLength;
+	while ((nLength = ReceiveBody (&pData)) > 0)
+	{
+		if (!pParser->Parse (pData, nLength))
+			return FALSE;
+	}
+	return nLength == 0 && pParser->IsComplete ();
+}
+
+void CWebRequest::SkipBody (void)
+{
+	const u8 *pData;
+	while (ReceiveBody (&pData) > 0)
+		;
+}
+
+//
+// sending the response
+//
+static const char *GetStatusText (unsigned nStatus)
+{
+	switch (nStatus)
+	{
+	case 200:	return "OK";
+	case 400:	return "Bad Request";
+	case 404:	return "Not Found";
+	case 405:	return "Method Not Allowed";
+	case 413:	return "Request Entity Too Large";
+	default:	return "Internal Server Error";
+	}
+}
+
+boolean CWebRequest::Send (const void *pData, unsigned nLength)
+{
+	const u8 *p = (const u8 *) pData;
+	while (nLength > 0)
+	{
+		unsigned nChunk = nLength > WEBSERVER_RX_BUFFER_SIZE ? WEBSERVER_RX_BUFFER_SIZE : nLength;
+		int nSent = m_pSocket->Send (p, nChunk, 0);
+		if (nSent <= 0)
+			return FALSE;
+		p += nSent;
+		nLength -= nSent;
+	}
+	return TRUE;
+}
+
+void CWebRequest::SendResponse (unsigned nStatus, const char *pContentType, const u8 *pContent, unsigned nLength)
+{
+	CString Header;
+	Header.Format ("HTTP/1.0 %u %s\r\n"
+		       "Server: Sidekick64\r\n"
+		       "Connection: close\r\n"
+		       "Content-Type: %s\r\n"
+		       "Content-Length: %u\r\n"
+		       "\r\n", nStatus, GetStatusText (nStatus), pContentType, nLength);
+
+	if (Send ((const char *) Header, Header.GetLength ()) && nLength > 0)
+		Send (pContent, nLength);
+}
+
+void CWebRequest::SendJSON (unsigned nStatus, const char *pJSON)
+{
+	SendResponse (nStatus, "application/json", (const u8 *) pJSON, strlen (pJSON));
+}
+
+// appends a string with JSON escaping
+void AppendJSONString (CString &rJSON, const char *pString)
+{
+	char Buffer[WEBSERVER_MAX_PATH * 6 + 1];
+	unsigned n = 0;
+	for (; *pString && n < sizeof Buffer - 7; pString++)
+	{
+		u8 c = (u8) *pString;
+		if (c == '"' || c == '\\')
+		{
+			Buffer[n++] = '\\';
+			Buffer[n++] = c;
+		}
+		else if (c < 0x20)
+		{
+			const char Hex[] = "0123456789abcdef";
+			memcpy (&Buffer[n], "\\u00", 4);
+			Buffer[n + 4] = Hex[c >> 4];
+			Buffer[n + 5] = Hex[c & 15];
+			n += 6;
+		}
+		else
+			Buffer[n++] = c;
+	}
+	Buffer[n] = '\0';
+	rJSON.Append (Buffer);
+}
+
+void CWebRequest::SendError (unsigned nStatus, const char *pMessage)
+{
+	CString JSON = "{\"ok\":false,\"error\":\"";
+	AppendJSONString (JSON, pMessage);
+	JSON.Append ("\"}");
+	SendJSON (nStatus, JSON);
+}
+
+//
+// request handling
+//
+void CWebRequest::HandleRequest (void)
+{
+	if (!ReceiveHeader ())
+		return;
+
+	// all clients we know of send uploads with a Content-Length
+	if (m_bChunked)
+	{
+		SendError (400, "chunked request bodies are not supported");
+		return;
+	}
+
+	if (strncmp (m_Path, "/api/", 5) == 0)
+	{
+		HandleAPI ();
+		return;
+	}
+
+	if (strcmp (m_Method, "POST") == 0)
+		HandleFormUpload ();
+
+	HandlePage ();
+}
+
+
+//
+// uploads
+//
+static boolean HasExtension (const char *pHeader, const char *pExt)
+{
+	// the file name is the last quoted string in the part header
+	const char *pName = strstr (pHeader, "filename=\"");
+	if (pName == 0)
+		return FALSE;
+	pName += 10;
+	const char *pEnd = strchr (pName, '"');
+	unsigned nExt = strlen (pExt);
+	if (pEnd == 0 || (unsigned) (pEnd - pName) < nExt)
+		return FALSE;
+
+	const char *p = pEnd - nExt;
+	for (unsigned i = 0; i < nExt; i++)
+	{
+		char c = p[i];
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if (c != pExt[i])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// replaces 'pFilename' by '<pFilename>.part' once the upload has been completed
+static boolean CommitPartFile (const char *pFilename)
+{
+	CString Part = pFilename;
+	Part.Append (".part");
+	f_unlink (pFilename);
+	return f_rename (Part, pFilename) == FR_OK;
+}
+
+// limits the size of a file upload
+class CLimitedFileSink : public CHTTPFileSink
+{
+public:
+	CLimitedFileSink (unsigned nLimit) : m_nLimit (nLimit), m_nWritten (0) {}
+
+	boolean Write (const u8 *pData, unsigned nLength)
+	{
+		m_nWritten += nLength;
+		if (m_nWritten > m_nLimit)
+			return FALSE;
+		return CHTTPFileSink::Write (pData, nLength);
+	}
+
+	unsigned GetWritten (void) { return m_nWritten; }
+	void Reset (void) { m_nWritten = 0; }
+
+private:
+	unsigned m_nLimit;
+	unsigned m_nWritten;
+};
+
+// handles the parts of an upload: either the HTML form (kernel image or a file to launch)
+// or an upload through the API to a directory on the SD card
+class CUploadParser : public CMultipartParser
+{
+public:
+	CUploadParser (CWebRequest *pRequest, unsigned nMaxKernelSize, const char *pSaveDir = 0)
+	:	m_pRequest (pRequest),
+		m_pSaveDir (pSaveDir),
+		m_FileSink (pSaveDir != 0 ? 0xffffffff : nMaxKernelSize),
+		m_BufferSink (pRequest->m_pLaunchBuffer, pRequest->m_nLaunchBufferSize),
+		m_pLaunchType (0),
+		m_bKernel (FALSE),
+		m_nFiles (0),
+		m_pMsg (0)
+	{
+	}
+
+	~CUploadParser (void)
+	{
+		// an incomplete upload leaves no trace
+		if (m_PartName.GetLength () > 0)
+		{
+			m_FileSink.Close ();
+			f_unlink (m_PartName);
+		}
+	}
+
+	const char *GetMessage (void) { return m_pMsg; }
+	unsigned GetFiles (void) { return m_nFiles; }
+
+protected:
+	CHTTPStreamSink *BeginPart (const char *pHeader)
+	{
+		if (strstr (pHeader, "filename=\"") == 0)
+			return 0;
+
+		if (m_pSaveDir != 0)
+			return BeginSave (pHeader);
+
+		if (   strstr (pHeader, "name=\"kernelimg\"") != 0
+		    && ( strstr (pHeader, "filename=\"kernel") != 0 || strstr (pHeader, "filename=\"rpi4_kernel") != 0 )
+		    && HasExtension (pHeader, ".img"))
+		{
+			m_bKernel = TRUE;
+			m_FileName = m_pRequest->GetKernelFilename ();
+			return OpenPartFile ();
+		}
+
+		static const char *pTypes[] = { "prg", "d64", "crt", "sid", "bin" };
+		for (unsigned i = 0; i < sizeof pTypes / sizeof pTypes[0]; i++)
+		{
+			char Ext[5] = ".";
+			strcat (Ext, pTypes[i]);
+			if (HasExtension (pHeader, Ext))
+			{
+				m_pLaunchType = pTypes[i];
+				m_BufferSink.Begin (0, 0);
+				return &m_BufferSink;
+			}
+		}
+
+		m_pMsg = "Invalid request (1)";
+		return 0;
+	}
+
+	boolean EndPart (CHTTPStreamSink *pSink)
+	{
+		if (pSink == 0)
+			return TRUE;
+
+		if (pSink == &m_BufferSink)
+		{
+			if (m_BufferSink.GetLength () == 0)
+			{
+				m_pMsg = "Invalid request (2)";
+				return TRUE;
+			}
+			m_pRequest->Launch (m_pLaunchType, m_BufferSink.GetLength ());
+			m_pMsg = "Now launching payload...";
+			return TRUE;
+		}
+
+		m_FileSink.Close ();
+		unsigned nLength = m_FileSink.GetWritten ();
+		if (nLength == 0)
+		{
+			f_unlink (m_PartName);
+			m_PartName = "";
+			m_pMsg = "Invalid request (2)";
+			return TRUE;
+		}
+
+		m_PartName = "";
+		if (!CommitPartFile (m_FileName))
+			return FALSE;
+		m_pRequest->RefreshCaches ();
+		m_nFiles++;
+
+		if (m_bKernel)
+		{
+			logger->Write( FromWebServer, LogNotice, "Saved kernel image to SD card, length: %u", nLength);
+			m_pRequest->KernelSaved ();
+			m_pMsg = "Now rebooting into new kernel...";
+		}
+		else
+			logger->Write( FromWebServer, LogNotice, "Saved %s, length: %u", (const char *) m_FileName, nLength);
+
+		return TRUE;
+	}
+
+private:
+	CHTTPStreamSink *BeginSave (const char *pHeader)
+	{
+		const char *pName = strstr (pHeader, "filename=\"") + 10;
+		const char *pEnd = strchr (pName, '"');
+		if (pEnd == 0 || pEnd == pName || pEnd - pName >= WEBSERVER_MAX_PATH)
+			return 0;
+
+		// strip any directory a browser might send along
+		for (const char *p = pName; p < pEnd; p++)
+			if (*p == '/' || *p == '\\')
+				pName = p + 1;
+
+		char Name[WEBSERVER_MAX_PATH];
+		memcpy (Name, pName, pEnd - pName);
+		Name[pEnd - pName] = '\0';
+		if (Name[0] == '\0' || strstr (Name, "..") != 0)
+			return 0;
+
+		m_FileName = m_pSaveDir;
+		if (m_FileName.GetLength () > 0 && ((const char *) m_FileName)[m_FileName.GetLength () - 1] != '/')
+			m_FileName.Append ("/");
+		m_FileName.Append (Name);
+
+		return OpenPartFile ();
+	}
+
+	CHTTPStreamSink *OpenPartFile (void)
+	{
+		m_PartName = m_FileName;
+		m_PartName.Append (".part");
+
+		// no resuming here, start from scratch
+		f_unlink (m_PartName);
+		m_FileSink.Reset ();
+		if (!m_FileSink.Open (m_PartName))
+		{
+			m_PartName = "";
+			return 0;
+		}
+		return &m_FileSink;
+	}
+
+	CWebRequest      *m_pRequest;
+	const char       *m_pSaveDir;
+	CLimitedFileSink  m_FileSink;
+	CHTTPBufferSink   m_BufferSink;
+	CString           m_FileName;
+	CString           m_PartName;
+	const char       *m_pLaunchType;
+	boolean           m_bKernel;
+	unsigned          m_nFiles;
+	const char       *m_pMsg;
+};
+
+void CWebRequest::HandleFormUpload (void)
+{
+	if (strcmp (m_Path, "/") != 0 && strcmp (m_Path, "/index.html") != 0 && strcmp (m_Path, "/upload.html") != 0)
+		return;
+
+	RefreshCaches ();
+
+	CUploadParser Parser (this, m_nMaxKernelSize);
+	if (!ReceiveMultipart (&Parser))
+	{
+		logger->Write (FromWebServer, LogWarning, "Upload failed");
+		m_pUploadMsg = Parser.GetMessage () != 0 ? Parser.GetMessage () : "Upload failed";
+		return;
+	}
+
+	m_pUploadMsg = Parser.GetMessage () != 0 ? Parser.GetMessage () : "Invalid request (2)";
+}
+
+//
+// REST API
+//
+//   GET           /api/list?path=SD:dir          directory listing
+//   POST|PUT      /api/upload?path=SD:dir        multipart upload into a directory
+//   POST|PUT      /api/upload?path=SD:dir/file   raw body written to a file
+//   POST          /api/launch?path=SD:dir/file   launch a file from the SD card
+//   POST          /api/launch?type=prg           launch the request body (type is prg, d64, crt, sid or bin)
+//   POST|DELETE   /api/delete?path=SD:dir/file   delete a file
+//   POST          /api/profile?cmd=start&rate=N  start the sampling profiler (N samples per second)
+//   POST          /api/profile?cmd=stop          stop the sampling profiler
+//   GET           /api/profile?cmd=status        state and number of samples collected
+//   GET           /api/profile                   samples collected so far (binary, see profiler.h), removes them
+//   GET           /api/log                       levels of the deferred log messages per subsystem (see logring.h)
+//   POST          /api/log?sub=modem&level=debug change the level of a subsystem
+//
+// all responses (except for the profile samples) are JSON objects with a member "ok",
+// profile and log are handled by CWebServer (HandleAPICommand)
+//
+static int HexValue (char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+boolean CWebRequest::GetParam (const char *pName, char *pValue, unsigned nSize)
+{
+	unsigned nNameLength = strlen (pName);
+	for (const char *p = m_Params; *p; )
+	{
+		if (strncmp (p, pName, nNameLength) == 0 && p[nNameLength] == '=')
+		{
+			unsigned n = 0;
+			for (p += nNameLength + 1; *p && *p != '&'; p++)
+			{
+				if (n >= nSize - 1)
+					return FALSE;
+
+				char c = *p;
+				if (c == '+')
+					c = ' ';
+				else if (c == '%' && HexValue (p[1]) >= 0 && HexValue (p[2]) >= 0)
+				{
+					c = HexValue (p[1]) << 4 | HexValue (p[2]);
+					p += 2;
+				}
+				pValue[n++] = c;
+			}
+			pValue[n] = '\0';
+			return TRUE;
+		}
+
+		p = strchr (p, '&');
+		if (p == 0)
+			break;
+		p++;
+	}
+	return FALSE;
+}
+
+// only absolute paths on the SD card, no way out of it
+static boolean IsValidPath (const char *pPath)
+{
+	return strncmp (pPath, "SD:", 3) == 0 && strstr (pPath, "..") == 0;
+}
+
+static boolean IsLaunchType (const char *pType)
+{
+	return strcmp (pType, "prg") == 0 || strcmp (pType, "d64") == 0 || strcmp (pType, "crt") == 0
+	    || strcmp (pType, "sid") == 0 || strcmp (pType, "bin") == 0;
+}
+
+void CWebRequest::HandleAPI (void)
+{
+	const char *pCommand = m_Path + 5;
+	boolean bPost = strcmp (m_Method, "POST") == 0;
+
+	if (strcmp (pCommand, "list") == 0 && strcmp (m_Method, "GET") == 0)
+		APIList ();
+	else if (strcmp (pCommand, "upload") == 0 && (bPost || strcmp (m_Method, "PUT") == 0))
+		APIUpload ();
+	else if (strcmp (pCommand, "launch") == 0 && bPost)
+		APILaunch ();
+	else if (strcmp (pCommand, "delete") == 0 && (bPost || strcmp (m_Method, "DELETE") == 0))
+		APIDelete ();
+	else if (!HandleAPICommand (pCommand))
+	{
+		SkipBody ();
+		SendError (404, "unknown request");
+	}
+}
+
+void CWebRequest::APIList (void)
+{
+	char Path[WEBSERVER_MAX_PATH];
+	if (!GetParam ("path", Path, sizeof Path))
+		strcpy (Path, "SD:");
+	if (!IsValidPath (Path))
+	{
+		SendError (400, "invalid path");
+		return;
+	}
+
+	DIR Dir;
+	if (f_opendir (&Dir, Path) != FR_OK)
+	{
+		SendError (404, "cannot open directory");
+		return;
+	}
+
+	CString JSON = "{\"ok\":true,\"path\":\"";
+	AppendJSONString (JSON, Path);
+	JSON.Append ("\",\"entries\":[");
+
+	FILINFO FileInfo;
+	boolean bFirst = TRUE;
+	while (f_readdir (&Dir, &FileInfo) == FR_OK && FileInfo.fname[0] != '\0')
+	{
+		if (FileInfo.fattrib & (AM_HID | AM_SYS))
+			continue;
+
+		JSON.Append (bFirst ? "{\"name\":\"" : ",{\"name\":\"");
+		AppendJSONString (JSON, FileInfo.fname);
+
+		CString Entry;
+		Entry.Format ("\",\"dir\":%s,\"size\":%u}", FileInfo.fattrib & AM_DIR ? "true" : "false", (unsigned) FileInfo.fsize);
+		JSON.Append (Entry);
+		bFirst = FALSE;
+	}
+	f_closedir (&Dir);
+
+	JSON.Append ("]}");
+	SendJSON (200, JSON);
+}
+
+void CWebRequest::APIUpload (void)
+{
+	char Path[WEBSERVER_MAX_PATH];
+	if (!GetParam ("path", Path, sizeof Path) || !IsValidPath (Path))
+	{
+		SkipBody ();
+		SendError (400, "invalid path");
+		return;
+	}
+
+	RefreshCaches ();
+
+	if (strncmp (m_ContentType, "multipart/form-data", 19) == 0)
+	{
+		CUploadParser Parser (this, 0, Path);
+		if (!ReceiveMultipart (&Parser))
+		{
+			SendError (500, "upload failed");
+			return;
+		}
+
+		CString JSON;
+		JSON.Format ("{\"ok\":true,\"files\":%u}", Parser.GetFiles ());
+		SendJSON (200, JSON);
+		return;
+	}
+
+	CString Part = Path;
+	Part.Append (".part");
+	f_unlink (Part);
+
+	CHTTPFileSink File;
+	if (!File.Open (Part))
+	{
+		SkipBody ();
+		SendError (500, "cannot create file");
+		return;
+	}
+
+	unsigned nLength = m_nBodyLeft;
+	boolean bOK = ReceiveBodyTo (&File);
+	File.Close ();
+
+	if (!bOK || !CommitPartFile (Path))
+	{
+		f_unlink (Part);
+		SendError (500, "upload failed");
+		return;
+	}
+
+	RefreshCaches ();
+	logger->Write (FromWebServer, LogNotice, "Saved %s, length: %u", Path, nLength);
+
+	CString JSON;
+	JSON.Format ("{\"ok\":true,\"size\":%u}", nLength);
+	SendJSON (200, JSON);
+}
+
+void CWebRequest::APILaunch (void)
+{
+	char Path[WEBSERVER_MAX_PATH];
+	char Type[8];
+	CHTTPBufferSink Buffer (m_pLaunchBuffer, m_nLaunchBufferSize);
+	unsigned nLength;
+
+	if (GetParam ("path", Path, sizeof Path))
+	{
+		SkipBody ();
+
+		const char *pExt = strrchr (Path, '.');
+		if (!IsValidPath (Path) || pExt == 0 || strlen (pExt + 1) >= sizeof Type)
+		{
+			SendError (400, "invalid path");
+			return;
+		}
+
+		for (unsigned i = 0; ; i++)
+		{
+			char c = pExt[i + 1];
+			Type[i] = c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+			if (c == '\0')
+				break;
+		}
+
+		FIL File;
+		UINT nBytesRead;
+		if (!IsLaunchType (Type) || f_open (&File, Path, FA_READ) != FR_OK)
+		{
+			SendError (404, "cannot launch file");
+			return;
+		}
+
+		FRESULT Result = f_read (&File, m_pLaunchBuffer, m_nLaunchBufferSize, &nBytesRead);
+		f_close (&File);
+		if (Result != FR_OK || nBytesRead == 0)
+		{
+			SendError (500, "cannot read file");
+			return;
+		}
+		nLength = nBytesRead;
+	}
+	else
+	{
+		if (!GetParam ("type", Type, sizeof Type) || !IsLaunchType (Type))
+		{
+			SkipBody ();
+			SendError (400, "missing path or type");
+			return;
+		}
+
+		if (m_nBodyLeft == 0 || m_nBodyLeft > m_nLaunchBufferSize)
+		{
+			SkipBody ();
+			SendError (413, "invalid body size");
+			return;
+		}
+
+		if (!ReceiveBodyTo (&Buffer))
+		{
+			SendError (500, "upload failed");
+			return;
+		}
+		nLength = Buffer.GetLength ();
+	}
+
+	Launch (Type, nLength);
+
+	CString JSON;
+	JSON.Format ("{\"ok\":true,\"size\":%u}", nLength);
+	SendJSON (200, JSON);
+}
+
+void CWebRequest::APIDelete (void)
+{
+	SkipBody ();
+
+	char Path[WEBSERVER_MAX_PATH];
+	if (!GetParam ("path", Path, sizeof Path) || !IsValidPath (Path))
+	{
+		SendError (400, "invalid path");
+		return;
+	}
+
+	if (f_unlink (Path) != FR_OK)
+	{
+		SendError (404, "cannot delete file");
+		return;
+	}
+
+	RefreshCaches ();
+	SendJSON (200, "{\"ok\":true}");
+}
@@ -0,0 +1,111 @@
+//
+// webrequest.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2015  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _webrequest_h
+#define _webrequest_h
+
+#include <circle/types.h>
+#include <circle/string.h>
+#include <circle/net/netsocket.h>
+#include "httpstream.h"
+
+#define WEBSERVER_RX_BUFFER_SIZE	4096
+#define WEBSERVER_MAX_HEADER		2048
+#define WEBSERVER_MAX_PATH			256
+
+// One request on a connection of the web server: the header is received, uploads (multipart or raw)
+// are parsed while they arrive and the file and launch commands of the REST API are handled here.
+// What needs the rest of Sidekick64 is left to the derived class (CWebServer), so that this part
+// also builds on the host (see NetBench).
+class CWebRequest
+{
+public:
+	CWebRequest (CNetSocket *pSocket,
+		     unsigned	 nMaxKernelSize,	// largest kernel image accepted
+		     u8		*pLaunchBuffer,		// files for instant launch are received here
+		     unsigned	 nLaunchBufferSize);
+	virtual ~CWebRequest (void) {}
+
+	// handles one request, the connection is closed afterwards (HTTP/1.0)
+	void HandleRequest (void);
+
+protected:
+	// the file to launch is in the launch buffer
+	virtual void Launch (const char *pType, unsigned nLength) = 0;
+	// files on the SD card are about to change or have changed
+	virtual void RefreshCaches (void) = 0;
+	// a new kernel image has been saved to GetKernelFilename ()
+	virtual void KernelSaved (void) = 0;
+	virtual const char *GetKernelFilename (void) = 0;
+
+	// everything which is neither an API call nor an upload through the HTML form
+	virtual void HandlePage (void) = 0;
+	// API commands not handled here, returns FALSE if unknown
+	virtual boolean HandleAPICommand (const char *pCommand) { return FALSE; }
+
+	int ReceiveBody (const u8 **ppData);
+	boolean ReceiveBodyTo (CHTTPStreamSink *pSink);
+	boolean ReceiveMultipart (CMultipartParser *pParser);
+	void SkipBody (void);
+
+	boolean Send (const void *pData, unsigned nLength);
+	void SendResponse (unsigned nStatus, const char *pContentType, const u8 *pContent, unsigned nLength);
+	void SendJSON (unsigned nStatus, const char *pJSON);
+	void SendError (unsigned nStatus, const char *pMessage);
+
+	boolean GetParam (const char *pName, char *pValue, unsigned nSize);
+
+	// request
+	char     m_Method[ 8 ];
+	char     m_Path[ WEBSERVER_MAX_PATH ];
+	char     m_Params[ WEBSERVER_MAX_PATH ];
+
+	// result of an upload through the HTML form
+	const char * m_pUploadMsg;
+
+private:
+	friend class CUploadParser;
+
+	boolean Fill (void);
+	boolean ReceiveHeader (void);
+
+	void HandleFormUpload (void);
+	void HandleAPI (void);
+	void APIList (void);
+	void APIUpload (void);
+	void APILaunch (void);
+	void APIDelete (void);
+
+	CNetSocket * m_pSocket;
+	unsigned m_nMaxKernelSize;
+	u8     * m_pLaunchBuffer;
+	unsigned m_nLaunchBufferSize;
+
+	char     m_Header[ WEBSERVER_MAX_HEADER ];
+	char     m_ContentType[ 128 ];
+	unsigned m_nBodyLeft;
+	boolean  m_bChunked;
+	u8       m_RxBuffer[ WEBSERVER_RX_BUFFER_SIZE ];
+	unsigned m_nRxPos, m_nRxLength;
+};
+
+// appends a string with JSON escaping
+void AppendJSONString (CString &rJSON, const char *pString);
+
+#endif
@@ -24,10 +24,17 @@
 #include <circle/string.h>
 #include <circle/util.h>
 #include <circle/version.h>
+#include <circle/sched/scheduler.h>
+#include <circle/timer.h>
+#include <circle/net/in.h>
 #include <assert.h>
 #include "helpers.h"
 #include "config.h"
 #include "lowlevel_arm64.h"
+#include "logring.h"
+#ifndef IS264
+#include "profiler.h"
+#endif
 
 #define MAX_CONTENT_SIZE	40000
 
@@ -66,24 +73,213 @@ static const u8 s_SK64Logo[] =
 
 static const char FromWebServer[] = "webserver";
 
+unsigned CWebServer::s_nWorkers = 0;
+
 CWebServer::CWebServer (CNetSubSystem *pNetSubSystem, u16 nPort,
 				  unsigned nMaxMultipartSize, CSocket *pSocket, CSidekickNet * pSidekickNet)
-:	CHTTPDaemon (pNetSubSystem, pSocket, MAX_CONTENT_SIZE, nPort, nMaxMultipartSize),
+:	CWebRequest (pSocket, nMaxMultipartSize, prgDataLaunch, sizeof prgDataLaunch),
+	m_pNetSubSystem (pNetSubSystem),
+	m_pSocket (pSocket),
 	m_nPort (nPort),
 	m_nMaxMultipartSize (nMaxMultipartSize),
 	m_SidekickNet( pSidekickNet )
 {
+	if (m_pSocket != 0)
+		s_nWorkers++;
 }
 
 CWebServer::~CWebServer (void)
 {
+	delete m_pSocket;
+	m_pSocket = 0;
 }
 
-CHTTPDaemon *CWebServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pSocket)
+void CWebServer::Run (void)
 {
-	return new CWebServer (pNetSubSystem, m_nPort, m_nMaxMultipartSize, pSocket, m_SidekickNet);
+	if (m_pSocket == 0)
+	{
+		Listener ();
+		return;
+	}
+
+	HandleRequest ();
+
+	delete m_pSocket;
+	m_pSocket = 0;
+	s_nWorkers--;
 }
 
+void CWebServer::Listener (void)
+{
+	m_pSocket = new CSocket (m_pNetSubSystem, IPPROTO_TCP);
+	if (m_pSocket->Bind (m_nPort) < 0 || m_pSocket->Listen () < 0)
+	{
+		logger->Write (FromWebServer, LogError, "Cannot listen on port %u", m_nPort);
+		return;
+	}
+
+	for (;;)
+	{
+		CIPAddress ForeignIP;
+		u16 nForeignPort;
+		CSocket *pConnection = m_pSocket->Accept (&ForeignIP, &nForeignPort);
+		if (pConnection == 0)
+		{
+			CScheduler::Get ()->MsSleep (100);
+			continue;
+		}
+
+		if (s_nWorkers >= WEBSERVER_MAX_WORKERS)
+		{
+			delete pConnection;
+			continue;
+		}
+
+		// the worker task deletes itself when it has finished
+		new CWebServer (m_pNetSubSystem, m_nPort, m_nMaxMultipartSize, pConnection, m_SidekickNet);
+	}
+}
+
+//
+// request handling, the HTTP part and the file and launch commands are in webrequest.cpp
+//
+const char *CWebServer::GetKernelFilename (void)
+{
+#ifndef IS264
+	#if RASPPI >= 4
+	return m_SidekickNet->usesWLAN() ? "SD:rpi4_kernel_sk64_wlan.img" : "SD:rpi4_kernel_sk64_net.img";
+	#else
+	return m_SidekickNet->usesWLAN() ? "SD:kernel_sk64_wlan.img" : "SD:kernel_sk64_net.img";
+	#endif
+#else
+	#if RASPPI >= 4
+	return m_SidekickNet->usesWLAN() ? "SD:rpi4_kernel_sk264_wlan.img" : "SD:rpi4_kernel_sk264_net.img";
+	#else
+	return m_SidekickNet->usesWLAN() ? "SD:kernel_sk264_wlan.img" : "SD:kernel_sk264_net.img";
+	#endif
+#endif
+}
+
+void CWebServer::Launch (const char *pType, unsigned nLength)
+{
+	prgSizeLaunch = nLength;
+	m_SidekickNet->prepareLaunchOfUpload ((char *) pType);
+}
+
+void CWebServer::RefreshCaches (void)
+{
+	m_SidekickNet->requireCacheWellnessTreatment();
+}
+
+void CWebServer::KernelSaved (void)
+{
+	m_SidekickNet->requestReboot();
+}
+
+boolean CWebServer::HandleAPICommand (const char *pCommand)
+{
+	if (strcmp (pCommand, "log") == 0)
+		APILog ();
+#ifndef IS264
+	else if (strcmp (pCommand, "profile") == 0)
+		APIProfile ();
+#endif
+	else
+		return FALSE;
+	return TRUE;
+}
+
+void CWebServer::HandlePage (void)
+{
+	SkipBody ();
+
+	u8 *pBuffer = new u8[MAX_CONTENT_SIZE];
+	unsigned nLength = MAX_CONTENT_SIZE;
+	const char *pContentType = "text/html";
+
+	::THTTPStatus Status = GetContent (m_Path, m_Params, "", pBuffer, &nLength, &pContentType);
+	if (Status == ::HTTPOK)
+		SendResponse (Status, pContentType, pBuffer, nLength);
+	else
+	{
+		const char *pMsg = Status == ::HTTPNotFound ?
+			"<html><body><h1>404 Not Found</h1></body></html>" :
+			"<html><body><h1>500 Internal Server Error</h1></body></html>";
+		SendResponse (Status, "text/html", (const u8 *) pMsg, strlen (pMsg));
+	}
+
+	delete [] pBuffer;
+}
+
+void CWebServer::APILog (void)
+{
+	SkipBody ();
+
+	if (strcmp (m_Method, "POST") == 0)
+	{
+		char Sub[8], Level[8];
+		int nSub = GetParam ("sub", Sub, sizeof Sub) ? logRingSubsystem (Sub) : -1;
+		int nLevel = GetParam ("level", Level, sizeof Level) ? logRingParseLevel (Level) : -1;
+		if (nSub < 0 || nLevel < 0)
+		{
+			SendError (400, "invalid subsystem or level");
+			return;
+		}
+		logRingLevel[nSub] = nLevel;
+	}
+
+	CString JSON;
+	JSON.Format ("{\"ok\":true,\"pending\":%u,\"levels\":{", logRingPending ());
+	for (unsigned i = 0; i < LOGRING_SUBSYSTEMS; i++)
+	{
+		CString Entry;
+		Entry.Format ("%s\"%s\":\"%s\"", i ? "," : "", logRingSubsystemName[i], logRingLevelName (logRingLevel[i]));
+		JSON.Append (Entry);
+	}
+	JSON.Append ("}}");
+	SendJSON (200, JSON);
+}
+
+#ifndef IS264
+void CWebServer::APIProfile (void)
+{
+	SkipBody ();
+
+	char Command[8];
+	if (!GetParam ("cmd", Command, sizeof Command))
+	{
+		unsigned nSize = sizeof (PROFILE_HEADER) + PROFILE_SAMPLES * sizeof (PROFILE_SAMPLE);
+		u8 *pBuffer = new u8[nSize];
+		nSize = profileRead (pBuffer, nSize);
+		SendResponse (200, "application/octet-stream", pBuffer, nSize);
+		delete [] pBuffer;
+		return;
+	}
+
+	boolean bPost = strcmp (m_Method, "POST") == 0;
+	if (strcmp (Command, "start") == 0 && bPost)
+	{
+		char Rate[8];
+		if (!GetParam ("rate", Rate, sizeof Rate) || !profileStart (atoi (Rate)))
+		{
+			SendError (400, "invalid rate");
+			return;
+		}
+	}
+	else if (strcmp (Command, "stop") == 0 && bPost)
+		profileStop ();
+	else if (strcmp (Command, "status") != 0)
+	{
+		SendError (400, "unknown command");
+		return;
+	}
+
+	CString JSON;
+	JSON.Format ("{\"ok\":true,\"active\":%s,\"samples\":%u}", profileActive () ? "true" : "false", profileSamplesAvailable ());
+	SendJSON (200, JSON);
+}
+#endif
+
 ::THTTPStatus CWebServer::GetContent (const char  *pPath,
 					 const char  *pParams,
 					 const char  *pFormData,
@@ -114,91 +310,8 @@ CHTTPDaemon *CWebServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pS
 	}
 	else if ( strcmp (pPath, "/upload.html") == 0)
 	{*/
-		const char *pMsg = 0;
-
-		const char *pPartHeader;
-		const u8 *pPartData;
-		unsigned nPartLength;
-		if (GetMultipartFormPart (&pPartHeader, &pPartData, &nPartLength))
-		{
-			assert (pPartHeader != 0);
-			if (   strstr (pPartHeader, "name=\"kernelimg\"") != 0
-			    && ( strstr (pPartHeader, "filename=\"kernel") != 0 || strstr (pPartHeader, "filename=\"rpi4_kernel") != 0 )
-			    && strstr (pPartHeader, ".img\"") != 0
-			    && nPartLength > 0)
-			{
-				assert (pPartData != 0);
-				
-				m_SidekickNet->requireCacheWellnessTreatment();
-
-#ifndef IS264
-				#if RASPPI >= 4
-  				const char * filename = m_SidekickNet->usesWLAN() ? "SD:rpi4_kernel_sk64_wlan.img" : "SD:rpi4_kernel_sk64_net.img";
-				#else
-  				const char * filename = m_SidekickNet->usesWLAN() ? "SD:kernel_sk64_wlan.img" : "SD:kernel_sk64_net.img";
-				#endif
-#else
-				#if RASPPI >= 4
-					const char * filename = m_SidekickNet->usesWLAN() ? "SD:rpi4_kernel_sk264_wlan.img" : "SD:rpi4_kernel_sk264_net.img";
-				#else
-					const char * filename = m_SidekickNet->usesWLAN() ? "SD:kernel_sk264_wlan.img" : "SD:kernel_sk264_net.img";
-				#endif
-#endif			
-				logger->Write( FromWebServer, LogNotice, "Saving kernel image to SD card, length: %u", nPartLength);
-				//f_unlink("SD:kernel_sk64_net.img.old");
-				//f_rename("SD:kernel_sk64_net.img","SD:kernel_sk64_net.img.old");
-				writeFile( logger, "SD:", filename, (u8*) pPartData, nPartLength );
-				m_SidekickNet->requireCacheWellnessTreatment();
-				m_SidekickNet->requestReboot();
-				
-				pMsg = "Now rebooting into new kernel...";
-			}
-/*			
-			else if ( strstr (pPartHeader, "filename=\"rpimenu.prg") != 0  && nPartLength > 0 )
-			{
-				#ifndef IS264
-  				const char * filename = "SD:C64/rpimenu.prg";
-				#else
-					const char * filename = "SD:C16/rpimenu.prg";
-				#endif
-				logger->Write( FromWebServer, LogNotice, "Saving rpimenu.prg to SD card, length: %u", nPartLength);
-				writeFile( logger, "SD:", filename, (u8*) pPartData, nPartLength );
-				m_SidekickNet->requireCacheWellnessTreatment();
-				m_SidekickNet->requestReboot();
-				
-				pMsg = "Now uploading new rpimenu.prg to folder C64 and rebooting.";
-			}
-*/			
-			else if (nPartLength > 0)
-			{
-				char * type = "";
-				if ( strstr (pPartHeader, ".prg\"") || strstr (pPartHeader, ".PRG\""))
-				 	type = "prg";
-				if ( strstr (pPartHeader, ".d64\"") || strstr (pPartHeader, ".D64\""))
-					type = "d64";
-				if ( strstr (pPartHeader, ".crt\"") || strstr (pPartHeader, ".CRT\""))
-					type = "crt";
-				if ( strstr (pPartHeader, ".sid\"") || strstr (pPartHeader, ".SID\""))
-					type = "sid";
-				if ( strstr (pPartHeader, ".bin\"") || strstr (pPartHeader, ".BIN\""))
-					type = "bin";
-					
-				if (strcmp(type,"") != 0)
-				{
-					prgSizeLaunch = nPartLength;
-					memcpy( prgDataLaunch, pPartData, nPartLength);
-					m_SidekickNet->prepareLaunchOfUpload( type );
-					pMsg = "Now launching payload...";
-				}
-				else
-				{
-					pMsg = "Invalid request (1)";
-				}
-			}
-			else
-				pMsg = "Invalid request (2)";
-		}
-		else
+		const char *pMsg = m_pUploadMsg;
+		if (pMsg == 0)
 		{
 			pMsg = "Send a PRG, SID, CRT, D64 or BIN file to Sidekick64 for instant launch. Or upload a Sidekick kernel image update (includes reboot).";
 			m_SidekickNet->enterWebUploadMode();
@@ -242,7 +355,7 @@ CHTTPDaemon *CWebServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pS
 					}
 					else
 					{
-						logger->Write( FromWebServer, LogNotice, "Parsing form data: Error on finding key. %i / %i", c,l);
+						LOGRING( LOGRING_WEB, LogNotice, FromWebServer, "Parsing form data: Error on finding key. %i / %i", c,l);
 					}
 				}
 				if (mode == 1 && pFormData[c] == '=')
@@ -254,7 +367,7 @@ CHTTPDaemon *CWebServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pS
 					}
 					else
 					{
-						logger->Write( FromWebServer, LogNotice, "Parsing form data: Error looking for =.");
+						LOGRING( LOGRING_WEB, LogNotice, FromWebServer, "Parsing form data: Error looking for =.");
 						mode = 0;
 						break; //end of string, no value left after key =
 					}
@@ -263,7 +376,7 @@ CHTTPDaemon *CWebServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pS
 				{
 					if ( c == l || pFormData[c] == '&') //pFormData[c] == '\0')
 					{
-						logger->Write( FromWebServer, LogNotice, "Parsing form data: Assigning timingValue key=%i value=%i", key, atoi(value));
+						LOGRING( LOGRING_WEB, LogNotice, FromWebServer, "Parsing form data: Assigning timingValue key=%i value=%i", key, atoi(value));
 						
 						if ( atoi(value) > 0)
 						switch( key )
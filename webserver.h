@@ -20,28 +20,37 @@
 #ifndef _webserver_h
 #define _webserver_h
 
-#include <circle/net/httpdaemon.h>
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/net/http.h>
+#include <circle/string.h>
 
 class CWebServer; //forward declaration
 #include "net.h"
+#include "webrequest.h"
 
 extern CLogger *logger;
 
-class CWebServer : public CHTTPDaemon
+#define WEBSERVER_MAX_WORKERS		4
+
+// The requests are handled similar to Circle's CHTTPDaemon (a listener task creating one worker
+// task per connection), but the request body is not buffered: uploads are parsed while they are
+// received and streamed to the SD card or the launch buffer (see CWebRequest).
+class CWebServer : public CTask, public CWebRequest
 {
 public:
 	CWebServer (CNetSubSystem *pNetSubSystem,
 							 u16		nPort,
-							 unsigned	nMaxMultipartSize,
+							 unsigned	nMaxMultipartSize,	// largest kernel image accepted
 							 CSocket       *pSocket = 0,	// is 0 for 1st created instance (listener)				
 							 CSidekickNet * pSidekickNet = 0
 						 	);
 	~CWebServer (void);
  
 	boolean isRebootRequested();
- 
-	// creates an instance of our derived webserver class
-	CHTTPDaemon *CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pSocket);
+
+	void Run (void);
 
 	// provides our content
 	::THTTPStatus GetContent (const char  *pPath,		// path of the file to be sent
@@ -51,10 +60,29 @@ public:
 			        unsigned    *pLength,		// in: buffer size, out: content length
 			        const char **ppContentType);	// set this if not "text/html"
 
+protected:
+	void Launch (const char *pType, unsigned nLength);
+	void RefreshCaches (void);
+	void KernelSaved (void);
+	const char *GetKernelFilename (void);
+	void HandlePage (void);
+	boolean HandleAPICommand (const char *pCommand);
+
 private:
+	void Listener (void);
+
+	void APILog (void);
+#ifndef IS264
+	void APIProfile (void);
+#endif
+
+	CNetSubSystem * m_pNetSubSystem;
+	CSocket       * m_pSocket;
 	u16	 m_nPort;
 	unsigned m_nMaxMultipartSize;
   CSidekickNet * m_SidekickNet;
+
+	static unsigned s_nWorkers;
 };
 
 #endif